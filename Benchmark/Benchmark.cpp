@@ -0,0 +1,1590 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "CoalescingWriter.h"
+#include "ColorConversion.h"
+#include "EncodeDaemon.h"
+#include "FrameDedup.h"
+#include "FramePool.h"
+#include "FrameWriter.h"
+#include "MemoryFrameBuffer.h"
+#include "NullVideoSink.h"
+#include "EncoderProfiles.h"
+#include "ProfileSweep.h"
+#include "RawFrameReader.h"
+#include "RawVideoSink.h"
+#include "Tracer.h"
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        uint64_t NowNanoseconds()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        // Produces one frame per call and times each stage into its own
+        // histograms. Used from a single thread only.
+        class StageTimingProducer : public FrameProducer
+        {
+        public:
+            StageTimingProducer(const TestPatternSettings& pattern, uint32_t width, uint32_t height, KernelDispatch kernels)
+                : pattern(pattern), scratch(width, height, PixelFormat::RGB32),
+                  converter(ColorMatrix::BT709, ColorRange::Limited, 1, DetectSimdLevel(), kernels), kernels(kernels) {}
+
+            void render(const FrameView& frame, uint64_t frameIndex) override
+            {
+                uint64_t start = NowNanoseconds();
+                pattern.render(scratch.view(), frameIndex);
+                uint64_t end = NowNanoseconds();
+                generate.record(end - start);
+
+                start = end;
+                if (frame.format == PixelFormat::RGB32)
+                {
+                    CopyFrameRows(scratch.view(), frame, 0, frame.height, kernels);
+                    copy.record(NowNanoseconds() - start);
+                }
+                else
+                {
+                    converter.convert(scratch.view(), frame);
+                    convert.record(NowNanoseconds() - start);
+                }
+            }
+
+            LatencyHistogram generate;
+            LatencyHistogram convert;
+            LatencyHistogram copy;
+
+        private:
+            TestPatternProducer pattern;
+            MemoryFrameBuffer scratch;
+            ColorConverter converter;
+            KernelDispatch kernels;
+        };
+
+        // Forwards to another sink and times writeFrame.
+        class SubmitTimingSink : public VideoSink
+        {
+        public:
+            explicit SubmitTimingSink(VideoSink& inner) : inner(inner) {}
+
+            uint32_t addStream(const VideoStreamFormat& format) override { return inner.addStream(format); }
+            void setInputFormat(uint32_t streamIndex, const VideoStreamFormat& format) override { inner.setInputFormat(streamIndex, format); }
+            void beginWriting() override { inner.beginWriting(); }
+            SinkFrame acquireFrame(uint32_t streamIndex) override { return inner.acquireFrame(streamIndex); }
+            void discardFrame(uint32_t streamIndex, SinkFrame& frame) override { inner.discardFrame(streamIndex, frame); }
+            void finalize() override { inner.finalize(); }
+
+            void writeFrame(uint32_t streamIndex, SinkFrame& frame, int64_t timestamp, int64_t duration) override
+            {
+                const uint64_t start = NowNanoseconds();
+                inner.writeFrame(streamIndex, frame, timestamp, duration);
+                submit.record(NowNanoseconds() - start);
+            }
+
+            LatencyHistogram submit;
+
+        private:
+            VideoSink& inner;
+        };
+
+        std::unique_ptr<VideoSink> CreateBenchmarkSink(const std::string& output, PixelFormat format)
+        {
+            if (output == "null")
+            {
+                return std::unique_ptr<VideoSink>(new NullVideoSink());
+            }
+            const bool y4m = format != PixelFormat::RGB32 && output.size() > 4 && output.compare(output.size() - 4, 4, ".y4m") == 0;
+            return std::unique_ptr<VideoSink>(new RawVideoSink(output, y4m ? RawContainer::Y4M : RawContainer::Raw));
+        }
+
+        template<typename T, typename Parse>
+        std::vector<T> ParseList(const std::string& text, Parse parse)
+        {
+            std::vector<T> values;
+            std::istringstream in(text);
+            std::string item;
+            while (std::getline(in, item, ','))
+            {
+                values.push_back(parse(item));
+            }
+            if (values.empty())
+            {
+                throw std::invalid_argument("empty list: " + text);
+            }
+            return values;
+        }
+
+        uint64_t ParseNumber(const std::string& text)
+        {
+            size_t used = 0;
+            const unsigned long long value = std::stoull(text, &used);
+            if (used != text.size())
+            {
+                throw std::invalid_argument("not a number: " + text);
+            }
+            return value;
+        }
+
+        std::pair<uint32_t, uint32_t> ParseResolution(const std::string& text)
+        {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            if (!ParseFrameSize(text, width, height))
+            {
+                throw std::invalid_argument("expected WIDTHxHEIGHT, 720p, 1080p or 4k: " + text);
+            }
+            if (width == 0 || height == 0 || width % 2 != 0 || height % 2 != 0)
+            {
+                throw std::invalid_argument("resolution must be even and non-zero: " + text);
+            }
+            return std::make_pair(width, height);
+        }
+
+        // Frames per audio block, one AAC frame.
+        const uint32_t AUDIO_BLOCK_FRAMES = 1024;
+        const uint32_t AUDIO_CHANNELS = 2;
+
+        // Frames the hash cases cycle through.
+        const uint64_t HASH_DISTINCT_FRAMES = 4;
+
+        // Source frames the scale cases cycle through.
+        const uint64_t SCALE_DISTINCT_FRAMES = 4;
+
+        // Media per daemon job, at h264_profiles[0].
+        const double DAEMON_JOB_SECONDS = 1.0;
+
+        // SyntheticTranscodeRunner behind a startup delay standing in for
+        // COM, MFStartup and the first profile builds of a real runner.
+        class StubDaemonRunner : public TranscodeRunner
+        {
+        public:
+            StubDaemonRunner(double startupMs, std::atomic<uint64_t>& startups) : synthetic(DAEMON_JOB_SECONDS)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(startupMs));
+                ++startups;
+            }
+
+            TranscodeOutcome transcode(const TranscodeJob& job) override
+            {
+                return synthetic.transcode(job);
+            }
+
+            TranscodeOutcome transcodeWithProgress(const TranscodeJob& job, const TranscodeProgressCallback& onProgress) override
+            {
+                return synthetic.transcodeWithProgress(job, onProgress);
+            }
+
+        private:
+            SyntheticTranscodeRunner synthetic;
+        };
+
+        // Starts a StubDaemonRunner for every job, as running the encoder as
+        // a process per job would.
+        class PerJobDaemonRunner : public TranscodeRunner
+        {
+        public:
+            PerJobDaemonRunner(double startupMs, std::atomic<uint64_t>& startups) : startupMs(startupMs), startups(startups) {}
+
+            TranscodeOutcome transcode(const TranscodeJob& job) override
+            {
+                return transcodeWithProgress(job, TranscodeProgressCallback());
+            }
+
+            TranscodeOutcome transcodeWithProgress(const TranscodeJob& job, const TranscodeProgressCallback& onProgress) override
+            {
+                StubDaemonRunner runner(startupMs, startups);
+                return runner.transcodeWithProgress(job, onProgress);
+            }
+
+        private:
+            const double startupMs;
+            std::atomic<uint64_t>& startups;
+        };
+
+        const char* KernelDispatchName(KernelDispatch kernels)
+        {
+            return kernels == KernelDispatch::Generic ? "generic" : "specialized";
+        }
+
+        void WriteStageJson(std::ostream& out, const char* name, const LatencyHistogram& histogram, bool last)
+        {
+            out << "        \"" << name << "\": { \"count\": " << histogram.getCount()
+                << ", \"mean_us\": " << histogram.getMean() / 1000.0
+                << ", \"p50_us\": " << histogram.percentile(0.50) / 1000.0
+                << ", \"p99_us\": " << histogram.percentile(0.99) / 1000.0
+                << ", \"max_us\": " << histogram.getMax() / 1000.0 << " }" << (last ? "\n" : ",\n");
+        }
+    }
+
+    BenchmarkOptions DefaultBenchmarkOptions()
+    {
+        BenchmarkOptions options;
+        options.resolutions = { std::make_pair(640u, 480u), std::make_pair(1280u, 720u), std::make_pair(1920u, 1080u) };
+        options.formats = { PixelFormat::NV12, PixelFormat::I420, PixelFormat::RGB32 };
+        options.frameCounts = { 300 };
+        options.threadCounts = { 0, 2 };
+        options.patterns = { TestPatternKind::MovingBoxes };
+        options.motions = { 0.25 };
+        options.kernels = { KernelDispatch::Specialized };
+        options.dedupHolds = { 0.0 };
+        options.queueDepth = 8;
+        options.audioRates = { 44100, 48000, 96000 };
+        options.audioSeconds = 10.0;
+        options.ioWriteSizes = { 188, 4096, 65536 };
+        options.ioMegabytes = 256.0;
+        options.ioPath = "benchmark_io.tmp";
+        options.readMegabytes = 512.0;
+        options.readWindow = DEFAULT_MAP_WINDOW;
+        options.readPath = "benchmark_read.tmp";
+        options.hashFrames = 0;
+        options.scaleSizes = { std::make_pair(176u, 144u), std::make_pair(352u, 288u), std::make_pair(720u, 576u) };
+        options.scaleThreads = { 1, 2 };
+        options.scaleFrames = 100;
+        options.traceScopes = 0;
+        options.profileCacheLookups = 0;
+        options.daemonJobs = 0;
+        options.daemonStartupMs = 50.0;
+        options.daemonPath = "benchmark_daemon.sock";
+        options.profileSeconds = 0;
+        options.profileGrid = "*:*";
+        options.profileTolerance = 0.1;
+        options.output = "null";
+        return options;
+    }
+
+    BenchmarkOptions ParseBenchmarkOptions(int argc, char* argv[])
+    {
+        BenchmarkOptions options = DefaultBenchmarkOptions();
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string name = argv[i];
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument("missing value for " + name);
+            }
+            const std::string value = argv[++i];
+
+            if (name == "--resolutions")
+            {
+                if (value == "none")
+                {
+                    options.resolutions.clear();
+                }
+                else
+                {
+                    options.resolutions = ParseList<std::pair<uint32_t, uint32_t>>(value, ParseResolution);
+                }
+            }
+            else if (name == "--formats")
+            {
+                options.formats = ParseList<PixelFormat>(value, [](const std::string& text)
+                {
+                    PixelFormat format;
+                    if (!ParsePixelFormat(text, format))
+                    {
+                        throw std::invalid_argument("unknown pixel format: " + text);
+                    }
+                    return format;
+                });
+            }
+            else if (name == "--frames")
+            {
+                options.frameCounts = ParseList<uint64_t>(value, ParseNumber);
+            }
+            else if (name == "--threads")
+            {
+                options.threadCounts = ParseList<size_t>(value, [](const std::string& text) { return static_cast<size_t>(ParseNumber(text)); });
+            }
+            else if (name == "--patterns")
+            {
+                options.patterns = ParseList<TestPatternKind>(value, [](const std::string& text)
+                {
+                    TestPatternKind kind;
+                    if (!ParseTestPattern(text, kind))
+                    {
+                        throw std::invalid_argument("unknown test pattern: " + text);
+                    }
+                    return kind;
+                });
+            }
+            else if (name == "--motion")
+            {
+                options.motions = ParseList<double>(value, [](const std::string& text) { return std::stod(text); });
+            }
+            else if (name == "--kernels")
+            {
+                options.kernels = ParseList<KernelDispatch>(value, [](const std::string& text)
+                {
+                    if (text != KernelDispatchName(KernelDispatch::Generic) && text != KernelDispatchName(KernelDispatch::Specialized))
+                    {
+                        throw std::invalid_argument("unknown kernel set: " + text);
+                    }
+                    return text == KernelDispatchName(KernelDispatch::Generic) ? KernelDispatch::Generic : KernelDispatch::Specialized;
+                });
+            }
+            else if (name == "--dedup")
+            {
+                options.dedupHolds = ParseList<double>(value, [](const std::string& text) { return std::stod(text); });
+            }
+            else if (name == "--hash-frames")
+            {
+                options.hashFrames = ParseNumber(value);
+            }
+            else if (name == "--scale")
+            {
+                options.scaleFilters = ParseList<ScaleFilter>(value, [](const std::string& text)
+                {
+                    ScaleFilter filter;
+                    if (!ParseScaleFilter(text, filter))
+                    {
+                        throw std::invalid_argument("unknown scale filter: " + text);
+                    }
+                    return filter;
+                });
+            }
+            else if (name == "--scale-sizes")
+            {
+                options.scaleSizes = ParseList<std::pair<uint32_t, uint32_t>>(value, ParseResolution);
+            }
+            else if (name == "--scale-threads")
+            {
+                options.scaleThreads = ParseList<size_t>(value, [](const std::string& text) { return static_cast<size_t>(ParseNumber(text)); });
+            }
+            else if (name == "--scale-frames")
+            {
+                options.scaleFrames = ParseNumber(value);
+            }
+            else if (name == "--audio")
+            {
+                options.audioPatterns = ParseList<AudioPatternKind>(value, [](const std::string& text)
+                {
+                    AudioPatternKind kind;
+                    if (!ParseAudioPattern(text, kind))
+                    {
+                        throw std::invalid_argument("unknown audio pattern: " + text);
+                    }
+                    return kind;
+                });
+            }
+            else if (name == "--audio-rates")
+            {
+                options.audioRates = ParseList<uint32_t>(value, [](const std::string& text) { return static_cast<uint32_t>(ParseNumber(text)); });
+            }
+            else if (name == "--audio-seconds")
+            {
+                options.audioSeconds = std::stod(value);
+            }
+            else if (name == "--io")
+            {
+                options.ioTargets = ParseList<std::string>(value, [](const std::string& text)
+                {
+                    if (text != "file" && text != "memory")
+                    {
+                        throw std::invalid_argument("unknown I/O target: " + text);
+                    }
+                    return text;
+                });
+            }
+            else if (name == "--io-sizes")
+            {
+                options.ioWriteSizes = ParseList<size_t>(value, [](const std::string& text) { return static_cast<size_t>(ParseNumber(text)); });
+            }
+            else if (name == "--io-mb")
+            {
+                options.ioMegabytes = std::stod(value);
+            }
+            else if (name == "--io-path")
+            {
+                options.ioPath = value;
+            }
+            else if (name == "--read")
+            {
+                options.readMethods = ParseList<std::string>(value, [](const std::string& text)
+                {
+                    if (text != "mmap" && text != "read")
+                    {
+                        throw std::invalid_argument("unknown read method: " + text);
+                    }
+                    return text;
+                });
+            }
+            else if (name == "--read-mb")
+            {
+                options.readMegabytes = std::stod(value);
+            }
+            else if (name == "--read-window")
+            {
+                options.readWindow = static_cast<size_t>(ParseNumber(value)) << 20;
+            }
+            else if (name == "--read-path")
+            {
+                options.readPath = value;
+            }
+            else if (name == "--profile-cache")
+            {
+                options.profileCacheLookups = ParseNumber(value);
+            }
+            else if (name == "--daemon-jobs")
+            {
+                options.daemonJobs = ParseNumber(value);
+            }
+            else if (name == "--daemon-startup-ms")
+            {
+                options.daemonStartupMs = std::stod(value);
+            }
+            else if (name == "--daemon-path")
+            {
+                options.daemonPath = value;
+            }
+            else if (name == "--trace-scopes")
+            {
+                options.traceScopes = ParseNumber(value);
+            }
+            else if (name == "--trace")
+            {
+                options.tracePath = value;
+            }
+            else if (name == "--profile-sweep")
+            {
+                options.profileSeconds = std::stod(value);
+            }
+            else if (name == "--profile-grid")
+            {
+                options.profileGrid = value;
+            }
+            else if (name == "--profile-baseline")
+            {
+                options.profileBaseline = value;
+            }
+            else if (name == "--profile-csv")
+            {
+                options.profileCsv = value;
+            }
+            else if (name == "--profile-tolerance")
+            {
+                options.profileTolerance = std::stod(value);
+            }
+            else if (name == "--queue-depth")
+            {
+                options.queueDepth = static_cast<size_t>(ParseNumber(value));
+            }
+            else if (name == "--output")
+            {
+                options.output = value;
+            }
+            else if (name == "--json")
+            {
+                options.jsonPath = value;
+            }
+            else
+            {
+                throw std::invalid_argument("unknown option " + name);
+            }
+        }
+        return options;
+    }
+
+    BenchmarkResult RunBenchmarkCase(const BenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+    {
+        std::unique_ptr<VideoSink> output = CreateBenchmarkSink(options.output, benchmarkCase.format);
+        SubmitTimingSink sink(*output);
+
+        VideoStreamFormat format;
+        format.codec = VideoCodec::Uncompressed;
+        format.pixelFormat = benchmarkCase.format;
+        format.width = benchmarkCase.width;
+        format.height = benchmarkCase.height;
+        format.fpsNumerator = 30;
+        format.fpsDenominator = 1;
+        format.bitrate = 0;
+        format.matrix = ColorMatrix::BT709;
+        format.range = ColorRange::Limited;
+
+        const uint32_t streamIndex = sink.addStream(format);
+        sink.setInputFormat(streamIndex, format);
+        sink.beginWriting();
+
+        const size_t producerCount = benchmarkCase.threads > 0 ? benchmarkCase.threads : 1;
+        std::vector<std::unique_ptr<StageTimingProducer>> stageProducers;
+        std::vector<FrameProducer*> producers;
+        for (size_t i = 0; i < producerCount; ++i)
+        {
+            const TestPatternSettings pattern = { benchmarkCase.pattern, 1, benchmarkCase.motion };
+            stageProducers.emplace_back(new StageTimingProducer(pattern, benchmarkCase.width, benchmarkCase.height, benchmarkCase.kernels));
+            producers.push_back(stageProducers.back().get());
+        }
+
+        FrameWriterSettings settings;
+        settings.frameCount = benchmarkCase.frameCount;
+        settings.frameDuration = 10 * 1000 * 1000 / 30;
+        settings.queueDepth = benchmarkCase.threads > 0 ? options.queueDepth : 0;
+        settings.maxHoldDuration = static_cast<int64_t>(benchmarkCase.dedupHold * 10000000);
+
+        const uint64_t start = NowNanoseconds();
+        const PipelineStats stats = WriteFrames(sink, streamIndex, producers, settings);
+        sink.finalize();
+        const uint64_t elapsed = NowNanoseconds() - start;
+
+        BenchmarkResult result;
+        result.config = benchmarkCase;
+        result.seconds = elapsed / 1e9;
+        result.framesPerSecond = result.seconds > 0 ? benchmarkCase.frameCount / result.seconds : 0.0;
+        result.megabytesPerSecond = result.framesPerSecond * FrameBytes(benchmarkCase.format, benchmarkCase.width, benchmarkCase.height) / 1e6;
+        result.framesDropped = stats.framesDropped;
+        for (const std::unique_ptr<StageTimingProducer>& producer : stageProducers)
+        {
+            result.generate.merge(producer->generate);
+            result.convert.merge(producer->convert);
+            result.copy.merge(producer->copy);
+        }
+        result.submit = sink.submit;
+        return result;
+    }
+
+    std::vector<BenchmarkResult> RunBenchmarkSweep(const BenchmarkOptions& options)
+    {
+        std::vector<BenchmarkResult> results;
+        for (const std::pair<uint32_t, uint32_t>& resolution : options.resolutions)
+        {
+            for (PixelFormat format : options.formats)
+            {
+                for (uint64_t frameCount : options.frameCounts)
+                {
+                    for (size_t threads : options.threadCounts)
+                    {
+                        for (TestPatternKind pattern : options.patterns)
+                        {
+                            for (double motion : options.motions)
+                            {
+                                for (KernelDispatch kernels : options.kernels)
+                                {
+                                    for (double dedupHold : options.dedupHolds)
+                                    {
+                                        const BenchmarkCase benchmarkCase = { resolution.first, resolution.second, format, frameCount, threads, pattern, motion, kernels, dedupHold };
+                                        results.push_back(RunBenchmarkCase(benchmarkCase, options));
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return results;
+    }
+
+    AudioBenchmarkResult RunAudioBenchmarkCase(const AudioBenchmarkCase& benchmarkCase)
+    {
+        const AudioPatternSettings settings = DefaultAudioPatternSettings(benchmarkCase.pattern);
+        AudioPatternGenerator generator(settings, benchmarkCase.sampleRate, benchmarkCase.channels, benchmarkCase.level);
+        AudioPatternGenerator reference(settings, benchmarkCase.sampleRate, benchmarkCase.channels, SimdLevel::Scalar);
+
+        FramePool<AlignedBufferBackend> pool(AlignedBufferBackend(AudioBlockBytes(benchmarkCase.channels, AUDIO_BLOCK_FRAMES)), 4);
+        pool.preallocate();
+
+        std::vector<float> floatSamples(static_cast<size_t>(benchmarkCase.channels) * AUDIO_BLOCK_FRAMES);
+        std::vector<int16_t> intSamples(floatSamples.size());
+        std::vector<int16_t> expected(floatSamples.size());
+        std::vector<float*> floatPlanes;
+        std::vector<int16_t*> intPlanes;
+        for (uint32_t c = 0; c < benchmarkCase.channels; ++c)
+        {
+            floatPlanes.push_back(&floatSamples[static_cast<size_t>(c) * AUDIO_BLOCK_FRAMES]);
+            intPlanes.push_back(&intSamples[static_cast<size_t>(c) * AUDIO_BLOCK_FRAMES]);
+        }
+
+        AudioBenchmarkResult result;
+        result.config = benchmarkCase;
+        result.bitExact = true;
+        uint64_t elapsed = 0;
+        for (uint64_t position = 0; position < benchmarkCase.frameCount; position += AUDIO_BLOCK_FRAMES)
+        {
+            const uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>(AUDIO_BLOCK_FRAMES, benchmarkCase.frameCount - position));
+            AlignedBuffer block = pool.acquire();
+            int16_t* pcm = reinterpret_cast<int16_t*>(block.get());
+
+            uint64_t start = NowNanoseconds();
+            generator.renderFloat(floatPlanes.data(), position, frames);
+            uint64_t end = NowNanoseconds();
+            result.render.record(end - start);
+            elapsed += end - start;
+
+            start = end;
+            for (uint32_t c = 0; c < benchmarkCase.channels; ++c)
+            {
+                FloatToInt16(benchmarkCase.level, floatPlanes[c], intPlanes[c], frames, settings.dither, generator.ditherKey(c, position));
+            }
+            end = NowNanoseconds();
+            result.convert.record(end - start);
+            elapsed += end - start;
+
+            start = end;
+            InterleaveInt16(benchmarkCase.level, intPlanes.data(), benchmarkCase.channels, frames, pcm);
+            end = NowNanoseconds();
+            result.interleave.record(end - start);
+            elapsed += end - start;
+
+            reference.render(expected.data(), position, frames);
+            if (std::memcmp(expected.data(), pcm, AudioBlockBytes(benchmarkCase.channels, frames)) != 0)
+            {
+                result.bitExact = false;
+            }
+            pool.recycle(std::move(block));
+        }
+
+        result.seconds = elapsed / 1e9;
+        result.samplesPerSecond = result.seconds > 0 ? benchmarkCase.frameCount * benchmarkCase.channels / result.seconds : 0.0;
+        return result;
+    }
+
+    std::vector<AudioBenchmarkResult> RunAudioBenchmarkSweep(const BenchmarkOptions& options)
+    {
+        std::vector<SimdLevel> levels = { SimdLevel::Scalar };
+        if (DetectSimdLevel() >= SimdLevel::SSE2)
+        {
+            levels.push_back(SimdLevel::SSE2);
+        }
+        if (DetectSimdLevel() >= SimdLevel::AVX2)
+        {
+            levels.push_back(SimdLevel::AVX2);
+        }
+
+        std::vector<AudioBenchmarkResult> results;
+        for (AudioPatternKind pattern : options.audioPatterns)
+        {
+            for (uint32_t rate : options.audioRates)
+            {
+                for (SimdLevel level : levels)
+                {
+                    const uint64_t frameCount = static_cast<uint64_t>(options.audioSeconds * rate);
+                    const AudioBenchmarkCase benchmarkCase = { pattern, rate, AUDIO_CHANNELS, frameCount, level };
+                    results.push_back(RunAudioBenchmarkCase(benchmarkCase));
+                }
+            }
+        }
+        return results;
+    }
+
+    IoBenchmarkResult RunIoBenchmarkCase(const IoBenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+    {
+        if (benchmarkCase.writeSize == 0)
+        {
+            throw std::invalid_argument("I/O write size must be positive");
+        }
+
+        std::unique_ptr<ByteTarget> target;
+        MemoryRingTarget* ring = nullptr;
+        if (benchmarkCase.target == "memory")
+        {
+            ring = new MemoryRingTarget(4 * DEFAULT_COALESCING_BUFFER);
+            target.reset(ring);
+        }
+        else
+        {
+            target.reset(new FileByteTarget(options.ioPath));
+        }
+
+        // The next stage of a pipeline, draining the ring as fast as it can.
+        std::thread consumer;
+        if (ring != nullptr)
+        {
+            consumer = std::thread([ring]
+            {
+                std::vector<uint8_t> chunk(DEFAULT_COALESCING_BUFFER);
+                while (ring->consume(chunk.data(), chunk.size()) > 0)
+                {
+                }
+            });
+        }
+
+        std::vector<uint8_t> payload(benchmarkCase.writeSize);
+        for (size_t i = 0; i < payload.size(); ++i)
+        {
+            payload[i] = static_cast<uint8_t>(i * 31 + 7);
+        }
+
+        IoBenchmarkResult result;
+        result.config = benchmarkCase;
+        result.stalls = 0;
+        const uint64_t start = NowNanoseconds();
+
+        // Declared out here so whichever of writer and target owns the ring
+        // keeps it alive until the consumer has been joined, on every path.
+        std::unique_ptr<CoalescingWriter> writer;
+        try
+        {
+            if (benchmarkCase.coalesced)
+            {
+                writer.reset(new CoalescingWriter(std::move(target)));
+                for (uint64_t written = 0; written < benchmarkCase.totalBytes; written += payload.size())
+                {
+                    writer->write(payload.data(), static_cast<size_t>(std::min<uint64_t>(payload.size(), benchmarkCase.totalBytes - written)));
+                }
+                writer->close();
+                const CoalescingWriterStats stats = writer->getStats();
+                result.target = stats.target;
+                result.stalls = stats.stalls;
+            }
+            else
+            {
+                for (uint64_t written = 0; written < benchmarkCase.totalBytes; written += payload.size())
+                {
+                    target->write(payload.data(), static_cast<size_t>(std::min<uint64_t>(payload.size(), benchmarkCase.totalBytes - written)));
+                }
+                target->close();
+                result.target = target->getStats();
+            }
+        }
+        catch (...)
+        {
+            if (ring != nullptr)
+            {
+                ring->close();
+                consumer.join();
+            }
+            throw;
+        }
+        if (consumer.joinable())
+        {
+            consumer.join();
+        }
+        const uint64_t end = NowNanoseconds();
+        if (ring == nullptr)
+        {
+            std::remove(options.ioPath.c_str());
+        }
+
+        result.seconds = (end - start) / 1e9;
+        result.megabytesPerSecond = result.seconds > 0 ? benchmarkCase.totalBytes / result.seconds / 1e6 : 0.0;
+        return result;
+    }
+
+    std::vector<IoBenchmarkResult> RunIoBenchmarkSweep(const BenchmarkOptions& options)
+    {
+        const uint64_t totalBytes = static_cast<uint64_t>(options.ioMegabytes * 1e6);
+        std::vector<IoBenchmarkResult> results;
+        for (const std::string& target : options.ioTargets)
+        {
+            for (size_t writeSize : options.ioWriteSizes)
+            {
+                for (bool coalesced : { false, true })
+                {
+                    const IoBenchmarkCase benchmarkCase = { target, writeSize, totalBytes, coalesced };
+                    results.push_back(RunIoBenchmarkCase(benchmarkCase, options));
+                }
+            }
+        }
+        return results;
+    }
+
+    ReadBenchmarkResult RunReadBenchmarkCase(const ReadBenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+    {
+        MemoryFrameBuffer destination(benchmarkCase.width, benchmarkCase.height, PixelFormat::NV12);
+        const size_t frameBytes = FrameBytes(PixelFormat::NV12, benchmarkCase.width, benchmarkCase.height);
+
+        ReadBenchmarkResult result;
+        result.config = benchmarkCase;
+        result.maps = 0;
+        result.readCalls = 0;
+        uint64_t frames = 0;
+        const uint64_t start = NowNanoseconds();
+        if (benchmarkCase.method == "mmap")
+        {
+            const RawFrameFormat format = { PixelFormat::NV12, benchmarkCase.width, benchmarkCase.height, 0, 1 };
+            RawFrameReader reader(options.readPath, format, benchmarkCase.window);
+            for (; frames < reader.getFrameCount(); ++frames)
+            {
+                const uint64_t frameStart = NowNanoseconds();
+                CopyFrameRows(reader.frame(frames), destination.view(), 0, benchmarkCase.height);
+                result.frame.record(NowNanoseconds() - frameStart);
+            }
+            result.maps = reader.getStats().maps;
+        }
+        else
+        {
+            std::FILE* file = std::fopen(options.readPath.c_str(), "rb");
+            if (file == nullptr)
+            {
+                throw std::runtime_error("cannot open " + options.readPath);
+            }
+            // Unbuffered, so each frame is one read() straight into the buffer.
+            std::setvbuf(file, nullptr, _IONBF, 0);
+            MemoryFrameBuffer buffer(benchmarkCase.width, benchmarkCase.height, PixelFormat::NV12);
+            for (;;)
+            {
+                const uint64_t frameStart = NowNanoseconds();
+                ++result.readCalls;
+                if (std::fread(buffer.view().data, 1, frameBytes, file) != frameBytes)
+                {
+                    break;
+                }
+                CopyFrameRows(buffer.view(), destination.view(), 0, benchmarkCase.height);
+                result.frame.record(NowNanoseconds() - frameStart);
+                ++frames;
+            }
+            std::fclose(file);
+        }
+        const uint64_t end = NowNanoseconds();
+
+        if (frames != benchmarkCase.frameCount)
+        {
+            throw std::runtime_error("read " + std::to_string(frames) + " frames, expected " + std::to_string(benchmarkCase.frameCount));
+        }
+        result.seconds = (end - start) / 1e9;
+        result.megabytesPerSecond = result.seconds > 0 ? frames * frameBytes / result.seconds / 1e6 : 0.0;
+        return result;
+    }
+
+    std::vector<ReadBenchmarkResult> RunReadBenchmarkSweep(const BenchmarkOptions& options)
+    {
+        std::vector<ReadBenchmarkResult> results;
+        if (options.readMethods.empty())
+        {
+            return results;
+        }
+
+        const uint32_t width = 1920;
+        const uint32_t height = 1080;
+        const size_t frameBytes = FrameBytes(PixelFormat::NV12, width, height);
+        const uint64_t frameCount = std::max<uint64_t>(1, static_cast<uint64_t>(options.readMegabytes * 1e6) / frameBytes);
+        {
+            FileByteTarget capture(options.readPath);
+            std::vector<uint8_t> frame(frameBytes);
+            for (uint64_t i = 0; i < frameCount; ++i)
+            {
+                for (size_t j = 0; j < frame.size(); j += 4096)
+                {
+                    frame[j] = static_cast<uint8_t>(i + j);
+                }
+                capture.write(frame.data(), frame.size());
+            }
+            capture.close();
+        }
+
+        try
+        {
+            for (const std::string& method : options.readMethods)
+            {
+                const ReadBenchmarkCase benchmarkCase = { method, width, height, frameCount, options.readWindow };
+                results.push_back(RunReadBenchmarkCase(benchmarkCase, options));
+            }
+        }
+        catch (...)
+        {
+            std::remove(options.readPath.c_str());
+            throw;
+        }
+        std::remove(options.readPath.c_str());
+        return results;
+    }
+
+    HashBenchmarkResult RunHashBenchmarkCase(const HashBenchmarkCase& benchmarkCase)
+    {
+        // Noise, so every frame differs; more of them than fit in cache at
+        // the larger sizes.
+        const TestPatternSettings pattern = { TestPatternKind::Noise, 1, 1.0 };
+        StageTimingProducer producer(pattern, benchmarkCase.width, benchmarkCase.height, KernelDispatch::Specialized);
+        std::vector<MemoryFrameBuffer> frames;
+        for (uint64_t i = 0; i < HASH_DISTINCT_FRAMES; ++i)
+        {
+            frames.emplace_back(benchmarkCase.width, benchmarkCase.height, benchmarkCase.format);
+            producer.render(frames.back().view(), i);
+        }
+
+        HashBenchmarkResult result;
+        result.config = benchmarkCase;
+        result.matchesScalar = true;
+        for (const MemoryFrameBuffer& frame : frames)
+        {
+            if (HashFrame(benchmarkCase.level, frame.view()) != HashFrame(SimdLevel::Scalar, frame.view()))
+            {
+                result.matchesScalar = false;
+            }
+        }
+
+        // Summed so the hashing can't be optimised away.
+        uint64_t sum = 0;
+        const uint64_t start = NowNanoseconds();
+        for (uint64_t i = 0; i < benchmarkCase.frameCount; ++i)
+        {
+            sum += HashFrame(benchmarkCase.level, frames[i % frames.size()].view());
+        }
+        const uint64_t elapsed = NowNanoseconds() - start;
+        static std::atomic<uint64_t> sink(0);
+        sink += sum;
+
+        result.seconds = elapsed / 1e9;
+        result.megabytesPerSecond = result.seconds > 0
+            ? benchmarkCase.frameCount * FrameBytes(benchmarkCase.format, benchmarkCase.width, benchmarkCase.height) / result.seconds / 1e6 : 0.0;
+        return result;
+    }
+
+    std::vector<HashBenchmarkResult> RunHashBenchmarkSweep(const BenchmarkOptions& options)
+    {
+        std::vector<HashBenchmarkResult> results;
+        if (options.hashFrames == 0)
+        {
+            return results;
+        }
+        std::vector<SimdLevel> levels = { SimdLevel::Scalar };
+        if (DetectSimdLevel() >= SimdLevel::SSE2)
+        {
+            levels.push_back(SimdLevel::SSE2);
+        }
+        if (DetectSimdLevel() >= SimdLevel::AVX2)
+        {
+            levels.push_back(SimdLevel::AVX2);
+        }
+        for (const std::pair<uint32_t, uint32_t>& resolution : options.resolutions)
+        {
+            for (PixelFormat format : options.formats)
+            {
+                for (SimdLevel level : levels)
+                {
+                    const HashBenchmarkCase benchmarkCase = { resolution.first, resolution.second, format, options.hashFrames, level };
+                    results.push_back(RunHashBenchmarkCase(benchmarkCase));
+                }
+            }
+        }
+        return results;
+    }
+
+    ScaleBenchmarkResult RunScaleBenchmarkCase(const ScaleBenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+    {
+        const ScaleBenchmarkCase& c = benchmarkCase;
+        const TestPatternSettings pattern = { options.patterns.front(), 1, options.motions.front() };
+        StageTimingProducer producer(pattern, c.srcWidth, c.srcHeight, KernelDispatch::Specialized);
+        std::vector<MemoryFrameBuffer> frames;
+        for (uint64_t i = 0; i < SCALE_DISTINCT_FRAMES; ++i)
+        {
+            frames.emplace_back(c.srcWidth, c.srcHeight, c.format);
+            producer.render(frames.back().view(), i);
+        }
+
+        FrameScaler scaler(c.filter, c.threads, c.level);
+        FrameScaler scalar(c.filter, 1, SimdLevel::Scalar);
+        MemoryFrameBuffer scaled(c.dstWidth, c.dstHeight, c.format);
+        MemoryFrameBuffer expected(c.dstWidth, c.dstHeight, c.format);
+
+        ScaleBenchmarkResult result;
+        result.config = c;
+        result.matchesScalar = true;
+        for (const MemoryFrameBuffer& frame : frames)
+        {
+            scaler.scale(frame.view(), scaled.view());
+            scalar.scale(frame.view(), expected.view());
+            if (!SameFramePixels(scaled.view(), expected.view()))
+            {
+                result.matchesScalar = false;
+            }
+        }
+
+        // Quality from the first frame: the fixed point kernels against the
+        // exact filter, and what survives a trip down and back up.
+        scaler.scale(frames.front().view(), scaled.view());
+        ScaleFrameReference(c.filter, frames.front().view(), expected.view());
+        result.psnrReference = FramePsnr(scaled.view(), expected.view());
+        MemoryFrameBuffer roundTrip(c.srcWidth, c.srcHeight, c.format);
+        scaler.scale(scaled.view(), roundTrip.view());
+        result.psnrRoundTrip = FramePsnr(roundTrip.view(), frames.front().view());
+
+        const uint64_t start = NowNanoseconds();
+        for (uint64_t i = 0; i < c.frameCount; ++i)
+        {
+            scaler.scale(frames[i % frames.size()].view(), scaled.view());
+        }
+        const uint64_t elapsed = NowNanoseconds() - start;
+
+        result.seconds = elapsed / 1e9;
+        result.framesPerSecond = result.seconds > 0 ? c.frameCount / result.seconds : 0.0;
+        result.megabytesPerSecond = result.framesPerSecond * FrameBytes(c.format, c.srcWidth, c.srcHeight) / 1e6;
+        return result;
+    }
+
+    std::vector<ScaleBenchmarkResult> RunScaleBenchmarkSweep(const BenchmarkOptions& options)
+    {
+        std::vector<ScaleBenchmarkResult> results;
+        if (options.scaleFilters.empty() || options.scaleFrames == 0)
+        {
+            return results;
+        }
+        std::vector<SimdLevel> levels = { SimdLevel::Scalar };
+        if (DetectSimdLevel() >= SimdLevel::SSE2)
+        {
+            levels.push_back(SimdLevel::SSE2);
+        }
+        if (DetectSimdLevel() >= SimdLevel::AVX2)
+        {
+            levels.push_back(SimdLevel::AVX2);
+        }
+        for (const std::pair<uint32_t, uint32_t>& resolution : options.resolutions)
+        {
+            for (PixelFormat format : { PixelFormat::NV12, PixelFormat::I420 })
+            {
+                for (const std::pair<uint32_t, uint32_t>& size : options.scaleSizes)
+                {
+                    for (ScaleFilter filter : options.scaleFilters)
+                    {
+                        for (SimdLevel level : levels)
+                        {
+                            for (size_t threads : options.scaleThreads)
+                            {
+                                const ScaleBenchmarkCase benchmarkCase = { resolution.first, resolution.second, size.first, size.second,
+                                    format, filter, level, threads, options.scaleFrames };
+                                results.push_back(RunScaleBenchmarkCase(benchmarkCase, options));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return results;
+    }
+
+    ProfileCacheBenchmarkResult RunProfileCacheBenchmarkCase(const ProfileCacheBenchmarkCase& benchmarkCase)
+    {
+        // Every transcode profile the tables allow, in both containers.
+        std::vector<ProfileDescriptor> descriptors;
+        for (size_t audio = 0; audio < AAC_PROFILE_COUNT; ++audio)
+        {
+            for (size_t video = 0; video < H264_PROFILE_COUNT; ++video)
+            {
+                descriptors.push_back(MakeTranscodeDescriptor(aac_profiles[audio], h264_profiles[video], 0, ContainerType::MPEG4));
+                descriptors.push_back(MakeTranscodeDescriptor(aac_profiles[audio], h264_profiles[video], 0, ContainerType::FragmentedMPEG4));
+            }
+        }
+        // The same profiles as callers might spell them: unreduced frame
+        // rates and fields the profile doesn't use. They must find the
+        // entries above.
+        std::vector<ProfileDescriptor> variants = descriptors;
+        for (ProfileDescriptor& variant : variants)
+        {
+            variant.video.fpsNumerator *= 1000;
+            variant.video.fpsDenominator *= 1000;
+            variant.video.pixelFormat = PixelFormat::I420;
+            variant.video.matrix = ColorMatrix::BT709;
+        }
+
+        ProfileCache<std::string> cache;
+        const std::function<std::string(const ProfileDescriptor&)> build = DescribeProfile;
+
+        // Threads start together, so the first lookups race to build.
+        std::atomic<size_t> ready(0);
+        std::atomic<uint64_t> elapsed(0);
+        std::atomic<bool> consistent(true);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < benchmarkCase.threads; ++t)
+        {
+            threads.emplace_back([&, t]
+            {
+                ++ready;
+                while (ready.load() < benchmarkCase.threads)
+                {
+                    std::this_thread::yield();
+                }
+                size_t length = 0;
+                const uint64_t start = NowNanoseconds();
+                for (uint64_t i = 0; i < benchmarkCase.lookups; ++i)
+                {
+                    const size_t index = static_cast<size_t>((i + t) % descriptors.size());
+                    const ProfileDescriptor& descriptor = (i / descriptors.size()) % 2 == 0 ? descriptors[index] : variants[index];
+                    if (benchmarkCase.cached)
+                    {
+                        length += cache.get(descriptor, build)->size();
+                    }
+                    else
+                    {
+                        length += build(CanonicalProfileDescriptor(descriptor)).size();
+                    }
+                }
+                elapsed += NowNanoseconds() - start;
+                if (length == 0)
+                {
+                    consistent = false;
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        ProfileCacheBenchmarkResult result;
+        result.config = benchmarkCase;
+        result.seconds = elapsed.load() / 1e9 / benchmarkCase.threads;
+        result.nanosecondsPerLookup = benchmarkCase.lookups > 0 ? static_cast<double>(elapsed.load()) / benchmarkCase.threads / benchmarkCase.lookups : 0.0;
+        result.stats = cache.stats();
+        result.consistent = consistent.load();
+        if (benchmarkCase.cached)
+        {
+            const uint64_t total = benchmarkCase.threads * benchmarkCase.lookups;
+            const uint64_t distinct = std::min<uint64_t>(descriptors.size(), total);
+            result.consistent = result.consistent && result.stats.misses == distinct && result.stats.hits == total - distinct
+                && result.stats.failures == 0;
+            for (size_t i = 0; i < descriptors.size() && i < total; ++i)
+            {
+                const ProfileCache<std::string>::Entry entry = cache.get(variants[i], build);
+                result.consistent = result.consistent && entry == cache.get(descriptors[i], build) && *entry == DescribeProfile(descriptors[i]);
+            }
+        }
+        return result;
+    }
+
+    std::vector<ProfileCacheBenchmarkResult> RunProfileCacheBenchmarkSweep(const BenchmarkOptions& options)
+    {
+        std::vector<ProfileCacheBenchmarkResult> results;
+        if (options.profileCacheLookups == 0)
+        {
+            return results;
+        }
+        for (size_t threads : { 1, 4 })
+        {
+            for (bool cached : { false, true })
+            {
+                const ProfileCacheBenchmarkCase benchmarkCase = { threads, options.profileCacheLookups, cached };
+                results.push_back(RunProfileCacheBenchmarkCase(benchmarkCase));
+            }
+        }
+        return results;
+    }
+
+    DaemonBenchmarkResult RunDaemonBenchmarkCase(const DaemonBenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+    {
+        std::atomic<uint64_t> startups(0);
+        const double startupMs = options.daemonStartupMs;
+        TranscodeRunnerFactory createRunner;
+        if (benchmarkCase.resident)
+        {
+            createRunner = [startupMs, &startups]() { return std::unique_ptr<TranscodeRunner>(new StubDaemonRunner(startupMs, startups)); };
+        }
+        else
+        {
+            createRunner = [startupMs, &startups]() { return std::unique_ptr<TranscodeRunner>(new PerJobDaemonRunner(startupMs, startups)); };
+        }
+
+        const EncodeDaemonSettings settings = { benchmarkCase.sessions, 0, 1, 0 };
+        EncodeDaemon daemon(settings, createRunner);
+        LocalListener listener(options.daemonPath);
+        std::ostringstream log;
+        std::thread server([&]() { ServeEncodeDaemon(listener, daemon, log); });
+
+        std::mutex mutex;
+        LatencyHistogram latency;
+        uint64_t progressEvents = 0;
+        bool ordered = true;
+        std::vector<std::thread> clients;
+        const uint64_t start = NowNanoseconds();
+        for (size_t c = 0; c < benchmarkCase.clients; ++c)
+        {
+            clients.emplace_back([&, c]()
+            {
+                std::unique_ptr<LocalConnection> connection = LocalConnection::connect(options.daemonPath);
+                LatencyHistogram clientLatency;
+                uint64_t clientProgress = 0;
+                bool clientOrdered = true;
+                for (uint64_t j = c; j < benchmarkCase.jobs; j += benchmarkCase.clients)
+                {
+                    DaemonRequest request = DaemonRequest();
+                    request.kind = DaemonRequestKind::Encode;
+                    request.job.input = "job" + std::to_string(j);
+                    request.job.output = request.job.input + ".mp4";
+
+                    size_t seen = 0;
+                    double lastFraction = 0.0;
+                    const uint64_t submitted = NowNanoseconds();
+                    const DaemonEvent last = RequestDaemon(*connection, request, [&](const DaemonEvent& event)
+                    {
+                        const bool expected = seen == 0 ? event.kind == DaemonEventKind::Accepted
+                            : event.kind == DaemonEventKind::Progress || event.kind == DaemonEventKind::Done;
+                        if (event.kind == DaemonEventKind::Progress)
+                        {
+                            clientOrdered = clientOrdered && event.progress.fraction >= lastFraction;
+                            lastFraction = event.progress.fraction;
+                            ++clientProgress;
+                        }
+                        clientOrdered = clientOrdered && expected;
+                        ++seen;
+                    });
+                    clientLatency.record(NowNanoseconds() - submitted);
+                    clientOrdered = clientOrdered && last.kind == DaemonEventKind::Done && lastFraction == 1.0 && last.outcome.outputBytes > 0;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                latency.merge(clientLatency);
+                progressEvents += clientProgress;
+                ordered = ordered && clientOrdered;
+            });
+        }
+        for (std::thread& client : clients)
+        {
+            client.join();
+        }
+        const uint64_t elapsed = NowNanoseconds() - start;
+
+        std::unique_ptr<LocalConnection> control = LocalConnection::connect(options.daemonPath);
+        DaemonRequest shutdown = DaemonRequest();
+        shutdown.kind = DaemonRequestKind::Shutdown;
+        RequestDaemon(*control, shutdown);
+        server.join();
+        const DaemonStatus status = daemon.getStatus();
+
+        DaemonBenchmarkResult result;
+        result.config = benchmarkCase;
+        result.seconds = elapsed / 1e9;
+        result.jobsPerSecond = elapsed > 0 ? benchmarkCase.jobs / result.seconds : 0.0;
+        result.latency = latency;
+        result.startups = startups.load();
+        result.progressEvents = progressEvents;
+        result.ordered = ordered && status.succeeded == benchmarkCase.jobs && status.failed == 0;
+        return result;
+    }
+
+    std::vector<DaemonBenchmarkResult> RunDaemonBenchmarkSweep(const BenchmarkOptions& options)
+    {
+        std::vector<DaemonBenchmarkResult> results;
+        if (options.daemonJobs == 0)
+        {
+            return results;
+        }
+        for (size_t sessions : { 1, 2 })
+        {
+            for (bool resident : { false, true })
+            {
+                const DaemonBenchmarkCase benchmarkCase = { sessions, 4, options.daemonJobs, resident };
+                results.push_back(RunDaemonBenchmarkCase(benchmarkCase, options));
+            }
+        }
+        return results;
+    }
+
+    TraceBenchmarkResult RunTraceBenchmarkCase(const TraceBenchmarkCase& benchmarkCase)
+    {
+        if (benchmarkCase.enabled)
+        {
+            StartTracing(static_cast<size_t>(benchmarkCase.scopes) + 1);
+        }
+        else
+        {
+            StopTracing();
+        }
+
+        // Threads start together so they contend for nothing but the clock.
+        std::atomic<size_t> ready(0);
+        std::atomic<uint64_t> elapsed(0);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < benchmarkCase.threads; ++t)
+        {
+            threads.emplace_back([&]
+            {
+                // The first event allocates the thread's buffer; keep that
+                // out of the timing.
+                TraceInstant("ready");
+                ++ready;
+                while (ready.load() < benchmarkCase.threads)
+                {
+                    std::this_thread::yield();
+                }
+                const uint64_t start = NowNanoseconds();
+                for (uint64_t i = 0; i < benchmarkCase.scopes; ++i)
+                {
+                    TRACE_SCOPE("scope", static_cast<int64_t>(i));
+                }
+                elapsed += NowNanoseconds() - start;
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        StopTracing();
+
+        TraceBenchmarkResult result;
+        result.config = benchmarkCase;
+        result.seconds = elapsed.load() / 1e9 / benchmarkCase.threads;
+        result.nanosecondsPerScope = benchmarkCase.scopes > 0 ? static_cast<double>(elapsed.load()) / benchmarkCase.threads / benchmarkCase.scopes : 0.0;
+        const TraceStats stats = GetTraceStats();
+        result.recorded = benchmarkCase.enabled ? stats.events - benchmarkCase.threads : 0;
+        result.complete = benchmarkCase.enabled ? stats.events == benchmarkCase.threads * (benchmarkCase.scopes + 1) && stats.dropped == 0 : true;
+        if (benchmarkCase.enabled)
+        {
+            // The dump must hold every event; checked by count, not parsed.
+            std::ostringstream json;
+            WriteChromeTrace(json);
+            const std::string text = json.str();
+            uint64_t spans = 0;
+            for (size_t at = text.find("\"ph\": \"X\""); at != std::string::npos; at = text.find("\"ph\": \"X\"", at + 1))
+            {
+                ++spans;
+            }
+            result.complete = result.complete && spans == benchmarkCase.threads * benchmarkCase.scopes;
+        }
+        return result;
+    }
+
+    std::vector<TraceBenchmarkResult> RunTraceBenchmarkSweep(const BenchmarkOptions& options)
+    {
+        std::vector<TraceBenchmarkResult> results;
+        if (options.traceScopes == 0)
+        {
+            return results;
+        }
+        for (size_t threads : { 1, 4 })
+        {
+            for (bool enabled : { false, true })
+            {
+                const TraceBenchmarkCase benchmarkCase = { threads, options.traceScopes, enabled };
+                results.push_back(RunTraceBenchmarkCase(benchmarkCase));
+            }
+        }
+        return results;
+    }
+
+    size_t RunProfileSweepBenchmark(const BenchmarkOptions& options, std::ostream& out)
+    {
+        if (options.profileSeconds <= 0)
+        {
+            return 0;
+        }
+        std::vector<ProfileSweepResult> baseline;
+        if (!options.profileBaseline.empty())
+        {
+            std::ifstream in(options.profileBaseline);
+            if (!in)
+            {
+                throw std::runtime_error("cannot open " + options.profileBaseline);
+            }
+            baseline = ReadProfileSweepCsv(in);
+        }
+
+        SyntheticTranscodeRunner runner(options.profileSeconds);
+        const std::vector<ProfileSweepResult> results = RunProfileSweep(ParseProfileGrid(options.profileGrid), "synthetic", "benchmark_profile", runner);
+        const std::vector<ProfileSweepRegression> regressions = CompareProfileSweep(results, baseline, options.profileTolerance);
+        WriteProfileSweepSummary(out, results, regressions);
+        if (!options.profileCsv.empty())
+        {
+            std::ofstream csv(options.profileCsv);
+            WriteProfileSweepCsv(csv, results);
+        }
+        return regressions.size();
+    }
+
+    void WriteBenchmarkJson(std::ostream& out, const std::vector<BenchmarkResult>& results, const std::vector<AudioBenchmarkResult>& audioResults,
+        const std::vector<IoBenchmarkResult>& ioResults, const std::vector<ReadBenchmarkResult>& readResults,
+        const std::vector<TraceBenchmarkResult>& traceResults, const std::vector<HashBenchmarkResult>& hashResults,
+        const std::vector<ScaleBenchmarkResult>& scaleResults, const std::vector<ProfileCacheBenchmarkResult>& cacheResults,
+        const std::vector<DaemonBenchmarkResult>& daemonResults)
+    {
+        out << "{\n  \"simd\": \"" << SimdLevelName(DetectSimdLevel()) << "\",\n  \"cases\": [\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const BenchmarkResult& r = results[i];
+            out << "    {\n"
+                << "      \"width\": " << r.config.width << ", \"height\": " << r.config.height
+                << ", \"format\": \"" << PixelFormatName(r.config.format) << "\""
+                << ", \"frames\": " << r.config.frameCount << ", \"threads\": " << r.config.threads
+                << ", \"pattern\": \"" << TestPatternName(r.config.pattern) << "\", \"motion\": " << r.config.motion
+                << ", \"kernels\": \"" << KernelDispatchName(r.config.kernels) << "\", \"dedup_hold\": " << r.config.dedupHold << ",\n"
+                << "      \"seconds\": " << r.seconds << ", \"fps\": " << r.framesPerSecond
+                << ", \"mb_per_s\": " << r.megabytesPerSecond << ", \"frames_dropped\": " << r.framesDropped << ",\n"
+                << "      \"stages\": {\n";
+            WriteStageJson(out, "generate", r.generate, false);
+            WriteStageJson(out, "convert", r.convert, false);
+            WriteStageJson(out, "copy", r.copy, false);
+            WriteStageJson(out, "submit", r.submit, true);
+            out << "      }\n    }" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"audio_cases\": [\n";
+        for (size_t i = 0; i < audioResults.size(); ++i)
+        {
+            const AudioBenchmarkResult& r = audioResults[i];
+            out << "    {\n"
+                << "      \"pattern\": \"" << AudioPatternName(r.config.pattern) << "\", \"sample_rate\": " << r.config.sampleRate
+                << ", \"channels\": " << r.config.channels << ", \"frames\": " << r.config.frameCount
+                << ", \"simd\": \"" << SimdLevelName(r.config.level) << "\",\n"
+                << "      \"seconds\": " << r.seconds << ", \"msamples_per_s\": " << r.samplesPerSecond / 1e6
+                << ", \"bit_exact\": " << (r.bitExact ? "true" : "false") << ",\n"
+                << "      \"stages\": {\n";
+            WriteStageJson(out, "render", r.render, false);
+            WriteStageJson(out, "convert", r.convert, false);
+            WriteStageJson(out, "interleave", r.interleave, true);
+            out << "      }\n    }" << (i + 1 < audioResults.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"io_cases\": [\n";
+        for (size_t i = 0; i < ioResults.size(); ++i)
+        {
+            const IoBenchmarkResult& r = ioResults[i];
+            out << "    { \"target\": \"" << r.config.target << "\", \"write_size\": " << r.config.writeSize
+                << ", \"bytes\": " << r.config.totalBytes << ", \"coalesced\": " << (r.config.coalesced ? "true" : "false")
+                << ", \"seconds\": " << r.seconds << ", \"mb_per_s\": " << r.megabytesPerSecond
+                << ", \"target_writes\": " << r.target.writeCalls << ", \"bytes_written\": " << r.target.bytesWritten
+                << ", \"stalls\": " << r.stalls << " }" << (i + 1 < ioResults.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"read_cases\": [\n";
+        for (size_t i = 0; i < readResults.size(); ++i)
+        {
+            const ReadBenchmarkResult& r = readResults[i];
+            out << "    {\n"
+                << "      \"method\": \"" << r.config.method << "\", \"width\": " << r.config.width << ", \"height\": " << r.config.height
+                << ", \"frames\": " << r.config.frameCount << ", \"window\": " << r.config.window << ",\n"
+                << "      \"seconds\": " << r.seconds << ", \"mb_per_s\": " << r.megabytesPerSecond
+                << ", \"maps\": " << r.maps << ", \"read_calls\": " << r.readCalls << ",\n"
+                << "      \"stages\": {\n";
+            WriteStageJson(out, "frame", r.frame, true);
+            out << "      }\n    }" << (i + 1 < readResults.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"trace_cases\": [\n";
+        for (size_t i = 0; i < traceResults.size(); ++i)
+        {
+            const TraceBenchmarkResult& r = traceResults[i];
+            out << "    { \"threads\": " << r.config.threads << ", \"scopes\": " << r.config.scopes
+                << ", \"enabled\": " << (r.config.enabled ? "true" : "false")
+                << ", \"seconds\": " << r.seconds << ", \"ns_per_scope\": " << r.nanosecondsPerScope
+                << ", \"recorded\": " << r.recorded << ", \"complete\": " << (r.complete ? "true" : "false")
+                << " }" << (i + 1 < traceResults.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"hash_cases\": [\n";
+        for (size_t i = 0; i < hashResults.size(); ++i)
+        {
+            const HashBenchmarkResult& r = hashResults[i];
+            out << "    { \"width\": " << r.config.width << ", \"height\": " << r.config.height
+                << ", \"format\": \"" << PixelFormatName(r.config.format) << "\", \"frames\": " << r.config.frameCount
+                << ", \"simd\": \"" << SimdLevelName(r.config.level) << "\", \"seconds\": " << r.seconds
+                << ", \"mb_per_s\": " << r.megabytesPerSecond << ", \"matches_scalar\": " << (r.matchesScalar ? "true" : "false")
+                << " }" << (i + 1 < hashResults.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"scale_cases\": [\n";
+        for (size_t i = 0; i < scaleResults.size(); ++i)
+        {
+            const ScaleBenchmarkResult& r = scaleResults[i];
+            out << "    {\n"
+                << "      \"src_width\": " << r.config.srcWidth << ", \"src_height\": " << r.config.srcHeight
+                << ", \"dst_width\": " << r.config.dstWidth << ", \"dst_height\": " << r.config.dstHeight
+                << ", \"format\": \"" << PixelFormatName(r.config.format) << "\", \"filter\": \"" << ScaleFilterName(r.config.filter)
+                << "\", \"simd\": \"" << SimdLevelName(r.config.level) << "\", \"threads\": " << r.config.threads
+                << ", \"frames\": " << r.config.frameCount << ",\n"
+                << "      \"seconds\": " << r.seconds << ", \"fps\": " << r.framesPerSecond << ", \"mb_per_s\": " << r.megabytesPerSecond
+                << ", \"psnr_reference_db\": " << r.psnrReference << ", \"psnr_round_trip_db\": " << r.psnrRoundTrip
+                << ", \"matches_scalar\": " << (r.matchesScalar ? "true" : "false") << "\n"
+                << "    }" << (i + 1 < scaleResults.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"profile_cache_cases\": [\n";
+        for (size_t i = 0; i < cacheResults.size(); ++i)
+        {
+            const ProfileCacheBenchmarkResult& r = cacheResults[i];
+            out << "    { \"threads\": " << r.config.threads << ", \"lookups\": " << r.config.lookups
+                << ", \"cached\": " << (r.config.cached ? "true" : "false")
+                << ", \"seconds\": " << r.seconds << ", \"ns_per_lookup\": " << r.nanosecondsPerLookup
+                << ", \"hits\": " << r.stats.hits << ", \"misses\": " << r.stats.misses << ", \"entries\": " << r.stats.entries
+                << ", \"consistent\": " << (r.consistent ? "true" : "false")
+                << " }" << (i + 1 < cacheResults.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"daemon_cases\": [\n";
+        for (size_t i = 0; i < daemonResults.size(); ++i)
+        {
+            const DaemonBenchmarkResult& r = daemonResults[i];
+            out << "    { \"sessions\": " << r.config.sessions << ", \"clients\": " << r.config.clients << ", \"jobs\": " << r.config.jobs
+                << ", \"resident\": " << (r.config.resident ? "true" : "false")
+                << ", \"seconds\": " << r.seconds << ", \"jobs_per_s\": " << r.jobsPerSecond
+                << ", \"latency_mean_ms\": " << r.latency.getMean() / 1e6 << ", \"latency_p99_ms\": " << r.latency.percentile(0.99) / 1e6
+                << ", \"startups\": " << r.startups << ", \"progress_events\": " << r.progressEvents
+                << ", \"ordered\": " << (r.ordered ? "true" : "false")
+                << " }" << (i + 1 < daemonResults.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+
+    void WriteBenchmarkSummary(std::ostream& out, const std::vector<BenchmarkResult>& results, const std::vector<AudioBenchmarkResult>& audioResults,
+        const std::vector<IoBenchmarkResult>& ioResults, const std::vector<ReadBenchmarkResult>& readResults,
+        const std::vector<TraceBenchmarkResult>& traceResults, const std::vector<HashBenchmarkResult>& hashResults,
+        const std::vector<ScaleBenchmarkResult>& scaleResults, const std::vector<ProfileCacheBenchmarkResult>& cacheResults,
+        const std::vector<DaemonBenchmarkResult>& daemonResults)
+    {
+        for (const BenchmarkResult& r : results)
+        {
+            out << r.config.width << "x" << r.config.height << " " << PixelFormatName(r.config.format)
+                << " frames=" << r.config.frameCount << " threads=" << r.config.threads
+                << " " << TestPatternName(r.config.pattern) << "@" << r.config.motion << " " << KernelDispatchName(r.config.kernels)
+                << (r.config.dedupHold > 0 ? " dedup=" + std::to_string(r.config.dedupHold) : std::string())
+                << ": " << r.framesPerSecond << " fps, " << r.megabytesPerSecond << " MB/s"
+                << (r.config.dedupHold > 0 ? ", " + std::to_string(r.framesDropped) + " dropped" : std::string())
+                << " (p99 us: generate " << r.generate.percentile(0.99) / 1000.0
+                << ", convert " << r.convert.percentile(0.99) / 1000.0
+                << ", copy " << r.copy.percentile(0.99) / 1000.0
+                << ", submit " << r.submit.percentile(0.99) / 1000.0 << ")\n";
+        }
+        for (const AudioBenchmarkResult& r : audioResults)
+        {
+            out << "audio " << AudioPatternName(r.config.pattern) << " " << r.config.sampleRate << " Hz x" << r.config.channels
+                << " " << SimdLevelName(r.config.level) << ": " << r.samplesPerSecond / 1e6 << " Msamples/s"
+                << (r.bitExact ? "" : " NOT BIT-EXACT")
+                << " (p99 us: render " << r.render.percentile(0.99) / 1000.0
+                << ", convert " << r.convert.percentile(0.99) / 1000.0
+                << ", interleave " << r.interleave.percentile(0.99) / 1000.0 << ")\n";
+        }
+        for (const IoBenchmarkResult& r : ioResults)
+        {
+            out << "io " << r.config.target << " " << r.config.writeSize << " B writes " << (r.config.coalesced ? "coalesced" : "direct")
+                << ": " << r.megabytesPerSecond << " MB/s, " << r.target.writeCalls << " target writes"
+                << (r.config.coalesced ? ", " + std::to_string(r.stalls) + " stalls" : std::string()) << "\n";
+        }
+        for (const ReadBenchmarkResult& r : readResults)
+        {
+            out << "read " << r.config.method << " " << r.config.width << "x" << r.config.height << " nv12 frames=" << r.config.frameCount
+                << ": " << r.megabytesPerSecond << " MB/s, "
+                << (r.config.method == "mmap" ? std::to_string(r.maps) + " maps" : std::to_string(r.readCalls) + " reads")
+                << " (p99 us: frame " << r.frame.percentile(0.99) / 1000.0 << ")\n";
+        }
+        for (const TraceBenchmarkResult& r : traceResults)
+        {
+            out << "trace " << (r.config.enabled ? "on" : "off") << " threads=" << r.config.threads << " scopes=" << r.config.scopes
+                << ": " << r.nanosecondsPerScope << " ns/scope, " << r.recorded << " recorded"
+                << (r.complete ? "" : " INCOMPLETE") << "\n";
+        }
+        for (const HashBenchmarkResult& r : hashResults)
+        {
+            out << "hash " << r.config.width << "x" << r.config.height << " " << PixelFormatName(r.config.format)
+                << " " << SimdLevelName(r.config.level) << ": " << r.megabytesPerSecond << " MB/s"
+                << (r.matchesScalar ? "" : " NOT MATCHING SCALAR") << "\n";
+        }
+        for (const ScaleBenchmarkResult& r : scaleResults)
+        {
+            out << "scale " << r.config.srcWidth << "x" << r.config.srcHeight << " to " << r.config.dstWidth << "x" << r.config.dstHeight
+                << " " << PixelFormatName(r.config.format) << " " << ScaleFilterName(r.config.filter)
+                << " " << SimdLevelName(r.config.level) << " threads=" << r.config.threads
+                << ": " << r.framesPerSecond << " fps, " << r.megabytesPerSecond << " MB/s, PSNR "
+                << r.psnrReference << " dB vs reference, " << r.psnrRoundTrip << " dB round trip"
+                << (r.matchesScalar ? "" : " NOT MATCHING SCALAR") << "\n";
+        }
+        for (const ProfileCacheBenchmarkResult& r : cacheResults)
+        {
+            out << "profile cache " << (r.config.cached ? "on" : "off") << " threads=" << r.config.threads << " lookups=" << r.config.lookups
+                << ": " << r.nanosecondsPerLookup << " ns/lookup"
+                << (r.config.cached ? ", " + std::to_string(r.stats.hits) + " hits, " + std::to_string(r.stats.misses) + " misses" : std::string())
+                << (r.consistent ? "" : " INCONSISTENT") << "\n";
+        }
+        for (const DaemonBenchmarkResult& r : daemonResults)
+        {
+            out << "daemon " << (r.config.resident ? "resident" : "per-job") << " sessions=" << r.config.sessions << " clients=" << r.config.clients
+                << " jobs=" << r.config.jobs << ": " << r.jobsPerSecond << " jobs/s, " << r.startups << " runner startups"
+                << " (latency ms: mean " << r.latency.getMean() / 1e6 << ", p99 " << r.latency.percentile(0.99) / 1e6 << ")"
+                << (r.ordered ? "" : " OUT OF ORDER") << "\n";
+        }
+    }
+
+}
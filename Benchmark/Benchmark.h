@@ -0,0 +1,331 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "AudioPattern.h"
+#include "ByteTarget.h"
+#include "FrameGeometry.h"
+#include "FrameScaler.h"
+#include "FrameView.h"
+#include "LatencyHistogram.h"
+#include "MappedFile.h"
+#include "ProfileCache.h"
+#include "TestPattern.h"
+
+namespace VideoCoding
+{
+
+    struct BenchmarkCase
+    {
+        uint32_t width;
+        uint32_t height;
+        PixelFormat format;
+        uint64_t frameCount;
+        size_t threads;         // producer threads, 0 runs everything inline
+        TestPatternKind pattern;
+        double motion;
+        KernelDispatch kernels; // generic kernels for every size, or specialized where available
+        double dedupHold;       // seconds a sample may grow by dropping repeats, 0 writes every frame
+    };
+
+    // Per-frame stages, timed separately:
+    //   generate - RGB32 test pattern into a scratch buffer
+    //   convert  - RGB32 -> NV12/I420 into the sink buffer
+    //   copy     - RGB32 scratch -> sink buffer when no conversion is needed
+    //   submit   - VideoSink::writeFrame
+    struct BenchmarkResult
+    {
+        BenchmarkCase config;
+        double seconds;
+        double framesPerSecond;
+        double megabytesPerSecond;  // sink-format bytes per second
+        uint64_t framesDropped;     // repeats folded into the frame before
+        LatencyHistogram generate;
+        LatencyHistogram convert;
+        LatencyHistogram copy;
+        LatencyHistogram submit;
+    };
+
+    struct AudioBenchmarkCase
+    {
+        AudioPatternKind pattern;
+        uint32_t sampleRate;
+        uint32_t channels;
+        uint64_t frameCount;    // per channel
+        SimdLevel level;
+    };
+
+    // Per-block stages of AudioPatternGenerator::render, timed separately:
+    //   render     - float signal, one plane per channel
+    //   convert    - float -> 16 bit with dither
+    //   interleave - 16-bit planes into a pooled block
+    struct AudioBenchmarkResult
+    {
+        AudioBenchmarkCase config;
+        double seconds;
+        double samplesPerSecond;    // over all channels
+        bool bitExact;              // every block matched the scalar path
+        LatencyHistogram render;
+        LatencyHistogram convert;
+        LatencyHistogram interleave;
+    };
+
+    struct IoBenchmarkCase
+    {
+        std::string target;     // "file" or "memory"
+        size_t writeSize;       // bytes per write from the "muxer"
+        uint64_t totalBytes;
+        bool coalesced;         // through CoalescingWriter, or straight to the target
+    };
+
+    struct IoBenchmarkResult
+    {
+        IoBenchmarkCase config;
+        double seconds;
+        double megabytesPerSecond;
+        ByteTargetStats target;     // writeCalls is the syscall count for files
+        uint64_t stalls;            // coalesced only, writes that waited for the I/O thread
+    };
+
+    struct ReadBenchmarkCase
+    {
+        std::string method;     // "mmap" (RawFrameReader) or "read" (fread into a buffer)
+        uint32_t width;
+        uint32_t height;
+        uint64_t frameCount;    // NV12 frames in the capture
+        size_t window;          // mapping window, mmap only
+    };
+
+    // Each frame ends up copied into a sink-sized buffer, as the encoder's
+    // input would be; "read" first copies it out of the file into its own.
+    struct ReadBenchmarkResult
+    {
+        ReadBenchmarkCase config;
+        double seconds;
+        double megabytesPerSecond;
+        uint64_t maps;              // mmap: windows mapped
+        uint64_t readCalls;         // read: unbuffered fread calls
+        LatencyHistogram frame;     // fetch and copy of one frame
+    };
+
+    struct TraceBenchmarkCase
+    {
+        size_t threads;
+        uint64_t scopes;        // TRACE_SCOPEs per thread
+        bool enabled;           // tracing on, or only the check that it is off
+    };
+
+    struct TraceBenchmarkResult
+    {
+        TraceBenchmarkCase config;
+        double seconds;
+        double nanosecondsPerScope;     // per thread, loop overhead included
+        uint64_t recorded;
+        bool complete;                  // every scope recorded when on, none when off
+    };
+
+    struct HashBenchmarkCase
+    {
+        uint32_t width;
+        uint32_t height;
+        PixelFormat format;
+        uint64_t frameCount;    // frames hashed, cycling through a few distinct ones
+        SimdLevel level;
+    };
+
+    struct HashBenchmarkResult
+    {
+        HashBenchmarkCase config;
+        double seconds;
+        double megabytesPerSecond;
+        bool matchesScalar;         // every frame hashed as SimdLevel::Scalar does
+    };
+
+    struct ScaleBenchmarkCase
+    {
+        uint32_t srcWidth;
+        uint32_t srcHeight;
+        uint32_t dstWidth;
+        uint32_t dstHeight;
+        PixelFormat format;
+        ScaleFilter filter;
+        SimdLevel level;
+        size_t threads;         // row bands scaled in parallel
+        uint64_t frameCount;
+    };
+
+    struct ScaleBenchmarkResult
+    {
+        ScaleBenchmarkCase config;
+        double seconds;
+        double framesPerSecond;
+        double megabytesPerSecond;  // source frames read
+        double psnrReference;       // against ScaleFrameReference, dB
+        double psnrRoundTrip;       // scaled back to the source size, against the source
+        bool matchesScalar;         // every frame scaled as SimdLevel::Scalar does
+    };
+
+    struct ProfileCacheBenchmarkCase
+    {
+        size_t threads;
+        uint64_t lookups;       // per thread, cycling through every transcode profile
+        bool cached;            // through a ProfileCache, or building every time
+    };
+
+    struct ProfileCacheBenchmarkResult
+    {
+        ProfileCacheBenchmarkCase config;
+        double seconds;
+        double nanosecondsPerLookup;    // per thread
+        ProfileCacheStats stats;
+        bool consistent;        // one build per profile, the right entry every time
+    };
+
+    struct DaemonBenchmarkCase
+    {
+        size_t sessions;        // daemon workers
+        size_t clients;         // connections submitting at once, one job at a time each
+        uint64_t jobs;          // over all clients
+        bool resident;          // one runner per worker, or a fresh one per job
+    };
+
+    struct DaemonBenchmarkResult
+    {
+        DaemonBenchmarkCase config;
+        double seconds;
+        double jobsPerSecond;
+        LatencyHistogram latency;   // submit to done, per job
+        uint64_t startups;      // runner startups paid
+        uint64_t progressEvents;
+        bool ordered;           // every job: accepted, rising progress to 100%, done
+    };
+
+    struct BenchmarkOptions
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> resolutions;
+        std::vector<PixelFormat> formats;
+        std::vector<uint64_t> frameCounts;
+        std::vector<size_t> threadCounts;
+        std::vector<TestPatternKind> patterns;
+        std::vector<double> motions;
+        std::vector<KernelDispatch> kernels;
+        std::vector<double> dedupHolds;
+        size_t queueDepth;
+        std::vector<AudioPatternKind> audioPatterns;    // empty skips the audio cases
+        std::vector<uint32_t> audioRates;
+        double audioSeconds;
+        std::vector<std::string> ioTargets;             // empty skips the I/O cases
+        std::vector<size_t> ioWriteSizes;
+        double ioMegabytes;
+        std::string ioPath;         // scratch file for the "file" target
+        std::vector<std::string> readMethods;           // empty skips the read cases
+        double readMegabytes;
+        size_t readWindow;
+        std::string readPath;       // scratch capture, written first and removed after
+        uint64_t hashFrames;        // 0 skips the frame hash cases
+        std::vector<ScaleFilter> scaleFilters;          // empty skips the scale cases
+        std::vector<std::pair<uint32_t, uint32_t>> scaleSizes;
+        std::vector<size_t> scaleThreads;
+        uint64_t scaleFrames;
+        uint64_t traceScopes;       // 0 skips the trace overhead cases
+        uint64_t profileCacheLookups;   // 0 skips the profile cache cases
+        uint64_t daemonJobs;        // 0 skips the encode daemon cases
+        double daemonStartupMs;     // simulated runner startup
+        std::string daemonPath;     // socket the daemon listens on, removed after
+        std::string tracePath;      // timeline of the other cases, empty for none
+        double profileSeconds;      // media per profile sweep point, 0 skips the sweep
+        std::string profileGrid;    // see ParseProfileGrid
+        std::string profileBaseline;    // CSV of an earlier sweep, empty for none
+        std::string profileCsv;     // where to write this sweep's CSV, empty for none
+        double profileTolerance;
+        std::string output;         // "null", or a file written by RawVideoSink
+        std::string jsonPath;       // empty writes JSON to stdout
+    };
+
+    BenchmarkOptions DefaultBenchmarkOptions();
+
+    // Throws std::invalid_argument on malformed arguments.
+    BenchmarkOptions ParseBenchmarkOptions(int argc, char* argv[]);
+
+    BenchmarkResult RunBenchmarkCase(const BenchmarkCase& benchmarkCase, const BenchmarkOptions& options);
+
+    std::vector<BenchmarkResult> RunBenchmarkSweep(const BenchmarkOptions& options);
+
+    AudioBenchmarkResult RunAudioBenchmarkCase(const AudioBenchmarkCase& benchmarkCase);
+
+    // Every audio pattern and rate, in stereo, at every SimdLevel the CPU has.
+    std::vector<AudioBenchmarkResult> RunAudioBenchmarkSweep(const BenchmarkOptions& options);
+
+    IoBenchmarkResult RunIoBenchmarkCase(const IoBenchmarkCase& benchmarkCase, const BenchmarkOptions& options);
+
+    // Every target and write size, direct and coalesced.
+    std::vector<IoBenchmarkResult> RunIoBenchmarkSweep(const BenchmarkOptions& options);
+
+    ReadBenchmarkResult RunReadBenchmarkCase(const ReadBenchmarkCase& benchmarkCase, const BenchmarkOptions& options);
+
+    // Writes a 1080p NV12 capture of about readMegabytes and reads it back
+    // with every method. It has just been written, so the page cache is warm:
+    // this measures the cost of getting frames out of the cache, not disk.
+    std::vector<ReadBenchmarkResult> RunReadBenchmarkSweep(const BenchmarkOptions& options);
+
+    HashBenchmarkResult RunHashBenchmarkCase(const HashBenchmarkCase& benchmarkCase);
+
+    // Every resolution and format of the main sweep, at every SimdLevel the
+    // CPU has.
+    std::vector<HashBenchmarkResult> RunHashBenchmarkSweep(const BenchmarkOptions& options);
+
+    ScaleBenchmarkResult RunScaleBenchmarkCase(const ScaleBenchmarkCase& benchmarkCase, const BenchmarkOptions& options);
+
+    // Every resolution of the main sweep in NV12 and I420, to every scale
+    // size, with every filter, at every SimdLevel the CPU has.
+    std::vector<ScaleBenchmarkResult> RunScaleBenchmarkSweep(const BenchmarkOptions& options);
+
+    ProfileCacheBenchmarkResult RunProfileCacheBenchmarkCase(const ProfileCacheBenchmarkCase& benchmarkCase);
+
+    // One and four threads, with and without the cache. The objects are
+    // DescribeProfile() strings standing in for Media Foundation's, so this
+    // measures the lookup and its locking rather than what a miss saves.
+    std::vector<ProfileCacheBenchmarkResult> RunProfileCacheBenchmarkSweep(const BenchmarkOptions& options);
+
+    DaemonBenchmarkResult RunDaemonBenchmarkCase(const DaemonBenchmarkCase& benchmarkCase, const BenchmarkOptions& options);
+
+    // An EncodeDaemon served over a local socket to several clients, with
+    // SyntheticTranscodeRunner for the encoder and a sleep standing in for
+    // its startup. One and two sessions, with runners kept for the daemon's
+    // lifetime or started for every job.
+    std::vector<DaemonBenchmarkResult> RunDaemonBenchmarkSweep(const BenchmarkOptions& options);
+
+    TraceBenchmarkResult RunTraceBenchmarkCase(const TraceBenchmarkCase& benchmarkCase);
+
+    // One and four threads, with tracing off and on. Restarts tracing, so
+    // run it after anything being traced has been written out.
+    std::vector<TraceBenchmarkResult> RunTraceBenchmarkSweep(const BenchmarkOptions& options);
+
+    // The encoder profile sweep with SyntheticTranscodeRunner, see
+    // RunProfileSweep. Writes the summary to `out` and the CSV where
+    // profileCsv says; returns the regressions against profileBaseline.
+    size_t RunProfileSweepBenchmark(const BenchmarkOptions& options, std::ostream& out);
+
+    void WriteBenchmarkJson(std::ostream& out, const std::vector<BenchmarkResult>& results,
+        const std::vector<AudioBenchmarkResult>& audioResults = std::vector<AudioBenchmarkResult>(),
+        const std::vector<IoBenchmarkResult>& ioResults = std::vector<IoBenchmarkResult>(),
+        const std::vector<ReadBenchmarkResult>& readResults = std::vector<ReadBenchmarkResult>(),
+        const std::vector<TraceBenchmarkResult>& traceResults = std::vector<TraceBenchmarkResult>(),
+        const std::vector<HashBenchmarkResult>& hashResults = std::vector<HashBenchmarkResult>(),
+        const std::vector<ScaleBenchmarkResult>& scaleResults = std::vector<ScaleBenchmarkResult>(),
+        const std::vector<ProfileCacheBenchmarkResult>& cacheResults = std::vector<ProfileCacheBenchmarkResult>(),
+        const std::vector<DaemonBenchmarkResult>& daemonResults = std::vector<DaemonBenchmarkResult>());
+    void WriteBenchmarkSummary(std::ostream& out, const std::vector<BenchmarkResult>& results,
+        const std::vector<AudioBenchmarkResult>& audioResults = std::vector<AudioBenchmarkResult>(),
+        const std::vector<IoBenchmarkResult>& ioResults = std::vector<IoBenchmarkResult>(),
+        const std::vector<ReadBenchmarkResult>& readResults = std::vector<ReadBenchmarkResult>(),
+        const std::vector<TraceBenchmarkResult>& traceResults = std::vector<TraceBenchmarkResult>(),
+        const std::vector<HashBenchmarkResult>& hashResults = std::vector<HashBenchmarkResult>(),
+        const std::vector<ScaleBenchmarkResult>& scaleResults = std::vector<ScaleBenchmarkResult>(),
+        const std::vector<ProfileCacheBenchmarkResult>& cacheResults = std::vector<ProfileCacheBenchmarkResult>(),
+        const std::vector<DaemonBenchmarkResult>& daemonResults = std::vector<DaemonBenchmarkResult>());
+
+}
@@ -0,0 +1,90 @@
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "Benchmark.h"
+#include "Tracer.h"
+
+// Usage: Benchmark [--resolutions 640x480,1920x1080|none] [--formats nv12,i420,rgb32]
+//                  [--frames 300] [--threads 0,2,4] [--queue-depth 8]
+//                  [--patterns bars,gradient,boxes,text,noise] [--motion 0,0.25,1]
+//                  [--kernels specialized,generic] [--dedup 0,1] [--hash-frames 1000]
+//                  [--scale bilinear,bicubic,area [--scale-sizes 176x144,352x288,720x576]
+//                   [--scale-threads 1,2] [--scale-frames 100]]
+//                  [--audio tone,sweep,noise] [--audio-rates 44100,48000,96000] [--audio-seconds 10]
+//                  [--io file,memory] [--io-sizes 188,4096,65536] [--io-mb 256] [--io-path FILE]
+//                  [--read mmap,read] [--read-mb 512] [--read-window 64] [--read-path FILE]
+//                  [--trace-scopes 1000000] [--trace FILE] [--profile-cache 1000000]
+//                  [--daemon-jobs 40 [--daemon-startup-ms 50] [--daemon-path FILE]]
+//                  [--profile-sweep SECONDS [--profile-grid *:*] [--profile-csv FILE]
+//                   [--profile-baseline FILE [--profile-tolerance 0.1]]]
+//                  [--output null|FILE] [--json FILE]
+//
+// --dedup runs each case again per hold (seconds, 0 for none) with repeated
+// frames dropped, see FrameWriterSettings; use it with --motion 0 for
+// content that holds still. --hash-frames times the frame hash behind it at
+// every SIMD level.
+// --scale times FrameScaler from every resolution to every scale size, at
+// every SIMD level, and reports PSNR against the double precision reference
+// and after scaling back up to the source size.
+// --profile-cache times lookups in the transcode profile cache, on one and
+// four threads, against building every time, and checks each profile was
+// built once.
+// --daemon-jobs submits that many jobs to an encode daemon over a Unix
+// socket from four clients, with runners that sleep --daemon-startup-ms to
+// start and then encode synthetically, kept per worker or started per job.
+// It checks each job's events arrive in order; the startup is simulated, so
+// the gap between the two shows what amortizing it is worth at that cost.
+// The profile sweep runs the encoder profile tables through
+// SyntheticTranscodeRunner, so it works without Media Foundation; its
+// summary goes to stderr and regressions against the baseline make the exit
+// status 1. SinkWriter --profile-sweep does the same with the real encoder.
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const VideoCoding::BenchmarkOptions options = VideoCoding::ParseBenchmarkOptions(argc, argv);
+        if (!options.tracePath.empty())
+        {
+            VideoCoding::StartTracing();
+            VideoCoding::SetTraceThreadName("main");
+        }
+        const std::vector<VideoCoding::BenchmarkResult> results = VideoCoding::RunBenchmarkSweep(options);
+        const std::vector<VideoCoding::AudioBenchmarkResult> audioResults = VideoCoding::RunAudioBenchmarkSweep(options);
+        const std::vector<VideoCoding::IoBenchmarkResult> ioResults = VideoCoding::RunIoBenchmarkSweep(options);
+        const std::vector<VideoCoding::ReadBenchmarkResult> readResults = VideoCoding::RunReadBenchmarkSweep(options);
+        if (!options.tracePath.empty())
+        {
+            VideoCoding::StopTracing();
+            std::ofstream trace(options.tracePath);
+            VideoCoding::WriteChromeTrace(trace);
+        }
+        const std::vector<VideoCoding::HashBenchmarkResult> hashResults = VideoCoding::RunHashBenchmarkSweep(options);
+        const std::vector<VideoCoding::ScaleBenchmarkResult> scaleResults = VideoCoding::RunScaleBenchmarkSweep(options);
+        const std::vector<VideoCoding::ProfileCacheBenchmarkResult> cacheResults = VideoCoding::RunProfileCacheBenchmarkSweep(options);
+        const std::vector<VideoCoding::DaemonBenchmarkResult> daemonResults = VideoCoding::RunDaemonBenchmarkSweep(options);
+        const std::vector<VideoCoding::TraceBenchmarkResult> traceResults = VideoCoding::RunTraceBenchmarkSweep(options);
+        const size_t regressions = VideoCoding::RunProfileSweepBenchmark(options, std::cerr);
+
+        VideoCoding::WriteBenchmarkSummary(std::cerr, results, audioResults, ioResults, readResults, traceResults, hashResults, scaleResults, cacheResults, daemonResults);
+        if (options.jsonPath.empty())
+        {
+            VideoCoding::WriteBenchmarkJson(std::cout, results, audioResults, ioResults, readResults, traceResults, hashResults, scaleResults, cacheResults, daemonResults);
+        }
+        else
+        {
+            std::ofstream json(options.jsonPath);
+            VideoCoding::WriteBenchmarkJson(json, results, audioResults, ioResults, readResults, traceResults, hashResults, scaleResults, cacheResults, daemonResults);
+        }
+        if (regressions > 0)
+        {
+            return 1;
+        }
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << "Benchmark failed - " << err.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "AudioPattern.h"
+#include "TestFrames.h"
+#include "TestHarness.h"
+#include "TestPattern.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    const AudioPatternKind KINDS[] = { AudioPatternKind::Tone, AudioPatternKind::Sweep, AudioPatternKind::Noise };
+
+    std::vector<int16_t> Render(AudioPatternGenerator& generator, uint64_t firstFrame, uint32_t frames)
+    {
+        std::vector<int16_t> samples(static_cast<size_t>(frames) * generator.getChannels());
+        generator.render(samples.data(), firstFrame, frames);
+        return samples;
+    }
+
+    int Convert(float sample)
+    {
+        int16_t value = 0;
+        FloatToInt16(SimdLevel::Scalar, &sample, &value, 1, false, 0);
+        return value;
+    }
+}
+
+TEST_CASE(FloatToInt16RoundsAndSaturates)
+{
+    CHECK_EQUAL(0, Convert(0.0f));
+    CHECK_EQUAL(32767, Convert(1.0f));
+    CHECK_EQUAL(-32767, Convert(-1.0f));
+    CHECK_EQUAL(32767, Convert(3.0f));
+    CHECK_EQUAL(-32768, Convert(-3.0f));
+    CHECK_EQUAL(1, Convert(0.6f / 32767.0f));
+    CHECK_EQUAL(0, Convert(0.4f / 32767.0f));
+    CHECK_EQUAL(-1, Convert(-0.6f / 32767.0f));
+    CHECK_EQUAL(-32768, Convert(std::numeric_limits<float>::quiet_NaN()));
+}
+
+TEST_CASE(FloatToInt16MatchesScalarAtEverySimdLevel)
+{
+    // Noise over twice full scale plus the edge values, at lengths that end
+    // inside and after every vector width and dither chunk.
+    std::vector<float> src(1100);
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+        src[i] = static_cast<float>(static_cast<int32_t>(PatternHash(static_cast<uint32_t>(i))) / 1073741824.0);
+    }
+    const float edges[] = { 1.0f, -1.0f, 0.0f, -0.0f, 1.5f / 32767.0f, -0.5f / 32767.0f, std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i)
+    {
+        src[i * 3] = edges[i];
+    }
+
+    for (size_t count : { 0u, 1u, 7u, 8u, 15u, 17u, 33u, 256u, 263u, 1100u })
+    {
+        for (bool dither : { false, true })
+        {
+            std::vector<int16_t> expected(count);
+            FloatToInt16(SimdLevel::Scalar, src.data(), expected.data(), count, dither, 99);
+            for (SimdLevel level : SupportedSimdLevels())
+            {
+                std::vector<int16_t> actual(count + 1, 0x5555);
+                FloatToInt16(level, src.data(), actual.data(), count, dither, 99);
+                CHECK(std::equal(expected.begin(), expected.end(), actual.begin()));
+                CHECK_EQUAL(0x5555, static_cast<int>(actual[count]));
+            }
+        }
+    }
+}
+
+TEST_CASE(InterleaveInt16RoundTripsAtEverySimdLevel)
+{
+    for (uint32_t channels : { 1u, 2u, 3u, 6u })
+    {
+        for (size_t frames : { 0u, 5u, 8u, 16u, 37u, 1000u })
+        {
+            std::vector<std::vector<int16_t>> planes(channels, std::vector<int16_t>(frames));
+            std::vector<const int16_t*> sources;
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+                for (size_t i = 0; i < frames; ++i)
+                {
+                    planes[c][i] = static_cast<int16_t>(PatternHash(c * 100000 + static_cast<uint32_t>(i)));
+                }
+                sources.push_back(planes[c].data());
+            }
+            for (SimdLevel level : SupportedSimdLevels())
+            {
+                std::vector<int16_t> interleaved(frames * channels);
+                InterleaveInt16(level, sources.data(), channels, frames, interleaved.data());
+                for (size_t i = 0; i < frames; ++i)
+                {
+                    for (uint32_t c = 0; c < channels; ++c)
+                    {
+                        CHECK_EQUAL(planes[c][i], interleaved[i * channels + c]);
+                    }
+                }
+
+                std::vector<std::vector<int16_t>> back(channels, std::vector<int16_t>(frames));
+                std::vector<int16_t*> targets;
+                for (uint32_t c = 0; c < channels; ++c)
+                {
+                    targets.push_back(back[c].data());
+                }
+                DeinterleaveInt16(level, interleaved.data(), channels, frames, targets.data());
+                CHECK(back == planes);
+            }
+        }
+    }
+}
+
+TEST_CASE(AudioPatternIsIdenticalAtEverySimdLevel)
+{
+    for (AudioPatternKind kind : KINDS)
+    {
+        AudioPatternSettings settings = DefaultAudioPatternSettings(kind);
+        settings.dither = true;
+        for (uint32_t channels : { 1u, 2u, 6u })
+        {
+            AudioPatternGenerator reference(settings, 48000, channels, SimdLevel::Scalar);
+            const std::vector<int16_t> expected = Render(reference, 12345, 1001);
+            for (SimdLevel level : SupportedSimdLevels())
+            {
+                AudioPatternGenerator generator(settings, 48000, channels, level);
+                CHECK(expected == Render(generator, 12345, 1001));
+            }
+        }
+    }
+}
+
+TEST_CASE(AudioPatternDoesNotDependOnBlockSize)
+{
+    for (AudioPatternKind kind : KINDS)
+    {
+        AudioPatternSettings settings = DefaultAudioPatternSettings(kind);
+        settings.dither = true;
+        AudioPatternGenerator whole(settings, 44100, 2);
+        const std::vector<int16_t> expected = Render(whole, 0, 2000);
+
+        AudioPatternGenerator blocks(settings, 44100, 2);
+        std::vector<int16_t> actual;
+        for (uint32_t first = 0, size = 1; first < 2000; first += size, size = size * 3 % 511 + 1)
+        {
+            const uint32_t frames = std::min(size, 2000 - first);
+            const std::vector<int16_t> block = Render(blocks, first, frames);
+            actual.insert(actual.end(), block.begin(), block.end());
+        }
+        CHECK(expected == actual);
+    }
+}
+
+TEST_CASE(AudioPatternRenderIsRenderFloatConvertedAndInterleaved)
+{
+    for (AudioPatternKind kind : KINDS)
+    {
+        AudioPatternSettings settings = DefaultAudioPatternSettings(kind);
+        settings.dither = kind != AudioPatternKind::Tone;
+        for (SimdLevel level : SupportedSimdLevels())
+        {
+            AudioPatternGenerator generator(settings, 96000, 2, level);
+            const std::vector<int16_t> rendered = Render(generator, 777, 300);
+
+            std::vector<float> left(300);
+            std::vector<float> right(300);
+            float* floats[] = { left.data(), right.data() };
+            generator.renderFloat(floats, 777, 300);
+            std::vector<int16_t> leftInt(300);
+            std::vector<int16_t> rightInt(300);
+            FloatToInt16(SimdLevel::Scalar, left.data(), leftInt.data(), 300, settings.dither, generator.ditherKey(0, 777));
+            FloatToInt16(SimdLevel::Scalar, right.data(), rightInt.data(), 300, settings.dither, generator.ditherKey(1, 777));
+            const int16_t* planes[] = { leftInt.data(), rightInt.data() };
+            std::vector<int16_t> expected(600);
+            InterleaveInt16(SimdLevel::Scalar, planes, 2, 300, expected.data());
+            CHECK(expected == rendered);
+        }
+    }
+}
+
+TEST_CASE(AudioPatternRejectsUnusableSettings)
+{
+    for (AudioPatternKind kind : KINDS)
+    {
+        AudioPatternKind parsed = AudioPatternKind::Tone;
+        CHECK(ParseAudioPattern(AudioPatternName(kind), parsed));
+        CHECK(parsed == kind);
+    }
+    AudioPatternKind untouched = AudioPatternKind::Sweep;
+    CHECK(!ParseAudioPattern("hum", untouched));
+    CHECK(untouched == AudioPatternKind::Sweep);
+
+    const AudioPatternSettings tone = DefaultAudioPatternSettings(AudioPatternKind::Tone);
+    CHECK_THROWS(AudioPatternGenerator(tone, 0, 2), std::invalid_argument);
+    CHECK_THROWS(AudioPatternGenerator(tone, 48000, 0), std::invalid_argument);
+    AudioPatternSettings silent = tone;
+    silent.frequency = 0.0;
+    CHECK_THROWS(AudioPatternGenerator(silent, 48000, 2), std::invalid_argument);
+
+    AudioPatternGenerator wide(tone, 48000, 9);
+    std::vector<int16_t> samples(9 * 16);
+    CHECK_THROWS(wide.render(samples.data(), 0, 16), std::invalid_argument);
+}
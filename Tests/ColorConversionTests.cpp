@@ -0,0 +1,169 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "ColorConversion.h"
+#include "MemoryFrameBuffer.h"
+#include "TestFrames.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    struct Yuv
+    {
+        int y, u, v;
+    };
+
+    // A flat 2x2 RGB32 block through the scalar kernel.
+    Yuv ConvertColor(uint32_t bgrx, ColorMatrix matrix, ColorRange range, PixelFormat format)
+    {
+        MemoryFrameBuffer rgb(2, 2, PixelFormat::RGB32);
+        for (uint32_t y = 0; y < 2; ++y)
+        {
+            std::memcpy(rgb.view().row(y), &bgrx, 4);
+            std::memcpy(rgb.view().row(y) + 4, &bgrx, 4);
+        }
+        MemoryFrameBuffer yuv(2, 2, format);
+        ConvertRGB32Rows(SimdLevel::Scalar, ComputeColorCoefficients(matrix, range), rgb.view(), yuv.view(), 0, 2);
+
+        const FrameView view = yuv.view();
+        for (uint32_t y = 0; y < 2; ++y)
+        {
+            CHECK_EQUAL(static_cast<int>(view.row(y)[0]), static_cast<int>(view.row(y)[1]));
+        }
+        CHECK_EQUAL(static_cast<int>(view.row(0)[0]), static_cast<int>(view.row(1)[0]));
+        const Yuv result = { view.row(0)[0], view.plane(1)[0], format == PixelFormat::NV12 ? view.plane(1)[1] : view.plane(2)[0] };
+        return result;
+    }
+
+    void CheckColor(uint32_t bgrx, ColorMatrix matrix, ColorRange range, int y, int u, int v)
+    {
+        for (PixelFormat format : { PixelFormat::NV12, PixelFormat::I420 })
+        {
+            const Yuv yuv = ConvertColor(bgrx, matrix, range, format);
+            CHECK_EQUAL(y, yuv.y);
+            CHECK_EQUAL(u, yuv.u);
+            CHECK_EQUAL(v, yuv.v);
+        }
+    }
+
+    const ColorMatrix MATRICES[] = { ColorMatrix::BT601, ColorMatrix::BT709 };
+    const ColorRange RANGES[] = { ColorRange::Limited, ColorRange::Full };
+}
+
+TEST_CASE(ColorConversionMapsReferenceColors)
+{
+    // Grey levels keep the chroma at 128 in every matrix.
+    for (ColorMatrix matrix : MATRICES)
+    {
+        CheckColor(0x00000000, matrix, ColorRange::Limited, 16, 128, 128);
+        CheckColor(0x00FFFFFF, matrix, ColorRange::Limited, 235, 128, 128);
+        CheckColor(0x00000000, matrix, ColorRange::Full, 0, 128, 128);
+        CheckColor(0x00FFFFFF, matrix, ColorRange::Full, 255, 128, 128);
+        CheckColor(0x00808080, matrix, ColorRange::Full, 128, 128, 128);
+    }
+
+    // Primaries, from the BT.601 and BT.709 equations rounded to nearest.
+    CheckColor(0x00FF0000, ColorMatrix::BT601, ColorRange::Limited, 81, 90, 240);
+    CheckColor(0x0000FF00, ColorMatrix::BT601, ColorRange::Limited, 145, 54, 34);
+    CheckColor(0x000000FF, ColorMatrix::BT601, ColorRange::Limited, 41, 240, 110);
+    CheckColor(0x00FF0000, ColorMatrix::BT709, ColorRange::Limited, 63, 102, 240);
+    CheckColor(0x0000FF00, ColorMatrix::BT709, ColorRange::Limited, 173, 42, 26);
+    CheckColor(0x000000FF, ColorMatrix::BT709, ColorRange::Limited, 32, 240, 118);
+}
+
+TEST_CASE(ColorConversionMatchesScalarAtEverySimdLevel)
+{
+    // Widths that leave a tail after every vector width.
+    const uint32_t sizes[][2] = { { 2, 2 }, { 34, 6 }, { 70, 10 }, { 130, 4 }, { 1922, 2 } };
+    for (const auto& size : sizes)
+    {
+        MemoryFrameBuffer rgb(size[0], size[1], PixelFormat::RGB32);
+        FillFrameNoise(rgb.view(), size[0] * 7 + size[1]);
+        for (PixelFormat format : { PixelFormat::NV12, PixelFormat::I420 })
+        {
+            for (ColorMatrix matrix : MATRICES)
+            {
+                for (ColorRange range : RANGES)
+                {
+                    const ColorCoefficients coefficients = ComputeColorCoefficients(matrix, range);
+                    MemoryFrameBuffer expected(size[0], size[1], format);
+                    ConvertRGB32Rows(SimdLevel::Scalar, coefficients, rgb.view(), expected.view(), 0, size[1]);
+                    for (SimdLevel level : SupportedSimdLevels())
+                    {
+                        MemoryFrameBuffer actual(size[0], size[1], format);
+                        ConvertRGB32Rows(level, coefficients, rgb.view(), actual.view(), 0, size[1]);
+                        CHECK(SameFrameBytes(expected.view(), actual.view()));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE(ColorConverterRowBandsMatchASingleThread)
+{
+    MemoryFrameBuffer rgb(96, 38, PixelFormat::RGB32);
+    FillFrameNoise(rgb.view(), 11);
+    for (PixelFormat format : { PixelFormat::NV12, PixelFormat::I420 })
+    {
+        MemoryFrameBuffer expected(96, 38, format);
+        ColorConverter(ColorMatrix::BT709, ColorRange::Limited, 1, SimdLevel::Scalar).convert(rgb.view(), expected.view());
+        for (size_t threads : { 2, 3, 8 })
+        {
+            MemoryFrameBuffer actual(96, 38, format);
+            ColorConverter(ColorMatrix::BT709, ColorRange::Limited, threads).convert(rgb.view(), actual.view());
+            CHECK(SameFrameBytes(expected.view(), actual.view()));
+        }
+    }
+}
+
+TEST_CASE(ColorConverterConvertRowsTouchesOnlyThoseRows)
+{
+    MemoryFrameBuffer rgb(16, 8, PixelFormat::RGB32);
+    FillFrameNoise(rgb.view(), 5);
+    ColorConverter converter(ColorMatrix::BT601, ColorRange::Full);
+    MemoryFrameBuffer full(16, 8, PixelFormat::I420);
+    converter.convert(rgb.view(), full.view());
+
+    MemoryFrameBuffer part(16, 8, PixelFormat::I420);
+    std::memset(part.view().data, 0xAA, part.size());
+    converter.convertRows(rgb.view(), part.view(), 2, 6);
+    const FrameView a = full.view();
+    const FrameView b = part.view();
+    for (uint32_t y = 0; y < 8; ++y)
+    {
+        const bool inside = y >= 2 && y < 6;
+        CHECK_EQUAL(inside, std::memcmp(a.row(y), b.row(y), 16) == 0);
+        CHECK_EQUAL(!inside, b.row(y)[0] == 0xAA && b.row(y)[15] == 0xAA);
+    }
+    for (unsigned plane = 1; plane <= 2; ++plane)
+    {
+        for (uint32_t y = 0; y < 4; ++y)
+        {
+            const bool inside = y >= 1 && y < 3;
+            const ptrdiff_t offset = a.planeStride(plane) * static_cast<ptrdiff_t>(y);
+            CHECK_EQUAL(inside, std::memcmp(a.plane(plane) + offset, b.plane(plane) + offset, 8) == 0);
+        }
+    }
+}
+
+TEST_CASE(ColorConverterRejectsUnusableFrames)
+{
+    ColorConverter converter(ColorMatrix::BT709, ColorRange::Limited);
+    MemoryFrameBuffer rgb(8, 4, PixelFormat::RGB32);
+    MemoryFrameBuffer nv12(8, 4, PixelFormat::NV12);
+    MemoryFrameBuffer smaller(8, 2, PixelFormat::NV12);
+    MemoryFrameBuffer odd(7, 4, PixelFormat::RGB32);
+    MemoryFrameBuffer oddNv12(7, 4, PixelFormat::NV12);
+    CHECK_THROWS(converter.convert(nv12.view(), nv12.view()), std::invalid_argument);
+    CHECK_THROWS(converter.convert(rgb.view(), rgb.view()), std::invalid_argument);
+    CHECK_THROWS(converter.convert(rgb.view(), smaller.view()), std::invalid_argument);
+    CHECK_THROWS(converter.convert(odd.view(), oddNv12.view()), std::invalid_argument);
+    CHECK_THROWS(converter.convertRows(rgb.view(), nv12.view(), 1, 3), std::invalid_argument);
+    CHECK_THROWS(converter.convertRows(rgb.view(), nv12.view(), 2, 6), std::invalid_argument);
+    CHECK_THROWS(converter.convertRows(rgb.view(), nv12.view(), 4, 2), std::invalid_argument);
+}
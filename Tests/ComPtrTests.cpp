@@ -0,0 +1,199 @@
+#include <utility>
+
+#include "ComPtr.h"
+#include "TestHarness.h"
+
+using IMFWrappers::ComPtr;
+
+namespace
+{
+    // Counts calls instead of freeing anything; `references` starts at the
+    // one reference whoever created the object holds.
+    struct MockUnknown
+    {
+        MockUnknown() : references(1), addRefs(0), releases(0) {}
+        virtual ~MockUnknown() {}
+
+        unsigned long AddRef() { ++addRefs; return ++references; }
+        unsigned long Release() { ++releases; return --references; }
+
+        unsigned long references;
+        unsigned addRefs;
+        unsigned releases;
+    };
+
+    struct MockDerived : MockUnknown
+    {
+    };
+
+    // Takes a reference of its own for the caller, like a COM out parameter.
+    void GetObject(MockUnknown& object, MockUnknown** out)
+    {
+        object.AddRef();
+        *out = &object;
+    }
+}
+
+TEST_CASE(ComPtrAdoptTakesTheCallersReference)
+{
+    MockUnknown object;
+    {
+        ComPtr<MockUnknown> p = ComPtr<MockUnknown>::adopt(&object);
+        CHECK(p.get() == &object);
+        CHECK_EQUAL(0u, object.addRefs);
+        CHECK_EQUAL(0u, object.releases);
+    }
+    CHECK_EQUAL(0u, object.addRefs);
+    CHECK_EQUAL(1u, object.releases);
+    CHECK_EQUAL(0ul, object.references);
+}
+
+TEST_CASE(ComPtrShareAddsItsOwnReference)
+{
+    MockUnknown object;
+    {
+        ComPtr<MockUnknown> p = ComPtr<MockUnknown>::share(&object);
+        CHECK_EQUAL(1u, object.addRefs);
+        CHECK_EQUAL(2ul, object.references);
+    }
+    CHECK_EQUAL(1u, object.releases);
+    CHECK_EQUAL(1ul, object.references);
+
+    ComPtr<MockUnknown> empty = ComPtr<MockUnknown>::share(nullptr);
+    CHECK(!empty);
+}
+
+TEST_CASE(ComPtrCopyIsASecondOwner)
+{
+    MockUnknown object;
+    {
+        ComPtr<MockUnknown> a = ComPtr<MockUnknown>::adopt(&object);
+        {
+            ComPtr<MockUnknown> b = a.copy();
+            CHECK(a == b);
+            CHECK_EQUAL(1u, object.addRefs);
+            CHECK_EQUAL(2ul, object.references);
+        }
+        CHECK_EQUAL(1u, object.releases);
+        CHECK(a.get() == &object);
+    }
+    CHECK_EQUAL(1u, object.addRefs);
+    CHECK_EQUAL(2u, object.releases);
+    CHECK_EQUAL(0ul, object.references);
+
+    ComPtr<MockUnknown> empty;
+    CHECK(!empty.copy());
+}
+
+TEST_CASE(ComPtrReceiveKeepsTheOutParametersReference)
+{
+    MockUnknown object;
+    {
+        ComPtr<MockUnknown> p;
+        GetObject(object, p.receive());
+        CHECK(p.get() == &object);
+        CHECK_EQUAL(1u, object.addRefs);
+        CHECK_EQUAL(0u, object.releases);
+    }
+    CHECK_EQUAL(1u, object.releases);
+    CHECK_EQUAL(1ul, object.references);
+}
+
+TEST_CASE(ComPtrReceiveReleasesWhatItHeld)
+{
+    MockUnknown first;
+    MockUnknown second;
+    {
+        ComPtr<MockUnknown> p = ComPtr<MockUnknown>::adopt(&first);
+        GetObject(second, p.receive());
+        CHECK_EQUAL(1u, first.releases);
+        CHECK_EQUAL(0ul, first.references);
+        CHECK(p.get() == &second);
+        CHECK_EQUAL(0u, second.releases);
+    }
+    CHECK_EQUAL(1u, first.releases);
+    CHECK_EQUAL(1u, second.releases);
+    CHECK_EQUAL(1ul, second.references);
+}
+
+TEST_CASE(ComPtrDetachHandsBackTheReference)
+{
+    MockUnknown object;
+    MockUnknown* raw = nullptr;
+    {
+        ComPtr<MockUnknown> p = ComPtr<MockUnknown>::share(&object);
+        raw = p.detach();
+        CHECK(!p);
+    }
+    CHECK(raw == &object);
+    CHECK_EQUAL(1u, object.addRefs);
+    CHECK_EQUAL(0u, object.releases);
+    CHECK_EQUAL(2ul, object.references);
+}
+
+TEST_CASE(ComPtrMoveTransfersWithoutCounting)
+{
+    MockUnknown object;
+    MockUnknown other;
+    {
+        ComPtr<MockUnknown> a = ComPtr<MockUnknown>::adopt(&object);
+        ComPtr<MockUnknown> b(std::move(a));
+        CHECK(!a);
+        CHECK(b.get() == &object);
+
+        // Assigning over a held object releases it once.
+        ComPtr<MockUnknown> c = ComPtr<MockUnknown>::adopt(&other);
+        c = std::move(b);
+        CHECK(!b);
+        CHECK(c.get() == &object);
+        CHECK_EQUAL(1u, other.releases);
+        CHECK_EQUAL(0u, object.releases);
+    }
+    CHECK_EQUAL(0u, object.addRefs);
+    CHECK_EQUAL(1u, object.releases);
+    CHECK_EQUAL(0u, other.addRefs);
+    CHECK_EQUAL(1u, other.releases);
+}
+
+TEST_CASE(ComPtrSelfMoveKeepsTheObject)
+{
+    MockUnknown object;
+    {
+        ComPtr<MockUnknown> p = ComPtr<MockUnknown>::adopt(&object);
+        ComPtr<MockUnknown>& alias = p;
+        p = std::move(alias);
+        CHECK(p.get() == &object);
+        CHECK_EQUAL(0u, object.releases);
+    }
+    CHECK_EQUAL(0u, object.addRefs);
+    CHECK_EQUAL(1u, object.releases);
+}
+
+TEST_CASE(ComPtrMovesIntoABaseInterface)
+{
+    MockDerived object;
+    {
+        ComPtr<MockDerived> derived = ComPtr<MockDerived>::adopt(&object);
+        ComPtr<MockUnknown> base(std::move(derived));
+        CHECK(!derived);
+        CHECK(base.get() == &object);
+    }
+    CHECK_EQUAL(0u, object.addRefs);
+    CHECK_EQUAL(1u, object.releases);
+}
+
+TEST_CASE(ComPtrResetAndNullAssignmentReleaseOnce)
+{
+    MockUnknown object;
+    ComPtr<MockUnknown> p = ComPtr<MockUnknown>::adopt(&object);
+    p.reset();
+    p.reset();
+    CHECK_EQUAL(1u, object.releases);
+
+    object.references = 1;
+    p = ComPtr<MockUnknown>::adopt(&object);
+    p = nullptr;
+    p = nullptr;
+    CHECK_EQUAL(2u, object.releases);
+    CHECK_EQUAL(0ul, object.references);
+}
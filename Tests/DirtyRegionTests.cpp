@@ -0,0 +1,196 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "ColorConversion.h"
+#include "DirtyRegion.h"
+#include "MemoryFrameBuffer.h"
+#include "TestFrames.h"
+#include "TestHarness.h"
+#include "TestPattern.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    typedef DirtyRows::Range Range;
+
+    std::vector<Range> Ranges(std::initializer_list<Range> ranges)
+    {
+        return std::vector<Range>(ranges);
+    }
+
+    // Frame N is noise with row N % height rewritten, so exactly one row
+    // changes from one frame to the next.
+    class OneRowProducer : public DirtyFrameProducer
+    {
+    public:
+        OneRowProducer() : fullRenders(0) {}
+
+        void renderFull(const FrameView& frame, uint64_t frameIndex) override
+        {
+            ++fullRenders;
+            FillFrameNoise(frame, 1);
+            for (uint64_t i = 1; i <= frameIndex; ++i)
+            {
+                writeRow(frame, i);
+            }
+        }
+
+        void renderChanges(const FrameView& frame, uint64_t frameIndex, DirtyRows& changed) override
+        {
+            writeRow(frame, frameIndex);
+            changed.addRow(static_cast<uint32_t>(frameIndex % frame.height));
+        }
+
+        size_t fullRenders;
+
+    private:
+        static void writeRow(const FrameView& frame, uint64_t frameIndex)
+        {
+            std::memset(frame.row(static_cast<uint32_t>(frameIndex % frame.height)), static_cast<int>(frameIndex), frame.width * 4);
+        }
+    };
+
+    MemoryFrameBuffer RenderReference(DirtyFrameProducer& source, uint32_t width, uint32_t height, uint64_t frameIndex)
+    {
+        MemoryFrameBuffer frame(width, height, PixelFormat::RGB32);
+        source.renderFull(frame.view(), frameIndex);
+        return frame;
+    }
+}
+
+TEST_CASE(DirtyRowsMergesOverlappingAndTouchingRanges)
+{
+    DirtyRows rows;
+    CHECK(rows.isEmpty());
+    rows.add(10, 12);
+    rows.add(4, 6);
+    rows.add(20, 20);               // empty, ignored
+    CHECK(rows.getRanges() == Ranges({ Range(4, 6), Range(10, 12) }));
+
+    rows.add(6, 8);                 // touches [4, 6)
+    rows.addRow(9);                 // touches [10, 12)
+    CHECK(rows.getRanges() == Ranges({ Range(4, 8), Range(9, 12) }));
+    CHECK_EQUAL(7u, rows.rowCount());
+
+    rows.add(0, 30);                // swallows everything
+    CHECK(rows.getRanges() == Ranges({ Range(0, 30) }));
+
+    DirtyRows other;
+    other.add(40, 42);
+    other.add(30, 31);
+    rows.merge(other);
+    CHECK(rows.getRanges() == Ranges({ Range(0, 31), Range(40, 42) }));
+    rows.clear();
+    CHECK(rows.isEmpty());
+    CHECK_EQUAL(0u, rows.rowCount());
+}
+
+TEST_CASE(DirtyRowsAlignsToRowPairsWithinTheFrame)
+{
+    DirtyRows rows;
+    rows.addRow(3);
+    rows.add(6, 7);
+    rows.addRow(9);
+    rows.align(2, 10);
+    CHECK(rows.getRanges() == Ranges({ Range(2, 4), Range(6, 10) }));
+
+    DirtyRows tail;
+    tail.add(7, 9);
+    tail.align(4, 9);
+    CHECK(tail.getRanges() == Ranges({ Range(4, 9) }));
+}
+
+TEST_CASE(DirtyRegionProducerPatchesBuffersToTheFullFrame)
+{
+    // Three pooled buffers in rotation, each two frames behind when reused.
+    OneRowProducer source;
+    DirtyRegionTracker tracker;
+    DirtyRegionProducer producer(source, tracker, nullptr);
+    std::vector<MemoryFrameBuffer> buffers;
+    for (int i = 0; i < 3; ++i)
+    {
+        buffers.push_back(MemoryFrameBuffer(8, 16, PixelFormat::RGB32));
+    }
+    for (uint64_t frame = 0; frame < 12; ++frame)
+    {
+        const FrameView view = buffers[frame % 3].view();
+        producer.render(view, frame);
+        OneRowProducer reference;
+        CHECK(SameFrameBytes(RenderReference(reference, 8, 16, frame).view(), view));
+    }
+    CHECK_EQUAL(1u, source.fullRenders);
+
+    const DirtyRegionStats stats = tracker.stats();
+    const uint64_t frameBytes = 8 * 16 * 4;
+    CHECK_EQUAL(12u, stats.frames);
+    CHECK_EQUAL(3u, stats.fullCopies);
+    CHECK_EQUAL(12 * frameBytes, stats.bytesFull);
+    // Nine patches of the three rows changed since the buffer's last frame.
+    CHECK_EQUAL(3 * frameBytes + 9 * 3 * 8 * 4, stats.bytesCopied);
+}
+
+TEST_CASE(DirtyRegionProducerCopiesBuffersOlderThanItsHistory)
+{
+    OneRowProducer source;
+    DirtyRegionTracker tracker;
+    DirtyRegionProducer producer(source, tracker, nullptr, 2);
+    MemoryFrameBuffer a(8, 16, PixelFormat::RGB32);
+    MemoryFrameBuffer b(8, 16, PixelFormat::RGB32);
+
+    producer.render(a.view(), 0);
+    producer.render(b.view(), 1);
+    producer.render(b.view(), 2);
+    producer.render(a.view(), 3);               // three frames behind, history holds two
+    CHECK_EQUAL(3u, tracker.stats().fullCopies);
+    producer.render(b.view(), 4);               // two behind, patched
+    CHECK_EQUAL(3u, tracker.stats().fullCopies);
+
+    OneRowProducer reference;
+    CHECK(SameFrameBytes(RenderReference(reference, 8, 16, 3).view(), a.view()));
+    CHECK(SameFrameBytes(RenderReference(reference, 8, 16, 4).view(), b.view()));
+
+    // Going backwards or an unknown buffer id starts over.
+    FrameView anonymous = a.view();
+    anonymous.bufferId = 0;
+    producer.render(anonymous, 5);
+    producer.render(a.view(), 1);
+    CHECK_EQUAL(5u, tracker.stats().fullCopies);
+    CHECK_EQUAL(2u, source.fullRenders);
+    CHECK(SameFrameBytes(RenderReference(reference, 8, 16, 1).view(), a.view()));
+}
+
+TEST_CASE(DirtyRegionProducerConvertsPatchedRows)
+{
+    const TestPatternSettings settings = { TestPatternKind::MovingBoxes, 7, 0.5 };
+    TestPatternProducer source(settings);
+    TestPatternProducer reference(settings);
+    DirtyRegionTracker tracker;
+    ColorConverter converter(ColorMatrix::BT709, ColorRange::Limited);
+    DirtyRegionProducer producer(source, tracker, &converter);
+
+    for (PixelFormat format : { PixelFormat::NV12, PixelFormat::I420 })
+    {
+        MemoryFrameBuffer a(64, 36, format);
+        MemoryFrameBuffer b(64, 36, format);
+        for (uint64_t frame = 0; frame < 8; ++frame)
+        {
+            const FrameView view = (frame % 2 == 0 ? a : b).view();
+            producer.render(view, frame);
+
+            MemoryFrameBuffer rgb(64, 36, PixelFormat::RGB32);
+            reference.renderFull(rgb.view(), frame);
+            MemoryFrameBuffer expected(64, 36, format);
+            converter.convert(rgb.view(), expected.view());
+            CHECK(SameFrameBytes(expected.view(), view));
+        }
+    }
+    CHECK(tracker.stats().fullCopies < tracker.stats().frames);
+
+    DirtyRegionProducer unconverted(source, tracker, nullptr);
+    MemoryFrameBuffer nv12(64, 36, PixelFormat::NV12);
+    CHECK_THROWS(unconverted.render(nv12.view(), 0), std::invalid_argument);
+}
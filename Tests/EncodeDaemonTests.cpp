@@ -0,0 +1,400 @@
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "EncodeDaemon.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    // Shared by the fake runners of one daemon. A job's input names its
+    // behaviour, as in the scheduler tests:
+    //     "ok..."           succeeds, reporting progress half way
+    //     "retry<N>..."     fails retryably N times, then succeeds
+    //     "permanent..."    fails with a non-retryable TranscodeError
+    //     "hold..."         succeeds once release() is called
+    class FakeRunners
+    {
+    public:
+        TranscodeRunnerFactory factory()
+        {
+            return [this]() { return std::unique_ptr<TranscodeRunner>(new Runner(*this)); };
+        }
+
+        // Blocks until a "hold" job has started.
+        void waitForHold()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return holding; });
+        }
+
+        void release()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            released = true;
+            changed.notify_all();
+        }
+
+        size_t attemptsOf(const std::string& input)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return attempts[input];
+        }
+
+        int64_t fragmentDurationOf(const std::string& input)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return fragmentDurations[input];
+        }
+
+    private:
+        class Runner : public TranscodeRunner
+        {
+        public:
+            explicit Runner(FakeRunners& owner) : owner(owner) {}
+
+            TranscodeOutcome transcode(const TranscodeJob& job) override
+            {
+                return transcodeWithProgress(job, TranscodeProgressCallback());
+            }
+
+            TranscodeOutcome transcodeWithProgress(const TranscodeJob& job, const TranscodeProgressCallback& onProgress) override
+            {
+                size_t attempt;
+                {
+                    std::unique_lock<std::mutex> lock(owner.mutex);
+                    attempt = ++owner.attempts[job.input];
+                    owner.fragmentDurations[job.input] = job.fragmentDuration;
+                    if (job.input.compare(0, 4, "hold") == 0)
+                    {
+                        owner.holding = true;
+                        owner.changed.notify_all();
+                        owner.changed.wait(lock, [this]() { return owner.released; });
+                    }
+                }
+                if (job.input.compare(0, 5, "retry") == 0 && attempt <= static_cast<size_t>(job.input[5] - '0'))
+                {
+                    throw TranscodeError("busy", true);
+                }
+                if (job.input.compare(0, 9, "permanent") == 0)
+                {
+                    throw TranscodeError("unsupported", false);
+                }
+                if (onProgress)
+                {
+                    const SessionProgress half = { 5000000, 10000000, 0.5 };
+                    onProgress(half);
+                }
+                const TranscodeOutcome outcome = { 10000000, 1000 };
+                return outcome;
+            }
+
+        private:
+            FakeRunners& owner;
+        };
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool holding = false;
+        bool released = false;
+        std::map<std::string, size_t> attempts;
+        std::map<std::string, int64_t> fragmentDurations;
+    };
+
+    // Lets the held job finish on the way out, so a failed check doesn't
+    // leave the daemon's destructor waiting for it.
+    class HoldRelease
+    {
+    public:
+        explicit HoldRelease(FakeRunners& runners) : runners(runners) {}
+        ~HoldRelease() { runners.release(); }
+
+    private:
+        FakeRunners& runners;
+    };
+
+    // Every event a daemon delivered, from whichever thread.
+    class EventLog
+    {
+    public:
+        EncodeDaemon::EventCallback callback()
+        {
+            return [this](const DaemonEvent& event)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                events.push_back(event);
+            };
+        }
+
+        // The events of one job, in delivery order.
+        std::vector<DaemonEvent> of(uint64_t jobId)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<DaemonEvent> job;
+            for (const DaemonEvent& event : events)
+            {
+                if (event.jobId == jobId)
+                {
+                    job.push_back(event);
+                }
+            }
+            return job;
+        }
+
+        // Ids of the jobs in the order they finished.
+        std::vector<uint64_t> finished()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<uint64_t> ids;
+            for (const DaemonEvent& event : events)
+            {
+                if (event.kind == DaemonEventKind::Done || event.kind == DaemonEventKind::Failed)
+                {
+                    ids.push_back(event.jobId);
+                }
+            }
+            return ids;
+        }
+
+    private:
+        std::mutex mutex;
+        std::vector<DaemonEvent> events;
+    };
+
+    TranscodeJob MakeJob(const std::string& input)
+    {
+        const TranscodeJob job = { input, input + ".mp4", 0, 0, 0, 0, 0, 0 };
+        return job;
+    }
+
+    DaemonEvent RoundTrip(const DaemonEvent& event)
+    {
+        return ParseDaemonEvent(FormatDaemonEvent(event));
+    }
+
+    DaemonEvent MakeEvent(DaemonEventKind kind, uint64_t jobId)
+    {
+        DaemonEvent event = DaemonEvent();
+        event.kind = kind;
+        event.jobId = jobId;
+        return event;
+    }
+
+    // Accepted first, then progress, then Done or Failed.
+    void CheckJobEvents(const std::vector<DaemonEvent>& events, DaemonEventKind last)
+    {
+        CHECK(events.size() >= 2);
+        CHECK(events.front().kind == DaemonEventKind::Accepted);
+        for (size_t i = 1; i + 1 < events.size(); ++i)
+        {
+            CHECK(events[i].kind == DaemonEventKind::Progress);
+        }
+        CHECK(events.back().kind == last);
+    }
+}
+
+TEST_CASE(DaemonRequestsRoundTrip)
+{
+    DaemonRequest encode = DaemonRequest();
+    encode.kind = DaemonRequestKind::Encode;
+    encode.job = MakeJob("in put.yuv");
+    encode.job.audioProfile = 2;
+    encode.job.videoProfile = 3;
+    const DaemonRequest parsed = ParseDaemonRequest(FormatDaemonRequest(encode));
+    CHECK(parsed.kind == DaemonRequestKind::Encode);
+    CHECK_EQUAL(std::string("in put.yuv"), parsed.job.input);
+    CHECK_EQUAL(std::string("in put.yuv.mp4"), parsed.job.output);
+    CHECK_EQUAL(2, parsed.job.audioProfile);
+    CHECK_EQUAL(3, parsed.job.videoProfile);
+
+    const DaemonRequest shortest = ParseDaemonRequest("encode\ta.yuv\tb.mp4");
+    CHECK_EQUAL(std::string("b.mp4"), shortest.job.output);
+    CHECK_EQUAL(0, shortest.job.videoProfile);
+
+    for (DaemonRequestKind kind : { DaemonRequestKind::Status, DaemonRequestKind::Shutdown })
+    {
+        DaemonRequest request = DaemonRequest();
+        request.kind = kind;
+        CHECK(ParseDaemonRequest(FormatDaemonRequest(request)).kind == kind);
+    }
+
+    const char* malformed[] = { "", "encode", "encode\ta.yuv", "encode\ta\tb\t1\t2\t3", "encode\ta\tb\tx",
+        "status\tnow", "stop" };
+    for (const char* line : malformed)
+    {
+        CHECK_THROWS(ParseDaemonRequest(line), std::invalid_argument);
+    }
+}
+
+TEST_CASE(DaemonEventsRoundTrip)
+{
+    DaemonEvent accepted = MakeEvent(DaemonEventKind::Accepted, 7);
+    accepted.jobsAhead = 3;
+    const DaemonEvent acceptedBack = RoundTrip(accepted);
+    CHECK(acceptedBack.kind == DaemonEventKind::Accepted);
+    CHECK_EQUAL(UINT64_C(7), acceptedBack.jobId);
+    CHECK_EQUAL(size_t(3), acceptedBack.jobsAhead);
+
+    DaemonEvent progress = MakeEvent(DaemonEventKind::Progress, 8);
+    progress.progress.fraction = 0.25;
+    progress.progress.position = INT64_C(123456789);
+    progress.progress.duration = 999;
+    const DaemonEvent progressBack = RoundTrip(progress);
+    CHECK(progressBack.kind == DaemonEventKind::Progress);
+    CHECK_EQUAL(UINT64_C(8), progressBack.jobId);
+    CHECK_EQUAL(0.25, progressBack.progress.fraction);
+    CHECK_EQUAL(INT64_C(123456789), progressBack.progress.position);
+    CHECK_EQUAL(INT64_C(0), progressBack.progress.duration);
+
+    DaemonEvent done = MakeEvent(DaemonEventKind::Done, 9);
+    done.outcome.mediaDuration = INT64_C(600000000);
+    done.outcome.outputBytes = UINT64_C(5000000000);
+    done.seconds = 1.5;
+    const DaemonEvent doneBack = RoundTrip(done);
+    CHECK(doneBack.kind == DaemonEventKind::Done);
+    CHECK_EQUAL(INT64_C(600000000), doneBack.outcome.mediaDuration);
+    CHECK_EQUAL(UINT64_C(5000000000), doneBack.outcome.outputBytes);
+    CHECK_EQUAL(1.5, doneBack.seconds);
+
+    // Messages stay on one line and one field.
+    DaemonEvent failed = MakeEvent(DaemonEventKind::Failed, 10);
+    failed.message = "no\tcodec\r\nhere";
+    const DaemonEvent failedBack = RoundTrip(failed);
+    CHECK(failedBack.kind == DaemonEventKind::Failed);
+    CHECK_EQUAL(UINT64_C(10), failedBack.jobId);
+    CHECK_EQUAL(std::string("no codec  here"), failedBack.message);
+    CHECK(RoundTrip(MakeEvent(DaemonEventKind::Failed, 11)).message.empty());
+
+    DaemonEvent rejected = MakeEvent(DaemonEventKind::Rejected, 0);
+    rejected.message = "queue is full";
+    CHECK_EQUAL(std::string("queue is full"), RoundTrip(rejected).message);
+
+    DaemonEvent status = MakeEvent(DaemonEventKind::Status, 0);
+    const DaemonStatus counts = { 4, 2, 100, 5, 2 };
+    status.status = counts;
+    const DaemonEvent statusBack = RoundTrip(status);
+    CHECK(statusBack.kind == DaemonEventKind::Status);
+    CHECK_EQUAL(size_t(4), statusBack.status.queued);
+    CHECK_EQUAL(size_t(2), statusBack.status.running);
+    CHECK_EQUAL(UINT64_C(100), statusBack.status.succeeded);
+    CHECK_EQUAL(UINT64_C(5), statusBack.status.failed);
+    CHECK_EQUAL(size_t(2), statusBack.status.runners);
+
+    CHECK(RoundTrip(MakeEvent(DaemonEventKind::Closing, 0)).kind == DaemonEventKind::Closing);
+
+    const char* malformed[] = { "", "accepted\t1", "done\t1\tx\t2\t3", "progress\t1\t0.5\t10\t11", "status\t1\t2\t3\t4",
+        "closing\tnow", "hello" };
+    for (const char* line : malformed)
+    {
+        CHECK_THROWS(ParseDaemonEvent(line), std::invalid_argument);
+    }
+}
+
+TEST_CASE(EncodeDaemonRejectsJobsPastTheQueueLimit)
+{
+    FakeRunners runners;
+    EventLog log;
+    const EncodeDaemonSettings settings = { 1, 2, 1, 0 };
+    EncodeDaemon daemon(settings, runners.factory());
+    HoldRelease releaseOnExit(runners);
+    CHECK_EQUAL(size_t(1), daemon.getSessionLimit());
+
+    const DaemonEvent first = daemon.submit(MakeJob("hold"), log.callback());
+    CHECK(first.kind == DaemonEventKind::Accepted);
+    CHECK_EQUAL(size_t(0), first.jobsAhead);
+    runners.waitForHold();
+
+    // The running job doesn't count against the queue, but is ahead.
+    const DaemonEvent second = daemon.submit(MakeJob("ok1"), log.callback());
+    const DaemonEvent third = daemon.submit(MakeJob("ok2"), log.callback());
+    CHECK(second.kind == DaemonEventKind::Accepted);
+    CHECK_EQUAL(size_t(1), second.jobsAhead);
+    CHECK_EQUAL(size_t(2), third.jobsAhead);
+    CHECK(third.jobId > second.jobId);
+
+    const DaemonEvent full = daemon.submit(MakeJob("ok3"), log.callback());
+    CHECK(full.kind == DaemonEventKind::Rejected);
+    CHECK(full.message.find("queue is full") != std::string::npos);
+    const DaemonStatus waiting = daemon.getStatus();
+    CHECK_EQUAL(size_t(2), waiting.queued);
+    CHECK_EQUAL(size_t(1), waiting.running);
+
+    // Stopping finishes every accepted job, in order, then turns jobs away.
+    runners.release();
+    daemon.stop();
+    std::vector<uint64_t> order;
+    order.push_back(first.jobId);
+    order.push_back(second.jobId);
+    order.push_back(third.jobId);
+    CHECK(log.finished() == order);
+    CheckJobEvents(log.of(third.jobId), DaemonEventKind::Done);
+    CHECK_EQUAL(size_t(0), runners.attemptsOf("ok3"));
+
+    const DaemonStatus stopped = daemon.getStatus();
+    CHECK_EQUAL(size_t(0), stopped.queued);
+    CHECK_EQUAL(size_t(0), stopped.running);
+    CHECK_EQUAL(UINT64_C(3), stopped.succeeded);
+    CHECK_EQUAL(UINT64_C(0), stopped.failed);
+    CHECK_EQUAL(size_t(1), stopped.runners);
+
+    const DaemonEvent late = daemon.submit(MakeJob("ok4"), log.callback());
+    CHECK(late.kind == DaemonEventKind::Rejected);
+    CHECK(late.message.find("shutting down") != std::string::npos);
+    daemon.stop();
+}
+
+TEST_CASE(EncodeDaemonRetriesRetryableFailures)
+{
+    FakeRunners runners;
+    EventLog log;
+    const EncodeDaemonSettings settings = { 2, 0, 3, 20000000 };
+    std::map<std::string, uint64_t> ids;
+    {
+        EncodeDaemon daemon(settings, runners.factory());
+        for (const char* input : { "retry2", "retry5", "permanent", "ok" })
+        {
+            TranscodeJob job = MakeJob(input);
+            if (job.input == "ok")
+            {
+                job.fragmentDuration = 10000000;
+            }
+            const DaemonEvent accepted = daemon.submit(job, log.callback());
+            CHECK(accepted.kind == DaemonEventKind::Accepted);
+            ids[input] = accepted.jobId;
+        }
+        daemon.stop();
+        const DaemonStatus status = daemon.getStatus();
+        CHECK_EQUAL(UINT64_C(2), status.succeeded);
+        CHECK_EQUAL(UINT64_C(2), status.failed);
+        CHECK(status.runners >= 1 && status.runners <= 2);
+    }
+
+    CHECK_EQUAL(size_t(3), runners.attemptsOf("retry2"));
+    CHECK_EQUAL(size_t(3), runners.attemptsOf("retry5"));
+    CHECK_EQUAL(size_t(1), runners.attemptsOf("permanent"));
+    CHECK_EQUAL(size_t(1), runners.attemptsOf("ok"));
+
+    const std::vector<DaemonEvent> recovered = log.of(ids["retry2"]);
+    CheckJobEvents(recovered, DaemonEventKind::Done);
+    CHECK_EQUAL(size_t(3), recovered.size());
+    CHECK_EQUAL(INT64_C(10000000), recovered.back().outcome.mediaDuration);
+
+    const std::vector<DaemonEvent> gaveUp = log.of(ids["retry5"]);
+    CheckJobEvents(gaveUp, DaemonEventKind::Failed);
+    CHECK_EQUAL(std::string("busy"), gaveUp.back().message);
+    const std::vector<DaemonEvent> unsupported = log.of(ids["permanent"]);
+    CheckJobEvents(unsupported, DaemonEventKind::Failed);
+    CHECK_EQUAL(std::string("unsupported"), unsupported.back().message);
+    CheckJobEvents(log.of(ids["ok"]), DaemonEventKind::Done);
+
+    // Jobs without a fragment duration get the daemon's.
+    CHECK_EQUAL(INT64_C(20000000), runners.fragmentDurationOf("retry2"));
+    CHECK_EQUAL(INT64_C(10000000), runners.fragmentDurationOf("ok"));
+}
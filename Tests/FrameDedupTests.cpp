@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "FrameDedup.h"
+#include "FrameGeometry.h"
+#include "MemoryFrameBuffer.h"
+#include "TestFrames.h"
+#include "TestHarness.h"
+#include "VideoSink.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    const PixelFormat FORMATS[] = { PixelFormat::RGB32, PixelFormat::NV12, PixelFormat::I420 };
+
+    // Hands out memory frames and remembers what came back, by the hash of
+    // the picture.
+    class RecordingSink : public VideoSink
+    {
+    public:
+        struct Sample
+        {
+            uint64_t hash;
+            int64_t timestamp;
+            int64_t duration;
+        };
+
+        uint32_t addStream(const VideoStreamFormat&) override { return 0; }
+        void setInputFormat(uint32_t, const VideoStreamFormat&) override {}
+        void beginWriting() override {}
+
+        SinkFrame acquireFrame(uint32_t) override
+        {
+            buffers.emplace_back(new MemoryFrameBuffer(64, 16, PixelFormat::NV12));
+            const SinkFrame frame = { buffers.back()->view(), buffers.back().get() };
+            return frame;
+        }
+
+        void writeFrame(uint32_t, SinkFrame& frame, int64_t timestamp, int64_t duration) override
+        {
+            const Sample sample = { HashFrame(SimdLevel::Scalar, frame.view), timestamp, duration };
+            written.push_back(sample);
+            frame.handle = nullptr;
+        }
+
+        void discardFrame(uint32_t, SinkFrame& frame) override
+        {
+            ++discarded;
+            frame.handle = nullptr;
+        }
+
+        void finalize() override {}
+
+        std::vector<Sample> written;
+        int discarded = 0;
+
+    private:
+        std::vector<std::unique_ptr<MemoryFrameBuffer>> buffers;
+    };
+
+    // Writes a frame of noise `key` through the filter, one time unit long.
+    void WritePicture(RecordingSink& sink, DuplicateFrameFilter& filter, uint32_t key, int64_t timestamp)
+    {
+        SinkFrame frame = sink.acquireFrame(0);
+        FillFrameNoise(frame.view, key);
+        filter.write(frame, HashFrame(SimdLevel::Scalar, frame.view), timestamp, 1);
+        CHECK(frame.handle == nullptr);
+    }
+
+    uint64_t PictureHash(uint32_t key)
+    {
+        MemoryFrameBuffer frame(64, 16, PixelFormat::NV12);
+        FillFrameNoise(frame.view(), key);
+        return HashFrame(SimdLevel::Scalar, frame.view());
+    }
+
+    void CheckSample(const RecordingSink::Sample& sample, uint32_t key, int64_t timestamp, int64_t duration)
+    {
+        CHECK_EQUAL(PictureHash(key), sample.hash);
+        CHECK_EQUAL(timestamp, sample.timestamp);
+        CHECK_EQUAL(duration, sample.duration);
+    }
+}
+
+TEST_CASE(HashFrameIsTheSameAtEverySimdLevel)
+{
+    // Rows that end inside and after the first stripe and the first block
+    // of eight stripes.
+    for (uint32_t width : { 2u, 30u, 32u, 66u, 256u, 258u, 1282u })
+    {
+        for (PixelFormat format : FORMATS)
+        {
+            MemoryFrameBuffer frame(width, 6, format);
+            FillFrameNoise(frame.view(), width);
+            const uint64_t expected = HashFrame(SimdLevel::Scalar, frame.view());
+
+            // Padding holds different bytes in each copy and is left out.
+            PaddedFrame padded(width, 6, format, 40, 0xA5);
+            CopyFrameRows(frame.view(), padded.view, 0, 6, KernelDispatch::Generic);
+            for (SimdLevel level : SupportedSimdLevels())
+            {
+                CHECK_EQUAL(expected, HashFrame(level, frame.view()));
+                CHECK_EQUAL(expected, HashFrame(level, padded.view));
+            }
+        }
+    }
+}
+
+TEST_CASE(HashFrameChangesWithAnyPixel)
+{
+    for (PixelFormat format : FORMATS)
+    {
+        MemoryFrameBuffer frame(258, 8, format);
+        const FrameView view = frame.view();
+        FillFrameNoise(view, 5);
+        for (SimdLevel level : SupportedSimdLevels())
+        {
+            const uint64_t original = HashFrame(level, view);
+
+            // The first byte, one in the partial last stripe of a row, and
+            // the last byte of the last plane.
+            const unsigned lastPlane = format == PixelFormat::I420 ? 2 : format == PixelFormat::NV12 ? 1 : 0;
+            const size_t lastRowBytes = lastPlane == 0 ? RowBytes(format, 258) : format == PixelFormat::NV12 ? 258 : 129;
+            const uint32_t lastRows = lastPlane == 0 ? 8 : 4;
+            uint8_t* bytes[] = { view.data, view.data + view.stride * 3 + RowBytes(format, 258) - 1,
+                view.plane(lastPlane) + view.planeStride(lastPlane) * (lastRows - 1) + lastRowBytes - 1 };
+            for (uint8_t* byte : bytes)
+            {
+                *byte ^= 1;
+                CHECK(HashFrame(level, view) != original);
+                *byte ^= 1;
+                CHECK_EQUAL(original, HashFrame(level, view));
+            }
+
+            // Swapped rows hold the same bytes in another order.
+            std::swap_ranges(view.row(1), view.row(1) + RowBytes(format, 258), view.row(2));
+            CHECK(HashFrame(level, view) != original);
+            std::swap_ranges(view.row(1), view.row(1) + RowBytes(format, 258), view.row(2));
+        }
+    }
+}
+
+TEST_CASE(SameFramePixelsIgnoresPadding)
+{
+    MemoryFrameBuffer frame(66, 4, PixelFormat::I420);
+    FillFrameNoise(frame.view(), 3);
+    PaddedFrame padded(66, 4, PixelFormat::I420, 20, 0x11);
+    CopyFrameRows(frame.view(), padded.view, 0, 4, KernelDispatch::Generic);
+    CHECK(SameFramePixels(frame.view(), padded.view));
+
+    padded.view.plane(2)[1] ^= 0x80;
+    CHECK(!SameFramePixels(frame.view(), padded.view));
+
+    MemoryFrameBuffer nv12(66, 4, PixelFormat::NV12);
+    MemoryFrameBuffer smaller(64, 4, PixelFormat::I420);
+    CHECK(!SameFramePixels(frame.view(), nv12.view()));
+    CHECK(!SameFramePixels(frame.view(), smaller.view()));
+}
+
+TEST_CASE(DuplicateFrameFilterFoldsRepeatsUpToTheHold)
+{
+    RecordingSink sink;
+    DuplicateFrameFilter filter(sink, 0, 3);
+    const uint32_t pictures[] = { 1, 1, 1, 1, 2, 2, 1 };
+    for (int64_t t = 0; t < 7; ++t)
+    {
+        WritePicture(sink, filter, pictures[t], t);
+    }
+    // The last frame is still held.
+    CHECK_EQUAL(size_t(3), sink.written.size());
+    filter.flush();
+    filter.flush();
+
+    // The fourth repeat would have made the first sample 4 long, so it
+    // starts the next one.
+    CHECK_EQUAL(size_t(4), sink.written.size());
+    CheckSample(sink.written[0], 1, 0, 3);
+    CheckSample(sink.written[1], 1, 3, 1);
+    CheckSample(sink.written[2], 2, 4, 2);
+    CheckSample(sink.written[3], 1, 6, 1);
+    CHECK_EQUAL(UINT64_C(3), filter.getFramesDropped());
+    CHECK_EQUAL(3, sink.discarded);
+}
+
+TEST_CASE(DuplicateFrameFilterComparesPixelsBehindEqualHashes)
+{
+    RecordingSink sink;
+    {
+        DuplicateFrameFilter filter(sink, 0, 100);
+        for (uint32_t key : { 1u, 2u, 2u })
+        {
+            SinkFrame frame = sink.acquireFrame(0);
+            FillFrameNoise(frame.view, key);
+            filter.write(frame, 42, key, 1);
+        }
+        filter.flush();
+        CHECK_EQUAL(UINT64_C(1), filter.getFramesDropped());
+    }
+    CHECK_EQUAL(size_t(2), sink.written.size());
+    CheckSample(sink.written[0], 1, 1, 1);
+    CheckSample(sink.written[1], 2, 2, 2);
+
+    // A frame still held when the filter goes is discarded, not written.
+    RecordingSink unflushed;
+    {
+        DuplicateFrameFilter filter(unflushed, 0, 100);
+        WritePicture(unflushed, filter, 1, 0);
+        WritePicture(unflushed, filter, 1, 1);
+    }
+    CHECK(unflushed.written.empty());
+    CHECK_EQUAL(2, unflushed.discarded);
+}
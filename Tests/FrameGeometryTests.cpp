@@ -0,0 +1,119 @@
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "ColorConversion.h"
+#include "FrameGeometry.h"
+#include "MemoryFrameBuffer.h"
+#include "TestFrames.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    const uint32_t SPECIALIZED_WIDTHS[] = { 1280, 1920, 3840 };
+}
+
+TEST_CASE(SpecializedConversionMatchesTheGenericKernels)
+{
+    const ColorCoefficients coefficients = ComputeColorCoefficients(ColorMatrix::BT709, ColorRange::Limited);
+    for (uint32_t width : SPECIALIZED_WIDTHS)
+    {
+        MemoryFrameBuffer rgb(width, 6, PixelFormat::RGB32);
+        FillFrameNoise(rgb.view(), width);
+        for (PixelFormat format : { PixelFormat::NV12, PixelFormat::I420 })
+        {
+            MemoryFrameBuffer expected(width, 6, format);
+            ConvertRGB32Rows(SimdLevel::Scalar, coefficients, rgb.view(), expected.view(), 0, 6, KernelDispatch::Generic);
+            for (SimdLevel level : SupportedSimdLevels())
+            {
+                MemoryFrameBuffer specialized(width, 6, format);
+                ConvertRGB32Rows(level, coefficients, rgb.view(), specialized.view(), 0, 6, KernelDispatch::Specialized);
+                CHECK(SameFrameBytes(expected.view(), specialized.view()));
+
+                // Padded rows of a specialized width take the generic path.
+                PaddedFrame padded(width, 6, format, 64);
+                ConvertRGB32Rows(level, coefficients, rgb.view(), padded.view, 0, 6, KernelDispatch::Specialized);
+                CHECK(SameFrameBytes(expected.view(), padded.view));
+            }
+        }
+    }
+}
+
+TEST_CASE(SpecializedCopyMatchesTheRowCopy)
+{
+    for (uint32_t width : { 1280u, 1920u, 3840u, 96u })
+    {
+        for (PixelFormat format : { PixelFormat::RGB32, PixelFormat::NV12, PixelFormat::I420 })
+        {
+            MemoryFrameBuffer src(width, 8, format);
+            FillFrameNoise(src.view(), width + 1);
+            for (KernelDispatch dispatch : { KernelDispatch::Specialized, KernelDispatch::Generic })
+            {
+                MemoryFrameBuffer packed(width, 8, format);
+                std::memset(packed.view().data, 0, packed.size());
+                PaddedFrame padded(width, 8, format, 32);
+                CopyFrameRows(src.view(), packed.view(), 2, 6, dispatch);
+                CopyFrameRows(src.view(), padded.view, 2, 6, dispatch);
+
+                // Only rows 2..5 and their chroma rows 1..2 arrive.
+                MemoryFrameBuffer expected(width, 8, format);
+                std::memset(expected.view().data, 0, expected.size());
+                const FrameView from = src.view();
+                const FrameView to = expected.view();
+                const unsigned planes = format == PixelFormat::I420 ? 3 : format == PixelFormat::NV12 ? 2 : 1;
+                for (unsigned plane = 0; plane < planes; ++plane)
+                {
+                    const size_t bytes = plane == 0 ? RowBytes(format, width) : format == PixelFormat::NV12 ? width : width / 2;
+                    for (uint32_t y = plane == 0 ? 2 : 1; y < (plane == 0 ? 6u : 3u); ++y)
+                    {
+                        const ptrdiff_t offset = from.planeStride(plane) * static_cast<ptrdiff_t>(y);
+                        std::memcpy(to.plane(plane) + offset, from.plane(plane) + offset, bytes);
+                    }
+                }
+                CHECK(SameFrameBytes(expected.view(), packed.view()));
+                CHECK(SameFrameBytes(expected.view(), padded.view));
+            }
+        }
+    }
+}
+
+TEST_CASE(FrameGeometryReadsSizesRatesAndFiles)
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    CHECK(ParseFrameSize("1080p", width, height));
+    CHECK_EQUAL(1920u, width);
+    CHECK_EQUAL(1080u, height);
+    CHECK(ParseFrameSize("4k", width, height));
+    CHECK_EQUAL(3840u, width);
+    CHECK(ParseFrameSize("640x360", width, height));
+    CHECK_EQUAL(360u, height);
+    CHECK(!ParseFrameSize("640x", width, height));
+    CHECK(!ParseFrameSize("wide", width, height));
+    CHECK_EQUAL(360u, height);
+
+    const FrameGeometry defaults = { 1280, 720, 30, 1, 800000 };
+    std::istringstream config("# ntsc\nsize = 720x480\n\nfps = 30000/1001\nbitrate=2000000\n");
+    const FrameGeometry geometry = ReadFrameGeometry(config, defaults);
+    CHECK_EQUAL(720u, geometry.width);
+    CHECK_EQUAL(480u, geometry.height);
+    CHECK_EQUAL(30000u, geometry.fpsNumerator);
+    CHECK_EQUAL(1001u, geometry.fpsDenominator);
+    CHECK_EQUAL(2000000u, geometry.bitrate);
+    CHECK_EQUAL(INT64_C(333666), geometry.frameDuration());
+    CHECK_EQUAL(UINT64_C(299), geometry.framesFor(10));
+
+    std::istringstream unknown("size = 720p\ndepth = 10\n");
+    CHECK_THROWS(ReadFrameGeometry(unknown, defaults), std::invalid_argument);
+    FrameGeometry odd = defaults;
+    odd.height = 719;
+    CHECK_THROWS(ValidateFrameGeometry(odd), std::invalid_argument);
+    FrameGeometry still = defaults;
+    still.fpsNumerator = 0;
+    CHECK_THROWS(ValidateFrameGeometry(still), std::invalid_argument);
+    ValidateFrameGeometry(defaults);
+}
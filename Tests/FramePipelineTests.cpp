@@ -0,0 +1,89 @@
+#include <atomic>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "FramePipeline.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+TEST_CASE(FramePipelineSubmitsEveryFrameInOrder)
+{
+    // Small windows and several producers make the last frames race the
+    // producers finishing.
+    for (int run = 0; run < 200; ++run)
+    {
+        FramePipeline<uint64_t> pipeline(3, 2);
+        std::vector<uint64_t> order;
+        const PipelineStats stats = pipeline.run(17, 10,
+            [](size_t, uint64_t frameIndex) { return frameIndex; },
+            [&](PipelineFrame<uint64_t>& frame)
+            {
+                CHECK_EQUAL(static_cast<int64_t>(frame.index) * 10, frame.timestamp);
+                order.push_back(frame.item);
+            });
+
+        CHECK_EQUAL(17u, stats.framesSubmitted);
+        CHECK_EQUAL(17u, order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            CHECK_EQUAL(i, order[i]);
+        }
+        CHECK(stats.maxReorderDepth <= 2);
+    }
+}
+
+TEST_CASE(FramePipelineDiscardsTheFrameSubmitThrowsOn)
+{
+    FramePipeline<uint64_t> pipeline(2, 4);
+    std::atomic<uint64_t> produced(0);
+    std::vector<uint64_t> submitted;
+    std::multiset<uint64_t> discarded;
+
+    CHECK_THROWS(pipeline.run(50, 1,
+        [&](size_t, uint64_t frameIndex) { ++produced; return frameIndex; },
+        [&](PipelineFrame<uint64_t>& frame)
+        {
+            if (frame.index == 7)
+            {
+                throw std::runtime_error("submit failed");
+            }
+            submitted.push_back(frame.item);
+        },
+        [&](PipelineFrame<uint64_t>& frame) { discarded.insert(frame.item); }),
+        std::runtime_error);
+
+    CHECK_EQUAL(7u, submitted.size());
+    CHECK_EQUAL(1u, discarded.count(7));
+    CHECK_EQUAL(produced.load(), submitted.size() + discarded.size());
+    for (uint64_t index : submitted)
+    {
+        CHECK_EQUAL(0u, discarded.count(index));
+    }
+}
+
+TEST_CASE(FramePipelineDiscardsWhatIsInFlightWhenAProducerThrows)
+{
+    FramePipeline<uint64_t> pipeline(2, 4);
+    std::atomic<uint64_t> produced(0);
+    uint64_t submitted = 0;
+    uint64_t discarded = 0;
+
+    CHECK_THROWS(pipeline.run(50, 1,
+        [&](size_t, uint64_t frameIndex)
+        {
+            if (frameIndex == 20)
+            {
+                throw std::runtime_error("render failed");
+            }
+            ++produced;
+            return frameIndex;
+        },
+        [&](PipelineFrame<uint64_t>&) { ++submitted; },
+        [&](PipelineFrame<uint64_t>&) { ++discarded; }),
+        std::runtime_error);
+
+    CHECK(submitted <= 20);
+    CHECK_EQUAL(produced.load(), submitted + discarded);
+}
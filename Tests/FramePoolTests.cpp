@@ -0,0 +1,155 @@
+#include <thread>
+#include <vector>
+
+#include "FramePool.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    // Items are serial numbers; counts what the pool asks of its backend.
+    struct CountingBackend
+    {
+        typedef int Item;
+
+        CountingBackend(int& created, int& destroyed) : created(&created), destroyed(&destroyed) {}
+
+        Item create() { return ++*created; }
+        void destroy(Item&) { ++*destroyed; }
+
+        int* created;
+        int* destroyed;
+    };
+}
+
+TEST_CASE(FramePoolMissesUntilItemsComeBack)
+{
+    int created = 0;
+    int destroyed = 0;
+    FramePool<CountingBackend> pool(CountingBackend(created, destroyed), 2);
+
+    const int a = pool.acquire();
+    const int b = pool.acquire();
+    CHECK(a != b);
+    pool.recycle(a);
+    CHECK_EQUAL(a, pool.acquire());
+
+    const FramePoolStats stats = pool.stats();
+    CHECK_EQUAL(1u, stats.hits);
+    CHECK_EQUAL(2u, stats.misses);
+    CHECK_EQUAL(2u, stats.allocations);
+    CHECK_EQUAL(2u, stats.outstanding);
+    CHECK_EQUAL(2u, stats.highWaterMark);
+    CHECK_EQUAL(2, created);
+}
+
+TEST_CASE(FramePoolHighWaterMarkOutlivesRecycling)
+{
+    int created = 0;
+    int destroyed = 0;
+    FramePool<CountingBackend> pool(CountingBackend(created, destroyed), 4);
+
+    std::vector<int> items;
+    for (int i = 0; i < 3; ++i)
+    {
+        items.push_back(pool.acquire());
+    }
+    for (int item : items)
+    {
+        pool.recycle(item);
+    }
+    pool.recycle(pool.acquire());
+
+    const FramePoolStats stats = pool.stats();
+    CHECK_EQUAL(0u, stats.outstanding);
+    CHECK_EQUAL(3u, stats.highWaterMark);
+    CHECK_EQUAL(1u, stats.hits);
+    CHECK_EQUAL(3u, stats.misses);
+}
+
+TEST_CASE(FramePoolPreallocateFillsToCapacityOnce)
+{
+    int created = 0;
+    int destroyed = 0;
+    FramePool<CountingBackend> pool(CountingBackend(created, destroyed), 3);
+
+    pool.preallocate();
+    pool.preallocate();
+    CHECK_EQUAL(3, created);
+    CHECK_EQUAL(3u, pool.stats().allocations);
+    CHECK_EQUAL(0u, pool.stats().outstanding);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        pool.acquire();
+    }
+    CHECK_EQUAL(3u, pool.stats().hits);
+    CHECK_EQUAL(0u, pool.stats().misses);
+
+    pool.acquire();
+    CHECK_EQUAL(1u, pool.stats().misses);
+    CHECK_EQUAL(4u, pool.stats().allocations);
+}
+
+TEST_CASE(FramePoolDestroysWhatItCannotKeep)
+{
+    int created = 0;
+    int destroyed = 0;
+    {
+        FramePool<CountingBackend> pool(CountingBackend(created, destroyed), 1);
+        const int a = pool.acquire();
+        const int b = pool.acquire();
+        pool.recycle(a);
+        pool.recycle(b);
+        CHECK_EQUAL(1, destroyed);
+        CHECK_EQUAL(0u, pool.stats().outstanding);
+    }
+    // The idle item goes with the pool.
+    CHECK_EQUAL(2, destroyed);
+    CHECK_EQUAL(created, destroyed);
+}
+
+TEST_CASE(FramePoolCountsStayConsistentAcrossThreads)
+{
+    int created = 0;
+    int destroyed = 0;
+    FramePool<CountingBackend> pool(CountingBackend(created, destroyed), 2);
+    pool.preallocate();
+
+    const size_t THREADS = 4;
+    const size_t ROUNDS = 2000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&pool]()
+        {
+            for (size_t i = 0; i < ROUNDS; ++i)
+            {
+                pool.recycle(pool.acquire());
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    const FramePoolStats stats = pool.stats();
+    CHECK_EQUAL(THREADS * ROUNDS, stats.hits + stats.misses);
+    CHECK_EQUAL(2 + stats.misses, stats.allocations);
+    CHECK_EQUAL(0u, stats.outstanding);
+    CHECK(stats.highWaterMark >= 1 && stats.highWaterMark <= THREADS);
+}
+
+TEST_CASE(AlignedBufferPoolHandsOutAlignedFrames)
+{
+    AlignedBufferPool pool(AlignedBufferBackend(1000), 2);
+    pool.preallocate();
+    AlignedBuffer buffer = pool.acquire();
+    CHECK_EQUAL(1000u, buffer.size());
+    CHECK_EQUAL(0u, reinterpret_cast<uintptr_t>(buffer.get()) % FRAME_ALIGNMENT);
+    const uint64_t id = buffer.getId();
+    pool.recycle(std::move(buffer));
+    CHECK_EQUAL(id, pool.acquire().getId());
+}
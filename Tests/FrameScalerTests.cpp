@@ -0,0 +1,173 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "FrameScaler.h"
+#include "MemoryFrameBuffer.h"
+#include "TestFrames.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    const ScaleFilter FILTERS[] = { ScaleFilter::Bilinear, ScaleFilter::Bicubic, ScaleFilter::Area };
+
+    struct ScaleCase
+    {
+        uint32_t srcWidth, srcHeight;
+        uint32_t dstWidth, dstHeight;
+    };
+
+    // Shrinking and enlarging, by whole and odd factors, at widths that end
+    // inside and after every vector width.
+    const ScaleCase CASES[] =
+    {
+        { 64, 48, 32, 24 },
+        { 66, 34, 130, 70 },
+        { 320, 180, 142, 80 },
+        { 38, 22, 38, 22 },
+        { 18, 200, 258, 12 },
+    };
+}
+
+TEST_CASE(ScaleAxisWeightsAddUpToOne)
+{
+    for (ScaleFilter filter : FILTERS)
+    {
+        for (uint32_t srcSize : { 1u, 7u, 64u, 333u })
+        {
+            for (uint32_t dstSize : { 1u, 5u, 64u, 1000u })
+            {
+                const ScaleAxis axis = ComputeScaleAxis(filter, srcSize, dstSize);
+                CHECK(axis.taps > 0);
+                CHECK(axis.taps <= axis.tapStride);
+                CHECK_EQUAL(0u, axis.tapStride % 8);
+                CHECK_EQUAL(size_t(dstSize), axis.offsets.size());
+                CHECK_EQUAL(size_t(dstSize) * axis.tapStride, axis.weights.size());
+                for (uint32_t i = 0; i < dstSize; ++i)
+                {
+                    int sum = 0;
+                    for (uint32_t t = 0; t < axis.tapStride; ++t)
+                    {
+                        const int weight = axis.weights[i * axis.tapStride + t];
+                        CHECK(t < axis.taps || weight == 0);
+                        sum += weight;
+                    }
+                    CHECK_EQUAL(1 << 14, sum);
+                }
+            }
+        }
+        CHECK_THROWS(ComputeScaleAxis(filter, 0, 4), std::invalid_argument);
+        CHECK_THROWS(ComputeScaleAxis(filter, 4, 0), std::invalid_argument);
+    }
+}
+
+TEST_CASE(ScaleFrameRowsMatchesScalarAtEverySimdLevel)
+{
+    for (const ScaleCase& size : CASES)
+    {
+        for (ScaleFilter filter : FILTERS)
+        {
+            const ScalePlan plan = ComputeScalePlan(filter, size.srcWidth, size.srcHeight, size.dstWidth, size.dstHeight);
+            for (PixelFormat format : { PixelFormat::NV12, PixelFormat::I420 })
+            {
+                MemoryFrameBuffer src(size.srcWidth, size.srcHeight, format);
+                FillFrameNoise(src.view(), size.srcWidth * 7 + size.dstWidth);
+                MemoryFrameBuffer expected(size.dstWidth, size.dstHeight, format);
+                ScaleFrameRows(SimdLevel::Scalar, plan, src.view(), expected.view(), 0, size.dstHeight);
+
+                for (SimdLevel level : SupportedSimdLevels())
+                {
+                    PaddedFrame actual(size.dstWidth, size.dstHeight, format, 24);
+                    ScaleFrameRows(level, plan, src.view(), actual.view, 0, size.dstHeight);
+                    CHECK(SameFrameBytes(expected.view(), actual.view));
+
+                    // Row bands give the same rows as one pass.
+                    PaddedFrame banded(size.dstWidth, size.dstHeight, format, 8);
+                    for (uint32_t row = 0; row < size.dstHeight; row += 6)
+                    {
+                        const uint32_t end = row + 6 < size.dstHeight ? row + 6 : size.dstHeight;
+                        ScaleFrameRows(level, plan, src.view(), banded.view, row, end);
+                    }
+                    CHECK(SameFrameBytes(expected.view(), banded.view));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE(ScaleFrameRowsStaysCloseToTheReference)
+{
+    for (const ScaleCase& size : CASES)
+    {
+        for (ScaleFilter filter : FILTERS)
+        {
+            MemoryFrameBuffer src(size.srcWidth, size.srcHeight, PixelFormat::I420);
+            FillFrameNoise(src.view(), size.srcHeight);
+            MemoryFrameBuffer reference(size.dstWidth, size.dstHeight, PixelFormat::I420);
+            ScaleFrameReference(filter, src.view(), reference.view());
+            MemoryFrameBuffer scaled(size.dstWidth, size.dstHeight, PixelFormat::I420);
+            FrameScaler scaler(filter);
+            scaler.scale(src.view(), scaled.view());
+            // Fixed point is off by a level or so, on noise at worst.
+            CHECK(FramePsnr(reference.view(), scaled.view()) > 40);
+        }
+    }
+
+    // A flat frame stays exactly flat.
+    MemoryFrameBuffer flat(100, 60, PixelFormat::NV12);
+    std::memset(flat.view().data, 77, flat.size());
+    MemoryFrameBuffer flatScaled(62, 150, PixelFormat::NV12);
+    FrameScaler bicubic(ScaleFilter::Bicubic);
+    bicubic.scale(flat.view(), flatScaled.view());
+    MemoryFrameBuffer expected(62, 150, PixelFormat::NV12);
+    std::memset(expected.view().data, 77, expected.size());
+    CHECK(SameFrameBytes(expected.view(), flatScaled.view()));
+    CHECK_EQUAL(100.0, FramePsnr(expected.view(), flatScaled.view()));
+}
+
+TEST_CASE(FrameScalerBandsAndCachesPlans)
+{
+    MemoryFrameBuffer src(320, 180, PixelFormat::NV12);
+    FillFrameNoise(src.view(), 11);
+    MemoryFrameBuffer expected(142, 100, PixelFormat::NV12);
+    FrameScaler single(ScaleFilter::Area, 1, SimdLevel::Scalar);
+    single.scale(src.view(), expected.view());
+
+    FrameScaler threaded(ScaleFilter::Area, 3);
+    MemoryFrameBuffer actual(142, 100, PixelFormat::NV12);
+    threaded.scale(src.view(), actual.view());
+    threaded.scale(src.view(), actual.view());
+    CHECK(SameFrameBytes(expected.view(), actual.view()));
+    CHECK_EQUAL(size_t(1), threaded.getPlanCount());
+
+    MemoryFrameBuffer other(64, 36, PixelFormat::NV12);
+    threaded.scale(src.view(), other.view());
+    CHECK_EQUAL(size_t(2), threaded.getPlanCount());
+
+    MemoryFrameBuffer i420(142, 100, PixelFormat::I420);
+    MemoryFrameBuffer rgb(142, 100, PixelFormat::RGB32);
+    MemoryFrameBuffer odd(143, 100, PixelFormat::NV12);
+    CHECK_THROWS(threaded.scale(src.view(), i420.view()), std::invalid_argument);
+    CHECK_THROWS(threaded.scale(src.view(), rgb.view()), std::invalid_argument);
+    CHECK_THROWS(threaded.scale(src.view(), odd.view()), std::invalid_argument);
+    CHECK_THROWS(ScaleFrameRows(SimdLevel::Scalar, single.getPlan(320, 180, 142, 100), src.view(), other.view(), 0, 36),
+        std::invalid_argument);
+    CHECK_THROWS(ScaleFrameRows(SimdLevel::Scalar, single.getPlan(320, 180, 142, 100), src.view(), expected.view(), 1, 4),
+        std::invalid_argument);
+}
+
+TEST_CASE(ScaleFilterNamesRoundTrip)
+{
+    for (ScaleFilter filter : FILTERS)
+    {
+        ScaleFilter parsed = ScaleFilter::Bilinear;
+        CHECK(ParseScaleFilter(ScaleFilterName(filter), parsed));
+        CHECK(parsed == filter);
+    }
+    ScaleFilter untouched = ScaleFilter::Area;
+    CHECK(!ParseScaleFilter("lanczos", untouched));
+    CHECK(untouched == ScaleFilter::Area);
+}
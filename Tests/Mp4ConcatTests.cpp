@@ -0,0 +1,200 @@
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Mp4Concat.h"
+#include "Mp4TestMovie.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    const uint64_t TICKS_PER_SECOND = 10000000;
+    const uint32_t VIDEO_TIMESCALE = 30000;
+    const uint32_t AUDIO_TIMESCALE = 44100;
+
+    // 10 frames at 29.97 fps and 14 AAC frames at 44.1 kHz: the audio ends
+    // about 8.6 ms before the video.
+    Mp4Movie MakeSegment(uint8_t videoDescription = 0)
+    {
+        return MakeMovie({
+            MakeTrack(1, Mp4Type("vide"), VIDEO_TIMESCALE, 10, 1001, 100, 4, videoDescription),
+            MakeTrack(2, Mp4Type("soun"), AUDIO_TIMESCALE, 14, 1024, 40, 7) });
+    }
+
+    Mp4Movie ReadBack(const std::string& file)
+    {
+        std::istringstream in(file, std::ios::binary);
+        return ReadMp4Movie(in);
+    }
+
+    uint64_t CeilTicks(uint64_t duration, uint64_t timescale)
+    {
+        return (duration * TICKS_PER_SECOND + timescale - 1) / timescale;
+    }
+}
+
+TEST_CASE(Mp4MovieRoundTripsThroughTheReader)
+{
+    Mp4Movie movie = MakeSegment();
+    const Mp4Movie read = ReadBack(MakeMovieFile(movie, 0));
+
+    CHECK_EQUAL(2u, read.tracks.size());
+    for (size_t t = 0; t < 2; ++t)
+    {
+        const Mp4Track& expected = movie.tracks[t];
+        const Mp4Track& actual = read.tracks[t];
+        CHECK_EQUAL(expected.trackId, actual.trackId);
+        CHECK_EQUAL(expected.timescale, actual.timescale);
+        CHECK(expected.sampleDescription == actual.sampleDescription);
+        CHECK_EQUAL(expected.samples.size(), actual.samples.size());
+        for (size_t i = 0; i < actual.samples.size(); ++i)
+        {
+            CHECK_EQUAL(expected.samples[i].duration, actual.samples[i].duration);
+            CHECK_EQUAL(expected.samples[i].sync, actual.samples[i].sync);
+        }
+        CHECK_EQUAL(expected.chunks.size(), actual.chunks.size());
+        for (size_t c = 0; c < actual.chunks.size(); ++c)
+        {
+            CHECK_EQUAL(expected.chunks[c].offset, actual.chunks[c].offset);
+            CHECK_EQUAL(expected.chunks[c].sampleCount, actual.chunks[c].sampleCount);
+        }
+    }
+}
+
+TEST_CASE(Mp4ConcatStretchesTracksOntoTheLongestAcrossTimescales)
+{
+    const size_t SEGMENTS = 5;
+    std::vector<std::string> files;
+    std::vector<Mp4Movie> segments;
+    for (size_t s = 0; s < SEGMENTS; ++s)
+    {
+        Mp4Movie movie = MakeSegment();
+        files.push_back(MakeMovieFile(movie, s));
+        segments.push_back(ReadBack(files.back()));
+    }
+
+    const Mp4ConcatPlan plan = PlanMp4Concat(segments);
+    std::vector<std::istringstream> inputs;
+    std::vector<std::istream*> streams;
+    for (const std::string& file : files)
+    {
+        inputs.emplace_back(file, std::ios::binary);
+    }
+    for (std::istringstream& in : inputs)
+    {
+        streams.push_back(&in);
+    }
+    std::ostringstream out(std::ios::binary);
+    const uint64_t written = WriteMp4Concat(plan, streams, out);
+    const std::string joined = out.str();
+    CHECK_EQUAL(joined.size(), written);
+
+    const Mp4Movie movie = ReadBack(joined);
+    CHECK_EQUAL(2u, movie.tracks.size());
+    const Mp4Track& video = movie.tracks[0];
+    const Mp4Track& audio = movie.tracks[1];
+    CHECK_EQUAL(10 * SEGMENTS, video.samples.size());
+    CHECK_EQUAL(14 * SEGMENTS, audio.samples.size());
+
+    // The video is the longer track and rounds to whole ticks, so it is
+    // never stretched.
+    for (const Mp4Sample& sample : video.samples)
+    {
+        CHECK_EQUAL(1001u, sample.duration);
+    }
+
+    // Each segment lasts as long as its video; after every segment the
+    // audio ends exactly where the video does, rounded down to its own
+    // timescale, however the rounding went before.
+    const uint64_t segmentTicks = CeilTicks(10 * 1001, VIDEO_TIMESCALE);
+    uint64_t audioEnd = 0;
+    int64_t maxStretch = 0;
+    for (size_t s = 0; s < SEGMENTS; ++s)
+    {
+        for (size_t i = 0; i < 14; ++i)
+        {
+            const Mp4Sample& sample = audio.samples[s * 14 + i];
+            audioEnd += sample.duration;
+            if (i < 13)
+            {
+                CHECK_EQUAL(1024u, sample.duration);
+            }
+            else
+            {
+                CHECK(sample.duration > 1024u);
+                maxStretch = std::max<int64_t>(maxStretch, static_cast<int64_t>(CeilTicks(sample.duration - 1024, AUDIO_TIMESCALE)));
+            }
+        }
+        CHECK_EQUAL(segmentTicks * (s + 1) * AUDIO_TIMESCALE / TICKS_PER_SECOND, audioEnd);
+    }
+    CHECK_EQUAL(maxStretch, plan.maxStretch);
+
+    // Every sample's bytes, found through the rewritten chunk offsets, come
+    // from the right segment, track and position.
+    for (size_t t = 0; t < movie.tracks.size(); ++t)
+    {
+        const Mp4Track& track = movie.tracks[t];
+        const size_t perSegment = track.samples.size() / SEGMENTS;
+        for (const Mp4Chunk& chunk : track.chunks)
+        {
+            uint64_t offset = chunk.offset;
+            for (uint32_t i = 0; i < chunk.sampleCount; ++i)
+            {
+                const size_t sample = chunk.firstSample + i;
+                const uint8_t expected = SampleByte(sample / perSegment, t, sample % perSegment);
+                const uint32_t size = track.samples[sample].size;
+                CHECK(offset + size <= joined.size());
+                CHECK_EQUAL(std::string(size, static_cast<char>(expected)), joined.substr(static_cast<size_t>(offset), size));
+                offset += size;
+            }
+        }
+    }
+}
+
+TEST_CASE(Mp4HeaderSwitchesToCo64PerTrackPast4GiB)
+{
+    Mp4Movie movie = MakeMovie({
+        MakeTrack(1, Mp4Type("vide"), VIDEO_TIMESCALE, 4, 1001, 100, 2),
+        MakeTrack(2, Mp4Type("soun"), AUDIO_TIMESCALE, 2, 1024, 40, 2) });
+    movie.tracks[0].chunks[0].offset = 0;
+    movie.tracks[0].chunks[1].offset = 300;
+    movie.tracks[1].chunks[0].offset = 100;
+
+    const std::vector<uint8_t> small = WriteMp4MovieHeader(movie, 1000);
+    CHECK(ContainsMp4Type(small, "stco"));
+    CHECK(!ContainsMp4Type(small, "co64"));
+
+    // Only the video's second chunk lies past 4 GiB; that makes the whole
+    // video table 64-bit and leaves the audio one alone.
+    const uint64_t base = UINT32_MAX - 200ull;
+    const std::vector<uint8_t> large = WriteMp4MovieHeader(movie, base);
+    CHECK(ContainsMp4Type(large, "co64"));
+    CHECK(ContainsMp4Type(large, "stco"));
+
+    const Mp4Movie read = ReadBack(std::string(large.begin(), large.end()));
+    CHECK_EQUAL(base, read.tracks[0].chunks[0].offset);
+    CHECK_EQUAL(base + 300, read.tracks[0].chunks[1].offset);
+    CHECK_EQUAL(base + 100, read.tracks[1].chunks[0].offset);
+}
+
+TEST_CASE(Mp4ConcatRejectsSegmentsThatDoNotMatch)
+{
+    std::vector<Mp4Movie> segments;
+    segments.push_back(MakeSegment());
+    segments.push_back(MakeSegment(1));
+    CHECK_THROWS(PlanMp4Concat(segments), std::runtime_error);
+
+    segments[1] = MakeSegment();
+    segments[1].tracks[1].timescale = 48000;
+    CHECK_THROWS(PlanMp4Concat(segments), std::runtime_error);
+
+    segments[1] = MakeSegment();
+    segments[1].tracks.pop_back();
+    CHECK_THROWS(PlanMp4Concat(segments), std::runtime_error);
+
+    CHECK_THROWS(PlanMp4Concat(std::vector<Mp4Movie>()), std::invalid_argument);
+}
@@ -0,0 +1,281 @@
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ByteTarget.h"
+#include "Mp4Fragment.h"
+#include "Mp4TestMovie.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    const uint32_t VIDEO_TIMESCALE = 30000;
+    const uint32_t AUDIO_TIMESCALE = 44100;
+
+    class StringByteTarget : public ByteTarget
+    {
+    public:
+        void write(const uint8_t* data, size_t length) override
+        {
+            bytes.append(reinterpret_cast<const char*>(data), length);
+            stats.bytesWritten += length;
+            ++stats.writeCalls;
+        }
+
+        std::string bytes;
+    };
+
+    // One trun as the file has it, data offset already resolved.
+    struct Run
+    {
+        uint32_t sequenceNumber;
+        uint32_t trackId;
+        uint64_t baseDecodeTime;
+        uint64_t dataStart;         // file offset
+        std::vector<uint32_t> durations;
+        std::vector<uint32_t> sizes;
+        std::vector<bool> sync;
+    };
+
+    // Parses every moof by hand, independently of ReadMp4Fragments, and
+    // checks the layout the writer promises: moof then mdat, one traf per
+    // track with a tfhd based on the moof, a version 1 tfdt and a single
+    // trun with its own data offset, inside that mdat.
+    std::vector<Run> ParseRuns(const std::string& file)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(file.data());
+        const std::vector<Mp4BoxHeader> boxes = ReadMp4Boxes(p, 0, file.size());
+        std::vector<Run> runs;
+        for (size_t b = 0; b < boxes.size(); ++b)
+        {
+            if (boxes[b].type != Mp4Type("moof"))
+            {
+                continue;
+            }
+            const Mp4BoxHeader& moof = boxes[b];
+            CHECK(b + 1 < boxes.size());
+            const Mp4BoxHeader& mdat = boxes[b + 1];
+            CHECK_EQUAL(Mp4TypeName(Mp4Type("mdat")), Mp4TypeName(mdat.type));
+
+            const Mp4BoxHeader mfhd = RequireMp4Box(p, static_cast<size_t>(moof.payload()), static_cast<size_t>(moof.end()), Mp4Type("mfhd"));
+            Mp4Reader header(p, static_cast<size_t>(mfhd.payload()), static_cast<size_t>(mfhd.end()));
+            header.skip(4);
+            const uint32_t sequenceNumber = header.u32();
+
+            uint64_t previousEnd = mdat.payload();
+            for (const Mp4BoxHeader& traf : ReadMp4Boxes(p, static_cast<size_t>(moof.payload()), static_cast<size_t>(moof.end())))
+            {
+                if (traf.type != Mp4Type("traf"))
+                {
+                    continue;
+                }
+                const size_t begin = static_cast<size_t>(traf.payload());
+                const size_t end = static_cast<size_t>(traf.end());
+                Run run;
+                run.sequenceNumber = sequenceNumber;
+
+                Mp4Reader tfhd(p, static_cast<size_t>(RequireMp4Box(p, begin, end, Mp4Type("tfhd")).payload()), end);
+                CHECK_EQUAL(0x020000u, tfhd.u32());     // version 0, default-base-is-moof only
+                run.trackId = tfhd.u32();
+
+                const Mp4BoxHeader tfdtBox = RequireMp4Box(p, begin, end, Mp4Type("tfdt"));
+                Mp4Reader tfdt(p, static_cast<size_t>(tfdtBox.payload()), static_cast<size_t>(tfdtBox.end()));
+                CHECK_EQUAL(1u, static_cast<unsigned>(tfdt.u8()));
+                tfdt.skip(3);
+                run.baseDecodeTime = tfdt.u64();
+
+                const Mp4BoxHeader trunBox = RequireMp4Box(p, begin, end, Mp4Type("trun"));
+                Mp4Reader trun(p, static_cast<size_t>(trunBox.payload()), static_cast<size_t>(trunBox.end()));
+                const uint32_t flags = trun.u32() & 0xffffff;
+                CHECK_EQUAL(0x000701u, flags);          // data offset, duration, size and flags per sample
+                const uint32_t count = trun.u32();
+                run.dataStart = moof.offset + static_cast<int32_t>(trun.u32());
+                uint64_t bytes = 0;
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    run.durations.push_back(trun.u32());
+                    run.sizes.push_back(trun.u32());
+                    run.sync.push_back((trun.u32() & 0x00010000) == 0);
+                    bytes += run.sizes.back();
+                }
+                CHECK_EQUAL(0u, trun.remaining());
+
+                // Runs follow each other through the mdat without gaps.
+                CHECK_EQUAL(previousEnd, run.dataStart);
+                CHECK(run.dataStart + bytes <= mdat.end());
+                previousEnd = run.dataStart + bytes;
+                runs.push_back(run);
+            }
+            CHECK_EQUAL(mdat.end(), previousEnd);
+        }
+        return runs;
+    }
+
+    // Runs of each track pick up where the last one ended, in time and in
+    // sample order, and carry the track's samples byte for byte.
+    void CheckTracks(const std::string& file, const std::vector<Run>& runs, const Mp4Movie& movie)
+    {
+        for (size_t t = 0; t < movie.tracks.size(); ++t)
+        {
+            const Mp4Track& track = movie.tracks[t];
+            uint64_t decodeTime = 0;
+            size_t sample = 0;
+            for (const Run& run : runs)
+            {
+                if (run.trackId != track.trackId)
+                {
+                    continue;
+                }
+                CHECK_EQUAL(decodeTime, run.baseDecodeTime);
+                uint64_t offset = run.dataStart;
+                for (size_t i = 0; i < run.sizes.size(); ++i, ++sample)
+                {
+                    CHECK(sample < track.samples.size());
+                    CHECK_EQUAL(track.samples[sample].duration, run.durations[i]);
+                    CHECK_EQUAL(track.samples[sample].size, run.sizes[i]);
+                    CHECK_EQUAL(track.samples[sample].sync, static_cast<bool>(run.sync[i]));
+                    CHECK_EQUAL(std::string(run.sizes[i], static_cast<char>(SampleByte(0, t, sample))), file.substr(static_cast<size_t>(offset), run.sizes[i]));
+                    decodeTime += run.durations[i];
+                    offset += run.sizes[i];
+                }
+            }
+            CHECK_EQUAL(track.samples.size(), sample);
+        }
+    }
+
+    // 30 frames with a key frame every third, and the audio to go with it.
+    Mp4Movie MakeAudioVideo()
+    {
+        return MakeMovie({
+            MakeTrack(1, Mp4Type("vide"), VIDEO_TIMESCALE, 30, 1001, 100, 5),
+            MakeTrack(2, Mp4Type("soun"), AUDIO_TIMESCALE, 44, 1024, 40, 11) });
+    }
+
+    int64_t Ticks(uint64_t duration, uint32_t timescale)
+    {
+        return static_cast<int64_t>(duration * 10000000 / timescale);
+    }
+}
+
+TEST_CASE(FragmentedMp4WriterCutsAtTheFirstKeyFrameAfterTheDuration)
+{
+    const Mp4Movie movie = MakeAudioVideo();
+    StringByteTarget out;
+    // Six frames last 0.2002 s, so every other key frame starts a fragment.
+    FragmentedMp4Writer writer(movie, out, 2000000);
+
+    // Decode order across tracks, as a muxer would hand them over.
+    size_t video = 0;
+    size_t audio = 0;
+    std::vector<uint8_t> data;
+    while (video < 30 || audio < 44)
+    {
+        const bool takeVideo = audio == 44 || (video < 30 && Ticks(video * 1001, VIDEO_TIMESCALE) <= Ticks(audio * 1024, AUDIO_TIMESCALE));
+        const size_t track = takeVideo ? 0 : 1;
+        const size_t index = takeVideo ? video++ : audio++;
+        const Mp4Sample& sample = movie.tracks[track].samples[index];
+        data.assign(sample.size, SampleByte(0, track, index));
+        writer.writeSample(track, sample, data.data());
+    }
+    writer.finish();
+
+    const std::vector<Run> runs = ParseRuns(out.bytes);
+    CheckTracks(out.bytes, runs, movie);
+
+    const FragmentedMp4Stats& stats = writer.getStats();
+    CHECK_EQUAL(5u, stats.fragments);
+    CHECK_EQUAL(out.bytes.size(), stats.bytes);
+    CHECK_EQUAL(Ticks(6 * 1001, VIDEO_TIMESCALE), stats.longestFragment);
+
+    uint32_t sequenceNumber = 0;
+    for (const Run& run : runs)
+    {
+        if (run.trackId == 1)
+        {
+            CHECK_EQUAL(++sequenceNumber, run.sequenceNumber);
+            CHECK_EQUAL(6u, run.durations.size());
+            CHECK(run.sync[0]);
+        }
+    }
+    CHECK_EQUAL(5u, sequenceNumber);
+
+    // ReadMp4Fragments agrees on the structure.
+    std::istringstream in(out.bytes, std::ios::binary);
+    const std::vector<Mp4FragmentInfo> fragments = ReadMp4Fragments(in);
+    CHECK_EQUAL(5u, fragments.size());
+    uint64_t audioDuration = 0;
+    for (size_t f = 0; f < fragments.size(); ++f)
+    {
+        CHECK_EQUAL(f + 1, fragments[f].sequenceNumber);
+        CHECK_EQUAL(2u, fragments[f].tracks.size());
+        CHECK_EQUAL(6u * 1001, fragments[f].tracks[0].duration);
+        CHECK_EQUAL(6u * 1001 * f, fragments[f].tracks[0].baseDecodeTime);
+        CHECK(fragments[f].tracks[0].startsWithSync);
+        CHECK_EQUAL(audioDuration, fragments[f].tracks[1].baseDecodeTime);
+        audioDuration += fragments[f].tracks[1].duration;
+    }
+    CHECK_EQUAL(44u * 1024, audioDuration);
+}
+
+TEST_CASE(FragmentedMp4WriterClosesFragmentsWithoutKeyFramesEventually)
+{
+    Mp4Movie movie = MakeAudioVideo();
+    for (size_t i = 1; i < movie.tracks[0].samples.size(); ++i)
+    {
+        movie.tracks[0].samples[i].sync = false;
+    }
+    StringByteTarget out;
+    const int64_t fragmentDuration = 1000000;
+    FragmentedMp4Writer writer(movie, out, fragmentDuration);
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < 30; ++i)
+    {
+        data.assign(100, SampleByte(0, 0, i));
+        writer.writeSample(0, movie.tracks[0].samples[i], data.data());
+    }
+    writer.finish();
+
+    // 0.1 s fragments held to at most four times that: 12 frames each.
+    CHECK_EQUAL(3u, writer.getStats().fragments);
+    CHECK(writer.getStats().longestFragment <= MAX_FRAGMENT_FACTOR * fragmentDuration + Ticks(1001, VIDEO_TIMESCALE));
+    movie.tracks.pop_back();
+    CheckTracks(out.bytes, ParseRuns(out.bytes), movie);
+}
+
+TEST_CASE(RefragmentMp4KeepsEverySampleAndItsTiming)
+{
+    Mp4Movie movie = MakeAudioVideo();
+    const std::string file = MakeMovieFile(movie, 0);
+    std::istringstream in(file, std::ios::binary);
+    StringByteTarget out;
+    const FragmentedMp4Stats stats = RefragmentMp4(in, out, 2000000);
+
+    CHECK_EQUAL(5u, stats.fragments);
+    CHECK_EQUAL(out.bytes.size(), stats.bytes);
+    CheckTracks(out.bytes, ParseRuns(out.bytes), movie);
+
+    // The init segment comes first, the fragments right behind it.
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(out.bytes.data());
+    const std::vector<Mp4BoxHeader> boxes = ReadMp4Boxes(p, 0, out.bytes.size());
+    CHECK(boxes.size() >= 3);
+    CHECK_EQUAL(Mp4TypeName(Mp4Type("ftyp")), Mp4TypeName(boxes[0].type));
+    CHECK_EQUAL(Mp4TypeName(Mp4Type("moov")), Mp4TypeName(boxes[1].type));
+    CHECK_EQUAL(Mp4TypeName(Mp4Type("moof")), Mp4TypeName(boxes[2].type));
+}
+
+TEST_CASE(FragmentedMp4WriterRejectsUnusableSettings)
+{
+    StringByteTarget out;
+    CHECK_THROWS(FragmentedMp4Writer(MakeMovie({}), out), std::invalid_argument);
+    CHECK_THROWS(FragmentedMp4Writer(MakeAudioVideo(), out, 0), std::invalid_argument);
+
+    FragmentedMp4Writer writer(MakeAudioVideo(), out);
+    const uint8_t byte = 0;
+    CHECK_THROWS(writer.writeSample(2, Mp4Sample{ 1, 1, 0, true }, &byte), std::out_of_range);
+    CHECK_EQUAL(1u, static_cast<unsigned>(FramesPerFragment(0, 30, 1)));
+    CHECK_EQUAL(60u, static_cast<unsigned>(FramesPerFragment(DEFAULT_FRAGMENT_DURATION, 30000, 1001)));
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Mp4Box.h"
+#include "Mp4Concat.h"
+
+namespace VideoCoding
+{
+    namespace Testing
+    {
+
+        // Synthetic progressive movies, built from the same boxes an encoder
+        // writes, with sample data that says where it came from.
+
+        // Every byte of sample `sample` of track `track` in segment `segment`.
+        inline uint8_t SampleByte(size_t segment, size_t track, size_t sample)
+        {
+            return static_cast<uint8_t>(segment * 31 + track * 7 + sample + 1);
+        }
+
+        inline std::vector<uint8_t> MakeBox(uint32_t type, const std::vector<uint8_t>& payload = std::vector<uint8_t>())
+        {
+            Mp4BoxWriter writer;
+            writer.beginBox(type);
+            writer.bytes(payload);
+            writer.endBox();
+            return writer.data();
+        }
+
+        // A track of `count` samples of `size` bytes and `duration` ticks,
+        // `perChunk` samples to a chunk. `description` ends up in the single
+        // sample entry, so tracks that differ in it have different stsd.
+        inline Mp4Track MakeTrack(uint32_t trackId, uint32_t handler, uint32_t timescale, size_t count, uint32_t duration,
+            uint32_t size, uint32_t perChunk, uint8_t description = 0)
+        {
+            Mp4Track track = Mp4Track();
+            track.trackId = trackId;
+            track.handler = handler;
+            track.timescale = timescale;
+            track.language = 0x55C4;    // "und"
+            track.volume = handler == Mp4Type("soun") ? 0x0100 : 0;
+            track.matrix[0] = 1;
+            track.matrix[17] = 1;
+            track.matrix[32] = 0x40;
+            track.mediaTime = -1;
+
+            Mp4BoxWriter writer;
+            writer.beginFullBox(Mp4Type("hdlr"), 0, 0);
+            writer.u32(0);
+            writer.u32(handler);
+            writer.zeros(13);
+            writer.endBox();
+            track.handlerBox = writer.data();
+
+            writer.clear();
+            if (handler == Mp4Type("soun"))
+            {
+                writer.beginFullBox(Mp4Type("smhd"), 0, 0);
+                writer.zeros(4);
+            }
+            else
+            {
+                writer.beginFullBox(Mp4Type("vmhd"), 0, 1);
+                writer.zeros(8);
+            }
+            writer.endBox();
+            track.mediaHeaderBox = writer.data();
+
+            writer.clear();
+            writer.beginBox(Mp4Type("dinf"));
+            writer.beginFullBox(Mp4Type("dref"), 0, 0);
+            writer.u32(1);
+            writer.beginFullBox(Mp4Type("url "), 0, 1);
+            writer.endBox();
+            writer.endBox();
+            writer.endBox();
+            track.dataInformationBox = writer.data();
+
+            writer.clear();
+            writer.beginFullBox(Mp4Type("stsd"), 0, 0);
+            writer.u32(1);
+            writer.bytes(MakeBox(Mp4Type("test"), std::vector<uint8_t>(8, description)));
+            writer.endBox();
+            track.sampleDescription = writer.data();
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                // Every third sample is a key frame in video.
+                track.samples.push_back(Mp4Sample{ size, duration, 0, handler != Mp4Type("vide") || i % 3 == 0 });
+            }
+            for (size_t first = 0; first < count; first += perChunk)
+            {
+                const uint32_t inChunk = static_cast<uint32_t>(count - first < perChunk ? count - first : perChunk);
+                track.chunks.push_back(Mp4Chunk{ 0, static_cast<uint32_t>(first), inChunk });
+            }
+            return track;
+        }
+
+        inline Mp4Movie MakeMovie(const std::vector<Mp4Track>& tracks)
+        {
+            Mp4Movie movie = Mp4Movie();
+            Mp4BoxWriter writer;
+            writer.beginBox(Mp4Type("ftyp"));
+            writer.u32(Mp4Type("isom"));
+            writer.u32(0);
+            writer.u32(Mp4Type("isom"));
+            writer.endBox();
+            movie.fileTypeBox = writer.data();
+            movie.timescale = 1000;
+            movie.rate = 0x00010000;
+            movie.volume = 0x0100;
+            movie.matrix[0] = 1;
+            movie.matrix[17] = 1;
+            movie.matrix[32] = 0x40;
+            movie.tracks = tracks;
+            return movie;
+        }
+
+        // ftyp, mdat, moov: the chunks of all tracks taken in turn, so the
+        // tracks interleave, and filled as SampleByte says. Sets the chunk
+        // offsets of `movie` to where they landed.
+        inline std::string MakeMovieFile(Mp4Movie& movie, size_t segment)
+        {
+            std::vector<uint8_t> payload;
+            bool more = true;
+            for (size_t c = 0; more; ++c)
+            {
+                more = false;
+                for (size_t t = 0; t < movie.tracks.size(); ++t)
+                {
+                    Mp4Track& track = movie.tracks[t];
+                    if (c >= track.chunks.size())
+                    {
+                        continue;
+                    }
+                    more = true;
+                    Mp4Chunk& chunk = track.chunks[c];
+                    chunk.offset = movie.fileTypeBox.size() + 8 + payload.size();
+                    for (uint32_t i = 0; i < chunk.sampleCount; ++i)
+                    {
+                        const size_t sample = chunk.firstSample + i;
+                        payload.insert(payload.end(), track.samples[sample].size, SampleByte(segment, t, sample));
+                    }
+                }
+            }
+
+            Mp4Movie moovOnly = movie;
+            moovOnly.fileTypeBox.clear();
+            const std::vector<uint8_t> mdat = MakeBox(Mp4Type("mdat"), payload);
+            const std::vector<uint8_t> moov = WriteMp4MovieHeader(moovOnly, 0);
+
+            std::string file(movie.fileTypeBox.begin(), movie.fileTypeBox.end());
+            file.append(mdat.begin(), mdat.end());
+            file.append(moov.begin(), moov.end());
+            return file;
+        }
+
+        // Whether any box of that type appears in the data. Good enough for
+        // boxes whose four letters don't show up in the payloads around them.
+        inline bool ContainsMp4Type(const std::vector<uint8_t>& data, const char (&name)[5])
+        {
+            for (size_t i = 0; i + 4 <= data.size(); ++i)
+            {
+                if (std::memcmp(&data[i], name, 4) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    }
+}
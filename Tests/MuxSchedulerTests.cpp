@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "MuxScheduler.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    typedef MuxScheduler<uint64_t> Scheduler;
+    typedef Scheduler::Sample Sample;
+
+    // A stream of `count` back to back samples of `duration`. Counts what
+    // exists of it, from produce() until written or discarded, and
+    // remembers the most there ever were at once. Every few samples it
+    // sleeps, so streams run ahead of and behind each other.
+    struct MockStream
+    {
+        MockStream(uint64_t count, int64_t duration, unsigned sleepEvery)
+            : count(count), duration(duration), sleepEvery(sleepEvery), produced(0), live(0), maxLive(0) {}
+
+        bool produce(Sample& sample)
+        {
+            if (produced == count)
+            {
+                return false;
+            }
+            if (sleepEvery != 0 && produced % sleepEvery == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            sample.timestamp = static_cast<int64_t>(produced) * duration;
+            sample.duration = duration;
+            sample.item = produced++;
+            const size_t now = ++live;
+            size_t seen = maxLive.load();
+            while (now > seen && !maxLive.compare_exchange_weak(seen, now))
+            {
+            }
+            return true;
+        }
+
+        void release() { --live; }
+
+        const uint64_t count;
+        const int64_t duration;
+        const unsigned sleepEvery;
+        uint64_t produced;
+        std::atomic<size_t> live;
+        std::atomic<size_t> maxLive;
+    };
+
+    uint32_t AddStream(Scheduler& scheduler, MockStream& stream)
+    {
+        return scheduler.addStream([&stream](Sample& sample) { return stream.produce(sample); });
+    }
+}
+
+TEST_CASE(MuxSchedulerKeepsEachStreamInOrder)
+{
+    MockStream video(120, 333333, 7);
+    MockStream audio(300, 213333, 11);
+    Scheduler scheduler(4, 1000000);
+    const uint32_t videoIndex = AddStream(scheduler, video);
+    const uint32_t audioIndex = AddStream(scheduler, audio);
+
+    std::vector<uint64_t> next(2, 0);
+    const MuxStats stats = scheduler.run([&](Sample& sample)
+    {
+        CHECK(sample.stream == videoIndex || sample.stream == audioIndex);
+        CHECK_EQUAL(next[sample.stream], sample.item);
+        ++next[sample.stream];
+        (sample.stream == videoIndex ? video : audio).release();
+    });
+
+    CHECK_EQUAL(120u, next[videoIndex]);
+    CHECK_EQUAL(300u, next[audioIndex]);
+    CHECK_EQUAL(420u, stats.samplesWritten);
+}
+
+TEST_CASE(MuxSchedulerStepsBackNoMoreThanMaxSkew)
+{
+    const int64_t MAX_SKEW = 500000;
+    for (int64_t maxSkew : { static_cast<int64_t>(0), MAX_SKEW })
+    {
+        MockStream a(200, 400000, 5);
+        MockStream b(250, 320000, 3);
+        MockStream c(80, 1000000, 0);
+        Scheduler scheduler(2, maxSkew);
+        AddStream(scheduler, a);
+        AddStream(scheduler, b);
+        AddStream(scheduler, c);
+
+        bool first = true;
+        int64_t latest = 0;
+        int64_t observed = 0;
+        const MuxStats stats = scheduler.run([&](Sample& sample)
+        {
+            if (!first)
+            {
+                observed = std::max<int64_t>(observed, latest - sample.timestamp);
+            }
+            latest = first ? sample.timestamp : std::max<int64_t>(latest, sample.timestamp);
+            first = false;
+        });
+
+        CHECK_EQUAL(530u, stats.samplesWritten);
+        CHECK(observed <= maxSkew);
+        CHECK_EQUAL(observed, stats.maxSkew);
+    }
+}
+
+TEST_CASE(MuxSchedulerBuffersAtMostTheQueuePlusTwoPerStream)
+{
+    const size_t DEPTH = 4;     // a power of two, so the queue holds exactly this many
+    MockStream fast(400, 100000, 0);
+    MockStream slow(100, 400000, 2);
+    Scheduler scheduler(DEPTH, 0);
+    const uint32_t fastIndex = AddStream(scheduler, fast);
+    AddStream(scheduler, slow);
+
+    const MuxStats stats = scheduler.run([&](Sample& sample)
+    {
+        (sample.stream == fastIndex ? fast : slow).release();
+    });
+
+    CHECK_EQUAL(500u, stats.samplesWritten);
+    CHECK(fast.maxLive <= DEPTH + 2);
+    CHECK(slow.maxLive <= DEPTH + 2);
+    CHECK(stats.maxBuffered <= 2 * (DEPTH + 2));
+    CHECK_EQUAL(0u, fast.live.load());
+    CHECK_EQUAL(0u, slow.live.load());
+}
+
+TEST_CASE(MuxSchedulerDiscardsEverythingUnwrittenWhenTheWriterThrows)
+{
+    MockStream a(100, 100000, 0);
+    MockStream b(100, 150000, 0);
+    Scheduler scheduler(4, 0);
+    const uint32_t aIndex = AddStream(scheduler, a);
+    AddStream(scheduler, b);
+
+    uint64_t written = 0;
+    std::atomic<uint64_t> discarded(0);
+    std::atomic<bool> threwOnDiscarded(false);
+    std::atomic<uint32_t> failingStream(UINT32_MAX);
+    std::atomic<uint64_t> failingItem(0);
+    CHECK_THROWS(scheduler.run(
+        [&](Sample& sample)
+        {
+            if (written == 30)
+            {
+                failingItem = sample.item;
+                failingStream = sample.stream;
+                throw std::runtime_error("write failed");
+            }
+            ++written;
+            (sample.stream == aIndex ? a : b).release();
+        },
+        [&](Sample& sample)
+        {
+            ++discarded;
+            if (sample.stream == failingStream && sample.item == failingItem)
+            {
+                threwOnDiscarded = true;
+            }
+            (sample.stream == aIndex ? a : b).release();
+        }),
+        std::runtime_error);
+
+    CHECK_EQUAL(30u, written);
+    CHECK(threwOnDiscarded);
+    CHECK_EQUAL(a.produced + b.produced, written + discarded.load());
+    CHECK_EQUAL(0u, a.live.load());
+    CHECK_EQUAL(0u, b.live.load());
+}
+
+TEST_CASE(MuxSchedulerDiscardsEverythingUnwrittenWhenAProducerThrows)
+{
+    MockStream good(1000, 100000, 0);
+    MockStream bad(1000, 100000, 0);
+    Scheduler scheduler(4, 0);
+    const uint32_t goodIndex = AddStream(scheduler, good);
+    scheduler.addStream([&bad](Sample& sample)
+    {
+        if (bad.produced == 20)
+        {
+            throw std::runtime_error("produce failed");
+        }
+        return bad.produce(sample);
+    });
+
+    uint64_t written = 0;
+    std::atomic<uint64_t> discarded(0);
+    const auto streamOf = [&](const Sample& sample) -> MockStream& { return sample.stream == goodIndex ? good : bad; };
+    CHECK_THROWS(scheduler.run(
+        [&](Sample& sample) { ++written; streamOf(sample).release(); },
+        [&](Sample& sample) { ++discarded; streamOf(sample).release(); }),
+        std::runtime_error);
+
+    CHECK(good.produced < 1000);
+    CHECK_EQUAL(good.produced + bad.produced, written + discarded.load());
+    CHECK_EQUAL(0u, good.live.load());
+    CHECK_EQUAL(0u, bad.live.load());
+}
+
+TEST_CASE(MuxSchedulerRejectsStreamsGoingBackwards)
+{
+    Scheduler scheduler(2, 0);
+    int64_t timestamps[] = { 0, 10, 5 };
+    size_t next = 0;
+    scheduler.addStream([&](Sample& sample)
+    {
+        if (next == 3)
+        {
+            return false;
+        }
+        sample.timestamp = timestamps[next++];
+        sample.duration = 5;
+        return true;
+    });
+
+    std::atomic<uint64_t> released(0);
+    CHECK_THROWS(scheduler.run(
+        [&](Sample&) { ++released; },
+        [&](Sample&) { ++released; }),
+        std::logic_error);
+    CHECK_EQUAL(3u, released.load());
+}
@@ -0,0 +1,275 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "ProfileCache.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    VideoStreamFormat MakeVideoFormat(VideoCodec codec, uint32_t fpsNumerator, uint32_t fpsDenominator)
+    {
+        return VideoStreamFormat{ codec, PixelFormat::NV12, 1280, 720, fpsNumerator, fpsDenominator, 4000000, ColorMatrix::BT709, ColorRange::Limited };
+    }
+
+    AudioStreamFormat MakeAudioFormat(AudioCodec codec)
+    {
+        return AudioStreamFormat{ codec, 48000, 2, 16, 24000, 41 };
+    }
+
+    void CheckSame(const ProfileDescriptor& a, const ProfileDescriptor& b)
+    {
+        CHECK(a == b);
+        CHECK_EQUAL(HashProfileDescriptor(a), HashProfileDescriptor(b));
+        CHECK_EQUAL(ProfileDescriptorHash()(a), ProfileDescriptorHash()(b));
+        CHECK_EQUAL(DescribeProfile(a), DescribeProfile(b));
+    }
+
+    void CheckDifferent(const ProfileDescriptor& a, const ProfileDescriptor& b)
+    {
+        CHECK(a != b);
+        CHECK(HashProfileDescriptor(a) != HashProfileDescriptor(b));
+    }
+
+    // What get() hands out: the descriptor it was built from, and which build.
+    struct Built
+    {
+        ProfileDescriptor descriptor;
+        int build;
+    };
+}
+
+TEST_CASE(EquivalentDescriptorsCompareAndHashEqual)
+{
+    // 60/2 is 30/1; compressed output ignores the pixel format and colour.
+    VideoStreamFormat halved = MakeVideoFormat(VideoCodec::H264, 60, 2);
+    halved.pixelFormat = PixelFormat::RGB32;
+    halved.matrix = ColorMatrix::BT601;
+    halved.range = ColorRange::Full;
+    CheckSame(MakeVideoTypeDescriptor(ProfileUse::StreamOutput, MakeVideoFormat(VideoCodec::H264, 30, 1), 60),
+        MakeVideoTypeDescriptor(ProfileUse::StreamOutput, halved, 60));
+
+    // Input types are uncompressed and have no bitrate or key frames.
+    VideoStreamFormat input = MakeVideoFormat(VideoCodec::H264, 30000, 1001);
+    input.bitrate = 1;
+    CheckSame(MakeVideoTypeDescriptor(ProfileUse::StreamInput, MakeVideoFormat(VideoCodec::Uncompressed, 30000, 1001)),
+        MakeVideoTypeDescriptor(ProfileUse::StreamInput, input, 90));
+
+    // RGB32 input carries no YUV colour description.
+    VideoStreamFormat rgb = MakeVideoFormat(VideoCodec::Uncompressed, 25, 1);
+    rgb.pixelFormat = PixelFormat::RGB32;
+    VideoStreamFormat rgbFull = rgb;
+    rgbFull.matrix = ColorMatrix::BT601;
+    rgbFull.range = ColorRange::Full;
+    CheckSame(MakeVideoTypeDescriptor(ProfileUse::StreamInput, rgb), MakeVideoTypeDescriptor(ProfileUse::StreamInput, rgbFull));
+
+    // PCM has no bitrate or AAC profile of its own.
+    AudioStreamFormat pcm = MakeAudioFormat(AudioCodec::PCM);
+    pcm.bytesPerSecond = 0;
+    pcm.aacProfile = 0;
+    CheckSame(MakeAudioTypeDescriptor(ProfileUse::StreamInput, MakeAudioFormat(AudioCodec::PCM)),
+        MakeAudioTypeDescriptor(ProfileUse::StreamInput, pcm));
+
+    // A hand-made transcode descriptor, fields outside its use set, canonicalizes to the table one.
+    const H264ProfileInfo& video = h264_profiles[0];
+    const AACProfileInfo& audio = aac_profiles[0];
+    ProfileDescriptor handMade = ProfileDescriptor();
+    handMade.use = ProfileUse::Transcode;
+    handMade.container = ContainerType::FragmentedMPEG4;
+    handMade.hasVideo = true;
+    handMade.video = VideoStreamFormat{ VideoCodec::H264, PixelFormat::I420, video.width, video.height,
+        video.fpsNumerator * 3, video.fpsDenominator * 3, video.bitrate, ColorMatrix::BT601, ColorRange::Full };
+    handMade.videoProfile = video.profile;
+    handMade.keyframeSpacing = 48;
+    handMade.hasAudio = true;
+    handMade.audio = AudioStreamFormat{ AudioCodec::AAC, audio.samplesPerSec, audio.numChannels, audio.bitsPerSample, audio.bytesPerSec, audio.aacProfile };
+    CheckSame(MakeTranscodeDescriptor(audio, video, 48, ContainerType::FragmentedMPEG4), CanonicalProfileDescriptor(handMade));
+
+    // A stream carries one kind of media; the audio of a video stream is dropped.
+    ProfileDescriptor both = MakeVideoTypeDescriptor(ProfileUse::StreamOutput, MakeVideoFormat(VideoCodec::H264, 30, 1));
+    both.hasAudio = true;
+    both.audio = MakeAudioFormat(AudioCodec::AAC);
+    both.container = ContainerType::FragmentedMPEG4;
+    CheckSame(MakeVideoTypeDescriptor(ProfileUse::StreamOutput, MakeVideoFormat(VideoCodec::H264, 30, 1)), CanonicalProfileDescriptor(both));
+}
+
+TEST_CASE(DifferentDescriptorsCompareAndHashUnequal)
+{
+    const VideoStreamFormat format = MakeVideoFormat(VideoCodec::H264, 30, 1);
+    const ProfileDescriptor output = MakeVideoTypeDescriptor(ProfileUse::StreamOutput, format, 60);
+
+    VideoStreamFormat other = format;
+    other.width = 1920;
+    CheckDifferent(output, MakeVideoTypeDescriptor(ProfileUse::StreamOutput, other, 60));
+    other = format;
+    other.fpsNumerator = 30000;
+    other.fpsDenominator = 1001;
+    CheckDifferent(output, MakeVideoTypeDescriptor(ProfileUse::StreamOutput, other, 60));
+    other = format;
+    other.bitrate = 2000000;
+    CheckDifferent(output, MakeVideoTypeDescriptor(ProfileUse::StreamOutput, other, 60));
+    other = format;
+    other.codec = VideoCodec::WMV3;
+    CheckDifferent(output, MakeVideoTypeDescriptor(ProfileUse::StreamOutput, other, 60));
+    CheckDifferent(output, MakeVideoTypeDescriptor(ProfileUse::StreamOutput, format, 30));
+    CheckDifferent(output, MakeVideoTypeDescriptor(ProfileUse::StreamInput, format, 60));
+
+    // What input types do keep.
+    const ProfileDescriptor input = MakeVideoTypeDescriptor(ProfileUse::StreamInput, format);
+    other = format;
+    other.pixelFormat = PixelFormat::I420;
+    CheckDifferent(input, MakeVideoTypeDescriptor(ProfileUse::StreamInput, other));
+    other = format;
+    other.matrix = ColorMatrix::BT601;
+    CheckDifferent(input, MakeVideoTypeDescriptor(ProfileUse::StreamInput, other));
+    other = format;
+    other.range = ColorRange::Full;
+    CheckDifferent(input, MakeVideoTypeDescriptor(ProfileUse::StreamInput, other));
+
+    AudioStreamFormat aac = MakeAudioFormat(AudioCodec::AAC);
+    const ProfileDescriptor audio = MakeAudioTypeDescriptor(ProfileUse::StreamOutput, aac);
+    aac.bytesPerSecond = 16000;
+    CheckDifferent(audio, MakeAudioTypeDescriptor(ProfileUse::StreamOutput, aac));
+    aac = MakeAudioFormat(AudioCodec::AAC);
+    aac.channels = 1;
+    CheckDifferent(audio, MakeAudioTypeDescriptor(ProfileUse::StreamOutput, aac));
+    CheckDifferent(audio, MakeAudioTypeDescriptor(ProfileUse::StreamOutput, MakeAudioFormat(AudioCodec::PCM)));
+
+    CheckDifferent(MakeTranscodeDescriptor(aac_profiles[0], h264_profiles[0], 0, ContainerType::MPEG4),
+        MakeTranscodeDescriptor(aac_profiles[0], h264_profiles[0], 0, ContainerType::FragmentedMPEG4));
+    CheckDifferent(MakeTranscodeDescriptor(aac_profiles[0], h264_profiles[0], 0, ContainerType::MPEG4),
+        MakeTranscodeDescriptor(aac_profiles[1], h264_profiles[0], 0, ContainerType::MPEG4));
+    CheckDifferent(MakeTranscodeDescriptor(aac_profiles[0], h264_profiles[0], 0, ContainerType::MPEG4),
+        MakeTranscodeDescriptor(aac_profiles[0], h264_profiles[1], 0, ContainerType::MPEG4));
+}
+
+TEST_CASE(ProfileCacheBuildsEquivalentDescriptorsOnce)
+{
+    ProfileCache<Built> cache;
+    int builds = 0;
+    const auto create = [&builds](const ProfileDescriptor& key) { return Built{ key, ++builds }; };
+
+    ProfileDescriptor raw = ProfileDescriptor();
+    raw.use = ProfileUse::StreamOutput;
+    raw.hasVideo = true;
+    raw.video = MakeVideoFormat(VideoCodec::H264, 60, 2);
+    raw.video.pixelFormat = PixelFormat::RGB32;
+
+    const ProfileCache<Built>::Entry first = cache.get(raw, create);
+    const ProfileCache<Built>::Entry second = cache.get(MakeVideoTypeDescriptor(ProfileUse::StreamOutput, MakeVideoFormat(VideoCodec::H264, 30, 1)), create);
+    CHECK(first == second);
+    CHECK_EQUAL(1, builds);
+    // The factory sees the canonical form.
+    CHECK(first->descriptor == CanonicalProfileDescriptor(raw));
+    CHECK_EQUAL(30u, first->descriptor.video.fpsNumerator);
+
+    const ProfileCache<Built>::Entry third = cache.get(MakeVideoTypeDescriptor(ProfileUse::StreamOutput, MakeVideoFormat(VideoCodec::H264, 25, 1)), create);
+    CHECK(third != first);
+    CHECK_EQUAL(2, third->build);
+
+    ProfileCacheStats stats = cache.stats();
+    CHECK_EQUAL(1u, stats.hits);
+    CHECK_EQUAL(2u, stats.misses);
+    CHECK_EQUAL(0u, stats.failures);
+    CHECK_EQUAL(2u, stats.entries);
+
+    // Entries handed out outlive clear(); the next request builds anew.
+    cache.clear();
+    CHECK_EQUAL(0u, cache.stats().entries);
+    CHECK_EQUAL(1, first->build);
+    CHECK_EQUAL(3, cache.get(raw, create)->build);
+}
+
+TEST_CASE(ProfileCacheRetriesAFailedBuild)
+{
+    ProfileCache<Built> cache;
+    const ProfileDescriptor descriptor = MakeAudioTypeDescriptor(ProfileUse::StreamOutput, MakeAudioFormat(AudioCodec::AAC));
+    int builds = 0;
+    const auto failing = [&builds](const ProfileDescriptor&) -> Built
+    {
+        ++builds;
+        throw std::runtime_error("no encoder");
+    };
+    const auto create = [&builds](const ProfileDescriptor& key) { return Built{ key, ++builds }; };
+
+    CHECK_THROWS(cache.get(descriptor, failing), std::runtime_error);
+    ProfileCacheStats stats = cache.stats();
+    CHECK_EQUAL(1u, stats.failures);
+    CHECK_EQUAL(0u, stats.entries);
+
+    // Not a hit on the failed build: the next get() builds again.
+    CHECK_THROWS(cache.get(descriptor, failing), std::runtime_error);
+    CHECK_EQUAL(2, builds);
+    CHECK_EQUAL(3, cache.get(descriptor, create)->build);
+    CHECK_EQUAL(3, cache.get(descriptor, create)->build);
+
+    stats = cache.stats();
+    CHECK_EQUAL(1u, stats.hits);
+    CHECK_EQUAL(3u, stats.misses);
+    CHECK_EQUAL(2u, stats.failures);
+    CHECK_EQUAL(1u, stats.entries);
+}
+
+TEST_CASE(ProfileCacheSharesOneBuildBetweenConcurrentRequests)
+{
+    const size_t THREADS = 8;
+    ProfileCache<Built> cache;
+    const ProfileDescriptor descriptor = MakeVideoTypeDescriptor(ProfileUse::StreamInput, MakeVideoFormat(VideoCodec::Uncompressed, 30, 1));
+
+    // The first build fails slowly, so the others queue up behind it and
+    // all get its exception; then a slow success is shared the same way.
+    for (bool fail : { true, false })
+    {
+        std::atomic<int> builds(0);
+        std::atomic<size_t> started(0);
+        std::atomic<size_t> failures(0);
+        std::vector<ProfileCache<Built>::Entry> entries(THREADS);
+        const auto create = [&](const ProfileDescriptor& key)
+        {
+            const int build = ++builds;
+            while (started < THREADS)
+            {
+                std::this_thread::yield();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            if (fail)
+            {
+                throw std::runtime_error("no encoder");
+            }
+            return Built{ key, build };
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < THREADS; ++i)
+        {
+            threads.emplace_back([&, i]
+            {
+                ++started;
+                try
+                {
+                    entries[i] = cache.get(descriptor, create);
+                }
+                catch (const std::runtime_error&)
+                {
+                    ++failures;
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        CHECK_EQUAL(1, builds.load());
+        CHECK_EQUAL(fail ? THREADS : 0, failures.load());
+        for (const ProfileCache<Built>::Entry& entry : entries)
+        {
+            CHECK(entry == entries[0]);
+        }
+        CHECK_EQUAL(fail ? 0u : 1u, cache.stats().entries);
+    }
+}
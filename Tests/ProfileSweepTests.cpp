@@ -0,0 +1,199 @@
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "EncoderProfiles.h"
+#include "ProfileSweep.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    ProfileSweepResult Result(int audio, int video, double fps, double bitrate, uint64_t memoryGrowth)
+    {
+        ProfileSweepResult result = ProfileSweepResult();
+        result.point.audioProfile = audio;
+        result.point.videoProfile = video;
+        result.succeeded = true;
+        result.seconds = 2.5;
+        result.mediaDuration = 100000000;
+        result.outputBytes = 1250000;
+        result.framesPerSecond = fps;
+        result.realtimeFactor = 4;
+        result.outputBitrate = bitrate;
+        result.memoryGrowth = memoryGrowth;
+        return result;
+    }
+
+    ProfileSweepResult Failed(int audio, int video, const std::string& error)
+    {
+        ProfileSweepResult result = Result(audio, video, 0, 0, 0);
+        result.succeeded = false;
+        result.error = error;
+        return result;
+    }
+
+    std::vector<ProfileSweepRegression> Compare(const ProfileSweepResult& current, const ProfileSweepResult& baseline)
+    {
+        return CompareProfileSweep(std::vector<ProfileSweepResult>(1, current), std::vector<ProfileSweepResult>(1, baseline), 0.1);
+    }
+
+    bool Regressed(const std::vector<ProfileSweepRegression>& regressions, const std::string& metric)
+    {
+        for (const ProfileSweepRegression& regression : regressions)
+        {
+            if (regression.metric == metric)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+TEST_CASE(ProfileGridExpandsWildcardsOnce)
+{
+    const std::vector<ProfileSweepPoint> grid = ParseProfileGrid("*:*");
+    CHECK_EQUAL(AAC_PROFILE_COUNT * H264_PROFILE_COUNT, grid.size());
+    CHECK_EQUAL(0, grid.front().audioProfile);
+    CHECK_EQUAL(1, grid[1].videoProfile);
+    CHECK_EQUAL(static_cast<int>(AAC_PROFILE_COUNT) - 1, grid.back().audioProfile);
+    CHECK_EQUAL(static_cast<int>(H264_PROFILE_COUNT) - 1, grid.back().videoProfile);
+
+    const std::vector<ProfileSweepPoint> column = ParseProfileGrid("1:*");
+    CHECK_EQUAL(H264_PROFILE_COUNT, column.size());
+    for (size_t i = 0; i < column.size(); ++i)
+    {
+        CHECK_EQUAL(1, column[i].audioProfile);
+        CHECK_EQUAL(static_cast<int>(i), column[i].videoProfile);
+    }
+
+    // Repeats keep their first position.
+    const std::vector<ProfileSweepPoint> listed = ParseProfileGrid("1:2,0:0,1:2,*:0");
+    CHECK_EQUAL(AAC_PROFILE_COUNT + 1, listed.size());
+    CHECK_EQUAL(1, listed[0].audioProfile);
+    CHECK_EQUAL(2, listed[0].videoProfile);
+    CHECK_EQUAL(0, listed[1].audioProfile);
+    CHECK_EQUAL(0, listed[1].videoProfile);
+    CHECK_EQUAL(1, listed[2].audioProfile);
+    CHECK_EQUAL(0, listed[2].videoProfile);
+}
+
+TEST_CASE(ProfileGridRejectsMalformedPairs)
+{
+    const std::string pastAudio = std::to_string(AAC_PROFILE_COUNT) + ":0";
+    const std::string pastVideo = "0:" + std::to_string(H264_PROFILE_COUNT);
+    const char* malformed[] = { "", "1", "1-2", "-1:0", "a:0", "0:1x", "1:2,,0:0", "*:" };
+    for (const char* text : malformed)
+    {
+        CHECK_THROWS(ParseProfileGrid(text), std::invalid_argument);
+    }
+    CHECK_THROWS(ParseProfileGrid(pastAudio), std::invalid_argument);
+    CHECK_THROWS(ParseProfileGrid(pastVideo), std::invalid_argument);
+}
+
+TEST_CASE(ProfileSweepCsvRoundTrips)
+{
+    std::vector<ProfileSweepResult> results;
+    results.push_back(Result(0, 3, 29.97, 5.125e6, UINT64_C(123456789)));
+    results.push_back(Failed(2, 1, "no encoder, sorry\nreally"));
+    std::stringstream csv;
+    WriteProfileSweepCsv(csv, results);
+
+    const std::vector<ProfileSweepResult> read = ReadProfileSweepCsv(csv);
+    CHECK_EQUAL(size_t(2), read.size());
+    const ProfileSweepResult& ok = read[0];
+    CHECK_EQUAL(0, ok.point.audioProfile);
+    CHECK_EQUAL(3, ok.point.videoProfile);
+    CHECK(ok.succeeded);
+    CHECK(ok.error.empty());
+    CHECK_EQUAL(2.5, ok.seconds);
+    CHECK_EQUAL(INT64_C(100000000), ok.mediaDuration);
+    CHECK_EQUAL(UINT64_C(1250000), ok.outputBytes);
+    CHECK_EQUAL(29.97, ok.framesPerSecond);
+    CHECK_EQUAL(4.0, ok.realtimeFactor);
+    CHECK_EQUAL(5.125e6, ok.outputBitrate);
+    CHECK_EQUAL(UINT64_C(123456789), ok.memoryGrowth);
+
+    // The error loses the characters that would split the record.
+    CHECK(!read[1].succeeded);
+    CHECK_EQUAL(std::string("no encoder; sorry really"), read[1].error);
+}
+
+TEST_CASE(ProfileSweepCsvReadsOlderBaselines)
+{
+    // Written before memory growth was recorded, with Windows line ends.
+    std::istringstream csv(
+        "audio_profile,video_profile,succeeded,seconds,media_seconds,output_bytes,fps,realtime_factor,output_bitrate,error\r\n"
+        "1,4,1,3,10,2000000,60,3.5,1.6e+06,\r\n"
+        "\r\n");
+    const std::vector<ProfileSweepResult> read = ReadProfileSweepCsv(csv);
+    CHECK_EQUAL(size_t(1), read.size());
+    CHECK_EQUAL(1, read[0].point.audioProfile);
+    CHECK_EQUAL(4, read[0].point.videoProfile);
+    CHECK_EQUAL(60.0, read[0].framesPerSecond);
+    CHECK_EQUAL(1.6e6, read[0].outputBitrate);
+    CHECK_EQUAL(UINT64_C(0), read[0].memoryGrowth);
+
+    // Without a memory figure the baseline can't regress on memory.
+    CHECK(Compare(Result(1, 4, 60, 1.6e6, UINT64_C(1) << 30), read[0]).empty());
+
+    std::istringstream empty("");
+    CHECK_THROWS(ReadProfileSweepCsv(empty), std::runtime_error);
+    std::istringstream unprofiled("fps,seconds\n30,1\n");
+    CHECK_THROWS(ReadProfileSweepCsv(unprofiled), std::runtime_error);
+}
+
+TEST_CASE(ProfileSweepComparisonFlagsEachMetric)
+{
+    const uint64_t MB = 1 << 20;
+    const ProfileSweepResult baseline = Result(0, 0, 100, 2e6, 50 * MB);
+    CHECK(Compare(baseline, baseline).empty());
+
+    // Within the 10% tolerance.
+    CHECK(Compare(Result(0, 0, 91, 2.19e6, 50 * MB), baseline).empty());
+
+    std::vector<ProfileSweepRegression> slower = Compare(Result(0, 0, 89, 2e6, 50 * MB), baseline);
+    CHECK_EQUAL(size_t(1), slower.size());
+    CHECK_EQUAL(std::string("fps"), slower[0].metric);
+    CHECK_EQUAL(100.0, slower[0].baseline);
+    CHECK_EQUAL(89.0, slower[0].current);
+
+    std::vector<ProfileSweepRegression> larger = Compare(Result(0, 0, 100, 2.21e6, 50 * MB), baseline);
+    CHECK_EQUAL(size_t(1), larger.size());
+    CHECK_EQUAL(std::string("output_bitrate"), larger[0].metric);
+    CHECK(Compare(Result(0, 0, 100, 2.21e6, 50 * MB), Result(0, 0, 100, 0, 50 * MB)).empty());
+
+    std::vector<ProfileSweepRegression> failed = Compare(Failed(0, 0, "gone"), baseline);
+    CHECK_EQUAL(size_t(1), failed.size());
+    CHECK_EQUAL(std::string("failed"), failed[0].metric);
+    // A point that already failed can't regress.
+    CHECK(Compare(Failed(0, 0, "gone"), Failed(0, 0, "gone")).empty());
+
+    // Everything at once, reported together.
+    CHECK_EQUAL(size_t(3), Compare(Result(0, 0, 50, 3e6, 100 * MB), baseline).size());
+
+    // Points on one side only are skipped.
+    CHECK(Compare(Result(1, 0, 1, 9e9, 900 * MB), baseline).empty());
+}
+
+TEST_CASE(ProfileSweepComparisonAllowsSlackOnMemory)
+{
+    const uint64_t MB = 1 << 20;
+
+    // 20 MB to 28 MB is 40% more, but no more than the slack.
+    const ProfileSweepResult small = Result(0, 0, 100, 2e6, 20 * MB);
+    CHECK(Compare(Result(0, 0, 100, 2e6, 20 * MB + MEMORY_GROWTH_SLACK), small).empty());
+    const std::vector<ProfileSweepRegression> grown = Compare(Result(0, 0, 100, 2e6, 20 * MB + MEMORY_GROWTH_SLACK + 1), small);
+    CHECK_EQUAL(size_t(1), grown.size());
+    CHECK_EQUAL(std::string("memory_growth"), grown[0].metric);
+    CHECK_EQUAL(static_cast<double>(20 * MB), grown[0].baseline);
+
+    // Past the slack but within the tolerance.
+    const ProfileSweepResult large = Result(0, 0, 100, 2e6, 500 * MB);
+    CHECK(Compare(Result(0, 0, 100, 2e6, 540 * MB), large).empty());
+    CHECK(Regressed(Compare(Result(0, 0, 100, 2e6, 560 * MB), large), "memory_growth"));
+}
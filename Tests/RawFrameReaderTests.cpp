@@ -0,0 +1,175 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "MappedFile.h"
+#include "MemoryFrameBuffer.h"
+#include "RawFrameReader.h"
+#include "TestFrames.h"
+#include "TestHarness.h"
+#include "TestPattern.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    // A file in the working directory that is gone again at the end of the
+    // test, the way the benchmark handles its scratch files.
+    class ScratchFile
+    {
+    public:
+        ScratchFile(const std::string& path, const std::string& contents) : path(path)
+        {
+            std::ofstream out(path, std::ios::binary);
+            out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        }
+
+        ~ScratchFile() { std::remove(path.c_str()); }
+
+        const std::string path;
+    };
+
+    std::string NoiseBytes(size_t count, uint32_t key)
+    {
+        std::string bytes(count, '\0');
+        for (size_t i = 0; i < count; ++i)
+        {
+            bytes[i] = static_cast<char>(PatternHash(key + static_cast<uint32_t>(i)));
+        }
+        return bytes;
+    }
+
+    bool SameBytes(const uint8_t* data, const std::string& expected, size_t offset, size_t length)
+    {
+        return std::memcmp(data, expected.data() + offset, length) == 0;
+    }
+
+    RawFrameFormat RawFormat(PixelFormat format, uint32_t width, uint32_t height)
+    {
+        const RawFrameFormat raw = { format, width, height, 0, 1 };
+        return raw;
+    }
+}
+
+TEST_CASE(MappedFileSlidesItsWindowOverTheFile)
+{
+    const std::string contents = NoiseBytes(1000000, 3);
+    ScratchFile scratch("tests_mapped.tmp", contents);
+    MappedFile file(scratch.path, 64 << 10, 4096);
+    CHECK_EQUAL(UINT64_C(1000000), file.size());
+
+    for (uint64_t offset = 0; offset + 10000 <= file.size(); offset += 10000)
+    {
+        CHECK(SameBytes(file.map(offset, 10000), contents, static_cast<size_t>(offset), 10000));
+    }
+    const MappedFileStats forward = file.getStats();
+    CHECK(forward.maps > 1);
+    CHECK(forward.maps < 100);       // one window serves several requests
+    CHECK(forward.readaheadHints > 0);
+
+    // Backwards, longer than the window, and empty at the very end.
+    CHECK(SameBytes(file.map(12345, 100), contents, 12345, 100));
+    CHECK(SameBytes(file.map(70000, 300000), contents, 70000, 300000));
+    CHECK(file.map(file.size(), 0) != nullptr);
+    CHECK(SameBytes(file.map(999999, 1), contents, 999999, 1));
+
+    CHECK_THROWS(file.map(999999, 2), std::out_of_range);
+    CHECK_THROWS(file.map(1000001, 0), std::out_of_range);
+    CHECK_THROWS(MappedFile("tests_missing.tmp"), std::runtime_error);
+}
+
+TEST_CASE(RawFrameReaderReadsRawFramesInPlace)
+{
+    for (PixelFormat format : { PixelFormat::RGB32, PixelFormat::NV12, PixelFormat::I420 })
+    {
+        const size_t frameBytes = FrameBytes(format, 48, 20);
+        // Three frames and part of a fourth, which is ignored.
+        const std::string contents = NoiseBytes(frameBytes * 3 + frameBytes / 2, 5);
+        ScratchFile scratch("tests_raw.tmp", contents);
+        RawFrameReader reader(scratch.path, RawFormat(format, 48, 20), 4096);
+        CHECK_EQUAL(UINT64_C(3), reader.getFrameCount());
+
+        for (uint64_t index : { 0u, 1u, 2u, 0u })
+        {
+            const FrameView frame = reader.frame(index);
+            CHECK(frame.format == format);
+            CHECK_EQUAL(48u, frame.width);
+            CHECK_EQUAL(20u, frame.height);
+            CHECK_EQUAL(static_cast<ptrdiff_t>(RowBytes(format, 48)), frame.stride);
+            CHECK(SameBytes(frame.data, contents, static_cast<size_t>(index * frameBytes), frameBytes));
+        }
+        CHECK_THROWS(reader.frame(3), std::out_of_range);
+
+        // The producer copies the same frame into a sink buffer.
+        MappedFrameProducer producer(reader);
+        MemoryFrameBuffer sink(48, 20, format);
+        producer.render(sink.view(), 2);
+        CHECK(SameFrameBytes(reader.frame(2), sink.view()));
+    }
+
+    ScratchFile scratch("tests_raw.tmp", NoiseBytes(1000, 1));
+    CHECK_THROWS(RawFrameReader(scratch.path, RawFormat(PixelFormat::NV12, 0, 20)), std::invalid_argument);
+    CHECK_THROWS(RawFrameReader(scratch.path, RawFormat(PixelFormat::I420, 47, 20)), std::invalid_argument);
+    RawFrameReader odd(scratch.path, RawFormat(PixelFormat::RGB32, 5, 3));
+    CHECK_EQUAL(UINT64_C(16), odd.getFrameCount());
+}
+
+TEST_CASE(RawFrameReaderReadsY4mHeadersAndFrameMarkers)
+{
+    const size_t frameBytes = FrameBytes(PixelFormat::I420, 16, 10);
+    const std::string frames = NoiseBytes(frameBytes * 2, 9);
+    const std::string header = "YUV4MPEG2 W16 H10 F30000:1001 Ip A1:1 C420jpeg XYSCSS=420JPEG\n";
+    ScratchFile scratch("tests_reader.y4m",
+        header + "FRAME\n" + frames.substr(0, frameBytes) + "FRAME\n" + frames.substr(frameBytes) + "FRA");
+    RawFrameReader reader(scratch.path, RawFormat(PixelFormat::RGB32, 1, 1));
+
+    const RawFrameFormat& format = reader.getFormat();
+    CHECK(format.format == PixelFormat::I420);
+    CHECK_EQUAL(16u, format.width);
+    CHECK_EQUAL(10u, format.height);
+    CHECK_EQUAL(30000u, format.fpsNumerator);
+    CHECK_EQUAL(1001u, format.fpsDenominator);
+    CHECK_EQUAL(UINT64_C(2), reader.getFrameCount());
+    CHECK(SameBytes(reader.frame(1).data, frames, frameBytes, frameBytes));
+    CHECK(SameBytes(reader.frame(0).data, frames, 0, frameBytes));
+
+    // Frame parameters are allowed as long as every marker is as long.
+    ScratchFile tagged("tests_tagged.y4m", header + "FRAME Ip\n" + frames.substr(0, frameBytes) + "FRAME Ib\n" + frames.substr(frameBytes));
+    RawFrameReader taggedReader(tagged.path);
+    CHECK_EQUAL(UINT64_C(2), taggedReader.getFrameCount());
+    CHECK(SameBytes(taggedReader.frame(1).data, frames, frameBytes, frameBytes));
+
+    ScratchFile longer("tests_longer.y4m", header + "FRAME\n" + frames.substr(0, frameBytes) + "FRAME X\n" + frames.substr(frameBytes));
+    RawFrameReader longerReader(longer.path);
+    CHECK_THROWS(longerReader.frame(1), std::runtime_error);
+}
+
+TEST_CASE(RawFrameReaderRejectsMalformedY4m)
+{
+    const char* headers[] = {
+        "YUV4MPEG W16 H10\n",               // signature
+        "YUV4MPEG2 H10 F25:1\n",            // no width
+        "YUV4MPEG2 W15 H10\n",              // odd width
+        "YUV4MPEG2 W16 H10 C444\n",         // not 4:2:0
+        "YUV4MPEG2 W16 H10 F25\n",          // rate without denominator
+    };
+    for (const char* header : headers)
+    {
+        ScratchFile scratch("tests_bad.y4m", std::string(header) + "FRAME\n" + NoiseBytes(240, 1));
+        CHECK_THROWS(RawFrameReader(scratch.path), std::runtime_error);
+    }
+
+    ScratchFile unterminated("tests_bad.y4m", "YUV4MPEG2 W16 H10");
+    CHECK_THROWS(RawFrameReader(unterminated.path), std::runtime_error);
+
+    // A header and no frames is an empty stream.
+    ScratchFile empty("tests_empty.y4m", "YUV4MPEG2 W16 H10 F25:1\n");
+    CHECK_EQUAL(UINT64_C(0), RawFrameReader(empty.path).getFrameCount());
+    CHECK(IsY4mPath("clip.y4m"));
+    CHECK(!IsY4mPath("clip.yuv"));
+    CHECK(!IsY4mPath("y4m"));
+}
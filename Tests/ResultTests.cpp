@@ -0,0 +1,122 @@
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "Result.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    const int32_t E_TEST = static_cast<int32_t>(0x80004005);
+
+    int formatterCalls = 0;
+
+    std::string CountingFormatter(int32_t code)
+    {
+        ++formatterCalls;
+        return "formatted " + std::to_string(code);
+    }
+
+    int makeLine = 0;
+
+    Status Fail()
+    {
+        makeLine = __LINE__ + 1;
+        return MAKE_STATUS(E_TEST);
+    }
+
+    Status PassOn(bool fail, int& reached)
+    {
+        RETURN_IF_FAILED_STATUS(fail ? Fail() : Status());
+        ++reached;
+        return Status();
+    }
+
+    Result<std::unique_ptr<int>> MakeValue(bool fail)
+    {
+        RETURN_IF_FAILED_STATUS(fail ? Fail() : Status());
+        return std::unique_ptr<int>(new int(42));
+    }
+
+    // Counts live instances, to catch a Result that destroys too much or
+    // too little.
+    struct Tracked
+    {
+        explicit Tracked(int& live) : live(&live) { ++live; }
+        Tracked(Tracked&& other) : live(other.live) { ++*live; }
+        ~Tracked() { --*live; }
+
+        int* live;
+    };
+}
+
+TEST_CASE(StatusSucceedsForNonNegativeCodes)
+{
+    CHECK(Status().succeeded());
+    CHECK(MAKE_STATUS(0).succeeded());
+    CHECK(MAKE_STATUS(1).succeeded());      // S_FALSE
+
+    const Status failed = MAKE_STATUS(E_TEST);
+    CHECK(failed.failed());
+    CHECK_EQUAL(E_TEST, failed.getCode());
+    CHECK_EQUAL(std::string(__FILE__), std::string(failed.getFile()));
+}
+
+TEST_CASE(StatusKeepsTheSiteItWasMadeAt)
+{
+    int reached = 0;
+    const Status status = PassOn(true, reached);
+    CHECK(status.failed());
+    CHECK_EQUAL(0, reached);
+    CHECK_EQUAL(makeLine, status.getLine());
+
+    CHECK(PassOn(false, reached).succeeded());
+    CHECK_EQUAL(1, reached);
+}
+
+TEST_CASE(StatusFormatsOnlyWhenAsked)
+{
+    formatterCalls = 0;
+    int reached = 0;
+    const Status status = PassOn(true, reached);
+    Status copy = status;
+    CHECK_EQUAL(0, formatterCalls);
+
+    const std::string text = copy.toString(CountingFormatter);
+    CHECK_EQUAL(1, formatterCalls);
+    CHECK_EQUAL(std::string(__FILE__) + ":" + std::to_string(makeLine) + ": formatted " + std::to_string(E_TEST), text);
+    CHECK(status.toString().find("error 0x80004005") != std::string::npos);
+}
+
+TEST_CASE(ResultHoldsAValueOrAFailure)
+{
+    Result<std::unique_ptr<int>> value = MakeValue(false);
+    CHECK(value.succeeded());
+    CHECK(value.getStatus().succeeded());
+    CHECK_EQUAL(42, *value.value());
+    std::unique_ptr<int> taken = value.take();
+    CHECK_EQUAL(42, *taken);
+
+    Result<std::unique_ptr<int>> failure = MakeValue(true);
+    CHECK(failure.failed());
+    CHECK_EQUAL(E_TEST, failure.getStatus().getCode());
+    CHECK_EQUAL(makeLine, failure.getStatus().getLine());
+}
+
+TEST_CASE(ResultDestroysExactlyWhatItHolds)
+{
+    int live = 0;
+    {
+        Result<Tracked> value = Tracked(live);
+        CHECK_EQUAL(1, live);
+        Result<Tracked> moved(std::move(value));
+        CHECK_EQUAL(2, live);   // moved-from values are still destroyed
+        Result<Tracked> failure(MAKE_STATUS(E_TEST));
+        Result<Tracked> movedFailure(std::move(failure));
+        CHECK(movedFailure.failed());
+        CHECK_EQUAL(2, live);
+    }
+    CHECK_EQUAL(0, live);
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "SegmentPlanner.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    // Segments cover [0, duration) back to back, each at least minLength
+    // long, and every cut is on a keyframe.
+    void CheckPlan(const std::vector<MediaSegment>& segments, int64_t duration, const std::vector<int64_t>& keyframes, int64_t minLength)
+    {
+        CHECK(!segments.empty());
+        CHECK_EQUAL(0, segments.front().start);
+        CHECK_EQUAL(duration, segments.back().end);
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            CHECK(segments[i].end - segments[i].start >= minLength);
+            if (i > 0)
+            {
+                CHECK_EQUAL(segments[i - 1].end, segments[i].start);
+                CHECK(std::find(keyframes.begin(), keyframes.end(), segments[i].start) != keyframes.end());
+            }
+        }
+    }
+
+    void CheckCuts(const std::vector<MediaSegment>& segments, const std::vector<int64_t>& starts)
+    {
+        CHECK_EQUAL(starts.size(), segments.size());
+        for (size_t i = 0; i < segments.size() && i < starts.size(); ++i)
+        {
+            CHECK_EQUAL(starts[i], segments[i].start);
+        }
+    }
+}
+
+TEST_CASE(PlanSegmentsCutsOnTheKeyframeNearestTheSplit)
+{
+    const std::vector<int64_t> keyframes = RegularKeyframes(100, 10);
+    CHECK_EQUAL(10u, keyframes.size());
+
+    // 25 and 75 lie halfway between keyframes; ties go to the earlier one.
+    const std::vector<MediaSegment> segments = PlanSegments(100, keyframes, 4, 1);
+    CheckPlan(segments, 100, keyframes, 1);
+    CheckCuts(segments, { 0, 20, 50, 70 });
+}
+
+TEST_CASE(PlanSegmentsSortsAndDeduplicatesKeyframes)
+{
+    const std::vector<int64_t> keyframes = { 70, 20, 90, 50, 20, 0, 10, 70 };
+    const std::vector<MediaSegment> segments = PlanSegments(100, keyframes, 4, 1);
+    CheckPlan(segments, 100, keyframes, 1);
+    CheckCuts(segments, { 0, 20, 50, 70 });
+}
+
+TEST_CASE(PlanSegmentsReturnsFewerWhenKeyframesAreSparse)
+{
+    const std::vector<int64_t> keyframes = { 90, 0 };
+    const std::vector<MediaSegment> segments = PlanSegments(100, keyframes, 4, 1);
+    CheckPlan(segments, 100, keyframes, 1);
+    CheckCuts(segments, { 0, 90 });
+
+    CheckCuts(PlanSegments(100, { 0 }, 4, 1), { 0 });
+    CheckCuts(PlanSegments(100, std::vector<int64_t>(), 4, 1), { 0 });
+}
+
+TEST_CASE(PlanSegmentsKeepsEverySegmentAtLeastMinLength)
+{
+    const std::vector<int64_t> keyframes = RegularKeyframes(100, 10);
+    const std::vector<MediaSegment> segments = PlanSegments(100, keyframes, 4, 30);
+    CheckPlan(segments, 100, keyframes, 30);
+    CheckCuts(segments, { 0, 30, 60 });
+
+    // A cut that would leave the tail too short is dropped too.
+    const std::vector<int64_t> late = { 0, 95 };
+    CheckCuts(PlanSegments(100, late, 2, 10), { 0 });
+
+    // Longer than the input: nothing to split.
+    CheckCuts(PlanSegments(100, keyframes, 4, 200), { 0 });
+}
+
+TEST_CASE(PlanSegmentsSplitsLongInputsWithoutOverflow)
+{
+    // Ten hours in 100 ns units with a keyframe every two seconds.
+    const int64_t duration = 36000 * 10000000ll;
+    const std::vector<int64_t> keyframes = RegularKeyframes(duration, 20000000);
+    const std::vector<MediaSegment> segments = PlanSegments(duration, keyframes, 7, 1);
+    CheckPlan(segments, duration, keyframes, 1);
+    CHECK_EQUAL(7u, segments.size());
+    for (size_t i = 1; i < segments.size(); ++i)
+    {
+        const int64_t target = duration / 7 * static_cast<int64_t>(i);
+        CHECK(segments[i].start - target <= 10000000 && target - segments[i].start <= 10000000);
+    }
+}
+
+TEST_CASE(PlanSegmentsRejectsEmptyRequests)
+{
+    CHECK_THROWS(PlanSegments(0, { 0 }, 2, 1), std::invalid_argument);
+    CHECK_THROWS(PlanSegments(100, { 0 }, 0, 1), std::invalid_argument);
+    CHECK(RegularKeyframes(100, 0).empty());
+}
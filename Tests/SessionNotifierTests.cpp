@@ -0,0 +1,217 @@
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "SessionNotifier.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    typedef SessionNotifier::Clock Clock;
+
+    const SessionStatus FAILED = static_cast<SessionStatus>(0x80004005);
+
+    ProgressThrottle MakeThrottle(int intervalMs, double step)
+    {
+        const ProgressThrottle throttle = { std::chrono::milliseconds(intervalMs), step };
+        return throttle;
+    }
+
+    // Every progress update a notifier passed on.
+    std::shared_ptr<std::vector<SessionProgress>> RecordProgress(SessionNotifier& notifier)
+    {
+        std::shared_ptr<std::vector<SessionProgress>> updates = std::make_shared<std::vector<SessionProgress>>();
+        notifier.onProgress([updates](const SessionProgress& progress) { updates->push_back(progress); });
+        return updates;
+    }
+
+    std::shared_ptr<SessionNotifier> MakeSession(int64_t duration)
+    {
+        std::shared_ptr<SessionNotifier> notifier = std::make_shared<SessionNotifier>(MakeThrottle(0, 0.0));
+        notifier->setDuration(duration);
+        return notifier;
+    }
+}
+
+TEST_CASE(SessionNotifierThrottlesByStep)
+{
+    SessionNotifier notifier(MakeThrottle(0, 0.1));
+    notifier.setDuration(1000);
+    std::shared_ptr<std::vector<SessionProgress>> updates = RecordProgress(notifier);
+    const Clock::time_point now = Clock::now();
+
+    CHECK(notifier.reportPosition(10, now));        // the first always goes out
+    CHECK(!notifier.reportPosition(50, now));
+    CHECK(!notifier.reportPosition(109, now));
+    CHECK(notifier.reportPosition(110, now));
+    CHECK(!notifier.reportPosition(150, now));
+    CHECK(notifier.reportPosition(900, now));
+
+    CHECK_EQUAL(3u, updates->size());
+    CHECK_EQUAL(110, (*updates)[1].position);
+    CHECK_EQUAL(1000, (*updates)[1].duration);
+    CHECK(std::fabs((*updates)[2].fraction - 0.9) < 1e-9);
+    // The position still moves when an update is held back.
+    notifier.reportPosition(950, now);
+    CHECK_EQUAL(950, notifier.getProgress().position);
+}
+
+TEST_CASE(SessionNotifierThrottlesByInterval)
+{
+    SessionNotifier notifier(MakeThrottle(100, 0.0));
+    std::shared_ptr<std::vector<SessionProgress>> updates = RecordProgress(notifier);
+    const Clock::time_point start = Clock::now();
+
+    // Without a duration only the interval applies.
+    CHECK(notifier.reportPosition(1, start));
+    CHECK(!notifier.reportPosition(2, start + std::chrono::milliseconds(99)));
+    CHECK(notifier.reportPosition(3, start + std::chrono::milliseconds(100)));
+    CHECK(!notifier.reportPosition(4, start + std::chrono::milliseconds(150)));
+    CHECK(notifier.reportPosition(5, start + std::chrono::milliseconds(200)));
+    CHECK_EQUAL(3u, updates->size());
+    CHECK_EQUAL(0.0, (*updates)[2].fraction);
+
+    // With a duration both limits must be met.
+    SessionNotifier both(MakeThrottle(100, 0.5));
+    both.setDuration(100);
+    CHECK(both.reportPosition(0, start));
+    CHECK(!both.reportPosition(60, start + std::chrono::milliseconds(50)));
+    CHECK(!both.reportPosition(40, start + std::chrono::milliseconds(500)));
+    CHECK(both.reportPosition(60, start + std::chrono::milliseconds(500)));
+}
+
+TEST_CASE(SessionNotifierForcesAFinalFullReport)
+{
+    SessionNotifier notifier(MakeThrottle(1000, 0.5));
+    notifier.setDuration(1000);
+    std::shared_ptr<std::vector<SessionProgress>> updates = RecordProgress(notifier);
+    const Clock::time_point now = Clock::now();
+    notifier.reportPosition(100, now);
+    CHECK(!notifier.reportPosition(990, now));
+
+    notifier.complete(0);
+    CHECK_EQUAL(2u, updates->size());
+    CHECK_EQUAL(1.0, updates->back().fraction);
+    CHECK_EQUAL(1000, updates->back().position);
+    CHECK(!notifier.reportPosition(1000, now));     // nothing after completion
+    CHECK_EQUAL(2u, updates->size());
+
+    // A session that already reported 100% is not told twice.
+    SessionNotifier finished(MakeThrottle(0, 0.0));
+    finished.setDuration(10);
+    std::shared_ptr<std::vector<SessionProgress>> finishedUpdates = RecordProgress(finished);
+    finished.reportPosition(10, now);
+    finished.complete(0);
+    CHECK_EQUAL(1u, finishedUpdates->size());
+
+    // Nor is a failed one.
+    SessionNotifier failed(MakeThrottle(0, 0.0));
+    failed.setDuration(10);
+    std::shared_ptr<std::vector<SessionProgress>> failedUpdates = RecordProgress(failed);
+    failed.reportPosition(5, now);
+    failed.complete(FAILED);
+    CHECK_EQUAL(1u, failedUpdates->size());
+    CHECK_EQUAL(5, failed.getProgress().position);
+}
+
+TEST_CASE(SessionNotifierKeepsTheFirstCompletion)
+{
+    SessionNotifier notifier;
+    std::vector<SessionStatus> statuses;
+    notifier.onComplete([&statuses](SessionStatus status) { statuses.push_back(status); });
+    CHECK(!notifier.isComplete());
+
+    notifier.complete(FAILED);
+    notifier.complete(0);
+    CHECK(notifier.isComplete());
+    CHECK_EQUAL(1u, statuses.size());
+    CHECK_EQUAL(FAILED, statuses[0]);
+    CHECK_EQUAL(FAILED, notifier.completion().get());
+
+    // Registered after completion, it still runs, straight away.
+    notifier.onComplete([&statuses](SessionStatus status) { statuses.push_back(status); });
+    CHECK_EQUAL(2u, statuses.size());
+    CHECK_EQUAL(FAILED, statuses[1]);
+}
+
+TEST_CASE(SessionNotifierCompletesFromAnotherThread)
+{
+    std::shared_ptr<SessionNotifier> notifier = MakeSession(100);
+    std::thread source([notifier]()
+    {
+        for (int64_t position = 0; position <= 100; position += 10)
+        {
+            notifier->reportPosition(position);
+        }
+        notifier->complete(0);
+    });
+    const std::shared_future<SessionStatus> completion = notifier->completion();
+    CHECK_EQUAL(0, completion.get());
+    source.join();
+    CHECK_EQUAL(1.0, notifier->getProgress().fraction);
+}
+
+TEST_CASE(SessionGroupReturnsSessionsInCompletionOrder)
+{
+    SessionGroup group;
+    std::vector<std::shared_ptr<SessionNotifier>> sessions;
+    for (int i = 0; i < 3; ++i)
+    {
+        sessions.push_back(MakeSession(100));
+        CHECK_EQUAL(static_cast<size_t>(i), group.add(sessions.back()));
+    }
+    CHECK_EQUAL(3u, group.getCount());
+    CHECK_EQUAL(SessionGroup::NONE, group.waitNextFor(std::chrono::milliseconds(1)));
+
+    sessions[2]->complete(0);
+    sessions[0]->complete(FAILED);
+    CHECK_EQUAL(2u, group.waitNext());
+    CHECK_EQUAL(0u, group.waitNext());
+    CHECK_EQUAL(2u, group.getCompletedCount());
+    CHECK_EQUAL(1u, group.getFailedCount());
+    CHECK_EQUAL(FAILED, group.getStatus(0));
+    CHECK_EQUAL(0, group.getStatus(2));
+
+    // The last one finishes while waitNext() blocks.
+    std::thread source([&sessions]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        sessions[1]->complete(0);
+    });
+    CHECK_EQUAL(1u, group.waitNext());
+    source.join();
+    CHECK_EQUAL(SessionGroup::NONE, group.waitNext());
+    group.waitAll();
+    CHECK_EQUAL(3u, group.getCompletedCount());
+
+    // A session that completed before it was added is returned too.
+    std::shared_ptr<SessionNotifier> early = MakeSession(10);
+    early->complete(0);
+    CHECK_EQUAL(3u, group.add(early));
+    CHECK_EQUAL(3u, group.waitNext());
+}
+
+TEST_CASE(SessionGroupWeighsProgressByDuration)
+{
+    SessionGroup group;
+    CHECK_EQUAL(0.0, group.getProgress());
+
+    std::shared_ptr<SessionNotifier> shortSession = MakeSession(100);
+    std::shared_ptr<SessionNotifier> longSession = MakeSession(300);
+    std::shared_ptr<SessionNotifier> unknown = MakeSession(0);
+    group.add(shortSession);
+    group.add(longSession);
+    group.add(unknown);
+
+    shortSession->reportPosition(100);
+    unknown->reportPosition(1000);
+    CHECK(std::fabs(group.getProgress() - 0.25) < 1e-9);
+    longSession->reportPosition(150);
+    CHECK(std::fabs(group.getProgress() - 0.625) < 1e-9);
+    longSession->complete(0);
+    CHECK(std::fabs(group.getProgress() - 1.0) < 1e-9);
+}
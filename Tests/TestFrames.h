@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "FrameView.h"
+#include "TestPattern.h"
+
+namespace VideoCoding
+{
+    namespace Testing
+    {
+
+        // Frames and instruction sets for checking SIMD kernels against
+        // their scalar reference.
+
+        // Scalar and every vector level this CPU can run, in that order.
+        inline std::vector<SimdLevel> SupportedSimdLevels()
+        {
+            std::vector<SimdLevel> levels;
+            for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 })
+            {
+                if (level <= DetectSimdLevel())
+                {
+                    levels.push_back(level);
+                }
+            }
+            return levels;
+        }
+
+        // Rows of a frame as stored: luma then chroma rows for the planar
+        // formats, each RowBytes() long at the view's stride.
+        inline uint32_t StoredRows(const FrameView& frame)
+        {
+            return frame.format == PixelFormat::RGB32 ? frame.height : frame.height + frame.height / 2;
+        }
+
+        // Every byte of the frame from PatternHash, so no two rows or frames
+        // with different keys look alike.
+        inline void FillFrameNoise(const FrameView& frame, uint32_t key)
+        {
+            const size_t rowBytes = RowBytes(frame.format, frame.width);
+            for (uint32_t y = 0; y < StoredRows(frame); ++y)
+            {
+                uint8_t* row = frame.row(y);
+                for (size_t x = 0; x < rowBytes; ++x)
+                {
+                    row[x] = static_cast<uint8_t>(PatternHash(key + y * static_cast<uint32_t>(rowBytes) + static_cast<uint32_t>(x)));
+                }
+            }
+        }
+
+        // Pixel bytes equal, padding ignored, plane by plane so the strides
+        // may differ. Same geometry expected.
+        inline bool SameFrameBytes(const FrameView& a, const FrameView& b)
+        {
+            if (a.format != b.format || a.width != b.width || a.height != b.height)
+            {
+                return false;
+            }
+            const unsigned planes = a.format == PixelFormat::I420 ? 3 : a.format == PixelFormat::NV12 ? 2 : 1;
+            for (unsigned plane = 0; plane < planes; ++plane)
+            {
+                const size_t rowBytes = plane == 0 ? RowBytes(a.format, a.width) : a.format == PixelFormat::NV12 ? a.width : a.width / 2;
+                const uint32_t rows = plane == 0 ? a.height : a.height / 2;
+                for (uint32_t y = 0; y < rows; ++y)
+                {
+                    if (std::memcmp(a.plane(plane) + a.planeStride(plane) * static_cast<ptrdiff_t>(y),
+                        b.plane(plane) + b.planeStride(plane) * static_cast<ptrdiff_t>(y), rowBytes) != 0)
+                    {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // A frame whose rows are `padding` bytes longer than its pixels, which
+        // keeps it off the packed fast paths. Every byte starts out as `fill`.
+        struct PaddedFrame
+        {
+            PaddedFrame(uint32_t width, uint32_t height, PixelFormat format, size_t padding, uint8_t fill = 0)
+            {
+                const ptrdiff_t stride = static_cast<ptrdiff_t>(RowBytes(format, width) + padding);
+                storage.assign(FrameBytesForStride(format, height, stride), fill);
+                const FrameView frame = { storage.data(), stride, width, height, format, 0 };
+                view = frame;
+            }
+
+            std::vector<uint8_t> storage;
+            FrameView view;
+        };
+
+    }
+}
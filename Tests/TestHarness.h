@@ -0,0 +1,97 @@
+#pragma once
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace VideoCoding
+{
+    namespace Testing
+    {
+
+        typedef void (*TestFunction)();
+
+        struct TestCase
+        {
+            const char* name;
+            TestFunction function;
+        };
+
+        // Every TEST_CASE of the program, in registration order.
+        std::vector<TestCase>& TestRegistry();
+
+        struct TestRegistration
+        {
+            TestRegistration(const char* name, TestFunction function)
+            {
+                const TestCase test = { name, function };
+                TestRegistry().push_back(test);
+            }
+        };
+
+        // Thrown by a failed check, ending the test case.
+        class TestFailure : public std::runtime_error
+        {
+        public:
+            explicit TestFailure(const std::string& what) : std::runtime_error(what) {}
+        };
+
+        inline void Fail(const std::string& message, const char* file, int line)
+        {
+            std::ostringstream out;
+            out << file << ":" << line << ": " << message;
+            throw TestFailure(out.str());
+        }
+
+        template<typename Expected, typename Actual>
+        void CheckEqual(const Expected& expected, const Actual& actual, const char* expression, const char* file, int line)
+        {
+            if (!(expected == actual))
+            {
+                std::ostringstream message;
+                message << "CHECK_EQUAL(" << expression << "): expected " << expected << ", got " << actual;
+                Fail(message.str(), file, line);
+            }
+        }
+
+    }
+}
+
+// Defines and registers a test. Tests run in one process, one after the
+// other; a failed check ends only its own test.
+#define TEST_CASE(name) \
+    static void name(); \
+    static const VideoCoding::Testing::TestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            VideoCoding::Testing::Fail("CHECK(" #condition ")", __FILE__, __LINE__); \
+        } \
+    } while (0)
+
+// Both sides must be printable to an std::ostream.
+#define CHECK_EQUAL(expected, actual) \
+    VideoCoding::Testing::CheckEqual((expected), (actual), #expected ", " #actual, __FILE__, __LINE__)
+
+#define CHECK_THROWS(expression, Exception) \
+    do \
+    { \
+        bool thrown = false; \
+        try \
+        { \
+            expression; \
+        } \
+        catch (const Exception&) \
+        { \
+            thrown = true; \
+        } \
+        if (!thrown) \
+        { \
+            VideoCoding::Testing::Fail("CHECK_THROWS(" #expression ", " #Exception "): nothing thrown", __FILE__, __LINE__); \
+        } \
+    } while (0)
@@ -0,0 +1,55 @@
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+#include "TestHarness.h"
+
+namespace VideoCoding
+{
+    namespace Testing
+    {
+
+        std::vector<TestCase>& TestRegistry()
+        {
+            static std::vector<TestCase> registry;
+            return registry;
+        }
+
+    }
+}
+
+// Usage: Tests [name_substring]
+//
+// Runs every test whose name contains the substring, or all of them, and
+// prints a line per failure and a summary. Tests only use the portable
+// sources and need no files or devices. Exit status 1 if any test failed.
+int main(int argc, char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+    size_t run = 0;
+    size_t failed = 0;
+    for (const VideoCoding::Testing::TestCase& test : VideoCoding::Testing::TestRegistry())
+    {
+        if (std::strstr(test.name, filter) == nullptr)
+        {
+            continue;
+        }
+        ++run;
+        try
+        {
+            test.function();
+        }
+        catch (const VideoCoding::Testing::TestFailure& err)
+        {
+            ++failed;
+            std::cerr << "FAILED " << test.name << ": " << err.what() << std::endl;
+        }
+        catch (const std::exception& err)
+        {
+            ++failed;
+            std::cerr << "FAILED " << test.name << ": unexpected exception: " << err.what() << std::endl;
+        }
+    }
+    std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+    return failed == 0 && run > 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MemoryFrameBuffer.h"
+#include "TestFrames.h"
+#include "TestHarness.h"
+#include "TestPattern.h"
+
+using namespace VideoCoding;
+using namespace VideoCoding::Testing;
+
+namespace
+{
+    const TestPatternKind KINDS[] = {
+        TestPatternKind::ColorBars, TestPatternKind::Gradient, TestPatternKind::MovingBoxes,
+        TestPatternKind::ScrollingText, TestPatternKind::Noise,
+    };
+
+    MemoryFrameBuffer RenderPattern(const TestPatternSettings& settings, SimdLevel level, uint32_t width, uint32_t height, uint64_t frameIndex)
+    {
+        MemoryFrameBuffer frame(width, height, PixelFormat::RGB32);
+        TestPatternProducer(settings, level).render(frame.view(), frameIndex);
+        return frame;
+    }
+}
+
+TEST_CASE(FillNoiseMatchesPatternHashAtEverySimdLevel)
+{
+    // Counts that end inside and exactly on each vector width.
+    for (uint32_t count : { 0u, 1u, 3u, 4u, 7u, 8u, 9u, 31u, 64u, 1001u })
+    {
+        for (uint32_t key : { 0u, 12345u, 0xFFFFFFF0u })
+        {
+            for (SimdLevel level : SupportedSimdLevels())
+            {
+                std::vector<uint32_t> noise(count + 1, 0xDEADBEEF);
+                FillNoise(level, noise.data(), count, key);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    CHECK_EQUAL(PatternHash(key + i) & 0x00FFFFFFu, noise[i]);
+                }
+                CHECK_EQUAL(0xDEADBEEFu, noise[count]);
+            }
+        }
+    }
+}
+
+TEST_CASE(TestPatternIsIdenticalAtEverySimdLevel)
+{
+    for (TestPatternKind kind : KINDS)
+    {
+        const TestPatternSettings settings = { kind, 3, 0.7 };
+        for (uint64_t frame : { 0u, 1u, 29u })
+        {
+            const MemoryFrameBuffer expected = RenderPattern(settings, SimdLevel::Scalar, 98, 54, frame);
+            for (SimdLevel level : SupportedSimdLevels())
+            {
+                CHECK(SameFrameBytes(expected.view(), RenderPattern(settings, level, 98, 54, frame).view()));
+            }
+        }
+    }
+}
+
+TEST_CASE(TestPatternDependsOnlyOnSettingsSizeAndFrame)
+{
+    for (TestPatternKind kind : KINDS)
+    {
+        const TestPatternSettings settings = { kind, 9, 0.5 };
+        TestPatternProducer producer(settings);
+        MemoryFrameBuffer reused(64, 48, PixelFormat::RGB32);
+        // Out of order, and after another size, still renders the same frame.
+        producer.render(MemoryFrameBuffer(32, 16, PixelFormat::RGB32).view(), 40);
+        producer.render(reused.view(), 7);
+        CHECK(SameFrameBytes(RenderPattern(settings, SimdLevel::Scalar, 64, 48, 7).view(), reused.view()));
+    }
+
+    // Motion 0 is a still picture, and the seed matters for the random kinds.
+    for (TestPatternKind kind : KINDS)
+    {
+        const TestPatternSettings still = { kind, 1, 0.0 };
+        CHECK(SameFrameBytes(RenderPattern(still, SimdLevel::Scalar, 64, 48, 0).view(), RenderPattern(still, SimdLevel::Scalar, 64, 48, 10).view()));
+    }
+    const TestPatternSettings seed1 = { TestPatternKind::Noise, 1, 0.5 };
+    const TestPatternSettings seed2 = { TestPatternKind::Noise, 2, 0.5 };
+    CHECK(!SameFrameBytes(RenderPattern(seed1, SimdLevel::Scalar, 64, 48, 0).view(), RenderPattern(seed2, SimdLevel::Scalar, 64, 48, 0).view()));
+}
+
+TEST_CASE(TestPatternChangesMatchAFullRender)
+{
+    for (TestPatternKind kind : KINDS)
+    {
+        for (double motion : { 0.0, 0.3, 1.0 })
+        {
+            const TestPatternSettings settings = { kind, 5, motion };
+            TestPatternProducer producer(settings);
+            MemoryFrameBuffer frame(80, 60, PixelFormat::RGB32);
+            MemoryFrameBuffer previous(80, 60, PixelFormat::RGB32);
+            producer.renderFull(frame.view(), 0);
+            for (uint64_t index = 1; index < 12; ++index)
+            {
+                std::memcpy(previous.view().data, frame.view().data, frame.size());
+                DirtyRows changed;
+                producer.renderChanges(frame.view(), index, changed);
+                CHECK(SameFrameBytes(RenderPattern(settings, SimdLevel::Scalar, 80, 60, index).view(), frame.view()));
+
+                // Every row that differs from the previous frame was reported.
+                DirtyRows differing;
+                for (uint32_t y = 0; y < 60; ++y)
+                {
+                    if (std::memcmp(previous.view().row(y), frame.view().row(y), 80 * 4) != 0)
+                    {
+                        differing.addRow(y);
+                    }
+                }
+                DirtyRows covered = changed;
+                covered.merge(differing);
+                CHECK(covered.getRanges() == changed.getRanges());
+                if (motion == 0.0)
+                {
+                    CHECK(changed.isEmpty());
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE(TestPatternNamesRoundTrip)
+{
+    for (TestPatternKind kind : KINDS)
+    {
+        TestPatternKind parsed = TestPatternKind::Noise;
+        CHECK(ParseTestPattern(TestPatternName(kind), parsed));
+        CHECK(parsed == kind);
+    }
+    TestPatternKind untouched = TestPatternKind::Gradient;
+    CHECK(!ParseTestPattern("plaid", untouched));
+    CHECK(untouched == TestPatternKind::Gradient);
+
+    MemoryFrameBuffer nv12(16, 16, PixelFormat::NV12);
+    DirtyRows changed;
+    const TestPatternSettings settings = { TestPatternKind::ColorBars, 1, 0.5 };
+    CHECK_THROWS(TestPatternProducer(settings).render(nv12.view(), 0), std::invalid_argument);
+    CHECK_THROWS(TestPatternProducer(settings).renderChanges(nv12.view(), 1, changed), std::invalid_argument);
+}
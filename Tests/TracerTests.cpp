@@ -0,0 +1,177 @@
+#include <cstdint>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TestHarness.h"
+#include "Tracer.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    std::string ChromeTrace()
+    {
+        std::ostringstream out;
+        WriteChromeTrace(out);
+        return out.str();
+    }
+
+    // The distinct "tid" values of the dump.
+    std::set<std::string> TraceThreads(const std::string& trace)
+    {
+        std::set<std::string> threads;
+        const std::string key = "\"tid\": ";
+        for (size_t at = trace.find(key); at != std::string::npos; at = trace.find(key, at + 1))
+        {
+            const size_t begin = at + key.size();
+            threads.insert(trace.substr(begin, trace.find(',', begin) - begin));
+        }
+        return threads;
+    }
+
+    size_t Occurrences(const std::string& text, const std::string& needle)
+    {
+        size_t count = 0;
+        for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1))
+        {
+            ++count;
+        }
+        return count;
+    }
+}
+
+TEST_CASE(TracerRecordsNothingWhileStopped)
+{
+    StartTracing();
+    StopTracing();
+    CHECK(!IsTracing());
+    {
+        TRACE_SCOPE("stopped scope");
+        TraceInstant("stopped instant");
+        TraceCounter("stopped counter", 1);
+        SetTraceThreadName("stopped thread");
+    }
+
+    // A span begun while stopped stays unrecorded even if it ends in a run.
+    TraceScope* early = new TraceScope("early scope");
+    StartTracing();
+    delete early;
+    StopTracing();
+
+    const TraceStats stats = GetTraceStats();
+    CHECK_EQUAL(UINT64_C(0), stats.threads);
+    CHECK_EQUAL(UINT64_C(0), stats.events);
+    CHECK_EQUAL(UINT64_C(0), stats.dropped);
+    const std::string trace = ChromeTrace();
+    CHECK(trace.find("stopped") == std::string::npos);
+    CHECK(trace.find("early") == std::string::npos);
+}
+
+TEST_CASE(TracerGivesEachThreadItsOwnTrack)
+{
+    StartTracing();
+    TraceInstant("main instant");
+    std::vector<std::thread> workers;
+    for (int worker = 0; worker < 3; ++worker)
+    {
+        workers.emplace_back([]
+        {
+            SetTraceThreadName("worker");
+            for (int i = 0; i < 5; ++i)
+            {
+                TRACE_SCOPE("worker scope", i);
+                TraceCounter("worker counter", i);
+            }
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    StopTracing();
+
+    const TraceStats stats = GetTraceStats();
+    CHECK_EQUAL(UINT64_C(4), stats.threads);
+    CHECK_EQUAL(UINT64_C(31), stats.events);
+    CHECK_EQUAL(UINT64_C(0), stats.dropped);
+
+    const std::string trace = ChromeTrace();
+    CHECK_EQUAL(size_t(4), TraceThreads(trace).size());
+    CHECK_EQUAL(size_t(3), Occurrences(trace, "\"name\": \"thread_name\""));
+    CHECK_EQUAL(size_t(15), Occurrences(trace, "{\"ph\": \"X\", \"name\": \"worker scope\""));
+    CHECK_EQUAL(size_t(15), Occurrences(trace, "{\"ph\": \"C\", \"name\": \"worker counter\""));
+    CHECK_EQUAL(size_t(1), Occurrences(trace, "{\"ph\": \"i\", \"name\": \"main instant\""));
+}
+
+TEST_CASE(TracerCountsEventsThatFindTheBufferFull)
+{
+    StartTracing(4);
+    for (int i = 0; i < 10; ++i)
+    {
+        TraceInstant("kept or dropped", i);
+    }
+    std::thread other([]
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            TraceInstant("other thread", i);
+        }
+    });
+    other.join();
+    StopTracing();
+
+    const TraceStats stats = GetTraceStats();
+    CHECK_EQUAL(UINT64_C(2), stats.threads);
+    CHECK_EQUAL(UINT64_C(7), stats.events);
+    CHECK_EQUAL(UINT64_C(6), stats.dropped);
+
+    // The first events are the ones kept.
+    const std::string trace = ChromeTrace();
+    CHECK_EQUAL(size_t(4), Occurrences(trace, "\"kept or dropped\""));
+    CHECK(trace.find("\"args\": {\"arg\": 3}") != std::string::npos);
+    CHECK(trace.find("\"args\": {\"arg\": 4}") == std::string::npos);
+}
+
+TEST_CASE(StartTracingDiscardsTheEarlierRun)
+{
+    StartTracing(2);
+    SetTraceThreadName("first run thread");
+    for (int i = 0; i < 5; ++i)
+    {
+        TraceInstant("first run");
+    }
+    StopTracing();
+    CHECK_EQUAL(UINT64_C(3), GetTraceStats().dropped);
+
+    StartTracing();
+    TraceInstant("second run");
+    StopTracing();
+
+    const TraceStats stats = GetTraceStats();
+    CHECK_EQUAL(UINT64_C(1), stats.threads);
+    CHECK_EQUAL(UINT64_C(1), stats.events);
+    CHECK_EQUAL(UINT64_C(0), stats.dropped);
+    const std::string trace = ChromeTrace();
+    CHECK(trace.find("first run") == std::string::npos);
+    CHECK(trace.find("\"second run\"") != std::string::npos);
+    CHECK(trace.find("\"tid\": 0,") != std::string::npos);
+}
+
+TEST_CASE(TracerEscapesNamesForJson)
+{
+    StartTracing();
+    SetTraceThreadName("tab\there");
+    TraceInstant("say \"hi\" C:\\temp\nnext\001");
+    StopTracing();
+
+    const std::string trace = ChromeTrace();
+    CHECK(trace.find("\"say \\\"hi\\\" C:\\\\temp\\u000anext\\u0001\"") != std::string::npos);
+    CHECK(trace.find("\"tab\\u0009here\"") != std::string::npos);
+    CHECK(trace.find('\t') == std::string::npos);
+    CHECK(trace.find('\001') == std::string::npos);
+    // Raw newlines only separate the events.
+    CHECK_EQUAL(size_t(4), Occurrences(trace, "\n"));
+}
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TranscodeScheduler.h"
+#include "TestHarness.h"
+
+using namespace VideoCoding;
+
+namespace
+{
+    const uint64_t MB = 1ull << 20;
+
+    // What every fake runner of one batch saw, shared between the workers.
+    // A job's input names its behaviour:
+    //     "ok..."           succeeds
+    //     "retry<N>..."     fails retryably N times, then succeeds
+    //     "permanent..."    fails with a non-retryable TranscodeError
+    //     "throws..."       always fails with a plain std::runtime_error
+    struct FakeBatch
+    {
+        FakeBatch() : running(0), memoryInUse(0), maxRunning(0), maxMemory(0), runners(0) {}
+
+        std::mutex mutex;
+        size_t running;
+        uint64_t memoryInUse;
+        size_t maxRunning;
+        uint64_t maxMemory;
+        std::map<std::string, size_t> attempts;
+        std::map<std::string, size_t> mostAlongside;    // most jobs running at once during this one, itself included
+        std::map<std::string, size_t> activeCount;
+        std::atomic<size_t> runners;
+    };
+
+    class FakeRunner : public TranscodeRunner
+    {
+    public:
+        explicit FakeRunner(FakeBatch& batch) : batch(batch) { ++batch.runners; }
+
+        TranscodeOutcome transcode(const TranscodeJob& job) override
+        {
+            size_t attempt;
+            {
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                attempt = ++batch.attempts[job.input];
+                ++batch.running;
+                batch.memoryInUse += job.memoryEstimate;
+                batch.maxRunning = std::max(batch.maxRunning, batch.running);
+                batch.maxMemory = std::max(batch.maxMemory, batch.memoryInUse);
+                ++batch.activeCount[job.input];
+                for (const auto& active : batch.activeCount)
+                {
+                    if (active.second > 0)
+                    {
+                        size_t& most = batch.mostAlongside[active.first];
+                        most = std::max(most, batch.running);
+                    }
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            {
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                --batch.running;
+                batch.memoryInUse -= job.memoryEstimate;
+                --batch.activeCount[job.input];
+            }
+
+            if (job.input.compare(0, 5, "retry") == 0 && attempt <= static_cast<size_t>(job.input[5] - '0'))
+            {
+                throw TranscodeError("busy", true);
+            }
+            if (job.input.compare(0, 9, "permanent") == 0)
+            {
+                throw TranscodeError("unsupported", false);
+            }
+            if (job.input.compare(0, 6, "throws") == 0)
+            {
+                throw std::runtime_error("crashed");
+            }
+            const TranscodeOutcome outcome = { 10000000, 1000 };
+            return outcome;
+        }
+
+    private:
+        FakeBatch& batch;
+    };
+
+    TranscodeRunnerFactory FakeFactory(FakeBatch& batch)
+    {
+        return [&batch]() { return std::unique_ptr<TranscodeRunner>(new FakeRunner(batch)); };
+    }
+
+    TranscodeJob MakeJob(const std::string& input, uint64_t memoryEstimate = 0)
+    {
+        const TranscodeJob job = { input, input + ".mp4", 0, 0, memoryEstimate, 0, 0, 0 };
+        return job;
+    }
+
+    std::vector<TranscodeJob> MakeJobs(size_t count, uint64_t memoryEstimate = 0)
+    {
+        std::vector<TranscodeJob> jobs;
+        for (size_t i = 0; i < count; ++i)
+        {
+            jobs.push_back(MakeJob("ok" + std::to_string(i), memoryEstimate));
+        }
+        return jobs;
+    }
+
+    std::vector<TranscodeJob> ParseManifest(const std::string& text)
+    {
+        std::istringstream in(text);
+        return ParseTranscodeManifest(in);
+    }
+
+    // The manifest error for `text`, which must be rejected.
+    std::string ManifestError(const std::string& text)
+    {
+        try
+        {
+            ParseManifest(text);
+        }
+        catch (const std::invalid_argument& err)
+        {
+            return err.what();
+        }
+        VideoCoding::Testing::Fail("manifest accepted: " + text, __FILE__, __LINE__);
+        return std::string();
+    }
+}
+
+TEST_CASE(TranscodeSchedulerRunsNoMoreThanTheSessionLimit)
+{
+    FakeBatch batch;
+    const TranscodeSchedulerSettings settings = { 3, 0, 1 };
+    TranscodeScheduler scheduler(settings);
+    CHECK_EQUAL(3u, scheduler.getSessionLimit());
+
+    std::atomic<size_t> finished(0);
+    const TranscodeBatchReport report = scheduler.run(MakeJobs(12), FakeFactory(batch),
+        [&](const TranscodeJobReport&) { ++finished; });
+
+    CHECK(batch.maxRunning <= 3);
+    CHECK(report.peakSessions <= 3);
+    CHECK(batch.runners <= 3);      // one per worker, reused across jobs
+    CHECK_EQUAL(12u, finished.load());
+    CHECK_EQUAL(12u, report.succeeded);
+    CHECK_EQUAL(0u, report.failed);
+    CHECK_EQUAL(12 * INT64_C(10000000), report.mediaDuration);
+    CHECK_EQUAL(12u * 1000, report.outputBytes);
+    for (size_t i = 0; i < report.jobs.size(); ++i)
+    {
+        CHECK_EQUAL(i, report.jobs[i].index);
+        CHECK_EQUAL(1u, report.jobs[i].attempts);
+        CHECK_EQUAL(1u, batch.attempts["ok" + std::to_string(i)]);
+    }
+
+    // Never more workers than jobs, and an empty batch does nothing.
+    FakeBatch small;
+    scheduler.run(MakeJobs(2), FakeFactory(small));
+    CHECK(small.runners <= 2);
+    CHECK_EQUAL(0u, scheduler.run(std::vector<TranscodeJob>(), FakeFactory(small)).jobs.size());
+}
+
+TEST_CASE(TranscodeSchedulerAdmitsJobsWithinTheMemoryBudget)
+{
+    FakeBatch batch;
+    const TranscodeSchedulerSettings settings = { 8, 100 * MB, 1 };
+    const TranscodeBatchReport report = TranscodeScheduler(settings).run(MakeJobs(10, 40 * MB), FakeFactory(batch));
+
+    // Two 40 MB jobs fit in 100 MB, a third does not.
+    CHECK(batch.maxRunning <= 2);
+    CHECK(batch.maxMemory <= 100 * MB);
+    CHECK(report.peakMemory <= 100 * MB);
+    CHECK(report.peakSessions <= 2);
+    CHECK_EQUAL(10u, report.succeeded);
+}
+
+TEST_CASE(TranscodeSchedulerRunsAnOversizeJobAlone)
+{
+    FakeBatch batch;
+    const TranscodeSchedulerSettings settings = { 4, 100 * MB, 1 };
+    std::vector<TranscodeJob> jobs = MakeJobs(3, 40 * MB);
+    jobs.push_back(MakeJob("ok-huge", 250 * MB));
+    const std::vector<TranscodeJob> after = MakeJobs(3, 40 * MB);
+    for (const TranscodeJob& job : after)
+    {
+        jobs.push_back(MakeJob(job.input + "-after", 40 * MB));
+    }
+
+    const TranscodeBatchReport report = TranscodeScheduler(settings).run(jobs, FakeFactory(batch));
+    CHECK_EQUAL(7u, report.succeeded);
+    CHECK_EQUAL(1u, batch.mostAlongside["ok-huge"]);
+    CHECK_EQUAL(250 * MB, report.peakMemory);
+}
+
+TEST_CASE(TranscodeSchedulerRetriesOnlyRetryableFailures)
+{
+    FakeBatch batch;
+    const TranscodeSchedulerSettings settings = { 2, 0, 3 };
+    const std::vector<TranscodeJob> jobs = { MakeJob("retry2"), MakeJob("permanent"), MakeJob("throws"), MakeJob("retry9"), MakeJob("ok") };
+
+    std::mutex mutex;
+    std::map<std::string, size_t> finishedCalls;
+    const TranscodeBatchReport report = TranscodeScheduler(settings).run(jobs, FakeFactory(batch),
+        [&](const TranscodeJobReport& job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++finishedCalls[job.job.input];
+        });
+
+    // Recovers on the third and last attempt.
+    CHECK(report.jobs[0].succeeded);
+    CHECK_EQUAL(3u, report.jobs[0].attempts);
+    CHECK(report.jobs[0].error.empty());
+    // Not retried at all.
+    CHECK(!report.jobs[1].succeeded);
+    CHECK_EQUAL(1u, report.jobs[1].attempts);
+    CHECK_EQUAL(std::string("unsupported"), report.jobs[1].error);
+    // Unknown failures count as retryable.
+    CHECK(!report.jobs[2].succeeded);
+    CHECK_EQUAL(3u, report.jobs[2].attempts);
+    CHECK_EQUAL(std::string("crashed"), report.jobs[2].error);
+    CHECK(!report.jobs[3].succeeded);
+    CHECK_EQUAL(3u, report.jobs[3].attempts);
+    CHECK_EQUAL(std::string("busy"), report.jobs[3].error);
+    CHECK(report.jobs[4].succeeded);
+    CHECK_EQUAL(1u, report.jobs[4].attempts);
+
+    CHECK_EQUAL(2u, report.succeeded);
+    CHECK_EQUAL(3u, report.failed);
+    CHECK_EQUAL(6u, report.retries);
+    CHECK_EQUAL(5u, finishedCalls.size());
+    for (const auto& calls : finishedCalls)
+    {
+        CHECK_EQUAL(1u, calls.second);
+    }
+}
+
+TEST_CASE(TranscodeSchedulerCountsARunnerThatFailsToStartAgainstTheJob)
+{
+    FakeBatch batch;
+    std::atomic<int> factoryCalls(0);
+    const TranscodeSchedulerSettings settings = { 1, 0, 2 };
+    const TranscodeBatchReport report = TranscodeScheduler(settings).run(MakeJobs(2),
+        [&]() -> std::unique_ptr<TranscodeRunner>
+        {
+            if (++factoryCalls == 1)
+            {
+                throw std::runtime_error("no encoder");
+            }
+            return std::unique_ptr<TranscodeRunner>(new FakeRunner(batch));
+        });
+
+    CHECK_EQUAL(2, factoryCalls.load());
+    CHECK_EQUAL(2u, report.succeeded);
+    CHECK_EQUAL(1u, report.retries);
+    CHECK_EQUAL(2u, report.jobs[0].attempts);
+    CHECK_EQUAL(1u, report.jobs[1].attempts);
+}
+
+TEST_CASE(ParseTranscodeManifestReadsEveryField)
+{
+    const std::vector<TranscodeJob> jobs = ParseManifest(
+        "# input\toutput\n"
+        "\n"
+        "a.wmv\ta.mp4\n"
+        "b.wmv\tb.mp4\t2\r\n"
+        "c.wmv\tc.mp4\t1\t3\t64\n");
+    CHECK_EQUAL(3u, jobs.size());
+    CHECK_EQUAL(std::string("a.wmv"), jobs[0].input);
+    CHECK_EQUAL(std::string("a.mp4"), jobs[0].output);
+    CHECK_EQUAL(0, jobs[0].audioProfile);
+    CHECK_EQUAL(0, jobs[0].videoProfile);
+    CHECK_EQUAL(0u, jobs[0].memoryEstimate);
+    CHECK_EQUAL(std::string("b.mp4"), jobs[1].output);
+    CHECK_EQUAL(2, jobs[1].audioProfile);
+    CHECK_EQUAL(1, jobs[2].audioProfile);
+    CHECK_EQUAL(3, jobs[2].videoProfile);
+    CHECK_EQUAL(64 * MB, jobs[2].memoryEstimate);
+    CHECK(ParseManifest("").empty());
+}
+
+TEST_CASE(ParseTranscodeManifestNamesTheBadLine)
+{
+    const char* bad[] = {
+        "only-input\n",
+        "a\tb\t0\t0\t1\textra\n",
+        "\tb\n",
+        "a\t\n",
+        "a\tb\tx\n",
+        "a\tb\t-1\n",
+        "a\tb\t0\t3x\n",
+        "a\tb\t\t1\n",
+    };
+    for (const char* line : bad)
+    {
+        const std::string error = ManifestError(std::string("# header\nok\tok.mp4\n") + line);
+        CHECK(error.find("manifest line 3") != std::string::npos);
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace VideoCoding
+{
+
+    const size_t FRAME_ALIGNMENT = 64;
+
+    // Process-wide identity for frame buffers. Ids are never reused, so an id
+    // still names the same memory after the buffer went through a pool.
+    inline uint64_t NextBufferId()
+    {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    }
+
+    // Memory aligned to `alignment`, a power of two. Throws std::bad_alloc.
+    inline void* AlignedAllocate(size_t length, size_t alignment)
+    {
+        void* p = nullptr;
+#ifdef _WIN32
+        p = _aligned_malloc(length, alignment);
+#else
+        if (posix_memalign(&p, alignment, length) != 0)
+        {
+            p = nullptr;
+        }
+#endif
+        if (p == nullptr && length != 0)
+        {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    inline void AlignedFree(void* p)
+    {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+
+    // Owning, move-only block of memory aligned to a cache line (or more).
+    class AlignedBuffer
+    {
+    public:
+        AlignedBuffer() : data(nullptr), length(0), id(0) {}
+
+        AlignedBuffer(size_t length, size_t alignment = FRAME_ALIGNMENT)
+            : data(static_cast<uint8_t*>(AlignedAllocate(length, alignment))), length(length), id(NextBufferId())
+        {
+        }
+
+        AlignedBuffer(const AlignedBuffer&) = delete;
+        AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+        AlignedBuffer(AlignedBuffer&& other) : data(other.data), length(other.length), id(other.id)
+        {
+            other.data = nullptr;
+            other.length = 0;
+            other.id = 0;
+        }
+
+        AlignedBuffer& operator=(AlignedBuffer&& other)
+        {
+            if (this != &other)
+            {
+                free();
+                data = other.data;
+                length = other.length;
+                id = other.id;
+                other.data = nullptr;
+                other.length = 0;
+                other.id = 0;
+            }
+            return *this;
+        }
+
+        ~AlignedBuffer()
+        {
+            free();
+        }
+
+        uint8_t* get() const { return data; }
+        size_t size() const { return length; }
+        uint64_t getId() const { return id; }
+
+    private:
+        void free()
+        {
+            AlignedFree(data);
+            data = nullptr;
+        }
+
+        uint8_t* data;
+        size_t length;
+        uint64_t id;
+    };
+
+}
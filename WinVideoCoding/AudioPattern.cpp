@@ -0,0 +1,434 @@
+#include "AudioPattern.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "TestPattern.h"
+
+#ifdef VC_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        const double PI = 3.14159265358979323846;
+        const uint32_t GOLDEN = 0x9E3779B9u;
+
+        // Samples are rounded at 1/4096 LSB so the dither can be added exactly.
+        const float SCALE = 32767.0f * 4096.0f;
+        const float LOW = -32768.0f * 4096.0f;
+        const float HIGH = 32767.0f * 4096.0f;
+        const int32_t HALF_LSB = 2048;
+
+        // Dither values are generated this many at a time on the stack.
+        const uint32_t DITHER_CHUNK = 256;
+
+        const double MAX_FREQUENCY = 0.45;      // of the sample rate
+
+        struct AudioPatternEntry
+        {
+            AudioPatternKind kind;
+            const char* name;
+        };
+
+        const AudioPatternEntry AUDIO_PATTERN_NAMES[] =
+        {
+            { AudioPatternKind::Tone, "tone" },
+            { AudioPatternKind::Sweep, "sweep" },
+            { AudioPatternKind::Noise, "noise" },
+        };
+
+        // Difference of two 12-bit uniforms: triangular in (-4096, 4096).
+        inline int32_t DitherOffset(uint32_t noise)
+        {
+            return static_cast<int32_t>(noise & 0xFFF) - static_cast<int32_t>((noise >> 12) & 0xFFF);
+        }
+
+        // The comparisons mirror MAXPS/MINPS, including NaN going to LOW.
+        inline int16_t ConvertSample(float sample, int32_t dither)
+        {
+            float v = sample * SCALE;
+            v = v > LOW ? v : LOW;
+            v = v < HIGH ? v : HIGH;
+            const int32_t y = (static_cast<int32_t>(std::lrint(v)) + dither + HALF_LSB) >> 12;
+            return static_cast<int16_t>(y < -32768 ? -32768 : (y > 32767 ? 32767 : y));
+        }
+
+        void ScalarFloatToInt16(const float* src, int16_t* dst, size_t begin, size_t count, bool dither, uint32_t key)
+        {
+            for (size_t i = begin; i < count; ++i)
+            {
+                dst[i] = ConvertSample(src[i], dither ? DitherOffset(PatternHash(key + static_cast<uint32_t>(i)) & 0x00FFFFFF) : 0);
+            }
+        }
+
+        void ScalarInterleave(const int16_t* const* planes, uint32_t channels, size_t begin, size_t frames, int16_t* dst)
+        {
+            for (size_t i = begin; i < frames; ++i)
+            {
+                for (uint32_t c = 0; c < channels; ++c)
+                {
+                    dst[i * channels + c] = planes[c][i];
+                }
+            }
+        }
+
+        void ScalarDeinterleave(const int16_t* src, uint32_t channels, size_t begin, size_t frames, int16_t* const* planes)
+        {
+            for (size_t i = begin; i < frames; ++i)
+            {
+                for (uint32_t c = 0; c < channels; ++c)
+                {
+                    planes[c][i] = src[i * channels + c];
+                }
+            }
+        }
+
+#ifdef VC_X86
+        inline __m128i SSE2ScaleRound(const float* src)
+        {
+            __m128 v = _mm_mul_ps(_mm_loadu_ps(src), _mm_set1_ps(SCALE));
+            v = _mm_max_ps(v, _mm_set1_ps(LOW));
+            v = _mm_min_ps(v, _mm_set1_ps(HIGH));
+            return _mm_cvtps_epi32(v);
+        }
+
+        inline __m128i SSE2Dither(const uint32_t* noise)
+        {
+            const __m128i mask = _mm_set1_epi32(0xFFF);
+            const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(noise));
+            return _mm_sub_epi32(_mm_and_si128(r, mask), _mm_and_si128(_mm_srli_epi32(r, 12), mask));
+        }
+
+        inline __m128i SSE2Shift(__m128i x, __m128i dither)
+        {
+            return _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(x, dither), _mm_set1_epi32(HALF_LSB)), 12);
+        }
+
+        size_t SSE2FloatToInt16(const float* src, int16_t* dst, size_t count, bool dither, uint32_t key)
+        {
+            uint32_t noise[DITHER_CHUNK];
+            const __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            while (i + 8 <= count)
+            {
+                const uint32_t chunk = static_cast<uint32_t>(std::min<size_t>(DITHER_CHUNK, (count - i) & ~static_cast<size_t>(7)));
+                if (dither)
+                {
+                    FillNoise(SimdLevel::SSE2, noise, chunk, key + static_cast<uint32_t>(i));
+                }
+                for (uint32_t j = 0; j < chunk; j += 8)
+                {
+                    const __m128i a = SSE2Shift(SSE2ScaleRound(src + i + j), dither ? SSE2Dither(noise + j) : zero);
+                    const __m128i b = SSE2Shift(SSE2ScaleRound(src + i + j + 4), dither ? SSE2Dither(noise + j + 4) : zero);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + j), _mm_packs_epi32(a, b));
+                }
+                i += chunk;
+            }
+            return i;
+        }
+
+        VC_TARGET_AVX2 inline __m256i AVX2ScaleRound(const float* src)
+        {
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src), _mm256_set1_ps(SCALE));
+            v = _mm256_max_ps(v, _mm256_set1_ps(LOW));
+            v = _mm256_min_ps(v, _mm256_set1_ps(HIGH));
+            return _mm256_cvtps_epi32(v);
+        }
+
+        VC_TARGET_AVX2 inline __m256i AVX2Dither(const uint32_t* noise)
+        {
+            const __m256i mask = _mm256_set1_epi32(0xFFF);
+            const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(noise));
+            return _mm256_sub_epi32(_mm256_and_si256(r, mask), _mm256_and_si256(_mm256_srli_epi32(r, 12), mask));
+        }
+
+        VC_TARGET_AVX2 inline __m256i AVX2Shift(__m256i x, __m256i dither)
+        {
+            return _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(x, dither), _mm256_set1_epi32(HALF_LSB)), 12);
+        }
+
+        VC_TARGET_AVX2 size_t AVX2FloatToInt16(const float* src, int16_t* dst, size_t count, bool dither, uint32_t key)
+        {
+            uint32_t noise[DITHER_CHUNK];
+            const __m256i zero = _mm256_setzero_si256();
+            size_t i = 0;
+            while (i + 16 <= count)
+            {
+                const uint32_t chunk = static_cast<uint32_t>(std::min<size_t>(DITHER_CHUNK, (count - i) & ~static_cast<size_t>(15)));
+                if (dither)
+                {
+                    FillNoise(SimdLevel::AVX2, noise, chunk, key + static_cast<uint32_t>(i));
+                }
+                for (uint32_t j = 0; j < chunk; j += 16)
+                {
+                    const __m256i a = AVX2Shift(AVX2ScaleRound(src + i + j), dither ? AVX2Dither(noise + j) : zero);
+                    const __m256i b = AVX2Shift(AVX2ScaleRound(src + i + j + 8), dither ? AVX2Dither(noise + j + 8) : zero);
+                    // packs works per 128-bit lane: a0 b0 a1 b1 -> a0 a1 b0 b1.
+                    const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + j), packed);
+                }
+                i += chunk;
+            }
+            return i;
+        }
+
+        size_t SSE2InterleaveStereo(const int16_t* left, const int16_t* right, size_t frames, int16_t* dst)
+        {
+            size_t i = 0;
+            for (; i + 8 <= frames; i += 8)
+            {
+                const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+                const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), _mm_unpacklo_epi16(l, r));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+            }
+            return i;
+        }
+
+        VC_TARGET_AVX2 size_t AVX2InterleaveStereo(const int16_t* left, const int16_t* right, size_t frames, int16_t* dst)
+        {
+            size_t i = 0;
+            for (; i + 16 <= frames; i += 16)
+            {
+                const __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+                const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i));
+                // Per lane: lo = frames 0-3 | 8-11, hi = 4-7 | 12-15.
+                const __m256i lo = _mm256_unpacklo_epi16(l, r);
+                const __m256i hi = _mm256_unpackhi_epi16(l, r);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+            }
+            return i;
+        }
+
+        size_t SSE2DeinterleaveStereo(const int16_t* src, size_t frames, int16_t* left, int16_t* right)
+        {
+            size_t i = 0;
+            for (; i + 8 <= frames; i += 8)
+            {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i + 8));
+                // Sign-extend each half of the 32-bit pairs, then pack back.
+                const __m128i l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+                const __m128i r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(left + i), l);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(right + i), r);
+            }
+            return i;
+        }
+#endif
+    }
+
+    const char* AudioPatternName(AudioPatternKind kind)
+    {
+        for (const AudioPatternEntry& entry : AUDIO_PATTERN_NAMES)
+        {
+            if (entry.kind == kind)
+            {
+                return entry.name;
+            }
+        }
+        return "unknown";
+    }
+
+    bool ParseAudioPattern(const std::string& name, AudioPatternKind& kind)
+    {
+        for (const AudioPatternEntry& entry : AUDIO_PATTERN_NAMES)
+        {
+            if (name == entry.name)
+            {
+                kind = entry.kind;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    AudioPatternSettings DefaultAudioPatternSettings(AudioPatternKind kind)
+    {
+        const AudioPatternSettings settings = { kind, 1, 440.0, 20000.0, 10.0, 0.5f, true };
+        return settings;
+    }
+
+    void FloatToInt16(SimdLevel level, const float* src, int16_t* dst, size_t count, bool dither, uint32_t ditherKey)
+    {
+        size_t done = 0;
+        switch (level)
+        {
+#ifdef VC_X86
+        case SimdLevel::AVX2:
+            done = AVX2FloatToInt16(src, dst, count, dither, ditherKey);
+            break;
+        case SimdLevel::SSE2:
+            done = SSE2FloatToInt16(src, dst, count, dither, ditherKey);
+            break;
+#endif
+        default:
+            break;
+        }
+        ScalarFloatToInt16(src, dst, done, count, dither, ditherKey);
+    }
+
+    void InterleaveInt16(SimdLevel level, const int16_t* const* planes, uint32_t channels, size_t frames, int16_t* dst)
+    {
+        size_t done = 0;
+        if (channels == 2)
+        {
+            switch (level)
+            {
+#ifdef VC_X86
+            case SimdLevel::AVX2:
+                done = AVX2InterleaveStereo(planes[0], planes[1], frames, dst);
+                break;
+            case SimdLevel::SSE2:
+                done = SSE2InterleaveStereo(planes[0], planes[1], frames, dst);
+                break;
+#endif
+            default:
+                break;
+            }
+        }
+        ScalarInterleave(planes, channels, done, frames, dst);
+    }
+
+    void DeinterleaveInt16(SimdLevel level, const int16_t* src, uint32_t channels, size_t frames, int16_t* const* planes)
+    {
+        size_t done = 0;
+#ifdef VC_X86
+        // Bound by loads and stores, AVX2 gains nothing over SSE2 here.
+        if (channels == 2 && level != SimdLevel::Scalar)
+        {
+            done = SSE2DeinterleaveStereo(src, frames, planes[0], planes[1]);
+        }
+#else
+        (void)level;
+#endif
+        ScalarDeinterleave(src, channels, done, frames, planes);
+    }
+
+    // ------------------------------------------------------------------------
+
+    AudioPatternGenerator::AudioPatternGenerator(const AudioPatternSettings& settings, uint32_t sampleRate, uint32_t channels, SimdLevel level)
+        : settings(settings), sampleRate(sampleRate), channels(channels), level(level), sweepTo(0.0), sweepFrames(1)
+    {
+        if (sampleRate == 0 || channels == 0)
+        {
+            throw std::invalid_argument("AudioPatternGenerator: sample rate and channel count must be non-zero");
+        }
+        if (!(settings.frequency > 0.0) || !(settings.sweepSeconds > 0.0))
+        {
+            throw std::invalid_argument("AudioPatternGenerator: frequency and sweep length must be positive");
+        }
+        sweepTo = std::min(std::max(settings.sweepTo, settings.frequency), MAX_FREQUENCY * sampleRate);
+        sweepFrames = std::max<uint64_t>(1, static_cast<uint64_t>(std::llround(settings.sweepSeconds * sampleRate)));
+    }
+
+    uint32_t AudioPatternGenerator::ditherKey(uint32_t channel, uint64_t firstFrame) const
+    {
+        return PatternHash(~settings.seed + channel * GOLDEN) + static_cast<uint32_t>(firstFrame);
+    }
+
+    void AudioPatternGenerator::reserve(uint32_t frames)
+    {
+        const size_t samples = static_cast<size_t>(frames) * channels;
+        if (floatScratch.size() < samples)
+        {
+            floatScratch.resize(samples);
+            intScratch.resize(samples);
+        }
+        if (settings.kind == AudioPatternKind::Noise && noiseScratch.size() < frames)
+        {
+            noiseScratch.resize(frames);
+        }
+    }
+
+    void AudioPatternGenerator::renderFloat(float* const* planes, uint64_t firstFrame, uint32_t frames)
+    {
+        for (uint32_t c = 0; c < channels; ++c)
+        {
+            switch (settings.kind)
+            {
+            case AudioPatternKind::Tone:
+                renderTone(planes[c], c, firstFrame, frames);
+                break;
+            case AudioPatternKind::Sweep:
+                renderSweep(planes[c], firstFrame, frames);
+                break;
+            case AudioPatternKind::Noise:
+                renderNoise(planes[c], c, firstFrame, frames);
+                break;
+            }
+        }
+    }
+
+    void AudioPatternGenerator::render(int16_t* dst, uint64_t firstFrame, uint32_t frames)
+    {
+        reserve(frames);
+
+        // At most a handful of channels, keep the plane pointers off the heap.
+        const uint32_t MAX_CHANNELS = 8;
+        if (channels > MAX_CHANNELS)
+        {
+            throw std::invalid_argument("AudioPatternGenerator: too many channels");
+        }
+        float* floatPlanes[MAX_CHANNELS];
+        int16_t* intPlanes[MAX_CHANNELS];
+        for (uint32_t c = 0; c < channels; ++c)
+        {
+            floatPlanes[c] = &floatScratch[static_cast<size_t>(c) * frames];
+            intPlanes[c] = &intScratch[static_cast<size_t>(c) * frames];
+        }
+
+        renderFloat(floatPlanes, firstFrame, frames);
+        for (uint32_t c = 0; c < channels; ++c)
+        {
+            FloatToInt16(level, floatPlanes[c], intPlanes[c], frames, settings.dither, ditherKey(c, firstFrame));
+        }
+        InterleaveInt16(level, intPlanes, channels, frames, dst);
+    }
+
+    void AudioPatternGenerator::renderTone(float* plane, uint32_t channel, uint64_t firstFrame, uint32_t frames) const
+    {
+        const double cyclesPerFrame = std::min(settings.frequency * (1.0 + 0.5 * channel), MAX_FREQUENCY * sampleRate) / sampleRate;
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            double cycles = cyclesPerFrame * static_cast<double>(firstFrame + i);
+            cycles -= std::floor(cycles);
+            plane[i] = settings.amplitude * static_cast<float>(std::sin(2.0 * PI * cycles));
+        }
+    }
+
+    void AudioPatternGenerator::renderSweep(float* plane, uint64_t firstFrame, uint32_t frames) const
+    {
+        // Phase of an exponential sweep: f0 / k * (exp(k t) - 1) cycles,
+        // with k = ln(f1 / f0) / T.
+        const double f0 = settings.frequency;
+        const double seconds = static_cast<double>(sweepFrames) / sampleRate;
+        const double k = std::log(sweepTo / f0) / seconds;
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            const double t = static_cast<double>((firstFrame + i) % sweepFrames) / sampleRate;
+            double cycles = k > 0.0 ? f0 / k * (std::exp(k * t) - 1.0) : f0 * t;
+            cycles -= std::floor(cycles);
+            plane[i] = settings.amplitude * static_cast<float>(std::sin(2.0 * PI * cycles));
+        }
+    }
+
+    void AudioPatternGenerator::renderNoise(float* plane, uint32_t channel, uint64_t firstFrame, uint32_t frames)
+    {
+        reserve(frames);
+        FillNoise(level, noiseScratch.data(), frames, PatternHash(settings.seed + channel * GOLDEN) + static_cast<uint32_t>(firstFrame));
+        const float scale = settings.amplitude / 8388608.0f;
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            plane[i] = static_cast<float>(static_cast<int32_t>(noiseScratch[i]) - 0x800000) * scale;
+        }
+    }
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CpuFeatures.h"
+
+namespace VideoCoding
+{
+
+    enum class AudioPatternKind
+    {
+        Tone,       // sine per channel: frequency, 1.5 x frequency, 2 x frequency ...
+        Sweep,      // exponential sweep frequency -> sweepTo on every channel, repeating
+        Noise,      // seeded white noise, independent per channel
+    };
+
+    const char* AudioPatternName(AudioPatternKind kind);
+
+    // Accepts the names returned by AudioPatternName.
+    bool ParseAudioPattern(const std::string& name, AudioPatternKind& kind);
+
+    struct AudioPatternSettings
+    {
+        AudioPatternKind kind;
+        uint32_t seed;
+        double frequency;       // Hz, the tone or the start of the sweep
+        double sweepTo;         // Hz, limited to just below Nyquist
+        double sweepSeconds;
+        float amplitude;        // peak level, 1 is full scale
+        bool dither;            // TPDF dither when going to 16 bit
+    };
+
+    AudioPatternSettings DefaultAudioPatternSettings(AudioPatternKind kind);
+
+    // Bytes of `frames` interleaved 16-bit frames, the size of a pooled
+    // block for one profile.
+    inline size_t AudioBlockBytes(uint32_t channels, uint32_t frames)
+    {
+        return static_cast<size_t>(channels) * frames * sizeof(int16_t);
+    }
+
+    // Float -> 16 bit with optional triangular dither of +-1 LSB. The sample
+    // is scaled to 1/4096 LSB, rounded, the dither PatternHash(ditherKey + i)
+    // added in integer and the result shifted down and saturated, so the
+    // output is the same at every SimdLevel (NaN gives -32768).
+    void FloatToInt16(SimdLevel level, const float* src, int16_t* dst, size_t count, bool dither, uint32_t ditherKey);
+
+    // planes[c][i] <-> dst[i * channels + c]. Vectorized for stereo.
+    void InterleaveInt16(SimdLevel level, const int16_t* const* planes, uint32_t channels, size_t frames, int16_t* dst);
+    void DeinterleaveInt16(SimdLevel level, const int16_t* src, uint32_t channels, size_t frames, int16_t* const* planes);
+
+    // Deterministic PCM test signal. Sample N of a channel depends only on
+    // the settings, the sample rate and N, so blocks can be rendered in any
+    // size and order; 16-bit output is identical at every SimdLevel. Keeps
+    // scratch buffers, use one generator per thread.
+    class AudioPatternGenerator
+    {
+    public:
+        AudioPatternGenerator(const AudioPatternSettings& settings, uint32_t sampleRate, uint32_t channels, SimdLevel level = DetectSimdLevel());
+
+        // One float plane per channel, full scale is +-1.
+        void renderFloat(float* const* planes, uint64_t firstFrame, uint32_t frames);
+
+        // Interleaved 16-bit frames [firstFrame, firstFrame + frames).
+        void render(int16_t* dst, uint64_t firstFrame, uint32_t frames);
+
+        // Dither stream of a channel, for converting renderFloat output the
+        // same way render() does.
+        uint32_t ditherKey(uint32_t channel, uint64_t firstFrame) const;
+
+        const AudioPatternSettings& getSettings() const { return settings; }
+        uint32_t getSampleRate() const { return sampleRate; }
+        uint32_t getChannels() const { return channels; }
+
+    private:
+        void renderTone(float* plane, uint32_t channel, uint64_t firstFrame, uint32_t frames) const;
+        void renderSweep(float* plane, uint64_t firstFrame, uint32_t frames) const;
+        void renderNoise(float* plane, uint32_t channel, uint64_t firstFrame, uint32_t frames);
+
+        void reserve(uint32_t frames);
+
+        AudioPatternSettings settings;
+        uint32_t sampleRate;
+        uint32_t channels;
+        SimdLevel level;
+        double sweepTo;
+        uint64_t sweepFrames;
+
+        std::vector<float> floatScratch;
+        std::vector<int16_t> intScratch;
+        std::vector<uint32_t> noiseScratch;
+    };
+
+}
@@ -0,0 +1,201 @@
+#include "ByteTarget.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#endif
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        bool SeekFile(std::FILE* file, uint64_t position)
+        {
+#ifdef _WIN32
+            return _fseeki64(file, static_cast<__int64>(position), SEEK_SET) == 0;
+#else
+            return fseeko(file, static_cast<off_t>(position), SEEK_SET) == 0;
+#endif
+        }
+    }
+
+    void ByteTarget::seek(uint64_t)
+    {
+        throw std::logic_error("ByteTarget: target is not seekable");
+    }
+
+    size_t ByteTarget::read(uint8_t*, size_t)
+    {
+        throw std::logic_error("ByteTarget: target can't be read back");
+    }
+
+    // ------------------------------------------------------------------------
+
+    FileByteTarget::FileByteTarget(const std::string& path)
+        : file(nullptr), ownsFile(false), seekable(false), reading(false)
+    {
+        if (path == "-")
+        {
+            file = stdout;
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        }
+        else
+        {
+            file = std::fopen(path.c_str(), "w+b");
+            ownsFile = true;
+            seekable = true;
+        }
+        if (file == nullptr)
+        {
+            throw std::runtime_error("FileByteTarget: cannot open " + path);
+        }
+        // Callers batch their writes, stdio must not split them again.
+        std::setvbuf(file, nullptr, _IONBF, 0);
+    }
+
+    FileByteTarget::~FileByteTarget()
+    {
+        try
+        {
+            close();
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+
+    void FileByteTarget::write(const uint8_t* data, size_t length)
+    {
+        if (file == nullptr)
+        {
+            throw std::logic_error("FileByteTarget: write after close");
+        }
+        if (reading)
+        {
+            std::fseek(file, 0, SEEK_CUR);
+            reading = false;
+        }
+        if (std::fwrite(data, 1, length, file) != length)
+        {
+            throw std::runtime_error("FileByteTarget: write failed");
+        }
+        ++stats.writeCalls;
+        stats.bytesWritten += length;
+    }
+
+    void FileByteTarget::seek(uint64_t position)
+    {
+        if (!seekable || file == nullptr)
+        {
+            ByteTarget::seek(position);
+        }
+        if (!SeekFile(file, position))
+        {
+            throw std::runtime_error("FileByteTarget: seek failed");
+        }
+        reading = false;
+        ++stats.seeks;
+    }
+
+    size_t FileByteTarget::read(uint8_t* data, size_t length)
+    {
+        if (!seekable || file == nullptr)
+        {
+            return ByteTarget::read(data, length);
+        }
+        if (!reading)
+        {
+            std::fseek(file, 0, SEEK_CUR);
+            reading = true;
+        }
+        const size_t count = std::fread(data, 1, length, file);
+        if (count < length && std::ferror(file))
+        {
+            throw std::runtime_error("FileByteTarget: read failed");
+        }
+        return count;
+    }
+
+    void FileByteTarget::close()
+    {
+        if (file == nullptr)
+        {
+            return;
+        }
+        std::FILE* closing = file;
+        file = nullptr;
+        if (ownsFile ? std::fclose(closing) != 0 : std::fflush(closing) != 0)
+        {
+            throw std::runtime_error("FileByteTarget: failed to close output");
+        }
+    }
+
+    // ------------------------------------------------------------------------
+
+    MemoryRingTarget::MemoryRingTarget(size_t capacity)
+        : ring(capacity < 1 ? 1 : capacity), head(0), count(0), closed(false), cancelled(false)
+    {
+    }
+
+    void MemoryRingTarget::write(const uint8_t* data, size_t length)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (closed)
+        {
+            throw std::logic_error("MemoryRingTarget: write after close");
+        }
+        ++stats.writeCalls;
+        while (length > 0)
+        {
+            changed.wait(lock, [this] { return count < ring.size() || cancelled; });
+            if (cancelled)
+            {
+                throw std::runtime_error("MemoryRingTarget: consumer went away");
+            }
+            const size_t tail = (head + count) % ring.size();
+            const size_t chunk = std::min(length, std::min(ring.size() - count, ring.size() - tail));
+            std::memcpy(ring.data() + tail, data, chunk);
+            count += chunk;
+            data += chunk;
+            length -= chunk;
+            stats.bytesWritten += chunk;
+            changed.notify_all();
+        }
+    }
+
+    void MemoryRingTarget::close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        changed.notify_all();
+    }
+
+    size_t MemoryRingTarget::consume(uint8_t* data, size_t length)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return count > 0 || closed; });
+        const size_t chunk = std::min(length, std::min(count, ring.size() - head));
+        std::memcpy(data, ring.data() + head, chunk);
+        head = (head + chunk) % ring.size();
+        count -= chunk;
+        changed.notify_all();
+        return chunk;
+    }
+
+    void MemoryRingTarget::cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        changed.notify_all();
+    }
+
+}
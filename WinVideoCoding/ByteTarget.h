@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace VideoCoding
+{
+
+    struct ByteTargetStats
+    {
+        uint64_t bytesWritten;
+        uint64_t writeCalls;    // one per write that reached the OS or the ring
+        uint64_t seeks;
+    };
+
+    // Where encoded output ends up. Used from one thread at a time; errors
+    // throw std::runtime_error.
+    class ByteTarget
+    {
+    public:
+        virtual ~ByteTarget() {}
+
+        // Writes all of it at the current position.
+        virtual void write(const uint8_t* data, size_t length) = 0;
+
+        // Only seekable targets can be repositioned and read back, which a
+        // progressive MP4 needs to patch its header.
+        virtual bool canSeek() const { return false; }
+        virtual void seek(uint64_t position);
+        // Reads at the current position, returns 0 at the end.
+        virtual size_t read(uint8_t* data, size_t length);
+
+        // Pushes everything out; further writes throw.
+        virtual void close() {}
+
+        const ByteTargetStats& getStats() const { return stats; }
+
+    protected:
+        ByteTarget() : stats() {}
+
+        ByteTargetStats stats;
+    };
+
+    // A file, or stdout (not seekable) when the path is "-". Unbuffered, so
+    // every write is one call into the OS.
+    class FileByteTarget : public ByteTarget
+    {
+    public:
+        explicit FileByteTarget(const std::string& path);
+        ~FileByteTarget();
+
+        void write(const uint8_t* data, size_t length) override;
+        bool canSeek() const override { return seekable; }
+        void seek(uint64_t position) override;
+        size_t read(uint8_t* data, size_t length) override;
+        void close() override;
+
+    private:
+        std::FILE* file;
+        bool ownsFile;
+        bool seekable;
+        bool reading;           // C stdio needs a seek between reads and writes
+    };
+
+    // Bounded in-memory pipe to a consumer on another thread, so output can
+    // go to the next stage without touching disk. write() blocks while the
+    // ring is full, consume() while it is empty.
+    class MemoryRingTarget : public ByteTarget
+    {
+    public:
+        explicit MemoryRingTarget(size_t capacity);
+
+        void write(const uint8_t* data, size_t length) override;
+        // Ends the stream; consume() returns 0 once the rest is drained.
+        void close() override;
+
+        // Consumer side: up to `length` bytes, 0 at the end of the stream.
+        size_t consume(uint8_t* data, size_t length);
+        // Consumer side: gives up, so a blocked or later write throws.
+        void cancel();
+
+    private:
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<uint8_t> ring;
+        size_t head;            // next byte to consume
+        size_t count;
+        bool closed;
+        bool cancelled;
+    };
+
+}
@@ -0,0 +1,261 @@
+#include "CCoalescingByteStream.h"
+
+#include <mfapi.h>
+#include <mferror.h>
+#include <Shlwapi.h>
+#include <new>
+#include <stdexcept>
+
+#include "SafeRelease.h"
+
+namespace
+{
+    // Result object of BeginRead/BeginWrite, carries the byte count to the
+    // matching End call.
+    class CAsyncBytes : public IUnknown
+    {
+    public:
+        explicit CAsyncBytes(ULONG cb) : m_cRef(1), m_cb(cb) {}
+
+        STDMETHODIMP QueryInterface(REFIID riid, void** ppv)
+        {
+            if (riid != IID_IUnknown)
+            {
+                *ppv = NULL;
+                return E_NOINTERFACE;
+            }
+            *ppv = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+        STDMETHODIMP_(ULONG) AddRef() { return InterlockedIncrement(&m_cRef); }
+        STDMETHODIMP_(ULONG) Release()
+        {
+            long cRef = InterlockedDecrement(&m_cRef);
+            if (cRef == 0)
+            {
+                delete this;
+            }
+            return cRef;
+        }
+
+        ULONG Bytes() const { return m_cb; }
+
+    private:
+        long m_cRef;
+        ULONG m_cb;
+    };
+
+    // Runs `operation` under the lock and maps the writer's exceptions to
+    // HRESULTs.
+    template<typename Operation>
+    HRESULT Guarded(CRITICAL_SECTION *pCritSec, Operation operation)
+    {
+        HRESULT hr = S_OK;
+        EnterCriticalSection(pCritSec);
+        try
+        {
+            operation();
+        }
+        catch (const std::bad_alloc&)
+        {
+            hr = E_OUTOFMEMORY;
+        }
+        catch (const std::logic_error&)
+        {
+            hr = MF_E_INVALIDREQUEST;
+        }
+        catch (const std::exception&)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+        }
+        LeaveCriticalSection(pCritSec);
+        return hr;
+    }
+}
+
+HRESULT CCoalescingByteStream::Create(std::unique_ptr<VideoCoding::CoalescingWriter> writer, CCoalescingByteStream **ppStream)
+{
+    *ppStream = NULL;
+    if (!writer)
+    {
+        return E_INVALIDARG;
+    }
+
+    CCoalescingByteStream *pStream = new (std::nothrow) CCoalescingByteStream(std::move(writer));
+    if (pStream == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+    *ppStream = pStream;
+    return S_OK;
+}
+
+STDMETHODIMP CCoalescingByteStream::QueryInterface(REFIID riid, void** ppv)
+{
+    static const QITAB qit[] =
+    {
+        QITABENT(CCoalescingByteStream, IMFByteStream),
+        { 0 }
+    };
+    return QISearch(this, qit, riid, ppv);
+}
+
+STDMETHODIMP_(ULONG) CCoalescingByteStream::AddRef()
+{
+    return InterlockedIncrement(&m_cRef);
+}
+
+STDMETHODIMP_(ULONG) CCoalescingByteStream::Release()
+{
+    long cRef = InterlockedDecrement(&m_cRef);
+    if (cRef == 0)
+    {
+        delete this;
+    }
+    return cRef;
+}
+
+STDMETHODIMP CCoalescingByteStream::GetCapabilities(DWORD *pdwCapabilities)
+{
+    *pdwCapabilities = MFBYTESTREAM_IS_WRITABLE;
+    if (m_writer->canSeek())
+    {
+        *pdwCapabilities |= MFBYTESTREAM_IS_SEEKABLE | MFBYTESTREAM_IS_READABLE;
+    }
+    return S_OK;
+}
+
+STDMETHODIMP CCoalescingByteStream::GetLength(QWORD *pqwLength)
+{
+    return Guarded(&m_critSec, [&] { *pqwLength = m_writer->size(); });
+}
+
+STDMETHODIMP CCoalescingByteStream::SetLength(QWORD)
+{
+    return E_NOTIMPL;
+}
+
+STDMETHODIMP CCoalescingByteStream::GetCurrentPosition(QWORD *pqwPosition)
+{
+    return Guarded(&m_critSec, [&] { *pqwPosition = m_writer->tell(); });
+}
+
+STDMETHODIMP CCoalescingByteStream::SetCurrentPosition(QWORD qwPosition)
+{
+    return Guarded(&m_critSec, [&] { m_writer->seek(qwPosition); });
+}
+
+STDMETHODIMP CCoalescingByteStream::IsEndOfStream(BOOL *pfEndOfStream)
+{
+    return Guarded(&m_critSec, [&] { *pfEndOfStream = m_writer->tell() >= m_writer->size(); });
+}
+
+STDMETHODIMP CCoalescingByteStream::Read(BYTE *pb, ULONG cb, ULONG *pcbRead)
+{
+    *pcbRead = 0;
+    return Guarded(&m_critSec, [&] { *pcbRead = static_cast<ULONG>(m_writer->read(pb, cb)); });
+}
+
+STDMETHODIMP CCoalescingByteStream::BeginRead(BYTE *pb, ULONG cb, IMFAsyncCallback *pCallback, IUnknown *punkState)
+{
+    ULONG cbRead = 0;
+    HRESULT hr = Read(pb, cb, &cbRead);
+    return CompleteAsync(hr, cbRead, pCallback, punkState);
+}
+
+STDMETHODIMP CCoalescingByteStream::EndRead(IMFAsyncResult *pResult, ULONG *pcbRead)
+{
+    return EndWrite(pResult, pcbRead);
+}
+
+STDMETHODIMP CCoalescingByteStream::Write(const BYTE *pb, ULONG cb, ULONG *pcbWritten)
+{
+    *pcbWritten = 0;
+    return Guarded(&m_critSec, [&]
+    {
+        m_writer->write(pb, cb);
+        *pcbWritten = cb;
+    });
+}
+
+STDMETHODIMP CCoalescingByteStream::BeginWrite(const BYTE *pb, ULONG cb, IMFAsyncCallback *pCallback, IUnknown *punkState)
+{
+    ULONG cbWritten = 0;
+    HRESULT hr = Write(pb, cb, &cbWritten);
+    return CompleteAsync(hr, cbWritten, pCallback, punkState);
+}
+
+STDMETHODIMP CCoalescingByteStream::EndWrite(IMFAsyncResult *pResult, ULONG *pcbWritten)
+{
+    *pcbWritten = 0;
+
+    IUnknown *pObject = NULL;
+    HRESULT hr = pResult->GetStatus();
+    if (SUCCEEDED(hr))
+    {
+        hr = pResult->GetObject(&pObject);
+    }
+    if (SUCCEEDED(hr))
+    {
+        // Only ever a CAsyncBytes, see CompleteAsync.
+        *pcbWritten = static_cast<CAsyncBytes*>(pObject)->Bytes();
+    }
+    SafeRelease(&pObject);
+    return hr;
+}
+
+STDMETHODIMP CCoalescingByteStream::Seek(MFBYTESTREAM_SEEK_ORIGIN SeekOrigin, LONGLONG llSeekOffset, DWORD, QWORD *pqwCurrentPosition)
+{
+    return Guarded(&m_critSec, [&]
+    {
+        const LONGLONG base = SeekOrigin == msoCurrent ? static_cast<LONGLONG>(m_writer->tell()) : 0;
+        if (base + llSeekOffset < 0)
+        {
+            throw std::invalid_argument("seek before the start");
+        }
+        m_writer->seek(static_cast<uint64_t>(base + llSeekOffset));
+        *pqwCurrentPosition = m_writer->tell();
+    });
+}
+
+STDMETHODIMP CCoalescingByteStream::Flush()
+{
+    return Guarded(&m_critSec, [&] { m_writer->flush(); });
+}
+
+STDMETHODIMP CCoalescingByteStream::Close()
+{
+    return Guarded(&m_critSec, [&] { m_writer->close(); });
+}
+
+VideoCoding::CoalescingWriterStats CCoalescingByteStream::GetStats()
+{
+    EnterCriticalSection(&m_critSec);
+    const VideoCoding::CoalescingWriterStats stats = m_writer->getStats();
+    LeaveCriticalSection(&m_critSec);
+    return stats;
+}
+
+// The operation has already run; hand its outcome to the callback on a
+// work queue thread as Media Foundation expects.
+HRESULT CCoalescingByteStream::CompleteAsync(HRESULT hrStatus, ULONG cbDone, IMFAsyncCallback *pCallback, IUnknown *punkState)
+{
+    CAsyncBytes *pBytes = new (std::nothrow) CAsyncBytes(cbDone);
+    if (pBytes == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    IMFAsyncResult *pResult = NULL;
+    HRESULT hr = MFCreateAsyncResult(pBytes, pCallback, punkState, &pResult);
+    if (SUCCEEDED(hr))
+    {
+        pResult->SetStatus(hrStatus);
+        hr = MFInvokeCallback(pResult);
+    }
+
+    SafeRelease(&pResult);
+    pBytes->Release();
+    return hr;
+}
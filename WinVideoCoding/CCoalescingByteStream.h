@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Mfobjects.h>
+#include <Mfidl.h>
+
+#include <memory>
+
+#include "CoalescingWriter.h"
+
+// Write-side IMFByteStream over a VideoCoding::CoalescingWriter, so the sink
+// writer's small muxer writes reach the file, pipe or memory ring as few
+// large ones from a background thread. Seekable and readable only when the
+// target is; asynchronous calls complete synchronously.
+class CCoalescingByteStream : public IMFByteStream
+{
+public:
+    static HRESULT Create(std::unique_ptr<VideoCoding::CoalescingWriter> writer, CCoalescingByteStream **ppStream);
+
+    // IUnknown methods
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppv);
+    STDMETHODIMP_(ULONG) AddRef();
+    STDMETHODIMP_(ULONG) Release();
+
+    // IMFByteStream methods
+    STDMETHODIMP GetCapabilities(DWORD *pdwCapabilities);
+    STDMETHODIMP GetLength(QWORD *pqwLength);
+    STDMETHODIMP SetLength(QWORD qwLength);
+    STDMETHODIMP GetCurrentPosition(QWORD *pqwPosition);
+    STDMETHODIMP SetCurrentPosition(QWORD qwPosition);
+    STDMETHODIMP IsEndOfStream(BOOL *pfEndOfStream);
+    STDMETHODIMP Read(BYTE *pb, ULONG cb, ULONG *pcbRead);
+    STDMETHODIMP BeginRead(BYTE *pb, ULONG cb, IMFAsyncCallback *pCallback, IUnknown *punkState);
+    STDMETHODIMP EndRead(IMFAsyncResult *pResult, ULONG *pcbRead);
+    STDMETHODIMP Write(const BYTE *pb, ULONG cb, ULONG *pcbWritten);
+    STDMETHODIMP BeginWrite(const BYTE *pb, ULONG cb, IMFAsyncCallback *pCallback, IUnknown *punkState);
+    STDMETHODIMP EndWrite(IMFAsyncResult *pResult, ULONG *pcbWritten);
+    STDMETHODIMP Seek(MFBYTESTREAM_SEEK_ORIGIN SeekOrigin, LONGLONG llSeekOffset, DWORD dwSeekFlags, QWORD *pqwCurrentPosition);
+    STDMETHODIMP Flush();
+    STDMETHODIMP Close();
+
+    // Other methods
+    VideoCoding::CoalescingWriterStats GetStats();
+
+private:
+    explicit CCoalescingByteStream(std::unique_ptr<VideoCoding::CoalescingWriter> writer) : m_cRef(1), m_writer(std::move(writer))
+    {
+        InitializeCriticalSection(&m_critSec);
+    }
+    virtual ~CCoalescingByteStream()
+    {
+        Close();
+        DeleteCriticalSection(&m_critSec);
+    }
+
+    HRESULT CompleteAsync(HRESULT hrStatus, ULONG cbDone, IMFAsyncCallback *pCallback, IUnknown *punkState);
+
+private:
+    long m_cRef;
+    std::unique_ptr<VideoCoding::CoalescingWriter> m_writer;
+    CRITICAL_SECTION m_critSec;     // the sink writer calls in from its work queue threads
+};
@@ -0,0 +1,153 @@
+#include "CSamplePool.h"
+
+#include <mfapi.h>
+#include <Shlwapi.h>
+#include <new>
+
+#include "WindowsError.h"
+
+IMFSample* MFSampleBackend::create()
+{
+    IMFTrackedSample *pTracked = NULL;
+    IMFSample *pSample = NULL;
+    IMFMediaBuffer *pBuffer = NULL;
+
+    HRESULT hr = MFCreateTrackedSample(&pTracked);
+    if (SUCCEEDED(hr))
+    {
+        hr = pTracked->QueryInterface(IID_PPV_ARGS(&pSample));
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = MFCreateAlignedMemoryBuffer(bufferLength, MF_64_BYTE_ALIGNMENT, &pBuffer);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pSample->AddBuffer(pBuffer);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pSample->SetUINT64(VC_SAMPLE_BUFFER_ID, VideoCoding::NextBufferId());
+    }
+
+    SafeRelease(&pBuffer);
+    SafeRelease(&pTracked);
+    if (FAILED(hr))
+    {
+        SafeRelease(&pSample);
+        THROW_WINDOWS_ERROR(hr);
+    }
+    return pSample;
+}
+
+HRESULT CSamplePool::Create(DWORD bufferLength, size_t capacity, CSamplePool **ppPool)
+{
+    *ppPool = NULL;
+
+    CSamplePool *pPool = new (std::nothrow) CSamplePool(bufferLength, capacity);
+    if (pPool == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    try
+    {
+        pPool->m_pool.preallocate();
+    }
+    catch (const WindowsError& err)
+    {
+        pPool->Release();
+        return err.getErrorCode();
+    }
+    catch (const std::bad_alloc&)
+    {
+        pPool->Release();
+        return E_OUTOFMEMORY;
+    }
+    *ppPool = pPool;
+    return S_OK;
+}
+
+STDMETHODIMP CSamplePool::QueryInterface(REFIID riid, void** ppv)
+{
+    static const QITAB qit[] =
+    {
+        QITABENT(CSamplePool, IMFAsyncCallback),
+        { 0 }
+    };
+    return QISearch(this, qit, riid, ppv);
+}
+
+STDMETHODIMP_(ULONG) CSamplePool::AddRef()
+{
+    return InterlockedIncrement(&m_cRef);
+}
+
+STDMETHODIMP_(ULONG) CSamplePool::Release()
+{
+    long cRef = InterlockedDecrement(&m_cRef);
+    if (cRef == 0)
+    {
+        delete this;
+    }
+    return cRef;
+}
+
+// Called when the last reference to a checked out sample is released.
+STDMETHODIMP CSamplePool::Invoke(IMFAsyncResult *pResult)
+{
+    IUnknown *pObject = NULL;
+    IMFSample *pSample = NULL;
+
+    HRESULT hr = pResult->GetObject(&pObject);
+    if (SUCCEEDED(hr))
+    {
+        hr = pObject->QueryInterface(IID_PPV_ARGS(&pSample));
+    }
+    if (SUCCEEDED(hr))
+    {
+        // Attributes and timestamps are overwritten on the next checkout.
+        m_pool.recycle(pSample);
+    }
+
+    SafeRelease(&pObject);
+    return hr;
+}
+
+// The returned sample carries one reference owned by the caller.
+HRESULT CSamplePool::AcquireSample(IMFSample **ppSample)
+{
+    *ppSample = NULL;
+
+    IMFSample *pSample = NULL;
+    IMFTrackedSample *pTracked = NULL;
+
+    try
+    {
+        pSample = m_pool.acquire();
+    }
+    catch (const WindowsError& err)
+    {
+        return err.getErrorCode();
+    }
+    catch (const std::bad_alloc&)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    HRESULT hr = pSample->QueryInterface(IID_PPV_ARGS(&pTracked));
+    if (SUCCEEDED(hr))
+    {
+        // SetAllocator is one-shot, so it is re-armed on every checkout.
+        hr = pTracked->SetAllocator(this, NULL);
+    }
+    SafeRelease(&pTracked);
+
+    if (FAILED(hr))
+    {
+        m_pool.recycle(pSample);
+        return hr;
+    }
+    *ppSample = pSample;
+    return S_OK;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Mfobjects.h>
+#include <Mfidl.h>
+
+#include "FramePool.h"
+#include "SafeRelease.h"
+
+// UINT64 sample attribute set on every pooled sample: the
+// VideoCoding::NextBufferId() of its buffer, see FrameView::bufferId.
+// {5B1E3C2A-8D47-4F0B-9A6E-2C71D4E8B903}
+static const GUID VC_SAMPLE_BUFFER_ID = { 0x5b1e3c2a, 0x8d47, 0x4f0b, { 0x9a, 0x6e, 0x2c, 0x71, 0xd4, 0xe8, 0xb9, 0x03 } };
+
+// Media Foundation backend for VideoCoding::FramePool. Each item is a tracked
+// sample owning a single 64-byte aligned memory buffer.
+struct MFSampleBackend
+{
+    typedef IMFSample* Item;
+
+    explicit MFSampleBackend(DWORD bufferLength) : bufferLength(bufferLength) {}
+
+    Item create();
+    void destroy(Item& item) { SafeRelease(&item); }
+
+    DWORD bufferLength;
+};
+
+// Hands out pooled samples to the sink writer. The samples are tracked, so
+// when the sink (and the caller) release their last reference the sample is
+// not destroyed but comes back here through Invoke and is reused.
+class CSamplePool : public IMFAsyncCallback
+{
+public:
+    static HRESULT Create(DWORD bufferLength, size_t capacity, CSamplePool **ppPool);
+
+    // IUnknown methods
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppv);
+    STDMETHODIMP_(ULONG) AddRef();
+    STDMETHODIMP_(ULONG) Release();
+
+    // IMFAsyncCallback methods
+    STDMETHODIMP GetParameters(DWORD* pdwFlags, DWORD* pdwQueue)
+    {
+        // Implementation of this method is optional.
+        return E_NOTIMPL;
+    }
+    STDMETHODIMP Invoke(IMFAsyncResult *pResult);
+
+    // Other methods
+    HRESULT AcquireSample(IMFSample **ppSample);
+    VideoCoding::FramePoolStats GetStats() const { return m_pool.stats(); }
+
+private:
+    CSamplePool(DWORD bufferLength, size_t capacity) : m_cRef(1), m_pool(MFSampleBackend(bufferLength), capacity)
+    {
+    }
+    virtual ~CSamplePool()
+    {
+    }
+
+private:
+    long m_cRef;
+    VideoCoding::FramePool<MFSampleBackend> m_pool;
+};
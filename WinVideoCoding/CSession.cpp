@@ -3,11 +3,17 @@
 #include <Shlwapi.h>
 #include <new>
 
-HRESULT CSession::Create(CSession **ppSession)
+#include "Tracer.h"
+
+// Granularity of the progress timer. The notifier's throttle decides what
+// is actually passed on.
+const DWORD PROGRESS_TICK_MSEC = 100;
+
+HRESULT CSession::Create(CSession **ppSession, const VideoCoding::ProgressThrottle& throttle)
 {
     *ppSession = NULL;
 
-    CSession *pSession = new (std::nothrow) CSession();
+    CSession *pSession = new (std::nothrow) CSession(throttle);
     if (pSession == NULL)
     {
         return E_OUTOFMEMORY;
@@ -86,9 +92,50 @@ done:
     return hr;
 }
 
+namespace
+{
+    // Trace names of the events a transcode session sends.
+    const char* MediaEventName(MediaEventType meType)
+    {
+        switch (meType)
+        {
+        case MESessionTopologySet:
+            return "MESessionTopologySet";
+        case MESessionTopologyStatus:
+            return "MESessionTopologyStatus";
+        case MESessionNotifyPresentationTime:
+            return "MESessionNotifyPresentationTime";
+        case MESessionCapabilitiesChanged:
+            return "MESessionCapabilitiesChanged";
+        case MESessionStarted:
+            return "MESessionStarted";
+        case MESessionEnded:
+            return "MESessionEnded";
+        case MESessionClosed:
+            return "MESessionClosed";
+        case MEEndOfPresentation:
+            return "MEEndOfPresentation";
+        case MEError:
+            return "MEError";
+        default:
+            return "MediaEvent";
+        }
+    }
+}
+
 // Implements IMFAsyncCallback::Invoke
 STDMETHODIMP CSession::Invoke(IMFAsyncResult *pResult)
 {
+    if (pResult->GetStateNoAddRef() == ProgressTickState())
+    {
+        TRACE_SCOPE("ProgressTick");
+        return OnProgressTick();
+    }
+
+    // Renamed after the event once its type is known; the argument is the
+    // MediaEventType.
+    VideoCoding::TraceScope trace("MediaEvent");
+
     IMFMediaEvent* pEvent = NULL;
     MediaEventType meType = MEUnknown;
     HRESULT hrStatus = S_OK;
@@ -104,6 +151,8 @@ STDMETHODIMP CSession::Invoke(IMFAsyncResult *pResult)
     {
         goto done;
     }
+    trace.rename(MediaEventName(meType));
+    trace.setArg(meType);
 
     hr = pEvent->GetStatus(&hrStatus);
     if (FAILED(hr))
@@ -128,7 +177,7 @@ STDMETHODIMP CSession::Invoke(IMFAsyncResult *pResult)
         break;
 
     case MESessionClosed:
-        SetEvent(m_hWaitEvent);
+        Complete(m_hrStatus);
         break;
     }
 
@@ -140,26 +189,96 @@ STDMETHODIMP CSession::Invoke(IMFAsyncResult *pResult)
 done:
     if (FAILED(hr))
     {
+        // No further events are requested, so MESessionClosed will not be
+        // seen; complete here rather than leave waiters hanging.
         m_hrStatus = hr;
         m_pSession->Close();
+        Complete(hr);
     }
 
     SafeRelease(&pEvent);
     return hr;
 }
 
-HRESULT CSession::StartEncodingSession(IMFTopology *pTopology)
+HRESULT CSession::StartEncodingSession(IMFTopology *pTopology, MFTIME duration, MFTIME start)
 {
+    m_pNotifier->setDuration(duration);
+
     HRESULT hr = m_pSession->SetTopology(0, pTopology);
     if (SUCCEEDED(hr))
     {
         PROPVARIANT varStart;
         PropVariantClear(&varStart);
+        if (start > 0)
+        {
+            varStart.vt = VT_I8;
+            varStart.hVal.QuadPart = start;
+        }
         hr = m_pSession->Start(&GUID_NULL, &varStart);
     }
+    if (SUCCEEDED(hr))
+    {
+        EnterCriticalSection(&m_critSec);
+        if (!m_bClosed)
+        {
+            hr = ScheduleProgressTick();
+        }
+        LeaveCriticalSection(&m_critSec);
+    }
+    return hr;
+}
+
+// Called with m_critSec held.
+HRESULT CSession::ScheduleProgressTick()
+{
+    DWORD dwMsec = PROGRESS_TICK_MSEC;
+    const long long throttleMsec = m_pNotifier->getThrottle().minInterval.count();
+    if (throttleMsec > dwMsec)
+    {
+        dwMsec = static_cast<DWORD>(throttleMsec);
+    }
+    return MFScheduleWorkItem(this, ProgressTickState(), -static_cast<INT64>(dwMsec), &m_tickKey);
+}
+
+HRESULT CSession::OnProgressTick()
+{
+    // The clock has no time until the session starts, skip those ticks.
+    MFTIME pos = 0;
+    if (SUCCEEDED(m_pClock->GetTime(&pos)))
+    {
+        m_pNotifier->reportPosition(pos);
+    }
+
+    HRESULT hr = S_OK;
+    EnterCriticalSection(&m_critSec);
+    m_tickKey = 0;
+    if (!m_bClosed)
+    {
+        hr = ScheduleProgressTick();
+    }
+    LeaveCriticalSection(&m_critSec);
     return hr;
 }
 
+void CSession::Complete(HRESULT hrStatus)
+{
+    EnterCriticalSection(&m_critSec);
+    const BOOL bWasClosed = m_bClosed;
+    m_bClosed = TRUE;
+    if (m_tickKey != 0)
+    {
+        MFCancelWorkItem(m_tickKey);
+        m_tickKey = 0;
+    }
+    LeaveCriticalSection(&m_critSec);
+
+    if (!bWasClosed)
+    {
+        SetEvent(m_hWaitEvent);
+        m_pNotifier->complete(hrStatus);
+    }
+}
+
 HRESULT CSession::GetEncodingPosition(MFTIME *pTime)
 {
     return m_pClock->GetTime(pTime);
@@ -2,13 +2,17 @@
 
 #include <Mfobjects.h>
 #include <Mfidl.h>
+#include <mfapi.h>
+
+#include <memory>
 
 #include "SafeRelease.h"
+#include "SessionNotifier.h"
 
 class CSession : public IMFAsyncCallback
 {
 public:
-	static HRESULT Create(CSession **ppSession);
+	static HRESULT Create(CSession **ppSession, const VideoCoding::ProgressThrottle& throttle = VideoCoding::DefaultProgressThrottle());
 
 	// IUnknown methods
 	STDMETHODIMP QueryInterface(REFIID riid, void** ppv);
@@ -24,13 +28,23 @@ public:
 	STDMETHODIMP Invoke(IMFAsyncResult *pResult);
 
 	// Other methods
-	HRESULT StartEncodingSession(IMFTopology *pTopology);
+	// A non-zero start seeks the source there first; progress is then
+	// reported against the source clock, so pass 0 as duration.
+	HRESULT StartEncodingSession(IMFTopology *pTopology, MFTIME duration = 0, MFTIME start = 0);
 	HRESULT GetEncodingPosition(MFTIME *pTime);
 	HRESULT Wait(DWORD dwMsec);
 
+	// Progress is pushed from a timer on the MF work queue and completion
+	// from the session events, so callers can wait on the notifier's future
+	// or register callbacks instead of polling Wait().
+	std::shared_ptr<VideoCoding::SessionNotifier> GetNotifier() const { return m_pNotifier; }
+
 private:
-	CSession() : m_cRef(1), m_pSession(NULL), m_pClock(NULL), m_hrStatus(S_OK), m_hWaitEvent(NULL)
+	CSession(const VideoCoding::ProgressThrottle& throttle)
+		: m_cRef(1), m_pSession(NULL), m_pClock(NULL), m_hrStatus(S_OK), m_hWaitEvent(NULL),
+		  m_pNotifier(std::make_shared<VideoCoding::SessionNotifier>(throttle)), m_tickKey(0), m_bClosed(FALSE)
 	{
+		InitializeCriticalSection(&m_critSec);
 	}
 	virtual ~CSession()
 	{
@@ -42,9 +56,17 @@ private:
 		SafeRelease(&m_pClock);
 		SafeRelease(&m_pSession);
 		CloseHandle(m_hWaitEvent);
+		DeleteCriticalSection(&m_critSec);
 	}
 
 	HRESULT Initialize();
+	HRESULT ScheduleProgressTick();
+	HRESULT OnProgressTick();
+	void Complete(HRESULT hrStatus);
+
+	// State object of the progress timer, tells its Invoke apart from the
+	// session's event callbacks which have no state.
+	IUnknown* ProgressTickState() { return static_cast<IMFAsyncCallback*>(this); }
 
 private:
 	IMFMediaSession      *m_pSession;
@@ -52,4 +74,9 @@ private:
 	HRESULT m_hrStatus;
 	HANDLE  m_hWaitEvent;
 	long    m_cRef;
+
+	std::shared_ptr<VideoCoding::SessionNotifier> m_pNotifier;
+	CRITICAL_SECTION m_critSec;     // guards m_tickKey and m_bClosed
+	MFWORKITEM_KEY   m_tickKey;
+	BOOL             m_bClosed;
 };
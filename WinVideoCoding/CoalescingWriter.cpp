@@ -0,0 +1,218 @@
+#include "CoalescingWriter.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        size_t AlignUp(size_t size, size_t alignment)
+        {
+            const size_t aligned = (size + alignment - 1) / alignment * alignment;
+            return aligned == 0 ? alignment : aligned;
+        }
+    }
+
+    CoalescingWriter::CoalescingWriter(std::unique_ptr<ByteTarget> target, size_t bufferSize)
+        : target(std::move(target)), bufferSize(AlignUp(bufferSize, COALESCING_ALIGNMENT)), front(0), filled(0),
+          limit(this->bufferSize), position(0), end(0), closed(false), pending(false), pendingBytes(0), stopping(false),
+          failed(false), stats()
+    {
+        if (!this->target)
+        {
+            throw std::invalid_argument("CoalescingWriter: no target");
+        }
+        buffers[0] = AlignedBuffer(this->bufferSize, COALESCING_ALIGNMENT);
+        buffers[1] = AlignedBuffer(this->bufferSize, COALESCING_ALIGNMENT);
+        ioThread = std::thread([this] { run(); });
+    }
+
+    CoalescingWriter::~CoalescingWriter()
+    {
+        try
+        {
+            close();
+        }
+        catch (const std::exception&)
+        {
+        }
+        if (ioThread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            changed.notify_all();
+            ioThread.join();
+        }
+    }
+
+    void CoalescingWriter::write(const void* data, size_t length)
+    {
+        checkOpen();
+        checkError();
+        ++stats.writes;
+        stats.bytes += length;
+
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        while (length > 0)
+        {
+            const size_t chunk = length < limit - filled ? length : limit - filled;
+            std::memcpy(buffers[front].get() + filled, src, chunk);
+            filled += chunk;
+            src += chunk;
+            length -= chunk;
+            position += chunk;
+            if (filled == limit)
+            {
+                submit();
+            }
+        }
+        if (position > end)
+        {
+            end = position;
+        }
+    }
+
+    void CoalescingWriter::seek(uint64_t newPosition)
+    {
+        checkOpen();
+        if (newPosition == position)
+        {
+            return;
+        }
+        flush();
+        target->seek(newPosition);
+        position = newPosition;
+        limit = bufferSize - static_cast<size_t>(newPosition % bufferSize);
+    }
+
+    size_t CoalescingWriter::read(void* data, size_t length)
+    {
+        checkOpen();
+        flush();
+        const size_t count = target->read(static_cast<uint8_t*>(data), length);
+        position += count;
+        limit = bufferSize - static_cast<size_t>(position % bufferSize);
+        return count;
+    }
+
+    void CoalescingWriter::flush()
+    {
+        if (closed)
+        {
+            return;
+        }
+        checkError();
+        if (filled > 0)
+        {
+            submit();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        waitIdle(lock);
+        lock.unlock();
+        checkError();
+    }
+
+    void CoalescingWriter::close()
+    {
+        if (closed)
+        {
+            return;
+        }
+        flush();
+        closed = true;
+        target->close();
+    }
+
+    CoalescingWriterStats CoalescingWriter::getStats()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        waitIdle(lock);
+        CoalescingWriterStats current = stats;
+        current.target = target->getStats();
+        return current;
+    }
+
+    // Hands the front buffer to the I/O thread and switches to the other
+    // one, waiting if that is still being written.
+    void CoalescingWriter::submit()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (pending)
+        {
+            ++stats.stalls;
+            waitIdle(lock);
+        }
+        pending = true;
+        pendingBytes = filled;
+        front = 1 - front;
+        ++stats.submits;
+        lock.unlock();
+        changed.notify_all();
+
+        filled = 0;
+        limit = bufferSize - static_cast<size_t>(position % bufferSize);
+        checkError();
+    }
+
+    void CoalescingWriter::waitIdle(std::unique_lock<std::mutex>& lock)
+    {
+        changed.wait(lock, [this] { return !pending; });
+    }
+
+    void CoalescingWriter::checkOpen() const
+    {
+        if (closed)
+        {
+            throw std::logic_error("CoalescingWriter: used after close");
+        }
+    }
+
+    void CoalescingWriter::checkError()
+    {
+        if (failed)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::rethrow_exception(error);
+        }
+    }
+
+    void CoalescingWriter::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            changed.wait(lock, [this] { return pending || stopping; });
+            if (!pending)
+            {
+                return;
+            }
+            const uint8_t* data = buffers[1 - front].get();
+            const size_t length = pendingBytes;
+            lock.unlock();
+
+            // After a failure the rest is dropped, the caller sees the error.
+            if (!failed)
+            {
+                try
+                {
+                    target->write(data, length);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> errorLock(mutex);
+                    error = std::current_exception();
+                    failed = true;
+                }
+            }
+
+            lock.lock();
+            pending = false;
+            changed.notify_all();
+        }
+    }
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "AlignedBuffer.h"
+#include "ByteTarget.h"
+
+namespace VideoCoding
+{
+
+    const size_t DEFAULT_COALESCING_BUFFER = 1 << 20;
+    const size_t COALESCING_ALIGNMENT = 4096;
+
+    struct CoalescingWriterStats
+    {
+        uint64_t writes;            // calls to write()
+        uint64_t bytes;
+        uint64_t submits;           // buffers handed to the I/O thread
+        uint64_t stalls;            // write() waited for the I/O thread
+        ByteTargetStats target;
+    };
+
+    // Turns a muxer's many small writes into few large ones. Writes are
+    // copied into one of two page-aligned buffers; a full buffer goes to a
+    // background thread, which writes it to the target while the caller
+    // fills the other one. A buffer is cut where the output reaches a
+    // multiple of the buffer size, so target writes stay aligned to it even
+    // after a seek.
+    //
+    // Not thread-safe: one caller at a time. An I/O error is rethrown from
+    // the next call and every call after it.
+    class CoalescingWriter
+    {
+    public:
+        // bufferSize is rounded up to COALESCING_ALIGNMENT.
+        explicit CoalescingWriter(std::unique_ptr<ByteTarget> target, size_t bufferSize = DEFAULT_COALESCING_BUFFER);
+        ~CoalescingWriter();
+
+        CoalescingWriter(const CoalescingWriter&) = delete;
+        CoalescingWriter& operator=(const CoalescingWriter&) = delete;
+
+        void write(const void* data, size_t length);
+
+        // Logical position and the furthest byte written, buffered or not.
+        uint64_t tell() const { return position; }
+        uint64_t size() const { return end; }
+
+        // Seeking and reading back first wait for everything buffered to
+        // reach the target.
+        bool canSeek() const { return target->canSeek(); }
+        void seek(uint64_t newPosition);
+        size_t read(void* data, size_t length);
+
+        // Returns once everything written so far has reached the target.
+        void flush();
+        // Flushes and closes the target. Afterwards flush and close do
+        // nothing and everything else throws std::logic_error.
+        void close();
+
+        // Waits for a buffer in flight, so the target counts are current.
+        CoalescingWriterStats getStats();
+
+        ByteTarget& getTarget() { return *target; }
+
+    private:
+        void submit();
+        void waitIdle(std::unique_lock<std::mutex>& lock);
+        void checkOpen() const;
+        void checkError();
+        void run();
+
+        std::unique_ptr<ByteTarget> target;
+        const size_t bufferSize;
+        AlignedBuffer buffers[2];
+        size_t front;               // buffer being filled by the caller
+        size_t filled;
+        size_t limit;               // bytes that fit before the next aligned cut
+        uint64_t position;
+        uint64_t end;
+        bool closed;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool pending;               // buffers[1 - front] waits for or is in the I/O thread
+        size_t pendingBytes;
+        bool stopping;
+        std::atomic<bool> failed;
+        std::exception_ptr error;
+        CoalescingWriterStats stats;
+        std::thread ioThread;
+    };
+
+}
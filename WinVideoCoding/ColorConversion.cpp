@@ -0,0 +1,399 @@
+#include "ColorConversion.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef VC_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        const int FIXED_SHIFT = 15;
+        const int32_t FIXED_HALF = 1 << (FIXED_SHIFT - 1);
+
+        int16_t Fixed(double value)
+        {
+            return static_cast<int16_t>(std::lround(value * (1 << FIXED_SHIFT)));
+        }
+
+        inline uint8_t Clamp255(int32_t value)
+        {
+            return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+
+        inline uint8_t Luma(const ColorCoefficients& c, const uint8_t* px)
+        {
+            return Clamp255((px[0] * c.yb + px[1] * c.yg + px[2] * c.yr + c.yOffset) >> FIXED_SHIFT);
+        }
+
+        // Pixels are B, G, R, X in memory. The row kernels take the width and
+        // the chroma layout (true for NV12) either as plain values or, for
+        // specialized geometries, as std::integral_constants.
+        template<typename Interleaved, typename Width>
+        void ScalarRowPair(const ColorCoefficients& c, const uint8_t* src0, const uint8_t* src1,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, Interleaved interleaved, uint32_t xBegin, Width width)
+        {
+            for (uint32_t x = xBegin; x < width; x += 2)
+            {
+                const uint8_t* a = src0 + 4 * x;
+                const uint8_t* b = src1 + 4 * x;
+                y0[x] = Luma(c, a);
+                y0[x + 1] = Luma(c, a + 4);
+                y1[x] = Luma(c, b);
+                y1[x + 1] = Luma(c, b + 4);
+
+                const int32_t blue = (a[0] + a[4] + b[0] + b[4] + 2) >> 2;
+                const int32_t green = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;
+                const int32_t red = (a[2] + a[6] + b[2] + b[6] + 2) >> 2;
+                const uint8_t cb = Clamp255((blue * c.ub + green * c.ug + red * c.ur + c.uvOffset) >> FIXED_SHIFT);
+                const uint8_t cr = Clamp255((blue * c.vb + green * c.vg + red * c.vr + c.uvOffset) >> FIXED_SHIFT);
+                if (interleaved)
+                {
+                    u[x] = cb;
+                    u[x + 1] = cr;
+                }
+                else
+                {
+                    u[x / 2] = cb;
+                    v[x / 2] = cr;
+                }
+            }
+        }
+
+#ifdef VC_X86
+        inline int32_t PackPair(int16_t low, int16_t high)
+        {
+            return static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16) | static_cast<uint16_t>(low));
+        }
+
+        // Weights for (B, R) pairs and (G, X) pairs as laid out by the masks
+        // below, so a single madd per pair computes a dot product per pixel.
+        struct SSE2Weights
+        {
+            explicit SSE2Weights(const ColorCoefficients& c)
+                : mask(_mm_set1_epi32(0x00FF00FF)),
+                  yBR(_mm_set1_epi32(PackPair(c.yb, c.yr))), yG(_mm_set1_epi32(PackPair(c.yg, 0))),
+                  uBR(_mm_set1_epi32(PackPair(c.ub, c.ur))), uG(_mm_set1_epi32(PackPair(c.ug, 0))),
+                  vBR(_mm_set1_epi32(PackPair(c.vb, c.vr))), vG(_mm_set1_epi32(PackPair(c.vg, 0))),
+                  yOffset(_mm_set1_epi32(c.yOffset)), uvOffset(_mm_set1_epi32(c.uvOffset)),
+                  two(_mm_set1_epi16(2))
+            {
+            }
+
+            __m128i mask, yBR, yG, uBR, uG, vBR, vG, yOffset, uvOffset, two;
+        };
+
+        // Four pixels in, four 32-bit luma values out.
+        inline __m128i LumaSSE2(const SSE2Weights& w, __m128i px)
+        {
+            const __m128i br = _mm_and_si128(px, w.mask);
+            const __m128i gx = _mm_and_si128(_mm_srli_epi32(px, 8), w.mask);
+            __m128i sum = _mm_add_epi32(_mm_madd_epi16(br, w.yBR), _mm_madd_epi16(gx, w.yG));
+            return _mm_srai_epi32(_mm_add_epi32(sum, w.yOffset), FIXED_SHIFT);
+        }
+
+        // Averages horizontally adjacent pixel pairs from two rows. The even
+        // 32-bit lanes hold the averages, the odd lanes are garbage.
+        inline void AverageSSE2(const SSE2Weights& w, __m128i p0, __m128i p1, __m128i& br, __m128i& gx)
+        {
+            br = _mm_add_epi16(_mm_and_si128(p0, w.mask), _mm_and_si128(p1, w.mask));
+            gx = _mm_add_epi16(_mm_and_si128(_mm_srli_epi32(p0, 8), w.mask), _mm_and_si128(_mm_srli_epi32(p1, 8), w.mask));
+            br = _mm_add_epi16(br, _mm_srli_epi64(br, 32));
+            gx = _mm_add_epi16(gx, _mm_srli_epi64(gx, 32));
+            br = _mm_srli_epi16(_mm_add_epi16(br, w.two), 2);
+            gx = _mm_srli_epi16(_mm_add_epi16(gx, w.two), 2);
+        }
+
+        inline __m128i EvenLanes(__m128i a, __m128i b)
+        {
+            return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+
+        inline __m128i ChromaSSE2(__m128i br, __m128i gx, __m128i wBR, __m128i wG, __m128i offset)
+        {
+            __m128i sum = _mm_add_epi32(_mm_madd_epi16(br, wBR), _mm_madd_epi16(gx, wG));
+            return _mm_srai_epi32(_mm_add_epi32(sum, offset), FIXED_SHIFT);
+        }
+
+        template<typename Interleaved, typename Width>
+        void SSE2RowPair(const ColorCoefficients& c, const uint8_t* src0, const uint8_t* src1,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, Interleaved interleaved, Width width)
+        {
+            const SSE2Weights w(c);
+            uint32_t x = 0;
+            for (; x + 8 <= width; x += 8)
+            {
+                const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + 4 * x));
+                const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + 4 * x + 16));
+                const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + 4 * x));
+                const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + 4 * x + 16));
+
+                const __m128i lumaA = _mm_packs_epi32(LumaSSE2(w, a0), LumaSSE2(w, a1));
+                const __m128i lumaB = _mm_packs_epi32(LumaSSE2(w, b0), LumaSSE2(w, b1));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(y0 + x), _mm_packus_epi16(lumaA, lumaA));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(y1 + x), _mm_packus_epi16(lumaB, lumaB));
+
+                __m128i br0, gx0, br1, gx1;
+                AverageSSE2(w, a0, b0, br0, gx0);
+                AverageSSE2(w, a1, b1, br1, gx1);
+                const __m128i br = EvenLanes(br0, br1);
+                const __m128i gx = EvenLanes(gx0, gx1);
+
+                const __m128i cb = ChromaSSE2(br, gx, w.uBR, w.uG, w.uvOffset);
+                const __m128i cr = ChromaSSE2(br, gx, w.vBR, w.vG, w.uvOffset);
+                __m128i packed = _mm_packs_epi32(cb, cr);
+                if (interleaved)
+                {
+                    packed = _mm_unpacklo_epi16(packed, _mm_srli_si128(packed, 8));
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x), _mm_packus_epi16(packed, packed));
+                }
+                else
+                {
+                    packed = _mm_packus_epi16(packed, packed);
+                    const int32_t cbBytes = _mm_cvtsi128_si32(packed);
+                    const int32_t crBytes = _mm_cvtsi128_si32(_mm_srli_si128(packed, 4));
+                    std::memcpy(u + x / 2, &cbBytes, 4);
+                    std::memcpy(v + x / 2, &crBytes, 4);
+                }
+            }
+            ScalarRowPair(c, src0, src1, y0, y1, u, v, interleaved, x, width);
+        }
+
+        // --------------------------------------------------------------------
+
+        struct AVX2Weights
+        {
+            VC_TARGET_AVX2 explicit AVX2Weights(const ColorCoefficients& c)
+                : mask(_mm256_set1_epi32(0x00FF00FF)),
+                  yBR(_mm256_set1_epi32(PackPair(c.yb, c.yr))), yG(_mm256_set1_epi32(PackPair(c.yg, 0))),
+                  uBR(_mm256_set1_epi32(PackPair(c.ub, c.ur))), uG(_mm256_set1_epi32(PackPair(c.ug, 0))),
+                  vBR(_mm256_set1_epi32(PackPair(c.vb, c.vr))), vG(_mm256_set1_epi32(PackPair(c.vg, 0))),
+                  yOffset(_mm256_set1_epi32(c.yOffset)), uvOffset(_mm256_set1_epi32(c.uvOffset)),
+                  two(_mm256_set1_epi16(2))
+            {
+            }
+
+            __m256i mask, yBR, yG, uBR, uG, vBR, vG, yOffset, uvOffset, two;
+        };
+
+        VC_TARGET_AVX2 inline __m256i LumaAVX2(const AVX2Weights& w, __m256i px)
+        {
+            const __m256i br = _mm256_and_si256(px, w.mask);
+            const __m256i gx = _mm256_and_si256(_mm256_srli_epi32(px, 8), w.mask);
+            const __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(br, w.yBR), _mm256_madd_epi16(gx, w.yG));
+            return _mm256_srai_epi32(_mm256_add_epi32(sum, w.yOffset), FIXED_SHIFT);
+        }
+
+        VC_TARGET_AVX2 inline void AverageAVX2(const AVX2Weights& w, __m256i p0, __m256i p1, __m256i& br, __m256i& gx)
+        {
+            br = _mm256_add_epi16(_mm256_and_si256(p0, w.mask), _mm256_and_si256(p1, w.mask));
+            gx = _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi32(p0, 8), w.mask), _mm256_and_si256(_mm256_srli_epi32(p1, 8), w.mask));
+            br = _mm256_add_epi16(br, _mm256_srli_epi64(br, 32));
+            gx = _mm256_add_epi16(gx, _mm256_srli_epi64(gx, 32));
+            br = _mm256_srli_epi16(_mm256_add_epi16(br, w.two), 2);
+            gx = _mm256_srli_epi16(_mm256_add_epi16(gx, w.two), 2);
+        }
+
+        // The permutes undo the per-128-bit-lane behaviour of the shuffle and
+        // pack instructions.
+        VC_TARGET_AVX2 inline __m256i EvenLanesAVX2(__m256i a, __m256i b)
+        {
+            const __m256i mixed = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+            return _mm256_permute4x64_epi64(mixed, _MM_SHUFFLE(3, 1, 2, 0));
+        }
+
+        VC_TARGET_AVX2 inline __m256i ChromaAVX2(__m256i br, __m256i gx, __m256i wBR, __m256i wG, __m256i offset)
+        {
+            const __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(br, wBR), _mm256_madd_epi16(gx, wG));
+            return _mm256_srai_epi32(_mm256_add_epi32(sum, offset), FIXED_SHIFT);
+        }
+
+        VC_TARGET_AVX2 inline __m128i PackLumaAVX2(__m256i first, __m256i second)
+        {
+            const __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(first, second), _MM_SHUFFLE(3, 1, 2, 0));
+            const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), _MM_SHUFFLE(3, 1, 2, 0));
+            return _mm256_castsi256_si128(bytes);
+        }
+
+        // Same algorithm as the SSE2 kernel on 16 pixels at a time.
+        template<typename Interleaved, typename Width>
+        VC_TARGET_AVX2 void AVX2RowPair(const ColorCoefficients& c, const uint8_t* src0, const uint8_t* src1,
+            uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, Interleaved interleaved, Width width)
+        {
+            const AVX2Weights w(c);
+            uint32_t x = 0;
+            for (; x + 16 <= width; x += 16)
+            {
+                const __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src0 + 4 * x));
+                const __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src0 + 4 * x + 32));
+                const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src1 + 4 * x));
+                const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src1 + 4 * x + 32));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(y0 + x), PackLumaAVX2(LumaAVX2(w, a0), LumaAVX2(w, a1)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(y1 + x), PackLumaAVX2(LumaAVX2(w, b0), LumaAVX2(w, b1)));
+
+                __m256i br0, gx0, br1, gx1;
+                AverageAVX2(w, a0, b0, br0, gx0);
+                AverageAVX2(w, a1, b1, br1, gx1);
+                const __m256i br = EvenLanesAVX2(br0, br1);
+                const __m256i gx = EvenLanesAVX2(gx0, gx1);
+
+                const __m256i cb = ChromaAVX2(br, gx, w.uBR, w.uG, w.uvOffset);
+                const __m256i cr = ChromaAVX2(br, gx, w.vBR, w.vG, w.uvOffset);
+                __m256i packed = _mm256_packs_epi32(cb, cr);
+                if (interleaved)
+                {
+                    packed = _mm256_unpacklo_epi16(packed, _mm256_srli_si256(packed, 8));
+                    packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(packed, packed), _MM_SHUFFLE(3, 1, 2, 0));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(u + x), _mm256_castsi256_si128(packed));
+                }
+                else
+                {
+                    packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+                    packed = _mm256_packus_epi16(packed, packed);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), _mm256_castsi256_si128(packed));
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), _mm256_extracti128_si256(packed, 1));
+                }
+            }
+            SSE2RowPair(c, src0 + 4 * x, src1 + 4 * x, y0 + x, y1 + x,
+                interleaved ? u + x : u + x / 2, interleaved ? v : v + x / 2, interleaved, static_cast<uint32_t>(width - x));
+        }
+#endif
+
+        template<typename Interleaved, typename Width, typename SrcStride, typename DstStride>
+        void ConvertRowPairs(SimdLevel level, const ColorCoefficients& coefficients, const FrameView& src, const FrameView& dst,
+            uint32_t rowBegin, uint32_t rowEnd, Interleaved interleaved, Width width, SrcStride srcStride, DstStride dstStride)
+        {
+            uint8_t* uPlane = dst.plane(1);
+            uint8_t* vPlane = dst.plane(2);
+            const ptrdiff_t chromaStride = interleaved ? static_cast<ptrdiff_t>(dstStride) : dstStride / 2;
+
+            for (uint32_t y = rowBegin; y < rowEnd; y += 2)
+            {
+                const uint8_t* src0 = src.data + srcStride * static_cast<ptrdiff_t>(y);
+                const uint8_t* src1 = src0 + srcStride;
+                uint8_t* y0 = dst.data + dstStride * static_cast<ptrdiff_t>(y);
+                uint8_t* y1 = y0 + dstStride;
+                uint8_t* u = uPlane + chromaStride * static_cast<ptrdiff_t>(y / 2);
+                uint8_t* v = vPlane + chromaStride * static_cast<ptrdiff_t>(y / 2);
+
+                switch (level)
+                {
+#ifdef VC_X86
+                case SimdLevel::AVX2:
+                    AVX2RowPair(coefficients, src0, src1, y0, y1, u, v, interleaved, width);
+                    break;
+                case SimdLevel::SSE2:
+                    SSE2RowPair(coefficients, src0, src1, y0, y1, u, v, interleaved, width);
+                    break;
+#endif
+                default:
+                    ScalarRowPair(coefficients, src0, src1, y0, y1, u, v, interleaved, 0, width);
+                    break;
+                }
+            }
+        }
+    }
+
+    ColorCoefficients ComputeColorCoefficients(ColorMatrix matrix, ColorRange range)
+    {
+        const double kr = matrix == ColorMatrix::BT709 ? 0.2126 : 0.299;
+        const double kb = matrix == ColorMatrix::BT709 ? 0.0722 : 0.114;
+        const double kg = 1.0 - kr - kb;
+        const bool limited = range == ColorRange::Limited;
+        const double yScale = limited ? 219.0 / 255.0 : 1.0;
+        const double cScale = limited ? 224.0 / 255.0 : 1.0;
+
+        ColorCoefficients c;
+        c.yr = Fixed(kr * yScale);
+        c.yg = Fixed(kg * yScale);
+        c.yb = Fixed(kb * yScale);
+        c.ub = Fixed(0.5 * cScale);
+        c.ug = Fixed(-kg / (2.0 * (1.0 - kb)) * cScale);
+        c.ur = Fixed(-kr / (2.0 * (1.0 - kb)) * cScale);
+        c.vr = Fixed(0.5 * cScale);
+        c.vg = Fixed(-kg / (2.0 * (1.0 - kr)) * cScale);
+        c.vb = Fixed(-kb / (2.0 * (1.0 - kr)) * cScale);
+        c.yOffset = ((limited ? 16 : 0) << FIXED_SHIFT) + FIXED_HALF;
+        c.uvOffset = (128 << FIXED_SHIFT) + FIXED_HALF;
+        return c;
+    }
+
+    void ConvertRGB32Rows(SimdLevel level, const ColorCoefficients& coefficients,
+        const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd, KernelDispatch dispatch)
+    {
+        const bool specialized = dispatch == KernelDispatch::Specialized
+            && src.stride == static_cast<ptrdiff_t>(RowBytes(PixelFormat::RGB32, src.width))
+            && dst.stride == static_cast<ptrdiff_t>(RowBytes(dst.format, dst.width))
+            && WithSpecializedWidth(dst.width, [&](auto width)
+            {
+                typedef decltype(width) Width;
+                const std::integral_constant<ptrdiff_t, 4 * Width::value> srcStride;
+                const std::integral_constant<ptrdiff_t, Width::value> dstStride;
+                if (dst.format == PixelFormat::NV12)
+                {
+                    ConvertRowPairs(level, coefficients, src, dst, rowBegin, rowEnd, std::true_type(), width, srcStride, dstStride);
+                }
+                else
+                {
+                    ConvertRowPairs(level, coefficients, src, dst, rowBegin, rowEnd, std::false_type(), width, srcStride, dstStride);
+                }
+            });
+        if (!specialized)
+        {
+            ConvertRowPairs(level, coefficients, src, dst, rowBegin, rowEnd, dst.format == PixelFormat::NV12, dst.width, src.stride, dst.stride);
+        }
+    }
+
+    // ------------------------------------------------------------------------
+
+    ColorConverter::ColorConverter(ColorMatrix matrix, ColorRange range, size_t threadCount, SimdLevel level, KernelDispatch dispatch)
+        : coefficients(ComputeColorCoefficients(matrix, range)), level(level), dispatch(dispatch), executor(new RowBandExecutor(threadCount))
+    {
+    }
+
+    void ColorConverter::convert(const FrameView& src, const FrameView& dst)
+    {
+        convertRows(src, dst, 0, dst.height);
+    }
+
+    void ColorConverter::convertRows(const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd)
+    {
+        if (src.format != PixelFormat::RGB32 || dst.format == PixelFormat::RGB32)
+        {
+            throw std::invalid_argument("ColorConverter: expected RGB32 source and NV12/I420 destination");
+        }
+        if (src.width != dst.width || src.height != dst.height || (dst.width % 2) != 0 || (dst.height % 2) != 0)
+        {
+            throw std::invalid_argument("ColorConverter: frame sizes must match and be even");
+        }
+        if (rowBegin > rowEnd || rowEnd > dst.height || (rowBegin % 2) != 0 || (rowEnd % 2) != 0)
+        {
+            throw std::invalid_argument("ColorConverter: row range must be even and inside the frame");
+        }
+
+        executor->run(rowEnd - rowBegin, 2, [&](uint32_t bandBegin, uint32_t bandEnd)
+        {
+            ConvertRGB32Rows(level, coefficients, src, dst, rowBegin + bandBegin, rowBegin + bandEnd, dispatch);
+        });
+    }
+
+    // ------------------------------------------------------------------------
+
+    void ConvertingFrameProducer::render(const FrameView& frame, uint64_t frameIndex)
+    {
+        if (!scratch || scratch->view().width != frame.width || scratch->view().height != frame.height)
+        {
+            scratch.reset(new MemoryFrameBuffer(frame.width, frame.height, PixelFormat::RGB32));
+        }
+        RenderFrame(*scratch, source, frameIndex);
+        converter.convert(scratch->view(), frame);
+    }
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "CpuFeatures.h"
+#include "FrameGeometry.h"
+#include "FrameView.h"
+#include "MemoryFrameBuffer.h"
+#include "RowBandExecutor.h"
+
+namespace VideoCoding
+{
+
+    enum class ColorMatrix
+    {
+        BT601,
+        BT709,
+    };
+
+    enum class ColorRange
+    {
+        Limited,    // Y 16..235, U/V 16..240
+        Full,       // 0..255
+    };
+
+    // RGB -> YUV weights in Q15 fixed point. The offsets already include the
+    // rounding term, so a component is (B * b + G * g + R * r + offset) >> 15.
+    struct ColorCoefficients
+    {
+        int16_t yb, yg, yr;
+        int16_t ub, ug, ur;
+        int16_t vb, vg, vr;
+        int32_t yOffset;
+        int32_t uvOffset;
+    };
+
+    ColorCoefficients ComputeColorCoefficients(ColorMatrix matrix, ColorRange range);
+
+    // Converts RGB32 rows [rowBegin, rowEnd) of `src` into `dst`, which must
+    // be NV12 or I420 with the same size. Width and both row bounds must be
+    // even. Every SimdLevel produces bit-identical output; Scalar is the
+    // reference the vector kernels are checked against. Packed frames of a
+    // width WithSpecializedWidth knows use kernels built for that width.
+    void ConvertRGB32Rows(SimdLevel level, const ColorCoefficients& coefficients,
+        const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd,
+        KernelDispatch dispatch = KernelDispatch::Specialized);
+
+    // ------------------------------------------------------------------------
+
+    // RGB32 -> NV12/I420 converter using the best kernel for this CPU,
+    // optionally splitting the frame into row bands across threads.
+    class ColorConverter
+    {
+    public:
+        ColorConverter(ColorMatrix matrix, ColorRange range, size_t threadCount = 1, SimdLevel level = DetectSimdLevel(),
+            KernelDispatch dispatch = KernelDispatch::Specialized);
+
+        void convert(const FrameView& src, const FrameView& dst);
+
+        // Converts rows [rowBegin, rowEnd) only, both bounds even.
+        void convertRows(const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd);
+
+        SimdLevel getSimdLevel() const { return level; }
+        KernelDispatch getKernelDispatch() const { return dispatch; }
+
+    private:
+        ColorCoefficients coefficients;
+        SimdLevel level;
+        KernelDispatch dispatch;
+        std::unique_ptr<RowBandExecutor> executor;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Renders with an RGB32 producer into a scratch frame and converts the
+    // result into the (NV12 or I420) destination.
+    class ConvertingFrameProducer : public FrameProducer
+    {
+    public:
+        ConvertingFrameProducer(FrameProducer& source, ColorConverter& converter)
+            : source(source), converter(converter) {}
+
+        void render(const FrameView& frame, uint64_t frameIndex) override;
+
+    private:
+        FrameProducer& source;
+        ColorConverter& converter;
+        std::unique_ptr<MemoryFrameBuffer> scratch;
+    };
+
+}
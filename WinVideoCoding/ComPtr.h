@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace IMFWrappers
+{
+
+    // Owns one reference to a reference counted object, anything with COM
+    // style AddRef() and Release(). Same size as a raw pointer, no virtual
+    // functions, and move-only: a second owner has to be asked for with
+    // copy(), so every AddRef is visible at the call site.
+    //
+    // Raw pointers stay the way to pass an object without transferring
+    // ownership, e.g. into COM methods or the helpers in IMFObjectWrapper.h.
+    template<typename T>
+    class ComPtr
+    {
+    public:
+        ComPtr() : ptr(nullptr) {}
+        ComPtr(std::nullptr_t) : ptr(nullptr) {}
+
+        ComPtr(ComPtr&& other) noexcept : ptr(other.ptr)
+        {
+            other.ptr = nullptr;
+        }
+
+        // Moves from a pointer to a derived interface, e.g. IMFMediaType
+        // into ComPtr<IMFAttributes>.
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        ComPtr(ComPtr<U>&& other) : ptr(other.detach()) {}
+
+        ComPtr(const ComPtr&) = delete;
+        ComPtr& operator=(const ComPtr&) = delete;
+
+        ComPtr& operator=(ComPtr&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                ptr = other.ptr;
+                other.ptr = nullptr;
+            }
+            return *this;
+        }
+
+        ComPtr& operator=(std::nullptr_t)
+        {
+            reset();
+            return *this;
+        }
+
+        ~ComPtr()
+        {
+            reset();
+        }
+
+        // Takes over a reference the caller already holds, e.g. one returned
+        // through an out parameter.
+        static ComPtr adopt(T* object)
+        {
+            ComPtr result;
+            result.ptr = object;
+            return result;
+        }
+
+        // Adds a reference of its own to an object the caller only borrows.
+        static ComPtr share(T* object)
+        {
+            if (object != nullptr)
+            {
+                object->AddRef();
+            }
+            return adopt(object);
+        }
+
+        // A second owner of the same object.
+        ComPtr copy() const
+        {
+            return share(ptr);
+        }
+
+        T* get() const { return ptr; }
+        T* operator->() const { return ptr; }
+        explicit operator bool() const { return ptr != nullptr; }
+
+        // Releases the current object and returns the slot for a T** out
+        // parameter, which then hands its reference to this pointer:
+        //     DO_CHECKED_OPERATION(MFCreateSample(sample.receive()));
+        T** receive()
+        {
+            reset();
+            return &ptr;
+        }
+
+        // Gives up ownership without releasing.
+        T* detach()
+        {
+            T* object = ptr;
+            ptr = nullptr;
+            return object;
+        }
+
+        void reset()
+        {
+            if (ptr != nullptr)
+            {
+                // Cleared first, Release may re-enter through callbacks.
+                T* object = ptr;
+                ptr = nullptr;
+                object->Release();
+            }
+        }
+
+        void swap(ComPtr& other)
+        {
+            std::swap(ptr, other.ptr);
+        }
+
+    private:
+        T* ptr;
+    };
+
+    template<typename T>
+    bool operator==(const ComPtr<T>& a, const ComPtr<T>& b) { return a.get() == b.get(); }
+
+    template<typename T>
+    bool operator!=(const ComPtr<T>& a, const ComPtr<T>& b) { return a.get() != b.get(); }
+
+}
@@ -0,0 +1,96 @@
+#include "CpuFeatures.h"
+
+#ifdef VC_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace VideoCoding
+{
+
+#ifdef VC_X86
+    namespace
+    {
+        void Cpuid(int leaf, int subleaf, int regs[4])
+        {
+#ifdef _MSC_VER
+            __cpuidex(regs, leaf, subleaf);
+#else
+            unsigned int a, b, c, d;
+            __cpuid_count(leaf, subleaf, a, b, c, d);
+            regs[0] = static_cast<int>(a);
+            regs[1] = static_cast<int>(b);
+            regs[2] = static_cast<int>(c);
+            regs[3] = static_cast<int>(d);
+#endif
+        }
+
+        unsigned long long ReadXcr0()
+        {
+#ifdef _MSC_VER
+            return _xgetbv(0);
+#else
+            unsigned int lo, hi;
+            __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+        }
+
+        SimdLevel Detect()
+        {
+            int regs[4];
+            Cpuid(0, 0, regs);
+            const int maxLeaf = regs[0];
+
+            Cpuid(1, 0, regs);
+            const bool sse2 = (regs[3] & (1 << 26)) != 0;
+            const bool osxsave = (regs[2] & (1 << 27)) != 0;
+            const bool avx = (regs[2] & (1 << 28)) != 0;
+            if (!sse2)
+            {
+                return SimdLevel::Scalar;
+            }
+
+            // AVX2 also needs the OS to save the YMM registers.
+            if (maxLeaf >= 7 && osxsave && avx && (ReadXcr0() & 0x6) == 0x6)
+            {
+                Cpuid(7, 0, regs);
+                if ((regs[1] & (1 << 5)) != 0)
+                {
+                    return SimdLevel::AVX2;
+                }
+            }
+            return SimdLevel::SSE2;
+        }
+    }
+
+    SimdLevel DetectSimdLevel()
+    {
+        static const SimdLevel level = Detect();
+        return level;
+    }
+#else
+    SimdLevel DetectSimdLevel()
+    {
+        return SimdLevel::Scalar;
+    }
+#endif
+
+    const char* SimdLevelName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::SSE2:
+            return "sse2";
+        case SimdLevel::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+        }
+    }
+
+}
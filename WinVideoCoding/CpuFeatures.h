@@ -0,0 +1,31 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VC_X86 1
+#endif
+
+// Marks a function as allowed to use AVX2 instructions. MSVC accepts AVX2
+// intrinsics in any function, GCC and Clang need a per-function target.
+#if defined(VC_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define VC_TARGET_AVX2
+#endif
+
+namespace VideoCoding
+{
+
+    enum class SimdLevel
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    // Best instruction set supported by both the CPU and the OS. Detected
+    // once, then cached.
+    SimdLevel DetectSimdLevel();
+
+    const char* SimdLevelName(SimdLevel level);
+
+}
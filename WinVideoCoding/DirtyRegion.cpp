@@ -0,0 +1,215 @@
+#include "DirtyRegion.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "FrameGeometry.h"
+
+namespace VideoCoding
+{
+
+    void DirtyRows::add(uint32_t begin, uint32_t end)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+        // Find the first range that ends at or after begin, then swallow every
+        // range that overlaps or touches [begin, end).
+        auto first = std::lower_bound(ranges.begin(), ranges.end(), begin,
+            [](const Range& range, uint32_t value) { return range.second < value; });
+        auto last = first;
+        while (last != ranges.end() && last->first <= end)
+        {
+            begin = std::min(begin, last->first);
+            end = std::max(end, last->second);
+            ++last;
+        }
+        first = ranges.erase(first, last);
+        ranges.insert(first, Range(begin, end));
+    }
+
+    void DirtyRows::merge(const DirtyRows& other)
+    {
+        for (const Range& range : other.ranges)
+        {
+            add(range.first, range.second);
+        }
+    }
+
+    void DirtyRows::align(uint32_t alignment, uint32_t height)
+    {
+        std::vector<Range> unaligned;
+        unaligned.swap(ranges);
+        for (const Range& range : unaligned)
+        {
+            const uint32_t begin = range.first / alignment * alignment;
+            const uint32_t end = std::min(height, (range.second + alignment - 1) / alignment * alignment);
+            add(begin, end);
+        }
+    }
+
+    uint32_t DirtyRows::rowCount() const
+    {
+        uint32_t rows = 0;
+        for (const Range& range : ranges)
+        {
+            rows += range.second - range.first;
+        }
+        return rows;
+    }
+
+    // ------------------------------------------------------------------------
+
+    bool DirtyRegionTracker::takeContents(uint64_t bufferId, uint64_t& frameIndex)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = contents.find(bufferId);
+        if (it == contents.end())
+        {
+            return false;
+        }
+        frameIndex = it->second;
+        contents.erase(it);
+        return true;
+    }
+
+    void DirtyRegionTracker::recordContents(uint64_t bufferId, uint64_t frameIndex, uint64_t oldestUseful)
+    {
+        // Buffers dropped by a pool leave their entry behind; sweep the ones
+        // too old to be patched once the map has grown well past any pool.
+        const size_t SWEEP_THRESHOLD = 256;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        contents[bufferId] = frameIndex;
+        if (contents.size() > SWEEP_THRESHOLD)
+        {
+            for (auto it = contents.begin(); it != contents.end();)
+            {
+                it = it->second < oldestUseful ? contents.erase(it) : std::next(it);
+            }
+        }
+    }
+
+    void DirtyRegionTracker::addFrame(bool fullCopy, uint64_t bytesCopied, uint64_t bytesFull)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++stats_.frames;
+        if (fullCopy)
+        {
+            ++stats_.fullCopies;
+        }
+        stats_.bytesCopied += bytesCopied;
+        stats_.bytesFull += bytesFull;
+    }
+
+    DirtyRegionStats DirtyRegionTracker::stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats_;
+    }
+
+    // ------------------------------------------------------------------------
+
+    DirtyRegionProducer::DirtyRegionProducer(DirtyFrameProducer& source, DirtyRegionTracker& tracker, ColorConverter* converter, size_t historyDepth)
+        : source(source), tracker(tracker), converter(converter), historyDepth(std::max<size_t>(1, historyDepth)), masterIndex(0), historyBase(0)
+    {
+    }
+
+    void DirtyRegionProducer::advanceMaster(uint32_t width, uint32_t height, uint64_t frameIndex)
+    {
+        const bool reusable = master && master->view().width == width && master->view().height == height && frameIndex >= masterIndex;
+        if (!reusable)
+        {
+            if (!master || master->view().width != width || master->view().height != height)
+            {
+                master.reset(new MemoryFrameBuffer(width, height, PixelFormat::RGB32));
+            }
+            source.renderFull(master->view(), frameIndex);
+            masterIndex = frameIndex;
+            historyBase = frameIndex;
+            history.clear();
+            return;
+        }
+
+        try
+        {
+            while (masterIndex < frameIndex)
+            {
+                history.push_back(DirtyRows());
+                source.renderChanges(master->view(), masterIndex + 1, history.back());
+                ++masterIndex;
+                if (history.size() > historyDepth)
+                {
+                    history.pop_front();
+                    ++historyBase;
+                }
+            }
+        }
+        catch (...)
+        {
+            // The master is half updated, start over from a full render.
+            master.reset();
+            throw;
+        }
+    }
+
+    void DirtyRegionProducer::copyRows(const FrameView& frame, const DirtyRows& rows)
+    {
+        const FrameView src = master->view();
+        if (frame.format != PixelFormat::RGB32)
+        {
+            for (const DirtyRows::Range& range : rows.getRanges())
+            {
+                converter->convertRows(src, frame, range.first, range.second);
+            }
+            return;
+        }
+
+        for (const DirtyRows::Range& range : rows.getRanges())
+        {
+            CopyFrameRows(src, frame, range.first, range.second);
+        }
+    }
+
+    void DirtyRegionProducer::render(const FrameView& frame, uint64_t frameIndex)
+    {
+        if (frame.format != PixelFormat::RGB32 && converter == nullptr)
+        {
+            throw std::invalid_argument("DirtyRegionProducer: NV12/I420 output needs a ColorConverter");
+        }
+
+        advanceMaster(frame.width, frame.height, frameIndex);
+
+        uint64_t held = 0;
+        const bool known = frame.bufferId != 0 && tracker.takeContents(frame.bufferId, held)
+            && held >= historyBase && held <= frameIndex;
+
+        DirtyRows rows;
+        if (known)
+        {
+            for (uint64_t i = held; i < frameIndex; ++i)
+            {
+                rows.merge(history[static_cast<size_t>(i - historyBase)]);
+            }
+        }
+        else
+        {
+            rows.add(0, frame.height);
+        }
+        if (frame.format != PixelFormat::RGB32)
+        {
+            rows.align(2, frame.height);
+        }
+
+        copyRows(frame, rows);
+
+        if (frame.bufferId != 0)
+        {
+            tracker.recordContents(frame.bufferId, frameIndex, historyBase);
+        }
+        const uint64_t bytesFull = FrameBytes(frame.format, frame.width, frame.height);
+        tracker.addFrame(!known, bytesFull / frame.height * rows.rowCount(), bytesFull);
+    }
+
+}
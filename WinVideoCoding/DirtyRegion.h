@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ColorConversion.h"
+#include "FrameView.h"
+#include "MemoryFrameBuffer.h"
+
+namespace VideoCoding
+{
+
+    // Set of changed rows, kept as sorted, non-overlapping [begin, end) ranges.
+    class DirtyRows
+    {
+    public:
+        typedef std::pair<uint32_t, uint32_t> Range;
+
+        void clear() { ranges.clear(); }
+        void add(uint32_t begin, uint32_t end);
+        void addRow(uint32_t y) { add(y, y + 1); }
+        void merge(const DirtyRows& other);
+
+        // Widens every range to multiples of `alignment` rows, clamped to
+        // height. 4:2:0 frames are patched in row pairs.
+        void align(uint32_t alignment, uint32_t height);
+
+        bool isEmpty() const { return ranges.empty(); }
+        uint32_t rowCount() const;
+        const std::vector<Range>& getRanges() const { return ranges; }
+
+    private:
+        std::vector<Range> ranges;
+    };
+
+    // RGB32 producer that can update the previous frame in place and say
+    // which rows it touched, for mostly static content.
+    class DirtyFrameProducer
+    {
+    public:
+        virtual ~DirtyFrameProducer() {}
+
+        // Renders frame frameIndex from scratch.
+        virtual void renderFull(const FrameView& frame, uint64_t frameIndex) = 0;
+
+        // `frame` holds frame frameIndex - 1; turns it into frameIndex and
+        // adds every row that may have changed to `changed`.
+        virtual void renderChanges(const FrameView& frame, uint64_t frameIndex, DirtyRows& changed) = 0;
+    };
+
+    struct DirtyRegionStats
+    {
+        uint64_t frames;
+        uint64_t fullCopies;        // frames whose buffer content was unknown or too old
+        uint64_t bytesCopied;       // bytes written into sink buffers
+        uint64_t bytesFull;         // bytes a full copy of every frame would have written
+
+        double copiedFraction() const { return bytesFull > 0 ? static_cast<double>(bytesCopied) / bytesFull : 0.0; }
+    };
+
+    // Remembers which frame each sink buffer (by FrameView::bufferId) holds.
+    // Shared by all DirtyRegionProducers writing to one sink, since pooled
+    // buffers move between producers.
+    class DirtyRegionTracker
+    {
+    public:
+        DirtyRegionTracker() : stats_() {}
+
+        // Frame index the buffer holds, false if unknown. Forgets the buffer
+        // until recordContents() so a failed patch is never trusted.
+        bool takeContents(uint64_t bufferId, uint64_t& frameIndex);
+        void recordContents(uint64_t bufferId, uint64_t frameIndex, uint64_t oldestUseful);
+
+        void addFrame(bool fullCopy, uint64_t bytesCopied, uint64_t bytesFull);
+        DirtyRegionStats stats() const;
+
+    private:
+        mutable std::mutex mutex;
+        std::unordered_map<uint64_t, uint64_t> contents;
+        DirtyRegionStats stats_;
+    };
+
+    // Keeps a private RGB32 master copy of the stream advanced by a
+    // DirtyFrameProducer, and brings each sink buffer up to date by patching
+    // only the rows changed since the frame that buffer last held. Buffers it
+    // has not seen, or that are more than historyDepth frames behind, get a
+    // full copy. With a converter the patched rows are converted to NV12 or
+    // I420, otherwise the sink must take RGB32.
+    //
+    // Not thread safe; give each pipeline producer its own instance sharing
+    // one tracker.
+    class DirtyRegionProducer : public FrameProducer
+    {
+    public:
+        DirtyRegionProducer(DirtyFrameProducer& source, DirtyRegionTracker& tracker, ColorConverter* converter, size_t historyDepth = 16);
+
+        void render(const FrameView& frame, uint64_t frameIndex) override;
+
+    private:
+        void advanceMaster(uint32_t width, uint32_t height, uint64_t frameIndex);
+        void copyRows(const FrameView& frame, const DirtyRows& rows);
+
+        DirtyFrameProducer& source;
+        DirtyRegionTracker& tracker;
+        ColorConverter* converter;
+        const size_t historyDepth;
+
+        std::unique_ptr<MemoryFrameBuffer> master;
+        uint64_t masterIndex;
+        uint64_t historyBase;                   // master can be patched from any frame >= this
+        std::deque<DirtyRows> history;          // history[i] turns frame historyBase + i into the next
+    };
+
+}
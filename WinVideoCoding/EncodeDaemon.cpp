@@ -0,0 +1,610 @@
+#include "EncodeDaemon.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        const char* EventName(DaemonEventKind kind)
+        {
+            switch (kind)
+            {
+            case DaemonEventKind::Accepted:
+                return "accepted";
+            case DaemonEventKind::Progress:
+                return "progress";
+            case DaemonEventKind::Done:
+                return "done";
+            case DaemonEventKind::Failed:
+                return "failed";
+            case DaemonEventKind::Rejected:
+                return "rejected";
+            case DaemonEventKind::Status:
+                return "status";
+            default:
+                return "closing";
+            }
+        }
+
+        std::vector<std::string> SplitFields(const std::string& line)
+        {
+            std::vector<std::string> fields;
+            std::istringstream fieldStream(line);
+            std::string field;
+            while (std::getline(fieldStream, field, '\t'))
+            {
+                fields.push_back(field);
+            }
+            return fields;
+        }
+
+        std::string OneLine(const std::string& text)
+        {
+            std::string line = text;
+            std::replace(line.begin(), line.end(), '\t', ' ');
+            std::replace(line.begin(), line.end(), '\r', ' ');
+            std::replace(line.begin(), line.end(), '\n', ' ');
+            return line;
+        }
+
+        // Whole field or throw, like the manifest parser.
+        template<typename T>
+        T ParseField(const std::string& text, const std::string& line)
+        {
+            std::istringstream in(text);
+            T value = T();
+            if (text.empty() || !(in >> value) || in.peek() != std::char_traits<char>::eof())
+            {
+                throw std::invalid_argument("bad number '" + text + "' in: " + line);
+            }
+            return value;
+        }
+
+        void ExpectFields(const std::vector<std::string>& fields, size_t count, const std::string& line)
+        {
+            if (fields.size() != count)
+            {
+                throw std::invalid_argument("expected " + std::to_string(count) + " fields in: " + line);
+            }
+        }
+
+        DaemonEvent MakeEvent(DaemonEventKind kind, uint64_t jobId)
+        {
+            DaemonEvent event = DaemonEvent();
+            event.kind = kind;
+            event.jobId = jobId;
+            return event;
+        }
+
+        double SecondsSince(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    DaemonRequest ParseDaemonRequest(const std::string& line)
+    {
+        const std::vector<std::string> fields = SplitFields(line);
+        DaemonRequest request = DaemonRequest();
+        if (fields.size() == 1 && fields[0] == "status")
+        {
+            request.kind = DaemonRequestKind::Status;
+            return request;
+        }
+        if (fields.size() == 1 && fields[0] == "shutdown")
+        {
+            request.kind = DaemonRequestKind::Shutdown;
+            return request;
+        }
+        if (fields.empty() || fields[0] != "encode")
+        {
+            throw std::invalid_argument("unknown request: " + line);
+        }
+
+        // The rest is a manifest line, without the memory estimate.
+        std::istringstream manifest(fields.size() > 1 ? line.substr(line.find('\t') + 1) : std::string());
+        const std::vector<TranscodeJob> jobs = ParseTranscodeManifest(manifest);
+        if (jobs.size() != 1 || fields.size() > 5)
+        {
+            throw std::invalid_argument("expected encode<TAB>input<TAB>output[<TAB>audio_profile[<TAB>video_profile]]");
+        }
+        request.kind = DaemonRequestKind::Encode;
+        request.job = jobs[0];
+        return request;
+    }
+
+    std::string FormatDaemonRequest(const DaemonRequest& request)
+    {
+        switch (request.kind)
+        {
+        case DaemonRequestKind::Status:
+            return "status";
+        case DaemonRequestKind::Shutdown:
+            return "shutdown";
+        default:
+        {
+            std::ostringstream line;
+            line << "encode\t" << OneLine(request.job.input) << "\t" << OneLine(request.job.output) << "\t"
+                << request.job.audioProfile << "\t" << request.job.videoProfile;
+            return line.str();
+        }
+        }
+    }
+
+    std::string FormatDaemonEvent(const DaemonEvent& event)
+    {
+        std::ostringstream line;
+        line << EventName(event.kind);
+        switch (event.kind)
+        {
+        case DaemonEventKind::Accepted:
+            line << "\t" << event.jobId << "\t" << event.jobsAhead;
+            break;
+        case DaemonEventKind::Progress:
+            line << "\t" << event.jobId << "\t" << event.progress.fraction << "\t" << event.progress.position;
+            break;
+        case DaemonEventKind::Done:
+            line << "\t" << event.jobId << "\t" << event.outcome.mediaDuration << "\t" << event.outcome.outputBytes << "\t" << event.seconds;
+            break;
+        case DaemonEventKind::Failed:
+            line << "\t" << event.jobId << "\t" << OneLine(event.message);
+            break;
+        case DaemonEventKind::Rejected:
+            line << "\t" << OneLine(event.message);
+            break;
+        case DaemonEventKind::Status:
+            line << "\t" << event.status.queued << "\t" << event.status.running << "\t" << event.status.succeeded
+                << "\t" << event.status.failed << "\t" << event.status.runners;
+            break;
+        default:
+            break;
+        }
+        return line.str();
+    }
+
+    DaemonEvent ParseDaemonEvent(const std::string& line)
+    {
+        const std::vector<std::string> fields = SplitFields(line);
+        const std::string name = fields.empty() ? std::string() : fields[0];
+        DaemonEvent event = DaemonEvent();
+        if (name == "accepted")
+        {
+            ExpectFields(fields, 3, line);
+            event.kind = DaemonEventKind::Accepted;
+            event.jobId = ParseField<uint64_t>(fields[1], line);
+            event.jobsAhead = ParseField<size_t>(fields[2], line);
+        }
+        else if (name == "progress")
+        {
+            ExpectFields(fields, 4, line);
+            event.kind = DaemonEventKind::Progress;
+            event.jobId = ParseField<uint64_t>(fields[1], line);
+            event.progress.fraction = ParseField<double>(fields[2], line);
+            event.progress.position = ParseField<int64_t>(fields[3], line);
+        }
+        else if (name == "done")
+        {
+            ExpectFields(fields, 5, line);
+            event.kind = DaemonEventKind::Done;
+            event.jobId = ParseField<uint64_t>(fields[1], line);
+            event.outcome.mediaDuration = ParseField<int64_t>(fields[2], line);
+            event.outcome.outputBytes = ParseField<uint64_t>(fields[3], line);
+            event.seconds = ParseField<double>(fields[4], line);
+        }
+        else if (name == "failed")
+        {
+            // An empty message leaves no trailing field.
+            ExpectFields(fields, fields.size() == 2 ? 2 : 3, line);
+            event.kind = DaemonEventKind::Failed;
+            event.jobId = ParseField<uint64_t>(fields[1], line);
+            event.message = fields.size() > 2 ? fields[2] : std::string();
+        }
+        else if (name == "rejected")
+        {
+            event.kind = DaemonEventKind::Rejected;
+            event.message = fields.size() > 1 ? fields[1] : std::string();
+        }
+        else if (name == "status")
+        {
+            ExpectFields(fields, 6, line);
+            event.kind = DaemonEventKind::Status;
+            event.status.queued = ParseField<size_t>(fields[1], line);
+            event.status.running = ParseField<size_t>(fields[2], line);
+            event.status.succeeded = ParseField<uint64_t>(fields[3], line);
+            event.status.failed = ParseField<uint64_t>(fields[4], line);
+            event.status.runners = ParseField<size_t>(fields[5], line);
+        }
+        else if (name == "closing" && fields.size() == 1)
+        {
+            event.kind = DaemonEventKind::Closing;
+        }
+        else
+        {
+            throw std::invalid_argument("unknown event: " + line);
+        }
+        return event;
+    }
+
+    // ------------------------------------------------------------------------
+
+    EncodeDaemon::EncodeDaemon(const EncodeDaemonSettings& settings, const TranscodeRunnerFactory& createRunner)
+        : sessionLimit(settings.maxSessions > 0 ? settings.maxSessions : DefaultSessionLimit()),
+          maxQueued(settings.maxQueued),
+          maxAttempts(std::max(1u, settings.maxAttempts)),
+          fragmentDuration(settings.fragmentDuration),
+          createRunner(createRunner),
+          reserved(0), running(0), nextId(0), succeeded(0), failed(0), runners(0), stopping(false)
+    {
+        for (size_t i = 0; i < sessionLimit; ++i)
+        {
+            workers.emplace_back([this]() { work(); });
+        }
+    }
+
+    EncodeDaemon::~EncodeDaemon()
+    {
+        stop();
+    }
+
+    DaemonEvent EncodeDaemon::submit(const TranscodeJob& job, const EventCallback& onEvent)
+    {
+        DaemonEvent event = MakeEvent(DaemonEventKind::Rejected, 0);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping)
+            {
+                event.message = "daemon is shutting down";
+            }
+            else if (maxQueued > 0 && queue.size() + reserved >= maxQueued)
+            {
+                event.message = "queue is full (" + std::to_string(maxQueued) + " jobs)";
+            }
+            else
+            {
+                event.kind = DaemonEventKind::Accepted;
+                event.jobId = ++nextId;
+                event.jobsAhead = queue.size() + reserved + running;
+                ++reserved;
+            }
+        }
+        if (onEvent)
+        {
+            onEvent(event);
+        }
+        if (event.kind == DaemonEventKind::Rejected)
+        {
+            return event;
+        }
+
+        // Only now can a worker see the job, so its Accepted event is out
+        // before any other.
+        QueuedJob queued = { event.jobId, job, onEvent, 0, 0.0 };
+        if (queued.job.fragmentDuration == 0)
+        {
+            queued.job.fragmentDuration = fragmentDuration;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        --reserved;
+        queue.push_back(queued);
+        changed.notify_all();
+        return event;
+    }
+
+    DaemonStatus EncodeDaemon::getStatus() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        DaemonStatus status = { queue.size() + reserved, running, succeeded, failed, runners };
+        return status;
+    }
+
+    void EncodeDaemon::stop()
+    {
+        std::vector<std::thread> stopped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            stopped.swap(workers);
+            changed.notify_all();
+        }
+        for (std::thread& thread : stopped)
+        {
+            thread.join();
+        }
+    }
+
+    void EncodeDaemon::work()
+    {
+        std::unique_ptr<TranscodeRunner> runner;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            // A stopping daemon still runs what it accepted, including jobs
+            // whose Accepted event is being delivered.
+            changed.wait(lock, [this]() { return !queue.empty() || (stopping && reserved == 0); });
+            if (queue.empty())
+            {
+                break;
+            }
+
+            QueuedJob queued = queue.front();
+            queue.pop_front();
+            ++running;
+            ++queued.attempts;
+            lock.unlock();
+
+            bool succeeded = false;
+            bool retryable = true;
+            TranscodeOutcome outcome = { 0, 0 };
+            std::string error;
+            const auto attemptStart = std::chrono::steady_clock::now();
+            try
+            {
+                // Kept for the worker's lifetime; a runner that fails to
+                // start counts against the job and is tried again for the
+                // next one.
+                if (!runner)
+                {
+                    runner = createRunner();
+                    std::lock_guard<std::mutex> counted(mutex);
+                    ++runners;
+                }
+                const uint64_t id = queued.id;
+                const EventCallback& onEvent = queued.onEvent;
+                TranscodeProgressCallback onProgress;
+                if (onEvent)
+                {
+                    onProgress = [id, &onEvent](const SessionProgress& progress)
+                    {
+                        DaemonEvent event = MakeEvent(DaemonEventKind::Progress, id);
+                        event.progress = progress;
+                        onEvent(event);
+                    };
+                }
+                outcome = runner->transcodeWithProgress(queued.job, onProgress);
+                succeeded = true;
+            }
+            catch (const TranscodeError& err)
+            {
+                error = err.what();
+                retryable = err.isRetryable();
+            }
+            catch (const std::exception& err)
+            {
+                error = err.what();
+            }
+            queued.seconds += SecondsSince(attemptStart);
+
+            const bool finished = succeeded || !retryable || queued.attempts >= maxAttempts;
+            lock.lock();
+            --running;
+            if (!finished)
+            {
+                queue.push_back(queued);
+                changed.notify_all();
+                continue;
+            }
+            if (succeeded)
+            {
+                ++this->succeeded;
+            }
+            else
+            {
+                ++failed;
+            }
+            lock.unlock();
+
+            if (queued.onEvent)
+            {
+                DaemonEvent event = MakeEvent(succeeded ? DaemonEventKind::Done : DaemonEventKind::Failed, queued.id);
+                event.outcome = outcome;
+                event.seconds = queued.seconds;
+                event.message = error;
+                queued.onEvent(event);
+            }
+            lock.lock();
+        }
+        lock.unlock();
+        runner.reset();
+    }
+
+    // ------------------------------------------------------------------------
+
+    void ServeEncodeDaemon(LocalListener& listener, EncodeDaemon& daemon, std::ostream& log)
+    {
+        std::mutex logMutex;
+        auto writeLog = [&logMutex, &log](const std::string& line)
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            log << line << std::endl;
+        };
+
+        auto serve = [&](std::shared_ptr<LocalConnection> connection, size_t client)
+        {
+            const std::string who = "client " + std::to_string(client);
+            writeLog(who + " connected");
+            std::string line;
+            while (connection->readLine(line))
+            {
+                if (line.empty())
+                {
+                    continue;
+                }
+                DaemonRequest request = DaemonRequest();
+                try
+                {
+                    request = ParseDaemonRequest(line);
+                }
+                catch (const std::invalid_argument& err)
+                {
+                    DaemonEvent rejected = MakeEvent(DaemonEventKind::Rejected, 0);
+                    rejected.message = err.what();
+                    connection->writeLine(FormatDaemonEvent(rejected));
+                    continue;
+                }
+
+                if (request.kind == DaemonRequestKind::Status)
+                {
+                    DaemonEvent status = MakeEvent(DaemonEventKind::Status, 0);
+                    status.status = daemon.getStatus();
+                    connection->writeLine(FormatDaemonEvent(status));
+                }
+                else if (request.kind == DaemonRequestKind::Shutdown)
+                {
+                    writeLog(who + " asked for shutdown");
+                    connection->writeLine(FormatDaemonEvent(MakeEvent(DaemonEventKind::Closing, 0)));
+                    listener.close();
+                }
+                else
+                {
+                    const TranscodeJob job = request.job;
+                    // Holds the connection, so events of a job whose client
+                    // hung up go nowhere rather than to a closed handle.
+                    daemon.submit(job, [connection, who, job, &writeLog](const DaemonEvent& event)
+                    {
+                        connection->writeLine(FormatDaemonEvent(event));
+                        std::ostringstream entry;
+                        if (event.kind == DaemonEventKind::Accepted)
+                        {
+                            entry << who << ": job " << event.jobId << " accepted, " << job.input << " -> " << job.output;
+                        }
+                        else if (event.kind == DaemonEventKind::Done)
+                        {
+                            entry << who << ": job " << event.jobId << " done in " << event.seconds << " s";
+                        }
+                        else if (event.kind == DaemonEventKind::Failed)
+                        {
+                            entry << who << ": job " << event.jobId << " failed: " << event.message;
+                        }
+                        else if (event.kind == DaemonEventKind::Rejected)
+                        {
+                            entry << who << ": rejected " << job.input << ": " << event.message;
+                        }
+                        if (!entry.str().empty())
+                        {
+                            writeLog(entry.str());
+                        }
+                    });
+                }
+            }
+            writeLog(who + " disconnected");
+        };
+
+        struct Client
+        {
+            std::shared_ptr<LocalConnection> connection;
+            std::shared_ptr<std::atomic<bool>> finished;
+            std::thread thread;
+        };
+
+        std::vector<Client> clients;
+        size_t clientCount = 0;
+        for (;;)
+        {
+            std::unique_ptr<LocalConnection> accepted = listener.accept();
+            if (!accepted)
+            {
+                break;
+            }
+
+            // Threads of clients that have gone are joined as new ones
+            // arrive, so a daemon that runs for weeks doesn't collect them.
+            for (size_t i = 0; i < clients.size();)
+            {
+                if (clients[i].finished->load())
+                {
+                    clients[i].thread.join();
+                    clients[i] = std::move(clients.back());
+                    clients.pop_back();
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+
+            Client client;
+            client.connection = std::shared_ptr<LocalConnection>(accepted.release());
+            client.finished = std::make_shared<std::atomic<bool>>(false);
+            const std::shared_ptr<LocalConnection> connection = client.connection;
+            const std::shared_ptr<std::atomic<bool>> finished = client.finished;
+            const size_t number = ++clientCount;
+            client.thread = std::thread([&serve, connection, finished, number]()
+            {
+                serve(connection, number);
+                finished->store(true);
+            });
+            clients.push_back(std::move(client));
+        }
+
+        writeLog("finishing accepted jobs");
+        daemon.stop();
+        for (Client& client : clients)
+        {
+            client.connection->shutdown();
+            client.thread.join();
+        }
+    }
+
+    DaemonEvent RequestDaemon(LocalConnection& connection, const DaemonRequest& request, const EncodeDaemon::EventCallback& onEvent)
+    {
+        if (!connection.writeLine(FormatDaemonRequest(request)))
+        {
+            throw std::runtime_error("the encode daemon closed the connection");
+        }
+
+        uint64_t jobId = 0;
+        std::string line;
+        while (connection.readLine(line))
+        {
+            const DaemonEvent event = ParseDaemonEvent(line);
+            // Events of other jobs on this connection belong to other
+            // requests.
+            const bool mine = event.jobId == 0 || jobId == 0 || event.jobId == jobId;
+            if (!mine)
+            {
+                continue;
+            }
+            if (onEvent)
+            {
+                onEvent(event);
+            }
+            switch (event.kind)
+            {
+            case DaemonEventKind::Accepted:
+                jobId = event.jobId;
+                break;
+            case DaemonEventKind::Done:
+            case DaemonEventKind::Failed:
+            case DaemonEventKind::Rejected:
+                if (request.kind == DaemonRequestKind::Encode)
+                {
+                    return event;
+                }
+                break;
+            case DaemonEventKind::Status:
+                if (request.kind == DaemonRequestKind::Status)
+                {
+                    return event;
+                }
+                break;
+            case DaemonEventKind::Closing:
+                if (request.kind == DaemonRequestKind::Shutdown)
+                {
+                    return event;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        throw std::runtime_error("the encode daemon closed the connection");
+    }
+
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LocalChannel.h"
+#include "TranscodeScheduler.h"
+
+namespace VideoCoding
+{
+
+    // Line protocol between an encode daemon and its clients, tab separated
+    // like the batch manifest. Requests:
+    //     encode <TAB> input <TAB> output [<TAB> audio_profile [<TAB> video_profile]]
+    //     status
+    //     shutdown                 finish every accepted job, then exit
+    // Events for an encode request, in this order:
+    //     accepted <TAB> id <TAB> jobs_ahead
+    //     progress <TAB> id <TAB> fraction <TAB> position      zero or more
+    //     done <TAB> id <TAB> media_duration <TAB> output_bytes <TAB> seconds
+    //  or failed <TAB> id <TAB> message
+    // or instead of all of them
+    //     rejected <TAB> message
+    // The reply to status is
+    //     status <TAB> queued <TAB> running <TAB> succeeded <TAB> failed <TAB> runners
+    // and to shutdown
+    //     closing
+    // Positions and durations are in 100 ns units. A client may have several
+    // jobs in flight on one connection and tells their events apart by id.
+
+    enum class DaemonRequestKind
+    {
+        Encode,
+        Status,
+        Shutdown,
+    };
+
+    struct DaemonRequest
+    {
+        DaemonRequestKind kind;
+        TranscodeJob job;           // Encode only
+    };
+
+    // Throws std::invalid_argument for anything but the requests above.
+    DaemonRequest ParseDaemonRequest(const std::string& line);
+    std::string FormatDaemonRequest(const DaemonRequest& request);
+
+    enum class DaemonEventKind
+    {
+        Accepted,
+        Progress,
+        Done,
+        Failed,
+        Rejected,
+        Status,
+        Closing,
+    };
+
+    struct DaemonStatus
+    {
+        size_t queued;
+        size_t running;
+        uint64_t succeeded;
+        uint64_t failed;
+        size_t runners;             // runners started since the daemon started
+    };
+
+    struct DaemonEvent
+    {
+        DaemonEventKind kind;
+        uint64_t jobId;             // Accepted, Progress, Done, Failed
+        size_t jobsAhead;           // Accepted: queued or running before this one
+        SessionProgress progress;   // Progress; the duration isn't sent
+        TranscodeOutcome outcome;   // Done
+        double seconds;             // Done: wall time over every attempt
+        std::string message;        // Failed, Rejected
+        DaemonStatus status;        // Status
+    };
+
+    // Tabs and line breaks in messages become spaces.
+    std::string FormatDaemonEvent(const DaemonEvent& event);
+
+    // Throws std::invalid_argument.
+    DaemonEvent ParseDaemonEvent(const std::string& line);
+
+    // ------------------------------------------------------------------------
+
+    struct EncodeDaemonSettings
+    {
+        size_t maxSessions;         // jobs run at once, 0 picks DefaultSessionLimit()
+        size_t maxQueued;           // waiting jobs beyond which new ones are rejected, 0 means unlimited
+        unsigned maxAttempts;       // per job, at least 1
+        int64_t fragmentDuration;   // given to jobs that don't set their own
+    };
+
+    // A resident job queue for a process that keeps running between
+    // batches. Each of its maxSessions workers creates one runner, on first
+    // use, and keeps it until stop(), so runner startup (COM, Media
+    // Foundation, the cached profiles it builds) is paid once per worker
+    // rather than once per job. Jobs run in the order they were accepted;
+    // failures are retried as TranscodeScheduler does.
+    class EncodeDaemon
+    {
+    public:
+        typedef std::function<void(const DaemonEvent&)> EventCallback;
+
+        EncodeDaemon(const EncodeDaemonSettings& settings, const TranscodeRunnerFactory& createRunner);
+
+        // Calls stop().
+        ~EncodeDaemon();
+
+        EncodeDaemon(const EncodeDaemon&) = delete;
+        EncodeDaemon& operator=(const EncodeDaemon&) = delete;
+
+        // Queues a job and returns its Accepted event, or a Rejected one when
+        // the queue is full or the daemon is stopping. Every event of the job
+        // goes to onEvent, the Accepted one on this thread before the job can
+        // start and the rest on the worker that runs it, with no daemon lock
+        // held.
+        DaemonEvent submit(const TranscodeJob& job, const EventCallback& onEvent);
+
+        DaemonStatus getStatus() const;
+
+        size_t getSessionLimit() const { return sessionLimit; }
+
+        // Rejects new jobs, waits for the accepted ones to finish and their
+        // events to be delivered, then ends the workers and their runners.
+        // Idempotent.
+        void stop();
+
+    private:
+        struct QueuedJob
+        {
+            uint64_t id;
+            TranscodeJob job;
+            EventCallback onEvent;
+            unsigned attempts;
+            double seconds;
+        };
+
+        void work();
+
+        const size_t sessionLimit;
+        const size_t maxQueued;
+        const unsigned maxAttempts;
+        const int64_t fragmentDuration;
+        const TranscodeRunnerFactory createRunner;
+
+        mutable std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<QueuedJob> queue;
+        size_t reserved;            // accepted, Accepted event not delivered yet
+        size_t running;
+        uint64_t nextId;
+        uint64_t succeeded;
+        uint64_t failed;
+        size_t runners;
+        bool stopping;
+        std::vector<std::thread> workers;
+    };
+
+    // Serves `daemon` to the clients of `listener`, one thread per
+    // connection, until a client asks for shutdown. Then stops the daemon,
+    // which finishes the accepted jobs and sends their events, and hangs up
+    // on everyone. A client that disconnects doesn't cancel its jobs. Writes
+    // a line per connection and job to `log`.
+    void ServeEncodeDaemon(LocalListener& listener, EncodeDaemon& daemon, std::ostream& log);
+
+    // Sends one request and passes the events that come back to onEvent
+    // until the last one for it: Done, Failed or Rejected for an encode,
+    // Status or Closing for the others. Returns that event. Throws
+    // std::runtime_error if the daemon hangs up first.
+    DaemonEvent RequestDaemon(LocalConnection& connection, const DaemonRequest& request, const EncodeDaemon::EventCallback& onEvent = EncodeDaemon::EventCallback());
+
+}
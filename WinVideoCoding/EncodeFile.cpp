@@ -5,10 +5,20 @@
 #include <Mfidl.h>
 #include <shlwapi.h>
 #include <codecapi.h>
-#include <iostream>
+#include <mferror.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
 
 #include "CSession.h"
+#include "EncodeFile.h"
+#include "MFProfileCache.h"
+#include "Mp4Concat.h"
+#include "Mp4Fragment.h"
+#include "ProfileSweep.h"
 #include "SafeRelease.h"
+#include "Tracer.h"
 #include "WindowsError.h"
 #include "IMFObjectWrapper.h"
 
@@ -19,182 +29,432 @@
 
 #pragma warning(disable : 4996)
 
-struct H264ProfileInfo
-{
-    UINT32  profile;
-    MFRatio fps;
-    MFRatio frame_size;
-    UINT32  bitrate;
-};
+// The profile table stores profile_idc values, which these match.
+static_assert(eAVEncH264VProfile_Base == 66 && eAVEncH264VProfile_Main == 77, "H.264 profile values");
+
+int video_profile = 0;
+int audio_profile = 0;
 
-H264ProfileInfo h264_profiles[] =
+// Shared with every other job on the same profiles, see MFProfileCache.h.
+// A positive fragmentDuration selects fragmented MP4. The sink cuts
+// fragments at key frames, so the encoder is asked for one at least that
+// often.
+IMFWrappers::TranscodeProfilePtr LookupTranscodeProfile(DWORD audioProfile, DWORD videoProfile, MFTIME fragmentDuration)
 {
-    { eAVEncH264VProfile_Base,{ 15, 1 },{ 176, 144 },   128000 },
-    { eAVEncH264VProfile_Base,{ 15, 1 },{ 352, 288 },   384000 },
-    { eAVEncH264VProfile_Base,{ 30, 1 },{ 352, 288 },   384000 },
-    { eAVEncH264VProfile_Base,{ 29970, 1000 },{ 320, 240 },   528560 },
-    { eAVEncH264VProfile_Base,{ 15, 1 },{ 720, 576 },  4000000 },
-    { eAVEncH264VProfile_Main,{ 25, 1 },{ 720, 576 }, 10000000 },
-    { eAVEncH264VProfile_Main,{ 30, 1 },{ 352, 288 }, 10000000 },
-};
-
-struct AACProfileInfo
+    if (audioProfile >= AAC_PROFILE_COUNT || videoProfile >= H264_PROFILE_COUNT)
+    {
+        THROW_WINDOWS_ERROR(E_INVALIDARG);
+    }
+
+    const H264ProfileInfo& video = h264_profiles[videoProfile];
+    const uint32_t keyframeSpacing = fragmentDuration > 0 ? VideoCoding::FramesPerFragment(fragmentDuration, video.fpsNumerator, video.fpsDenominator) : 0;
+    const VideoCoding::ContainerType container = fragmentDuration > 0 ? VideoCoding::ContainerType::FragmentedMPEG4 : VideoCoding::ContainerType::MPEG4;
+    return GetTranscodeProfile(VideoCoding::MakeTranscodeDescriptor(aac_profiles[audioProfile], video, keyframeSpacing, container));
+}
+
+// Progress is printed in steps of this many percent.
+const double PROGRESS_STEP = 0.05;
+
+// Blocks until the session has closed; completion and progress are pushed
+// by the session, nothing is polled here.
+void RunEncodingSession(CSession *pSession, bool showProgress)
 {
-    UINT32  samplesPerSec;
-    UINT32  numChannels;
-    UINT32  bitsPerSample;
-    UINT32  bytesPerSec;
-    UINT32  aacProfile;
-};
-
-AACProfileInfo aac_profiles[] =
+    TRACE_SCOPE("RunEncodingSession");
+    HRESULT hr = pSession->GetNotifier()->completion().get();
+    if (showProgress)
+    {
+        std::cout << std::endl;
+    }
+    if (FAILED(hr))
+    {
+        THROW_WINDOWS_ERROR(hr);
+    }
+}
+
+MFTIME EncodeFile(PCWSTR pszInput, PCWSTR pszOutput, DWORD audioProfile, DWORD videoProfile, bool showProgress, MFTIME fragmentDuration,
+    const VideoCoding::TranscodeProgressCallback& onProgress)
 {
-    { 96000, 2, 16, 24000, 0x29 },
-    { 48000, 2, 16, 24000, 0x29 },
-    { 44100, 2, 16, 16000, 0x29 },
-    { 44100, 2, 16, 12000, 0x29 },
-};
+    IMFWrappers::MediaSourcePtr pSource = IMFWrappers::CreateMediaSource(pszInput);
+    IMFWrappers::ScopedShutdown sourceShutdown(pSource.get());
+
+    MFTIME duration = IMFWrappers::GetDuration(pSource.get());
+    if (showProgress)
+    {
+        std::cout << "Duration: " << duration << std::endl;
+    }
 
+    IMFWrappers::TranscodeProfilePtr pProfile = LookupTranscodeProfile(audioProfile, videoProfile, fragmentDuration);
 
-int video_profile = 0;
-int audio_profile = 0;
+    IMFWrappers::TopologyPtr pTopology = IMFWrappers::CreateTranscodeTopology(pSource.get(), pszOutput, pProfile.get());
+
+    VideoCoding::ProgressThrottle throttle = { std::chrono::milliseconds(0), PROGRESS_STEP };
+    IMFWrappers::ComPtr<CSession> pSession;
+    DO_CHECKED_OPERATION(CSession::Create(pSession.receive(), throttle));
+    if (showProgress)
+    {
+        pSession->GetNotifier()->onProgress([](const VideoCoding::SessionProgress& progress)
+        {
+            std::cout << static_cast<int>(progress.fraction * 100) << "% .. ";
+        });
+    }
+    if (onProgress)
+    {
+        pSession->GetNotifier()->onProgress(onProgress);
+    }
+    DO_CHECKED_OPERATION(pSession->StartEncodingSession(pTopology.get(), duration));
+
+    RunEncodingSession(pSession.get(), showProgress);
+
+    return duration;
+}
 
-IMFWrappers::IMFMediaSourceWrapper CreateMediaSource(PCWSTR pszURL)
+MFTIME EncodeFileRange(PCWSTR pszInput, PCWSTR pszOutput, DWORD audioProfile, DWORD videoProfile, const VideoCoding::MediaSegment& segment)
 {
-    // Create the source resolver.
-    IMFWrappers::IMFSourceResolverWrapper pResolver;
-    IMFWrappers::IMFMediaSourceWrapper pSource;
+    IMFWrappers::MediaSourcePtr pSource = IMFWrappers::CreateMediaSource(pszInput);
+    IMFWrappers::ScopedShutdown sourceShutdown(pSource.get());
+
+    // Parts are joined afterwards, which needs their progressive sample tables.
+    IMFWrappers::TranscodeProfilePtr pProfile = LookupTranscodeProfile(audioProfile, videoProfile, 0);
+
+    IMFWrappers::TopologyPtr pTopology = IMFWrappers::CreateTranscodeTopology(pSource.get(), pszOutput, pProfile.get());
+    IMFWrappers::SetSourceRange(pTopology.get(), segment.start, segment.end);
 
-    // Use the source resolver to create the media source
-    MF_OBJECT_TYPE objecType = MF_OBJECT_INVALID;
-    pResolver.CreateObjectFromURL(pszURL, MF_RESOLUTION_MEDIASOURCE, NULL, &objecType, pSource);
+    VideoCoding::ProgressThrottle throttle = { std::chrono::milliseconds(0), PROGRESS_STEP };
+    IMFWrappers::ComPtr<CSession> pSession;
+    DO_CHECKED_OPERATION(CSession::Create(pSession.receive(), throttle));
+    DO_CHECKED_OPERATION(pSession->StartEncodingSession(pTopology.get(), 0, segment.start));
 
-    pSource.QueryInterface();
+    RunEncodingSession(pSession.get(), false);
 
-    return std::move(pSource);
+    return segment.end - segment.start;
 }
 
-IMFWrappers::IMFAttributesWrapper CreateAACProfile(DWORD index)
+std::vector<int64_t> FindKeyframes(PCWSTR pszInput)
 {
-    if (index >= ARRAYSIZE(h264_profiles))
+    // No output type is set, so samples come out as stored.
+    IMFWrappers::SourceReaderPtr pReader = IMFWrappers::CreateSourceReader(pszInput);
+    DO_CHECKED_OPERATION(pReader->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_ALL_STREAMS), FALSE));
+    DO_CHECKED_OPERATION(pReader->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), TRUE));
+
+    std::vector<int64_t> keyframes;
+    for (;;)
     {
-        THROW_WINDOWS_ERROR(E_INVALIDARG);
+        DWORD flags = 0;
+        LONGLONG timestamp = 0;
+        IMFWrappers::SamplePtr pSample;
+        DO_CHECKED_OPERATION(pReader->ReadSample(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), 0, nullptr, &flags, &timestamp, pSample.receive()));
+        if (flags & MF_SOURCE_READERF_ENDOFSTREAM)
+        {
+            break;
+        }
+        if (pSample && MFGetAttributeUINT32(pSample.get(), MFSampleExtension_CleanPoint, FALSE))
+        {
+            keyframes.push_back(timestamp);
+        }
     }
+    return keyframes;
+}
 
-    const AACProfileInfo& profile = aac_profiles[index];
+// ------------------------------------------------------------------------
 
-    IMFWrappers::IMFAttributesWrapper pAttributes(7);
+namespace
+{
+    UINT64 GetFileSize(PCWSTR path)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExW(path, GetFileExInfoStandard, &data))
+        {
+            return 0;
+        }
+        return (static_cast<UINT64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    }
 
-    pAttributes.setGUID(MF_MT_SUBTYPE, MFAudioFormat_AAC);
-    pAttributes.setUINT32(MF_MT_AUDIO_BITS_PER_SAMPLE, profile.bitsPerSample);
-    pAttributes.setUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, profile.samplesPerSec);
-    pAttributes.setUINT32(MF_MT_AUDIO_NUM_CHANNELS, profile.numChannels);
-    pAttributes.setUINT32(MF_MT_AUDIO_AVG_BYTES_PER_SECOND, profile.bytesPerSec);
-    pAttributes.setUINT32(MF_MT_AUDIO_BLOCK_ALIGNMENT, 1);
-    pAttributes.setUINT32(MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION, profile.aacProfile);
+    // Errors that will fail the same way however often the job is retried.
+    bool IsPermanentError(HRESULT hr)
+    {
+        switch (hr)
+        {
+        case E_INVALIDARG:
+        case __HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND):
+        case __HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND):
+        case __HRESULT_FROM_WIN32(ERROR_ACCESS_DENIED):
+        case MF_E_UNSUPPORTED_BYTESTREAM_TYPE:
+        case MF_E_UNSUPPORTED_FORMAT:
+        case MF_E_INVALIDMEDIATYPE:
+        case MF_E_TOPO_CODEC_NOT_FOUND:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Runs jobs on one scheduler worker thread. Each worker joins the MTA and
+    // holds its own MFStartup reference for as long as the runner lives.
+    class MFTranscodeRunner : public VideoCoding::TranscodeRunner
+    {
+    public:
+        MFTranscodeRunner() : comInitialized(false)
+        {
+            // The calling thread of EncodeBatch also runs jobs and may already
+            // be in an STA, which the encoding session copes with.
+            HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+            if (FAILED(hr) && hr != RPC_E_CHANGED_MODE)
+            {
+                throw VideoCoding::TranscodeError(WindowsError(hr, __FILE__, __LINE__).toString(), true);
+            }
+            comInitialized = SUCCEEDED(hr);
 
-    pAttributes.addRef(); // Is this needed?
+            hr = MFStartup(MF_VERSION);
+            if (FAILED(hr))
+            {
+                if (comInitialized)
+                {
+                    CoUninitialize();
+                }
+                throw VideoCoding::TranscodeError(WindowsError(hr, __FILE__, __LINE__).toString(), true);
+            }
+        }
 
-    return std::move(pAttributes);
+        ~MFTranscodeRunner()
+        {
+            MFShutdown();
+            if (comInitialized)
+            {
+                CoUninitialize();
+            }
+        }
+
+        VideoCoding::TranscodeOutcome transcode(const VideoCoding::TranscodeJob& job) override
+        {
+            return transcodeWithProgress(job, VideoCoding::TranscodeProgressCallback());
+        }
+
+        VideoCoding::TranscodeOutcome transcodeWithProgress(const VideoCoding::TranscodeJob& job, const VideoCoding::TranscodeProgressCallback& onProgress) override
+        {
+            const std::wstring input = IMFWrappers::ToWide(job.input);
+            const std::wstring output = IMFWrappers::ToWide(job.output);
+            try
+            {
+                VideoCoding::TranscodeOutcome outcome;
+                if (job.end > 0)
+                {
+                    const VideoCoding::MediaSegment segment = { job.start, job.end };
+                    outcome.mediaDuration = EncodeFileRange(input.c_str(), output.c_str(), job.audioProfile, job.videoProfile, segment);
+                }
+                else
+                {
+                    outcome.mediaDuration = EncodeFile(input.c_str(), output.c_str(), job.audioProfile, job.videoProfile, false, job.fragmentDuration, onProgress);
+                }
+                outcome.outputBytes = GetFileSize(output.c_str());
+                return outcome;
+            }
+            catch (const WindowsError& err)
+            {
+                throw VideoCoding::TranscodeError(err.toString(), !IsPermanentError(err.getErrorCode()));
+            }
+        }
+
+    private:
+        bool comInitialized;
+    };
+
+    void PrintProfileCacheStats(std::ostream& out)
+    {
+        const VideoCoding::ProfileCacheStats stats = GetTranscodeProfileCacheStats();
+        out << "Transcode profiles: " << stats.hits << " cached, " << stats.misses << " built";
+        if (stats.failures > 0)
+        {
+            out << ", " << stats.failures << " failed";
+        }
+        out << std::endl;
+    }
+
+    uint64_t EstimateJobMemory(const VideoCoding::TranscodeJob& job)
+    {
+        if (job.memoryEstimate > 0)
+        {
+            return job.memoryEstimate;
+        }
+        if (job.videoProfile >= 0 && job.videoProfile < static_cast<int>(H264_PROFILE_COUNT))
+        {
+            const H264ProfileInfo& profile = h264_profiles[job.videoProfile];
+            return VideoCoding::EstimateSessionMemory(profile.width, profile.height);
+        }
+        return VideoCoding::EstimateSessionMemory(1920, 1080);
+    }
 }
 
-IMFWrappers::IMFAttributesWrapper CreateH264Profile(DWORD index)
+int EncodeBatch(const std::string& manifestPath, const VideoCoding::TranscodeSchedulerSettings& settings, MFTIME fragmentDuration)
 {
-    if (index >= ARRAYSIZE(h264_profiles))
+    std::ifstream manifest(manifestPath);
+    if (!manifest)
     {
-        THROW_WINDOWS_ERROR(E_INVALIDARG);
+        std::cerr << "Can't open manifest " << manifestPath << std::endl;
+        return 1;
     }
 
-    const H264ProfileInfo& profile = h264_profiles[index];
-
-    IMFWrappers::IMFAttributesWrapper pAttributes(5);
+    std::vector<VideoCoding::TranscodeJob> jobs = VideoCoding::ParseTranscodeManifest(manifest);
+    for (VideoCoding::TranscodeJob& job : jobs)
+    {
+        job.memoryEstimate = EstimateJobMemory(job);
+        job.fragmentDuration = fragmentDuration;
+    }
 
-    pAttributes.setGUID(MF_MT_SUBTYPE, MFVideoFormat_H264);
-    pAttributes.setUINT32(MF_MT_MPEG2_PROFILE, profile.profile);
-    pAttributes.setAttributeSize(MF_MT_FRAME_SIZE, profile.frame_size.Numerator, profile.frame_size.Numerator);
-    pAttributes.setAttributeRatio(MF_MT_FRAME_RATE, profile.fps.Numerator, profile.fps.Denominator);
-    pAttributes.setUINT32(MF_MT_AVG_BITRATE, profile.bitrate);
+    VideoCoding::TranscodeScheduler scheduler(settings);
+    std::cout << "Transcoding " << jobs.size() << " files, up to " << scheduler.getSessionLimit() << " at once" << std::endl;
 
-    pAttributes.addRef(); // Is this needed?
+    const VideoCoding::TranscodeBatchReport report = scheduler.run(jobs,
+        []() { return std::unique_ptr<VideoCoding::TranscodeRunner>(new MFTranscodeRunner()); },
+        [](const VideoCoding::TranscodeJobReport& job) { VideoCoding::WriteTranscodeJobStatus(std::cout, job); });
 
-    return std::move(pAttributes);
+    VideoCoding::WriteTranscodeBatchSummary(std::cout, report);
+    PrintProfileCacheStats(std::cout);
+    return report.failed == 0 ? 0 : 1;
 }
 
-IMFWrappers::IMFTranscodeProfileWrapper CreateTranscodeProfile()
+int EncodeProfileSweep(const std::string& input, const std::string& outputPrefix, const std::string& grid,
+    const std::string& baselinePath, double tolerance)
 {
-    IMFWrappers::IMFTranscodeProfileWrapper pProfile;
-
-    // Audio attributes.
-    IMFWrappers::IMFAttributesWrapper pAudio = CreateAACProfile(audio_profile);
-    pProfile.SetAudioAttributes(pAudio);
+    const std::vector<VideoCoding::ProfileSweepPoint> points = VideoCoding::ParseProfileGrid(grid);
+    std::vector<VideoCoding::ProfileSweepResult> baseline;
+    if (!baselinePath.empty())
+    {
+        std::ifstream in(baselinePath);
+        if (!in)
+        {
+            std::cerr << "Can't open baseline " << baselinePath << std::endl;
+            return 1;
+        }
+        baseline = VideoCoding::ReadProfileSweepCsv(in);
+    }
 
-    // Video attributes.
-    IMFWrappers::IMFAttributesWrapper pVideo = CreateH264Profile(video_profile);
-    pProfile.SetVideoAttributes(pVideo);
+    std::cout << "Sweeping " << input << " through " << points.size() << " profile combinations" << std::endl;
+    MFTranscodeRunner runner;
+    const std::vector<VideoCoding::ProfileSweepResult> results = VideoCoding::RunProfileSweep(points, input, outputPrefix, runner);
+    const std::vector<VideoCoding::ProfileSweepRegression> regressions = VideoCoding::CompareProfileSweep(results, baseline, tolerance);
 
-    // Container attributes.
-    IMFWrappers::IMFAttributesWrapper pContainer(1);
-    pContainer.setGUID(MF_TRANSCODE_CONTAINERTYPE, MFTranscodeContainerType_MPEG4);
-    
-    pProfile.SetContainerAttributes(pContainer);
-    pProfile.addRef();
+    std::ofstream csv(outputPrefix + ".csv");
+    VideoCoding::WriteProfileSweepCsv(csv, results);
+    std::ofstream json(outputPrefix + ".json");
+    VideoCoding::WriteProfileSweepJson(json, results, regressions);
+    VideoCoding::WriteProfileSweepSummary(std::cout, results, regressions);
 
-    return std::move(pProfile);
+    const bool allSucceeded = std::all_of(results.begin(), results.end(), [](const VideoCoding::ProfileSweepResult& r) { return r.succeeded; });
+    return allSucceeded && regressions.empty() ? 0 : 1;
 }
 
-void RunEncodingSession(CSession *pSession, MFTIME duration)
+// Parts shorter than this cost more in session start-up than they gain.
+const MFTIME MIN_SEGMENT_LENGTH = 50000000;
+
+int EncodeSegmented(const std::string& input, const std::string& output, int audioProfile, int videoProfile, size_t segments,
+    const VideoCoding::TranscodeSchedulerSettings& settings, MFTIME fragmentDuration)
 {
-    const DWORD WAIT_PERIOD = 500;
-    const int   UPDATE_INCR = 5;
+    const std::wstring wideInput = IMFWrappers::ToWide(input);
+    MFTIME duration = 0;
+    {
+        IMFWrappers::MediaSourcePtr pSource = IMFWrappers::CreateMediaSource(wideInput.c_str());
+        IMFWrappers::ScopedShutdown sourceShutdown(pSource.get());
+        duration = IMFWrappers::GetDuration(pSource.get());
+    }
+
+    const std::vector<VideoCoding::MediaSegment> plan = VideoCoding::PlanSegments(duration, FindKeyframes(wideInput.c_str()), segments, MIN_SEGMENT_LENGTH);
 
-    HRESULT hr = S_OK;
-    MFTIME pos;
-    LONGLONG prev = 0;
-    while (1)
+    std::vector<VideoCoding::TranscodeJob> jobs;
+    std::vector<std::string> parts;
+    for (size_t i = 0; i < plan.size(); ++i)
     {
-        hr = pSession->Wait(WAIT_PERIOD);
-        if (hr == E_PENDING)
-        {
-            hr = pSession->GetEncodingPosition(&pos);
+        parts.push_back(output + ".part" + std::to_string(i) + ".mp4");
+        VideoCoding::TranscodeJob job = { input, parts.back(), audioProfile, videoProfile, 0, plan[i].start, plan[i].end, 0 };
+        job.memoryEstimate = EstimateJobMemory(job);
+        jobs.push_back(job);
+    }
 
-            LONGLONG percent = (100 * pos) / duration;
-            if (percent >= prev + UPDATE_INCR)
+    VideoCoding::TranscodeScheduler scheduler(settings);
+    std::cout << "Transcoding " << input << " as " << jobs.size() << " segments, up to " << scheduler.getSessionLimit() << " at once" << std::endl;
+
+    const VideoCoding::TranscodeBatchReport report = scheduler.run(jobs,
+        []() { return std::unique_ptr<VideoCoding::TranscodeRunner>(new MFTranscodeRunner()); },
+        [](const VideoCoding::TranscodeJobReport& job) { VideoCoding::WriteTranscodeJobStatus(std::cout, job); });
+    VideoCoding::WriteTranscodeBatchSummary(std::cout, report);
+
+    int status = 1;
+    if (report.failed == 0)
+    {
+        try
+        {
+            if (fragmentDuration > 0)
             {
-                std::cout << percent << "% .. ";
-                prev = percent;
+                const VideoCoding::FragmentedMp4Stats stats = VideoCoding::ConcatenateMp4FilesFragmented(parts, output, fragmentDuration);
+                std::cout << "Joined " << parts.size() << " segments into " << output << ", " << stats.bytes << " bytes in "
+                    << stats.fragments << " fragments" << std::endl;
             }
+            else
+            {
+                const uint64_t bytes = VideoCoding::ConcatenateMp4Files(parts, output);
+                std::cout << "Joined " << parts.size() << " segments into " << output << ", " << bytes << " bytes" << std::endl;
+            }
+            status = 0;
         }
-        else
+        catch (const std::exception& err)
         {
-            std::cout << std::endl;
-            break;
+            std::cerr << "Can't join segments: " << err.what() << std::endl;
         }
     }
-    if (FAILED(hr))
+    for (const std::string& part : parts)
     {
-        THROW_WINDOWS_ERROR(hr);
+        std::remove(part.c_str());
     }
+    return status;
 }
 
-void EncodeFile(PCWSTR pszInput, PCWSTR pszOutput)
+int RunEncodeDaemon(const std::string& endpoint, const VideoCoding::EncodeDaemonSettings& settings)
 {
-    IMFWrappers::IMFMediaSourceWrapper pSource(CreateMediaSource(pszInput));
-
-    MFTIME duration = pSource.getDuration();
-    std::cout << "Duration: " << duration << std::endl;
-
-    IMFWrappers::IMFTranscodeProfileWrapper pProfile = CreateTranscodeProfile();
+    VideoCoding::LocalListener listener(endpoint);
+    VideoCoding::EncodeDaemon daemon(settings,
+        []() { return std::unique_ptr<VideoCoding::TranscodeRunner>(new MFTranscodeRunner()); });
+    std::cout << "Encode daemon listening at " << endpoint << ", up to " << daemon.getSessionLimit() << " jobs at once" << std::endl;
 
-    IMFWrappers::IMFTopologyWrapper pTopology(pSource, pszOutput, pProfile);
+    VideoCoding::ServeEncodeDaemon(listener, daemon, std::cout);
 
-    CSession *pSession;
-    DO_CHECKED_OPERATION(CSession::Create(&pSession));
-    DO_CHECKED_OPERATION(pSession->StartEncodingSession(pTopology.get()));
-
-    RunEncodingSession(pSession, duration);
+    const VideoCoding::DaemonStatus status = daemon.getStatus();
+    std::cout << status.succeeded << " jobs succeeded, " << status.failed << " failed, " << status.runners << " runners started" << std::endl;
+    PrintProfileCacheStats(std::cout);
+    return 0;
+}
 
-    pSession->Release();
+int SubmitToDaemon(const std::string& endpoint, const VideoCoding::DaemonRequest& request)
+{
+    std::unique_ptr<VideoCoding::LocalConnection> connection = VideoCoding::LocalConnection::connect(endpoint);
+    const VideoCoding::DaemonEvent last = VideoCoding::RequestDaemon(*connection, request, [](const VideoCoding::DaemonEvent& event)
+    {
+        if (event.kind == VideoCoding::DaemonEventKind::Accepted)
+        {
+            std::cout << "Job " << event.jobId << " accepted, " << event.jobsAhead << " ahead of it" << std::endl;
+        }
+        else if (event.kind == VideoCoding::DaemonEventKind::Progress)
+        {
+            std::cout << static_cast<int>(event.progress.fraction * 100) << "% .. " << std::flush;
+        }
+    });
 
+    switch (last.kind)
+    {
+    case VideoCoding::DaemonEventKind::Done:
+        std::cout << std::endl << "Done: " << last.outcome.mediaDuration / 1e7 << " s of media, " << last.outcome.outputBytes
+            << " bytes in " << last.seconds << " s" << std::endl;
+        return 0;
+    case VideoCoding::DaemonEventKind::Status:
+        std::cout << last.status.queued << " queued, " << last.status.running << " running, " << last.status.succeeded << " succeeded, "
+            << last.status.failed << " failed, " << last.status.runners << " runners started" << std::endl;
+        return 0;
+    case VideoCoding::DaemonEventKind::Closing:
+        std::cout << "The daemon is finishing its jobs and shutting down" << std::endl;
+        return 0;
+    default:
+        std::cout << std::endl;
+        std::cerr << (last.kind == VideoCoding::DaemonEventKind::Rejected ? "Rejected: " : "Failed: ") << last.message << std::endl;
+        return 1;
+    }
 }
 
 /*
@@ -237,7 +497,7 @@ int main(int argc, char* argv[])
 
             try
             {
-                EncodeFile(arg1, arg2);
+                EncodeFile(arg1, arg2, audio_profile, video_profile, true);
             }
             catch (const WindowsError& err)
             {
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <windows.h>
+#include <mfidl.h>
+
+#include <string>
+#include <vector>
+
+#include "EncodeDaemon.h"
+#include "EncoderProfiles.h"
+#include "SegmentPlanner.h"
+#include "TranscodeScheduler.h"
+
+// Transcodes one file to MP4 (H.264 + AAC) using the given profile indices,
+// returns the source duration. A positive fragmentDuration (100 ns units)
+// writes fragmented MP4 with key frames at least that often, which
+// consumers can read while it is being written. onProgress, if set, gets
+// the session's progress on the thread that reports it. Throws WindowsError.
+MFTIME EncodeFile(PCWSTR pszInput, PCWSTR pszOutput, DWORD audioProfile, DWORD videoProfile, bool showProgress, MFTIME fragmentDuration = 0,
+    const VideoCoding::TranscodeProgressCallback& onProgress = VideoCoding::TranscodeProgressCallback());
+
+// Transcodes only [segment.start, segment.end) of the input, returns the
+// length of the range. Throws WindowsError.
+MFTIME EncodeFileRange(PCWSTR pszInput, PCWSTR pszOutput, DWORD audioProfile, DWORD videoProfile, const VideoCoding::MediaSegment& segment);
+
+// Presentation times of the keyframes of the input's first video stream.
+// Reads the stored samples without decoding them. Throws WindowsError.
+std::vector<int64_t> FindKeyframes(PCWSTR pszInput);
+
+// Transcodes every entry of a manifest (see ParseTranscodeManifest) with a
+// TranscodeScheduler, printing per-job status and a summary to stdout.
+// fragmentDuration applies to every job, see EncodeFile. Returns 0 when
+// every job succeeded.
+int EncodeBatch(const std::string& manifestPath, const VideoCoding::TranscodeSchedulerSettings& settings, MFTIME fragmentDuration = 0);
+
+// Transcodes one long input as up to `segments` keyframe-aligned parts at
+// once (see PlanSegments), then joins the parts into one MP4 with
+// continuous timestamps (see PlanMp4Concat) and deletes them. With a
+// positive fragmentDuration the joined file is fragmented (see
+// WriteMp4ConcatFragmented). Prints the per-part status like EncodeBatch.
+// Returns 0 on success.
+int EncodeSegmented(const std::string& input, const std::string& output, int audioProfile, int videoProfile, size_t segments,
+    const VideoCoding::TranscodeSchedulerSettings& settings, MFTIME fragmentDuration = 0);
+
+// Transcodes `input` once per profile combination of `grid` (see
+// ParseProfileGrid) and writes the measurements to <outputPrefix>.csv and
+// <outputPrefix>.json, with a summary on stdout. Given a baseline CSV from
+// an earlier sweep, points more than `tolerance` worse are reported as
+// regressions. Returns 0 when every point succeeded and nothing regressed.
+int EncodeProfileSweep(const std::string& input, const std::string& outputPrefix, const std::string& grid,
+    const std::string& baselinePath, double tolerance);
+
+// Serves an EncodeDaemon at `endpoint` (a named pipe) until a client asks
+// for shutdown, logging to stdout. Each of its workers keeps one COM and
+// Media Foundation startup for the daemon's lifetime, and transcode
+// profiles stay cached across jobs. Throws std::runtime_error when the
+// endpoint is taken. Returns 0.
+int RunEncodeDaemon(const std::string& endpoint, const VideoCoding::EncodeDaemonSettings& settings);
+
+// Sends one request to the daemon at `endpoint` and prints its events,
+// progress included, until the request is over. Returns 0 when a job is
+// done or a status or shutdown request answered. Throws std::runtime_error
+// when no daemon is listening.
+int SubmitToDaemon(const std::string& endpoint, const VideoCoding::DaemonRequest& request);
@@ -0,0 +1,27 @@
+#include "EncoderProfiles.h"
+
+const uint32_t H264_BASELINE = 66;
+const uint32_t H264_MAIN = 77;
+
+const H264ProfileInfo h264_profiles[] =
+{
+    { H264_BASELINE,    15,    1, 176, 144,   128000 },
+    { H264_BASELINE,    15,    1, 352, 288,   384000 },
+    { H264_BASELINE,    30,    1, 352, 288,   384000 },
+    { H264_BASELINE, 29970, 1000, 320, 240,   528560 },
+    { H264_BASELINE,    15,    1, 720, 576,  4000000 },
+    { H264_MAIN,        25,    1, 720, 576, 10000000 },
+    { H264_MAIN,        30,    1, 352, 288, 10000000 },
+};
+
+const size_t H264_PROFILE_COUNT = sizeof(h264_profiles) / sizeof(h264_profiles[0]);
+
+const AACProfileInfo aac_profiles[] =
+{
+    { 96000, 2, 16, 24000, 0x29 },
+    { 48000, 2, 16, 24000, 0x29 },
+    { 44100, 2, 16, 16000, 0x29 },
+    { 44100, 2, 16, 12000, 0x29 },
+};
+
+const size_t AAC_PROFILE_COUNT = sizeof(aac_profiles) / sizeof(aac_profiles[0]);
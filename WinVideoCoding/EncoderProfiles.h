@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Output settings selectable by index, shared by the transcoder, the sink
+// writer's audio stream and the profile sweep. Plain values, so the tables
+// can be used without Media Foundation.
+
+struct H264ProfileInfo
+{
+    uint32_t profile;           // profile_idc, as eAVEncH264VProfile_*: 66 Baseline, 77 Main
+    uint32_t fpsNumerator;
+    uint32_t fpsDenominator;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bitrate;
+};
+
+struct AACProfileInfo
+{
+    uint32_t samplesPerSec;
+    uint32_t numChannels;
+    uint32_t bitsPerSample;
+    uint32_t bytesPerSec;
+    uint32_t aacProfile;
+};
+
+extern const H264ProfileInfo h264_profiles[];
+extern const size_t H264_PROFILE_COUNT;
+
+extern const AACProfileInfo aac_profiles[];
+extern const size_t AAC_PROFILE_COUNT;
@@ -0,0 +1,316 @@
+#include "FrameDedup.h"
+
+#include <cstring>
+
+#ifdef VC_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        // Rows are hashed in 32-byte stripes into four 64-bit lanes, each lane
+        // adding its 8 bytes plus the product of their halves mixed with a key
+        // (the XXH3 accumulate step; a 32x32->64 multiply, which SSE2 and AVX2
+        // both have). The key depends on the stripe's place in its block of 8,
+        // and every block and every row ends by scrambling the lanes, so moved
+        // content changes the hash even though the adds commute.
+        const size_t STRIPE_BYTES = 32;
+        const size_t BLOCK_STRIPES = 8;
+        const size_t LANES = 4;
+
+        const uint64_t SECRET[] =
+        {
+            0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+            0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+            0xcb00c391bb52283cull, 0xa32e531b8b65d088ull, 0x4ef90da297486471ull,
+        };
+        const uint64_t SCRAMBLE_KEY[LANES] = { 0xd8acdea946ef1938ull, 0x3f349ce33f76faa8ull, 0x1d4f0bc7c7bbdcf9ull, 0x3159b4cd4be0518aull };
+        const uint32_t PRIME32 = 0x9E3779B1u;
+        const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+        const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+        const uint64_t INITIAL[LANES] = { PRIME32, PRIME64_1, PRIME64_2, 0x165667B19E3779F9ull };
+
+        static_assert(sizeof(SECRET) / sizeof(SECRET[0]) == BLOCK_STRIPES + LANES - 1, "every stripe of a block needs LANES keys");
+
+        // Whole rows of one plane, padding excluded.
+        struct PlaneRows
+        {
+            const uint8_t* data;
+            ptrdiff_t stride;
+            size_t rowBytes;
+            uint32_t rows;
+        };
+
+        unsigned GetPlaneRows(const FrameView& frame, PlaneRows planes[3])
+        {
+            const size_t lumaBytes = RowBytes(frame.format, frame.width);
+            planes[0] = { frame.plane(0), frame.planeStride(0), lumaBytes, frame.height };
+            switch (frame.format)
+            {
+            case PixelFormat::NV12:
+                planes[1] = { frame.plane(1), frame.planeStride(1), lumaBytes, frame.height / 2 };
+                return 2;
+            case PixelFormat::I420:
+                planes[1] = { frame.plane(1), frame.planeStride(1), lumaBytes / 2, frame.height / 2 };
+                planes[2] = { frame.plane(2), frame.planeStride(2), lumaBytes / 2, frame.height / 2 };
+                return 3;
+            default:
+                return 1;
+            }
+        }
+
+        inline uint64_t Load64(const uint8_t* p)
+        {
+            uint64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        inline void ScalarStripe(uint64_t* acc, const uint8_t* data, const uint64_t* key)
+        {
+            for (size_t i = 0; i < LANES; ++i)
+            {
+                const uint64_t d = Load64(data + 8 * i);
+                const uint64_t k = d ^ key[i];
+                acc[i] += d + (k & 0xFFFFFFFFu) * (k >> 32);
+            }
+        }
+
+        inline void ScalarScramble(uint64_t* acc)
+        {
+            for (size_t i = 0; i < LANES; ++i)
+            {
+                uint64_t a = acc[i];
+                a ^= a >> 47;
+                a ^= SCRAMBLE_KEY[i];
+                acc[i] = a * PRIME32;
+            }
+        }
+
+        void ScalarHashStripes(uint64_t* acc, const uint8_t* data, size_t begin, size_t stripes)
+        {
+            for (size_t s = begin; s < stripes; ++s)
+            {
+                ScalarStripe(acc, data + s * STRIPE_BYTES, SECRET + s % BLOCK_STRIPES);
+                if (s % BLOCK_STRIPES == BLOCK_STRIPES - 1)
+                {
+                    ScalarScramble(acc);
+                }
+            }
+        }
+
+#ifdef VC_X86
+        inline __m128i SSE2Accumulate(__m128i acc, __m128i d, __m128i key)
+        {
+            const __m128i k = _mm_xor_si128(d, key);
+            return _mm_add_epi64(acc, _mm_add_epi64(d, _mm_mul_epu32(k, _mm_srli_epi64(k, 32))));
+        }
+
+        // a * PRIME32 on 64-bit lanes from two 32x32->64 multiplies.
+        inline __m128i SSE2Scramble(__m128i a, __m128i key)
+        {
+            const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32));
+            a = _mm_xor_si128(_mm_xor_si128(a, _mm_srli_epi64(a, 47)), key);
+            const __m128i low = _mm_mul_epu32(a, prime);
+            const __m128i high = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+            return _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+        }
+
+        size_t SSE2HashStripes(uint64_t* acc, const uint8_t* data, size_t stripes)
+        {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + 2));
+            const __m128i scramble0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(SCRAMBLE_KEY));
+            const __m128i scramble1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(SCRAMBLE_KEY + 2));
+            for (size_t s = 0; s < stripes; ++s)
+            {
+                const uint8_t* p = data + s * STRIPE_BYTES;
+                const uint64_t* key = SECRET + s % BLOCK_STRIPES;
+                a0 = SSE2Accumulate(a0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(key)));
+                a1 = SSE2Accumulate(a1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + 2)));
+                if (s % BLOCK_STRIPES == BLOCK_STRIPES - 1)
+                {
+                    a0 = SSE2Scramble(a0, scramble0);
+                    a1 = SSE2Scramble(a1, scramble1);
+                }
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), a0);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 2), a1);
+            return stripes;
+        }
+
+        VC_TARGET_AVX2 size_t AVX2HashStripes(uint64_t* acc, const uint8_t* data, size_t stripes)
+        {
+            const __m256i prime = _mm256_set1_epi32(static_cast<int>(PRIME32));
+            const __m256i scramble = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(SCRAMBLE_KEY));
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+            for (size_t s = 0; s < stripes; ++s)
+            {
+                const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + s * STRIPE_BYTES));
+                const __m256i k = _mm256_xor_si256(d, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(SECRET + s % BLOCK_STRIPES)));
+                a = _mm256_add_epi64(a, _mm256_add_epi64(d, _mm256_mul_epu32(k, _mm256_srli_epi64(k, 32))));
+                if (s % BLOCK_STRIPES == BLOCK_STRIPES - 1)
+                {
+                    a = _mm256_xor_si256(_mm256_xor_si256(a, _mm256_srli_epi64(a, 47)), scramble);
+                    const __m256i low = _mm256_mul_epu32(a, prime);
+                    const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+                    a = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+                }
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a);
+            return stripes;
+        }
+#endif
+
+        void HashRow(SimdLevel level, uint64_t* acc, const uint8_t* row, size_t bytes)
+        {
+            const size_t stripes = bytes / STRIPE_BYTES;
+            size_t done = 0;
+            switch (level)
+            {
+#ifdef VC_X86
+            case SimdLevel::AVX2:
+                done = AVX2HashStripes(acc, row, stripes);
+                break;
+            case SimdLevel::SSE2:
+                done = SSE2HashStripes(acc, row, stripes);
+                break;
+#endif
+            default:
+                break;
+            }
+            ScalarHashStripes(acc, row, done, stripes);
+
+            // The partial last stripe goes in zero padded; rows compared
+            // against each other always have the same length.
+            const size_t tail = bytes - stripes * STRIPE_BYTES;
+            if (tail > 0)
+            {
+                uint8_t last[STRIPE_BYTES] = {};
+                std::memcpy(last, row + stripes * STRIPE_BYTES, tail);
+                ScalarStripe(acc, last, SECRET + stripes % BLOCK_STRIPES);
+            }
+            ScalarScramble(acc);
+        }
+
+        inline uint64_t Avalanche(uint64_t h)
+        {
+            h ^= h >> 37;
+            h *= 0x165667919E3779F9ull;
+            return h ^ (h >> 32);
+        }
+    }
+
+    uint64_t HashFrame(SimdLevel level, const FrameView& frame)
+    {
+        uint64_t acc[LANES];
+        std::memcpy(acc, INITIAL, sizeof(acc));
+
+        PlaneRows planes[3];
+        const unsigned planeCount = GetPlaneRows(frame, planes);
+        uint64_t bytes = 0;
+        for (unsigned p = 0; p < planeCount; ++p)
+        {
+            for (uint32_t y = 0; y < planes[p].rows; ++y)
+            {
+                HashRow(level, acc, planes[p].data + planes[p].stride * static_cast<ptrdiff_t>(y), planes[p].rowBytes);
+            }
+            bytes += static_cast<uint64_t>(planes[p].rowBytes) * planes[p].rows;
+        }
+
+        uint64_t hash = bytes * PRIME64_1;
+        for (size_t i = 0; i < LANES; ++i)
+        {
+            hash = (hash ^ Avalanche(acc[i])) * PRIME64_2;
+        }
+        return Avalanche(hash);
+    }
+
+    bool SameFramePixels(const FrameView& a, const FrameView& b)
+    {
+        if (a.format != b.format || a.width != b.width || a.height != b.height)
+        {
+            return false;
+        }
+        PlaneRows planesA[3];
+        PlaneRows planesB[3];
+        const unsigned planeCount = GetPlaneRows(a, planesA);
+        GetPlaneRows(b, planesB);
+        for (unsigned p = 0; p < planeCount; ++p)
+        {
+            for (uint32_t y = 0; y < planesA[p].rows; ++y)
+            {
+                const uint8_t* rowA = planesA[p].data + planesA[p].stride * static_cast<ptrdiff_t>(y);
+                const uint8_t* rowB = planesB[p].data + planesB[p].stride * static_cast<ptrdiff_t>(y);
+                if (std::memcmp(rowA, rowB, planesA[p].rowBytes) != 0)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // ------------------------------------------------------------------------
+
+    DuplicateFrameFilter::DuplicateFrameFilter(VideoSink& sink, uint32_t streamIndex, int64_t maxHold)
+        : sink(sink), streamIndex(streamIndex), maxHold(maxHold), holding(false), held(), heldHash(0), heldTimestamp(0), heldDuration(0), framesDropped(0)
+    {
+    }
+
+    DuplicateFrameFilter::~DuplicateFrameFilter()
+    {
+        if (holding)
+        {
+            try
+            {
+                sink.discardFrame(streamIndex, held);
+            }
+            catch (...)
+            {
+            }
+        }
+    }
+
+    void DuplicateFrameFilter::write(SinkFrame& frame, uint64_t hash, int64_t timestamp, int64_t duration)
+    {
+        // A matching hash is only a hint; the pixels decide.
+        if (holding && hash == heldHash && heldDuration + duration <= maxHold && SameFramePixels(frame.view, held.view))
+        {
+            sink.discardFrame(streamIndex, frame);
+            heldDuration += duration;
+            ++framesDropped;
+            return;
+        }
+
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+            sink.discardFrame(streamIndex, frame);
+            throw;
+        }
+        held = frame;
+        frame.handle = nullptr;
+        heldHash = hash;
+        heldTimestamp = timestamp;
+        heldDuration = duration;
+        holding = true;
+    }
+
+    void DuplicateFrameFilter::flush()
+    {
+        if (holding)
+        {
+            holding = false;
+            sink.writeFrame(streamIndex, held, heldTimestamp, heldDuration);
+        }
+    }
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CpuFeatures.h"
+#include "FrameView.h"
+#include "VideoSink.h"
+
+namespace VideoCoding
+{
+
+    // 64-bit hash of every plane's pixels, row padding excluded, for telling
+    // repeated frames apart from changed ones. Not cryptographic: equal hashes
+    // still need SameFramePixels() before a frame is thrown away. Every
+    // SimdLevel gives the same hash.
+    uint64_t HashFrame(SimdLevel level, const FrameView& frame);
+
+    // Whether two frames of the same size and format hold the same pixels,
+    // padding excluded. Frames that differ in size or format never match.
+    bool SameFramePixels(const FrameView& a, const FrameView& b);
+
+    // Folds runs of identical frames into one sample: the most recent frame
+    // is held back, and while the frames after it repeat it they are
+    // discarded and its duration grows. It goes to the sink once a different
+    // frame arrives, once holding on would make it last longer than
+    // `maxHold` (100 ns units), or on flush(). The sample that then starts
+    // the next run repeats the picture, so a decoder joining late never waits
+    // more than `maxHold` for it.
+    //
+    // Used from one thread. A frame still held on destruction is discarded,
+    // as after a failure; call flush() to write it.
+    class DuplicateFrameFilter
+    {
+    public:
+        DuplicateFrameFilter(VideoSink& sink, uint32_t streamIndex, int64_t maxHold);
+        ~DuplicateFrameFilter();
+
+        DuplicateFrameFilter(const DuplicateFrameFilter&) = delete;
+        DuplicateFrameFilter& operator=(const DuplicateFrameFilter&) = delete;
+
+        // Takes `frame` over, as VideoSink::writeFrame. `hash` is
+        // HashFrame() of its contents.
+        void write(SinkFrame& frame, uint64_t hash, int64_t timestamp, int64_t duration);
+
+        // Writes the held frame, if any.
+        void flush();
+
+        uint64_t getFramesDropped() const { return framesDropped; }
+
+    private:
+        VideoSink& sink;
+        const uint32_t streamIndex;
+        const int64_t maxHold;
+        bool holding;
+        SinkFrame held;
+        uint64_t heldHash;
+        int64_t heldTimestamp;
+        int64_t heldDuration;
+        uint64_t framesDropped;
+    };
+
+}
@@ -0,0 +1,256 @@
+#include "FrameGeometry.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        uint32_t ParseUInt32(const std::string& text)
+        {
+            size_t used = 0;
+            unsigned long long value = 0;
+            try
+            {
+                value = std::stoull(text, &used);
+            }
+            catch (const std::exception&)
+            {
+                used = 0;
+            }
+            if (used == 0 || used != text.size() || value > UINT32_MAX)
+            {
+                throw std::invalid_argument("not a 32-bit number: " + text);
+            }
+            return static_cast<uint32_t>(value);
+        }
+
+        std::string Trim(const std::string& text)
+        {
+            const char* SPACE = " \t\r";
+            const size_t begin = text.find_first_not_of(SPACE);
+            if (begin == std::string::npos)
+            {
+                return std::string();
+            }
+            return text.substr(begin, text.find_last_not_of(SPACE) - begin + 1);
+        }
+
+        void CopyPlaneRows(const uint8_t* src, uint8_t* dst, uint32_t rowBegin, uint32_t rowEnd,
+            size_t rowBytes, ptrdiff_t srcStride, ptrdiff_t dstStride)
+        {
+            for (uint32_t y = rowBegin; y < rowEnd; ++y)
+            {
+                std::memcpy(dst + dstStride * static_cast<ptrdiff_t>(y), src + srcStride * static_cast<ptrdiff_t>(y), rowBytes);
+            }
+        }
+
+        // Packed planes have no padding between rows, so the rows are one
+        // contiguous block.
+        template<typename RowBytes>
+        void CopyPackedPlaneRows(const uint8_t* src, uint8_t* dst, uint32_t rowBegin, uint32_t rowEnd, RowBytes rowBytes)
+        {
+            const size_t offset = static_cast<size_t>(rowBytes) * rowBegin;
+            std::memcpy(dst + offset, src + offset, static_cast<size_t>(rowBytes) * (rowEnd - rowBegin));
+        }
+
+        void CopyRows(const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd)
+        {
+            const size_t rowBytes = RowBytes(src.format, src.width);
+            CopyPlaneRows(src.data, dst.data, rowBegin, rowEnd, rowBytes, src.stride, dst.stride);
+            if (src.format == PixelFormat::NV12)
+            {
+                CopyPlaneRows(src.plane(1), dst.plane(1), rowBegin / 2, rowEnd / 2, rowBytes, src.stride, dst.stride);
+            }
+            else if (src.format == PixelFormat::I420)
+            {
+                for (unsigned plane = 1; plane <= 2; ++plane)
+                {
+                    CopyPlaneRows(src.plane(plane), dst.plane(plane), rowBegin / 2, rowEnd / 2, rowBytes / 2, src.stride / 2, dst.stride / 2);
+                }
+            }
+        }
+
+        template<typename Width>
+        void CopyPackedRows(const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd, Width)
+        {
+            typedef std::integral_constant<size_t, 4 * Width::value> RgbBytes;
+            typedef std::integral_constant<size_t, Width::value> LumaBytes;
+            typedef std::integral_constant<size_t, Width::value / 2> ChromaBytes;
+
+            if (src.format == PixelFormat::RGB32)
+            {
+                CopyPackedPlaneRows(src.data, dst.data, rowBegin, rowEnd, RgbBytes());
+                return;
+            }
+            CopyPackedPlaneRows(src.data, dst.data, rowBegin, rowEnd, LumaBytes());
+            if (src.format == PixelFormat::NV12)
+            {
+                CopyPackedPlaneRows(src.plane(1), dst.plane(1), rowBegin / 2, rowEnd / 2, LumaBytes());
+            }
+            else
+            {
+                for (unsigned plane = 1; plane <= 2; ++plane)
+                {
+                    CopyPackedPlaneRows(src.plane(plane), dst.plane(plane), rowBegin / 2, rowEnd / 2, ChromaBytes());
+                }
+            }
+        }
+    }
+
+    bool ParseFrameSize(const std::string& text, uint32_t& width, uint32_t& height)
+    {
+        if (text == "720p")
+        {
+            width = 1280;
+            height = 720;
+            return true;
+        }
+        if (text == "1080p")
+        {
+            width = 1920;
+            height = 1080;
+            return true;
+        }
+        if (text == "2160p" || text == "4k" || text == "4K")
+        {
+            width = 3840;
+            height = 2160;
+            return true;
+        }
+
+        const size_t x = text.find('x');
+        if (x == std::string::npos)
+        {
+            return false;
+        }
+        try
+        {
+            const uint32_t parsedWidth = ParseUInt32(text.substr(0, x));
+            const uint32_t parsedHeight = ParseUInt32(text.substr(x + 1));
+            width = parsedWidth;
+            height = parsedHeight;
+            return true;
+        }
+        catch (const std::invalid_argument&)
+        {
+            return false;
+        }
+    }
+
+    void SetFrameGeometryField(FrameGeometry& geometry, const std::string& key, const std::string& value)
+    {
+        if (key == "size")
+        {
+            if (!ParseFrameSize(value, geometry.width, geometry.height))
+            {
+                throw std::invalid_argument("expected WIDTHxHEIGHT, 720p, 1080p or 4k: " + value);
+            }
+        }
+        else if (key == "width")
+        {
+            geometry.width = ParseUInt32(value);
+        }
+        else if (key == "height")
+        {
+            geometry.height = ParseUInt32(value);
+        }
+        else if (key == "fps")
+        {
+            const size_t slash = value.find('/');
+            geometry.fpsNumerator = ParseUInt32(value.substr(0, slash));
+            geometry.fpsDenominator = slash == std::string::npos ? 1 : ParseUInt32(value.substr(slash + 1));
+        }
+        else if (key == "bitrate")
+        {
+            geometry.bitrate = ParseUInt32(value);
+        }
+        else
+        {
+            throw std::invalid_argument("unknown frame geometry setting: " + key);
+        }
+    }
+
+    FrameGeometry ReadFrameGeometry(std::istream& in, const FrameGeometry& defaults)
+    {
+        FrameGeometry geometry = defaults;
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(in, line))
+        {
+            ++lineNumber;
+            line = Trim(line);
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            const size_t equals = line.find('=');
+            if (equals == std::string::npos)
+            {
+                std::ostringstream message;
+                message << "geometry line " << lineNumber << ": expected key = value";
+                throw std::invalid_argument(message.str());
+            }
+            try
+            {
+                SetFrameGeometryField(geometry, Trim(line.substr(0, equals)), Trim(line.substr(equals + 1)));
+            }
+            catch (const std::invalid_argument& err)
+            {
+                std::ostringstream message;
+                message << "geometry line " << lineNumber << ": " << err.what();
+                throw std::invalid_argument(message.str());
+            }
+        }
+        return geometry;
+    }
+
+    FrameGeometry LoadFrameGeometry(const std::string& path, const FrameGeometry& defaults)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            throw std::runtime_error("cannot open " + path);
+        }
+        return ReadFrameGeometry(in, defaults);
+    }
+
+    void ValidateFrameGeometry(const FrameGeometry& geometry)
+    {
+        if (geometry.width == 0 || geometry.height == 0 || (geometry.width % 2) != 0 || (geometry.height % 2) != 0)
+        {
+            throw std::invalid_argument("frame size must be non-zero and even");
+        }
+        if (geometry.fpsNumerator == 0 || geometry.fpsDenominator == 0)
+        {
+            throw std::invalid_argument("frame rate must be non-zero");
+        }
+    }
+
+    void CopyFrameRows(const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd, KernelDispatch dispatch)
+    {
+        if (src.format != dst.format || src.width != dst.width || src.height != dst.height)
+        {
+            throw std::invalid_argument("CopyFrameRows: frames must have the same size and format");
+        }
+        const bool planar = src.format != PixelFormat::RGB32;
+        if (rowBegin > rowEnd || rowEnd > dst.height || (planar && ((rowBegin % 2) != 0 || (rowEnd % 2) != 0)))
+        {
+            throw std::invalid_argument("CopyFrameRows: row range must be inside the frame, and even for NV12/I420");
+        }
+
+        const ptrdiff_t packed = static_cast<ptrdiff_t>(RowBytes(src.format, src.width));
+        const bool specialized = dispatch == KernelDispatch::Specialized && src.stride == packed && dst.stride == packed
+            && WithSpecializedWidth(src.width, [&](auto width) { CopyPackedRows(src, dst, rowBegin, rowEnd, width); });
+        if (!specialized)
+        {
+            CopyRows(src, dst, rowBegin, rowEnd);
+        }
+    }
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <type_traits>
+
+#include "FrameView.h"
+
+namespace VideoCoding
+{
+
+    // Size, rate and bitrate of a generated stream, chosen at run time.
+    struct FrameGeometry
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t fpsNumerator;
+        uint32_t fpsDenominator;
+        uint32_t bitrate;
+
+        // In 100 ns units, as Media Foundation timestamps.
+        int64_t frameDuration() const
+        {
+            return static_cast<int64_t>(10 * 1000 * 1000) * fpsDenominator / fpsNumerator;
+        }
+
+        // Frames in `seconds` of video, rounded down.
+        uint64_t framesFor(uint32_t seconds) const
+        {
+            return static_cast<uint64_t>(seconds) * fpsNumerator / fpsDenominator;
+        }
+    };
+
+    // "WIDTHxHEIGHT", or one of "720p", "1080p", "2160p" and "4k".
+    bool ParseFrameSize(const std::string& text, uint32_t& width, uint32_t& height);
+
+    // Sets one field from its text form. Keys are "size" (as
+    // ParseFrameSize), "width", "height", "fps" ("30" or "30000/1001") and
+    // "bitrate". Throws std::invalid_argument for unknown keys or values.
+    void SetFrameGeometryField(FrameGeometry& geometry, const std::string& key, const std::string& value);
+
+    // Reads "key = value" lines as SetFrameGeometryField, on top of
+    // `defaults`. Blank lines and lines starting with '#' are skipped.
+    FrameGeometry ReadFrameGeometry(std::istream& in, const FrameGeometry& defaults);
+    FrameGeometry LoadFrameGeometry(const std::string& path, const FrameGeometry& defaults);
+
+    // Throws std::invalid_argument unless the size is non-zero and even
+    // (4:2:0 needs row and column pairs) and the rate is non-zero.
+    void ValidateFrameGeometry(const FrameGeometry& geometry);
+
+    // ------------------------------------------------------------------------
+
+    // Whether row kernels may use a variant built for the exact frame width.
+    enum class KernelDispatch
+    {
+        Specialized,
+        Generic,
+    };
+
+    // Calls kernel(std::integral_constant<uint32_t, WIDTH>()) when `width`
+    // belongs to one of the common geometries (720p, 1080p, 4K) and returns
+    // true, so loop bounds and packed strides become compile-time constants
+    // inside the kernel. Returns false for any other width.
+    template<typename Kernel>
+    bool WithSpecializedWidth(uint32_t width, Kernel&& kernel)
+    {
+        switch (width)
+        {
+        case 1280:
+            kernel(std::integral_constant<uint32_t, 1280>());
+            return true;
+        case 1920:
+            kernel(std::integral_constant<uint32_t, 1920>());
+            return true;
+        case 3840:
+            kernel(std::integral_constant<uint32_t, 3840>());
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Copies rows [rowBegin, rowEnd) of every plane from `src` into `dst`,
+    // which must have the same size and format. For NV12 and I420 both row
+    // bounds must be even. Packed frames of a specialized width are copied
+    // as one block.
+    void CopyFrameRows(const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd,
+        KernelDispatch dispatch = KernelDispatch::Specialized);
+
+}
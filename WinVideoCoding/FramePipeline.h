@@ -0,0 +1,232 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RingQueue.h"
+#include "Tracer.h"
+
+namespace VideoCoding
+{
+
+    template<typename Item>
+    struct PipelineFrame
+    {
+        uint64_t index;
+        int64_t timestamp;
+        Item item;
+    };
+
+    struct PipelineStats
+    {
+        uint64_t framesSubmitted;
+        uint64_t producerStalls;    // producer waited for the queue or the window
+        uint64_t submitterStalls;   // submitter waited for the next frame
+        size_t maxReorderDepth;     // frames held back waiting for an earlier one
+        uint64_t framesDropped;     // submitted but folded into the frame before (WriteFrames dedup)
+    };
+
+    // Overlaps frame generation with submission: `producerCount` threads
+    // produce frames into a bounded lock-free queue and the thread calling
+    // run() drains it, handing frames to `submit` in timestamp order.
+    //
+    // At most `queueDepth` frames are in flight between producer and
+    // submitter; producers block once they get that far ahead, which is the
+    // backpressure towards generation.
+    template<typename Item>
+    class FramePipeline
+    {
+    public:
+        typedef PipelineFrame<Item> Frame;
+        typedef std::function<Item(size_t producerIndex, uint64_t frameIndex)> ProduceFunction;
+        typedef std::function<void(Frame& frame)> SubmitFunction;
+        typedef std::function<void(Frame& frame)> DiscardFunction;
+
+        FramePipeline(size_t producerCount, size_t queueDepth)
+            : producerCount(producerCount < 1 ? 1 : producerCount), queueDepth(queueDepth < 1 ? 1 : queueDepth)
+        {
+        }
+
+        // Runs frames [0, frameCount) with timestamps index * frameDuration.
+        // If a producer or `submit` throws, the pipeline stops, frames not yet
+        // submitted, including the one `submit` threw on, are passed to
+        // `discard` and the exception is rethrown.
+        PipelineStats run(uint64_t frameCount, int64_t frameDuration,
+            const ProduceFunction& produce, const SubmitFunction& submit,
+            const DiscardFunction& discard = DiscardFunction())
+        {
+            RingQueue<Frame> queue(queueDepth);
+            std::vector<Frame> reorder(queueDepth);
+            std::vector<bool> occupied(queueDepth, false);
+
+            std::atomic<uint64_t> nextIndex(0);
+            std::atomic<uint64_t> submitted(0);
+            std::atomic<uint64_t> producerStalls(0);
+            std::atomic<size_t> producersDone(0);
+            std::atomic<bool> aborted(false);
+            std::exception_ptr error;
+            std::mutex errorMutex;
+
+            const auto fail = [&](std::exception_ptr e)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                {
+                    error = e;
+                }
+                aborted = true;
+            };
+
+            std::vector<std::thread> producers;
+            for (size_t p = 0; p < producerCount; ++p)
+            {
+                producers.emplace_back([&, p]
+                {
+                    SetTraceThreadName("producer");
+                    Backoff backoff;
+                    try
+                    {
+                        for (;;)
+                        {
+                            const uint64_t index = nextIndex.fetch_add(1);
+                            if (index >= frameCount)
+                            {
+                                break;
+                            }
+
+                            // Stay within the reorder window.
+                            bool stalled = false;
+                            while (index >= submitted.load(std::memory_order_acquire) + queueDepth && !aborted)
+                            {
+                                stalled = true;
+                                backoff.pause();
+                            }
+                            if (aborted)
+                            {
+                                break;
+                            }
+
+                            Frame frame;
+                            frame.index = index;
+                            frame.timestamp = static_cast<int64_t>(index) * frameDuration;
+                            frame.item = produce(p, index);
+
+                            backoff.reset();
+                            while (!queue.tryPush(frame))
+                            {
+                                stalled = true;
+                                backoff.pause();
+                            }
+                            if (stalled)
+                            {
+                                ++producerStalls;
+                            }
+                        }
+                    }
+                    catch (...)
+                    {
+                        fail(std::current_exception());
+                    }
+                    producersDone.fetch_add(1, std::memory_order_release);
+                });
+            }
+
+            PipelineStats stats = PipelineStats();
+            size_t held = 0;
+            Backoff backoff;
+            try
+            {
+                uint64_t expected = 0;
+                Frame frame;
+                while (expected < frameCount && !aborted)
+                {
+                    // Loaded first: once every producer is done, whatever they
+                    // pushed is visible to the tryPop below.
+                    const bool done = producersDone.load(std::memory_order_acquire) == producerCount;
+                    if (!queue.tryPop(frame))
+                    {
+                        if (done)
+                        {
+                            break;
+                        }
+                        ++stats.submitterStalls;
+                        backoff.pause();
+                        continue;
+                    }
+                    backoff.reset();
+
+                    const size_t slot = static_cast<size_t>(frame.index % queueDepth);
+                    reorder[slot] = std::move(frame);
+                    occupied[slot] = true;
+                    ++held;
+                    if (held > stats.maxReorderDepth)
+                    {
+                        stats.maxReorderDepth = held;
+                    }
+                    TraceCounter("reorderDepth", static_cast<int64_t>(held));
+
+                    for (size_t next = static_cast<size_t>(expected % queueDepth); occupied[next]; next = static_cast<size_t>(expected % queueDepth))
+                    {
+                        // Still held while submit runs, so a frame it throws on
+                        // is discarded with the others.
+                        submit(reorder[next]);
+                        occupied[next] = false;
+                        --held;
+                        ++expected;
+                        submitted.store(expected, std::memory_order_release);
+                    }
+                }
+                if (expected != frameCount && !aborted)
+                {
+                    throw std::runtime_error("FramePipeline: producers stopped after " + std::to_string(expected) + " of " + std::to_string(frameCount) + " frames");
+                }
+                stats.framesSubmitted = expected;
+            }
+            catch (...)
+            {
+                fail(std::current_exception());
+            }
+
+            for (std::thread& producer : producers)
+            {
+                producer.join();
+            }
+
+            if (error)
+            {
+                Frame frame;
+                while (queue.tryPop(frame))
+                {
+                    if (discard)
+                    {
+                        discard(frame);
+                    }
+                }
+                for (size_t slot = 0; slot < queueDepth; ++slot)
+                {
+                    if (occupied[slot] && discard)
+                    {
+                        discard(reorder[slot]);
+                    }
+                }
+                std::rethrow_exception(error);
+            }
+
+            stats.producerStalls = producerStalls;
+            return stats;
+        }
+
+    private:
+        const size_t producerCount;
+        const size_t queueDepth;
+    };
+
+}
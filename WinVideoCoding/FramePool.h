@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "AlignedBuffer.h"
+
+namespace VideoCoding
+{
+
+    struct FramePoolStats
+    {
+        size_t hits;            // acquire() served from the free list
+        size_t misses;          // acquire() had to allocate a new item
+        size_t allocations;     // total items created by the backend
+        size_t outstanding;     // items currently checked out
+        size_t highWaterMark;   // maximum number of items checked out at once
+    };
+
+    // Bounded pool of reusable frame items.
+    //
+    // Backend must provide:
+    //     typedef ... Item;            // movable
+    //     Item create();
+    //     void destroy(Item& item);
+    //
+    // At most `capacity` idle items are retained; items recycled while the
+    // free list is full are handed back to the backend. acquire() never
+    // blocks, when the free list is empty a new item is created and counted
+    // as a miss. All methods are thread safe so items can be recycled from
+    // whatever thread the consumer releases them on.
+    template<typename Backend>
+    class FramePool
+    {
+    public:
+        typedef typename Backend::Item Item;
+
+        FramePool(Backend backend, size_t capacity) : backend(std::move(backend)), capacity(capacity), stats_()
+        {
+            freeItems.reserve(capacity);
+        }
+
+        FramePool(const FramePool&) = delete;
+        FramePool& operator=(const FramePool&) = delete;
+
+        ~FramePool()
+        {
+            for (Item& item : freeItems)
+            {
+                backend.destroy(item);
+            }
+        }
+
+        // Fills the free list up to capacity so the first frames are hits too.
+        void preallocate()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (freeItems.size() < capacity)
+            {
+                freeItems.push_back(backend.create());
+                ++stats_.allocations;
+            }
+        }
+
+        Item acquire()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!freeItems.empty())
+            {
+                Item item = std::move(freeItems.back());
+                freeItems.pop_back();
+                ++stats_.hits;
+                checkOut();
+                return item;
+            }
+            ++stats_.misses;
+            ++stats_.allocations;
+            checkOut();
+            lock.unlock();
+            return backend.create();
+        }
+
+        void recycle(Item item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stats_.outstanding > 0)
+            {
+                --stats_.outstanding;
+            }
+            if (freeItems.size() < capacity)
+            {
+                freeItems.push_back(std::move(item));
+                return;
+            }
+            lock.unlock();
+            backend.destroy(item);
+        }
+
+        FramePoolStats stats() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats_;
+        }
+
+        size_t getCapacity() const { return capacity; }
+
+    private:
+        void checkOut()
+        {
+            ++stats_.outstanding;
+            if (stats_.outstanding > stats_.highWaterMark)
+            {
+                stats_.highWaterMark = stats_.outstanding;
+            }
+        }
+
+        Backend backend;
+        const size_t capacity;
+        std::vector<Item> freeItems;
+        FramePoolStats stats_;
+        mutable std::mutex mutex;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Portable backend handing out 64-byte aligned frame buffers.
+    struct AlignedBufferBackend
+    {
+        typedef AlignedBuffer Item;
+
+        explicit AlignedBufferBackend(size_t frameSize) : frameSize(frameSize) {}
+
+        Item create() { return AlignedBuffer(frameSize, FRAME_ALIGNMENT); }
+        void destroy(Item&) {}
+
+        size_t frameSize;
+    };
+
+    typedef FramePool<AlignedBufferBackend> AlignedBufferPool;
+
+    // Same, but items are heap pointers so they can travel through opaque
+    // handles such as SinkFrame::handle.
+    struct HeapAlignedBufferBackend
+    {
+        typedef AlignedBuffer* Item;
+
+        explicit HeapAlignedBufferBackend(size_t frameSize) : frameSize(frameSize) {}
+
+        Item create() { return new AlignedBuffer(frameSize, FRAME_ALIGNMENT); }
+        void destroy(Item& item) { delete item; item = nullptr; }
+
+        size_t frameSize;
+    };
+
+}
@@ -0,0 +1,672 @@
+#include "FrameScaler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+#ifdef VC_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        const int WEIGHT_SHIFT = 14;
+        const int32_t WEIGHT_ONE = 1 << WEIGHT_SHIFT;
+        const uint32_t TAP_ALIGNMENT = 8;
+
+        // The vertical pass leaves Q6 values in 16 bits, enough headroom for
+        // the bicubic overshoot; the horizontal pass brings them back to 8.
+        const int VERTICAL_SHIFT = WEIGHT_SHIFT - 6;
+        const int32_t VERTICAL_ROUND = 1 << (VERTICAL_SHIFT - 1);
+        const int HORIZONTAL_SHIFT = WEIGHT_SHIFT + 6;
+        const int32_t HORIZONTAL_ROUND = 1 << (HORIZONTAL_SHIFT - 1);
+
+        const double BICUBIC_A = -0.5;
+
+        struct ScaleFilterEntry
+        {
+            ScaleFilter filter;
+            const char* name;
+        };
+
+        const ScaleFilterEntry SCALE_FILTER_NAMES[] =
+        {
+            { ScaleFilter::Bilinear, "bilinear" },
+            { ScaleFilter::Bicubic, "bicubic" },
+            { ScaleFilter::Area, "area" },
+        };
+
+        double Kernel(ScaleFilter filter, double x)
+        {
+            x = std::fabs(x);
+            if (filter == ScaleFilter::Bilinear)
+            {
+                return x < 1.0 ? 1.0 - x : 0.0;
+            }
+            if (x < 1.0)
+            {
+                return ((BICUBIC_A + 2.0) * x - (BICUBIC_A + 3.0)) * x * x + 1.0;
+            }
+            if (x < 2.0)
+            {
+                return ((BICUBIC_A * x - 5.0 * BICUBIC_A) * x + 8.0 * BICUBIC_A) * x - 4.0 * BICUBIC_A;
+            }
+            return 0.0;
+        }
+
+        // Source samples first, first + 1, ... and their weights for
+        // destination sample i, before edge clamping and normalisation.
+        int64_t FilterWindow(ScaleFilter filter, uint32_t srcSize, uint32_t dstSize, uint32_t i, std::vector<double>& weights)
+        {
+            weights.clear();
+            const double scale = static_cast<double>(srcSize) / dstSize;
+            if (filter == ScaleFilter::Area)
+            {
+                // Destination sample i covers [i, i + 1) * scale of the source.
+                const int64_t first = static_cast<int64_t>(static_cast<uint64_t>(i) * srcSize / dstSize);
+                const int64_t end = static_cast<int64_t>((static_cast<uint64_t>(i + 1) * srcSize + dstSize - 1) / dstSize);
+                const double begin = i * scale;
+                const double finish = (i + 1) * scale;
+                for (int64_t j = first; j < end; ++j)
+                {
+                    weights.push_back(std::max(0.0, std::min(finish, static_cast<double>(j + 1)) - std::max(begin, static_cast<double>(j))));
+                }
+                return first;
+            }
+
+            const double stretch = std::max(1.0, scale);
+            const double radius = (filter == ScaleFilter::Bicubic ? 2.0 : 1.0) * stretch;
+            const double center = (i + 0.5) * scale - 0.5;
+            const int64_t first = static_cast<int64_t>(std::floor(center - radius)) + 1;
+            const int64_t last = static_cast<int64_t>(std::floor(center + radius));
+            for (int64_t j = first; j <= last; ++j)
+            {
+                weights.push_back(Kernel(filter, (j - center) / stretch));
+            }
+            return first;
+        }
+
+        inline int64_t ClampIndex(int64_t j, uint32_t size)
+        {
+            return j < 0 ? 0 : (j >= static_cast<int64_t>(size) ? static_cast<int64_t>(size) - 1 : j);
+        }
+
+        inline uint8_t Clamp255(int32_t value)
+        {
+            return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+
+        inline int16_t ClampInt16(int32_t value)
+        {
+            return static_cast<int16_t>(value < -32768 ? -32768 : (value > 32767 ? 32767 : value));
+        }
+
+        // One plane: `width` samples of `components` interleaved bytes per row.
+        struct Plane
+        {
+            uint8_t* data;
+            ptrdiff_t stride;
+            uint32_t width;
+            uint32_t height;
+            uint32_t components;
+        };
+
+        unsigned GetPlanes(const FrameView& frame, Plane planes[3])
+        {
+            if (frame.format == PixelFormat::RGB32)
+            {
+                planes[0] = { frame.data, frame.stride, frame.width, frame.height, 4 };
+                return 1;
+            }
+            planes[0] = { frame.plane(0), frame.planeStride(0), frame.width, frame.height, 1 };
+            if (frame.format == PixelFormat::NV12)
+            {
+                planes[1] = { frame.plane(1), frame.planeStride(1), frame.width / 2, frame.height / 2, 2 };
+                return 2;
+            }
+            planes[1] = { frame.plane(1), frame.planeStride(1), frame.width / 2, frame.height / 2, 1 };
+            planes[2] = { frame.plane(2), frame.planeStride(2), frame.width / 2, frame.height / 2, 1 };
+            return 3;
+        }
+
+        void CheckFrames(const char* who, const FrameView& src, const FrameView& dst)
+        {
+            if (src.format != dst.format || src.format == PixelFormat::RGB32)
+            {
+                throw std::invalid_argument(std::string(who) + ": expected NV12 or I420 frames of the same format");
+            }
+            if (src.width == 0 || src.height == 0 || dst.width == 0 || dst.height == 0
+                || (src.width % 2) != 0 || (src.height % 2) != 0 || (dst.width % 2) != 0 || (dst.height % 2) != 0)
+            {
+                throw std::invalid_argument(std::string(who) + ": frame sizes must be even and non-zero");
+            }
+        }
+
+        // ---- vertical pass: `taps` source rows into one row of Q6 values ----
+
+        void ScalarVertical(const uint8_t* const* rows, const int16_t* weights, uint32_t taps, int16_t* dst, size_t begin, size_t count)
+        {
+            for (size_t x = begin; x < count; ++x)
+            {
+                int32_t sum = VERTICAL_ROUND;
+                for (uint32_t t = 0; t < taps; ++t)
+                {
+                    sum += rows[t][x] * weights[t];
+                }
+                dst[x] = ClampInt16(sum >> VERTICAL_SHIFT);
+            }
+        }
+
+#ifdef VC_X86
+        inline int32_t PackPair(int16_t low, int16_t high)
+        {
+            return static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16) | static_cast<uint16_t>(low));
+        }
+
+        // Rows are taken in pairs, interleaved as 16 bits, so one madd
+        // applies two taps; an odd last tap pairs with a zero weight.
+        size_t SSE2Vertical(const uint8_t* const* rows, const int16_t* weights, uint32_t taps, int16_t* dst, size_t count)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi32(VERTICAL_ROUND);
+            size_t x = 0;
+            for (; x + 8 <= count; x += 8)
+            {
+                __m128i low = round;
+                __m128i high = round;
+                for (uint32_t t = 0; t < taps; t += 2)
+                {
+                    const bool pair = t + 1 < taps;
+                    const __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[t] + x)), zero);
+                    const __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[pair ? t + 1 : t] + x)), zero);
+                    const __m128i w = _mm_set1_epi32(PackPair(weights[t], pair ? weights[t + 1] : 0));
+                    low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+                    high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                    _mm_packs_epi32(_mm_srai_epi32(low, VERTICAL_SHIFT), _mm_srai_epi32(high, VERTICAL_SHIFT)));
+            }
+            return x;
+        }
+
+        // The in-lane unpacks and the in-lane pack undo each other, so the
+        // 16 results come out in order.
+        VC_TARGET_AVX2 size_t AVX2Vertical(const uint8_t* const* rows, const int16_t* weights, uint32_t taps, int16_t* dst, size_t count)
+        {
+            const __m256i round = _mm256_set1_epi32(VERTICAL_ROUND);
+            size_t x = 0;
+            for (; x + 16 <= count; x += 16)
+            {
+                __m256i low = round;
+                __m256i high = round;
+                for (uint32_t t = 0; t < taps; t += 2)
+                {
+                    const bool pair = t + 1 < taps;
+                    const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t] + x)));
+                    const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[pair ? t + 1 : t] + x)));
+                    const __m256i w = _mm256_set1_epi32(PackPair(weights[t], pair ? weights[t + 1] : 0));
+                    low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+                    high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x),
+                    _mm256_packs_epi32(_mm256_srai_epi32(low, VERTICAL_SHIFT), _mm256_srai_epi32(high, VERTICAL_SHIFT)));
+            }
+            return x;
+        }
+#endif
+
+        void VerticalRow(SimdLevel level, const uint8_t* const* rows, const int16_t* weights, uint32_t taps, int16_t* dst, size_t count)
+        {
+            size_t done = 0;
+            switch (level)
+            {
+#ifdef VC_X86
+            case SimdLevel::AVX2:
+                done = AVX2Vertical(rows, weights, taps, dst, count);
+                break;
+            case SimdLevel::SSE2:
+                done = SSE2Vertical(rows, weights, taps, dst, count);
+                break;
+#endif
+            default:
+                break;
+            }
+            ScalarVertical(rows, weights, taps, dst, done, count);
+        }
+
+        // ---- horizontal pass: Q6 row into `count` bytes, `step` apart ----
+        //
+        // Each destination sample is a dot product over tapStride source
+        // values; `src` is padded with tapStride zeros so the last ones can
+        // read past the row.
+
+        void ScalarHorizontal(const int16_t* src, const ScaleAxis& axis, uint8_t* dst, uint32_t step, size_t begin, size_t count)
+        {
+            for (size_t x = begin; x < count; ++x)
+            {
+                const int16_t* s = src + axis.offsets[x];
+                const int16_t* w = axis.weights.data() + x * axis.tapStride;
+                int32_t sum = HORIZONTAL_ROUND;
+                for (uint32_t t = 0; t < axis.tapStride; ++t)
+                {
+                    sum += s[t] * w[t];
+                }
+                dst[x * step] = Clamp255(sum >> HORIZONTAL_SHIFT);
+            }
+        }
+
+#ifdef VC_X86
+        inline void StoreFour(uint8_t* dst, uint32_t step, __m128i packed)
+        {
+            const uint32_t bytes = static_cast<uint32_t>(_mm_cvtsi128_si32(packed));
+            if (step == 1)
+            {
+                std::memcpy(dst, &bytes, sizeof(bytes));
+                return;
+            }
+            for (uint32_t k = 0; k < 4; ++k)
+            {
+                dst[k * step] = static_cast<uint8_t>(bytes >> (8 * k));
+            }
+        }
+
+        inline __m128i SSE2Dot(const int16_t* s, const int16_t* w, uint32_t tapStride)
+        {
+            __m128i sum = _mm_setzero_si128();
+            for (uint32_t t = 0; t < tapStride; t += 8)
+            {
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + t)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + t))));
+            }
+            return sum;
+        }
+
+        // Four destination samples at a time; the partial sums are
+        // transposed into one register before rounding.
+        size_t SSE2Horizontal(const int16_t* src, const ScaleAxis& axis, uint8_t* dst, uint32_t step, size_t count)
+        {
+            const __m128i round = _mm_set1_epi32(HORIZONTAL_ROUND);
+            size_t x = 0;
+            for (; x + 4 <= count; x += 4)
+            {
+                __m128i s[4];
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    s[k] = SSE2Dot(src + axis.offsets[x + k], axis.weights.data() + (x + k) * axis.tapStride, axis.tapStride);
+                }
+                const __m128i t0 = _mm_add_epi32(_mm_unpacklo_epi32(s[0], s[1]), _mm_unpackhi_epi32(s[0], s[1]));
+                const __m128i t1 = _mm_add_epi32(_mm_unpacklo_epi32(s[2], s[3]), _mm_unpackhi_epi32(s[2], s[3]));
+                __m128i r = _mm_add_epi32(_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1));
+                r = _mm_srai_epi32(_mm_add_epi32(r, round), HORIZONTAL_SHIFT);
+                r = _mm_packs_epi32(r, r);
+                StoreFour(dst + x * step, step, _mm_packus_epi16(r, r));
+            }
+            return x;
+        }
+
+        // Eight destination samples at a time, two per register: the low
+        // lane works on one, the high lane on the next.
+        VC_TARGET_AVX2 size_t AVX2Horizontal(const int16_t* src, const ScaleAxis& axis, uint8_t* dst, uint32_t step, size_t count)
+        {
+            const __m128i round = _mm_set1_epi32(HORIZONTAL_ROUND);
+            const uint32_t tapStride = axis.tapStride;
+            size_t x = 0;
+            for (; x + 8 <= count; x += 8)
+            {
+                __m256i s[4];
+                for (size_t k = 0; k < 4; ++k)
+                {
+                    const int16_t* s0 = src + axis.offsets[x + 2 * k];
+                    const int16_t* s1 = src + axis.offsets[x + 2 * k + 1];
+                    const int16_t* w0 = axis.weights.data() + (x + 2 * k) * tapStride;
+                    const int16_t* w1 = w0 + tapStride;
+                    __m256i sum = _mm256_setzero_si256();
+                    for (uint32_t t = 0; t < tapStride; t += 8)
+                    {
+                        const __m256i values = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + t))), _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + t)), 1);
+                        const __m256i weights = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(w0 + t))), _mm_loadu_si128(reinterpret_cast<const __m128i*>(w1 + t)), 1);
+                        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(values, weights));
+                    }
+                    s[k] = sum;
+                }
+                // Low lanes end up holding samples 0, 2, 4, 6, high lanes 1, 3, 5, 7.
+                const __m256i r = _mm256_hadd_epi32(_mm256_hadd_epi32(s[0], s[1]), _mm256_hadd_epi32(s[2], s[3]));
+                const __m128i even = _mm256_castsi256_si128(r);
+                const __m128i odd = _mm256_extracti128_si256(r, 1);
+                const __m128i first = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi32(even, odd), round), HORIZONTAL_SHIFT);
+                const __m128i second = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi32(even, odd), round), HORIZONTAL_SHIFT);
+                const __m128i words = _mm_packs_epi32(first, second);
+                const __m128i bytes = _mm_packus_epi16(words, words);
+                StoreFour(dst + x * step, step, bytes);
+                StoreFour(dst + (x + 4) * step, step, _mm_srli_si128(bytes, 4));
+            }
+            return x;
+        }
+#endif
+
+        void HorizontalRow(SimdLevel level, const int16_t* src, const ScaleAxis& axis, uint8_t* dst, uint32_t step, size_t count)
+        {
+            size_t done = 0;
+            switch (level)
+            {
+#ifdef VC_X86
+            case SimdLevel::AVX2:
+                done = AVX2Horizontal(src, axis, dst, step, count);
+                break;
+            case SimdLevel::SSE2:
+                done = SSE2Horizontal(src, axis, dst, step, count);
+                break;
+#endif
+            default:
+                break;
+            }
+            ScalarHorizontal(src, axis, dst, step, done, count);
+        }
+
+        void ScalePlaneRows(SimdLevel level, const ScaleAxis& axisX, const ScaleAxis& axisY, const Plane& src, const Plane& dst,
+            uint32_t rowBegin, uint32_t rowEnd)
+        {
+            const size_t rowSamples = static_cast<size_t>(src.width) * src.components;
+            const size_t planarStride = src.width + axisX.tapStride;
+            std::vector<int16_t> interleaved(src.components > 1 ? rowSamples : 0);
+            std::vector<int16_t> planar(planarStride * src.components, 0);
+            std::vector<const uint8_t*> rows(axisY.taps);
+
+            for (uint32_t y = rowBegin; y < rowEnd; ++y)
+            {
+                for (uint32_t t = 0; t < axisY.taps; ++t)
+                {
+                    rows[t] = src.data + src.stride * static_cast<ptrdiff_t>(axisY.offsets[y] + t);
+                }
+                const int16_t* weights = axisY.weights.data() + static_cast<size_t>(y) * axisY.tapStride;
+                if (src.components == 1)
+                {
+                    VerticalRow(level, rows.data(), weights, axisY.taps, planar.data(), rowSamples);
+                }
+                else
+                {
+                    VerticalRow(level, rows.data(), weights, axisY.taps, interleaved.data(), rowSamples);
+                    for (uint32_t x = 0; x < src.width; ++x)
+                    {
+                        for (uint32_t c = 0; c < src.components; ++c)
+                        {
+                            planar[c * planarStride + x] = interleaved[static_cast<size_t>(x) * src.components + c];
+                        }
+                    }
+                }
+
+                uint8_t* out = dst.data + dst.stride * static_cast<ptrdiff_t>(y);
+                for (uint32_t c = 0; c < src.components; ++c)
+                {
+                    HorizontalRow(level, planar.data() + c * planarStride, axisX, out + c, dst.components, dst.width);
+                }
+            }
+        }
+
+        // Folded, normalised double weights of destination sample i,
+        // for the reference.
+        void ReferenceWeights(ScaleFilter filter, uint32_t srcSize, uint32_t dstSize, uint32_t i, std::vector<int64_t>& indices, std::vector<double>& weights)
+        {
+            const int64_t first = FilterWindow(filter, srcSize, dstSize, i, weights);
+            double sum = 0.0;
+            for (double w : weights)
+            {
+                sum += w;
+            }
+            indices.clear();
+            for (size_t t = 0; t < weights.size(); ++t)
+            {
+                weights[t] /= sum;
+                indices.push_back(ClampIndex(first + static_cast<int64_t>(t), srcSize));
+            }
+        }
+    }
+
+    const char* ScaleFilterName(ScaleFilter filter)
+    {
+        for (const ScaleFilterEntry& entry : SCALE_FILTER_NAMES)
+        {
+            if (entry.filter == filter)
+            {
+                return entry.name;
+            }
+        }
+        return "unknown";
+    }
+
+    bool ParseScaleFilter(const std::string& name, ScaleFilter& filter)
+    {
+        for (const ScaleFilterEntry& entry : SCALE_FILTER_NAMES)
+        {
+            if (name == entry.name)
+            {
+                filter = entry.filter;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ScaleAxis ComputeScaleAxis(ScaleFilter filter, uint32_t srcSize, uint32_t dstSize)
+    {
+        if (srcSize == 0 || dstSize == 0)
+        {
+            throw std::invalid_argument("ComputeScaleAxis: sizes must be non-zero");
+        }
+
+        std::vector<int64_t> firsts(dstSize);
+        std::vector<std::vector<double>> windows(dstSize);
+        size_t widest = 1;
+        for (uint32_t i = 0; i < dstSize; ++i)
+        {
+            firsts[i] = FilterWindow(filter, srcSize, dstSize, i, windows[i]);
+            widest = std::max(widest, windows[i].size());
+        }
+
+        ScaleAxis axis;
+        axis.taps = static_cast<uint32_t>(std::min<size_t>(widest, srcSize));
+        axis.tapStride = (axis.taps + TAP_ALIGNMENT - 1) / TAP_ALIGNMENT * TAP_ALIGNMENT;
+        axis.offsets.resize(dstSize);
+        axis.weights.assign(static_cast<size_t>(dstSize) * axis.tapStride, 0);
+
+        std::vector<double> folded(axis.taps);
+        for (uint32_t i = 0; i < dstSize; ++i)
+        {
+            // The window is moved inside the source; samples beyond the edge
+            // then land on the edge sample, which the window still covers.
+            const int64_t offset = std::max<int64_t>(0, std::min<int64_t>(firsts[i], static_cast<int64_t>(srcSize) - axis.taps));
+            std::fill(folded.begin(), folded.end(), 0.0);
+            double sum = 0.0;
+            for (size_t t = 0; t < windows[i].size(); ++t)
+            {
+                folded[static_cast<size_t>(ClampIndex(firsts[i] + static_cast<int64_t>(t), srcSize) - offset)] += windows[i][t];
+                sum += windows[i][t];
+            }
+
+            // Rounded to Q14, with what rounding lost or gained given to the
+            // largest tap so the weights add up to exactly one.
+            int16_t* weights = axis.weights.data() + static_cast<size_t>(i) * axis.tapStride;
+            int32_t total = 0;
+            size_t largest = 0;
+            for (size_t t = 0; t < folded.size(); ++t)
+            {
+                weights[t] = static_cast<int16_t>(std::lround(folded[t] / sum * WEIGHT_ONE));
+                total += weights[t];
+                if (folded[t] > folded[largest])
+                {
+                    largest = t;
+                }
+            }
+            weights[largest] = static_cast<int16_t>(weights[largest] + WEIGHT_ONE - total);
+            axis.offsets[i] = static_cast<uint32_t>(offset);
+        }
+        return axis;
+    }
+
+    ScalePlan ComputeScalePlan(ScaleFilter filter, uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight)
+    {
+        ScalePlan plan;
+        plan.srcWidth = srcWidth;
+        plan.srcHeight = srcHeight;
+        plan.dstWidth = dstWidth;
+        plan.dstHeight = dstHeight;
+        plan.lumaX = ComputeScaleAxis(filter, srcWidth, dstWidth);
+        plan.lumaY = ComputeScaleAxis(filter, srcHeight, dstHeight);
+        plan.chromaX = ComputeScaleAxis(filter, srcWidth / 2, dstWidth / 2);
+        plan.chromaY = ComputeScaleAxis(filter, srcHeight / 2, dstHeight / 2);
+        return plan;
+    }
+
+    void ScaleFrameRows(SimdLevel level, const ScalePlan& plan, const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd)
+    {
+        CheckFrames("ScaleFrameRows", src, dst);
+        if (plan.srcWidth != src.width || plan.srcHeight != src.height || plan.dstWidth != dst.width || plan.dstHeight != dst.height)
+        {
+            throw std::invalid_argument("ScaleFrameRows: plan is for other frame sizes");
+        }
+        if (rowBegin > rowEnd || rowEnd > dst.height || (rowBegin % 2) != 0 || (rowEnd % 2) != 0)
+        {
+            throw std::invalid_argument("ScaleFrameRows: row range must be even and inside the frame");
+        }
+
+        Plane srcPlanes[3];
+        Plane dstPlanes[3];
+        const unsigned planeCount = GetPlanes(src, srcPlanes);
+        GetPlanes(dst, dstPlanes);
+        ScalePlaneRows(level, plan.lumaX, plan.lumaY, srcPlanes[0], dstPlanes[0], rowBegin, rowEnd);
+        for (unsigned p = 1; p < planeCount; ++p)
+        {
+            ScalePlaneRows(level, plan.chromaX, plan.chromaY, srcPlanes[p], dstPlanes[p], rowBegin / 2, rowEnd / 2);
+        }
+    }
+
+    void ScaleFrameReference(ScaleFilter filter, const FrameView& src, const FrameView& dst)
+    {
+        CheckFrames("ScaleFrameReference", src, dst);
+        Plane srcPlanes[3];
+        Plane dstPlanes[3];
+        const unsigned planeCount = GetPlanes(src, srcPlanes);
+        GetPlanes(dst, dstPlanes);
+
+        std::vector<int64_t> columns;
+        std::vector<double> columnWeights;
+        std::vector<int64_t> rows;
+        std::vector<double> rowWeights;
+        for (unsigned p = 0; p < planeCount; ++p)
+        {
+            const Plane& in = srcPlanes[p];
+            const Plane& out = dstPlanes[p];
+            for (uint32_t y = 0; y < out.height; ++y)
+            {
+                ReferenceWeights(filter, in.height, out.height, y, rows, rowWeights);
+                for (uint32_t x = 0; x < out.width; ++x)
+                {
+                    ReferenceWeights(filter, in.width, out.width, x, columns, columnWeights);
+                    for (uint32_t c = 0; c < in.components; ++c)
+                    {
+                        double sum = 0.0;
+                        for (size_t j = 0; j < rows.size(); ++j)
+                        {
+                            const uint8_t* row = in.data + in.stride * static_cast<ptrdiff_t>(rows[j]);
+                            for (size_t i = 0; i < columns.size(); ++i)
+                            {
+                                sum += rowWeights[j] * columnWeights[i] * row[columns[i] * in.components + c];
+                            }
+                        }
+                        out.data[out.stride * static_cast<ptrdiff_t>(y) + static_cast<ptrdiff_t>(x) * out.components + c] =
+                            Clamp255(static_cast<int32_t>(std::lround(sum)));
+                    }
+                }
+            }
+        }
+    }
+
+    double FramePsnr(const FrameView& a, const FrameView& b)
+    {
+        if (a.format != b.format || a.width != b.width || a.height != b.height)
+        {
+            throw std::invalid_argument("FramePsnr: frames must have the same size and format");
+        }
+        Plane planesA[3];
+        Plane planesB[3];
+        const unsigned planeCount = GetPlanes(a, planesA);
+        GetPlanes(b, planesB);
+        uint64_t squared = 0;
+        uint64_t samples = 0;
+        for (unsigned p = 0; p < planeCount; ++p)
+        {
+            const size_t bytes = static_cast<size_t>(planesA[p].width) * planesA[p].components;
+            for (uint32_t y = 0; y < planesA[p].height; ++y)
+            {
+                const uint8_t* rowA = planesA[p].data + planesA[p].stride * static_cast<ptrdiff_t>(y);
+                const uint8_t* rowB = planesB[p].data + planesB[p].stride * static_cast<ptrdiff_t>(y);
+                for (size_t x = 0; x < bytes; ++x)
+                {
+                    const int32_t d = static_cast<int32_t>(rowA[x]) - rowB[x];
+                    squared += static_cast<uint64_t>(d * d);
+                }
+            }
+            samples += bytes * planesA[p].height;
+        }
+        if (squared == 0)
+        {
+            return 100.0;
+        }
+        const double mse = static_cast<double>(squared) / samples;
+        return std::min(100.0, 10.0 * std::log10(255.0 * 255.0 / mse));
+    }
+
+    // ------------------------------------------------------------------------
+
+    bool FrameScaler::PlanKey::operator<(const PlanKey& other) const
+    {
+        return std::tie(srcWidth, srcHeight, dstWidth, dstHeight) < std::tie(other.srcWidth, other.srcHeight, other.dstWidth, other.dstHeight);
+    }
+
+    FrameScaler::FrameScaler(ScaleFilter filter, size_t threadCount, SimdLevel level)
+        : filter(filter), level(level), executor(new RowBandExecutor(threadCount))
+    {
+    }
+
+    const ScalePlan& FrameScaler::getPlan(uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight)
+    {
+        const PlanKey key = { srcWidth, srcHeight, dstWidth, dstHeight };
+        std::map<PlanKey, ScalePlan>::iterator it = plans.find(key);
+        if (it == plans.end())
+        {
+            it = plans.insert(std::make_pair(key, ComputeScalePlan(filter, srcWidth, srcHeight, dstWidth, dstHeight))).first;
+        }
+        return it->second;
+    }
+
+    void FrameScaler::scale(const FrameView& src, const FrameView& dst)
+    {
+        CheckFrames("FrameScaler", src, dst);
+        const ScalePlan& plan = getPlan(src.width, src.height, dst.width, dst.height);
+        executor->run(dst.height, 2, [&](uint32_t bandBegin, uint32_t bandEnd)
+        {
+            ScaleFrameRows(level, plan, src, dst, bandBegin, bandEnd);
+        });
+    }
+
+    // ------------------------------------------------------------------------
+
+    void ScalingFrameProducer::render(const FrameView& frame, uint64_t frameIndex)
+    {
+        if (!scratch || scratch->view().format != frame.format)
+        {
+            scratch.reset(new MemoryFrameBuffer(sourceWidth, sourceHeight, frame.format));
+        }
+        RenderFrame(*scratch, source, frameIndex);
+        scaler.scale(scratch->view(), frame);
+    }
+
+}
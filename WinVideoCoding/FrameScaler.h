@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "FrameView.h"
+#include "MemoryFrameBuffer.h"
+#include "RowBandExecutor.h"
+
+namespace VideoCoding
+{
+
+    enum class ScaleFilter
+    {
+        Bilinear,   // triangle, widened to the scale factor when shrinking
+        Bicubic,    // Keys cubic (a = -0.5), widened the same way
+        Area,       // each source pixel weighted by how much of the destination pixel it covers
+    };
+
+    const char* ScaleFilterName(ScaleFilter filter);
+
+    // Accepts the names returned by ScaleFilterName().
+    bool ParseScaleFilter(const std::string& name, ScaleFilter& filter);
+
+    // Filter taps along one axis, in Q14 fixed point. Destination sample i
+    // is the sum over t < taps of source sample offsets[i] + t times
+    // weights[i * tapStride + t]; the taps past `taps` are zero. Source
+    // positions outside the image are folded onto the edge sample, and the
+    // weights of every destination sample add up to exactly 1 << 14, so flat
+    // areas stay flat.
+    struct ScaleAxis
+    {
+        uint32_t taps;
+        uint32_t tapStride;             // taps rounded up to a multiple of 8
+        std::vector<uint32_t> offsets;
+        std::vector<int16_t> weights;
+    };
+
+    // Throws std::invalid_argument for a zero size.
+    ScaleAxis ComputeScaleAxis(ScaleFilter filter, uint32_t srcSize, uint32_t dstSize);
+
+    // Both axes of the luma and the (half size) chroma planes for one
+    // source and destination size.
+    struct ScalePlan
+    {
+        uint32_t srcWidth, srcHeight;
+        uint32_t dstWidth, dstHeight;
+        ScaleAxis lumaX;
+        ScaleAxis lumaY;
+        ScaleAxis chromaX;
+        ScaleAxis chromaY;
+    };
+
+    ScalePlan ComputeScalePlan(ScaleFilter filter, uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight);
+
+    // Scales destination rows [rowBegin, rowEnd) of an NV12 or I420 frame,
+    // luma and chroma planes separately; NV12's U and V stay interleaved.
+    // Both bounds must be even, `plan` must be for these sizes. Vertical then
+    // horizontal pass, through 16-bit intermediates. Every SimdLevel
+    // produces bit-identical output.
+    void ScaleFrameRows(SimdLevel level, const ScalePlan& plan, const FrameView& src, const FrameView& dst, uint32_t rowBegin, uint32_t rowEnd);
+
+    // Same filters in double precision, applied in one 2D pass with no
+    // intermediate rounding. Slow; the reference ScaleFrameRows is checked
+    // against.
+    void ScaleFrameReference(ScaleFilter filter, const FrameView& src, const FrameView& dst);
+
+    // Peak signal to noise ratio over every plane's pixels, in dB. Frames
+    // must have the same size and format; identical frames give 100.
+    double FramePsnr(const FrameView& a, const FrameView& b);
+
+    // ------------------------------------------------------------------------
+
+    // NV12/I420 scaler using the best kernel for this CPU, optionally
+    // splitting the destination into row bands across threads. The plan for
+    // each source and destination size is computed on first use and kept.
+    class FrameScaler
+    {
+    public:
+        explicit FrameScaler(ScaleFilter filter, size_t threadCount = 1, SimdLevel level = DetectSimdLevel());
+
+        // Source and destination must have the same format and even sizes.
+        void scale(const FrameView& src, const FrameView& dst);
+
+        const ScalePlan& getPlan(uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight);
+
+        ScaleFilter getFilter() const { return filter; }
+        SimdLevel getSimdLevel() const { return level; }
+        size_t getPlanCount() const { return plans.size(); }
+
+    private:
+        struct PlanKey
+        {
+            uint32_t srcWidth, srcHeight, dstWidth, dstHeight;
+
+            bool operator<(const PlanKey& other) const;
+        };
+
+        const ScaleFilter filter;
+        const SimdLevel level;
+        std::map<PlanKey, ScalePlan> plans;
+        std::unique_ptr<RowBandExecutor> executor;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Renders with `source` at sourceWidth x sourceHeight into a scratch
+    // frame of the destination's format and scales the result into the
+    // destination.
+    class ScalingFrameProducer : public FrameProducer
+    {
+    public:
+        ScalingFrameProducer(FrameProducer& source, FrameScaler& scaler, uint32_t sourceWidth, uint32_t sourceHeight)
+            : source(source), scaler(scaler), sourceWidth(sourceWidth), sourceHeight(sourceHeight) {}
+
+        void render(const FrameView& frame, uint64_t frameIndex) override;
+
+    private:
+        FrameProducer& source;
+        FrameScaler& scaler;
+        const uint32_t sourceWidth;
+        const uint32_t sourceHeight;
+        std::unique_ptr<MemoryFrameBuffer> scratch;
+    };
+
+}
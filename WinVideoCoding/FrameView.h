@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+namespace VideoCoding
+{
+
+    enum class PixelFormat
+    {
+        RGB32,  // packed B, G, R, X
+        NV12,   // Y plane followed by interleaved U/V plane, same stride
+        I420,   // Y plane followed by U and V planes at half stride
+    };
+
+    inline const char* PixelFormatName(PixelFormat format)
+    {
+        switch (format)
+        {
+        case PixelFormat::NV12:
+            return "nv12";
+        case PixelFormat::I420:
+            return "i420";
+        default:
+            return "rgb32";
+        }
+    }
+
+    // Accepts the names returned by PixelFormatName().
+    inline bool ParsePixelFormat(const std::string& name, PixelFormat& format)
+    {
+        for (PixelFormat candidate : { PixelFormat::RGB32, PixelFormat::NV12, PixelFormat::I420 })
+        {
+            if (name == PixelFormatName(candidate))
+            {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline size_t BytesPerPixel(PixelFormat format)
+    {
+        return format == PixelFormat::RGB32 ? 4 : 1;
+    }
+
+    // Bytes of one row of the first plane, without padding.
+    inline size_t RowBytes(PixelFormat format, uint32_t width)
+    {
+        return BytesPerPixel(format) * width;
+    }
+
+    // Bytes needed for a contiguous frame with the given luma stride.
+    inline size_t FrameBytesForStride(PixelFormat format, uint32_t height, ptrdiff_t stride)
+    {
+        const size_t lumaBytes = static_cast<size_t>(stride) * height;
+        return format == PixelFormat::RGB32 ? lumaBytes : lumaBytes + lumaBytes / 2;
+    }
+
+    inline size_t FrameBytes(PixelFormat format, uint32_t width, uint32_t height)
+    {
+        return FrameBytesForStride(format, height, static_cast<ptrdiff_t>(RowBytes(format, width)));
+    }
+
+    // Writable window on a frame somebody else owns. For planar formats the
+    // chroma planes follow the luma plane contiguously.
+    struct FrameView
+    {
+        uint8_t* data;
+        ptrdiff_t stride;
+        uint32_t width;
+        uint32_t height;
+        PixelFormat format;
+        uint64_t bufferId;      // NextBufferId() of the memory behind data, 0 if unknown
+
+        uint8_t* row(uint32_t y) const { return data + stride * static_cast<ptrdiff_t>(y); }
+
+        // Plane 0 is RGB32 or luma, planes 1 and 2 are chroma (NV12 only has
+        // plane 1, holding interleaved U/V).
+        uint8_t* plane(unsigned index) const
+        {
+            if (index == 0 || format == PixelFormat::RGB32)
+            {
+                return data;
+            }
+            uint8_t* chroma = data + stride * static_cast<ptrdiff_t>(height);
+            if (index == 2 && format == PixelFormat::I420)
+            {
+                chroma += (stride / 2) * static_cast<ptrdiff_t>(height / 2);
+            }
+            return chroma;
+        }
+
+        ptrdiff_t planeStride(unsigned index) const
+        {
+            return (index == 0 || format != PixelFormat::I420) ? stride : stride / 2;
+        }
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Renders frames straight into the destination buffer, so no intermediate
+    // frame has to be copied.
+    class FrameProducer
+    {
+    public:
+        virtual ~FrameProducer() {}
+
+        virtual void render(const FrameView& frame, uint64_t frameIndex) = 0;
+    };
+
+    // Target must provide:
+    //     FrameView lockFrame();
+    //     void unlockFrame();
+    template<typename Target>
+    void RenderFrame(Target& target, FrameProducer& producer, uint64_t frameIndex)
+    {
+        FrameView view = target.lockFrame();
+        try
+        {
+            producer.render(view, frameIndex);
+        }
+        catch (...)
+        {
+            target.unlockFrame();
+            throw;
+        }
+        target.unlockFrame();
+    }
+
+}
@@ -0,0 +1,116 @@
+#include "FrameWriter.h"
+
+#include <stdexcept>
+#include <string>
+
+#include "FrameDedup.h"
+#include "Tracer.h"
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        SinkFrame RenderSinkFrame(VideoSink& sink, uint32_t streamIndex, FrameProducer& producer, uint64_t frameIndex)
+        {
+            SinkFrame frame;
+            {
+                TRACE_SCOPE("acquireFrame", static_cast<int64_t>(frameIndex));
+                frame = sink.acquireFrame(streamIndex);
+            }
+            try
+            {
+                TRACE_SCOPE("render", static_cast<int64_t>(frameIndex));
+                producer.render(frame.view, frameIndex);
+            }
+            catch (...)
+            {
+                sink.discardFrame(streamIndex, frame);
+                throw;
+            }
+            return frame;
+        }
+
+        struct HashedFrame
+        {
+            SinkFrame frame;
+            uint64_t hash;      // HashFrame() of the contents, 0 without dedup
+        };
+
+        // Hashing here keeps it on the producers' threads.
+        HashedFrame ProduceFrame(VideoSink& sink, uint32_t streamIndex, FrameProducer& producer, uint64_t frameIndex, bool hash)
+        {
+            HashedFrame result = { RenderSinkFrame(sink, streamIndex, producer, frameIndex), 0 };
+            if (hash)
+            {
+                TRACE_SCOPE("hashFrame", static_cast<int64_t>(frameIndex));
+                result.hash = HashFrame(DetectSimdLevel(), result.frame.view);
+            }
+            return result;
+        }
+    }
+
+    PipelineStats WriteFrames(VideoSink& sink, uint32_t streamIndex, const std::vector<FrameProducer*>& producers, const FrameWriterSettings& settings)
+    {
+        if (producers.empty())
+        {
+            throw std::invalid_argument("WriteFrames: no frame producer");
+        }
+
+        const bool dedup = settings.maxHoldDuration > 0;
+        DuplicateFrameFilter filter(sink, streamIndex, settings.maxHoldDuration);
+        const auto write = [&](HashedFrame& frame, uint64_t frameIndex, int64_t timestamp)
+        {
+            TRACE_SCOPE("writeFrame", static_cast<int64_t>(frameIndex));
+            if (dedup)
+            {
+                filter.write(frame.frame, frame.hash, timestamp, settings.frameDuration);
+            }
+            else
+            {
+                sink.writeFrame(streamIndex, frame.frame, timestamp, settings.frameDuration);
+            }
+        };
+
+        PipelineStats stats = PipelineStats();
+        if (settings.queueDepth == 0)
+        {
+            for (uint64_t i = 0; i < settings.frameCount; ++i)
+            {
+                TRACE_SCOPE("frame", static_cast<int64_t>(i));
+                HashedFrame frame = ProduceFrame(sink, streamIndex, *producers[0], i, dedup);
+                write(frame, i, static_cast<int64_t>(i) * settings.frameDuration);
+                ++stats.framesSubmitted;
+            }
+        }
+        else
+        {
+            FramePipeline<HashedFrame> pipeline(producers.size(), settings.queueDepth);
+            stats = pipeline.run(settings.frameCount, settings.frameDuration,
+                [&](size_t producerIndex, uint64_t frameIndex)
+                {
+                    return ProduceFrame(sink, streamIndex, *producers[producerIndex], frameIndex, dedup);
+                },
+                [&](PipelineFrame<HashedFrame>& frame)
+                {
+                    write(frame.item, frame.index, frame.timestamp);
+                },
+                [&](PipelineFrame<HashedFrame>& frame)
+                {
+                    // A write that failed may already have taken the frame.
+                    if (frame.item.frame.handle != nullptr)
+                    {
+                        sink.discardFrame(streamIndex, frame.item.frame);
+                    }
+                });
+        }
+        if (stats.framesSubmitted != settings.frameCount)
+        {
+            throw std::runtime_error("WriteFrames: wrote " + std::to_string(stats.framesSubmitted) + " of " + std::to_string(settings.frameCount) + " frames");
+        }
+        filter.flush();
+        stats.framesDropped = filter.getFramesDropped();
+        return stats;
+    }
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FramePipeline.h"
+#include "FrameView.h"
+#include "VideoSink.h"
+
+namespace VideoCoding
+{
+
+    struct FrameWriterSettings
+    {
+        uint64_t frameCount;
+        int64_t frameDuration;      // 100 ns units
+        size_t queueDepth;          // 0 renders and writes on the calling thread
+        int64_t maxHoldDuration;    // > 0 folds repeated frames into the sample before them,
+                                    // up to this long; see DuplicateFrameFilter
+    };
+
+    // Renders frames straight into buffers from `sink` and writes them in
+    // timestamp order. With a queue depth, every producer gets its own
+    // thread and the calling thread only submits; otherwise the first
+    // producer is used inline. With a hold duration, producers also hash
+    // each frame and the submitting side drops repeats.
+    PipelineStats WriteFrames(VideoSink& sink, uint32_t streamIndex, const std::vector<FrameProducer*>& producers, const FrameWriterSettings& settings);
+
+}
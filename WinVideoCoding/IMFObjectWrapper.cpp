@@ -1 +1,111 @@
 #include "IMFObjectWrapper.h"
+
+namespace IMFWrappers
+{
+
+    std::wstring ToWide(const std::string& text)
+    {
+        int length = MultiByteToWideChar(CP_ACP, 0, text.c_str(), -1, NULL, 0);
+        if (length == 0)
+        {
+            THROW_WINDOWS_ERROR(HRESULT_FROM_WIN32(GetLastError()));
+        }
+        std::wstring wide(length, L'\0');
+        MultiByteToWideChar(CP_ACP, 0, text.c_str(), -1, &wide[0], length);
+        wide.resize(length - 1);
+        return wide;
+    }
+
+    AttributesPtr CreateAttributes(UINT32 initialSize)
+    {
+        AttributesPtr attributes;
+        DO_CHECKED_OPERATION(MFCreateAttributes(attributes.receive(), initialSize));
+        return attributes;
+    }
+
+    MediaBufferPtr CreateMemoryBuffer(DWORD maxLength)
+    {
+        MediaBufferPtr buffer;
+        DO_CHECKED_OPERATION(MFCreateMemoryBuffer(maxLength, buffer.receive()));
+        return buffer;
+    }
+
+    MediaTypePtr CreateMediaType()
+    {
+        MediaTypePtr mediaType;
+        DO_CHECKED_OPERATION(MFCreateMediaType(mediaType.receive()));
+        return mediaType;
+    }
+
+    SamplePtr CreateSample()
+    {
+        SamplePtr sample;
+        DO_CHECKED_OPERATION(MFCreateSample(sample.receive()));
+        return sample;
+    }
+
+    TranscodeProfilePtr CreateTranscodeProfile()
+    {
+        TranscodeProfilePtr profile;
+        DO_CHECKED_OPERATION(MFCreateTranscodeProfile(profile.receive()));
+        return profile;
+    }
+
+    TopologyPtr CreateTranscodeTopology(IMFMediaSource* source, LPCWSTR outputFilePath, IMFTranscodeProfile* profile)
+    {
+        TopologyPtr topology;
+        DO_CHECKED_OPERATION(MFCreateTranscodeTopology(source, outputFilePath, profile, topology.receive()));
+        return topology;
+    }
+
+    SinkWriterPtr CreateSinkWriter(const std::wstring& outputURL, IMFByteStream* byteStream, IMFAttributes* attributes)
+    {
+        SinkWriterPtr writer;
+        DO_CHECKED_OPERATION(MFCreateSinkWriterFromURL(outputURL.c_str(), byteStream, attributes, writer.receive()));
+        return writer;
+    }
+
+    MediaSourcePtr CreateMediaSource(LPCWSTR url)
+    {
+        ComPtr<IMFSourceResolver> resolver;
+        DO_CHECKED_OPERATION(MFCreateSourceResolver(resolver.receive()));
+
+        MF_OBJECT_TYPE objectType = MF_OBJECT_INVALID;
+        ComPtr<IUnknown> object;
+        DO_CHECKED_OPERATION(resolver->CreateObjectFromURL(url, MF_RESOLUTION_MEDIASOURCE, NULL, &objectType, object.receive()));
+        return QueryInterface<IMFMediaSource>(object.get());
+    }
+
+    SourceReaderPtr CreateSourceReader(LPCWSTR url)
+    {
+        SourceReaderPtr reader;
+        DO_CHECKED_OPERATION(MFCreateSourceReaderFromURL(url, nullptr, reader.receive()));
+        return reader;
+    }
+
+    MFTIME GetDuration(IMFMediaSource* source)
+    {
+        ComPtr<IMFPresentationDescriptor> descriptor;
+        DO_CHECKED_OPERATION(source->CreatePresentationDescriptor(descriptor.receive()));
+        UINT64 duration = 0;
+        DO_CHECKED_OPERATION(descriptor->GetUINT64(MF_PD_DURATION, &duration));
+        return static_cast<MFTIME>(duration);
+    }
+
+    void SetSourceRange(IMFTopology* topology, MFTIME start, MFTIME stop)
+    {
+        ComPtr<IMFCollection> nodes;
+        DO_CHECKED_OPERATION(topology->GetSourceNodeCollection(nodes.receive()));
+        DWORD count = 0;
+        DO_CHECKED_OPERATION(nodes->GetElementCount(&count));
+        for (DWORD i = 0; i < count; ++i)
+        {
+            ComPtr<IUnknown> element;
+            DO_CHECKED_OPERATION(nodes->GetElement(i, element.receive()));
+            ComPtr<IMFTopologyNode> node = QueryInterface<IMFTopologyNode>(element.get());
+            DO_CHECKED_OPERATION(node->SetUINT64(MF_TOPONODE_MEDIASTART, static_cast<UINT64>(start)));
+            DO_CHECKED_OPERATION(node->SetUINT64(MF_TOPONODE_MEDIASTOP, static_cast<UINT64>(stop)));
+        }
+    }
+
+}
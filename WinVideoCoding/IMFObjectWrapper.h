@@ -1,8 +1,12 @@
 #pragma once
 
 #include <iostream>
+#include <string>
 #include <utility>
 
+#include "ComPtr.h"
+#include "FrameView.h"
+#include "Result.h"
 #include "SafeRelease.h"
 #include "WindowsError.h"
 
@@ -15,279 +19,178 @@
 namespace IMFWrappers
 {
 
-    template<typename T>
-    class IMFObjectWrapper
-    {
-    public:
-        IMFObjectWrapper() : ptr(nullptr) {};
-        IMFObjectWrapper(const IMFObjectWrapper&) = delete;
-        IMFObjectWrapper(IMFObjectWrapper&& other) : ptr(other.ptr) { other.ptr = nullptr; }
-        virtual ~IMFObjectWrapper() {};
+    typedef ComPtr<IMFAttributes> AttributesPtr;
+    typedef ComPtr<IMFMediaBuffer> MediaBufferPtr;
+    typedef ComPtr<IMFMediaSource> MediaSourcePtr;
+    typedef ComPtr<IMFMediaType> MediaTypePtr;
+    typedef ComPtr<IMFSample> SamplePtr;
+    typedef ComPtr<IMFSinkWriter> SinkWriterPtr;
+    typedef ComPtr<IMFSourceReader> SourceReaderPtr;
+    typedef ComPtr<IMFTopology> TopologyPtr;
+    typedef ComPtr<IMFTranscodeProfile> TranscodeProfilePtr;
 
-        T** getPointer() { return &ptr; }
-        T* get() const { return ptr; }
-
-    protected:
-        T* ptr;
-    };
+    // Every helper below throws WindowsError when the underlying call fails,
+    // except the Try* variants which return a VideoCoding::Status instead.
 
-    // ------------------------------------------------------------------------
+    // Converts from the ANSI code page, as used for command line arguments.
+    std::wstring ToWide(const std::string& text);
 
-    template<typename T>
-    struct AddRefWrapper : public virtual IMFObjectWrapper<T>
+    template<typename U, typename T>
+    ComPtr<U> QueryInterface(T* object)
     {
-        AddRefWrapper() {};
-
-        AddRefWrapper(AddRefWrapper&& other) : IMFObjectWrapper(std::move(other)) {}
+        ComPtr<U> result;
+        DO_CHECKED_OPERATION(object->QueryInterface(IID_PPV_ARGS(result.receive())));
+        return result;
+    }
+
+    AttributesPtr CreateAttributes(UINT32 initialSize);
+    MediaBufferPtr CreateMemoryBuffer(DWORD maxLength);
+    MediaTypePtr CreateMediaType();
+    SamplePtr CreateSample();
+    TranscodeProfilePtr CreateTranscodeProfile();
+    TopologyPtr CreateTranscodeTopology(IMFMediaSource* source, LPCWSTR outputFilePath, IMFTranscodeProfile* profile);
+    // With a byte stream the output goes there and the URL only picks the
+    // container by its extension, unless `attributes` name one with
+    // MF_TRANSCODE_CONTAINERTYPE.
+    SinkWriterPtr CreateSinkWriter(const std::wstring& outputURL, IMFByteStream* byteStream = nullptr, IMFAttributes* attributes = nullptr);
+
+    // Resolves a file or URL into a media source.
+    MediaSourcePtr CreateMediaSource(LPCWSTR url);
+
+    // Reader delivering the source's samples as stored, without decoders.
+    SourceReaderPtr CreateSourceReader(LPCWSTR url);
 
-        void addRef()
-        {
-            ptr->AddRef();
-        }
+    // ------------------------------------------------------------------------
 
-        ULONG release()
-        {
-            return ptr->Release();
-        }
-    };
+    // Attributes. Media types and samples are IMFAttributes too.
 
-    struct IMFMediaBufferWrapper : public AddRefWrapper<IMFMediaBuffer>
+    inline void SetGUID(IMFAttributes* attributes, REFGUID key, REFGUID value)
     {
-        IMFMediaBufferWrapper(const DWORD maxLength)
-        {
-            DO_CHECKED_OPERATION(MFCreateMemoryBuffer(maxLength, &ptr));
-        }
-
-        void copyImage(BYTE* pDest, LONG lDestStride, const BYTE* pSrc, LONG lSrcStride, DWORD dwWidthInBytes, DWORD dwLines)
-        {
-            DO_CHECKED_OPERATION(MFCopyImage(pDest, lDestStride, pSrc, lSrcStride, dwWidthInBytes, dwLines));
-        }
-
-        void lock(BYTE** pData)
-        {
-            DO_CHECKED_OPERATION(ptr->Lock(pData, nullptr, nullptr));
-        }
-
-        void setCurrentLength(DWORD currentLength)
-        {
-            DO_CHECKED_OPERATION(ptr->SetCurrentLength(currentLength));
-        }
-
-        void unlock()
-        {
-            DO_CHECKED_OPERATION(ptr->Unlock();)
-        }
-
-    };
-
-    // ------------------------------------------------------------------------
+        DO_CHECKED_OPERATION(attributes->SetGUID(key, value));
+    }
 
-    template<typename T>
-    struct IMFHasAttributes : public virtual IMFObjectWrapper<T>
+    inline void SetUINT32(IMFAttributes* attributes, REFGUID key, UINT32 value)
     {
-        void setAttributeSize(REFGUID guidKey, UINT32 unWidth, UINT32 unHeight)
-        {
-            DO_CHECKED_OPERATION(MFSetAttributeSize(ptr, guidKey, unWidth, unHeight));
-        }
+        DO_CHECKED_OPERATION(attributes->SetUINT32(key, value));
+    }
 
-        void setAttributeRatio(REFGUID guidKey, UINT32 unWidth, UINT32 unHeight)
-        {
-            DO_CHECKED_OPERATION(MFSetAttributeRatio(ptr, guidKey, unWidth, unHeight));
-        }
+    inline void SetAttributeSize(IMFAttributes* attributes, REFGUID key, UINT32 width, UINT32 height)
+    {
+        DO_CHECKED_OPERATION(MFSetAttributeSize(attributes, key, width, height));
+    }
 
-        void setGUID(REFGUID guidKey, REFGUID guidValue)
-        {
-            DO_CHECKED_OPERATION(ptr->SetGUID(guidKey, guidValue));
-        }
+    inline void SetAttributeRatio(IMFAttributes* attributes, REFGUID key, UINT32 numerator, UINT32 denominator)
+    {
+        DO_CHECKED_OPERATION(MFSetAttributeRatio(attributes, key, numerator, denominator));
+    }
 
-        void setUINT32(REFGUID guidKey, UINT32 unValue)
-        {
-            DO_CHECKED_OPERATION(ptr->SetUINT32(guidKey, unValue));
-        }
+    // Duration of the source's presentation, in 100 ns units.
+    MFTIME GetDuration(IMFMediaSource* source);
 
-    };
+    // Limits every source node of the topology to [start, stop) of the
+    // source timeline; the session then ends by itself at `stop`.
+    void SetSourceRange(IMFTopology* topology, MFTIME start, MFTIME stop);
 
     // ------------------------------------------------------------------------
 
-    struct IMFAttributesWrapper : public AddRefWrapper<IMFAttributes>, public IMFHasAttributes<IMFAttributes>
-    {
-        IMFAttributesWrapper(IMFAttributesWrapper&& other) : IMFObjectWrapper(std::move(other)) {}
-
-        IMFAttributesWrapper(const size_t size)
-        {
-            DO_CHECKED_OPERATION(MFCreateAttributes(&ptr, size));
-        }
-    };
-
-    // ------------------------------------------------------------------------
+    // Samples and buffers.
+    //
+    // The Try* variants are for the per-frame path: they report failure as a
+    // VideoCoding::Status carrying the call site instead of throwing, and do
+    // not allocate either way. The message is only formatted if somebody asks,
+    // see ThrowIfFailed and FormatWindowsMessage in WindowsError.h.
 
-    struct IMFMediaTypeWrapper : public AddRefWrapper<IMFMediaType>, public IMFHasAttributes<IMFMediaType>
+    inline VideoCoding::Result<MediaBufferPtr> TryGetBufferByIndex(IMFSample* sample, DWORD index)
     {
-        IMFMediaTypeWrapper()
-        {
-            DO_CHECKED_OPERATION(MFCreateMediaType(&ptr));
-        }
-    };
-
-    // ------------------------------------------------------------------------
+        MediaBufferPtr buffer;
+        RETURN_IF_FAILED_STATUS(sample->GetBufferByIndex(index, buffer.receive()));
+        return std::move(buffer);
+    }
 
-    struct IMFMediaSourceWrapper : public AddRefWrapper<IMFMediaSource>
+    inline VideoCoding::Status TryLockBuffer(IMFMediaBuffer* buffer, BYTE** data)
     {
+        return MAKE_STATUS(buffer->Lock(data, nullptr, nullptr));
+    }
 
-        IMFMediaSourceWrapper() {}
-
-        IMFMediaSourceWrapper(IMFMediaSourceWrapper&& other) : AddRefWrapper(std::move(other)) {}
-
-        ~IMFMediaSourceWrapper()
-        {
-            if (ptr != nullptr)
-            {
-                ptr->Shutdown();
-            }
-        }
-
-        MFTIME getDuration()
-        {
-            MFTIME pDuration = 0;
-            IMFPresentationDescriptor *pPD = NULL;
-            DO_CHECKED_OPERATION(ptr->CreatePresentationDescriptor(&pPD));
-            UINT64 tmp;
-            DO_CHECKED_OPERATION(pPD->GetUINT64(MF_PD_DURATION, &tmp));
-            pDuration = tmp;
-            pPD->Release();
-            return pDuration;
-        }
-
-        void QueryInterface()
-        {
-            DO_CHECKED_OPERATION(ptr->QueryInterface(IID_PPV_ARGS(&ptr)));
-        }
-
-    };
-
-    // ------------------------------------------------------------------------
-
-    class IMFSourceResolverWrapper : public IMFObjectWrapper<IMFSourceResolver>
+    inline VideoCoding::Status TryUnlockBuffer(IMFMediaBuffer* buffer, DWORD currentLength)
     {
-    public:
-        IMFSourceResolverWrapper()
-        {
-            DO_CHECKED_OPERATION(MFCreateSourceResolver(&ptr));
-        }
-
-        template <typename T>
-        void CreateObjectFromURL(LPCWSTR pwszURL, DWORD dwFlags, IPropertyStore *pProps, MF_OBJECT_TYPE *pObjectType, IMFObjectWrapper<T>& ppObject)
-        {
-            DO_CHECKED_OPERATION(ptr->CreateObjectFromURL(pwszURL, MF_RESOLUTION_MEDIASOURCE, NULL, pObjectType, reinterpret_cast<IUnknown**>(ppObject.getPointer())));
-        }
-
-    };
+        RETURN_IF_FAILED_STATUS(buffer->Unlock());
+        return MAKE_STATUS(buffer->SetCurrentLength(currentLength));
+    }
 
-    class IMFTranscodeProfileWrapper : public AddRefWrapper<IMFTranscodeProfile>
+    inline VideoCoding::Status TrySetSampleTiming(IMFSample* sample, LONGLONG time, LONGLONG duration)
     {
-    public:
-        IMFTranscodeProfileWrapper()
-        {
-            DO_CHECKED_OPERATION(MFCreateTranscodeProfile(&ptr));
-        }
-
-        IMFTranscodeProfileWrapper(IMFTranscodeProfileWrapper&& other) : AddRefWrapper(std::move(other)) {}
-
-        void SetAudioAttributes(IMFAttributesWrapper& attr)
-        {
-            DO_CHECKED_OPERATION(ptr->SetAudioAttributes(attr.get()));
-        }
-
-        void SetContainerAttributes(IMFAttributesWrapper& attr)
-        {
-            DO_CHECKED_OPERATION(ptr->SetContainerAttributes(attr.get()));
-        }
-
-        void SetVideoAttributes(IMFAttributesWrapper& attr)
-        {
-            DO_CHECKED_OPERATION(ptr->SetVideoAttributes(attr.get()));
-        }
-    };
+        RETURN_IF_FAILED_STATUS(sample->SetSampleTime(time));
+        return MAKE_STATUS(sample->SetSampleDuration(duration));
+    }
 
-    struct IMFTopologyWrapper : public IMFObjectWrapper<IMFTopology>
+    inline VideoCoding::Status TryWriteSample(IMFSinkWriter* writer, DWORD streamIndex, IMFSample* sample)
     {
-        IMFTopologyWrapper(IMFMediaSourceWrapper& pSrc, LPCWSTR pwszOutputFilePath, IMFTranscodeProfileWrapper& pProfile)
-        {
-            DO_CHECKED_OPERATION(MFCreateTranscodeTopology(pSrc.get(), pwszOutputFilePath, pProfile.get(), &ptr));
-        }
-    };
+        return MAKE_STATUS(writer->WriteSample(streamIndex, sample));
+    }
 
-    // ------------------------------------------------------------------------
+    inline MediaBufferPtr GetBufferByIndex(IMFSample* sample, DWORD index)
+    {
+        return Unwrap(TryGetBufferByIndex(sample, index));
+    }
 
-    struct IMFSampleWrapper : public AddRefWrapper<IMFSample>
+    inline void AddBuffer(IMFSample* sample, IMFMediaBuffer* buffer)
     {
+        DO_CHECKED_OPERATION(sample->AddBuffer(buffer));
+    }
 
-        IMFSampleWrapper()
-        {
-            DO_CHECKED_OPERATION(MFCreateSample(&ptr));
-        }
+    inline void SetSampleTiming(IMFSample* sample, LONGLONG time, LONGLONG duration)
+    {
+        ThrowIfFailed(TrySetSampleTiming(sample, time, duration));
+    }
 
-        void addBuffer(const IMFMediaBufferWrapper& buffer)
-        {
-            DO_CHECKED_OPERATION(ptr->AddBuffer(buffer.get()));
-        }
+    // Lets a VideoCoding::FrameProducer render straight into a locked media
+    // buffer, see VideoCoding::RenderFrame. Does not own the buffer.
+    struct MediaBufferFrameTarget
+    {
+        MediaBufferFrameTarget(IMFMediaBuffer* buffer, UINT32 width, UINT32 height, VideoCoding::PixelFormat format)
+            : buffer(buffer), width(width), height(height), format(format) {}
 
-        void setSampleDuration(const LONGLONG duration)
+        VideoCoding::FrameView lockFrame()
         {
-            DO_CHECKED_OPERATION(ptr->SetSampleDuration(duration));
+            BYTE* data = nullptr;
+            ThrowIfFailed(TryLockBuffer(buffer, &data));
+            VideoCoding::FrameView view = { data, static_cast<ptrdiff_t>(VideoCoding::RowBytes(format, width)), width, height, format, 0 };
+            return view;
         }
 
-        void setSampleTime(const LONGLONG time)
+        void unlockFrame()
         {
-            DO_CHECKED_OPERATION(ptr->SetSampleTime(time));
+            ThrowIfFailed(TryUnlockBuffer(buffer, static_cast<DWORD>(VideoCoding::FrameBytes(format, width, height))));
         }
 
+        IMFMediaBuffer* buffer;
+        UINT32 width;
+        UINT32 height;
+        VideoCoding::PixelFormat format;
     };
 
     // ------------------------------------------------------------------------
 
-    struct IMFSinkWriterWrapper : public AddRefWrapper<IMFSinkWriter>
+    // Shuts a media source down when leaving the scope. The source keeps
+    // internal references to itself that Release alone does not break.
+    class ScopedShutdown
     {
+    public:
+        explicit ScopedShutdown(IMFMediaSource* source) : source(source) {}
+        ScopedShutdown(const ScopedShutdown&) = delete;
+        ScopedShutdown& operator=(const ScopedShutdown&) = delete;
 
-        IMFSinkWriterWrapper(IMFSinkWriterWrapper&& other) : IMFObjectWrapper<IMFSinkWriter>(std::move(other)) {}
-
-        ~IMFSinkWriterWrapper()
+        ~ScopedShutdown()
         {
-            if (ptr != nullptr)
+            if (source != nullptr)
             {
-                ptr->Finalize();
+                source->Shutdown();
             }
         }
 
-        // TODO: pAttributes should be of type std::optional<IMFAttributesWrapper>
-        IMFSinkWriterWrapper(std::string pwszOutputURL, IMFByteStream *pByteStream, IMFAttributes *pAttributes)
-        {
-            DO_CHECKED_OPERATION(MFCreateSinkWriterFromURL(L"output.wmv", nullptr, nullptr, &ptr));
-        }
-
-        DWORD AddStream(const IMFMediaTypeWrapper& pTargetMediaType)
-        {
-            DWORD streamIndex;
-            DO_CHECKED_OPERATION(ptr->AddStream(pTargetMediaType.get(), &streamIndex));
-            return streamIndex;
-        }
-
-        void beginWritting()
-        {
-            DO_CHECKED_OPERATION(ptr->BeginWriting());
-        }
-
-        // TODO: pEncodingParameters should be of type std::optional<IMFAttributesWrapper>
-        void setInputMediaType(DWORD dwStreamIndex, const IMFMediaTypeWrapper& pInputMediaType, IMFAttributes *pEncodingParameters)
-        {
-            DO_CHECKED_OPERATION(ptr->SetInputMediaType(dwStreamIndex, pInputMediaType.get(), nullptr));
-        }
-
-        void writeSample(DWORD streamIndex, const IMFSampleWrapper& sample) const
-        {
-            DO_CHECKED_OPERATION(ptr->WriteSample(streamIndex, sample.get()));
-        }
-
+    private:
+        IMFMediaSource* source;
     };
 
 }
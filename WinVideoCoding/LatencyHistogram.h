@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace VideoCoding
+{
+
+    // Log-linear histogram of durations in nanoseconds. Values below 32 are
+    // exact, above that every power of two is split into 32 buckets, which
+    // keeps the error of a reported percentile under ~3% at a fixed size.
+    class LatencyHistogram
+    {
+    public:
+        LatencyHistogram() : buckets(BUCKET_COUNT, 0), count(0), sum(0), max(0) {}
+
+        void record(uint64_t value)
+        {
+            ++buckets[bucketIndex(value)];
+            ++count;
+            sum += value;
+            max = std::max(max, value);
+        }
+
+        void merge(const LatencyHistogram& other)
+        {
+            for (size_t i = 0; i < BUCKET_COUNT; ++i)
+            {
+                buckets[i] += other.buckets[i];
+            }
+            count += other.count;
+            sum += other.sum;
+            max = std::max(max, other.max);
+        }
+
+        // Value at or below which `fraction` (0..1) of the samples lie.
+        uint64_t percentile(double fraction) const
+        {
+            if (count == 0)
+            {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(fraction * count + 0.5);
+            rank = std::max<uint64_t>(1, std::min(rank, count));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKET_COUNT; ++i)
+            {
+                seen += buckets[i];
+                if (seen >= rank)
+                {
+                    return std::min(bucketValue(i), max);
+                }
+            }
+            return max;
+        }
+
+        uint64_t getCount() const { return count; }
+        uint64_t getMax() const { return max; }
+        double getMean() const { return count == 0 ? 0.0 : static_cast<double>(sum) / count; }
+
+    private:
+        static const unsigned SUB_BITS = 5;
+        static const uint64_t SUB_COUNT = 1u << SUB_BITS;
+        static const size_t BUCKET_COUNT = (64 - SUB_BITS + 1) << SUB_BITS;
+
+        static size_t bucketIndex(uint64_t value)
+        {
+            if (value < SUB_COUNT)
+            {
+                return static_cast<size_t>(value);
+            }
+            unsigned msb = 0;
+            for (uint64_t v = value; v >>= 1;)
+            {
+                ++msb;
+            }
+            const unsigned shift = msb - SUB_BITS;
+            return static_cast<size_t>(((shift + 1) << SUB_BITS) | ((value >> shift) & (SUB_COUNT - 1)));
+        }
+
+        // Middle of the bucket's range.
+        static uint64_t bucketValue(size_t index)
+        {
+            if (index < SUB_COUNT)
+            {
+                return index;
+            }
+            const unsigned shift = static_cast<unsigned>(index >> SUB_BITS) - 1;
+            const uint64_t lower = (SUB_COUNT | (index & (SUB_COUNT - 1))) << shift;
+            return lower + ((uint64_t(1) << shift) >> 1);
+        }
+
+        std::vector<uint64_t> buckets;
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+    };
+
+}
@@ -0,0 +1,376 @@
+#include "LocalChannel.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        const size_t READ_CHUNK = 4096;
+
+#ifdef _WIN32
+        const DWORD PIPE_BUFFER_BYTES = 64 << 10;
+        const DWORD CONNECT_TIMEOUT_MS = 5000;
+
+        std::string PipeName(const std::string& endpoint)
+        {
+            const std::string prefix = "\\\\.\\pipe\\";
+            return endpoint.compare(0, prefix.size(), prefix) == 0 ? endpoint : prefix + endpoint;
+        }
+
+        HANDLE CreatePipeInstance(const std::string& name, bool first)
+        {
+            const DWORD openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+            HANDLE pipe = CreateNamedPipeA(name.c_str(), openMode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                PIPE_UNLIMITED_INSTANCES, PIPE_BUFFER_BYTES, PIPE_BUFFER_BYTES, 0, NULL);
+            if (pipe == INVALID_HANDLE_VALUE)
+            {
+                throw std::runtime_error("LocalListener: cannot create " + name + (first ? ", is another daemon running?" : ""));
+            }
+            return pipe;
+        }
+
+        // Overlapped, so a read blocked on one thread doesn't hold up writes
+        // from others on the same handle. False on failure or cancellation.
+        bool TransferPipe(HANDLE pipe, bool write, void* data, DWORD length, DWORD& transferred)
+        {
+            OVERLAPPED overlapped = {};
+            overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+            if (overlapped.hEvent == NULL)
+            {
+                return false;
+            }
+            const BOOL started = write ? WriteFile(pipe, data, length, NULL, &overlapped) : ReadFile(pipe, data, length, NULL, &overlapped);
+            bool ok = started || GetLastError() == ERROR_IO_PENDING;
+            transferred = 0;
+            if (ok)
+            {
+                ok = GetOverlappedResult(pipe, &overlapped, &transferred, TRUE) != FALSE;
+            }
+            CloseHandle(overlapped.hEvent);
+            return ok;
+        }
+#else
+#ifdef MSG_NOSIGNAL
+        const int SEND_FLAGS = MSG_NOSIGNAL;   // a gone peer fails the send instead of raising SIGPIPE
+#else
+        const int SEND_FLAGS = 0;
+#endif
+
+        sockaddr_un SocketAddress(const std::string& endpoint)
+        {
+            sockaddr_un address;
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (endpoint.empty() || endpoint.size() >= sizeof(address.sun_path))
+            {
+                throw std::runtime_error("local endpoint must be a path of 1 to " + std::to_string(sizeof(address.sun_path) - 1) + " bytes: " + endpoint);
+            }
+            std::memcpy(address.sun_path, endpoint.c_str(), endpoint.size());
+            return address;
+        }
+
+        int ConnectSocket(const std::string& endpoint)
+        {
+            const sockaddr_un address = SocketAddress(endpoint);
+            const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0)
+            {
+                return -1;
+            }
+            if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+            {
+                ::close(fd);
+                return -1;
+            }
+            return fd;
+        }
+#endif
+    }
+
+    // ------------------------------------------------------------------------
+
+#ifdef _WIN32
+    LocalConnection::LocalConnection(void* pipe) : pipe(pipe), closed(false)
+    {
+    }
+#else
+    LocalConnection::LocalConnection(int socket) : socket(socket), closed(false)
+    {
+    }
+#endif
+
+    LocalConnection::~LocalConnection()
+    {
+#ifdef _WIN32
+        CloseHandle(pipe);
+#else
+        ::close(socket);
+#endif
+    }
+
+    std::unique_ptr<LocalConnection> LocalConnection::connect(const std::string& endpoint)
+    {
+#ifdef _WIN32
+        const std::string name = PipeName(endpoint);
+        for (;;)
+        {
+            HANDLE pipe = CreateFileA(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+            if (pipe != INVALID_HANDLE_VALUE)
+            {
+                return std::unique_ptr<LocalConnection>(new LocalConnection(pipe));
+            }
+            // Every instance is taken until the daemon creates the next one.
+            if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(name.c_str(), CONNECT_TIMEOUT_MS))
+            {
+                throw std::runtime_error("LocalConnection: nothing listens at " + name);
+            }
+        }
+#else
+        const int fd = ConnectSocket(endpoint);
+        if (fd < 0)
+        {
+            throw std::runtime_error("LocalConnection: nothing listens at " + endpoint);
+        }
+        return std::unique_ptr<LocalConnection>(new LocalConnection(fd));
+#endif
+    }
+
+    bool LocalConnection::readLine(std::string& line)
+    {
+        for (;;)
+        {
+            const size_t end = buffer.find('\n');
+            if (end != std::string::npos)
+            {
+                line.assign(buffer, 0, end > 0 && buffer[end - 1] == '\r' ? end - 1 : end);
+                buffer.erase(0, end + 1);
+                return true;
+            }
+            if (closed.load())
+            {
+                return false;
+            }
+
+            char chunk[READ_CHUNK];
+#ifdef _WIN32
+            DWORD received = 0;
+            if (!TransferPipe(pipe, false, chunk, sizeof(chunk), received) || received == 0)
+            {
+                return false;
+            }
+#else
+            ssize_t received = ::recv(socket, chunk, sizeof(chunk), 0);
+            if (received < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                return false;
+            }
+#endif
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+    }
+
+    bool LocalConnection::writeLine(const std::string& line)
+    {
+        const std::string data = line + "\n";
+        std::lock_guard<std::mutex> lock(writeMutex);
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            if (closed.load())
+            {
+                return false;
+            }
+#ifdef _WIN32
+            DWORD written = 0;
+            if (!TransferPipe(pipe, true, const_cast<char*>(data.data() + sent), static_cast<DWORD>(data.size() - sent), written))
+            {
+                return false;
+            }
+#else
+            const ssize_t written = ::send(socket, data.data() + sent, data.size() - sent, SEND_FLAGS);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                return false;
+            }
+#endif
+            sent += static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    void LocalConnection::shutdown()
+    {
+        if (closed.exchange(true))
+        {
+            return;
+        }
+#ifdef _WIN32
+        // Ends a read pending on another thread; the handle is closed by the
+        // destructor, once nobody can be using it.
+        CancelIoEx(pipe, NULL);
+#else
+        ::shutdown(socket, SHUT_RDWR);
+#endif
+    }
+
+    // ------------------------------------------------------------------------
+
+    LocalListener::LocalListener(const std::string& endpoint)
+        : endpoint(endpoint), closed(false)
+    {
+#ifdef _WIN32
+        const std::string name = PipeName(endpoint);
+        stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        if (stopEvent == NULL)
+        {
+            throw std::runtime_error("LocalListener: cannot create event");
+        }
+        try
+        {
+            pending = CreatePipeInstance(name, true);
+        }
+        catch (...)
+        {
+            CloseHandle(stopEvent);
+            throw;
+        }
+#else
+        const sockaddr_un address = SocketAddress(endpoint);
+        const int live = ConnectSocket(endpoint);
+        if (live >= 0)
+        {
+            ::close(live);
+            throw std::runtime_error("LocalListener: " + endpoint + " is in use, is another daemon running?");
+        }
+        // Left behind by a daemon that didn't exit cleanly.
+        ::unlink(endpoint.c_str());
+
+        socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket < 0)
+        {
+            throw std::runtime_error("LocalListener: cannot create a socket");
+        }
+        if (::bind(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(socket, SOMAXCONN) != 0)
+        {
+            ::close(socket);
+            throw std::runtime_error("LocalListener: cannot listen at " + endpoint);
+        }
+#endif
+    }
+
+    LocalListener::~LocalListener()
+    {
+#ifdef _WIN32
+        if (pending != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(pending);
+        }
+        CloseHandle(stopEvent);
+#else
+        ::close(socket);
+        ::unlink(endpoint.c_str());
+#endif
+    }
+
+    std::unique_ptr<LocalConnection> LocalListener::accept()
+    {
+#ifdef _WIN32
+        if (closed.load() || pending == INVALID_HANDLE_VALUE)
+        {
+            return std::unique_ptr<LocalConnection>();
+        }
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        if (overlapped.hEvent == NULL)
+        {
+            throw std::runtime_error("LocalListener: cannot create event");
+        }
+        bool connected = ConnectNamedPipe(pending, &overlapped) != FALSE || GetLastError() == ERROR_PIPE_CONNECTED;
+        if (!connected && GetLastError() == ERROR_IO_PENDING)
+        {
+            HANDLE events[] = { overlapped.hEvent, stopEvent };
+            if (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0)
+            {
+                DWORD unused = 0;
+                connected = GetOverlappedResult(pending, &overlapped, &unused, FALSE) != FALSE;
+            }
+            else
+            {
+                CancelIoEx(pending, &overlapped);
+                DWORD unused = 0;
+                GetOverlappedResult(pending, &overlapped, &unused, TRUE);
+            }
+        }
+        CloseHandle(overlapped.hEvent);
+        if (!connected || closed.load())
+        {
+            return std::unique_ptr<LocalConnection>();
+        }
+
+        // The next client needs an instance to connect to before this one is
+        // handed out.
+        HANDLE client = pending;
+        pending = INVALID_HANDLE_VALUE;
+        std::unique_ptr<LocalConnection> connection(new LocalConnection(client));
+        pending = CreatePipeInstance(PipeName(endpoint), false);
+        return connection;
+#else
+        for (;;)
+        {
+            const int fd = ::accept(socket, NULL, NULL);
+            if (closed.load())
+            {
+                if (fd >= 0)
+                {
+                    ::close(fd);
+                }
+                return std::unique_ptr<LocalConnection>();
+            }
+            if (fd >= 0)
+            {
+                return std::unique_ptr<LocalConnection>(new LocalConnection(fd));
+            }
+            if (errno != EINTR && errno != ECONNABORTED)
+            {
+                throw std::runtime_error("LocalListener: accept failed on " + endpoint);
+            }
+        }
+#endif
+    }
+
+    void LocalListener::close()
+    {
+        if (closed.exchange(true))
+        {
+            return;
+        }
+#ifdef _WIN32
+        SetEvent(stopEvent);
+#else
+        // Wakes a blocked accept(); the descriptor stays open until the
+        // destructor so it can't be reused under it.
+        ::shutdown(socket, SHUT_RDWR);
+#endif
+    }
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace VideoCoding
+{
+
+    // Endpoints are a Unix domain socket path, or on Windows a named pipe:
+    // "name" and "\\.\pipe\name" are the same pipe.
+
+    // One end of a local stream connection carrying text lines. One thread
+    // may read while others write; each line is written whole, so lines
+    // from different threads never interleave.
+    class LocalConnection
+    {
+    public:
+        ~LocalConnection();
+
+        LocalConnection(const LocalConnection&) = delete;
+        LocalConnection& operator=(const LocalConnection&) = delete;
+
+        // Throws std::runtime_error when nothing listens at `endpoint`.
+        static std::unique_ptr<LocalConnection> connect(const std::string& endpoint);
+
+        // Next line, without its "\n" or "\r\n". False at the end of the
+        // stream or after shutdown().
+        bool readLine(std::string& line);
+
+        // Appends "\n". False once the peer has gone; the line is lost.
+        bool writeLine(const std::string& line);
+
+        // Ends the connection both ways. A readLine() blocked on another
+        // thread returns false. Thread safe.
+        void shutdown();
+
+    private:
+#ifdef _WIN32
+        explicit LocalConnection(void* pipe);
+
+        void* pipe;
+#else
+        explicit LocalConnection(int socket);
+
+        int socket;
+#endif
+        friend class LocalListener;
+
+        std::string buffer;         // read but not yet returned
+        std::mutex writeMutex;
+        std::atomic<bool> closed;
+    };
+
+    // Accepts connections at an endpoint until closed. A Unix socket left
+    // behind by a listener that is gone is replaced; one that is still
+    // being listened on is not.
+    class LocalListener
+    {
+    public:
+        // Throws std::runtime_error when the endpoint can't be created or
+        // is in use.
+        explicit LocalListener(const std::string& endpoint);
+        ~LocalListener();
+
+        LocalListener(const LocalListener&) = delete;
+        LocalListener& operator=(const LocalListener&) = delete;
+
+        // Blocks for the next client. Null once close() has been called.
+        std::unique_ptr<LocalConnection> accept();
+
+        // Makes a blocked accept() return null, and every later one. Thread
+        // safe.
+        void close();
+
+        const std::string& getEndpoint() const { return endpoint; }
+
+    private:
+        const std::string endpoint;
+        std::atomic<bool> closed;
+#ifdef _WIN32
+        void* pending;              // pipe instance the next client connects to
+        void* stopEvent;
+#else
+        int socket;
+#endif
+    };
+
+}
@@ -0,0 +1,190 @@
+#include "MFProfileCache.h"
+
+#include <codecapi.h>
+
+namespace
+{
+    const GUID& CodecSubtype(VideoCoding::VideoCodec codec, VideoCoding::PixelFormat pixelFormat)
+    {
+        switch (codec)
+        {
+        case VideoCoding::VideoCodec::WMV3:
+            return MFVideoFormat_WMV3;
+        case VideoCoding::VideoCodec::H264:
+            return MFVideoFormat_H264;
+        default:
+            break;
+        }
+
+        switch (pixelFormat)
+        {
+        case VideoCoding::PixelFormat::NV12:
+            return MFVideoFormat_NV12;
+        case VideoCoding::PixelFormat::I420:
+            return MFVideoFormat_I420;
+        default:
+            return MFVideoFormat_RGB32;
+        }
+    }
+
+    void SetVideoAttributes(IMFMediaType* mediaType, const VideoCoding::VideoStreamFormat& format)
+    {
+        IMFWrappers::SetGUID(mediaType, MF_MT_MAJOR_TYPE, MFMediaType_Video);
+        IMFWrappers::SetGUID(mediaType, MF_MT_SUBTYPE, CodecSubtype(format.codec, format.pixelFormat));
+        IMFWrappers::SetUINT32(mediaType, MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+        IMFWrappers::SetAttributeSize(mediaType, MF_MT_FRAME_SIZE, format.width, format.height);
+        IMFWrappers::SetAttributeRatio(mediaType, MF_MT_FRAME_RATE, format.fpsNumerator, format.fpsDenominator);
+        IMFWrappers::SetAttributeRatio(mediaType, MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
+    }
+
+    IMFWrappers::MediaTypePtr CreateVideoType(const VideoCoding::ProfileDescriptor& descriptor)
+    {
+        const VideoCoding::VideoStreamFormat& format = descriptor.video;
+        IMFWrappers::MediaTypePtr mediaType = IMFWrappers::CreateMediaType();
+        SetVideoAttributes(mediaType.get(), format);
+        if (descriptor.use == VideoCoding::ProfileUse::StreamInput)
+        {
+            if (format.pixelFormat != VideoCoding::PixelFormat::RGB32)
+            {
+                IMFWrappers::SetUINT32(mediaType.get(), MF_MT_YUV_MATRIX, format.matrix == VideoCoding::ColorMatrix::BT709 ? MFVideoTransferMatrix_BT709 : MFVideoTransferMatrix_BT601);
+                IMFWrappers::SetUINT32(mediaType.get(), MF_MT_VIDEO_NOMINAL_RANGE, format.range == VideoCoding::ColorRange::Full ? MFNominalRange_0_255 : MFNominalRange_16_235);
+            }
+            return mediaType;
+        }
+        IMFWrappers::SetUINT32(mediaType.get(), MF_MT_AVG_BITRATE, format.bitrate);
+        if (descriptor.keyframeSpacing > 0)
+        {
+            IMFWrappers::SetUINT32(mediaType.get(), MF_MT_MAX_KEYFRAME_SPACING, descriptor.keyframeSpacing);
+        }
+        return mediaType;
+    }
+
+    IMFWrappers::MediaTypePtr CreateAudioType(const VideoCoding::AudioStreamFormat& format)
+    {
+        IMFWrappers::MediaTypePtr mediaType = IMFWrappers::CreateMediaType();
+        IMFWrappers::SetGUID(mediaType.get(), MF_MT_MAJOR_TYPE, MFMediaType_Audio);
+        IMFWrappers::SetUINT32(mediaType.get(), MF_MT_AUDIO_SAMPLES_PER_SECOND, format.sampleRate);
+        IMFWrappers::SetUINT32(mediaType.get(), MF_MT_AUDIO_NUM_CHANNELS, format.channels);
+        IMFWrappers::SetUINT32(mediaType.get(), MF_MT_AUDIO_BITS_PER_SAMPLE, format.bitsPerSample);
+        if (format.codec == VideoCoding::AudioCodec::AAC)
+        {
+            IMFWrappers::SetGUID(mediaType.get(), MF_MT_SUBTYPE, MFAudioFormat_AAC);
+            IMFWrappers::SetUINT32(mediaType.get(), MF_MT_AUDIO_AVG_BYTES_PER_SECOND, format.bytesPerSecond);
+            IMFWrappers::SetUINT32(mediaType.get(), MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION, format.aacProfile);
+        }
+        else
+        {
+            IMFWrappers::SetGUID(mediaType.get(), MF_MT_SUBTYPE, MFAudioFormat_PCM);
+            IMFWrappers::SetUINT32(mediaType.get(), MF_MT_AUDIO_BLOCK_ALIGNMENT, format.blockAlign());
+            IMFWrappers::SetUINT32(mediaType.get(), MF_MT_AUDIO_AVG_BYTES_PER_SECOND, format.blockAlign() * format.sampleRate);
+        }
+        return mediaType;
+    }
+
+    IMFWrappers::AttributesPtr CreateAACProfile(const VideoCoding::AudioStreamFormat& format)
+    {
+        IMFWrappers::AttributesPtr pAttributes = IMFWrappers::CreateAttributes(7);
+
+        IMFWrappers::SetGUID(pAttributes.get(), MF_MT_SUBTYPE, MFAudioFormat_AAC);
+        IMFWrappers::SetUINT32(pAttributes.get(), MF_MT_AUDIO_BITS_PER_SAMPLE, format.bitsPerSample);
+        IMFWrappers::SetUINT32(pAttributes.get(), MF_MT_AUDIO_SAMPLES_PER_SECOND, format.sampleRate);
+        IMFWrappers::SetUINT32(pAttributes.get(), MF_MT_AUDIO_NUM_CHANNELS, format.channels);
+        IMFWrappers::SetUINT32(pAttributes.get(), MF_MT_AUDIO_AVG_BYTES_PER_SECOND, format.bytesPerSecond);
+        IMFWrappers::SetUINT32(pAttributes.get(), MF_MT_AUDIO_BLOCK_ALIGNMENT, 1);
+        IMFWrappers::SetUINT32(pAttributes.get(), MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION, format.aacProfile);
+
+        return pAttributes;
+    }
+
+    IMFWrappers::AttributesPtr CreateH264Profile(const VideoCoding::ProfileDescriptor& descriptor)
+    {
+        const VideoCoding::VideoStreamFormat& format = descriptor.video;
+        IMFWrappers::AttributesPtr pAttributes = IMFWrappers::CreateAttributes(6);
+
+        IMFWrappers::SetGUID(pAttributes.get(), MF_MT_SUBTYPE, MFVideoFormat_H264);
+        IMFWrappers::SetUINT32(pAttributes.get(), MF_MT_MPEG2_PROFILE, descriptor.videoProfile);
+        IMFWrappers::SetAttributeSize(pAttributes.get(), MF_MT_FRAME_SIZE, format.width, format.height);
+        IMFWrappers::SetAttributeRatio(pAttributes.get(), MF_MT_FRAME_RATE, format.fpsNumerator, format.fpsDenominator);
+        IMFWrappers::SetUINT32(pAttributes.get(), MF_MT_AVG_BITRATE, format.bitrate);
+        if (descriptor.keyframeSpacing > 0)
+        {
+            IMFWrappers::SetUINT32(pAttributes.get(), MF_MT_MAX_KEYFRAME_SPACING, descriptor.keyframeSpacing);
+        }
+
+        return pAttributes;
+    }
+
+    IMFWrappers::TranscodeProfilePtr CreateTranscodeProfile(const VideoCoding::ProfileDescriptor& descriptor)
+    {
+        if (descriptor.use != VideoCoding::ProfileUse::Transcode || !descriptor.hasVideo || !descriptor.hasAudio
+            || descriptor.video.codec != VideoCoding::VideoCodec::H264 || descriptor.audio.codec != VideoCoding::AudioCodec::AAC)
+        {
+            THROW_WINDOWS_ERROR(E_INVALIDARG);
+        }
+
+        IMFWrappers::TranscodeProfilePtr pProfile = IMFWrappers::CreateTranscodeProfile();
+
+        // Audio attributes.
+        IMFWrappers::AttributesPtr pAudio = CreateAACProfile(descriptor.audio);
+        DO_CHECKED_OPERATION(pProfile->SetAudioAttributes(pAudio.get()));
+
+        // Video attributes.
+        IMFWrappers::AttributesPtr pVideo = CreateH264Profile(descriptor);
+        DO_CHECKED_OPERATION(pProfile->SetVideoAttributes(pVideo.get()));
+
+        // Container attributes.
+        IMFWrappers::AttributesPtr pContainer = IMFWrappers::CreateAttributes(1);
+        IMFWrappers::SetGUID(pContainer.get(), MF_TRANSCODE_CONTAINERTYPE,
+            descriptor.container == VideoCoding::ContainerType::FragmentedMPEG4 ? MFTranscodeContainerType_FMPEG4 : MFTranscodeContainerType_MPEG4);
+        DO_CHECKED_OPERATION(pProfile->SetContainerAttributes(pContainer.get()));
+
+        return pProfile;
+    }
+
+    IMFWrappers::MediaTypePtr CreateStreamType(const VideoCoding::ProfileDescriptor& descriptor)
+    {
+        if (descriptor.use == VideoCoding::ProfileUse::Transcode || descriptor.hasVideo == descriptor.hasAudio)
+        {
+            THROW_WINDOWS_ERROR(E_INVALIDARG);
+        }
+        return descriptor.hasVideo ? CreateVideoType(descriptor) : CreateAudioType(descriptor.audio);
+    }
+
+    VideoCoding::ProfileCache<IMFWrappers::TranscodeProfilePtr>& TranscodeProfiles()
+    {
+        static VideoCoding::ProfileCache<IMFWrappers::TranscodeProfilePtr> cache;
+        return cache;
+    }
+
+    VideoCoding::ProfileCache<IMFWrappers::MediaTypePtr>& MediaTypes()
+    {
+        static VideoCoding::ProfileCache<IMFWrappers::MediaTypePtr> cache;
+        return cache;
+    }
+}
+
+IMFWrappers::TranscodeProfilePtr GetTranscodeProfile(const VideoCoding::ProfileDescriptor& descriptor)
+{
+    return TranscodeProfiles().get(descriptor, CreateTranscodeProfile)->copy();
+}
+
+IMFWrappers::MediaTypePtr GetMediaType(const VideoCoding::ProfileDescriptor& descriptor)
+{
+    return MediaTypes().get(descriptor, CreateStreamType)->copy();
+}
+
+VideoCoding::ProfileCacheStats GetTranscodeProfileCacheStats()
+{
+    return TranscodeProfiles().stats();
+}
+
+VideoCoding::ProfileCacheStats GetMediaTypeCacheStats()
+{
+    return MediaTypes().stats();
+}
+
+void ClearMFProfileCaches()
+{
+    TranscodeProfiles().clear();
+    MediaTypes().clear();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "IMFObjectWrapper.h"
+#include "ProfileCache.h"
+
+// Process wide caches of the Media Foundation objects built from profile
+// descriptors: transcode profiles for EncodeFile, stream media types for
+// MFVideoSink. Jobs with the same settings get the same object, so what
+// these hand out must not be modified.
+//
+// The objects belong to Media Foundation: call ClearMFProfileCaches()
+// before the process's last MFShutdown().
+
+// `descriptor` must be a ProfileUse::Transcode one. Throws WindowsError.
+IMFWrappers::TranscodeProfilePtr GetTranscodeProfile(const VideoCoding::ProfileDescriptor& descriptor);
+
+// For StreamOutput and StreamInput descriptors. Throws WindowsError.
+IMFWrappers::MediaTypePtr GetMediaType(const VideoCoding::ProfileDescriptor& descriptor);
+
+VideoCoding::ProfileCacheStats GetTranscodeProfileCacheStats();
+VideoCoding::ProfileCacheStats GetMediaTypeCacheStats();
+
+void ClearMFProfileCaches();
@@ -0,0 +1,238 @@
+#include "MFVideoSink.h"
+
+#include <cstring>
+
+#include "MFProfileCache.h"
+#include "Mp4Fragment.h"
+#include "Tracer.h"
+
+namespace
+{
+    IMFWrappers::AttributesPtr CreateWriterAttributes(int64_t fragmentDuration)
+    {
+        if (fragmentDuration <= 0)
+        {
+            return IMFWrappers::AttributesPtr();
+        }
+        IMFWrappers::AttributesPtr attributes = IMFWrappers::CreateAttributes(1);
+        IMFWrappers::SetGUID(attributes.get(), MF_TRANSCODE_CONTAINERTYPE, MFTranscodeContainerType_FMPEG4);
+        return attributes;
+    }
+}
+
+MFVideoSink::MFVideoSink(const std::string& outputURL, size_t poolCapacity, IMFByteStream* byteStream, int64_t fragmentDuration)
+    : writer(IMFWrappers::CreateSinkWriter(IMFWrappers::ToWide(outputURL), byteStream, CreateWriterAttributes(fragmentDuration).get())),
+      poolCapacity(poolCapacity), fragmentDuration(fragmentDuration), finalized(false)
+{
+}
+
+MFVideoSink::~MFVideoSink()
+{
+    if (!finalized)
+    {
+        // Best effort, errors can't be reported from here.
+        writer->Finalize();
+    }
+    for (Stream& stream : streams)
+    {
+        SafeRelease(&stream.pool);
+    }
+}
+
+uint32_t MFVideoSink::addStream(const VideoCoding::VideoStreamFormat& outputFormat)
+{
+    uint32_t keyframeSpacing = 0;
+    if (fragmentDuration > 0 && outputFormat.codec != VideoCoding::VideoCodec::Uncompressed)
+    {
+        keyframeSpacing = VideoCoding::FramesPerFragment(fragmentDuration, outputFormat.fpsNumerator, outputFormat.fpsDenominator);
+    }
+    // Shared with every other sink writing this format, so not modified here.
+    IMFWrappers::MediaTypePtr pMediaTypeOut = GetMediaType(VideoCoding::MakeVideoTypeDescriptor(VideoCoding::ProfileUse::StreamOutput, outputFormat, keyframeSpacing));
+
+    DWORD streamIndex = 0;
+    DO_CHECKED_OPERATION(writer->AddStream(pMediaTypeOut.get(), &streamIndex));
+
+    if (streams.size() <= streamIndex)
+    {
+        streams.resize(streamIndex + 1, Stream());
+    }
+    return streamIndex;
+}
+
+void MFVideoSink::setInputFormat(uint32_t streamIndex, const VideoCoding::VideoStreamFormat& inputFormat)
+{
+    Stream& stream = getStream(streamIndex);
+
+    IMFWrappers::MediaTypePtr pMediaTypeIn = GetMediaType(VideoCoding::MakeVideoTypeDescriptor(VideoCoding::ProfileUse::StreamInput, inputFormat));
+
+    DO_CHECKED_OPERATION(writer->SetInputMediaType(streamIndex, pMediaTypeIn.get(), NULL));
+
+    SafeRelease(&stream.pool);
+    stream.input = inputFormat;
+    const DWORD frameBytes = static_cast<DWORD>(VideoCoding::FrameBytes(inputFormat.pixelFormat, inputFormat.width, inputFormat.height));
+    DO_CHECKED_OPERATION(CSamplePool::Create(frameBytes, poolCapacity, &stream.pool));
+}
+
+void MFVideoSink::beginWriting()
+{
+    DO_CHECKED_OPERATION(writer->BeginWriting());
+}
+
+VideoCoding::SinkFrame MFVideoSink::acquireFrame(uint32_t streamIndex)
+{
+    VideoCoding::SinkFrame frame = {};
+    ThrowIfFailed(tryAcquireFrame(streamIndex, frame));
+    return frame;
+}
+
+VideoCoding::Status MFVideoSink::tryAcquireFrame(uint32_t streamIndex, VideoCoding::SinkFrame& frame)
+{
+    Stream* stream = findStream(streamIndex);
+    if (stream == nullptr || stream->pool == nullptr)
+    {
+        return MAKE_STATUS(MF_E_INVALIDSTREAMNUMBER);
+    }
+
+    IMFWrappers::SamplePtr pSample;
+    RETURN_IF_FAILED_STATUS(stream->pool->AcquireSample(pSample.receive()));
+
+    VideoCoding::Result<IMFWrappers::MediaBufferPtr> buffer = IMFWrappers::TryGetBufferByIndex(pSample.get(), 0);
+    RETURN_IF_FAILED_STATUS(buffer.getStatus());
+
+    BYTE* data = nullptr;
+    RETURN_IF_FAILED_STATUS(IMFWrappers::TryLockBuffer(buffer.value().get(), &data));
+
+    const VideoCoding::VideoStreamFormat& input = stream->input;
+    VideoCoding::FrameView view = { data, static_cast<ptrdiff_t>(VideoCoding::RowBytes(input.pixelFormat, input.width)), input.width, input.height, input.pixelFormat, 0 };
+    frame.view = view;
+    UINT64 bufferId = 0;
+    if (SUCCEEDED(pSample->GetUINT64(VC_SAMPLE_BUFFER_ID, &bufferId)))
+    {
+        frame.view.bufferId = bufferId;
+    }
+    // The frame keeps the sample reference until writeFrame or discardFrame.
+    frame.handle = pSample.detach();
+    return VideoCoding::Status();
+}
+
+void MFVideoSink::writeFrame(uint32_t streamIndex, VideoCoding::SinkFrame& frame, int64_t timestamp, int64_t duration)
+{
+    ThrowIfFailed(tryWriteFrame(streamIndex, frame, timestamp, duration));
+}
+
+VideoCoding::Status MFVideoSink::tryWriteFrame(uint32_t streamIndex, VideoCoding::SinkFrame& frame, int64_t timestamp, int64_t duration)
+{
+    Stream* stream = findStream(streamIndex);
+    if (stream == nullptr)
+    {
+        // Unlocks the buffer before the sample goes back to its pool.
+        discardFrame(streamIndex, frame);
+        return MAKE_STATUS(MF_E_INVALIDSTREAMNUMBER);
+    }
+
+    IMFWrappers::SamplePtr pSample = IMFWrappers::SamplePtr::adopt(static_cast<IMFSample*>(frame.handle));
+    frame.handle = nullptr;
+
+    {
+        VideoCoding::Result<IMFWrappers::MediaBufferPtr> buffer = IMFWrappers::TryGetBufferByIndex(pSample.get(), 0);
+        RETURN_IF_FAILED_STATUS(buffer.getStatus());
+        const VideoCoding::VideoStreamFormat& input = stream->input;
+        const DWORD frameBytes = static_cast<DWORD>(VideoCoding::FrameBytes(input.pixelFormat, input.width, input.height));
+        RETURN_IF_FAILED_STATUS(IMFWrappers::TryUnlockBuffer(buffer.value().get(), frameBytes));
+    }
+
+    RETURN_IF_FAILED_STATUS(IMFWrappers::TrySetSampleTiming(pSample.get(), timestamp, duration));
+
+    // The sample goes back to the pool once the sink writer is done with it
+    // too and our reference is gone.
+    TRACE_SCOPE("WriteSample", timestamp);
+    return IMFWrappers::TryWriteSample(writer.get(), streamIndex, pSample.get());
+}
+
+void MFVideoSink::discardFrame(uint32_t streamIndex, VideoCoding::SinkFrame& frame)
+{
+    IMFWrappers::SamplePtr pSample = IMFWrappers::SamplePtr::adopt(static_cast<IMFSample*>(frame.handle));
+    frame.handle = nullptr;
+
+    IMFWrappers::MediaBufferPtr pBuffer;
+    if (SUCCEEDED(pSample->GetBufferByIndex(0, pBuffer.receive())))
+    {
+        pBuffer->Unlock();
+    }
+}
+
+uint32_t MFVideoSink::addAudioStream(const VideoCoding::AudioStreamFormat& outputFormat, const VideoCoding::AudioStreamFormat& inputFormat)
+{
+    if (inputFormat.codec != VideoCoding::AudioCodec::PCM)
+    {
+        THROW_WINDOWS_ERROR(MF_E_INVALIDMEDIATYPE);
+    }
+
+    DWORD streamIndex = 0;
+    DO_CHECKED_OPERATION(writer->AddStream(GetMediaType(VideoCoding::MakeAudioTypeDescriptor(VideoCoding::ProfileUse::StreamOutput, outputFormat)).get(), &streamIndex));
+    DO_CHECKED_OPERATION(writer->SetInputMediaType(streamIndex,
+        GetMediaType(VideoCoding::MakeAudioTypeDescriptor(VideoCoding::ProfileUse::StreamInput, inputFormat)).get(), NULL));
+
+    if (streams.size() <= streamIndex)
+    {
+        streams.resize(streamIndex + 1, Stream());
+    }
+    return streamIndex;
+}
+
+void MFVideoSink::writeAudio(uint32_t streamIndex, const void* data, size_t bytes, int64_t timestamp, int64_t duration)
+{
+    if (getStream(streamIndex).pool != nullptr)
+    {
+        THROW_WINDOWS_ERROR(MF_E_INVALIDSTREAMNUMBER);
+    }
+
+    IMFWrappers::MediaBufferPtr pBuffer = IMFWrappers::CreateMemoryBuffer(static_cast<DWORD>(bytes));
+    BYTE* target = nullptr;
+    ThrowIfFailed(IMFWrappers::TryLockBuffer(pBuffer.get(), &target));
+    std::memcpy(target, data, bytes);
+    ThrowIfFailed(IMFWrappers::TryUnlockBuffer(pBuffer.get(), static_cast<DWORD>(bytes)));
+
+    IMFWrappers::SamplePtr pSample = IMFWrappers::CreateSample();
+    IMFWrappers::AddBuffer(pSample.get(), pBuffer.get());
+    IMFWrappers::SetSampleTiming(pSample.get(), timestamp, duration);
+    ThrowIfFailed(IMFWrappers::TryWriteSample(writer.get(), streamIndex, pSample.get()));
+}
+
+void MFVideoSink::finalize()
+{
+    if (!finalized)
+    {
+        finalized = true;
+        DO_CHECKED_OPERATION(writer->Finalize());
+    }
+}
+
+VideoCoding::FramePoolStats MFVideoSink::getPoolStats(uint32_t streamIndex) const
+{
+    return getStream(streamIndex).pool->GetStats();
+}
+
+MFVideoSink::Stream& MFVideoSink::getStream(uint32_t streamIndex)
+{
+    Stream* stream = findStream(streamIndex);
+    if (stream == nullptr)
+    {
+        THROW_WINDOWS_ERROR(MF_E_INVALIDSTREAMNUMBER);
+    }
+    return *stream;
+}
+
+const MFVideoSink::Stream& MFVideoSink::getStream(uint32_t streamIndex) const
+{
+    if (streamIndex >= streams.size())
+    {
+        THROW_WINDOWS_ERROR(MF_E_INVALIDSTREAMNUMBER);
+    }
+    return streams[streamIndex];
+}
+
+MFVideoSink::Stream* MFVideoSink::findStream(uint32_t streamIndex)
+{
+    return streamIndex < streams.size() ? &streams[streamIndex] : nullptr;
+}
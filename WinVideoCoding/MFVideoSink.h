@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "CSamplePool.h"
+#include "IMFObjectWrapper.h"
+#include "VideoSink.h"
+
+// VideoSink backed by IMFSinkWriter. Frames are pooled tracked samples, so
+// acquireFrame() hands out memory that goes to the encoder as is.
+class MFVideoSink : public VideoCoding::VideoSink
+{
+public:
+    // See IMFWrappers::CreateSinkWriter for `byteStream`. A positive
+    // `fragmentDuration` (100 ns units) writes a fragmented MP4 whatever the
+    // URL, with compressed video given a key frame at least that often;
+    // the sink cuts fragments at key frames.
+    MFVideoSink(const std::string& outputURL, size_t poolCapacity, IMFByteStream* byteStream = nullptr, int64_t fragmentDuration = 0);
+    ~MFVideoSink();
+
+    uint32_t addStream(const VideoCoding::VideoStreamFormat& outputFormat) override;
+    void setInputFormat(uint32_t streamIndex, const VideoCoding::VideoStreamFormat& inputFormat) override;
+    void beginWriting() override;
+
+    VideoCoding::SinkFrame acquireFrame(uint32_t streamIndex) override;
+    void writeFrame(uint32_t streamIndex, VideoCoding::SinkFrame& frame, int64_t timestamp, int64_t duration) override;
+    void discardFrame(uint32_t streamIndex, VideoCoding::SinkFrame& frame) override;
+
+    // PCM in, AAC (or PCM) out. Blocks are copied into a fresh media buffer.
+    uint32_t addAudioStream(const VideoCoding::AudioStreamFormat& outputFormat, const VideoCoding::AudioStreamFormat& inputFormat) override;
+    void writeAudio(uint32_t streamIndex, const void* data, size_t bytes, int64_t timestamp, int64_t duration) override;
+
+    void finalize() override;
+
+    VideoCoding::FramePoolStats getPoolStats(uint32_t streamIndex) const;
+
+private:
+    // acquireFrame and writeFrame without the ThrowIfFailed, so a frame that
+    // goes through costs no exception handling or message formatting; only
+    // a failure is turned into a WindowsError, once, at the override.
+    VideoCoding::Status tryAcquireFrame(uint32_t streamIndex, VideoCoding::SinkFrame& frame);
+    VideoCoding::Status tryWriteFrame(uint32_t streamIndex, VideoCoding::SinkFrame& frame, int64_t timestamp, int64_t duration);
+
+    struct Stream
+    {
+        VideoCoding::VideoStreamFormat input;
+        CSamplePool* pool;      // null for audio streams
+    };
+
+    Stream& getStream(uint32_t streamIndex);
+    const Stream& getStream(uint32_t streamIndex) const;
+    Stream* findStream(uint32_t streamIndex);
+
+    IMFWrappers::SinkWriterPtr writer;
+    std::vector<Stream> streams;
+    const size_t poolCapacity;
+    const int64_t fragmentDuration;
+    bool finalized;
+};
@@ -0,0 +1,182 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VideoCoding
+{
+
+    MappedFile::MappedFile(const std::string& path, size_t window, size_t readahead)
+        : fileSize(0), window(window), readahead(readahead), granularity(1), view(nullptr), viewOffset(0), viewLength(0), hintedUpTo(0), stats()
+    {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        granularity = info.dwAllocationGranularity;
+
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("MappedFile: cannot open " + path);
+        }
+        LARGE_INTEGER length;
+        if (!GetFileSizeEx(file, &length))
+        {
+            CloseHandle(file);
+            throw std::runtime_error("MappedFile: cannot size " + path);
+        }
+        fileSize = static_cast<uint64_t>(length.QuadPart);
+        // An empty file can't be mapped, and there is nothing to map anyway.
+        mapping = NULL;
+        if (fileSize > 0)
+        {
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping == NULL)
+            {
+                CloseHandle(file);
+                throw std::runtime_error("MappedFile: cannot map " + path);
+            }
+        }
+#else
+        granularity = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+        file = open(path.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            throw std::runtime_error("MappedFile: cannot open " + path);
+        }
+        struct stat status;
+        if (fstat(file, &status) != 0)
+        {
+            close(file);
+            throw std::runtime_error("MappedFile: cannot size " + path);
+        }
+        fileSize = static_cast<uint64_t>(status.st_size);
+#endif
+    }
+
+    MappedFile::~MappedFile()
+    {
+        unmapWindow();
+#ifdef _WIN32
+        if (mapping != NULL)
+        {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+#else
+        close(file);
+#endif
+    }
+
+    const uint8_t* MappedFile::map(uint64_t offset, size_t length)
+    {
+        if (offset > fileSize || length > fileSize - offset)
+        {
+            throw std::out_of_range("MappedFile: range beyond the end of the file");
+        }
+        if (view == nullptr || offset < viewOffset || offset + length > viewOffset + viewLength)
+        {
+            mapWindow(offset, length);
+        }
+        if (readahead > 0)
+        {
+            hint(offset + length, readahead);
+        }
+        return view + (offset - viewOffset);
+    }
+
+    void MappedFile::mapWindow(uint64_t offset, size_t length)
+    {
+        unmapWindow();
+
+        const uint64_t start = offset / granularity * granularity;
+        const uint64_t needed = offset - start + length;
+        const uint64_t wanted = std::max<uint64_t>(needed, window);
+        viewLength = static_cast<size_t>(std::min<uint64_t>(wanted, fileSize - start));
+        if (viewLength == 0)
+        {
+            // Zero-length request at the very end; any valid pointer will do.
+            static const uint8_t empty = 0;
+            view = const_cast<uint8_t*>(&empty);
+            viewOffset = offset;
+            return;
+        }
+
+#ifdef _WIN32
+        void* p = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32), static_cast<DWORD>(start), viewLength);
+        if (p == NULL)
+        {
+            viewLength = 0;
+            throw std::runtime_error("MappedFile: MapViewOfFile failed");
+        }
+#else
+        void* p = mmap(nullptr, viewLength, PROT_READ, MAP_SHARED, file, static_cast<off_t>(start));
+        if (p == MAP_FAILED)
+        {
+            viewLength = 0;
+            throw std::runtime_error("MappedFile: mmap failed");
+        }
+        madvise(p, viewLength, MADV_SEQUENTIAL);
+#endif
+        view = static_cast<uint8_t*>(p);
+        viewOffset = start;
+        hintedUpTo = start;
+        ++stats.maps;
+        stats.bytesMapped += viewLength;
+    }
+
+    void MappedFile::unmapWindow()
+    {
+        if (view == nullptr || viewLength == 0)
+        {
+            view = nullptr;
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(view);
+#else
+        munmap(view, viewLength);
+#endif
+        view = nullptr;
+        viewLength = 0;
+    }
+
+    // Asks for the pages of [offset, offset + length) within the window to be
+    // read in the background, skipping what an earlier hint already covered.
+    void MappedFile::hint(uint64_t offset, size_t length)
+    {
+        const uint64_t windowEnd = viewOffset + viewLength;
+        const uint64_t begin = std::max<uint64_t>(offset, hintedUpTo) / granularity * granularity;
+        const uint64_t end = std::min<uint64_t>(offset + length, windowEnd);
+        if (end <= begin || end <= hintedUpTo)
+        {
+            return;
+        }
+        void* p = view + (begin - viewOffset);
+        const size_t count = static_cast<size_t>(end - begin);
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range = { p, count };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+        (void)p;
+        (void)count;
+#endif
+#else
+        madvise(p, count, MADV_WILLNEED);
+#endif
+        hintedUpTo = end;
+        ++stats.readaheadHints;
+    }
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace VideoCoding
+{
+
+    const size_t DEFAULT_MAP_WINDOW = 64 << 20;
+
+    struct MappedFileStats
+    {
+        uint64_t maps;              // windows mapped, the first one included
+        uint64_t bytesMapped;       // sum of the window lengths
+        uint64_t readaheadHints;
+    };
+
+    // Read-only view of a file through a window that slides forward as it
+    // is read, so files larger than the address space or RAM can be walked
+    // front to back with bounded mapping. The OS is told the access is
+    // sequential, and each request hints that `readahead` bytes after it
+    // will be needed next.
+    //
+    // Not thread-safe. Throws std::runtime_error when the file can't be
+    // opened or mapped.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& path, size_t window = DEFAULT_MAP_WINDOW, size_t readahead = 0);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        uint64_t size() const { return fileSize; }
+
+        void setReadahead(size_t bytes) { readahead = bytes; }
+
+        // [offset, offset + length) of the file, which must lie within it.
+        // Valid until the next call; moves the window if needed, growing it
+        // for requests longer than the window.
+        const uint8_t* map(uint64_t offset, size_t length);
+
+        MappedFileStats getStats() const { return stats; }
+
+    private:
+        void mapWindow(uint64_t offset, size_t length);
+        void unmapWindow();
+        void hint(uint64_t offset, size_t length);
+
+        uint64_t fileSize;
+        const size_t window;
+        size_t readahead;
+        size_t granularity;         // window starts are multiples of this
+        uint8_t* view;
+        uint64_t viewOffset;
+        size_t viewLength;
+        uint64_t hintedUpTo;        // end of the last readahead hint
+        MappedFileStats stats;
+
+#ifdef _WIN32
+        void* file;
+        void* mapping;
+#else
+        int file;
+#endif
+    };
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstring>
+
+#include "AlignedBuffer.h"
+#include "FrameView.h"
+
+namespace VideoCoding
+{
+
+    // Portable frame buffer with the same lock/unlock shape as the Media
+    // Foundation buffers. It counts every full or partial copy made into it,
+    // which makes it possible to check how many copies a pipeline does.
+    class MemoryFrameBuffer
+    {
+    public:
+        MemoryFrameBuffer(uint32_t width, uint32_t height, PixelFormat format)
+            : width(width), height(height), format(format),
+              stride(static_cast<ptrdiff_t>(RowBytes(format, width))),
+              storage(FrameBytes(format, width, height)),
+              locked(false), lockCount(0), copyCount(0), bytesCopied(0)
+        {
+        }
+
+        MemoryFrameBuffer(MemoryFrameBuffer&&) = default;
+
+        FrameView lockFrame()
+        {
+            locked = true;
+            ++lockCount;
+            return view();
+        }
+
+        void unlockFrame()
+        {
+            locked = false;
+        }
+
+        // Copies a whole frame of the same geometry into this buffer.
+        void copyFrame(const uint8_t* src, ptrdiff_t srcStride)
+        {
+            const size_t rowBytes = RowBytes(format, width);
+            const uint32_t rows = format == PixelFormat::RGB32 ? height : height + height / 2;
+            for (uint32_t y = 0; y < rows; ++y)
+            {
+                std::memcpy(storage.get() + stride * y, src + srcStride * y, rowBytes);
+            }
+            ++copyCount;
+            bytesCopied += rowBytes * rows;
+        }
+
+        FrameView view() const
+        {
+            FrameView v = { storage.get(), stride, width, height, format, storage.getId() };
+            return v;
+        }
+
+        bool isLocked() const { return locked; }
+        size_t getLockCount() const { return lockCount; }
+        size_t getCopyCount() const { return copyCount; }
+        size_t getBytesCopied() const { return bytesCopied; }
+        size_t size() const { return storage.size(); }
+
+    private:
+        uint32_t width;
+        uint32_t height;
+        PixelFormat format;
+        ptrdiff_t stride;
+        AlignedBuffer storage;
+        bool locked;
+        size_t lockCount;
+        size_t copyCount;
+        size_t bytesCopied;
+    };
+
+}
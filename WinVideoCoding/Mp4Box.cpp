@@ -0,0 +1,261 @@
+#include "Mp4Box.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace VideoCoding
+{
+
+    std::string Mp4TypeName(uint32_t type)
+    {
+        std::string name(4, ' ');
+        for (int i = 0; i < 4; ++i)
+        {
+            const char c = static_cast<char>(type >> (24 - 8 * i));
+            name[i] = c >= 0x20 && c < 0x7F ? c : '?';
+        }
+        return name;
+    }
+
+    // ------------------------------------------------------------------------
+
+    const uint8_t* Mp4Reader::need(size_t count)
+    {
+        if (count > limit - position)
+        {
+            throw std::runtime_error("MP4: box truncated");
+        }
+        const uint8_t* p = data + position;
+        position += count;
+        return p;
+    }
+
+    uint8_t Mp4Reader::u8()
+    {
+        return *need(1);
+    }
+
+    uint16_t Mp4Reader::u16()
+    {
+        const uint8_t* p = need(2);
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    uint32_t Mp4Reader::u32()
+    {
+        const uint8_t* p = need(4);
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+    }
+
+    uint64_t Mp4Reader::u64()
+    {
+        const uint64_t high = u32();
+        return (high << 32) | u32();
+    }
+
+    void Mp4Reader::skip(size_t count)
+    {
+        need(count);
+    }
+
+    void Mp4Reader::bytes(void* dst, size_t count)
+    {
+        std::memcpy(dst, need(count), count);
+    }
+
+    // ------------------------------------------------------------------------
+
+    namespace
+    {
+        // Shared by the memory and the stream reader: `header` holds the
+        // first 16 bytes at `offset` (fewer near the end), `end` bounds the
+        // box.
+        Mp4BoxHeader ParseHeader(const uint8_t* header, size_t available, uint64_t offset, uint64_t end)
+        {
+            Mp4Reader reader(header, 0, available);
+            Mp4BoxHeader box;
+            box.offset = offset;
+            box.size = reader.u32();
+            box.type = reader.u32();
+            box.headerSize = 8;
+            if (box.size == 1)
+            {
+                box.size = reader.u64();
+                box.headerSize = 16;
+            }
+            else if (box.size == 0)
+            {
+                box.size = end - offset;
+            }
+            if (box.size < box.headerSize || box.size > end - offset)
+            {
+                throw std::runtime_error("MP4: bad size of box '" + Mp4TypeName(box.type) + "'");
+            }
+            return box;
+        }
+    }
+
+    Mp4BoxHeader ReadMp4BoxHeader(const uint8_t* data, size_t offset, size_t end)
+    {
+        if (offset >= end)
+        {
+            throw std::runtime_error("MP4: box truncated");
+        }
+        const size_t available = end - offset < 16 ? end - offset : 16;
+        return ParseHeader(data + offset, available, offset, end);
+    }
+
+    std::vector<Mp4BoxHeader> ReadMp4Boxes(const uint8_t* data, size_t begin, size_t end)
+    {
+        std::vector<Mp4BoxHeader> boxes;
+        size_t offset = begin;
+        while (offset < end)
+        {
+            boxes.push_back(ReadMp4BoxHeader(data, offset, end));
+            offset = static_cast<size_t>(boxes.back().end());
+        }
+        return boxes;
+    }
+
+    bool FindMp4Box(const uint8_t* data, size_t begin, size_t end, uint32_t type, Mp4BoxHeader& box)
+    {
+        size_t offset = begin;
+        while (offset < end)
+        {
+            box = ReadMp4BoxHeader(data, offset, end);
+            if (box.type == type)
+            {
+                return true;
+            }
+            offset = static_cast<size_t>(box.end());
+        }
+        return false;
+    }
+
+    Mp4BoxHeader RequireMp4Box(const uint8_t* data, size_t begin, size_t end, uint32_t type)
+    {
+        Mp4BoxHeader box;
+        if (!FindMp4Box(data, begin, end, type, box))
+        {
+            throw std::runtime_error("MP4: missing box '" + Mp4TypeName(type) + "'");
+        }
+        return box;
+    }
+
+    std::vector<Mp4BoxHeader> ReadMp4TopLevelBoxes(std::istream& in)
+    {
+        in.clear();
+        in.seekg(0, std::ios::end);
+        const std::streamoff length = in.tellg();
+        if (length < 0)
+        {
+            throw std::runtime_error("MP4: input is not seekable");
+        }
+        const uint64_t end = static_cast<uint64_t>(length);
+
+        std::vector<Mp4BoxHeader> boxes;
+        uint64_t offset = 0;
+        while (offset < end)
+        {
+            uint8_t header[16];
+            const size_t available = end - offset < sizeof(header) ? static_cast<size_t>(end - offset) : sizeof(header);
+            in.seekg(static_cast<std::streamoff>(offset));
+            if (!in.read(reinterpret_cast<char*>(header), available))
+            {
+                throw std::runtime_error("MP4: read failed");
+            }
+            boxes.push_back(ParseHeader(header, available, offset, end));
+            offset = boxes.back().end();
+        }
+        return boxes;
+    }
+
+    std::vector<uint8_t> LoadMp4Box(std::istream& in, const Mp4BoxHeader& box)
+    {
+        std::vector<uint8_t> data(static_cast<size_t>(box.size));
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(box.offset));
+        if (!in.read(reinterpret_cast<char*>(data.data()), data.size()))
+        {
+            throw std::runtime_error("MP4: read failed");
+        }
+        return data;
+    }
+
+    // ------------------------------------------------------------------------
+
+    void Mp4BoxWriter::beginBox(uint32_t type)
+    {
+        open.push_back(buffer.size());
+        u32(0);
+        u32(type);
+    }
+
+    void Mp4BoxWriter::beginFullBox(uint32_t type, uint8_t version, uint32_t flags)
+    {
+        beginBox(type);
+        u8(version);
+        u24(flags);
+    }
+
+    void Mp4BoxWriter::endBox()
+    {
+        if (open.empty())
+        {
+            throw std::logic_error("Mp4BoxWriter: endBox without beginBox");
+        }
+        const size_t start = open.back();
+        open.pop_back();
+        const size_t size = buffer.size() - start;
+        if (size > UINT32_MAX)
+        {
+            throw std::runtime_error("MP4: box too large");
+        }
+        patchU32(start, static_cast<uint32_t>(size));
+    }
+
+    void Mp4BoxWriter::u16(uint16_t value)
+    {
+        u8(static_cast<uint8_t>(value >> 8));
+        u8(static_cast<uint8_t>(value));
+    }
+
+    void Mp4BoxWriter::u24(uint32_t value)
+    {
+        u8(static_cast<uint8_t>(value >> 16));
+        u16(static_cast<uint16_t>(value));
+    }
+
+    void Mp4BoxWriter::u32(uint32_t value)
+    {
+        u16(static_cast<uint16_t>(value >> 16));
+        u16(static_cast<uint16_t>(value));
+    }
+
+    void Mp4BoxWriter::u64(uint64_t value)
+    {
+        u32(static_cast<uint32_t>(value >> 32));
+        u32(static_cast<uint32_t>(value));
+    }
+
+    void Mp4BoxWriter::bytes(const void* src, size_t count)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(src);
+        buffer.insert(buffer.end(), p, p + count);
+    }
+
+    void Mp4BoxWriter::patchU32(size_t position, uint32_t value)
+    {
+        buffer[position] = static_cast<uint8_t>(value >> 24);
+        buffer[position + 1] = static_cast<uint8_t>(value >> 16);
+        buffer[position + 2] = static_cast<uint8_t>(value >> 8);
+        buffer[position + 3] = static_cast<uint8_t>(value);
+    }
+
+    void Mp4BoxWriter::clear()
+    {
+        buffer.clear();
+        open.clear();
+    }
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace VideoCoding
+{
+
+    // ISO base media file format (MP4) boxes. Everything is big-endian;
+    // malformed input throws std::runtime_error.
+
+    inline uint32_t Mp4Type(const char (&name)[5])
+    {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(name[0])) << 24) | (static_cast<uint32_t>(static_cast<uint8_t>(name[1])) << 16) |
+            (static_cast<uint32_t>(static_cast<uint8_t>(name[2])) << 8) | static_cast<uint32_t>(static_cast<uint8_t>(name[3]));
+    }
+
+    std::string Mp4TypeName(uint32_t type);
+
+    struct Mp4BoxHeader
+    {
+        uint32_t type;
+        uint64_t offset;        // of the size field
+        uint32_t headerSize;    // 8, or 16 with a 64-bit size
+        uint64_t size;          // including the header
+
+        uint64_t payload() const { return offset + headerSize; }
+        uint64_t payloadSize() const { return size - headerSize; }
+        uint64_t end() const { return offset + size; }
+    };
+
+    // Bounds-checked big-endian cursor over [begin, end) of a buffer.
+    class Mp4Reader
+    {
+    public:
+        Mp4Reader(const uint8_t* data, size_t begin, size_t end) : data(data), position(begin), limit(end) {}
+
+        uint8_t u8();
+        uint16_t u16();
+        uint32_t u32();
+        uint64_t u64();
+        void skip(size_t count);
+        void bytes(void* dst, size_t count);
+
+        size_t tell() const { return position; }
+        size_t remaining() const { return limit - position; }
+
+    private:
+        const uint8_t* need(size_t count);
+
+        const uint8_t* data;
+        size_t position;
+        size_t limit;
+    };
+
+    // Header of the box at `offset`, which must lie within [offset, end).
+    // A size of 0 means "to the end".
+    Mp4BoxHeader ReadMp4BoxHeader(const uint8_t* data, size_t offset, size_t end);
+
+    // The boxes directly inside [begin, end), in file order.
+    std::vector<Mp4BoxHeader> ReadMp4Boxes(const uint8_t* data, size_t begin, size_t end);
+
+    // First child of that type, false if there is none.
+    bool FindMp4Box(const uint8_t* data, size_t begin, size_t end, uint32_t type, Mp4BoxHeader& box);
+
+    // Same as above for a child that must exist.
+    Mp4BoxHeader RequireMp4Box(const uint8_t* data, size_t begin, size_t end, uint32_t type);
+
+    // Top-level boxes of a file, read header by header without loading the
+    // payloads. Leaves the stream position undefined.
+    std::vector<Mp4BoxHeader> ReadMp4TopLevelBoxes(std::istream& in);
+
+    // The whole box, header included, loaded into memory.
+    std::vector<uint8_t> LoadMp4Box(std::istream& in, const Mp4BoxHeader& box);
+
+    // Appends boxes to a growing buffer. beginBox/endBox nest; endBox fills in
+    // the 32-bit size of the innermost open box.
+    class Mp4BoxWriter
+    {
+    public:
+        void beginBox(uint32_t type);
+        void beginFullBox(uint32_t type, uint8_t version, uint32_t flags);
+        void endBox();
+
+        void u8(uint8_t value) { buffer.push_back(value); }
+        void u16(uint16_t value);
+        void u24(uint32_t value);
+        void u32(uint32_t value);
+        void u64(uint64_t value);
+        void zeros(size_t count) { buffer.insert(buffer.end(), count, 0); }
+        void bytes(const void* src, size_t count);
+        void bytes(const std::vector<uint8_t>& src) { bytes(src.data(), src.size()); }
+
+        // Overwrites 4 bytes written earlier, for fields known only later.
+        void patchU32(size_t position, uint32_t value);
+
+        size_t size() const { return buffer.size(); }
+        const std::vector<uint8_t>& data() const { return buffer; }
+        void clear();
+
+    private:
+        std::vector<uint8_t> buffer;
+        std::vector<size_t> open;
+    };
+
+}
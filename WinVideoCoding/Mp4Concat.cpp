@@ -0,0 +1,933 @@
+#include "Mp4Concat.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "Mp4Box.h"
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        const int64_t TICKS_PER_SECOND = 10000000;
+        const size_t COPY_BLOCK = 1 << 20;
+
+        // value * to / from, rounded down. Exact as long as both scales fit in
+        // 32 bits.
+        uint64_t Rescale(uint64_t value, uint64_t to, uint64_t from)
+        {
+            return value / from * to + value % from * to / from;
+        }
+
+        uint64_t RescaleUp(uint64_t value, uint64_t to, uint64_t from)
+        {
+            const uint64_t down = Rescale(value, to, from);
+            return Rescale(down, from, to) < value ? down + 1 : down;
+        }
+
+        std::vector<uint8_t> CopyBox(const std::vector<uint8_t>& data, const Mp4BoxHeader& box)
+        {
+            return std::vector<uint8_t>(data.begin() + static_cast<size_t>(box.offset), data.begin() + static_cast<size_t>(box.end()));
+        }
+
+        // Cursor over a full box's payload, past version and flags.
+        Mp4Reader FullBoxReader(const std::vector<uint8_t>& data, const Mp4BoxHeader& box, uint8_t& version)
+        {
+            Mp4Reader reader(data.data(), static_cast<size_t>(box.payload()), static_cast<size_t>(box.end()));
+            version = reader.u8();
+            reader.skip(3);
+            return reader;
+        }
+
+        uint32_t ReadEntryCount(Mp4Reader& reader, size_t entryBytes)
+        {
+            const uint32_t count = reader.u32();
+            if (count > reader.remaining() / entryBytes)
+            {
+                throw std::runtime_error("MP4: table larger than its box");
+            }
+            return count;
+        }
+
+        void ReadSampleTable(const std::vector<uint8_t>& data, const Mp4BoxHeader& stbl, Mp4Track& track)
+        {
+            const uint8_t* p = data.data();
+            const size_t begin = static_cast<size_t>(stbl.payload());
+            const size_t end = static_cast<size_t>(stbl.end());
+            uint8_t version = 0;
+
+            const Mp4BoxHeader stsd = RequireMp4Box(p, begin, end, Mp4Type("stsd"));
+            {
+                Mp4Reader reader = FullBoxReader(data, stsd, version);
+                if (reader.u32() != 1)
+                {
+                    throw std::runtime_error("MP4: only one sample description per track is supported");
+                }
+            }
+            track.sampleDescription = CopyBox(data, stsd);
+
+            Mp4BoxHeader box;
+            if (FindMp4Box(p, begin, end, Mp4Type("stz2"), box))
+            {
+                throw std::runtime_error("MP4: compact sample sizes are not supported");
+            }
+            {
+                Mp4Reader reader = FullBoxReader(data, RequireMp4Box(p, begin, end, Mp4Type("stsz")), version);
+                const uint32_t size = reader.u32();
+                const uint32_t count = reader.u32();
+                if (size == 0 && count > reader.remaining() / 4)
+                {
+                    throw std::runtime_error("MP4: table larger than its box");
+                }
+                track.samples.assign(count, Mp4Sample{ size, 0, 0, true });
+                for (uint32_t i = 0; size == 0 && i < count; ++i)
+                {
+                    track.samples[i].size = reader.u32();
+                }
+            }
+            const size_t sampleCount = track.samples.size();
+
+            {
+                Mp4Reader reader = FullBoxReader(data, RequireMp4Box(p, begin, end, Mp4Type("stts")), version);
+                const uint32_t entries = ReadEntryCount(reader, 8);
+                size_t sample = 0;
+                for (uint32_t i = 0; i < entries; ++i)
+                {
+                    const uint32_t count = reader.u32();
+                    const uint32_t delta = reader.u32();
+                    if (count > sampleCount - sample)
+                    {
+                        throw std::runtime_error("MP4: stts covers more samples than stsz");
+                    }
+                    for (uint32_t j = 0; j < count; ++j)
+                    {
+                        track.samples[sample++].duration = delta;
+                    }
+                }
+                if (sample != sampleCount)
+                {
+                    throw std::runtime_error("MP4: stts covers fewer samples than stsz");
+                }
+            }
+
+            if (FindMp4Box(p, begin, end, Mp4Type("ctts"), box))
+            {
+                // Version 0 offsets are unsigned but never meant to exceed
+                // 2^31, so both versions read the same way.
+                Mp4Reader reader = FullBoxReader(data, box, version);
+                const uint32_t entries = ReadEntryCount(reader, 8);
+                size_t sample = 0;
+                for (uint32_t i = 0; i < entries; ++i)
+                {
+                    const uint32_t count = reader.u32();
+                    const int32_t offset = static_cast<int32_t>(reader.u32());
+                    if (count > sampleCount - sample)
+                    {
+                        throw std::runtime_error("MP4: ctts covers more samples than stsz");
+                    }
+                    for (uint32_t j = 0; j < count; ++j)
+                    {
+                        track.samples[sample++].compositionOffset = offset;
+                    }
+                }
+            }
+
+            if (FindMp4Box(p, begin, end, Mp4Type("stss"), box))
+            {
+                Mp4Reader reader = FullBoxReader(data, box, version);
+                const uint32_t entries = ReadEntryCount(reader, 4);
+                for (Mp4Sample& sample : track.samples)
+                {
+                    sample.sync = false;
+                }
+                for (uint32_t i = 0; i < entries; ++i)
+                {
+                    const uint32_t number = reader.u32();
+                    if (number == 0 || number > sampleCount)
+                    {
+                        throw std::runtime_error("MP4: stss names a sample that does not exist");
+                    }
+                    track.samples[number - 1].sync = true;
+                }
+            }
+
+            std::vector<uint64_t> offsets;
+            if (FindMp4Box(p, begin, end, Mp4Type("co64"), box))
+            {
+                Mp4Reader reader = FullBoxReader(data, box, version);
+                offsets.resize(ReadEntryCount(reader, 8));
+                for (uint64_t& offset : offsets)
+                {
+                    offset = reader.u64();
+                }
+            }
+            else
+            {
+                Mp4Reader reader = FullBoxReader(data, RequireMp4Box(p, begin, end, Mp4Type("stco")), version);
+                offsets.resize(ReadEntryCount(reader, 4));
+                for (uint64_t& offset : offsets)
+                {
+                    offset = reader.u32();
+                }
+            }
+
+            // stsc runs: chunks from firstChunk up to the next run's first
+            // chunk hold samplesPerChunk samples each.
+            Mp4Reader reader = FullBoxReader(data, RequireMp4Box(p, begin, end, Mp4Type("stsc")), version);
+            const uint32_t entries = ReadEntryCount(reader, 12);
+            std::vector<uint32_t> firstChunks(entries);
+            std::vector<uint32_t> perChunk(entries);
+            for (uint32_t i = 0; i < entries; ++i)
+            {
+                firstChunks[i] = reader.u32();
+                perChunk[i] = reader.u32();
+                reader.skip(4);
+                if (firstChunks[i] == 0 || (i > 0 && firstChunks[i] <= firstChunks[i - 1]))
+                {
+                    throw std::runtime_error("MP4: stsc runs out of order");
+                }
+            }
+
+            size_t sample = 0;
+            for (size_t chunk = 0; chunk < offsets.size(); ++chunk)
+            {
+                const auto run = std::upper_bound(firstChunks.begin(), firstChunks.end(), static_cast<uint32_t>(chunk + 1));
+                if (run == firstChunks.begin())
+                {
+                    throw std::runtime_error("MP4: stsc does not start at the first chunk");
+                }
+                const uint32_t count = perChunk[run - firstChunks.begin() - 1];
+                if (count > sampleCount - sample)
+                {
+                    throw std::runtime_error("MP4: chunks hold more samples than stsz");
+                }
+                track.chunks.push_back(Mp4Chunk{ offsets[chunk], static_cast<uint32_t>(sample), count });
+                sample += count;
+            }
+            if (sample != sampleCount)
+            {
+                throw std::runtime_error("MP4: chunks hold fewer samples than stsz");
+            }
+        }
+
+        Mp4Track ReadTrack(const std::vector<uint8_t>& data, const Mp4BoxHeader& trak)
+        {
+            const uint8_t* p = data.data();
+            const size_t begin = static_cast<size_t>(trak.payload());
+            const size_t end = static_cast<size_t>(trak.end());
+            uint8_t version = 0;
+
+            Mp4Track track = Mp4Track();
+            {
+                Mp4Reader reader = FullBoxReader(data, RequireMp4Box(p, begin, end, Mp4Type("tkhd")), version);
+                reader.skip(version == 1 ? 16 : 8);
+                track.trackId = reader.u32();
+                reader.skip(version == 1 ? 12 : 8);
+                reader.skip(8);
+                track.layer = static_cast<int16_t>(reader.u16());
+                track.alternateGroup = static_cast<int16_t>(reader.u16());
+                track.volume = reader.u16();
+                reader.skip(2);
+                reader.bytes(track.matrix, sizeof(track.matrix));
+                track.width = reader.u32();
+                track.height = reader.u32();
+            }
+
+            track.mediaTime = -1;
+            Mp4BoxHeader edts;
+            Mp4BoxHeader elst;
+            if (FindMp4Box(p, begin, end, Mp4Type("edts"), edts) &&
+                FindMp4Box(p, static_cast<size_t>(edts.payload()), static_cast<size_t>(edts.end()), Mp4Type("elst"), elst))
+            {
+                // Leading empty edits are dropped, the first real one kept.
+                Mp4Reader reader = FullBoxReader(data, elst, version);
+                const uint32_t entries = ReadEntryCount(reader, version == 1 ? 20 : 12);
+                for (uint32_t i = 0; i < entries && track.mediaTime < 0; ++i)
+                {
+                    reader.skip(version == 1 ? 8 : 4);
+                    track.mediaTime = version == 1 ? static_cast<int64_t>(reader.u64()) : static_cast<int32_t>(reader.u32());
+                    reader.skip(4);
+                }
+            }
+
+            const Mp4BoxHeader mdia = RequireMp4Box(p, begin, end, Mp4Type("mdia"));
+            const size_t mdiaBegin = static_cast<size_t>(mdia.payload());
+            const size_t mdiaEnd = static_cast<size_t>(mdia.end());
+            {
+                Mp4Reader reader = FullBoxReader(data, RequireMp4Box(p, mdiaBegin, mdiaEnd, Mp4Type("mdhd")), version);
+                reader.skip(version == 1 ? 16 : 8);
+                track.timescale = reader.u32();
+                reader.skip(version == 1 ? 8 : 4);
+                track.language = reader.u16();
+                if (track.timescale == 0)
+                {
+                    throw std::runtime_error("MP4: track without a timescale");
+                }
+            }
+            {
+                const Mp4BoxHeader hdlr = RequireMp4Box(p, mdiaBegin, mdiaEnd, Mp4Type("hdlr"));
+                Mp4Reader reader = FullBoxReader(data, hdlr, version);
+                reader.skip(4);
+                track.handler = reader.u32();
+                track.handlerBox = CopyBox(data, hdlr);
+            }
+
+            const Mp4BoxHeader minf = RequireMp4Box(p, mdiaBegin, mdiaEnd, Mp4Type("minf"));
+            for (const Mp4BoxHeader& box : ReadMp4Boxes(p, static_cast<size_t>(minf.payload()), static_cast<size_t>(minf.end())))
+            {
+                if (box.type == Mp4Type("vmhd") || box.type == Mp4Type("smhd") || box.type == Mp4Type("hmhd") ||
+                    box.type == Mp4Type("nmhd") || box.type == Mp4Type("sthd"))
+                {
+                    track.mediaHeaderBox = CopyBox(data, box);
+                }
+                else if (box.type == Mp4Type("dinf"))
+                {
+                    track.dataInformationBox = CopyBox(data, box);
+                }
+                else if (box.type == Mp4Type("stbl"))
+                {
+                    ReadSampleTable(data, box, track);
+                }
+            }
+            if (track.dataInformationBox.empty())
+            {
+                throw std::runtime_error("MP4: missing box 'dinf'");
+            }
+            if (track.sampleDescription.empty())
+            {
+                throw std::runtime_error("MP4: missing box 'stbl'");
+            }
+            return track;
+        }
+
+        // ------------------------------------------------------------------------
+
+        void WriteTimeToSample(Mp4BoxWriter& writer, const Mp4Track& track)
+        {
+            writer.beginFullBox(Mp4Type("stts"), 0, 0);
+            const size_t countAt = writer.size();
+            writer.u32(0);
+            uint32_t entries = 0;
+            for (size_t i = 0; i < track.samples.size();)
+            {
+                size_t j = i + 1;
+                while (j < track.samples.size() && track.samples[j].duration == track.samples[i].duration)
+                {
+                    ++j;
+                }
+                writer.u32(static_cast<uint32_t>(j - i));
+                writer.u32(track.samples[i].duration);
+                ++entries;
+                i = j;
+            }
+            writer.patchU32(countAt, entries);
+            writer.endBox();
+        }
+
+        void WriteCompositionOffsets(Mp4BoxWriter& writer, const Mp4Track& track)
+        {
+            bool any = false;
+            bool negative = false;
+            for (const Mp4Sample& sample : track.samples)
+            {
+                any = any || sample.compositionOffset != 0;
+                negative = negative || sample.compositionOffset < 0;
+            }
+            if (!any)
+            {
+                return;
+            }
+
+            writer.beginFullBox(Mp4Type("ctts"), negative ? 1 : 0, 0);
+            const size_t countAt = writer.size();
+            writer.u32(0);
+            uint32_t entries = 0;
+            for (size_t i = 0; i < track.samples.size();)
+            {
+                size_t j = i + 1;
+                while (j < track.samples.size() && track.samples[j].compositionOffset == track.samples[i].compositionOffset)
+                {
+                    ++j;
+                }
+                writer.u32(static_cast<uint32_t>(j - i));
+                writer.u32(static_cast<uint32_t>(track.samples[i].compositionOffset));
+                ++entries;
+                i = j;
+            }
+            writer.patchU32(countAt, entries);
+            writer.endBox();
+        }
+
+        void WriteSyncSamples(Mp4BoxWriter& writer, const Mp4Track& track)
+        {
+            uint32_t sync = 0;
+            for (const Mp4Sample& sample : track.samples)
+            {
+                sync += sample.sync ? 1 : 0;
+            }
+            if (sync == track.samples.size())
+            {
+                return;
+            }
+
+            writer.beginFullBox(Mp4Type("stss"), 0, 0);
+            writer.u32(sync);
+            for (size_t i = 0; i < track.samples.size(); ++i)
+            {
+                if (track.samples[i].sync)
+                {
+                    writer.u32(static_cast<uint32_t>(i + 1));
+                }
+            }
+            writer.endBox();
+        }
+
+        void WriteSampleToChunk(Mp4BoxWriter& writer, const Mp4Track& track)
+        {
+            writer.beginFullBox(Mp4Type("stsc"), 0, 0);
+            const size_t countAt = writer.size();
+            writer.u32(0);
+            uint32_t entries = 0;
+            for (size_t i = 0; i < track.chunks.size(); ++i)
+            {
+                if (i == 0 || track.chunks[i].sampleCount != track.chunks[i - 1].sampleCount)
+                {
+                    writer.u32(static_cast<uint32_t>(i + 1));
+                    writer.u32(track.chunks[i].sampleCount);
+                    writer.u32(1);
+                    ++entries;
+                }
+            }
+            writer.patchU32(countAt, entries);
+            writer.endBox();
+        }
+
+        void WriteSampleSizes(Mp4BoxWriter& writer, const Mp4Track& track)
+        {
+            bool constant = !track.samples.empty();
+            for (const Mp4Sample& sample : track.samples)
+            {
+                constant = constant && sample.size == track.samples[0].size;
+            }
+
+            writer.beginFullBox(Mp4Type("stsz"), 0, 0);
+            writer.u32(constant ? track.samples[0].size : 0);
+            writer.u32(static_cast<uint32_t>(track.samples.size()));
+            for (size_t i = 0; !constant && i < track.samples.size(); ++i)
+            {
+                writer.u32(track.samples[i].size);
+            }
+            writer.endBox();
+        }
+
+        void WriteChunkOffsets(Mp4BoxWriter& writer, const Mp4Track& track, uint64_t base)
+        {
+            bool wide = false;
+            for (const Mp4Chunk& chunk : track.chunks)
+            {
+                wide = wide || base + chunk.offset > UINT32_MAX;
+            }
+
+            writer.beginFullBox(wide ? Mp4Type("co64") : Mp4Type("stco"), 0, 0);
+            writer.u32(static_cast<uint32_t>(track.chunks.size()));
+            for (const Mp4Chunk& chunk : track.chunks)
+            {
+                if (wide)
+                {
+                    writer.u64(base + chunk.offset);
+                }
+                else
+                {
+                    writer.u32(static_cast<uint32_t>(base + chunk.offset));
+                }
+            }
+            writer.endBox();
+        }
+
+        // Times of mvhd, tkhd and mdhd: creation and modification are left 0.
+        void WriteHeaderTimes(Mp4BoxWriter& writer, bool wide, uint64_t duration, const uint32_t* timescale, const uint32_t* trackId)
+        {
+            if (wide)
+            {
+                writer.u64(0);
+                writer.u64(0);
+            }
+            else
+            {
+                writer.u32(0);
+                writer.u32(0);
+            }
+            if (timescale != nullptr)
+            {
+                writer.u32(*timescale);
+            }
+            if (trackId != nullptr)
+            {
+                writer.u32(*trackId);
+                writer.u32(0);
+            }
+            if (wide)
+            {
+                writer.u64(duration);
+            }
+            else
+            {
+                writer.u32(static_cast<uint32_t>(duration));
+            }
+        }
+
+        void WriteTrack(Mp4BoxWriter& writer, const Mp4Movie& movie, const Mp4Track& track, uint64_t base)
+        {
+            const uint64_t mediaDuration = track.duration();
+            const uint64_t trackDuration = Rescale(mediaDuration, movie.timescale, track.timescale);
+
+            writer.beginBox(Mp4Type("trak"));
+
+            const bool wideTrack = trackDuration > UINT32_MAX;
+            writer.beginFullBox(Mp4Type("tkhd"), wideTrack ? 1 : 0, 0x000003);
+            WriteHeaderTimes(writer, wideTrack, trackDuration, nullptr, &track.trackId);
+            writer.zeros(8);
+            writer.u16(static_cast<uint16_t>(track.layer));
+            writer.u16(static_cast<uint16_t>(track.alternateGroup));
+            writer.u16(track.volume);
+            writer.zeros(2);
+            writer.bytes(track.matrix, sizeof(track.matrix));
+            writer.u32(track.width);
+            writer.u32(track.height);
+            writer.endBox();
+
+            if (track.mediaTime >= 0)
+            {
+                const uint64_t start = static_cast<uint64_t>(track.mediaTime);
+                const uint64_t edited = Rescale(mediaDuration > start ? mediaDuration - start : 0, movie.timescale, track.timescale);
+                const bool wideEdit = edited > UINT32_MAX || start > INT32_MAX;
+                writer.beginBox(Mp4Type("edts"));
+                writer.beginFullBox(Mp4Type("elst"), wideEdit ? 1 : 0, 0);
+                writer.u32(1);
+                if (wideEdit)
+                {
+                    writer.u64(edited);
+                    writer.u64(start);
+                }
+                else
+                {
+                    writer.u32(static_cast<uint32_t>(edited));
+                    writer.u32(static_cast<uint32_t>(start));
+                }
+                writer.u16(1);
+                writer.u16(0);
+                writer.endBox();
+                writer.endBox();
+            }
+
+            writer.beginBox(Mp4Type("mdia"));
+            const bool wideMedia = mediaDuration > UINT32_MAX;
+            writer.beginFullBox(Mp4Type("mdhd"), wideMedia ? 1 : 0, 0);
+            WriteHeaderTimes(writer, wideMedia, mediaDuration, &track.timescale, nullptr);
+            writer.u16(track.language);
+            writer.u16(0);
+            writer.endBox();
+            writer.bytes(track.handlerBox);
+
+            writer.beginBox(Mp4Type("minf"));
+            writer.bytes(track.mediaHeaderBox);
+            writer.bytes(track.dataInformationBox);
+            writer.beginBox(Mp4Type("stbl"));
+            writer.bytes(track.sampleDescription);
+            WriteTimeToSample(writer, track);
+            WriteCompositionOffsets(writer, track);
+            WriteSyncSamples(writer, track);
+            WriteSampleToChunk(writer, track);
+            WriteSampleSizes(writer, track);
+            WriteChunkOffsets(writer, track, base);
+            writer.endBox();
+            writer.endBox();
+            writer.endBox();
+
+            writer.endBox();
+        }
+
+        // moov of the movie; a fragmented movie also declares every track in
+        // mvex, with no defaults, so each fragment carries all its values.
+        void WriteMovie(Mp4BoxWriter& writer, const Mp4Movie& movie, uint64_t chunkOffsetBase, bool fragmented)
+        {
+            writer.beginBox(Mp4Type("moov"));
+            const uint64_t duration = movie.duration();
+            const bool wide = duration > UINT32_MAX;
+            uint32_t nextTrackId = 1;
+            for (const Mp4Track& track : movie.tracks)
+            {
+                nextTrackId = std::max(nextTrackId, track.trackId + 1);
+            }
+
+            writer.beginFullBox(Mp4Type("mvhd"), wide ? 1 : 0, 0);
+            WriteHeaderTimes(writer, wide, duration, &movie.timescale, nullptr);
+            writer.u32(movie.rate);
+            writer.u16(movie.volume);
+            writer.zeros(10);
+            writer.bytes(movie.matrix, sizeof(movie.matrix));
+            writer.zeros(24);
+            writer.u32(nextTrackId);
+            writer.endBox();
+
+            for (const Mp4Track& track : movie.tracks)
+            {
+                WriteTrack(writer, movie, track, chunkOffsetBase);
+            }
+
+            if (fragmented)
+            {
+                writer.beginBox(Mp4Type("mvex"));
+                for (const Mp4Track& track : movie.tracks)
+                {
+                    writer.beginFullBox(Mp4Type("trex"), 0, 0);
+                    writer.u32(track.trackId);
+                    writer.u32(1);
+                    writer.zeros(12);
+                    writer.endBox();
+                }
+                writer.endBox();
+            }
+            writer.endBox();
+        }
+
+        std::string SegmentError(size_t segment, size_t track, const char* what)
+        {
+            std::ostringstream message;
+            message << "MP4 concat: segment " << segment << " track " << track << ": " << what;
+            return message.str();
+        }
+    }
+
+    uint64_t Mp4Track::duration() const
+    {
+        uint64_t total = 0;
+        for (const Mp4Sample& sample : samples)
+        {
+            total += sample.duration;
+        }
+        return total;
+    }
+
+    uint64_t Mp4Track::chunkBytes(const Mp4Chunk& chunk) const
+    {
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < chunk.sampleCount; ++i)
+        {
+            total += samples[chunk.firstSample + i].size;
+        }
+        return total;
+    }
+
+    uint64_t Mp4Movie::duration() const
+    {
+        uint64_t longest = 0;
+        for (const Mp4Track& track : tracks)
+        {
+            longest = std::max(longest, Rescale(track.duration(), timescale, track.timescale));
+        }
+        return longest;
+    }
+
+    Mp4Movie ReadMp4Movie(std::istream& in)
+    {
+        Mp4Movie movie = Mp4Movie();
+        std::vector<uint8_t> moov;
+        for (const Mp4BoxHeader& box : ReadMp4TopLevelBoxes(in))
+        {
+            if (box.type == Mp4Type("ftyp"))
+            {
+                movie.fileTypeBox = LoadMp4Box(in, box);
+            }
+            else if (box.type == Mp4Type("moov"))
+            {
+                moov = LoadMp4Box(in, box);
+            }
+            else if (box.type == Mp4Type("moof"))
+            {
+                throw std::runtime_error("MP4: fragmented files are not supported");
+            }
+        }
+        if (moov.empty())
+        {
+            throw std::runtime_error("MP4: missing box 'moov'");
+        }
+
+        const uint8_t* p = moov.data();
+        const Mp4BoxHeader root = ReadMp4BoxHeader(p, 0, moov.size());
+        const size_t begin = static_cast<size_t>(root.payload());
+        uint8_t version = 0;
+        {
+            Mp4Reader reader = FullBoxReader(moov, RequireMp4Box(p, begin, moov.size(), Mp4Type("mvhd")), version);
+            reader.skip(version == 1 ? 16 : 8);
+            movie.timescale = reader.u32();
+            reader.skip(version == 1 ? 8 : 4);
+            movie.rate = reader.u32();
+            movie.volume = reader.u16();
+            reader.skip(10);
+            reader.bytes(movie.matrix, sizeof(movie.matrix));
+            if (movie.timescale == 0)
+            {
+                throw std::runtime_error("MP4: movie without a timescale");
+            }
+        }
+
+        for (const Mp4BoxHeader& box : ReadMp4Boxes(p, begin, moov.size()))
+        {
+            if (box.type == Mp4Type("trak"))
+            {
+                movie.tracks.push_back(ReadTrack(moov, box));
+            }
+        }
+        return movie;
+    }
+
+    std::vector<uint8_t> WriteMp4MovieHeader(const Mp4Movie& movie, uint64_t chunkOffsetBase)
+    {
+        Mp4BoxWriter writer;
+        writer.bytes(movie.fileTypeBox);
+        WriteMovie(writer, movie, chunkOffsetBase, false);
+        return writer.data();
+    }
+
+    std::vector<uint8_t> WriteMp4InitSegment(const Mp4Movie& movie)
+    {
+        Mp4BoxWriter writer;
+        writer.beginBox(Mp4Type("ftyp"));
+        writer.u32(Mp4Type("iso6"));
+        writer.u32(0);
+        writer.u32(Mp4Type("iso6"));
+        writer.u32(Mp4Type("isom"));
+        writer.u32(Mp4Type("mp41"));
+        writer.endBox();
+
+        Mp4Movie empty = movie;
+        for (Mp4Track& track : empty.tracks)
+        {
+            track.samples.clear();
+            track.chunks.clear();
+        }
+        WriteMovie(writer, empty, 0, true);
+        return writer.data();
+    }
+
+    Mp4ConcatPlan PlanMp4Concat(const std::vector<Mp4Movie>& segments)
+    {
+        if (segments.empty())
+        {
+            throw std::invalid_argument("MP4 concat: no segments");
+        }
+
+        Mp4ConcatPlan plan = Mp4ConcatPlan();
+        plan.movie = segments[0];
+        for (Mp4Track& track : plan.movie.tracks)
+        {
+            track.samples.clear();
+            track.chunks.clear();
+        }
+
+        const size_t trackCount = plan.movie.tracks.size();
+        std::vector<uint64_t> trackEnd(trackCount, 0);
+        uint64_t segmentEnd = 0;     // 100 ns units
+
+        for (size_t s = 0; s < segments.size(); ++s)
+        {
+            const Mp4Movie& segment = segments[s];
+            if (segment.tracks.size() != trackCount)
+            {
+                throw std::runtime_error("MP4 concat: segment " + std::to_string(s) + ": track count differs from the first segment");
+            }
+
+            // The segment lasts as long as its longest track.
+            uint64_t length = 0;
+            for (size_t t = 0; t < trackCount; ++t)
+            {
+                const Mp4Track& source = segment.tracks[t];
+                const Mp4Track& target = plan.movie.tracks[t];
+                if (source.handler != target.handler || source.timescale != target.timescale)
+                {
+                    throw std::runtime_error(SegmentError(s, t, "track type or timescale differs from the first segment"));
+                }
+                if (source.sampleDescription != target.sampleDescription)
+                {
+                    throw std::runtime_error(SegmentError(s, t, "sample description differs from the first segment"));
+                }
+                length = std::max(length, RescaleUp(source.duration(), TICKS_PER_SECOND, source.timescale));
+            }
+            segmentEnd += length;
+
+            // Chunks in file order, so the copy keeps the segment's interleaving
+            // and contiguous chunks become one copy.
+            struct ChunkRef
+            {
+                size_t track;
+                size_t chunk;
+                uint64_t offset;
+            };
+            std::vector<ChunkRef> refs;
+            for (size_t t = 0; t < trackCount; ++t)
+            {
+                for (size_t c = 0; c < segment.tracks[t].chunks.size(); ++c)
+                {
+                    refs.push_back({ t, c, segment.tracks[t].chunks[c].offset });
+                }
+            }
+            std::stable_sort(refs.begin(), refs.end(), [](const ChunkRef& a, const ChunkRef& b) { return a.offset < b.offset; });
+
+            std::vector<std::vector<uint64_t>> placed(trackCount);
+            for (size_t t = 0; t < trackCount; ++t)
+            {
+                placed[t].resize(segment.tracks[t].chunks.size());
+            }
+            for (const ChunkRef& ref : refs)
+            {
+                const Mp4Track& source = segment.tracks[ref.track];
+                const uint64_t bytes = source.chunkBytes(source.chunks[ref.chunk]);
+                placed[ref.track][ref.chunk] = plan.payloadBytes;
+                if (!plan.copies.empty() && plan.copies.back().segment == s && plan.copies.back().sourceOffset + plan.copies.back().length == ref.offset)
+                {
+                    plan.copies.back().length += bytes;
+                }
+                else if (bytes > 0)
+                {
+                    plan.copies.push_back({ s, ref.offset, bytes });
+                }
+                plan.payloadBytes += bytes;
+            }
+
+            for (size_t t = 0; t < trackCount; ++t)
+            {
+                const Mp4Track& source = segment.tracks[t];
+                Mp4Track& target = plan.movie.tracks[t];
+                const size_t base = target.samples.size();
+                if (base + source.samples.size() > UINT32_MAX)
+                {
+                    throw std::runtime_error(SegmentError(s, t, "too many samples"));
+                }
+                target.samples.insert(target.samples.end(), source.samples.begin(), source.samples.end());
+                for (size_t c = 0; c < source.chunks.size(); ++c)
+                {
+                    const Mp4Chunk& chunk = source.chunks[c];
+                    target.chunks.push_back({ placed[t][c], static_cast<uint32_t>(base + chunk.firstSample), chunk.sampleCount });
+                }
+                trackEnd[t] += source.duration();
+
+                // Rebase onto the running segment end rather than this
+                // segment's length, so rounding never adds up.
+                const uint64_t wanted = Rescale(segmentEnd, target.timescale, TICKS_PER_SECOND);
+                if (wanted > trackEnd[t] && target.samples.size() > base)
+                {
+                    const uint64_t stretch = wanted - trackEnd[t];
+                    Mp4Sample& last = target.samples.back();
+                    if (stretch > UINT32_MAX - last.duration)
+                    {
+                        throw std::runtime_error(SegmentError(s, t, "tracks differ too much in length"));
+                    }
+                    last.duration += static_cast<uint32_t>(stretch);
+                    trackEnd[t] = wanted;
+                    plan.maxStretch = std::max(plan.maxStretch, static_cast<int64_t>(RescaleUp(stretch, TICKS_PER_SECOND, target.timescale)));
+                }
+            }
+        }
+        return plan;
+    }
+
+    uint64_t WriteMp4Concat(const Mp4ConcatPlan& plan, const std::vector<std::istream*>& inputs, std::ostream& out)
+    {
+        // The header size depends on whether chunk offsets need 64 bits,
+        // which depends on the header size; it only ever grows, so this
+        // settles after at most one extra pass.
+        const uint32_t mdatHeader = plan.payloadBytes + 8 > UINT32_MAX ? 16 : 8;
+        std::vector<uint8_t> header = WriteMp4MovieHeader(plan.movie, 0);
+        for (;;)
+        {
+            std::vector<uint8_t> next = WriteMp4MovieHeader(plan.movie, header.size() + mdatHeader);
+            const bool settled = next.size() == header.size();
+            header.swap(next);
+            if (settled)
+            {
+                break;
+            }
+        }
+
+        Mp4BoxWriter mdat;
+        if (mdatHeader == 16)
+        {
+            mdat.u32(1);
+            mdat.u32(Mp4Type("mdat"));
+            mdat.u64(plan.payloadBytes + 16);
+        }
+        else
+        {
+            mdat.u32(static_cast<uint32_t>(plan.payloadBytes + 8));
+            mdat.u32(Mp4Type("mdat"));
+        }
+        out.write(reinterpret_cast<const char*>(header.data()), header.size());
+        out.write(reinterpret_cast<const char*>(mdat.data().data()), mdat.size());
+
+        std::unique_ptr<char[]> block(new char[COPY_BLOCK]);
+        for (const Mp4CopyRange& copy : plan.copies)
+        {
+            if (copy.segment >= inputs.size())
+            {
+                throw std::invalid_argument("MP4 concat: fewer inputs than segments");
+            }
+            std::istream& in = *inputs[copy.segment];
+            in.clear();
+            in.seekg(static_cast<std::streamoff>(copy.sourceOffset));
+            uint64_t left = copy.length;
+            while (left > 0)
+            {
+                const size_t count = left < COPY_BLOCK ? static_cast<size_t>(left) : COPY_BLOCK;
+                if (!in.read(block.get(), count))
+                {
+                    throw std::runtime_error("MP4 concat: sample data lies outside its segment file");
+                }
+                out.write(block.get(), count);
+                left -= count;
+            }
+        }
+        if (!out)
+        {
+            throw std::runtime_error("MP4 concat: write failed");
+        }
+        return header.size() + mdat.size() + plan.payloadBytes;
+    }
+
+    uint64_t ConcatenateMp4Files(const std::vector<std::string>& inputs, const std::string& output)
+    {
+        std::vector<std::unique_ptr<std::ifstream>> files;
+        std::vector<std::istream*> streams;
+        std::vector<Mp4Movie> segments;
+        for (const std::string& path : inputs)
+        {
+            files.emplace_back(new std::ifstream(path, std::ios::binary));
+            if (!*files.back())
+            {
+                throw std::runtime_error("MP4 concat: can't open " + path);
+            }
+            streams.push_back(files.back().get());
+            segments.push_back(ReadMp4Movie(*files.back()));
+        }
+
+        const Mp4ConcatPlan plan = PlanMp4Concat(segments);
+        std::ofstream out(output, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("MP4 concat: can't create " + output);
+        }
+        const uint64_t written = WriteMp4Concat(plan, streams, out);
+        out.close();
+        if (!out)
+        {
+            throw std::runtime_error("MP4 concat: write failed");
+        }
+        return written;
+    }
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace VideoCoding
+{
+
+    struct Mp4Sample
+    {
+        uint32_t size;
+        uint32_t duration;          // media timescale
+        int32_t compositionOffset;
+        bool sync;
+    };
+
+    struct Mp4Chunk
+    {
+        uint64_t offset;            // file offset of the first sample
+        uint32_t firstSample;       // index into Mp4Track::samples
+        uint32_t sampleCount;
+    };
+
+    // One track of a progressive (moov + mdat) MP4, reduced to what is needed
+    // to rewrite it. The boxes that are carried over unchanged are kept raw,
+    // header included.
+    struct Mp4Track
+    {
+        uint32_t trackId;
+        uint32_t handler;           // 'vide', 'soun', ...
+        uint32_t timescale;
+        uint16_t language;          // packed ISO-639-2/T as in mdhd
+        int16_t layer;
+        int16_t alternateGroup;
+        uint16_t volume;            // 8.8 fixed point
+        uint8_t matrix[36];
+        uint32_t width;             // 16.16 fixed point
+        uint32_t height;
+        int64_t mediaTime;          // start of the single edit, -1 without an edit list
+
+        std::vector<uint8_t> handlerBox;        // hdlr
+        std::vector<uint8_t> mediaHeaderBox;    // vmhd, smhd, nmhd ...
+        std::vector<uint8_t> dataInformationBox;// dinf
+        std::vector<uint8_t> sampleDescription; // stsd
+
+        std::vector<Mp4Sample> samples;
+        std::vector<Mp4Chunk> chunks;
+
+        // Sum of the sample durations, media timescale.
+        uint64_t duration() const;
+        uint64_t chunkBytes(const Mp4Chunk& chunk) const;
+    };
+
+    struct Mp4Movie
+    {
+        std::vector<uint8_t> fileTypeBox;       // ftyp, raw
+        uint32_t timescale;
+        uint32_t rate;                          // 16.16 fixed point
+        uint16_t volume;
+        uint8_t matrix[36];
+        std::vector<Mp4Track> tracks;
+
+        // Longest track, movie timescale.
+        uint64_t duration() const;
+    };
+
+    // Reads ftyp and moov of a progressive MP4. Fragmented files, multiple
+    // sample descriptions and compact sample sizes (stz2) are rejected with
+    // std::runtime_error. mdat is not read.
+    Mp4Movie ReadMp4Movie(std::istream& in);
+
+    // Serializes the movie as ftyp + moov, with chunk offsets shifted by
+    // `chunkOffsetBase`. Uses 64-bit chunk offsets and headers where 32 bits
+    // do not suffice.
+    std::vector<uint8_t> WriteMp4MovieHeader(const Mp4Movie& movie, uint64_t chunkOffsetBase);
+
+    // ftyp + moov announcing a fragmented movie: the tracks of `movie` with
+    // empty sample tables and a trex each. Sample data follows in moof + mdat
+    // pairs, see FragmentedMp4Writer.
+    std::vector<uint8_t> WriteMp4InitSegment(const Mp4Movie& movie);
+
+    // A run of sample data to copy from one segment into the joined mdat.
+    struct Mp4CopyRange
+    {
+        size_t segment;
+        uint64_t sourceOffset;
+        uint64_t length;
+    };
+
+    struct Mp4ConcatPlan
+    {
+        Mp4Movie movie;                     // chunk offsets relative to the mdat payload
+        std::vector<Mp4CopyRange> copies;   // in output order, back to back
+        uint64_t payloadBytes;
+        int64_t maxStretch;                 // longest sample stretch at a boundary, 100 ns units
+    };
+
+    // Joins segments encoded from consecutive parts of one timeline into one
+    // movie. Segments must have the same tracks in the same order with
+    // identical sample descriptions. Decode times are continuous by
+    // construction; at each segment boundary every track is rebased onto the
+    // end of the segment's longest track, by stretching the track's last
+    // sample, so audio and video stay in step however far each segment's
+    // tracks drift apart. Rebasing works on the running total, so rounding
+    // between timescales never accumulates. Edit lists are taken from the
+    // first segment. Sample data keeps each segment's interleaving.
+    Mp4ConcatPlan PlanMp4Concat(const std::vector<Mp4Movie>& segments);
+
+    // Writes ftyp, moov and mdat for the plan, copying sample data from
+    // `inputs` (one per segment). Returns the bytes written.
+    uint64_t WriteMp4Concat(const Mp4ConcatPlan& plan, const std::vector<std::istream*>& inputs, std::ostream& out);
+
+    // Reads, plans and writes in one go.
+    uint64_t ConcatenateMp4Files(const std::vector<std::string>& inputs, const std::string& output);
+
+}
@@ -0,0 +1,496 @@
+#include "Mp4Fragment.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        const int64_t TICKS_PER_SECOND = 10000000;
+
+        // sample_flags of trun: sample_depends_on and sample_is_non_sync_sample.
+        const uint32_t SYNC_SAMPLE_FLAGS = 0x02000000;
+        const uint32_t NON_SYNC_SAMPLE_FLAGS = 0x01010000;
+        const uint32_t NON_SYNC_SAMPLE_BIT = 0x00010000;
+
+        // tfhd flags.
+        const uint32_t TFHD_BASE_DATA_OFFSET = 0x000001;
+        const uint32_t TFHD_SAMPLE_DESCRIPTION_INDEX = 0x000002;
+        const uint32_t TFHD_DEFAULT_DURATION = 0x000008;
+        const uint32_t TFHD_DEFAULT_SIZE = 0x000010;
+        const uint32_t TFHD_DEFAULT_FLAGS = 0x000020;
+        const uint32_t TFHD_DEFAULT_BASE_IS_MOOF = 0x020000;
+
+        // trun flags.
+        const uint32_t TRUN_DATA_OFFSET = 0x000001;
+        const uint32_t TRUN_FIRST_SAMPLE_FLAGS = 0x000004;
+        const uint32_t TRUN_DURATION = 0x000100;
+        const uint32_t TRUN_SIZE = 0x000200;
+        const uint32_t TRUN_FLAGS = 0x000400;
+        const uint32_t TRUN_COMPOSITION_OFFSET = 0x000800;
+
+        int64_t ToTicks(uint64_t value, uint32_t timescale)
+        {
+            return static_cast<int64_t>(value / timescale * TICKS_PER_SECOND + value % timescale * TICKS_PER_SECOND / timescale);
+        }
+
+        // File offsets of every sample of the track, from its chunk table.
+        std::vector<uint64_t> SampleOffsets(const Mp4Track& track)
+        {
+            std::vector<uint64_t> offsets(track.samples.size());
+            for (const Mp4Chunk& chunk : track.chunks)
+            {
+                uint64_t offset = chunk.offset;
+                for (uint32_t i = 0; i < chunk.sampleCount; ++i)
+                {
+                    offsets[chunk.firstSample + i] = offset;
+                    offset += track.samples[chunk.firstSample + i].size;
+                }
+            }
+            return offsets;
+        }
+
+        // Feeds every sample of the movie to a writer, in decode order across
+        // tracks. `read(offset, data, size)` fetches the sample at a chunk
+        // offset of the movie.
+        template<typename ReadSample>
+        FragmentedMp4Stats FragmentMovie(const Mp4Movie& movie, ReadSample read, ByteTarget& out, int64_t fragmentDuration)
+        {
+            FragmentedMp4Writer writer(movie, out, fragmentDuration);
+
+            std::vector<std::vector<uint64_t>> offsets;
+            for (const Mp4Track& track : movie.tracks)
+            {
+                offsets.push_back(SampleOffsets(track));
+            }
+            std::vector<size_t> next(movie.tracks.size(), 0);
+            std::vector<uint64_t> decodeTime(movie.tracks.size(), 0);
+            std::vector<uint8_t> data;
+            for (;;)
+            {
+                size_t track = movie.tracks.size();
+                for (size_t t = 0; t < movie.tracks.size(); ++t)
+                {
+                    if (next[t] < movie.tracks[t].samples.size() &&
+                        (track == movie.tracks.size() || ToTicks(decodeTime[t], movie.tracks[t].timescale) < ToTicks(decodeTime[track], movie.tracks[track].timescale)))
+                    {
+                        track = t;
+                    }
+                }
+                if (track == movie.tracks.size())
+                {
+                    break;
+                }
+
+                const Mp4Sample& sample = movie.tracks[track].samples[next[track]];
+                data.resize(sample.size);
+                read(offsets[track][next[track]], data.data(), sample.size);
+                writer.writeSample(track, sample, data.data());
+                decodeTime[track] += sample.duration;
+                ++next[track];
+            }
+            writer.finish();
+            return writer.getStats();
+        }
+
+        void ReadExactly(std::istream& in, uint64_t offset, uint8_t* data, size_t size)
+        {
+            in.clear();
+            in.seekg(static_cast<std::streamoff>(offset));
+            if (!in.read(reinterpret_cast<char*>(data), size))
+            {
+                throw std::runtime_error("MP4: sample data lies outside the file");
+            }
+        }
+
+        void ReadTrackFragment(const std::vector<uint8_t>& moof, const Mp4BoxHeader& traf, uint64_t moofOffset, const Mp4BoxHeader& mdat,
+            Mp4TrackFragmentInfo& info)
+        {
+            const uint8_t* p = moof.data();
+            const Mp4BoxHeader tfhd = RequireMp4Box(p, static_cast<size_t>(traf.payload()), static_cast<size_t>(traf.end()), Mp4Type("tfhd"));
+            Mp4Reader header(p, static_cast<size_t>(tfhd.payload()), static_cast<size_t>(tfhd.end()));
+            const uint32_t tfhdFlags = header.u32() & 0xffffff;
+            info.trackId = header.u32();
+            uint64_t dataBase = moofOffset;
+            if (tfhdFlags & TFHD_BASE_DATA_OFFSET)
+            {
+                dataBase = header.u64();
+            }
+            if (tfhdFlags & TFHD_SAMPLE_DESCRIPTION_INDEX)
+            {
+                header.skip(4);
+            }
+            const uint32_t defaultDuration = (tfhdFlags & TFHD_DEFAULT_DURATION) ? header.u32() : 0;
+            const uint32_t defaultSize = (tfhdFlags & TFHD_DEFAULT_SIZE) ? header.u32() : 0;
+            const uint32_t defaultFlags = (tfhdFlags & TFHD_DEFAULT_FLAGS) ? header.u32() : 0;
+
+            Mp4BoxHeader tfdt;
+            info.baseDecodeTime = 0;
+            if (FindMp4Box(p, static_cast<size_t>(traf.payload()), static_cast<size_t>(traf.end()), Mp4Type("tfdt"), tfdt))
+            {
+                Mp4Reader reader(p, static_cast<size_t>(tfdt.payload()), static_cast<size_t>(tfdt.end()));
+                const uint8_t version = reader.u8();
+                reader.skip(3);
+                info.baseDecodeTime = version == 1 ? reader.u64() : reader.u32();
+            }
+
+            info.sampleCount = 0;
+            info.duration = 0;
+            info.dataBytes = 0;
+            info.startsWithSync = false;
+            uint64_t dataEnd = dataBase;
+            for (const Mp4BoxHeader& box : ReadMp4Boxes(p, static_cast<size_t>(traf.payload()), static_cast<size_t>(traf.end())))
+            {
+                if (box.type != Mp4Type("trun"))
+                {
+                    continue;
+                }
+                Mp4Reader reader(p, static_cast<size_t>(box.payload()), static_cast<size_t>(box.end()));
+                const uint32_t flags = reader.u32() & 0xffffff;
+                const uint32_t count = reader.u32();
+                uint64_t dataStart = dataEnd;
+                if (flags & TRUN_DATA_OFFSET)
+                {
+                    dataStart = dataBase + static_cast<int64_t>(static_cast<int32_t>(reader.u32()));
+                }
+                const uint32_t firstFlags = (flags & TRUN_FIRST_SAMPLE_FLAGS) ? reader.u32() : defaultFlags;
+
+                uint64_t runBytes = 0;
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    info.duration += (flags & TRUN_DURATION) ? reader.u32() : defaultDuration;
+                    runBytes += (flags & TRUN_SIZE) ? reader.u32() : defaultSize;
+                    uint32_t sampleFlags = (flags & TRUN_FLAGS) ? reader.u32() : defaultFlags;
+                    if (i == 0 && (flags & TRUN_FIRST_SAMPLE_FLAGS))
+                    {
+                        sampleFlags = firstFlags;
+                    }
+                    if (flags & TRUN_COMPOSITION_OFFSET)
+                    {
+                        reader.skip(4);
+                    }
+                    if (info.sampleCount == 0 && i == 0)
+                    {
+                        info.startsWithSync = (sampleFlags & NON_SYNC_SAMPLE_BIT) == 0;
+                    }
+                }
+                if (dataStart < mdat.payload() || dataStart + runBytes > mdat.end())
+                {
+                    throw std::runtime_error("MP4: trun points outside its mdat");
+                }
+                info.sampleCount += count;
+                info.dataBytes += runBytes;
+                dataEnd = dataStart + runBytes;
+            }
+        }
+    }
+
+    uint32_t FramesPerFragment(int64_t fragmentDuration, uint32_t fpsNumerator, uint32_t fpsDenominator)
+    {
+        if (fragmentDuration <= 0 || fpsDenominator == 0)
+        {
+            return 1;
+        }
+        const double frames = static_cast<double>(fragmentDuration) * fpsNumerator / (static_cast<double>(fpsDenominator) * TICKS_PER_SECOND);
+        return frames < 1.0 ? 1 : static_cast<uint32_t>(std::min(frames + 0.5, 4294967295.0));
+    }
+
+    FragmentedMp4Writer::FragmentedMp4Writer(const Mp4Movie& movie, ByteTarget& target, int64_t fragmentDuration)
+        : target(target), fragmentDuration(fragmentDuration), anchor(0), sequenceNumber(0), stats()
+    {
+        if (movie.tracks.empty())
+        {
+            throw std::invalid_argument("FragmentedMp4Writer: movie has no tracks");
+        }
+        if (fragmentDuration <= 0)
+        {
+            throw std::invalid_argument("FragmentedMp4Writer: fragment duration must be positive");
+        }
+
+        bool video = false;
+        for (size_t i = 0; i < movie.tracks.size(); ++i)
+        {
+            const Mp4Track& source = movie.tracks[i];
+            if (source.timescale == 0)
+            {
+                throw std::invalid_argument("FragmentedMp4Writer: track without a timescale");
+            }
+            TrackState track;
+            track.trackId = source.trackId;
+            track.timescale = source.timescale;
+            track.decodeTime = 0;
+            track.duration = 0;
+            tracks.push_back(track);
+            if (!video && source.handler == Mp4Type("vide"))
+            {
+                anchor = i;
+                video = true;
+            }
+        }
+
+        const std::vector<uint8_t> init = WriteMp4InitSegment(movie);
+        target.write(init.data(), init.size());
+        stats.bytes += init.size();
+    }
+
+    void FragmentedMp4Writer::writeSample(size_t track, const Mp4Sample& sample, const uint8_t* data)
+    {
+        if (track >= tracks.size())
+        {
+            throw std::out_of_range("FragmentedMp4Writer: no such track");
+        }
+
+        TrackState& state = tracks[track];
+        const int64_t span = elapsed(state);
+        if (!state.samples.empty() &&
+            ((track == anchor && sample.sync && span >= fragmentDuration) || span >= MAX_FRAGMENT_FACTOR * fragmentDuration))
+        {
+            closeFragment();
+        }
+
+        state.samples.push_back(sample);
+        state.data.insert(state.data.end(), data, data + sample.size);
+        state.duration += sample.duration;
+    }
+
+    void FragmentedMp4Writer::finish()
+    {
+        closeFragment();
+    }
+
+    int64_t FragmentedMp4Writer::elapsed(const TrackState& track) const
+    {
+        return ToTicks(track.duration, track.timescale);
+    }
+
+    void FragmentedMp4Writer::closeFragment()
+    {
+        if (std::all_of(tracks.begin(), tracks.end(), [](const TrackState& track) { return track.samples.empty(); }))
+        {
+            return;
+        }
+        uint64_t payload = 0;
+        for (const TrackState& track : tracks)
+        {
+            payload += track.data.size();
+        }
+
+        // Data offsets are relative to the moof, which isn't complete until
+        // every trun is in; they are patched once its size is known.
+        moof.clear();
+        moof.beginBox(Mp4Type("moof"));
+        moof.beginFullBox(Mp4Type("mfhd"), 0, 0);
+        moof.u32(++sequenceNumber);
+        moof.endBox();
+
+        std::vector<size_t> dataOffsetAt;
+        for (const TrackState& track : tracks)
+        {
+            if (track.samples.empty())
+            {
+                continue;
+            }
+            bool offsets = false;
+            for (const Mp4Sample& sample : track.samples)
+            {
+                offsets = offsets || sample.compositionOffset != 0;
+            }
+
+            moof.beginBox(Mp4Type("traf"));
+            moof.beginFullBox(Mp4Type("tfhd"), 0, TFHD_DEFAULT_BASE_IS_MOOF);
+            moof.u32(track.trackId);
+            moof.endBox();
+            moof.beginFullBox(Mp4Type("tfdt"), 1, 0);
+            moof.u64(track.decodeTime);
+            moof.endBox();
+            moof.beginFullBox(Mp4Type("trun"), 1, TRUN_DATA_OFFSET | TRUN_DURATION | TRUN_SIZE | TRUN_FLAGS | (offsets ? TRUN_COMPOSITION_OFFSET : 0));
+            moof.u32(static_cast<uint32_t>(track.samples.size()));
+            dataOffsetAt.push_back(moof.size());
+            moof.u32(0);
+            for (const Mp4Sample& sample : track.samples)
+            {
+                moof.u32(sample.duration);
+                moof.u32(sample.size);
+                moof.u32(sample.sync ? SYNC_SAMPLE_FLAGS : NON_SYNC_SAMPLE_FLAGS);
+                if (offsets)
+                {
+                    moof.u32(static_cast<uint32_t>(sample.compositionOffset));
+                }
+            }
+            moof.endBox();
+            moof.endBox();
+        }
+        moof.endBox();
+
+        const bool wide = payload + 8 > UINT32_MAX;
+        Mp4BoxWriter mdat;
+        if (wide)
+        {
+            mdat.u32(1);
+            mdat.u32(Mp4Type("mdat"));
+            mdat.u64(payload + 16);
+        }
+        else
+        {
+            mdat.u32(static_cast<uint32_t>(payload + 8));
+            mdat.u32(Mp4Type("mdat"));
+        }
+
+        uint64_t dataOffset = moof.size() + mdat.size();
+        size_t run = 0;
+        for (const TrackState& track : tracks)
+        {
+            if (track.samples.empty())
+            {
+                continue;
+            }
+            if (dataOffset > INT32_MAX)
+            {
+                throw std::runtime_error("FragmentedMp4Writer: fragment too large");
+            }
+            moof.patchU32(dataOffsetAt[run++], static_cast<uint32_t>(dataOffset));
+            dataOffset += track.data.size();
+        }
+
+        target.write(moof.data().data(), moof.size());
+        target.write(mdat.data().data(), mdat.size());
+        for (const TrackState& track : tracks)
+        {
+            if (!track.data.empty())
+            {
+                target.write(track.data.data(), track.data.size());
+            }
+        }
+
+        const uint64_t fragmentBytes = moof.size() + mdat.size() + payload;
+        ++stats.fragments;
+        stats.bytes += fragmentBytes;
+        stats.largestFragment = std::max(stats.largestFragment, fragmentBytes);
+        stats.longestFragment = std::max(stats.longestFragment, elapsed(tracks[anchor]));
+
+        // clear() keeps the capacity, so steady state allocates nothing.
+        for (TrackState& track : tracks)
+        {
+            track.decodeTime += track.duration;
+            track.duration = 0;
+            track.samples.clear();
+            track.data.clear();
+        }
+    }
+
+    // ------------------------------------------------------------------------
+
+    FragmentedMp4Stats RefragmentMp4(std::istream& in, ByteTarget& out, int64_t fragmentDuration)
+    {
+        const Mp4Movie movie = ReadMp4Movie(in);
+        return FragmentMovie(movie, [&in](uint64_t offset, uint8_t* data, size_t size)
+        {
+            ReadExactly(in, offset, data, size);
+        }, out, fragmentDuration);
+    }
+
+    FragmentedMp4Stats WriteMp4ConcatFragmented(const Mp4ConcatPlan& plan, const std::vector<std::istream*>& inputs, ByteTarget& out,
+        int64_t fragmentDuration)
+    {
+        // The plan's chunk offsets count from the start of the joined mdat
+        // payload, which is the copy ranges back to back.
+        std::vector<uint64_t> copyStarts;
+        uint64_t position = 0;
+        for (const Mp4CopyRange& copy : plan.copies)
+        {
+            if (copy.segment >= inputs.size())
+            {
+                throw std::invalid_argument("MP4 concat: fewer inputs than segments");
+            }
+            copyStarts.push_back(position);
+            position += copy.length;
+        }
+
+        return FragmentMovie(plan.movie, [&](uint64_t offset, uint8_t* data, size_t size)
+        {
+            const size_t index = static_cast<size_t>(std::upper_bound(copyStarts.begin(), copyStarts.end(), offset) - copyStarts.begin());
+            if (index == 0 || offset + size > copyStarts[index - 1] + plan.copies[index - 1].length)
+            {
+                throw std::runtime_error("MP4 concat: sample straddles segment copies");
+            }
+            const Mp4CopyRange& copy = plan.copies[index - 1];
+            ReadExactly(*inputs[copy.segment], copy.sourceOffset + (offset - copyStarts[index - 1]), data, size);
+        }, out, fragmentDuration);
+    }
+
+    FragmentedMp4Stats ConcatenateMp4FilesFragmented(const std::vector<std::string>& inputs, const std::string& output, int64_t fragmentDuration)
+    {
+        std::vector<std::unique_ptr<std::ifstream>> files;
+        std::vector<std::istream*> streams;
+        std::vector<Mp4Movie> segments;
+        for (const std::string& path : inputs)
+        {
+            files.emplace_back(new std::ifstream(path, std::ios::binary));
+            if (!*files.back())
+            {
+                throw std::runtime_error("MP4 concat: can't open " + path);
+            }
+            streams.push_back(files.back().get());
+            segments.push_back(ReadMp4Movie(*files.back()));
+        }
+
+        const Mp4ConcatPlan plan = PlanMp4Concat(segments);
+        FileByteTarget out(output);
+        const FragmentedMp4Stats stats = WriteMp4ConcatFragmented(plan, streams, out, fragmentDuration);
+        out.close();
+        return stats;
+    }
+
+    // ------------------------------------------------------------------------
+
+    std::vector<Mp4FragmentInfo> ReadMp4Fragments(std::istream& in)
+    {
+        const std::vector<Mp4BoxHeader> boxes = ReadMp4TopLevelBoxes(in);
+        std::vector<Mp4FragmentInfo> fragments;
+        for (size_t i = 0; i < boxes.size(); ++i)
+        {
+            if (boxes[i].type != Mp4Type("moof"))
+            {
+                continue;
+            }
+            if (i + 1 >= boxes.size() || boxes[i + 1].type != Mp4Type("mdat"))
+            {
+                throw std::runtime_error("MP4: moof without a following mdat");
+            }
+
+            const Mp4BoxHeader& mdat = boxes[i + 1];
+            const std::vector<uint8_t> moof = LoadMp4Box(in, boxes[i]);
+            const uint8_t* p = moof.data();
+            Mp4BoxHeader local = boxes[i];
+            local.offset = 0;
+
+            Mp4FragmentInfo fragment;
+            fragment.offset = boxes[i].offset;
+            fragment.size = mdat.end() - boxes[i].offset;
+            const Mp4BoxHeader mfhd = RequireMp4Box(p, static_cast<size_t>(local.payload()), static_cast<size_t>(local.end()), Mp4Type("mfhd"));
+            Mp4Reader reader(p, static_cast<size_t>(mfhd.payload()), static_cast<size_t>(mfhd.end()));
+            reader.skip(4);
+            fragment.sequenceNumber = reader.u32();
+
+            for (const Mp4BoxHeader& traf : ReadMp4Boxes(p, static_cast<size_t>(local.payload()), static_cast<size_t>(local.end())))
+            {
+                if (traf.type != Mp4Type("traf"))
+                {
+                    continue;
+                }
+                // Box offsets within `moof` are relative to its start; the
+                // data offsets in the file are absolute.
+                Mp4TrackFragmentInfo track;
+                ReadTrackFragment(moof, traf, boxes[i].offset, mdat, track);
+                fragment.tracks.push_back(track);
+            }
+            fragments.push_back(fragment);
+        }
+        return fragments;
+    }
+
+}
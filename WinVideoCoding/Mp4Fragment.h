@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "ByteTarget.h"
+#include "Mp4Box.h"
+#include "Mp4Concat.h"
+
+namespace VideoCoding
+{
+
+    // 100 ns units, as everywhere else.
+    const int64_t DEFAULT_FRAGMENT_DURATION = 20000000;
+
+    // A fragment that has not met a key frame by this many times the
+    // requested duration is closed anyway, so memory stays bounded even for
+    // sources with sparse key frames.
+    const int64_t MAX_FRAGMENT_FACTOR = 4;
+
+    // Key frame interval, in frames, that makes an encoder's GOPs line up
+    // with fragments of the given duration. At least 1.
+    uint32_t FramesPerFragment(int64_t fragmentDuration, uint32_t fpsNumerator, uint32_t fpsDenominator);
+
+    struct FragmentedMp4Stats
+    {
+        uint64_t fragments;
+        uint64_t bytes;             // everything written, init segment included
+        uint64_t largestFragment;   // moof + mdat, the most ever held in memory
+        int64_t longestFragment;    // 100 ns units, by the anchor track
+    };
+
+    // Writes a fragmented MP4: the init segment (see WriteMp4InitSegment)
+    // up front, then one moof + mdat pair per fragment, each handed to the
+    // target as soon as it is complete. Only the open fragment is held in
+    // memory.
+    //
+    // Fragments are cut on the anchor track, the first video track or else
+    // the first track: at its first sync sample once the fragment spans
+    // `fragmentDuration`. Every track's base decode time is carried in tfdt,
+    // so a consumer can start at any fragment that begins with a key frame.
+    class FragmentedMp4Writer
+    {
+    public:
+        // `movie` supplies the track descriptions, its sample tables are
+        // ignored. Throws std::invalid_argument for a movie without tracks
+        // or a duration that isn't positive.
+        FragmentedMp4Writer(const Mp4Movie& movie, ByteTarget& target, int64_t fragmentDuration = DEFAULT_FRAGMENT_DURATION);
+
+        FragmentedMp4Writer(const FragmentedMp4Writer&) = delete;
+        FragmentedMp4Writer& operator=(const FragmentedMp4Writer&) = delete;
+
+        // Samples of one track come in decode order; tracks may interleave
+        // freely. `data` holds sample.size bytes.
+        void writeSample(size_t track, const Mp4Sample& sample, const uint8_t* data);
+
+        // Writes out the open fragment. Does not close the target.
+        void finish();
+
+        const FragmentedMp4Stats& getStats() const { return stats; }
+
+    private:
+        struct TrackState
+        {
+            uint32_t trackId;
+            uint32_t timescale;
+            uint64_t decodeTime;        // of the open fragment's first sample
+            uint64_t duration;          // of the open fragment so far, media timescale
+            std::vector<Mp4Sample> samples;
+            std::vector<uint8_t> data;
+        };
+
+        int64_t elapsed(const TrackState& track) const;
+        void closeFragment();
+
+        ByteTarget& target;
+        const int64_t fragmentDuration;
+        std::vector<TrackState> tracks;
+        size_t anchor;
+        uint32_t sequenceNumber;
+        Mp4BoxWriter moof;
+        FragmentedMp4Stats stats;
+    };
+
+    // Rewrites a progressive MP4 as a fragmented one, reading samples in
+    // decode order across tracks.
+    FragmentedMp4Stats RefragmentMp4(std::istream& in, ByteTarget& out, int64_t fragmentDuration = DEFAULT_FRAGMENT_DURATION);
+
+    // Like WriteMp4Concat, but fragmented; the output needs no seeking.
+    FragmentedMp4Stats WriteMp4ConcatFragmented(const Mp4ConcatPlan& plan, const std::vector<std::istream*>& inputs, ByteTarget& out,
+        int64_t fragmentDuration = DEFAULT_FRAGMENT_DURATION);
+
+    // Reads, plans and writes in one go, see ConcatenateMp4Files.
+    FragmentedMp4Stats ConcatenateMp4FilesFragmented(const std::vector<std::string>& inputs, const std::string& output,
+        int64_t fragmentDuration = DEFAULT_FRAGMENT_DURATION);
+
+    // ------------------------------------------------------------------------
+
+    // What one traf of a fragment says about its track.
+    struct Mp4TrackFragmentInfo
+    {
+        uint32_t trackId;
+        uint64_t baseDecodeTime;    // media timescale
+        uint32_t sampleCount;
+        uint64_t duration;          // media timescale
+        uint64_t dataBytes;
+        bool startsWithSync;
+    };
+
+    struct Mp4FragmentInfo
+    {
+        uint32_t sequenceNumber;
+        uint64_t offset;            // of the moof
+        uint64_t size;              // moof and its mdat
+        std::vector<Mp4TrackFragmentInfo> tracks;
+    };
+
+    // The fragments of a fragmented MP4, for checking structure and timing.
+    // Throws std::runtime_error when a moof is malformed, is not followed by
+    // an mdat, or points at sample data outside that mdat.
+    std::vector<Mp4FragmentInfo> ReadMp4Fragments(std::istream& in);
+
+}
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "AlignedBuffer.h"
+#include "RingQueue.h"
+
+namespace VideoCoding
+{
+
+    template<typename Item>
+    struct MuxSample
+    {
+        uint32_t stream;            // index returned by MuxScheduler::addStream
+        int64_t timestamp;          // 100 ns units
+        int64_t duration;
+        Item item;
+    };
+
+    struct MuxStats
+    {
+        uint64_t samplesWritten;
+        uint64_t producerStalls;    // a producer waited for room in its queue
+        uint64_t writerStalls;      // the writer waited for a lagging stream
+        size_t maxBuffered;         // samples produced but not yet written
+        int64_t maxSkew;            // largest step back in timestamp between consecutive writes
+    };
+
+    // Interleaves several streams, each fed by its own producer thread, into
+    // one writer in presentation order. Every stream has a bounded queue
+    // (`queueDepth` rounded up to a power of two), so per stream at most the
+    // queue plus two samples, one being produced and one waiting with the
+    // writer, exist at any time. A stream running ahead is held back by its
+    // producer blocking on the full queue.
+    //
+    // The writer (the thread calling run()) always takes the earliest queued
+    // sample. It may write it before a stream that has nothing queued yet
+    // has caught up, as long as the sample starts no more than `maxSkew`
+    // after where that stream left off; only further ahead it waits. The
+    // output is therefore in timestamp order except for steps back of at
+    // most `maxSkew`, and per stream always in order.
+    template<typename Item>
+    class MuxScheduler
+    {
+    public:
+        typedef MuxSample<Item> Sample;
+        // Fills in timestamp, duration and item of the stream's next sample,
+        // returns false at the end of the stream. Timestamps of one stream
+        // must not decrease.
+        typedef std::function<bool(Sample& sample)> ProduceFunction;
+        typedef std::function<void(Sample& sample)> WriteFunction;
+        // Called for samples that were produced but never written; may be
+        // called from producer threads.
+        typedef std::function<void(Sample& sample)> DiscardFunction;
+
+        MuxScheduler(size_t queueDepth, int64_t maxSkew)
+            : queueDepth(queueDepth < 1 ? 1 : queueDepth), maxSkew(maxSkew < 0 ? 0 : maxSkew)
+        {
+        }
+
+        // `startTime` is a lower bound for the stream's first timestamp.
+        uint32_t addStream(const ProduceFunction& produce, int64_t startTime = 0)
+        {
+            streams.emplace_back(new Stream(produce, startTime, queueDepth));
+            return static_cast<uint32_t>(streams.size() - 1);
+        }
+
+        // Runs every stream to its end. If a producer or `write` throws, all
+        // producers stop, samples not yet written, including the one `write`
+        // threw on, go to `discard` and the exception is rethrown.
+        MuxStats run(const WriteFunction& write, const DiscardFunction& discard = DiscardFunction())
+        {
+            std::atomic<bool> aborted(false);
+            std::atomic<size_t> buffered(0);
+            std::atomic<size_t> maxBuffered(0);
+            std::atomic<uint64_t> producerStalls(0);
+            std::exception_ptr error;
+            std::mutex errorMutex;
+
+            const auto fail = [&](std::exception_ptr e)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error)
+                {
+                    error = e;
+                }
+                aborted = true;
+            };
+
+            std::vector<std::thread> producers;
+            for (size_t s = 0; s < streams.size(); ++s)
+            {
+                producers.emplace_back([&, s]
+                {
+                    Stream& stream = *streams[s];
+                    Backoff backoff;
+                    try
+                    {
+                        int64_t previous = stream.startTime;
+                        Sample sample;
+                        while (!aborted)
+                        {
+                            sample = Sample();
+                            if (!stream.produce(sample))
+                            {
+                                break;
+                            }
+                            sample.stream = static_cast<uint32_t>(s);
+                            if (sample.timestamp < previous)
+                            {
+                                if (discard)
+                                {
+                                    discard(sample);
+                                }
+                                throw std::logic_error("MuxScheduler: stream timestamps went backwards");
+                            }
+                            previous = sample.timestamp;
+
+                            // Counted before the push so the writer never sees
+                            // the count drop below zero.
+                            const size_t now = ++buffered;
+                            size_t seen = maxBuffered.load(std::memory_order_relaxed);
+                            while (now > seen && !maxBuffered.compare_exchange_weak(seen, now, std::memory_order_relaxed))
+                            {
+                            }
+
+                            bool stalled = false;
+                            backoff.reset();
+                            while (!stream.queue.tryPush(sample))
+                            {
+                                if (aborted)
+                                {
+                                    if (discard)
+                                    {
+                                        discard(sample);
+                                    }
+                                    break;
+                                }
+                                stalled = true;
+                                backoff.pause();
+                            }
+                            if (stalled)
+                            {
+                                ++producerStalls;
+                            }
+                        }
+                    }
+                    catch (...)
+                    {
+                        fail(std::current_exception());
+                    }
+                    stream.finished.store(true, std::memory_order_release);
+                });
+            }
+
+            MuxStats stats = MuxStats();
+            std::vector<Sample> heads(streams.size());
+            std::vector<bool> hasHead(streams.size(), false);
+            std::vector<bool> done(streams.size(), false);
+            // Where each stream's next sample can start at the earliest.
+            std::vector<int64_t> nextStart(streams.size());
+            for (size_t s = 0; s < streams.size(); ++s)
+            {
+                nextStart[s] = streams[s]->startTime;
+            }
+
+            Backoff backoff;
+            bool waiting = false;
+            try
+            {
+                bool first = true;
+                int64_t latest = 0;
+                size_t remaining = streams.size();
+                while (remaining > 0 && !aborted)
+                {
+                    for (size_t s = 0; s < streams.size(); ++s)
+                    {
+                        if (hasHead[s] || done[s])
+                        {
+                            continue;
+                        }
+                        // Look at the flag first: a push that happened before
+                        // it was set is visible to the pop after it.
+                        const bool finished = streams[s]->finished.load(std::memory_order_acquire);
+                        if (streams[s]->queue.tryPop(heads[s]))
+                        {
+                            hasHead[s] = true;
+                        }
+                        else if (finished)
+                        {
+                            done[s] = true;
+                            --remaining;
+                        }
+                    }
+
+                    size_t next = streams.size();
+                    for (size_t s = 0; s < streams.size(); ++s)
+                    {
+                        if (hasHead[s] && (next == streams.size() || heads[s].timestamp < heads[next].timestamp))
+                        {
+                            next = s;
+                        }
+                    }
+
+                    bool ready = next != streams.size();
+                    for (size_t s = 0; ready && s < streams.size(); ++s)
+                    {
+                        if (!hasHead[s] && !done[s] && heads[next].timestamp > nextStart[s] + maxSkew)
+                        {
+                            ready = false;
+                        }
+                    }
+                    if (!ready)
+                    {
+                        if (next != streams.size() && !waiting)
+                        {
+                            ++stats.writerStalls;
+                            waiting = true;
+                        }
+                        backoff.pause();
+                        continue;
+                    }
+                    backoff.reset();
+                    waiting = false;
+
+                    Sample& sample = heads[next];
+                    if (!first && latest - sample.timestamp > stats.maxSkew)
+                    {
+                        stats.maxSkew = latest - sample.timestamp;
+                    }
+                    latest = first ? sample.timestamp : std::max(latest, sample.timestamp);
+                    first = false;
+                    nextStart[next] = sample.timestamp + sample.duration;
+
+                    // Still held while write runs, so a sample it throws on
+                    // is discarded with the others.
+                    write(sample);
+                    hasHead[next] = false;
+                    --buffered;
+                    ++stats.samplesWritten;
+                }
+            }
+            catch (...)
+            {
+                fail(std::current_exception());
+            }
+
+            for (std::thread& producer : producers)
+            {
+                producer.join();
+            }
+
+            if (error)
+            {
+                for (size_t s = 0; s < streams.size(); ++s)
+                {
+                    Sample sample;
+                    if (hasHead[s] && discard)
+                    {
+                        discard(heads[s]);
+                    }
+                    while (streams[s]->queue.tryPop(sample))
+                    {
+                        if (discard)
+                        {
+                            discard(sample);
+                        }
+                    }
+                }
+                std::rethrow_exception(error);
+            }
+
+            stats.producerStalls = producerStalls;
+            stats.maxBuffered = maxBuffered;
+            return stats;
+        }
+
+    private:
+        struct Stream
+        {
+            Stream(const ProduceFunction& produce, int64_t startTime, size_t queueDepth)
+                : produce(produce), startTime(startTime), queue(queueDepth), finished(false) {}
+
+            // The queue keeps its ends on separate cache lines, which plain
+            // new does not honour before C++17.
+            static void* operator new(size_t size) { return AlignedAllocate(size, alignof(Stream)); }
+            static void operator delete(void* p) { AlignedFree(p); }
+
+            ProduceFunction produce;
+            const int64_t startTime;
+            RingQueue<Sample> queue;
+            std::atomic<bool> finished;
+        };
+
+        const size_t queueDepth;
+        const int64_t maxSkew;
+        std::vector<std::unique_ptr<Stream>> streams;
+    };
+
+}
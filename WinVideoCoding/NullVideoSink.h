@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdexcept>
+#include <memory>
+
+#include "FramePool.h"
+#include "VideoSink.h"
+
+namespace VideoCoding
+{
+
+    // Sink that accepts frames and throws them away, for measuring the
+    // pipeline in front of the sink without any I/O.
+    class NullVideoSink : public VideoSink
+    {
+    public:
+        explicit NullVideoSink(size_t poolCapacity = 8) : poolCapacity(poolCapacity), input(), framesWritten(0) {}
+
+        uint32_t addStream(const VideoStreamFormat&) override
+        {
+            return 0;
+        }
+
+        void setInputFormat(uint32_t, const VideoStreamFormat& inputFormat) override
+        {
+            input = inputFormat;
+            pool.reset(new FramePool<HeapAlignedBufferBackend>(HeapAlignedBufferBackend(FrameBytes(input.pixelFormat, input.width, input.height)), poolCapacity));
+            pool->preallocate();
+        }
+
+        void beginWriting() override
+        {
+            if (!pool)
+            {
+                throw std::logic_error("NullVideoSink: setInputFormat() was not called");
+            }
+        }
+
+        SinkFrame acquireFrame(uint32_t) override
+        {
+            AlignedBuffer* buffer = pool->acquire();
+            FrameView view = { buffer->get(), static_cast<ptrdiff_t>(RowBytes(input.pixelFormat, input.width)), input.width, input.height, input.pixelFormat, buffer->getId() };
+            SinkFrame frame = { view, buffer };
+            return frame;
+        }
+
+        void writeFrame(uint32_t streamIndex, SinkFrame& frame, int64_t, int64_t) override
+        {
+            ++framesWritten;
+            discardFrame(streamIndex, frame);
+        }
+
+        void discardFrame(uint32_t, SinkFrame& frame) override
+        {
+            pool->recycle(static_cast<AlignedBuffer*>(frame.handle));
+            frame.handle = nullptr;
+        }
+
+        void finalize() override {}
+
+        uint64_t getFramesWritten() const { return framesWritten; }
+
+    private:
+        const size_t poolCapacity;
+        VideoStreamFormat input;
+        std::unique_ptr<FramePool<HeapAlignedBufferBackend>> pool;
+        uint64_t framesWritten;
+    };
+
+}
@@ -0,0 +1,246 @@
+#include "ProfileCache.h"
+
+#include <sstream>
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        uint32_t GreatestCommonDivisor(uint32_t a, uint32_t b)
+        {
+            while (b != 0)
+            {
+                const uint32_t rest = a % b;
+                a = b;
+                b = rest;
+            }
+            return a;
+        }
+
+        const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+        const uint64_t FNV_PRIME = 1099511628211ull;
+
+        void HashValue(uint64_t& hash, uint32_t value)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                hash ^= (value >> (i * 8)) & 0xff;
+                hash *= FNV_PRIME;
+            }
+        }
+
+        const char* VideoCodecName(VideoCodec codec)
+        {
+            switch (codec)
+            {
+            case VideoCodec::WMV3:
+                return "wmv3";
+            case VideoCodec::H264:
+                return "h264";
+            default:
+                return "raw";
+            }
+        }
+
+        const char* ProfileUseName(ProfileUse use)
+        {
+            switch (use)
+            {
+            case ProfileUse::Transcode:
+                return "transcode";
+            case ProfileUse::StreamOutput:
+                return "output";
+            default:
+                return "input";
+            }
+        }
+    }
+
+    ProfileDescriptor CanonicalProfileDescriptor(const ProfileDescriptor& descriptor)
+    {
+        ProfileDescriptor canonical = ProfileDescriptor();
+        canonical.use = descriptor.use;
+        if (descriptor.use == ProfileUse::Transcode)
+        {
+            canonical.container = descriptor.container;
+        }
+
+        canonical.hasVideo = descriptor.hasVideo;
+        if (descriptor.hasVideo)
+        {
+            const VideoStreamFormat& video = descriptor.video;
+            const bool input = descriptor.use == ProfileUse::StreamInput;
+            canonical.video.codec = input ? VideoCodec::Uncompressed : video.codec;
+            canonical.video.width = video.width;
+            canonical.video.height = video.height;
+            const uint32_t divisor = GreatestCommonDivisor(video.fpsNumerator, video.fpsDenominator);
+            canonical.video.fpsNumerator = divisor > 0 ? video.fpsNumerator / divisor : video.fpsNumerator;
+            canonical.video.fpsDenominator = divisor > 0 ? video.fpsDenominator / divisor : video.fpsDenominator;
+            if (canonical.video.codec == VideoCodec::Uncompressed)
+            {
+                canonical.video.pixelFormat = video.pixelFormat;
+            }
+            if (input && video.pixelFormat != PixelFormat::RGB32)
+            {
+                canonical.video.matrix = video.matrix;
+                canonical.video.range = video.range;
+            }
+            if (!input)
+            {
+                canonical.video.bitrate = video.bitrate;
+                canonical.keyframeSpacing = canonical.video.codec != VideoCodec::Uncompressed ? descriptor.keyframeSpacing : 0;
+                canonical.videoProfile = canonical.video.codec == VideoCodec::H264 ? descriptor.videoProfile : 0;
+            }
+        }
+
+        // A stream carries one kind of media.
+        canonical.hasAudio = descriptor.hasAudio && (descriptor.use == ProfileUse::Transcode || !descriptor.hasVideo);
+        if (canonical.hasAudio)
+        {
+            const AudioStreamFormat& audio = descriptor.audio;
+            canonical.audio.codec = audio.codec;
+            canonical.audio.sampleRate = audio.sampleRate;
+            canonical.audio.channels = audio.channels;
+            canonical.audio.bitsPerSample = audio.bitsPerSample;
+            if (audio.codec == AudioCodec::AAC)
+            {
+                // PCM's rate follows from the rest.
+                canonical.audio.bytesPerSecond = audio.bytesPerSecond;
+                canonical.audio.aacProfile = audio.aacProfile;
+            }
+        }
+        return canonical;
+    }
+
+    ProfileDescriptor MakeTranscodeDescriptor(const AACProfileInfo& audio, const H264ProfileInfo& video, uint32_t keyframeSpacing, ContainerType container)
+    {
+        ProfileDescriptor descriptor = ProfileDescriptor();
+        descriptor.use = ProfileUse::Transcode;
+        descriptor.container = container;
+        descriptor.hasVideo = true;
+        descriptor.video.codec = VideoCodec::H264;
+        descriptor.video.width = video.width;
+        descriptor.video.height = video.height;
+        descriptor.video.fpsNumerator = video.fpsNumerator;
+        descriptor.video.fpsDenominator = video.fpsDenominator;
+        descriptor.video.bitrate = video.bitrate;
+        descriptor.videoProfile = video.profile;
+        descriptor.keyframeSpacing = keyframeSpacing;
+        descriptor.hasAudio = true;
+        descriptor.audio.codec = AudioCodec::AAC;
+        descriptor.audio.sampleRate = audio.samplesPerSec;
+        descriptor.audio.channels = audio.numChannels;
+        descriptor.audio.bitsPerSample = audio.bitsPerSample;
+        descriptor.audio.bytesPerSecond = audio.bytesPerSec;
+        descriptor.audio.aacProfile = audio.aacProfile;
+        return CanonicalProfileDescriptor(descriptor);
+    }
+
+    ProfileDescriptor MakeVideoTypeDescriptor(ProfileUse use, const VideoStreamFormat& format, uint32_t keyframeSpacing)
+    {
+        ProfileDescriptor descriptor = ProfileDescriptor();
+        descriptor.use = use;
+        descriptor.hasVideo = true;
+        descriptor.video = format;
+        descriptor.keyframeSpacing = keyframeSpacing;
+        return CanonicalProfileDescriptor(descriptor);
+    }
+
+    ProfileDescriptor MakeAudioTypeDescriptor(ProfileUse use, const AudioStreamFormat& format)
+    {
+        ProfileDescriptor descriptor = ProfileDescriptor();
+        descriptor.use = use;
+        descriptor.hasAudio = true;
+        descriptor.audio = format;
+        return CanonicalProfileDescriptor(descriptor);
+    }
+
+    bool operator==(const ProfileDescriptor& a, const ProfileDescriptor& b)
+    {
+        return a.use == b.use && a.container == b.container
+            && a.hasVideo == b.hasVideo
+            && a.video.codec == b.video.codec && a.video.pixelFormat == b.video.pixelFormat
+            && a.video.width == b.video.width && a.video.height == b.video.height
+            && a.video.fpsNumerator == b.video.fpsNumerator && a.video.fpsDenominator == b.video.fpsDenominator
+            && a.video.bitrate == b.video.bitrate && a.video.matrix == b.video.matrix && a.video.range == b.video.range
+            && a.videoProfile == b.videoProfile && a.keyframeSpacing == b.keyframeSpacing
+            && a.hasAudio == b.hasAudio
+            && a.audio.codec == b.audio.codec && a.audio.sampleRate == b.audio.sampleRate
+            && a.audio.channels == b.audio.channels && a.audio.bitsPerSample == b.audio.bitsPerSample
+            && a.audio.bytesPerSecond == b.audio.bytesPerSecond && a.audio.aacProfile == b.audio.aacProfile;
+    }
+
+    uint64_t HashProfileDescriptor(const ProfileDescriptor& descriptor)
+    {
+        // Field by field rather than over the struct's bytes, which would
+        // take in padding.
+        uint64_t hash = FNV_OFFSET_BASIS;
+        HashValue(hash, static_cast<uint32_t>(descriptor.use));
+        HashValue(hash, static_cast<uint32_t>(descriptor.container));
+        HashValue(hash, descriptor.hasVideo ? 1 : 0);
+        HashValue(hash, static_cast<uint32_t>(descriptor.video.codec));
+        HashValue(hash, static_cast<uint32_t>(descriptor.video.pixelFormat));
+        HashValue(hash, descriptor.video.width);
+        HashValue(hash, descriptor.video.height);
+        HashValue(hash, descriptor.video.fpsNumerator);
+        HashValue(hash, descriptor.video.fpsDenominator);
+        HashValue(hash, descriptor.video.bitrate);
+        HashValue(hash, static_cast<uint32_t>(descriptor.video.matrix));
+        HashValue(hash, static_cast<uint32_t>(descriptor.video.range));
+        HashValue(hash, descriptor.videoProfile);
+        HashValue(hash, descriptor.keyframeSpacing);
+        HashValue(hash, descriptor.hasAudio ? 1 : 0);
+        HashValue(hash, static_cast<uint32_t>(descriptor.audio.codec));
+        HashValue(hash, descriptor.audio.sampleRate);
+        HashValue(hash, descriptor.audio.channels);
+        HashValue(hash, descriptor.audio.bitsPerSample);
+        HashValue(hash, descriptor.audio.bytesPerSecond);
+        HashValue(hash, descriptor.audio.aacProfile);
+        return hash;
+    }
+
+    std::string DescribeProfile(const ProfileDescriptor& descriptor)
+    {
+        std::ostringstream out;
+        out << ProfileUseName(descriptor.use);
+        if (descriptor.use == ProfileUse::Transcode)
+        {
+            out << (descriptor.container == ContainerType::FragmentedMPEG4 ? " fmp4" : " mp4");
+        }
+        if (descriptor.hasVideo)
+        {
+            const VideoStreamFormat& video = descriptor.video;
+            out << " " << (video.codec == VideoCodec::Uncompressed ? PixelFormatName(video.pixelFormat) : VideoCodecName(video.codec))
+                << " " << video.width << "x" << video.height << " " << video.fpsNumerator << "/" << video.fpsDenominator;
+            if (descriptor.use == ProfileUse::StreamInput)
+            {
+                if (video.pixelFormat != PixelFormat::RGB32)
+                {
+                    out << (video.matrix == ColorMatrix::BT709 ? " bt709" : " bt601") << (video.range == ColorRange::Full ? " full" : " limited");
+                }
+            }
+            else
+            {
+                out << " " << video.bitrate << "bps";
+                if (video.codec == VideoCodec::H264)
+                {
+                    out << " profile " << descriptor.videoProfile;
+                }
+                out << " gop " << descriptor.keyframeSpacing;
+            }
+        }
+        if (descriptor.hasAudio)
+        {
+            const AudioStreamFormat& audio = descriptor.audio;
+            out << (descriptor.hasVideo ? "," : "") << " " << (audio.codec == AudioCodec::AAC ? "aac" : "pcm")
+                << " " << audio.sampleRate << "Hz x" << audio.channels << " " << audio.bitsPerSample << "bit";
+            if (audio.codec == AudioCodec::AAC)
+            {
+                out << " " << audio.bytesPerSecond << "B/s level " << audio.aacProfile;
+            }
+        }
+        return out.str();
+    }
+
+}
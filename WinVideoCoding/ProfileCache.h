@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "EncoderProfiles.h"
+#include "VideoSink.h"
+
+namespace VideoCoding
+{
+
+    enum class ProfileUse
+    {
+        Transcode,      // a transcode profile: container, video and audio
+        StreamOutput,   // a sink writer stream's output media type
+        StreamInput,    // a sink writer stream's input media type
+    };
+
+    enum class ContainerType
+    {
+        MPEG4,
+        FragmentedMPEG4,
+    };
+
+    // Everything that goes into a transcode profile or a stream's media type,
+    // as plain values. The Make*Descriptor functions fill in only what the
+    // object is built from and leave the rest zero, so two descriptors that
+    // would build the same object compare equal; build descriptors with
+    // them, or pass hand-made ones through CanonicalProfileDescriptor().
+    struct ProfileDescriptor
+    {
+        ProfileUse use;
+        ContainerType container;    // Transcode only
+        bool hasVideo;
+        VideoStreamFormat video;
+        uint32_t videoProfile;      // H.264 profile_idc, 0 leaves it to the encoder
+        uint32_t keyframeSpacing;   // frames, 0 leaves it to the encoder
+        bool hasAudio;
+        AudioStreamFormat audio;
+    };
+
+    // Frame rate reduced to lowest terms, fields the object doesn't use
+    // cleared: the pixel format and colour description of compressed
+    // video, the bitrate and key frame spacing of input types, the container
+    // outside transcode profiles, a stream's other media kind.
+    ProfileDescriptor CanonicalProfileDescriptor(const ProfileDescriptor& descriptor);
+
+    // h264_profiles and aac_profiles entries as one transcode profile.
+    ProfileDescriptor MakeTranscodeDescriptor(const AACProfileInfo& audio, const H264ProfileInfo& video, uint32_t keyframeSpacing, ContainerType container);
+
+    ProfileDescriptor MakeVideoTypeDescriptor(ProfileUse use, const VideoStreamFormat& format, uint32_t keyframeSpacing = 0);
+    ProfileDescriptor MakeAudioTypeDescriptor(ProfileUse use, const AudioStreamFormat& format);
+
+    // Field by field; both sides should be canonical.
+    bool operator==(const ProfileDescriptor& a, const ProfileDescriptor& b);
+    inline bool operator!=(const ProfileDescriptor& a, const ProfileDescriptor& b) { return !(a == b); }
+
+    // FNV-1a over every field. Stable across runs and platforms.
+    uint64_t HashProfileDescriptor(const ProfileDescriptor& descriptor);
+
+    struct ProfileDescriptorHash
+    {
+        size_t operator()(const ProfileDescriptor& descriptor) const { return static_cast<size_t>(HashProfileDescriptor(descriptor)); }
+    };
+
+    // One line for logs, e.g.
+    // "transcode mp4 h264 176x144 15/1 128000bps profile 66 gop 0, aac 44100Hz x2 16bit 16000B/s level 41".
+    std::string DescribeProfile(const ProfileDescriptor& descriptor);
+
+    // ------------------------------------------------------------------------
+
+    struct ProfileCacheStats
+    {
+        uint64_t hits;          // get() found the entry, possibly still being built
+        uint64_t misses;        // get() built the entry
+        uint64_t failures;      // builds that threw
+        size_t entries;
+    };
+
+    // Ready-made objects keyed by their canonical descriptor, built once and
+    // then shared by every caller that asks for the same thing. Entries are
+    // never modified or replaced once built; callers must treat what they
+    // get as read-only.
+    //
+    // Thread safe. Concurrent first requests for one descriptor build it
+    // once, the others wait for that build rather than start their own. A
+    // build that throws passes its exception to everyone waiting on it and
+    // leaves no entry, so the next request tries again. Builds of different
+    // descriptors run in parallel; the lock is only held for the lookup.
+    //
+    // Unbounded: the keys come from the profile tables and the handful of
+    // geometries a process uses.
+    template<typename T>
+    class ProfileCache
+    {
+    public:
+        typedef std::shared_ptr<const T> Entry;
+
+        ProfileCache() : nextSlot(0), stats_() {}
+
+        ProfileCache(const ProfileCache&) = delete;
+        ProfileCache& operator=(const ProfileCache&) = delete;
+
+        // `create` is called as create(canonicalDescriptor) and returns a T.
+        template<typename Factory>
+        Entry get(const ProfileDescriptor& descriptor, Factory create)
+        {
+            const ProfileDescriptor key = CanonicalProfileDescriptor(descriptor);
+            std::promise<Entry> promise;
+            std::shared_future<Entry> pending;
+            uint64_t slotId = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                typename Slots::const_iterator found = slots.find(key);
+                if (found != slots.end())
+                {
+                    ++stats_.hits;
+                    pending = found->second.entry;
+                }
+                else
+                {
+                    ++stats_.misses;
+                    slotId = ++nextSlot;
+                    const Slot slot = { promise.get_future().share(), slotId };
+                    slots.emplace(key, slot);
+                }
+            }
+            if (pending.valid())
+            {
+                // Waits outside the lock for a build still in progress.
+                return pending.get();
+            }
+
+            try
+            {
+                Entry entry = std::make_shared<const T>(create(key));
+                promise.set_value(entry);
+                return entry;
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+                std::lock_guard<std::mutex> lock(mutex);
+                ++stats_.failures;
+                typename Slots::iterator found = slots.find(key);
+                if (found != slots.end() && found->second.id == slotId)
+                {
+                    slots.erase(found);
+                }
+                throw;
+            }
+        }
+
+        // Forgets every entry. Objects already handed out stay valid for as
+        // long as their holders keep them.
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots.clear();
+        }
+
+        ProfileCacheStats stats() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ProfileCacheStats result = stats_;
+            result.entries = slots.size();
+            return result;
+        }
+
+    private:
+        struct Slot
+        {
+            std::shared_future<Entry> entry;
+            uint64_t id;        // tells a retried build's slot from a failed one's
+        };
+
+        typedef std::unordered_map<ProfileDescriptor, Slot, ProfileDescriptorHash> Slots;
+
+        mutable std::mutex mutex;
+        Slots slots;
+        uint64_t nextSlot;
+        ProfileCacheStats stats_;
+    };
+
+}
@@ -0,0 +1,437 @@
+#include "ProfileSweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "ColorConversion.h"
+#include "MemoryFrameBuffer.h"
+#include "TestPattern.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#else
+#include <unistd.h>
+#endif
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        // How often the working set is sampled during an encode.
+        const std::chrono::milliseconds MEMORY_SAMPLE_INTERVAL(5);
+
+        const char CSV_HEADER[] = "audio_profile,video_profile,succeeded,seconds,media_seconds,output_bytes,fps,realtime_factor,output_bitrate,memory_growth,error";
+
+        // One side of an AUDIO:VIDEO pair, '*' giving every index below `count`.
+        std::vector<int> ParseProfileIndices(const std::string& text, size_t count, const std::string& pair)
+        {
+            std::vector<int> indices;
+            if (text == "*")
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    indices.push_back(static_cast<int>(i));
+                }
+                return indices;
+            }
+            size_t used = 0;
+            int value = -1;
+            try
+            {
+                value = std::stoi(text, &used);
+            }
+            catch (const std::exception&)
+            {
+                used = 0;
+            }
+            if (used == 0 || used != text.size() || value < 0 || static_cast<size_t>(value) >= count)
+            {
+                throw std::invalid_argument("bad profile in '" + pair + "': " + text);
+            }
+            indices.push_back(value);
+            return indices;
+        }
+
+        std::pair<int, int> Key(const ProfileSweepPoint& point)
+        {
+            return std::make_pair(point.audioProfile, point.videoProfile);
+        }
+
+        // Commas and line breaks would split the CSV record.
+        std::string CsvField(const std::string& text)
+        {
+            std::string field = text;
+            std::replace(field.begin(), field.end(), ',', ';');
+            std::replace(field.begin(), field.end(), '\n', ' ');
+            std::replace(field.begin(), field.end(), '\r', ' ');
+            return field;
+        }
+
+        void WriteJsonString(std::ostream& out, const std::string& text)
+        {
+            out << '"';
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out << '\\' << c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out << ' ';
+                }
+                else
+                {
+                    out << c;
+                }
+            }
+            out << '"';
+        }
+    }
+
+    std::vector<ProfileSweepPoint> ParseProfileGrid(const std::string& text)
+    {
+        std::vector<ProfileSweepPoint> points;
+        std::istringstream in(text);
+        std::string pair;
+        while (std::getline(in, pair, ','))
+        {
+            const size_t colon = pair.find(':');
+            if (colon == std::string::npos)
+            {
+                throw std::invalid_argument("expected AUDIO:VIDEO, got '" + pair + "'");
+            }
+            for (int audio : ParseProfileIndices(pair.substr(0, colon), AAC_PROFILE_COUNT, pair))
+            {
+                for (int video : ParseProfileIndices(pair.substr(colon + 1), H264_PROFILE_COUNT, pair))
+                {
+                    const ProfileSweepPoint point = { audio, video };
+                    const bool listed = std::any_of(points.begin(), points.end(),
+                        [&](const ProfileSweepPoint& p) { return Key(p) == Key(point); });
+                    if (!listed)
+                    {
+                        points.push_back(point);
+                    }
+                }
+            }
+        }
+        if (points.empty())
+        {
+            throw std::invalid_argument("empty profile grid");
+        }
+        return points;
+    }
+
+    uint64_t ProcessMemoryUsage()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return 0;
+        }
+        return counters.WorkingSetSize;
+#else
+        std::ifstream statm("/proc/self/statm");
+        uint64_t size = 0;
+        uint64_t resident = 0;
+        if (!(statm >> size >> resident))
+        {
+            return 0;
+        }
+        return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+    std::vector<ProfileSweepResult> RunProfileSweep(const std::vector<ProfileSweepPoint>& points, const std::string& input,
+        const std::string& outputPrefix, TranscodeRunner& runner)
+    {
+        std::vector<ProfileSweepResult> results;
+        for (const ProfileSweepPoint& point : points)
+        {
+            const std::string output = outputPrefix + ".a" + std::to_string(point.audioProfile) + ".v" + std::to_string(point.videoProfile) + ".mp4";
+            const TranscodeJob job = { input, output, point.audioProfile, point.videoProfile, 0, 0, 0, 0 };
+
+            ProfileSweepResult result = ProfileSweepResult();
+            result.point = point;
+
+            std::atomic<bool> done(false);
+            const uint64_t before = ProcessMemoryUsage();
+            std::atomic<uint64_t> peak(before);
+            std::thread sampler([&]
+            {
+                while (!done.load())
+                {
+                    std::this_thread::sleep_for(MEMORY_SAMPLE_INTERVAL);
+                    peak = std::max<uint64_t>(peak.load(), ProcessMemoryUsage());
+                }
+            });
+
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            try
+            {
+                const TranscodeOutcome outcome = runner.transcode(job);
+                result.succeeded = true;
+                result.mediaDuration = outcome.mediaDuration;
+                result.outputBytes = outcome.outputBytes;
+            }
+            catch (const std::exception& err)
+            {
+                result.error = err.what();
+            }
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            done = true;
+            sampler.join();
+            result.memoryGrowth = std::max<uint64_t>(peak.load(), ProcessMemoryUsage()) - before;
+            std::remove(output.c_str());
+
+            const double mediaSeconds = result.mediaDuration / 1e7;
+            if (result.succeeded && result.seconds > 0 && mediaSeconds > 0)
+            {
+                const H264ProfileInfo& profile = h264_profiles[point.videoProfile];
+                result.framesPerSecond = mediaSeconds * profile.fpsNumerator / profile.fpsDenominator / result.seconds;
+                result.realtimeFactor = mediaSeconds / result.seconds;
+                result.outputBitrate = result.outputBytes * 8.0 / mediaSeconds;
+            }
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    TranscodeOutcome SyntheticTranscodeRunner::transcode(const TranscodeJob& job)
+    {
+        return transcodeWithProgress(job, TranscodeProgressCallback());
+    }
+
+    TranscodeOutcome SyntheticTranscodeRunner::transcodeWithProgress(const TranscodeJob& job, const TranscodeProgressCallback& onProgress)
+    {
+        if (job.videoProfile < 0 || static_cast<size_t>(job.videoProfile) >= H264_PROFILE_COUNT ||
+            job.audioProfile < 0 || static_cast<size_t>(job.audioProfile) >= AAC_PROFILE_COUNT)
+        {
+            throw TranscodeError("no such profile", false);
+        }
+        const H264ProfileInfo& video = h264_profiles[job.videoProfile];
+        const AACProfileInfo& audio = aac_profiles[job.audioProfile];
+
+        const uint64_t frameCount = static_cast<uint64_t>(mediaSeconds * video.fpsNumerator / video.fpsDenominator);
+        const TestPatternSettings settings = { TestPatternKind::MovingBoxes, 1, 0.25 };
+        TestPatternProducer pattern(settings);
+        ColorConverter converter(ColorMatrix::BT601, ColorRange::Limited);
+        MemoryFrameBuffer rgb(video.width, video.height, PixelFormat::RGB32);
+        MemoryFrameBuffer nv12(video.width, video.height, PixelFormat::NV12);
+        const int64_t frameDuration = static_cast<int64_t>(10000000ull * video.fpsDenominator / video.fpsNumerator);
+        // Throttled as the encoding session's progress is.
+        SessionNotifier notifier;
+        notifier.setDuration(static_cast<int64_t>(frameCount) * frameDuration);
+        if (onProgress)
+        {
+            notifier.onProgress(onProgress);
+        }
+        for (uint64_t i = 0; i < frameCount; ++i)
+        {
+            pattern.render(rgb.view(), i);
+            converter.convert(rgb.view(), nv12.view());
+            notifier.reportPosition(static_cast<int64_t>(i + 1) * frameDuration);
+        }
+        notifier.complete(0);
+
+        TranscodeOutcome outcome;
+        outcome.mediaDuration = static_cast<int64_t>(frameCount * 10000000 * video.fpsDenominator / video.fpsNumerator);
+        const double seconds = outcome.mediaDuration / 1e7;
+        outcome.outputBytes = static_cast<uint64_t>((video.bitrate / 8.0 + audio.bytesPerSec) * seconds);
+        return outcome;
+    }
+
+    // ------------------------------------------------------------------------
+
+    std::vector<ProfileSweepRegression> CompareProfileSweep(const std::vector<ProfileSweepResult>& results,
+        const std::vector<ProfileSweepResult>& baseline, double tolerance)
+    {
+        std::map<std::pair<int, int>, const ProfileSweepResult*> before;
+        for (const ProfileSweepResult& result : baseline)
+        {
+            before[Key(result.point)] = &result;
+        }
+
+        std::vector<ProfileSweepRegression> regressions;
+        const auto add = [&](const ProfileSweepPoint& point, const char* metric, double was, double now)
+        {
+            const ProfileSweepRegression regression = { point, metric, was, now };
+            regressions.push_back(regression);
+        };
+        for (const ProfileSweepResult& result : results)
+        {
+            const auto found = before.find(Key(result.point));
+            if (found == before.end() || !found->second->succeeded)
+            {
+                continue;
+            }
+            const ProfileSweepResult& was = *found->second;
+            if (!result.succeeded)
+            {
+                add(result.point, "failed", 1, 0);
+                continue;
+            }
+            if (result.framesPerSecond < was.framesPerSecond * (1 - tolerance))
+            {
+                add(result.point, "fps", was.framesPerSecond, result.framesPerSecond);
+            }
+            // A baseline without a figure (0, or a column it lacks) can't
+            // regress on it.
+            if (was.outputBitrate > 0 && result.outputBitrate > was.outputBitrate * (1 + tolerance))
+            {
+                add(result.point, "output_bitrate", was.outputBitrate, result.outputBitrate);
+            }
+            // A baseline from before memory growth was recorded has no
+            // memory_growth column, and so no figure.
+            if (was.memoryGrowth > 0 && result.memoryGrowth > was.memoryGrowth * (1 + tolerance)
+                && result.memoryGrowth > was.memoryGrowth + MEMORY_GROWTH_SLACK)
+            {
+                add(result.point, "memory_growth", static_cast<double>(was.memoryGrowth), static_cast<double>(result.memoryGrowth));
+            }
+        }
+        return regressions;
+    }
+
+    void WriteProfileSweepCsv(std::ostream& out, const std::vector<ProfileSweepResult>& results)
+    {
+        out << CSV_HEADER << "\n";
+        for (const ProfileSweepResult& r : results)
+        {
+            out << r.point.audioProfile << "," << r.point.videoProfile << "," << (r.succeeded ? 1 : 0) << "," << r.seconds
+                << "," << r.mediaDuration / 1e7 << "," << r.outputBytes << "," << r.framesPerSecond << "," << r.realtimeFactor
+                << "," << r.outputBitrate << "," << r.memoryGrowth << "," << CsvField(r.error) << "\n";
+        }
+    }
+
+    std::vector<ProfileSweepResult> ReadProfileSweepCsv(std::istream& in)
+    {
+        const auto split = [](const std::string& line)
+        {
+            std::vector<std::string> fields;
+            std::istringstream fieldStream(line);
+            std::string field;
+            while (std::getline(fieldStream, field, ','))
+            {
+                fields.push_back(field);
+            }
+            return fields;
+        };
+
+        std::string line;
+        if (!std::getline(in, line))
+        {
+            throw std::runtime_error("profile sweep CSV: empty");
+        }
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        std::map<std::string, size_t> columns;
+        const std::vector<std::string> header = split(line);
+        for (size_t i = 0; i < header.size(); ++i)
+        {
+            columns[header[i]] = i;
+        }
+        if (columns.count("audio_profile") == 0 || columns.count("video_profile") == 0)
+        {
+            throw std::runtime_error("profile sweep CSV: missing profile columns");
+        }
+
+        std::vector<ProfileSweepResult> results;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty())
+            {
+                continue;
+            }
+            const std::vector<std::string> fields = split(line);
+            const auto field = [&](const char* name) -> std::string
+            {
+                const auto column = columns.find(name);
+                return column != columns.end() && column->second < fields.size() ? fields[column->second] : std::string();
+            };
+            const auto number = [&](const char* name)
+            {
+                const std::string text = field(name);
+                return text.empty() ? 0.0 : std::stod(text);
+            };
+
+            ProfileSweepResult result = ProfileSweepResult();
+            result.point.audioProfile = static_cast<int>(number("audio_profile"));
+            result.point.videoProfile = static_cast<int>(number("video_profile"));
+            result.succeeded = field("succeeded") != "0";
+            result.error = field("error");
+            result.seconds = number("seconds");
+            result.mediaDuration = static_cast<int64_t>(number("media_seconds") * 1e7);
+            result.outputBytes = static_cast<uint64_t>(number("output_bytes"));
+            result.framesPerSecond = number("fps");
+            result.realtimeFactor = number("realtime_factor");
+            result.outputBitrate = number("output_bitrate");
+            result.memoryGrowth = static_cast<uint64_t>(number("memory_growth"));
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    void WriteProfileSweepJson(std::ostream& out, const std::vector<ProfileSweepResult>& results, const std::vector<ProfileSweepRegression>& regressions)
+    {
+        out << "{\n  \"profiles\": [\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const ProfileSweepResult& r = results[i];
+            out << "    { \"audio_profile\": " << r.point.audioProfile << ", \"video_profile\": " << r.point.videoProfile
+                << ", \"succeeded\": " << (r.succeeded ? "true" : "false") << ", \"seconds\": " << r.seconds
+                << ", \"media_seconds\": " << r.mediaDuration / 1e7 << ", \"output_bytes\": " << r.outputBytes
+                << ", \"fps\": " << r.framesPerSecond << ", \"realtime_factor\": " << r.realtimeFactor
+                << ", \"output_bitrate\": " << r.outputBitrate << ", \"memory_growth\": " << r.memoryGrowth << ", \"error\": ";
+            WriteJsonString(out, r.error);
+            out << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"regressions\": [\n";
+        for (size_t i = 0; i < regressions.size(); ++i)
+        {
+            const ProfileSweepRegression& r = regressions[i];
+            out << "    { \"audio_profile\": " << r.point.audioProfile << ", \"video_profile\": " << r.point.videoProfile
+                << ", \"metric\": \"" << r.metric << "\", \"baseline\": " << r.baseline << ", \"current\": " << r.current
+                << " }" << (i + 1 < regressions.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+
+    void WriteProfileSweepSummary(std::ostream& out, const std::vector<ProfileSweepResult>& results, const std::vector<ProfileSweepRegression>& regressions)
+    {
+        for (const ProfileSweepResult& r : results)
+        {
+            out << "profile a" << r.point.audioProfile << " v" << r.point.videoProfile << ": ";
+            if (!r.succeeded)
+            {
+                out << "FAILED - " << r.error << "\n";
+                continue;
+            }
+            out << r.framesPerSecond << " fps, " << r.realtimeFactor << "x realtime, " << r.outputBitrate / 1000 << " kbit/s, +"
+                << (r.memoryGrowth >> 20) << " MB\n";
+        }
+        for (const ProfileSweepRegression& r : regressions)
+        {
+            out << "REGRESSION a" << r.point.audioProfile << " v" << r.point.videoProfile << " " << r.metric << ": "
+                << r.baseline << " -> " << r.current << "\n";
+        }
+    }
+
+}
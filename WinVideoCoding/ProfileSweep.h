@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "EncoderProfiles.h"
+#include "TranscodeScheduler.h"
+
+namespace VideoCoding
+{
+
+    // One audio/video combination of the profile tables.
+    struct ProfileSweepPoint
+    {
+        int audioProfile;
+        int videoProfile;
+    };
+
+    // Comma separated AUDIO:VIDEO pairs, where either side may be '*' for
+    // every entry of its table: "*:*" is the full grid, "0:*" every video
+    // profile with AAC profile 0, "1:3,2:3" just those two. A point listed
+    // twice is swept once, where it first appears. Throws
+    // std::invalid_argument for malformed text or an index out of range.
+    std::vector<ProfileSweepPoint> ParseProfileGrid(const std::string& text);
+
+    struct ProfileSweepResult
+    {
+        ProfileSweepPoint point;
+        bool succeeded;
+        std::string error;          // empty on success
+        double seconds;             // wall time of the encode
+        int64_t mediaDuration;      // 100 ns units
+        uint64_t outputBytes;
+        double framesPerSecond;     // at the profile's frame rate
+        double realtimeFactor;      // media time per wall time
+        double outputBitrate;       // bits per second of media, container included
+        uint64_t memoryGrowth;      // largest rise of the working set over its level just before
+                                    // the encode, so what earlier points left allocated doesn't count
+    };
+
+    // Working set (resident size) of this process, 0 where unknown.
+    uint64_t ProcessMemoryUsage();
+
+    // Encodes `input` once per point, one after the other so runs don't
+    // compete, with the output going to "<outputPrefix>.a<A>.v<V>.mp4"
+    // (deleted afterwards). A failed point is reported and the sweep goes
+    // on. Memory is sampled every few milliseconds while each runs.
+    std::vector<ProfileSweepResult> RunProfileSweep(const std::vector<ProfileSweepPoint>& points, const std::string& input,
+        const std::string& outputPrefix, TranscodeRunner& runner);
+
+    // Stands in for the Media Foundation encoder where there is none, so the
+    // sweep can run anywhere. "Encodes" `mediaSeconds` of the job's video
+    // profile by rendering and colour converting every frame at its size and
+    // reports the bytes its bitrates would give. The input is ignored and
+    // nothing is written.
+    class SyntheticTranscodeRunner : public TranscodeRunner
+    {
+    public:
+        explicit SyntheticTranscodeRunner(double mediaSeconds) : mediaSeconds(mediaSeconds) {}
+
+        TranscodeOutcome transcode(const TranscodeJob& job) override;
+        TranscodeOutcome transcodeWithProgress(const TranscodeJob& job, const TranscodeProgressCallback& onProgress) override;
+
+    private:
+        const double mediaSeconds;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // See CompareProfileSweep.
+    const uint64_t MEMORY_GROWTH_SLACK = 8 << 20;
+
+    struct ProfileSweepRegression
+    {
+        ProfileSweepPoint point;
+        std::string metric;         // "fps", "output_bitrate", "memory_growth" or "failed"
+        double baseline;
+        double current;
+    };
+
+    // Points that got worse than the baseline by more than `tolerance`
+    // (0.1 is 10%): slower, larger output, more memory, or failing where the
+    // baseline succeeded. Memory growth must also exceed the baseline by
+    // MEMORY_GROWTH_SLACK, since small rises are mostly allocator noise.
+    // Points missing from either side are skipped.
+    std::vector<ProfileSweepRegression> CompareProfileSweep(const std::vector<ProfileSweepResult>& results,
+        const std::vector<ProfileSweepResult>& baseline, double tolerance);
+
+    // The CSV doubles as the baseline format. ReadProfileSweepCsv finds
+    // columns by their header name, so older files with fewer columns still
+    // load; throws std::runtime_error without the profile columns.
+    void WriteProfileSweepCsv(std::ostream& out, const std::vector<ProfileSweepResult>& results);
+    std::vector<ProfileSweepResult> ReadProfileSweepCsv(std::istream& in);
+
+    void WriteProfileSweepJson(std::ostream& out, const std::vector<ProfileSweepResult>& results,
+        const std::vector<ProfileSweepRegression>& regressions = std::vector<ProfileSweepRegression>());
+    void WriteProfileSweepSummary(std::ostream& out, const std::vector<ProfileSweepResult>& results,
+        const std::vector<ProfileSweepRegression>& regressions = std::vector<ProfileSweepRegression>());
+
+}
@@ -0,0 +1,143 @@
+#include "RawFrameReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        const char Y4M_SIGNATURE[] = "YUV4MPEG2 ";
+        const char Y4M_FRAME[] = "FRAME";
+        const size_t Y4M_MAX_LINE = 1024;
+
+        // Offset just past the '\n' ending the line at `offset`.
+        uint64_t LineEnd(MappedFile& file, uint64_t offset)
+        {
+            const size_t length = static_cast<size_t>(std::min<uint64_t>(Y4M_MAX_LINE, file.size() - offset));
+            const uint8_t* line = file.map(offset, length);
+            const void* newline = std::memchr(line, '\n', length);
+            if (newline == nullptr)
+            {
+                throw std::runtime_error("Y4M: line too long or missing");
+            }
+            return offset + (static_cast<const uint8_t*>(newline) - line) + 1;
+        }
+    }
+
+    RawFrameReader::RawFrameReader(const std::string& path, const RawFrameFormat& format, size_t window)
+        : format(format), file(path, window), frameBytes(0), firstFrame(0), frameStride(0), markerBytes(0), frameCount(0)
+    {
+        if (IsY4mPath(path))
+        {
+            readY4mHeader();
+        }
+        else if (format.width == 0 || format.height == 0 ||
+            (format.format != PixelFormat::RGB32 && (format.width % 2 != 0 || format.height % 2 != 0)))
+        {
+            throw std::invalid_argument("RawFrameReader: raw input needs a size, even for NV12/I420");
+        }
+
+        frameBytes = FrameBytes(this->format.format, this->format.width, this->format.height);
+        frameStride = markerBytes + frameBytes;
+        frameCount = (file.size() - firstFrame) / frameStride;
+        file.setReadahead(static_cast<size_t>(frameStride));
+    }
+
+    void RawFrameReader::readY4mHeader()
+    {
+        if (file.size() < sizeof(Y4M_SIGNATURE) - 1 || std::memcmp(file.map(0, sizeof(Y4M_SIGNATURE) - 1), Y4M_SIGNATURE, sizeof(Y4M_SIGNATURE) - 1) != 0)
+        {
+            throw std::runtime_error("Y4M: missing YUV4MPEG2 signature");
+        }
+        const uint64_t headerEnd = LineEnd(file, 0);
+        const uint8_t* header = file.map(0, static_cast<size_t>(headerEnd));
+        std::istringstream fields(std::string(reinterpret_cast<const char*>(header) + sizeof(Y4M_SIGNATURE) - 1,
+            static_cast<size_t>(headerEnd) - sizeof(Y4M_SIGNATURE)));
+
+        format.format = PixelFormat::I420;
+        format.width = 0;
+        format.height = 0;
+        format.fpsNumerator = 0;
+        format.fpsDenominator = 1;
+        std::string field;
+        while (fields >> field)
+        {
+            const std::string value = field.substr(1);
+            switch (field[0])
+            {
+            case 'W':
+                format.width = static_cast<uint32_t>(std::stoul(value));
+                break;
+            case 'H':
+                format.height = static_cast<uint32_t>(std::stoul(value));
+                break;
+            case 'F':
+            {
+                const size_t colon = value.find(':');
+                if (colon == std::string::npos)
+                {
+                    throw std::runtime_error("Y4M: bad frame rate " + value);
+                }
+                format.fpsNumerator = static_cast<uint32_t>(std::stoul(value.substr(0, colon)));
+                format.fpsDenominator = static_cast<uint32_t>(std::stoul(value.substr(colon + 1)));
+                break;
+            }
+            case 'C':
+                if (value.compare(0, 3, "420") != 0)
+                {
+                    throw std::runtime_error("Y4M: only 4:2:0 is supported, not C" + value);
+                }
+                break;
+            default:
+                // Interlacing, aspect ratio and extensions don't change the layout.
+                break;
+            }
+        }
+        if (format.width == 0 || format.height == 0 || format.width % 2 != 0 || format.height % 2 != 0)
+        {
+            throw std::runtime_error("Y4M: frame size missing or odd");
+        }
+
+        firstFrame = headerEnd;
+        if (firstFrame < file.size())
+        {
+            markerBytes = static_cast<size_t>(LineEnd(file, firstFrame) - firstFrame);
+        }
+        else
+        {
+            markerBytes = sizeof(Y4M_FRAME);
+        }
+    }
+
+    FrameView RawFrameReader::frame(uint64_t index)
+    {
+        if (index >= frameCount)
+        {
+            throw std::out_of_range("RawFrameReader: frame past the end");
+        }
+        const uint8_t* data = file.map(firstFrame + index * frameStride, static_cast<size_t>(frameStride));
+        if (markerBytes > 0 && (std::memcmp(data, Y4M_FRAME, sizeof(Y4M_FRAME) - 1) != 0 || data[markerBytes - 1] != '\n'))
+        {
+            throw std::runtime_error("Y4M: frame marker missing; per-frame parameters must not change length");
+        }
+        // The mapping is read-only; FrameView is shared with writers.
+        FrameView view = { const_cast<uint8_t*>(data + markerBytes), static_cast<ptrdiff_t>(RowBytes(format.format, format.width)),
+            format.width, format.height, format.format, 0 };
+        return view;
+    }
+
+    bool IsY4mPath(const std::string& path)
+    {
+        return path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+    }
+
+    void MappedFrameProducer::render(const FrameView& frame, uint64_t frameIndex)
+    {
+        CopyFrameRows(reader.frame(frameIndex), frame, 0, frame.height, kernels);
+    }
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "FrameGeometry.h"
+#include "FrameView.h"
+#include "MappedFile.h"
+
+namespace VideoCoding
+{
+
+    struct RawFrameFormat
+    {
+        PixelFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t fpsNumerator;      // 0 when the file doesn't say
+        uint32_t fpsDenominator;
+    };
+
+    // Uncompressed capture read through a sliding memory mapping: either
+    // YUV4MPEG2 (4:2:0, read as I420; size and rate come from the header) or
+    // frames back to back in the given format, the layouts RawVideoSink
+    // writes. Frames are handed out as views into the mapping, nothing is
+    // copied. Frames are meant to be read in order; going backwards works
+    // but remaps.
+    //
+    // The mapping window should hold a few frames; each frame hints the OS
+    // to read the next one ahead. A partial frame at the end is ignored.
+    //
+    // Not thread-safe. Throws std::runtime_error on a malformed file,
+    // std::invalid_argument for an unusable raw format and std::out_of_range
+    // for a frame past the end.
+    class RawFrameReader
+    {
+    public:
+        // Reads the header of a *.y4m file, ignoring `format`.
+        explicit RawFrameReader(const std::string& path, const RawFrameFormat& format = RawFrameFormat(), size_t window = DEFAULT_MAP_WINDOW);
+
+        const RawFrameFormat& getFormat() const { return format; }
+        uint64_t getFrameCount() const { return frameCount; }
+
+        // Read-only view of frame `index`, valid until the next call.
+        FrameView frame(uint64_t index);
+
+        MappedFileStats getStats() const { return file.getStats(); }
+
+    private:
+        void readY4mHeader();
+
+        RawFrameFormat format;
+        MappedFile file;
+        size_t frameBytes;
+        uint64_t firstFrame;        // offset of the first frame's data
+        uint64_t frameStride;       // frame data plus its Y4M marker
+        size_t markerBytes;         // "FRAME\n" before each Y4M frame, 0 for raw
+        uint64_t frameCount;
+    };
+
+    // Whether the path names a YUV4MPEG2 file, by extension.
+    bool IsY4mPath(const std::string& path);
+
+    // Fills sink frames from a RawFrameReader with a row copy straight from
+    // the mapping into the sink's buffer, so the sink's input format must be
+    // the file's. For a single producer thread, frames in order.
+    class MappedFrameProducer : public FrameProducer
+    {
+    public:
+        explicit MappedFrameProducer(RawFrameReader& reader, KernelDispatch kernels = KernelDispatch::Specialized) : reader(reader), kernels(kernels) {}
+
+        void render(const FrameView& frame, uint64_t frameIndex) override;
+
+    private:
+        RawFrameReader& reader;
+        const KernelDispatch kernels;
+    };
+
+}
@@ -0,0 +1,264 @@
+#include "RawVideoSink.h"
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        // Large enough to hold any de-interleaved chroma row.
+        const size_t MIN_WRITE_BUFFER = 64 << 10;
+    }
+
+    RawVideoSink::RawVideoSink(const std::string& path, RawContainer container, size_t writeBufferSize, size_t poolCapacity)
+        : container(container), file(nullptr), ownsFile(false), hasStream(false), writing(false), input(),
+          writeBuffer(writeBufferSize < MIN_WRITE_BUFFER ? MIN_WRITE_BUFFER : writeBufferSize), buffered(0), poolCapacity(poolCapacity), stats()
+    {
+        if (path == "-")
+        {
+            file = stdout;
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        }
+        else
+        {
+            file = std::fopen(path.c_str(), "wb");
+            ownsFile = true;
+        }
+        if (file == nullptr)
+        {
+            throw std::runtime_error("RawVideoSink: cannot open " + path);
+        }
+        // All buffering happens in writeBuffer.
+        std::setvbuf(file, nullptr, _IONBF, 0);
+    }
+
+    RawVideoSink::~RawVideoSink()
+    {
+        if (file != nullptr)
+        {
+            try
+            {
+                finalize();
+            }
+            catch (const std::exception&)
+            {
+            }
+        }
+    }
+
+    uint32_t RawVideoSink::addStream(const VideoStreamFormat&)
+    {
+        if (hasStream)
+        {
+            throw std::logic_error("RawVideoSink: only one stream is supported");
+        }
+        hasStream = true;
+        return 0;
+    }
+
+    void RawVideoSink::setInputFormat(uint32_t streamIndex, const VideoStreamFormat& inputFormat)
+    {
+        checkStream(streamIndex);
+        if (inputFormat.codec != VideoCodec::Uncompressed)
+        {
+            throw std::invalid_argument("RawVideoSink: input must be uncompressed");
+        }
+        if (container == RawContainer::Y4M && inputFormat.pixelFormat == PixelFormat::RGB32)
+        {
+            throw std::invalid_argument("RawVideoSink: Y4M output needs NV12 or I420 input");
+        }
+        input = inputFormat;
+        HeapAlignedBufferBackend backend(FrameBytes(input.pixelFormat, input.width, input.height));
+        pool.reset(new FramePool<HeapAlignedBufferBackend>(backend, poolCapacity));
+        pool->preallocate();
+    }
+
+    void RawVideoSink::beginWriting()
+    {
+        if (!pool)
+        {
+            throw std::logic_error("RawVideoSink: setInputFormat() was not called");
+        }
+        if (container == RawContainer::Y4M)
+        {
+            std::ostringstream header;
+            header << "YUV4MPEG2 W" << input.width << " H" << input.height
+                << " F" << input.fpsNumerator << ":" << input.fpsDenominator
+                << " Ip A1:1 C420jpeg XCOLORRANGE=" << (input.range == ColorRange::Full ? "FULL" : "LIMITED") << "\n";
+            const std::string text = header.str();
+            append(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        }
+        writing = true;
+    }
+
+    SinkFrame RawVideoSink::acquireFrame(uint32_t streamIndex)
+    {
+        checkStream(streamIndex);
+        AlignedBuffer* buffer = pool->acquire();
+        SinkFrame frame;
+        FrameView view = { buffer->get(), static_cast<ptrdiff_t>(RowBytes(input.pixelFormat, input.width)), input.width, input.height, input.pixelFormat, buffer->getId() };
+        frame.view = view;
+        frame.handle = buffer;
+        return frame;
+    }
+
+    void RawVideoSink::writeFrame(uint32_t streamIndex, SinkFrame& frame, int64_t, int64_t)
+    {
+        checkStream(streamIndex);
+        if (!writing)
+        {
+            throw std::logic_error("RawVideoSink: beginWriting() was not called");
+        }
+
+        const FrameView& view = frame.view;
+        if (container == RawContainer::Y4M)
+        {
+            static const char marker[] = "FRAME\n";
+            append(reinterpret_cast<const uint8_t*>(marker), sizeof(marker) - 1);
+        }
+
+        if (view.format == PixelFormat::RGB32)
+        {
+            appendPlane(view.data, view.stride, RowBytes(view.format, view.width), view.height);
+        }
+        else
+        {
+            appendPlane(view.plane(0), view.planeStride(0), view.width, view.height);
+            if (view.format == PixelFormat::NV12 && container == RawContainer::Y4M)
+            {
+                appendDeinterleaved(view.plane(1), view.planeStride(1), view.width / 2, view.height / 2, 0);
+                appendDeinterleaved(view.plane(1), view.planeStride(1), view.width / 2, view.height / 2, 1);
+            }
+            else if (view.format == PixelFormat::NV12)
+            {
+                appendPlane(view.plane(1), view.planeStride(1), view.width, view.height / 2);
+            }
+            else
+            {
+                appendPlane(view.plane(1), view.planeStride(1), view.width / 2, view.height / 2);
+                appendPlane(view.plane(2), view.planeStride(2), view.width / 2, view.height / 2);
+            }
+        }
+        ++stats.framesWritten;
+
+        discardFrame(streamIndex, frame);
+    }
+
+    void RawVideoSink::discardFrame(uint32_t, SinkFrame& frame)
+    {
+        pool->recycle(static_cast<AlignedBuffer*>(frame.handle));
+        frame.handle = nullptr;
+    }
+
+    void RawVideoSink::finalize()
+    {
+        if (file == nullptr)
+        {
+            return;
+        }
+        flush();
+        std::FILE* closing = file;
+        file = nullptr;
+        if (ownsFile ? std::fclose(closing) != 0 : std::fflush(closing) != 0)
+        {
+            throw std::runtime_error("RawVideoSink: failed to close output");
+        }
+    }
+
+    void RawVideoSink::append(const uint8_t* data, size_t length)
+    {
+        while (length > 0)
+        {
+            // Nothing buffered and a big chunk: write it straight through.
+            if (buffered == 0 && length >= writeBuffer.size())
+            {
+                const size_t chunk = length - length % writeBuffer.size();
+                if (std::fwrite(data, 1, chunk, file) != chunk)
+                {
+                    throw std::runtime_error("RawVideoSink: write failed");
+                }
+                ++stats.writeCalls;
+                stats.bytesWritten += chunk;
+                data += chunk;
+                length -= chunk;
+                continue;
+            }
+
+            const size_t room = writeBuffer.size() - buffered;
+            const size_t chunk = length < room ? length : room;
+            std::memcpy(writeBuffer.get() + buffered, data, chunk);
+            buffered += chunk;
+            data += chunk;
+            length -= chunk;
+            if (buffered == writeBuffer.size())
+            {
+                flush();
+            }
+        }
+    }
+
+    void RawVideoSink::appendPlane(const uint8_t* data, ptrdiff_t stride, size_t rowBytes, uint32_t rows)
+    {
+        if (static_cast<size_t>(stride) == rowBytes)
+        {
+            append(data, rowBytes * rows);
+            return;
+        }
+        for (uint32_t y = 0; y < rows; ++y)
+        {
+            append(data + stride * static_cast<ptrdiff_t>(y), rowBytes);
+        }
+    }
+
+    void RawVideoSink::appendDeinterleaved(const uint8_t* data, ptrdiff_t stride, uint32_t width, uint32_t rows, unsigned offset)
+    {
+        for (uint32_t y = 0; y < rows; ++y)
+        {
+            if (writeBuffer.size() - buffered < width)
+            {
+                flush();
+            }
+            const uint8_t* src = data + stride * static_cast<ptrdiff_t>(y) + offset;
+            uint8_t* dst = writeBuffer.get() + buffered;
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                dst[x] = src[2 * x];
+            }
+            buffered += width;
+        }
+    }
+
+    void RawVideoSink::flush()
+    {
+        if (buffered == 0)
+        {
+            return;
+        }
+        if (std::fwrite(writeBuffer.get(), 1, buffered, file) != buffered)
+        {
+            throw std::runtime_error("RawVideoSink: write failed");
+        }
+        ++stats.writeCalls;
+        stats.bytesWritten += buffered;
+        buffered = 0;
+    }
+
+    void RawVideoSink::checkStream(uint32_t streamIndex) const
+    {
+        if (!hasStream || streamIndex != 0)
+        {
+            throw std::out_of_range("RawVideoSink: unknown stream");
+        }
+    }
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "AlignedBuffer.h"
+#include "FramePool.h"
+#include "VideoSink.h"
+
+namespace VideoCoding
+{
+
+    enum class RawContainer
+    {
+        Y4M,    // YUV4MPEG2 header and FRAME markers, planar 4:2:0
+        Raw,    // frames back to back in the input pixel format
+    };
+
+    struct RawVideoSinkStats
+    {
+        uint64_t framesWritten;
+        uint64_t bytesWritten;
+        uint64_t writeCalls;
+    };
+
+    // Portable sink streaming uncompressed frames to a file, or to stdout
+    // when the path is "-", so the pipeline can run off Windows or feed an
+    // external encoder. Output goes through one large buffer and leaves in
+    // few big writes. Y4M output of NV12 frames is de-interleaved to I420 on
+    // the way out. There is a single stream and the output codec is ignored.
+    class RawVideoSink : public VideoSink
+    {
+    public:
+        RawVideoSink(const std::string& path, RawContainer container, size_t writeBufferSize = 4 << 20, size_t poolCapacity = 8);
+        ~RawVideoSink();
+
+        uint32_t addStream(const VideoStreamFormat& outputFormat) override;
+        void setInputFormat(uint32_t streamIndex, const VideoStreamFormat& inputFormat) override;
+        void beginWriting() override;
+
+        SinkFrame acquireFrame(uint32_t streamIndex) override;
+        void writeFrame(uint32_t streamIndex, SinkFrame& frame, int64_t timestamp, int64_t duration) override;
+        void discardFrame(uint32_t streamIndex, SinkFrame& frame) override;
+
+        void finalize() override;
+
+        RawVideoSinkStats getStats() const { return stats; }
+
+    private:
+        void append(const uint8_t* data, size_t length);
+        void appendPlane(const uint8_t* data, ptrdiff_t stride, size_t rowBytes, uint32_t rows);
+        void appendDeinterleaved(const uint8_t* data, ptrdiff_t stride, uint32_t width, uint32_t rows, unsigned offset);
+        void flush();
+        void checkStream(uint32_t streamIndex) const;
+
+        const RawContainer container;
+        std::FILE* file;
+        bool ownsFile;
+        bool hasStream;
+        bool writing;
+        VideoStreamFormat input;
+
+        AlignedBuffer writeBuffer;
+        size_t buffered;
+        std::unique_ptr<FramePool<HeapAlignedBufferBackend>> pool;
+        const size_t poolCapacity;
+        RawVideoSinkStats stats;
+    };
+
+}
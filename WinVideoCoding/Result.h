@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace VideoCoding
+{
+
+    // Turns an error code into message text. Only called when somebody asks
+    // for the message, never on the path that produced the error.
+    typedef std::string (*StatusFormatter)(int32_t code);
+
+    // Portable fallback: "error 0x80004005".
+    inline std::string FormatStatusCode(int32_t code)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "error 0x%08X", static_cast<unsigned>(code));
+        return text;
+    }
+
+    // Outcome of an HRESULT style call: negative codes are failures. A failed
+    // status remembers where it was made (file and line as string literals),
+    // so creating, copying and returning one never allocates.
+    class Status
+    {
+    public:
+        Status() : code(0), file(nullptr), line(0) {}
+
+        static Status fromCode(int32_t code, const char* file, int line)
+        {
+            Status status;
+            status.code = code;
+            status.file = file;
+            status.line = line;
+            return status;
+        }
+
+        // Keeps the site of a status that was already made further down.
+        static Status fromCode(const Status& status, const char*, int)
+        {
+            return status;
+        }
+
+        bool succeeded() const { return code >= 0; }
+        bool failed() const { return code < 0; }
+
+        int32_t getCode() const { return code; }
+        const char* getFile() const { return file != nullptr ? file : ""; }
+        int getLine() const { return line; }
+
+        // "file:line: message". Allocates, meant for the error path only.
+        std::string toString(StatusFormatter formatter = FormatStatusCode) const
+        {
+            std::string text = getFile();
+            text += ':';
+            text += std::to_string(line);
+            text += ": ";
+            text += formatter(code);
+            return text;
+        }
+
+    private:
+        int32_t code;
+        const char* file;
+        int line;
+    };
+
+    // Either a value or the failed Status that prevented it. Move-only,
+    // never throws and never allocates by itself.
+    template<typename T>
+    class Result
+    {
+    public:
+        Result(T&& value) : hasValue(true)
+        {
+            new (&storage) T(std::move(value));
+        }
+
+        // `failure` must be failed, there is no value to go with success.
+        Result(const Status& failure) : status(failure), hasValue(false) {}
+
+        Result(Result&& other) : status(other.status), hasValue(other.hasValue)
+        {
+            if (hasValue)
+            {
+                new (&storage) T(std::move(other.get()));
+            }
+        }
+
+        Result(const Result&) = delete;
+        Result& operator=(const Result&) = delete;
+        Result& operator=(Result&&) = delete;
+
+        ~Result()
+        {
+            if (hasValue)
+            {
+                get().~T();
+            }
+        }
+
+        bool succeeded() const { return hasValue; }
+        bool failed() const { return !hasValue; }
+        const Status& getStatus() const { return status; }
+
+        // Only valid when succeeded().
+        T& value() { return get(); }
+        const T& value() const { return get(); }
+        T take() { return std::move(get()); }
+
+    private:
+        T& get() { return *reinterpret_cast<T*>(&storage); }
+        const T& get() const { return *reinterpret_cast<const T*>(&storage); }
+
+        Status status;
+        bool hasValue;
+        typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+    };
+
+}
+
+// Status of an HRESULT (or the Status itself) tagged with the current site.
+#define MAKE_STATUS(X) ::VideoCoding::Status::fromCode((X), __FILE__, __LINE__)
+
+// Returns the failed Status from the enclosing function, which may return a
+// Status or any Result<T>.
+#define RETURN_IF_FAILED_STATUS(X) \
+{ \
+    const ::VideoCoding::Status failedStatus_ = MAKE_STATUS(X); \
+    if (failedStatus_.failed()) \
+    { \
+        return failedStatus_; \
+    } \
+}
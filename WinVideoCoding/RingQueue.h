@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace VideoCoding
+{
+
+    // Bounded lock-free multi-producer/multi-consumer queue (D. Vyukov's
+    // sequence-numbered ring). Capacity is rounded up to a power of two.
+    template<typename T>
+    class RingQueue
+    {
+    public:
+        explicit RingQueue(size_t requestedCapacity)
+            : cells(RoundUpPowerOfTwo(requestedCapacity)), mask(cells.size() - 1), head(0), tail(0)
+        {
+            for (size_t i = 0; i < cells.size(); ++i)
+            {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        RingQueue(const RingQueue&) = delete;
+        RingQueue& operator=(const RingQueue&) = delete;
+
+        bool tryPush(T& value)
+        {
+            size_t position = tail.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell& cell = cells[position & mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if (difference == 0)
+                {
+                    if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = std::move(value);
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;   // full
+                }
+                else
+                {
+                    position = tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool tryPop(T& value)
+        {
+            size_t position = head.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell& cell = cells[position & mask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+                if (difference == 0)
+                {
+                    if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        value = std::move(cell.value);
+                        cell.sequence.store(position + mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;   // empty
+                }
+                else
+                {
+                    position = head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        size_t capacity() const { return cells.size(); }
+
+    private:
+        static size_t RoundUpPowerOfTwo(size_t value)
+        {
+            size_t result = 2;
+            while (result < value)
+            {
+                result <<= 1;
+            }
+            return result;
+        }
+
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        std::vector<Cell> cells;
+        const size_t mask;
+
+        // Producers and consumers hammer different ends, keep them apart.
+        alignas(64) std::atomic<size_t> head;
+        alignas(64) std::atomic<size_t> tail;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Spin briefly, then give the core away. Used while waiting on a full or
+    // empty queue.
+    class Backoff
+    {
+    public:
+        Backoff() : spins(0) {}
+
+        void pause()
+        {
+            if (++spins > 64)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void reset() { spins = 0; }
+
+    private:
+        unsigned spins;
+    };
+
+}
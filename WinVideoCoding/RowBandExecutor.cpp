@@ -0,0 +1,102 @@
+#include "RowBandExecutor.h"
+
+namespace VideoCoding
+{
+
+    RowBandExecutor::RowBandExecutor(size_t threadCount)
+        : current(nullptr), rows(0), granularity(1), generation(0), pending(0), stopping(false)
+    {
+        for (size_t i = 1; i < threadCount; ++i)
+        {
+            workers.emplace_back(&RowBandExecutor::workerLoop, this, i);
+        }
+    }
+
+    RowBandExecutor::~RowBandExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void RowBandExecutor::bandRange(size_t band, uint32_t& begin, uint32_t& end) const
+    {
+        const uint64_t units = (rows + granularity - 1) / granularity;
+        const uint64_t bands = getThreadCount();
+        begin = static_cast<uint32_t>(units * band / bands * granularity);
+        end = static_cast<uint32_t>(units * (band + 1) / bands * granularity);
+        if (end > rows)
+        {
+            end = rows;
+        }
+    }
+
+    void RowBandExecutor::run(uint32_t rowCount, uint32_t bandGranularity, const BandFunction& function)
+    {
+        if (workers.empty() || rowCount <= bandGranularity)
+        {
+            function(0, rowCount);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &function;
+            rows = rowCount;
+            granularity = bandGranularity;
+            pending = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+
+        uint32_t begin, end;
+        bandRange(0, begin, end);
+        if (begin < end)
+        {
+            function(begin, end);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+        current = nullptr;
+    }
+
+    void RowBandExecutor::workerLoop(size_t index)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            const BandFunction* function;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+                function = current;
+            }
+
+            uint32_t begin, end;
+            bandRange(index, begin, end);
+            if (begin < end)
+            {
+                (*function)(begin, end);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --pending;
+            }
+            done.notify_one();
+        }
+    }
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VideoCoding
+{
+
+    // Splits a range of rows into bands and runs them on a fixed set of
+    // worker threads. The calling thread works on a band too, so a single
+    // thread executor simply runs the work inline.
+    class RowBandExecutor
+    {
+    public:
+        typedef std::function<void(uint32_t rowBegin, uint32_t rowEnd)> BandFunction;
+
+        explicit RowBandExecutor(size_t threadCount);
+        ~RowBandExecutor();
+
+        RowBandExecutor(const RowBandExecutor&) = delete;
+        RowBandExecutor& operator=(const RowBandExecutor&) = delete;
+
+        // Band boundaries are multiples of `granularity`, e.g. 2 for 4:2:0
+        // chroma. Blocks until every band has been processed.
+        void run(uint32_t rows, uint32_t granularity, const BandFunction& function);
+
+        size_t getThreadCount() const { return workers.size() + 1; }
+
+    private:
+        void workerLoop(size_t index);
+        void bandRange(size_t band, uint32_t& begin, uint32_t& end) const;
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        const BandFunction* current;
+        uint32_t rows;
+        uint32_t granularity;
+        uint64_t generation;
+        size_t pending;
+        bool stopping;
+    };
+
+}
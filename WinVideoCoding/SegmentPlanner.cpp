@@ -0,0 +1,67 @@
+#include "SegmentPlanner.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace VideoCoding
+{
+
+    std::vector<MediaSegment> PlanSegments(int64_t duration, const std::vector<int64_t>& keyframes, size_t count, int64_t minLength)
+    {
+        if (duration <= 0 || count == 0)
+        {
+            throw std::invalid_argument("PlanSegments: empty timeline or no segments");
+        }
+        if (minLength < 1)
+        {
+            minLength = 1;
+        }
+
+        std::vector<int64_t> cuts(keyframes);
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+        std::vector<MediaSegment> segments;
+        int64_t start = 0;
+        for (size_t i = 1; i < count; ++i)
+        {
+            // duration * i / count without overflowing for long inputs.
+            const int64_t n = static_cast<int64_t>(count);
+            const int64_t k = static_cast<int64_t>(i);
+            const int64_t target = duration / n * k + duration % n * k / n;
+
+            // Keyframes that leave at least minLength on both sides.
+            const auto first = std::lower_bound(cuts.begin(), cuts.end(), start + minLength);
+            const auto last = std::upper_bound(first, cuts.end(), duration - minLength);
+            if (first == last)
+            {
+                break;
+            }
+
+            auto best = std::lower_bound(first, last, target);
+            if (best == last || (best != first && target - *(best - 1) <= *best - target))
+            {
+                --best;
+            }
+            segments.push_back({ start, *best });
+            start = *best;
+        }
+        segments.push_back({ start, duration });
+        return segments;
+    }
+
+    std::vector<int64_t> RegularKeyframes(int64_t duration, int64_t interval)
+    {
+        std::vector<int64_t> keyframes;
+        if (interval <= 0)
+        {
+            return keyframes;
+        }
+        for (int64_t time = 0; time < duration; time += interval)
+        {
+            keyframes.push_back(time);
+        }
+        return keyframes;
+    }
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VideoCoding
+{
+
+    // [start, end) of the source timeline, 100 ns units.
+    struct MediaSegment
+    {
+        int64_t start;
+        int64_t end;
+    };
+
+    // Splits [0, duration) into up to `count` segments that can be encoded
+    // independently. Every cut is placed on a keyframe, as close to the even
+    // split point as possible, so each segment decodes from its first frame
+    // without reference to the previous one. Cuts that would leave a segment
+    // shorter than `minLength` are dropped, so fewer segments than asked for
+    // come back when keyframes are sparse; without any keyframe past the
+    // start the whole input is one segment. `keyframes` need not be sorted.
+    // Throws std::invalid_argument for a non-positive duration or zero count.
+    std::vector<MediaSegment> PlanSegments(int64_t duration, const std::vector<int64_t>& keyframes, size_t count, int64_t minLength);
+
+    // Keyframe times of a stream with a fixed GOP of `interval`, for sources
+    // whose keyframes are known without scanning them.
+    std::vector<int64_t> RegularKeyframes(int64_t duration, int64_t interval);
+
+}
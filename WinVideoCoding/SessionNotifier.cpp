@@ -0,0 +1,263 @@
+#include "SessionNotifier.h"
+
+#include <algorithm>
+
+namespace VideoCoding
+{
+
+    ProgressThrottle DefaultProgressThrottle()
+    {
+        ProgressThrottle throttle = { std::chrono::milliseconds(250), 0.01 };
+        return throttle;
+    }
+
+    SessionNotifier::SessionNotifier(const ProgressThrottle& throttle)
+        : throttle(throttle), duration(0), position(0), hasReported(false), lastFraction(0.0), completed(false),
+          future(promise.get_future().share())
+    {
+    }
+
+    SessionProgress SessionNotifier::makeProgress(int64_t at) const
+    {
+        SessionProgress progress = { at, duration, 0.0 };
+        if (duration > 0)
+        {
+            progress.fraction = std::min(1.0, std::max(0.0, static_cast<double>(at) / duration));
+        }
+        return progress;
+    }
+
+    void SessionNotifier::setDuration(int64_t newDuration)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        duration = newDuration;
+    }
+
+    bool SessionNotifier::reportPosition(int64_t newPosition, Clock::time_point now)
+    {
+        std::vector<ProgressCallback> callbacks;
+        SessionProgress progress;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (completed)
+            {
+                return false;
+            }
+            position = newPosition;
+            progress = makeProgress(position);
+            if (hasReported)
+            {
+                // Without a duration there is no step to measure, so only
+                // the interval applies.
+                const bool stepped = duration <= 0 || progress.fraction - lastFraction >= throttle.minStep;
+                if (now - lastTime < throttle.minInterval || !stepped)
+                {
+                    return false;
+                }
+            }
+            hasReported = true;
+            lastFraction = progress.fraction;
+            lastTime = now;
+            callbacks = progressCallbacks;
+        }
+        for (const ProgressCallback& callback : callbacks)
+        {
+            callback(progress);
+        }
+        return true;
+    }
+
+    void SessionNotifier::complete(SessionStatus status)
+    {
+        std::vector<ProgressCallback> progress;
+        std::vector<CompletionCallback> completion;
+        SessionProgress last;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (completed)
+            {
+                return;
+            }
+            completed = true;
+            if (!SessionFailed(status))
+            {
+                position = std::max(position, duration);
+                if (!hasReported || lastFraction < 1.0)
+                {
+                    progress = progressCallbacks;
+                }
+            }
+            last = makeProgress(position);
+            if (!SessionFailed(status))
+            {
+                last.fraction = 1.0;
+            }
+            completion.swap(completionCallbacks);
+            progressCallbacks.clear();
+        }
+        for (const ProgressCallback& callback : progress)
+        {
+            callback(last);
+        }
+        promise.set_value(status);
+        for (const CompletionCallback& callback : completion)
+        {
+            callback(status);
+        }
+    }
+
+    void SessionNotifier::onProgress(const ProgressCallback& callback)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!completed)
+        {
+            progressCallbacks.push_back(callback);
+        }
+    }
+
+    void SessionNotifier::onComplete(const CompletionCallback& callback)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!completed)
+            {
+                completionCallbacks.push_back(callback);
+                return;
+            }
+        }
+        callback(future.get());
+    }
+
+    bool SessionNotifier::isComplete() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return completed;
+    }
+
+    SessionProgress SessionNotifier::getProgress() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return makeProgress(position);
+    }
+
+    // ------------------------------------------------------------------------
+
+    const size_t SessionGroup::NONE;
+
+    SessionGroup::SessionGroup() : state(std::make_shared<State>())
+    {
+        state->returned = 0;
+        state->completed = 0;
+        state->failed = 0;
+    }
+
+    size_t SessionGroup::add(const std::shared_ptr<SessionNotifier>& notifier)
+    {
+        size_t index;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            index = state->notifiers.size();
+            state->notifiers.push_back(notifier);
+            state->statuses.push_back(0);
+        }
+
+        std::weak_ptr<State> weakState = state;
+        notifier->onComplete([weakState, index](SessionStatus status)
+        {
+            std::shared_ptr<State> group = weakState.lock();
+            if (!group)
+            {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(group->mutex);
+                group->statuses[index] = status;
+                group->finished.push_back(index);
+                ++group->completed;
+                if (SessionFailed(status))
+                {
+                    ++group->failed;
+                }
+            }
+            group->changed.notify_all();
+        });
+        return index;
+    }
+
+    size_t SessionGroup::takeFinished(State& group)
+    {
+        const size_t index = group.finished.front();
+        group.finished.pop_front();
+        ++group.returned;
+        return index;
+    }
+
+    size_t SessionGroup::waitNext()
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        State& group = *state;
+        group.changed.wait(lock, [&group]() { return !group.finished.empty() || group.returned == group.notifiers.size(); });
+        return group.finished.empty() ? NONE : takeFinished(group);
+    }
+
+    size_t SessionGroup::waitNextFor(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        State& group = *state;
+        group.changed.wait_for(lock, timeout, [&group]() { return !group.finished.empty() || group.returned == group.notifiers.size(); });
+        return group.finished.empty() ? NONE : takeFinished(group);
+    }
+
+    void SessionGroup::waitAll()
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        State& group = *state;
+        group.changed.wait(lock, [&group]() { return group.completed == group.notifiers.size(); });
+    }
+
+    double SessionGroup::getProgress() const
+    {
+        std::vector<std::shared_ptr<SessionNotifier>> notifiers;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            notifiers = state->notifiers;
+        }
+        double done = 0.0;
+        double total = 0.0;
+        for (const std::shared_ptr<SessionNotifier>& notifier : notifiers)
+        {
+            const SessionProgress progress = notifier->getProgress();
+            if (progress.duration > 0)
+            {
+                done += static_cast<double>(progress.duration) * progress.fraction;
+                total += static_cast<double>(progress.duration);
+            }
+        }
+        return total > 0 ? done / total : 0.0;
+    }
+
+    size_t SessionGroup::getCount() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->notifiers.size();
+    }
+
+    size_t SessionGroup::getCompletedCount() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->completed;
+    }
+
+    size_t SessionGroup::getFailedCount() const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->failed;
+    }
+
+    SessionStatus SessionGroup::getStatus(size_t index) const
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->statuses.at(index);
+    }
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace VideoCoding
+{
+
+    // Completion status of a session, HRESULT compatible: negative is failure.
+    typedef int32_t SessionStatus;
+
+    inline bool SessionFailed(SessionStatus status) { return status < 0; }
+
+    struct SessionProgress
+    {
+        int64_t position;       // 100 ns units
+        int64_t duration;       // 0 if unknown
+        double fraction;        // 0..1, 0 while the duration is unknown
+    };
+
+    // Limits how often progress is passed on. An update goes out once it is
+    // at least minStep past the last one and minInterval after it; either
+    // limit may be zero.
+    struct ProgressThrottle
+    {
+        std::chrono::milliseconds minInterval;
+        double minStep;
+    };
+
+    ProgressThrottle DefaultProgressThrottle();
+
+    // Turns a stream of position samples and a final status, pushed by an
+    // event source such as CSession::Invoke, into throttled progress
+    // callbacks and a completion future. All methods are thread safe and
+    // callbacks run on the reporting thread with no lock held.
+    class SessionNotifier
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+        typedef std::function<void(const SessionProgress&)> ProgressCallback;
+        typedef std::function<void(SessionStatus)> CompletionCallback;
+
+        explicit SessionNotifier(const ProgressThrottle& throttle = DefaultProgressThrottle());
+
+        SessionNotifier(const SessionNotifier&) = delete;
+        SessionNotifier& operator=(const SessionNotifier&) = delete;
+
+        void setDuration(int64_t duration);
+
+        // Called by the event source. Returns true if the update was passed on.
+        bool reportPosition(int64_t position, Clock::time_point now = Clock::now());
+
+        // First call wins. A successful session gets a final 100% progress
+        // update regardless of the throttle.
+        void complete(SessionStatus status);
+
+        void onProgress(const ProgressCallback& callback);
+
+        // Runs immediately if the session has already completed.
+        void onComplete(const CompletionCallback& callback);
+
+        std::shared_future<SessionStatus> completion() const { return future; }
+
+        bool isComplete() const;
+        SessionProgress getProgress() const;
+        const ProgressThrottle& getThrottle() const { return throttle; }
+
+    private:
+        SessionProgress makeProgress(int64_t position) const;
+
+        const ProgressThrottle throttle;
+        mutable std::mutex mutex;
+        int64_t duration;
+        int64_t position;
+        bool hasReported;
+        double lastFraction;
+        Clock::time_point lastTime;
+        bool completed;
+        std::vector<ProgressCallback> progressCallbacks;
+        std::vector<CompletionCallback> completionCallbacks;
+        std::promise<SessionStatus> promise;
+        std::shared_future<SessionStatus> future;
+    };
+
+    // ------------------------------------------------------------------------
+
+    // Watches many sessions from one thread: aggregate progress, completion
+    // in the order it happens, and waiting for all of them. Subscriptions
+    // only hold a weak reference, so sessions may outlive the group.
+    class SessionGroup
+    {
+    public:
+        static const size_t NONE = static_cast<size_t>(-1);
+
+        SessionGroup();
+
+        SessionGroup(const SessionGroup&) = delete;
+        SessionGroup& operator=(const SessionGroup&) = delete;
+
+        // Returns the session's index within the group.
+        size_t add(const std::shared_ptr<SessionNotifier>& notifier);
+
+        // Blocks until a session finishes that waitNext() has not returned
+        // yet and returns its index, or NONE once every session was returned.
+        size_t waitNext();
+
+        // Like waitNext() but gives up after timeout, returning NONE.
+        size_t waitNextFor(std::chrono::milliseconds timeout);
+
+        void waitAll();
+
+        // Duration weighted over the sessions that know their duration.
+        double getProgress() const;
+
+        size_t getCount() const;
+        size_t getCompletedCount() const;
+        size_t getFailedCount() const;
+        SessionStatus getStatus(size_t index) const;
+
+    private:
+        struct State
+        {
+            mutable std::mutex mutex;
+            std::condition_variable changed;
+            std::vector<std::shared_ptr<SessionNotifier>> notifiers;
+            std::vector<SessionStatus> statuses;
+            std::deque<size_t> finished;
+            size_t returned;
+            size_t completed;
+            size_t failed;
+        };
+
+        size_t takeFinished(State& state);
+
+        std::shared_ptr<State> state;
+    };
+
+}
@@ -4,104 +4,705 @@
 #include <Mfreadwrite.h>
 #include <mferror.h>
 
+#include <algorithm>
+#include <fstream>
+#include <memory>
 #include <utility>
-#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include"IMFObjectWrapper.h"
+#include "AudioPattern.h"
+#include "CCoalescingByteStream.h"
+#include "ColorConversion.h"
+#include "DirtyRegion.h"
+#include "EncodeFile.h"
+#include "FrameGeometry.h"
+#include "FramePool.h"
+#include "FrameScaler.h"
+#include "FrameWriter.h"
+#include "MFProfileCache.h"
+#include "MFVideoSink.h"
+#include "Mp4Fragment.h"
+#include "MuxScheduler.h"
+#include "RawFrameReader.h"
+#include "RawVideoSink.h"
+#include "TestPattern.h"
+#include "Tracer.h"
 
 #pragma comment(lib, "mfreadwrite")
 #pragma comment(lib, "mfplat")
 #pragma comment(lib, "mfuuid")
 
-// Format constants
-const UINT32 VIDEO_WIDTH = 640;
-const UINT32 VIDEO_HEIGHT = 480;
-const UINT32 VIDEO_FPS = 30;
-const UINT64 VIDEO_FRAME_DURATION = 10 * 1000 * 1000 / VIDEO_FPS;
-const UINT32 VIDEO_BIT_RATE = 800000;
-const GUID   VIDEO_ENCODING_FORMAT = MFVideoFormat_WMV3;
-const GUID   VIDEO_INPUT_FORMAT = MFVideoFormat_RGB32;
-const UINT32 VIDEO_PELS = VIDEO_WIDTH * VIDEO_HEIGHT;
-const UINT32 VIDEO_FRAME_COUNT = 20 * VIDEO_FPS;
+// Format constants. Size, frame rate and bit rate are only defaults, see
+// ParseGeometryOptions.
+const VideoCoding::FrameGeometry DEFAULT_VIDEO_GEOMETRY = { 640, 480, 30, 1, 800000 };
+const VideoCoding::VideoCodec  VIDEO_ENCODING_FORMAT = VideoCoding::VideoCodec::WMV3;   // H.264 for *.mp4
+const VideoCoding::PixelFormat VIDEO_INPUT_PIXEL_FORMAT = VideoCoding::PixelFormat::NV12;
+const UINT32 VIDEO_SECONDS = 20;
 
-// Buffer to hold the video frame data.
-DWORD videoFrameBuffer[VIDEO_PELS];
+// RGB32 -> NV12 conversion done by us instead of the sink writer.
+const VideoCoding::ColorMatrix VIDEO_COLOR_MATRIX = VideoCoding::ColorMatrix::BT601;
+const VideoCoding::ColorRange  VIDEO_COLOR_RANGE = VideoCoding::ColorRange::Limited;
+const size_t COLOR_CONVERSION_THREADS = 2;
 
-struct InitializeSinkWriterResult
+// Threads rendering frames ahead of the sink writer, 0 renders and writes
+// on the main thread. The queue depth bounds how far they may run ahead.
+const size_t PIPELINE_PRODUCER_COUNT = 2;
+const size_t PIPELINE_QUEUE_DEPTH = 8;
+
+// With --input, the capture is mapped this much at a time.
+const size_t INPUT_MAP_WINDOW = 64 << 20;
+
+// With --scale, captures are resized in process rather than by the
+// encoder's topology, split into row bands across this many threads.
+const VideoCoding::ScaleFilter SCALE_FILTER = VideoCoding::ScaleFilter::Area;
+const size_t SCALE_THREADS = 2;
+
+// Number of idle samples kept around for reuse by the sink.
+const size_t SAMPLE_POOL_CAPACITY = 8;
+
+// With --byte-stream, muxer writes are gathered into buffers of this size
+// before they go out.
+const size_t BYTE_STREAM_BUFFER = 1 << 20;
+
+// Patch only the rows that changed since a pooled buffer was last filled,
+// instead of converting every frame in full.
+const bool USE_DIRTY_REGIONS = true;
+
+// With --audio, video and a test signal are produced on separate threads and
+// interleaved by timestamp. A stream may get up to MUX_MAX_SKEW (100 ns
+// units) ahead of one that lags before the writer waits for it.
+const size_t   MUX_QUEUE_DEPTH = 8;
+const int64_t  MUX_MAX_SKEW = 1000000;
+const uint32_t AUDIO_BLOCK_FRAMES = 1024;   // one AAC frame
+const VideoCoding::AudioPatternKind AUDIO_TEST_PATTERN = VideoCoding::AudioPatternKind::Tone;
+
+// Default content, see VideoCoding::TestPatternKind. Overridden on the
+// command line.
+const VideoCoding::TestPatternKind VIDEO_TEST_PATTERN = VideoCoding::TestPatternKind::MovingBoxes;
+const double   VIDEO_PATTERN_MOTION = 0.25;
+const uint32_t VIDEO_PATTERN_SEED = 1;
+
+// Everything one thread needs to produce NV12 frames on its own. The dirty
+// region tracker is shared, pooled buffers move between threads.
+struct FrameSource
+{
+    FrameSource(const VideoCoding::TestPatternSettings& pattern, size_t conversionThreads, VideoCoding::DirtyRegionTracker& tracker)
+        : rgbProducer(pattern), converter(VIDEO_COLOR_MATRIX, VIDEO_COLOR_RANGE, conversionThreads), converting(rgbProducer, converter),
+          dirty(rgbProducer, tracker, &converter) {}
+
+    VideoCoding::FrameProducer& producer()
+    {
+        return USE_DIRTY_REGIONS ? static_cast<VideoCoding::FrameProducer&>(dirty) : converting;
+    }
+
+    VideoCoding::TestPatternProducer rgbProducer;
+    VideoCoding::ColorConverter converter;
+    VideoCoding::ConvertingFrameProducer converting;
+    VideoCoding::DirtyRegionProducer dirty;
+};
+
+VideoCoding::VideoStreamFormat MakeStreamFormat(VideoCoding::VideoCodec codec, const VideoCoding::FrameGeometry& geometry)
+{
+    VideoCoding::VideoStreamFormat format;
+    format.codec = codec;
+    format.pixelFormat = VIDEO_INPUT_PIXEL_FORMAT;
+    format.width = geometry.width;
+    format.height = geometry.height;
+    format.fpsNumerator = geometry.fpsNumerator;
+    format.fpsDenominator = geometry.fpsDenominator;
+    format.bitrate = geometry.bitrate;
+    format.matrix = VIDEO_COLOR_MATRIX;
+    format.range = VIDEO_COLOR_RANGE;
+    return format;
+}
+
+bool EndsWith(const std::string& text, const std::string& suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// "*.y4m" and "-" (stdout) write YUV4MPEG2, "*.yuv" raw NV12 frames,
+// anything else goes through the Media Foundation sink writer. A
+// `byteStream` of "file" or "stdout" routes the sink writer's output through
+// a CCoalescingByteStream, returned in `stream`; the output name then only
+// picks the container. A positive fragmentDuration makes it fragmented MP4.
+std::unique_ptr<VideoCoding::VideoSink> CreateSink(const std::string& output, const std::string& byteStream, int64_t fragmentDuration,
+    IMFWrappers::ComPtr<CCoalescingByteStream>& stream)
+{
+    if (output == "-" || EndsWith(output, ".y4m"))
+    {
+        return std::unique_ptr<VideoCoding::VideoSink>(new VideoCoding::RawVideoSink(output, VideoCoding::RawContainer::Y4M));
+    }
+    if (EndsWith(output, ".yuv"))
+    {
+        return std::unique_ptr<VideoCoding::VideoSink>(new VideoCoding::RawVideoSink(output, VideoCoding::RawContainer::Raw));
+    }
+    if (!byteStream.empty())
+    {
+        std::unique_ptr<VideoCoding::ByteTarget> target(new VideoCoding::FileByteTarget(byteStream == "stdout" ? "-" : output));
+        std::unique_ptr<VideoCoding::CoalescingWriter> writer(new VideoCoding::CoalescingWriter(std::move(target), BYTE_STREAM_BUFFER));
+        DO_CHECKED_OPERATION(CCoalescingByteStream::Create(std::move(writer), stream.receive()));
+    }
+    return std::unique_ptr<VideoCoding::VideoSink>(new MFVideoSink(output, SAMPLE_POOL_CAPACITY, stream.get(), fragmentDuration));
+}
+
+void PrintByteStreamStats(CCoalescingByteStream* stream)
+{
+    if (stream == nullptr)
+    {
+        return;
+    }
+    const VideoCoding::CoalescingWriterStats stats = stream->GetStats();
+    std::cerr << "Byte stream: " << stats.bytes << " bytes in " << stats.writes << " writes, " << stats.target.writeCalls << " target writes, "
+        << stats.target.seeks << " seeks, " << stats.stalls << " stalls" << std::endl;
+}
+
+// Rewrites a progressive MP4 as fragmented MP4, to a file or to stdout ("-").
+// Progress goes to stderr, stdout may be carrying the output.
+int RefragmentFile(const std::string& input, const std::string& output, int64_t fragmentDuration)
+{
+    std::ifstream in(input, std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Can't open " << input << std::endl;
+        return 1;
+    }
+    VideoCoding::FileByteTarget target(output);
+    const VideoCoding::FragmentedMp4Stats stats = VideoCoding::RefragmentMp4(in, target, fragmentDuration);
+    target.close();
+    std::cerr << "Wrote " << stats.bytes << " bytes in " << stats.fragments << " fragments, largest " << stats.largestFragment
+        << " bytes, longest " << stats.longestFragment / 10000 << " ms" << std::endl;
+    return 0;
+}
+
+VideoCoding::VideoCodec OutputCodec(const std::string& output)
+{
+    return EndsWith(output, ".mp4") ? VideoCoding::VideoCodec::H264 : VIDEO_ENCODING_FORMAT;
+}
+
+void PrintPoolStats(VideoCoding::VideoSink& sink, uint32_t streamIndex)
+{
+    if (MFVideoSink* mfSink = dynamic_cast<MFVideoSink*>(&sink))
+    {
+        const VideoCoding::FramePoolStats stats = mfSink->getPoolStats(streamIndex);
+        std::cerr << "Sample pool: " << stats.hits << " hits, " << stats.misses << " misses, "
+            << stats.allocations << " allocations, high water mark " << stats.highWaterMark << std::endl;
+    }
+}
+
+void PrintPipelineStats(const VideoCoding::PipelineStats& stats)
+{
+    std::cerr << "Pipeline: " << stats.framesSubmitted << " frames, " << stats.producerStalls << " producer stalls, "
+        << stats.submitterStalls << " submitter stalls, max reorder depth " << stats.maxReorderDepth << std::endl;
+    if (stats.framesDropped > 0)
+    {
+        std::cerr << "Dedup: " << stats.framesDropped << " repeated frames folded into the sample before" << std::endl;
+    }
+}
+
+// A positive maxHold drops repeated frames, see FrameWriterSettings.
+void WriteVideo(VideoCoding::VideoSink& sink, VideoCoding::VideoCodec codec, const VideoCoding::FrameGeometry& geometry, const VideoCoding::TestPatternSettings& pattern,
+    int64_t maxHold)
+{
+    const size_t sourceCount = PIPELINE_PRODUCER_COUNT > 0 ? PIPELINE_PRODUCER_COUNT : 1;
+    VideoCoding::DirtyRegionTracker tracker;
+    std::vector<std::unique_ptr<FrameSource>> sources;
+    std::vector<VideoCoding::FrameProducer*> producers;
+    for (size_t i = 0; i < sourceCount; ++i)
+    {
+        sources.emplace_back(new FrameSource(pattern, PIPELINE_PRODUCER_COUNT > 0 ? 1 : COLOR_CONVERSION_THREADS, tracker));
+        producers.push_back(&sources.back()->producer());
+    }
+
+    const uint32_t streamIndex = sink.addStream(MakeStreamFormat(codec, geometry));
+    sink.setInputFormat(streamIndex, MakeStreamFormat(VideoCoding::VideoCodec::Uncompressed, geometry));
+    sink.beginWriting();
+
+    VideoCoding::FrameWriterSettings settings;
+    settings.frameCount = geometry.framesFor(VIDEO_SECONDS);
+    settings.frameDuration = geometry.frameDuration();
+    settings.queueDepth = PIPELINE_PRODUCER_COUNT > 0 ? PIPELINE_QUEUE_DEPTH : 0;
+    settings.maxHoldDuration = maxHold;
+
+    const VideoCoding::PipelineStats pipelineStats = VideoCoding::WriteFrames(sink, streamIndex, producers, settings);
+    sink.finalize();
+
+    // stdout may be carrying the video, so report on stderr.
+    PrintPipelineStats(pipelineStats);
+
+    if (USE_DIRTY_REGIONS)
+    {
+        const VideoCoding::DirtyRegionStats stats = tracker.stats();
+        std::cerr << "Dirty regions: " << stats.fullCopies << " of " << stats.frames << " frames copied in full, "
+            << 100.0 * stats.copiedFraction() << "% of frame bytes written" << std::endl;
+    }
+
+    PrintPoolStats(sink, streamIndex);
+}
+
+// Size a capture is scaled to before encoding; a width of 0 keeps its own.
+struct ScaleOptions
 {
-    IMFWrappers::IMFSinkWriterWrapper sinkWritter;
-    DWORD streamIndex;
+    uint32_t width;
+    uint32_t height;
+    VideoCoding::ScaleFilter filter;
+};
+
+// Encodes a raw capture instead of a test pattern. Frames go from the
+// mapping straight into the sink's buffers, so the sink takes the file's
+// pixel format; a Y4M header overrides the geometry's size and frame rate.
+// With a scale size, each frame is copied out of the mapping at the
+// capture's size and scaled into the sink's buffer instead.
+void WriteFileVideo(VideoCoding::VideoSink& sink, VideoCoding::VideoCodec codec, VideoCoding::FrameGeometry geometry, VideoCoding::RawFrameReader& reader,
+    const ScaleOptions& scale, int64_t maxHold)
+{
+    const VideoCoding::RawFrameFormat& input = reader.getFormat();
+    const bool scaling = scale.width > 0 && (scale.width != input.width || scale.height != input.height);
+    if (scaling && input.format == VideoCoding::PixelFormat::RGB32)
+    {
+        throw std::invalid_argument("--scale needs an NV12 or I420 capture");
+    }
+    geometry.width = scaling ? scale.width : input.width;
+    geometry.height = scaling ? scale.height : input.height;
+    if (input.fpsNumerator > 0)
+    {
+        geometry.fpsNumerator = input.fpsNumerator;
+        geometry.fpsDenominator = input.fpsDenominator;
+    }
+    VideoCoding::ValidateFrameGeometry(geometry);
+
+    VideoCoding::VideoStreamFormat inputFormat = MakeStreamFormat(VideoCoding::VideoCodec::Uncompressed, geometry);
+    inputFormat.pixelFormat = input.format;
+    const uint32_t streamIndex = sink.addStream(MakeStreamFormat(codec, geometry));
+    sink.setInputFormat(streamIndex, inputFormat);
+    sink.beginWriting();
+
+    // One producer: the reader's mapping slides forward and is not shared.
+    VideoCoding::MappedFrameProducer mapped(reader);
+    VideoCoding::FrameScaler scaler(scale.filter, SCALE_THREADS);
+    VideoCoding::ScalingFrameProducer scaled(mapped, scaler, input.width, input.height);
+    std::vector<VideoCoding::FrameProducer*> producers(1, scaling ? static_cast<VideoCoding::FrameProducer*>(&scaled) : &mapped);
+    VideoCoding::FrameWriterSettings settings;
+    settings.frameCount = reader.getFrameCount();
+    settings.frameDuration = geometry.frameDuration();
+    settings.queueDepth = PIPELINE_QUEUE_DEPTH;
+    settings.maxHoldDuration = maxHold;
+
+    const VideoCoding::PipelineStats pipelineStats = VideoCoding::WriteFrames(sink, streamIndex, producers, settings);
+    sink.finalize();
+
+    const VideoCoding::MappedFileStats mapStats = reader.getStats();
+    PrintPipelineStats(pipelineStats);
+    std::cerr << "Input: " << mapStats.maps << " windows, " << mapStats.bytesMapped << " bytes mapped, "
+        << mapStats.readaheadHints << " readahead hints" << std::endl;
+    if (scaling)
+    {
+        std::cerr << "Scaled " << input.width << "x" << input.height << " to " << geometry.width << "x" << geometry.height
+            << " (" << VideoCoding::ScaleFilterName(scale.filter) << ", " << VideoCoding::SimdLevelName(scaler.getSimdLevel()) << ")" << std::endl;
+    }
+
+    PrintPoolStats(sink, streamIndex);
+}
 
-    explicit InitializeSinkWriterResult(IMFWrappers::IMFSinkWriterWrapper&& sinkWritter, DWORD streamIndex) : sinkWritter(std::move(sinkWritter)), streamIndex(streamIndex) {};
+// One entry of the interleaved stream, either a rendered video frame or a
+// pooled block of interleaved PCM.
+struct MediaPacket
+{
+    VideoCoding::SinkFrame frame;
+    VideoCoding::AlignedBuffer pcm;
+    size_t pcmBytes;
 };
 
-InitializeSinkWriterResult InitializeSinkWriter()
+// Video plus AAC audio, see MUX_QUEUE_DEPTH. Only the Media Foundation
+// sink takes audio.
+void WriteMedia(VideoCoding::VideoSink& sink, VideoCoding::VideoCodec codec, const VideoCoding::FrameGeometry& geometry,
+    const VideoCoding::TestPatternSettings& pattern, size_t audioProfile, const VideoCoding::AudioPatternSettings& audioPattern)
 {
-    IMFWrappers::IMFSinkWriterWrapper pSinkWriter("output.wmv", NULL, NULL);
+    if (audioProfile >= AAC_PROFILE_COUNT)
+    {
+        throw std::invalid_argument("unknown audio profile: " + std::to_string(audioProfile));
+    }
+    const AACProfileInfo& profile = aac_profiles[audioProfile];
+    const VideoCoding::AudioStreamFormat audioOutput = { VideoCoding::AudioCodec::AAC, profile.samplesPerSec, profile.numChannels, profile.bitsPerSample, profile.bytesPerSec, profile.aacProfile };
+    const VideoCoding::AudioStreamFormat audioInput = { VideoCoding::AudioCodec::PCM, profile.samplesPerSec, profile.numChannels, profile.bitsPerSample, 0, 0 };
+
+    VideoCoding::DirtyRegionTracker tracker;
+    FrameSource source(pattern, COLOR_CONVERSION_THREADS, tracker);
+
+    const uint32_t videoIndex = sink.addStream(MakeStreamFormat(codec, geometry));
+    sink.setInputFormat(videoIndex, MakeStreamFormat(VideoCoding::VideoCodec::Uncompressed, geometry));
+    const uint32_t audioIndex = sink.addAudioStream(audioOutput, audioInput);
+    sink.beginWriting();
+
+    VideoCoding::MuxScheduler<MediaPacket> mux(MUX_QUEUE_DEPTH, MUX_MAX_SKEW);
+
+    const uint64_t frameCount = geometry.framesFor(VIDEO_SECONDS);
+    const int64_t frameDuration = geometry.frameDuration();
+    uint64_t frameIndex = 0;
+    const uint32_t videoStream = mux.addStream([&](VideoCoding::MuxSample<MediaPacket>& sample)
+    {
+        if (frameIndex == frameCount)
+        {
+            return false;
+        }
+        sample.item.frame = sink.acquireFrame(videoIndex);
+        try
+        {
+            source.producer().render(sample.item.frame.view, frameIndex);
+        }
+        catch (...)
+        {
+            sink.discardFrame(videoIndex, sample.item.frame);
+            throw;
+        }
+        sample.timestamp = static_cast<int64_t>(frameIndex) * frameDuration;
+        sample.duration = frameDuration;
+        ++frameIndex;
+        return true;
+    });
+
+    // Timestamps come from the running sample count, so block durations
+    // that don't divide evenly into 100 ns units don't drift.
+    const uint64_t audioFrames = static_cast<uint64_t>(VIDEO_SECONDS) * audioInput.sampleRate;
+    const auto audioTime = [&](uint64_t frames) { return static_cast<int64_t>(frames * 10000000 / audioInput.sampleRate); };
+    VideoCoding::AudioPatternGenerator audio(audioPattern, audioInput.sampleRate, audioInput.channels);
+    // Enough blocks for a full queue, the one being rendered and the one
+    // being written.
+    VideoCoding::FramePool<VideoCoding::AlignedBufferBackend> audioBlocks(
+        VideoCoding::AlignedBufferBackend(VideoCoding::AudioBlockBytes(audioInput.channels, AUDIO_BLOCK_FRAMES)), MUX_QUEUE_DEPTH + 2);
+    audioBlocks.preallocate();
+    uint64_t audioPosition = 0;
+    mux.addStream([&](VideoCoding::MuxSample<MediaPacket>& sample)
+    {
+        if (audioPosition == audioFrames)
+        {
+            return false;
+        }
+        const uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>(AUDIO_BLOCK_FRAMES, audioFrames - audioPosition));
+        sample.item.pcm = audioBlocks.acquire();
+        sample.item.pcmBytes = VideoCoding::AudioBlockBytes(audioInput.channels, frames);
+        audio.render(reinterpret_cast<int16_t*>(sample.item.pcm.get()), audioPosition, frames);
+        sample.timestamp = audioTime(audioPosition);
+        sample.duration = audioTime(audioPosition + frames) - sample.timestamp;
+        audioPosition += frames;
+        return true;
+    });
+
+    const VideoCoding::MuxStats stats = mux.run(
+        [&](VideoCoding::MuxSample<MediaPacket>& sample)
+        {
+            if (sample.stream == videoStream)
+            {
+                sink.writeFrame(videoIndex, sample.item.frame, sample.timestamp, sample.duration);
+            }
+            else
+            {
+                sink.writeAudio(audioIndex, sample.item.pcm.get(), sample.item.pcmBytes, sample.timestamp, sample.duration);
+                audioBlocks.recycle(std::move(sample.item.pcm));
+            }
+        },
+        [&](VideoCoding::MuxSample<MediaPacket>& sample)
+        {
+            if (sample.stream != videoStream)
+            {
+                audioBlocks.recycle(std::move(sample.item.pcm));
+            }
+            else if (sample.item.frame.handle != nullptr)   // a failed write may already have taken it
+            {
+                sink.discardFrame(videoIndex, sample.item.frame);
+            }
+        });
+    sink.finalize();
 
-    // Set the output media type.
-    IMFWrappers::IMFMediaTypeWrapper pMediaTypeOut;
+    std::cerr << "Mux: " << stats.samplesWritten << " samples, " << stats.producerStalls << " producer stalls, "
+        << stats.writerStalls << " writer stalls, max " << stats.maxBuffered << " buffered, max skew "
+        << stats.maxSkew / 10000 << " ms" << std::endl;
+
+    PrintPoolStats(sink, videoIndex);
+}
 
-    pMediaTypeOut.setGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
-    pMediaTypeOut.setGUID(MF_MT_SUBTYPE, VIDEO_ENCODING_FORMAT);
-    pMediaTypeOut.setUINT32(MF_MT_AVG_BITRATE, VIDEO_BIT_RATE);
-    pMediaTypeOut.setUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
-    pMediaTypeOut.setAttributeSize(MF_MT_FRAME_SIZE, VIDEO_WIDTH, VIDEO_HEIGHT);
-    pMediaTypeOut.setAttributeRatio(MF_MT_FRAME_RATE, VIDEO_FPS, 1);
-    pMediaTypeOut.setAttributeRatio(MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
+// Retries per batch job before it is reported as failed.
+const unsigned BATCH_MAX_ATTEMPTS = 2;
 
-    // Set the input media type.
-    IMFWrappers::IMFMediaTypeWrapper pMediaTypeIn;
+// Jobs an encode daemon holds waiting before it turns new ones away.
+const size_t DAEMON_MAX_QUEUED = 64;
+
+// --profile-sweep defaults: every combination, 10% slack against a baseline.
+const char PROFILE_SWEEP_GRID[] = "*:*";
+const double PROFILE_SWEEP_TOLERANCE = 0.1;
+
+// Takes the geometry options out of the command line and returns the rest in
+// `args`. A --config file is applied where it appears, so later options
+// override it.
+VideoCoding::FrameGeometry ParseGeometryOptions(int argc, char* argv[], std::vector<std::string>& args)
+{
+    VideoCoding::FrameGeometry geometry = DEFAULT_VIDEO_GEOMETRY;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg != "--config" && arg != "--size" && arg != "--fps" && arg != "--bitrate")
+        {
+            args.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            throw std::invalid_argument("missing value for " + arg);
+        }
+        const std::string value = argv[++i];
+        if (arg == "--config")
+        {
+            geometry = VideoCoding::LoadFrameGeometry(value, geometry);
+        }
+        else
+        {
+            VideoCoding::SetFrameGeometryField(geometry, arg.substr(2), value);
+        }
+    }
+    VideoCoding::ValidateFrameGeometry(geometry);
+    return geometry;
+}
+
+// Takes every "FLAG VALUE" out of `args` and returns the last value, empty
+// if the flag isn't there.
+std::string TakeOptionValue(std::vector<std::string>& args, const std::string& flag)
+{
+    std::string value;
+    for (size_t i = 0; i < args.size();)
+    {
+        if (args[i] != flag)
+        {
+            ++i;
+            continue;
+        }
+        if (i + 1 >= args.size())
+        {
+            throw std::invalid_argument("missing value for " + flag);
+        }
+        value = args[i + 1];
+        args.erase(args.begin() + i, args.begin() + i + 2);
+    }
+    return value;
+}
 
-    pMediaTypeIn.setGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
-    pMediaTypeIn.setGUID(MF_MT_SUBTYPE, VIDEO_INPUT_FORMAT);
-    pMediaTypeIn.setUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
-    pMediaTypeIn.setAttributeSize(MF_MT_FRAME_SIZE, VIDEO_WIDTH, VIDEO_HEIGHT);
-    pMediaTypeIn.setAttributeRatio(MF_MT_FRAME_RATE, VIDEO_FPS, 1);
-    pMediaTypeIn.setAttributeRatio(MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
+struct AudioOptions
+{
+    int profile;        // index into aac_profiles, -1 writes video only
+    VideoCoding::AudioPatternSettings pattern;
+};
 
-    DWORD streamIndex = pSinkWriter.AddStream(pMediaTypeOut);
-    pSinkWriter.setInputMediaType(streamIndex, pMediaTypeIn, NULL);
-    pSinkWriter.beginWritting();
+// Takes "--audio N" and "--audio-pattern tone|sweep|noise" out of `args`.
+AudioOptions ParseAudioOptions(std::vector<std::string>& args)
+{
+    AudioOptions options = { -1, VideoCoding::DefaultAudioPatternSettings(AUDIO_TEST_PATTERN) };
+    const std::string profile = TakeOptionValue(args, "--audio");
+    if (!profile.empty())
+    {
+        options.profile = std::stoi(profile);
+    }
+    const std::string pattern = TakeOptionValue(args, "--audio-pattern");
+    if (!pattern.empty() && !VideoCoding::ParseAudioPattern(pattern, options.pattern.kind))
+    {
+        throw std::invalid_argument("unknown audio pattern: " + pattern);
+    }
+    return options;
+}
 
-    pSinkWriter.addRef();
+// Takes "--byte-stream file|stdout" out of `args`, empty if not given.
+std::string ParseByteStreamOption(std::vector<std::string>& args)
+{
+    const std::string mode = TakeOptionValue(args, "--byte-stream");
+    if (!mode.empty() && mode != "file" && mode != "stdout")
+    {
+        throw std::invalid_argument("unknown byte stream: " + mode);
+    }
+    return mode;
+}
 
-    return InitializeSinkWriterResult(std::move(pSinkWriter), streamIndex);
+// Takes "FLAG SECONDS" out of `args`, in 100 ns units; 0 if not given.
+// `what` names the value in the error for a duration that isn't positive.
+int64_t ParseSecondsOption(std::vector<std::string>& args, const std::string& flag, const std::string& what)
+{
+    const std::string text = TakeOptionValue(args, flag);
+    if (text.empty())
+    {
+        return 0;
+    }
+    const double seconds = std::stod(text);
+    if (!(seconds > 0))
+    {
+        throw std::invalid_argument(what + " must be positive: " + text);
+    }
+    return static_cast<int64_t>(seconds * 10000000);
 }
 
-void WriteFrame(const IMFWrappers::IMFSinkWriterWrapper& pWriter, DWORD streamIndex, const LONGLONG rtStart)
+struct InputOptions
 {
-    const LONG cbWidth = 4 * VIDEO_WIDTH;
-    const DWORD cbBuffer = cbWidth * VIDEO_HEIGHT;
-    BYTE *pData = NULL;
+    std::string path;   // empty renders a test pattern
+    VideoCoding::PixelFormat format;
+    ScaleOptions scale;
+};
+
+// Takes "--input FILE", "--input-format nv12|i420|rgb32",
+// "--scale WIDTHxHEIGHT" and "--scale-filter bilinear|bicubic|area" out of
+// `args`. Without a format, *.yuv is taken as NV12, as RawVideoSink writes it.
+InputOptions ParseInputOptions(std::vector<std::string>& args)
+{
+    InputOptions options = { std::string(), VideoCoding::PixelFormat::NV12, { 0, 0, SCALE_FILTER } };
+    options.path = TakeOptionValue(args, "--input");
+    const std::string format = TakeOptionValue(args, "--input-format");
+    if (!format.empty() && !VideoCoding::ParsePixelFormat(format, options.format))
+    {
+        throw std::invalid_argument("unknown pixel format: " + format);
+    }
+    const std::string scale = TakeOptionValue(args, "--scale");
+    if (!scale.empty() && (!VideoCoding::ParseFrameSize(scale, options.scale.width, options.scale.height)
+        || options.scale.width == 0 || options.scale.height == 0 || (options.scale.width % 2) != 0 || (options.scale.height % 2) != 0))
+    {
+        throw std::invalid_argument("scale size must be even WIDTHxHEIGHT: " + scale);
+    }
+    const std::string filter = TakeOptionValue(args, "--scale-filter");
+    if (!filter.empty() && !VideoCoding::ParseScaleFilter(filter, options.scale.filter))
+    {
+        throw std::invalid_argument("unknown scale filter: " + filter);
+    }
+    return options;
+}
 
-    IMFWrappers::IMFMediaBufferWrapper pBuffer(cbBuffer);
-    pBuffer.lock(&pData);
-    pBuffer.copyImage(pData, cbWidth, (BYTE*)videoFrameBuffer, cbWidth, cbWidth, VIDEO_HEIGHT);
-    pBuffer.unlock();
-    pBuffer.setCurrentLength(cbBuffer);
+// Takes "--trace FILE" out of `args`, empty if not given.
+std::string ParseTraceOption(std::vector<std::string>& args)
+{
+    return TakeOptionValue(args, "--trace");
+}
 
-    IMFWrappers::IMFSampleWrapper pSample;
-    pSample.addBuffer(pBuffer);
-    pSample.setSampleTime(rtStart);
-    pSample.setSampleDuration(VIDEO_FRAME_DURATION);
+// Stops tracing and writes the timeline, if --trace asked for one.
+void WriteTrace(const std::string& path)
+{
+    if (path.empty())
+    {
+        return;
+    }
+    VideoCoding::StopTracing();
+    std::ofstream out(path);
+    VideoCoding::WriteChromeTrace(out);
+    const VideoCoding::TraceStats stats = VideoCoding::GetTraceStats();
+    std::cerr << "Trace: " << stats.events << " events from " << stats.threads << " threads, " << stats.dropped << " dropped, written to " << path << std::endl;
+}
 
-    pWriter.writeSample(streamIndex, pSample);
+VideoCoding::TranscodeSchedulerSettings ParseBatchSettings(const std::vector<std::string>& args)
+{
+    VideoCoding::TranscodeSchedulerSettings settings;
+    settings.maxSessions = args.size() > 2 ? std::stoul(args[2]) : 0;
+    settings.memoryBudget = args.size() > 3 ? static_cast<uint64_t>(std::stoull(args[3])) << 20 : 0;
+    settings.maxAttempts = BATCH_MAX_ATTEMPTS;
+    return settings;
+}
 
-    pSample.release();
-    pBuffer.release();
+// "--daemon ENDPOINT [max_sessions [max_queued]]"; jobs retry like batch jobs.
+VideoCoding::EncodeDaemonSettings ParseDaemonSettings(const std::vector<std::string>& args, int64_t fragmentDuration)
+{
+    VideoCoding::EncodeDaemonSettings settings;
+    settings.maxSessions = args.size() > 2 ? std::stoul(args[2]) : 0;
+    settings.maxQueued = args.size() > 3 ? std::stoul(args[3]) : DAEMON_MAX_QUEUED;
+    settings.maxAttempts = BATCH_MAX_ATTEMPTS;
+    settings.fragmentDuration = fragmentDuration;
+    return settings;
 }
 
-void main()
+// "--submit ENDPOINT status|shutdown" or "--submit ENDPOINT input output [audio_profile [video_profile]]".
+VideoCoding::DaemonRequest ParseSubmitRequest(const std::vector<std::string>& args)
 {
-    std::default_random_engine generator;
-    std::uniform_int_distribution<UINT32> distribution(0, VIDEO_WIDTH);
+    VideoCoding::DaemonRequest request = VideoCoding::DaemonRequest();
+    if (args.size() == 3 && args[2] == "status")
+    {
+        request.kind = VideoCoding::DaemonRequestKind::Status;
+    }
+    else if (args.size() == 3 && args[2] == "shutdown")
+    {
+        request.kind = VideoCoding::DaemonRequestKind::Shutdown;
+    }
+    else if (args.size() >= 4 && args.size() <= 6)
+    {
+        request.kind = VideoCoding::DaemonRequestKind::Encode;
+        request.job.input = args[2];
+        request.job.output = args[3];
+        request.job.audioProfile = args.size() > 4 ? std::stoi(args[4]) : 0;
+        request.job.videoProfile = args.size() > 5 ? std::stoi(args[5]) : 0;
+    }
+    else
+    {
+        throw std::invalid_argument("--submit needs status, shutdown or input output [audio_profile [video_profile]]");
+    }
+    return request;
+}
 
-    // Set all pixels to green
-    for (DWORD i = 0; i < VIDEO_PELS; ++i)
+VideoCoding::TestPatternSettings ParsePatternSettings(const std::vector<std::string>& args)
+{
+    VideoCoding::TestPatternSettings pattern = { VIDEO_TEST_PATTERN, VIDEO_PATTERN_SEED, VIDEO_PATTERN_MOTION };
+    if (args.size() > 1 && !VideoCoding::ParseTestPattern(args[1], pattern.kind))
+    {
+        throw std::invalid_argument("unknown test pattern: " + args[1]);
+    }
+    if (args.size() > 2)
     {
-        videoFrameBuffer[i] = 0x0000FF00;
+        pattern.motion = std::stod(args[2]);
     }
+    return pattern;
+}
+
+// Usage: SinkWriter [geometry] [--audio N [--audio-pattern tone|sweep|noise]] [--byte-stream file|stdout] [--fragment SECONDS] [--dedup SECONDS] [output.wmv | output.mp4 | output.y4m | output.yuv | - [bars|gradient|boxes|text|noise [motion 0..1]]]
+//        SinkWriter [geometry] --input capture.y4m|capture.yuv [--input-format nv12|i420|rgb32] [--scale WIDTHxHEIGHT [--scale-filter bilinear|bicubic|area]] [--byte-stream file|stdout] [--fragment SECONDS] [--dedup SECONDS] [output]
+//        SinkWriter [--fragment SECONDS] --batch manifest.txt [max_sessions [memory_budget_mb]]
+//        SinkWriter [--fragment SECONDS] --segmented input output.mp4 [segments [audio_profile [video_profile]]]
+//        SinkWriter [--fragment SECONDS] --refragment input.mp4 output.mp4|-
+//        SinkWriter --profile-sweep input report_prefix [grid [baseline.csv [tolerance]]]
+//        SinkWriter [--fragment SECONDS] --daemon endpoint [max_sessions [max_queued]]
+//        SinkWriter --submit endpoint (input output [audio_profile [video_profile]] | status | shutdown)
+//
+// geometry: [--config video.cfg] [--size WIDTHxHEIGHT|720p|1080p|4k] [--fps 30|30000/1001] [--bitrate bps]
+// The config file holds "key = value" lines with the same keys (size, width,
+// height, fps, bitrate). --audio adds an AAC track using aac_profiles[N] and
+// needs an .mp4 output; *.mp4 is written as H.264. --byte-stream sends the
+// encoded output through our own coalescing byte stream, to the named file
+// or to stdout; stdout can't seek, so it needs a container written front to
+// back, such as the fragmented MP4 that --fragment selects: moof/mdat
+// fragments of about SECONDS each, usable downstream as soon as each is
+// written. --refragment turns an existing MP4 into one (2 s by default).
+// --input encodes a raw capture instead of a test pattern, reading it through
+// a memory mapping that slides forward, so captures larger than memory work.
+// A Y4M file carries its own size and frame rate; raw frames take them from
+// the geometry options, in NV12 unless --input-format says otherwise. Not
+// with --audio; the capture is encoded as video only.
+// --scale resizes an NV12 or I420 capture to another size, such as one of
+// the h264_profiles sizes, with our own SIMD scaler (SCALE_FILTER unless
+// --scale-filter says otherwise) before it reaches the encoder.
+// --dedup drops frames that repeat the one before and lengthens the sample
+// before them instead, up to SECONDS per sample, so static stretches of a
+// capture or a pattern with motion 0 cost no encoder work. Frames are
+// compared by hash and then byte for byte. Not with --audio or raw outputs,
+// which have no sample durations.
+// --profile-sweep transcodes the input with every profile combination of the
+// grid ("*:*", all of them, by default; see ParseProfileGrid) and writes fps,
+// realtime factor, output bitrate and memory growth to report_prefix.csv and
+// .json. Points more than tolerance (0.1 = 10%) worse than a baseline CSV
+// from an earlier sweep are flagged and make the exit status non-zero.
+// --daemon stays resident and takes transcode jobs from --submit clients
+// over a named pipe (\\.\pipe\endpoint), running up to max_sessions at
+// once on workers that start COM and Media Foundation once and keep the
+// transcode profiles they build, so a stream of short jobs doesn't pay for
+// that every time. More than max_queued waiting jobs (DAEMON_MAX_QUEUED by
+// default) are rejected. --submit sends one job and prints its progress
+// until it is done, or asks for the daemon's status, or for it to finish
+// its accepted jobs and exit.
+// --trace FILE, accepted by every form, records a timeline of the frame
+// loop, the sink writer and the media session and writes it as Chrome trace
+// JSON, for chrome://tracing or Perfetto.
+int main(int argc, char* argv[])
+{
+    int status = 0;
 
     HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
     if (SUCCEEDED(hr))
@@ -109,33 +710,112 @@ void main()
         hr = MFStartup(MF_VERSION);
         if (SUCCEEDED(hr))
         {
+            std::string tracePath;
             try
             {
-                auto sinkWriterAndStream = InitializeSinkWriter();
-
-                // Send frames to the sink writer.
-                LONGLONG rtStart = 0;
-
-                for (DWORD i = 0; i < VIDEO_FRAME_COUNT; ++i)
+                std::vector<std::string> args;
+                const VideoCoding::FrameGeometry geometry = ParseGeometryOptions(argc, argv, args);
+                const AudioOptions audio = ParseAudioOptions(args);
+                const std::string byteStream = ParseByteStreamOption(args);
+                const int64_t fragmentDuration = ParseSecondsOption(args, "--fragment", "fragment duration");
+                const int64_t dedupHold = ParseSecondsOption(args, "--dedup", "dedup hold");
+                const InputOptions input = ParseInputOptions(args);
+                tracePath = ParseTraceOption(args);
+                if (!tracePath.empty())
+                {
+                    VideoCoding::StartTracing();
+                    VideoCoding::SetTraceThreadName("main");
+                }
+                const std::string output = args.empty() ? "output.wmv" : args[0];
+                if (output == "--batch" && args.size() > 1)
+                {
+                    status = EncodeBatch(args[1], ParseBatchSettings(args), fragmentDuration);
+                }
+                else if (output == "--segmented" && args.size() > 2)
+                {
+                    const size_t segments = args.size() > 3 ? std::stoul(args[3]) : VideoCoding::DefaultSessionLimit();
+                    const int audioProfile = args.size() > 4 ? std::stoi(args[4]) : 0;
+                    const int videoProfile = args.size() > 5 ? std::stoi(args[5]) : 0;
+                    const VideoCoding::TranscodeSchedulerSettings settings = { segments, 0, BATCH_MAX_ATTEMPTS };
+                    status = EncodeSegmented(args[1], args[2], audioProfile, videoProfile, segments, settings, fragmentDuration);
+                }
+                else if (output == "--profile-sweep" && args.size() > 2)
+                {
+                    const std::string grid = args.size() > 3 ? args[3] : PROFILE_SWEEP_GRID;
+                    const std::string baseline = args.size() > 4 ? args[4] : std::string();
+                    const double tolerance = args.size() > 5 ? std::stod(args[5]) : PROFILE_SWEEP_TOLERANCE;
+                    status = EncodeProfileSweep(args[1], args[2], grid, baseline, tolerance);
+                }
+                else if (output == "--daemon" && args.size() > 1)
                 {
-                    // Add some random pixels
-                    for (size_t j = 0; j < 200; ++j)
+                    status = RunEncodeDaemon(args[1], ParseDaemonSettings(args, fragmentDuration));
+                }
+                else if (output == "--submit" && args.size() > 2)
+                {
+                    status = SubmitToDaemon(args[1], ParseSubmitRequest(args));
+                }
+                else if (output == "--refragment" && args.size() > 2)
+                {
+                    status = RefragmentFile(args[1], args[2], fragmentDuration > 0 ? fragmentDuration : VideoCoding::DEFAULT_FRAGMENT_DURATION);
+                }
+                else
+                {
+                    // Opened first, so a bad input doesn't leave an empty output behind.
+                    std::unique_ptr<VideoCoding::RawFrameReader> reader;
+                    if (!input.path.empty())
                     {
-                        videoFrameBuffer[distribution(generator) + (i % VIDEO_HEIGHT) * VIDEO_WIDTH] = (rand() % 0xFFFFFF);
+                        if (audio.profile >= 0)
+                        {
+                            // Captures carry no audio, and no test signal is mixed in.
+                            throw std::invalid_argument("--audio can't be used with --input");
+                        }
+                        const VideoCoding::RawFrameFormat format = { input.format, geometry.width, geometry.height, 0, 1 };
+                        reader.reset(new VideoCoding::RawFrameReader(input.path, format, INPUT_MAP_WINDOW));
                     }
-
-                    WriteFrame(sinkWriterAndStream.sinkWritter, sinkWriterAndStream.streamIndex, rtStart);
-                    rtStart += VIDEO_FRAME_DURATION;
+                    else if (input.scale.width > 0)
+                    {
+                        throw std::invalid_argument("--scale needs --input");
+                    }
+                    IMFWrappers::ComPtr<CCoalescingByteStream> stream;
+                    std::unique_ptr<VideoCoding::VideoSink> sink = CreateSink(output, byteStream, fragmentDuration, stream);
+                    if (dedupHold > 0 && (dynamic_cast<MFVideoSink*>(sink.get()) == nullptr || audio.profile >= 0))
+                    {
+                        // Raw outputs have no sample durations, so dropped frames would shorten the video.
+                        throw std::invalid_argument("--dedup needs a Media Foundation output without --audio");
+                    }
+                    if (reader)
+                    {
+                        WriteFileVideo(*sink, OutputCodec(output), geometry, *reader, input.scale, dedupHold);
+                    }
+                    else if (audio.profile >= 0)
+                    {
+                        WriteMedia(*sink, OutputCodec(output), geometry, ParsePatternSettings(args), static_cast<size_t>(audio.profile), audio.pattern);
+                    }
+                    else
+                    {
+                        WriteVideo(*sink, OutputCodec(output), geometry, ParsePatternSettings(args), dedupHold);
+                    }
+                    PrintByteStreamStats(stream.get());
                 }
-
             }
             catch (const WindowsError& err)
             {
-                std::cout << "Catched exception - " << err.toString() << std::endl;
+                std::cerr << "Catched exception - " << err.toString() << std::endl;
+                status = 1;
+            }
+            catch (const std::exception& err)
+            {
+                std::cerr << "Catched exception - " << err.what() << std::endl;
+                status = 1;
             }
+            // Also after a failure, when the timeline is most wanted.
+            WriteTrace(tracePath);
 
+            // The cached profiles and media types are Media Foundation objects.
+            ClearMFProfileCaches();
             MFShutdown();
         }
         CoUninitialize();
     }
+    return SUCCEEDED(hr) ? status : 1;
 }
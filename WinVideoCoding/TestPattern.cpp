@@ -0,0 +1,436 @@
+#include "TestPattern.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#ifdef VC_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        const uint32_t BAR_COLORS[8] =
+        {
+            0x00BFBFBF, 0x00BFBF00, 0x0000BFBF, 0x0000BF00, 0x00BF00BF, 0x00BF0000, 0x000000BF, 0x00101010,
+        };
+
+        const uint32_t BOX_BACKGROUND = 0x00202020;
+        const uint32_t TEXT_BACKGROUND = 0x00101820;
+        const uint32_t TEXT_FOREGROUND = 0x00E0E0E0;
+        const uint32_t GLYPH_WIDTH = 8;
+        const uint32_t GLYPH_HEIGHT = 16;
+        const uint32_t TICKER_SPEED = 4;        // pixels per frame
+        const uint32_t MAX_BOXES = 16;
+
+        const uint32_t GOLDEN = 0x9E3779B9u;
+
+        struct PatternName
+        {
+            TestPatternKind kind;
+            const char* name;
+        };
+
+        const PatternName PATTERN_NAMES[] =
+        {
+            { TestPatternKind::ColorBars, "bars" },
+            { TestPatternKind::Gradient, "gradient" },
+            { TestPatternKind::MovingBoxes, "boxes" },
+            { TestPatternKind::ScrollingText, "text" },
+            { TestPatternKind::Noise, "noise" },
+        };
+
+        // Fills row[x] for x in [0, count) with the colour bar under position
+        // (start + x), bars being width / 8 wide.
+        void FillBars(uint32_t* row, uint32_t count, uint32_t start, uint32_t width)
+        {
+            uint32_t x = 0;
+            while (x < count)
+            {
+                const uint32_t position = start + x;
+                const uint32_t bar = static_cast<uint32_t>(static_cast<uint64_t>(position) * 8 / width);
+                const uint32_t barEnd = static_cast<uint32_t>((static_cast<uint64_t>(bar + 1) * width + 7) / 8);
+                const uint32_t end = std::min(count, barEnd - start);
+                std::fill(row + x, row + end, BAR_COLORS[bar]);
+                x = end;
+            }
+        }
+
+        // Position bouncing between 0 and range, triangle wave.
+        uint32_t Bounce(uint32_t start, uint32_t velocity, uint64_t frameIndex, uint32_t range)
+        {
+            if (range == 0)
+            {
+                return 0;
+            }
+            const uint64_t period = 2 * static_cast<uint64_t>(range);
+            const uint64_t t = (start + (velocity % period) * (frameIndex % period)) % period;
+            return static_cast<uint32_t>(t <= range ? t : period - t);
+        }
+
+        void ScalarNoise(uint32_t* dst, uint32_t begin, uint32_t count, uint32_t key)
+        {
+            for (uint32_t i = begin; i < count; ++i)
+            {
+                dst[i] = PatternHash(key + i) & 0x00FFFFFF;
+            }
+        }
+
+#ifdef VC_X86
+        // SSE2 has no 32-bit low multiply, build it from two 32x32->64 ones.
+        inline __m128i MulLo32(__m128i a, __m128i b)
+        {
+            const __m128i even = _mm_mul_epu32(a, b);
+            const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+
+        uint32_t SSE2Noise(uint32_t* dst, uint32_t count, uint32_t key)
+        {
+            const __m128i m1 = _mm_set1_epi32(0x7FEB352D);
+            const __m128i m2 = _mm_set1_epi32(static_cast<int>(0x846CA68Bu));
+            const __m128i mask = _mm_set1_epi32(0x00FFFFFF);
+            const __m128i step = _mm_set1_epi32(4);
+            __m128i x = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(key)), _mm_setr_epi32(0, 1, 2, 3));
+
+            uint32_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i h = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+                h = MulLo32(h, m1);
+                h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+                h = MulLo32(h, m2);
+                h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_and_si128(h, mask));
+                x = _mm_add_epi32(x, step);
+            }
+            return i;
+        }
+
+        VC_TARGET_AVX2 uint32_t AVX2Noise(uint32_t* dst, uint32_t count, uint32_t key)
+        {
+            const __m256i m1 = _mm256_set1_epi32(0x7FEB352D);
+            const __m256i m2 = _mm256_set1_epi32(static_cast<int>(0x846CA68Bu));
+            const __m256i mask = _mm256_set1_epi32(0x00FFFFFF);
+            const __m256i step = _mm256_set1_epi32(8);
+            __m256i x = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(key)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+            uint32_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i h = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+                h = _mm256_mullo_epi32(h, m1);
+                h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+                h = _mm256_mullo_epi32(h, m2);
+                h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_and_si256(h, mask));
+                x = _mm256_add_epi32(x, step);
+            }
+            return i;
+        }
+#endif
+    }
+
+    const char* TestPatternName(TestPatternKind kind)
+    {
+        for (const PatternName& entry : PATTERN_NAMES)
+        {
+            if (entry.kind == kind)
+            {
+                return entry.name;
+            }
+        }
+        return "unknown";
+    }
+
+    bool ParseTestPattern(const std::string& name, TestPatternKind& kind)
+    {
+        for (const PatternName& entry : PATTERN_NAMES)
+        {
+            if (name == entry.name)
+            {
+                kind = entry.kind;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void FillNoise(SimdLevel level, uint32_t* dst, uint32_t count, uint32_t key)
+    {
+        uint32_t done = 0;
+        switch (level)
+        {
+#ifdef VC_X86
+        case SimdLevel::AVX2:
+            done = AVX2Noise(dst, count, key);
+            break;
+        case SimdLevel::SSE2:
+            done = SSE2Noise(dst, count, key);
+            break;
+#endif
+        default:
+            break;
+        }
+        ScalarNoise(dst, done, count, key);
+    }
+
+    // ------------------------------------------------------------------------
+
+    TestPatternProducer::TestPatternProducer(const TestPatternSettings& settings, SimdLevel level)
+        : settings(settings), level(level),
+          motion(static_cast<uint32_t>(std::lround(std::min(1.0, std::max(0.0, settings.motion)) * 65536)))
+    {
+    }
+
+    uint32_t TestPatternProducer::speed(uint32_t maxPixelsPerFrame) const
+    {
+        return static_cast<uint32_t>((static_cast<uint64_t>(motion) * maxPixelsPerFrame + 32768) >> 16);
+    }
+
+    uint32_t TestPatternProducer::tickerRows(uint32_t height) const
+    {
+        return static_cast<uint32_t>((static_cast<uint64_t>(motion) * height) >> 16);
+    }
+
+    bool TestPatternProducer::noiseRowRefreshed(uint32_t y, uint64_t frameIndex) const
+    {
+        const uint32_t frameKey = PatternHash(settings.seed + static_cast<uint32_t>(frameIndex) * GOLDEN);
+        return (PatternHash(frameKey + y) & 0xFFFF) < motion;
+    }
+
+    void TestPatternProducer::prepareFrame(uint32_t width, uint32_t height, uint64_t frameIndex)
+    {
+        if (settings.kind != TestPatternKind::MovingBoxes)
+        {
+            return;
+        }
+
+        const uint32_t count = std::min(MAX_BOXES, (motion * MAX_BOXES + 65535) >> 16);
+        const uint32_t boxWidth = std::max(2u, width / 8);
+        const uint32_t boxHeight = std::max(2u, height / 8);
+        const uint32_t rangeX = width > boxWidth ? width - boxWidth : 0;
+        const uint32_t rangeY = height > boxHeight ? height - boxHeight : 0;
+
+        boxes.clear();
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            const uint32_t h0 = PatternHash(settings.seed ^ ((k + 1) * GOLDEN));
+            const uint32_t h1 = PatternHash(h0);
+            const uint32_t h2 = PatternHash(h1);
+            const uint32_t x = Bounce(h0 % (rangeX + 1), 1 + (h1 & 7), frameIndex, rangeX);
+            const uint32_t y = Bounce(h1 % (rangeY + 1), 1 + ((h1 >> 8) & 7), frameIndex, rangeY);
+            const Box box = { x, y, std::min(width, x + boxWidth), std::min(height, y + boxHeight), (h2 & 0x00FFFFFF) | 0x00404040 };
+            boxes.push_back(box);
+        }
+    }
+
+    void TestPatternProducer::colorBarsRow(uint32_t* row, uint32_t y, uint32_t width, uint32_t height, uint64_t frameIndex) const
+    {
+        if (y < height - tickerRows(height))
+        {
+            FillBars(row, width, 0, width);
+            return;
+        }
+        const uint32_t shift = static_cast<uint32_t>((frameIndex * TICKER_SPEED) % width);
+        FillBars(row, width - shift, shift, width);
+        FillBars(row + (width - shift), shift, 0, width);
+    }
+
+    void TestPatternProducer::gradientRow(uint32_t* row, uint32_t y, uint32_t width, uint32_t height, uint64_t frameIndex) const
+    {
+        const uint32_t redStep = (255u << 16) / width;
+        const uint32_t blueStep = (255u << 16) / (width + height);
+        const uint32_t green = (y * 255 / height) << 8;
+        const uint32_t shift = static_cast<uint32_t>((frameIndex * speed(16)) % width);
+
+        // Red pans with the shift, blue runs along the diagonal. Two spans so
+        // the inner loops have no wrap-around and vectorize.
+        const uint32_t split = width - shift;
+        for (uint32_t x = 0; x < split; ++x)
+        {
+            row[x] = (((x + shift) * redStep >> 16) << 16) | green | ((x + y) * blueStep >> 16);
+        }
+        for (uint32_t x = split; x < width; ++x)
+        {
+            row[x] = (((x - split) * redStep >> 16) << 16) | green | ((x + y) * blueStep >> 16);
+        }
+    }
+
+    void TestPatternProducer::boxesRow(uint32_t* row, uint32_t y, uint32_t width) const
+    {
+        std::fill(row, row + width, BOX_BACKGROUND);
+        for (const Box& box : boxes)
+        {
+            if (y >= box.y0 && y < box.y1)
+            {
+                std::fill(row + box.x0, row + box.x1, box.color);
+            }
+        }
+    }
+
+    void TestPatternProducer::textRow(uint32_t* row, uint32_t y, uint32_t width, uint64_t frameIndex) const
+    {
+        const uint64_t scrolled = y + frameIndex * speed(GLYPH_HEIGHT / 2);
+        const uint32_t line = static_cast<uint32_t>(scrolled / GLYPH_HEIGHT);
+        const uint32_t glyphRow = static_cast<uint32_t>(scrolled % GLYPH_HEIGHT);
+
+        if (glyphRow < 2 || glyphRow >= GLYPH_HEIGHT - 2)
+        {
+            std::fill(row, row + width, TEXT_BACKGROUND);
+            return;
+        }
+
+        // Lines are 30..100% of the width, cells are letters or spaces.
+        const uint32_t columns = (width + GLYPH_WIDTH - 1) / GLYPH_WIDTH;
+        const uint32_t lineHash = PatternHash(settings.seed ^ (line * GOLDEN));
+        const uint32_t length = columns * 3 / 10 + lineHash % (columns - columns * 3 / 10 + 1);
+        std::fill(row + std::min(width, length * GLYPH_WIDTH), row + width, TEXT_BACKGROUND);
+
+        const uint32_t ink = TEXT_FOREGROUND ^ TEXT_BACKGROUND;
+        for (uint32_t column = 0; column < length; ++column)
+        {
+            const uint32_t cell = PatternHash(lineHash + column);
+            const uint32_t bits = (cell & 7) == 0 ? 0 : PatternHash(cell + glyphRow) & 0x7E;
+            const uint32_t x0 = column * GLYPH_WIDTH;
+            const uint32_t x1 = std::min(width, x0 + GLYPH_WIDTH);
+            for (uint32_t x = x0; x < x1; ++x)
+            {
+                row[x] = TEXT_BACKGROUND ^ ((0u - ((bits >> (x - x0)) & 1)) & ink);
+            }
+        }
+    }
+
+    void TestPatternProducer::noiseRow(uint32_t* row, uint32_t y, uint32_t width, uint64_t frameIndex) const
+    {
+        const uint32_t base = noiseRowRefreshed(y, frameIndex)
+            ? PatternHash(settings.seed ^ PatternHash(static_cast<uint32_t>(frameIndex) + 1))
+            : PatternHash(settings.seed);
+        FillNoise(level, row, width, base + y * width);
+    }
+
+    void TestPatternProducer::renderRow(uint32_t* row, uint32_t y, uint32_t width, uint32_t height, uint64_t frameIndex) const
+    {
+        switch (settings.kind)
+        {
+        case TestPatternKind::ColorBars:
+            colorBarsRow(row, y, width, height, frameIndex);
+            break;
+        case TestPatternKind::Gradient:
+            gradientRow(row, y, width, height, frameIndex);
+            break;
+        case TestPatternKind::MovingBoxes:
+            boxesRow(row, y, width);
+            break;
+        case TestPatternKind::ScrollingText:
+            textRow(row, y, width, frameIndex);
+            break;
+        case TestPatternKind::Noise:
+            noiseRow(row, y, width, frameIndex);
+            break;
+        }
+    }
+
+    void TestPatternProducer::addChangedRows(uint32_t width, uint32_t height, uint64_t frameIndex, DirtyRows& changed)
+    {
+        switch (settings.kind)
+        {
+        case TestPatternKind::ColorBars:
+            if (tickerRows(height) > 0)
+            {
+                changed.add(height - tickerRows(height), height);
+            }
+            break;
+        case TestPatternKind::Gradient:
+            if (speed(16) > 0)
+            {
+                changed.add(0, height);
+            }
+            break;
+        case TestPatternKind::ScrollingText:
+            if (speed(GLYPH_HEIGHT / 2) > 0)
+            {
+                changed.add(0, height);
+            }
+            break;
+        case TestPatternKind::MovingBoxes:
+            prepareFrame(width, height, frameIndex - 1);
+            previousBoxes.swap(boxes);
+            prepareFrame(width, height, frameIndex);
+            for (const Box& box : previousBoxes)
+            {
+                changed.add(box.y0, box.y1);
+            }
+            for (const Box& box : boxes)
+            {
+                changed.add(box.y0, box.y1);
+            }
+            break;
+        case TestPatternKind::Noise:
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                if (noiseRowRefreshed(y, frameIndex) || noiseRowRefreshed(y, frameIndex - 1))
+                {
+                    changed.addRow(y);
+                }
+            }
+            break;
+        }
+    }
+
+    void TestPatternProducer::render(const FrameView& frame, uint64_t frameIndex)
+    {
+        if (frame.format != PixelFormat::RGB32)
+        {
+            throw std::invalid_argument("TestPatternProducer: RGB32 frames only");
+        }
+        prepareFrame(frame.width, frame.height, frameIndex);
+        for (uint32_t y = 0; y < frame.height; ++y)
+        {
+            renderRow(reinterpret_cast<uint32_t*>(frame.row(y)), y, frame.width, frame.height, frameIndex);
+        }
+    }
+
+    void TestPatternProducer::renderFull(const FrameView& frame, uint64_t frameIndex)
+    {
+        render(frame, frameIndex);
+    }
+
+    void TestPatternProducer::renderChanges(const FrameView& frame, uint64_t frameIndex, DirtyRows& changed)
+    {
+        if (frame.format != PixelFormat::RGB32)
+        {
+            throw std::invalid_argument("TestPatternProducer: RGB32 frames only");
+        }
+
+        DirtyRows rows;
+        if (frameIndex == 0)
+        {
+            rows.add(0, frame.height);
+            prepareFrame(frame.width, frame.height, frameIndex);
+        }
+        else if (settings.kind == TestPatternKind::MovingBoxes)
+        {
+            addChangedRows(frame.width, frame.height, frameIndex, rows);
+        }
+        else
+        {
+            prepareFrame(frame.width, frame.height, frameIndex);
+            addChangedRows(frame.width, frame.height, frameIndex, rows);
+        }
+
+        for (const DirtyRows::Range& range : rows.getRanges())
+        {
+            for (uint32_t y = range.first; y < range.second; ++y)
+            {
+                renderRow(reinterpret_cast<uint32_t*>(frame.row(y)), y, frame.width, frame.height, frameIndex);
+            }
+        }
+        changed.merge(rows);
+    }
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "DirtyRegion.h"
+#include "FrameView.h"
+
+namespace VideoCoding
+{
+
+    enum class TestPatternKind
+    {
+        ColorBars,      // static 75% bars, a ticker strip at the bottom scrolls sideways
+        Gradient,       // diagonal colour gradient panning horizontally
+        MovingBoxes,    // solid boxes bouncing over a flat background
+        ScrollingText,  // lines of glyph-like blocks scrolling up
+        Noise,          // fixed colour noise, some rows replaced by fresh noise every frame
+    };
+
+    const char* TestPatternName(TestPatternKind kind);
+
+    // Accepts the names returned by TestPatternName.
+    bool ParseTestPattern(const std::string& name, TestPatternKind& kind);
+
+    struct TestPatternSettings
+    {
+        TestPatternKind kind;
+        uint32_t seed;
+        double motion;          // 0 is a static picture, 1 the most change per frame
+    };
+
+    // Counter based generator: PatternHash(key + i) for i = 0, 1, 2 ... is the
+    // random stream for `key`. Stateless, so every pixel is independent and
+    // the output does not depend on how the work is split or vectorized.
+    inline uint32_t PatternHash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7FEB352Du;
+        x ^= x >> 15;
+        x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // dst[i] = PatternHash(key + i) & 0x00FFFFFF. Every SimdLevel produces
+    // the same pixels.
+    void FillNoise(SimdLevel level, uint32_t* dst, uint32_t count, uint32_t key);
+
+    // Deterministic RGB32 test content. Frame N depends only on the settings,
+    // the frame size and N, so output is bit-identical across platforms,
+    // instruction sets and pipeline thread counts. Also usable as a
+    // DirtyFrameProducer: updates touch only the rows the pattern changes.
+    class TestPatternProducer : public FrameProducer, public DirtyFrameProducer
+    {
+    public:
+        explicit TestPatternProducer(const TestPatternSettings& settings, SimdLevel level = DetectSimdLevel());
+
+        void render(const FrameView& frame, uint64_t frameIndex) override;
+
+        void renderFull(const FrameView& frame, uint64_t frameIndex) override;
+        void renderChanges(const FrameView& frame, uint64_t frameIndex, DirtyRows& changed) override;
+
+        const TestPatternSettings& getSettings() const { return settings; }
+
+    private:
+        struct Box
+        {
+            uint32_t x0, y0, x1, y1;
+            uint32_t color;
+        };
+
+        void prepareFrame(uint32_t width, uint32_t height, uint64_t frameIndex);
+        void renderRow(uint32_t* row, uint32_t y, uint32_t width, uint32_t height, uint64_t frameIndex) const;
+        void addChangedRows(uint32_t width, uint32_t height, uint64_t frameIndex, DirtyRows& changed);
+
+        void colorBarsRow(uint32_t* row, uint32_t y, uint32_t width, uint32_t height, uint64_t frameIndex) const;
+        void gradientRow(uint32_t* row, uint32_t y, uint32_t width, uint32_t height, uint64_t frameIndex) const;
+        void boxesRow(uint32_t* row, uint32_t y, uint32_t width) const;
+        void textRow(uint32_t* row, uint32_t y, uint32_t width, uint64_t frameIndex) const;
+        void noiseRow(uint32_t* row, uint32_t y, uint32_t width, uint64_t frameIndex) const;
+
+        uint32_t tickerRows(uint32_t height) const;
+        uint32_t speed(uint32_t maxPixelsPerFrame) const;
+        bool noiseRowRefreshed(uint32_t y, uint64_t frameIndex) const;
+
+        TestPatternSettings settings;
+        SimdLevel level;
+        uint32_t motion;                // settings.motion in 1/65536 steps, 0..65536
+        std::vector<Box> boxes;         // MovingBoxes layout of the prepared frame
+        std::vector<Box> previousBoxes;
+    };
+
+}
@@ -0,0 +1,212 @@
+#include "Tracer.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace VideoCoding
+{
+
+    namespace TraceDetail
+    {
+        std::atomic<bool> enabled(false);
+    }
+
+    namespace
+    {
+        struct TraceEvent
+        {
+            const char* name;
+            uint64_t start;
+            uint64_t duration;
+            int64_t arg;
+            char phase;         // 'X' span, 'i' instant, 'C' counter
+        };
+
+        // Written by its thread only; `count` publishes the events to the
+        // dump.
+        struct TraceBuffer
+        {
+            TraceBuffer(uint64_t run, uint32_t thread, size_t capacity)
+                : run(run), thread(thread), events(capacity), count(0), dropped(0), name(nullptr) {}
+
+            const uint64_t run;
+            const uint32_t thread;      // tid in the trace, in order of first event
+            std::vector<TraceEvent> events;
+            std::atomic<size_t> count;
+            std::atomic<uint64_t> dropped;
+            std::atomic<const char*> name;
+        };
+
+        std::mutex registryMutex;
+        std::vector<std::unique_ptr<TraceBuffer>> registry;
+        std::atomic<uint64_t> currentRun(0);
+        size_t runCapacity = DEFAULT_TRACE_EVENTS;
+        uint64_t runStart = 0;
+        uint32_t runThreads = 0;
+
+        thread_local TraceBuffer* threadBuffer = nullptr;
+
+        TraceBuffer& ThreadBuffer()
+        {
+            const uint64_t run = currentRun.load(std::memory_order_acquire);
+            if (threadBuffer == nullptr || threadBuffer->run != run)
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                registry.emplace_back(new TraceBuffer(currentRun.load(std::memory_order_relaxed), runThreads++, runCapacity));
+                threadBuffer = registry.back().get();
+            }
+            return *threadBuffer;
+        }
+
+        void WriteJsonString(std::ostream& out, const char* text)
+        {
+            static const char HEX[] = "0123456789abcdef";
+            out << '"';
+            for (const char* c = text; *c != '\0'; ++c)
+            {
+                const unsigned char byte = static_cast<unsigned char>(*c);
+                if (*c == '"' || *c == '\\')
+                {
+                    out << '\\' << *c;
+                }
+                else if (byte < 0x20)
+                {
+                    // Control characters may not appear raw in a JSON string.
+                    out << "\\u00" << HEX[byte >> 4] << HEX[byte & 0xF];
+                }
+                else
+                {
+                    out << *c;
+                }
+            }
+            out << '"';
+        }
+
+        // Microseconds since the start of the run, as the format wants.
+        double Microseconds(uint64_t nanoseconds)
+        {
+            return nanoseconds / 1000.0;
+        }
+    }
+
+    namespace TraceDetail
+    {
+        uint64_t Now()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        void Record(const char* name, char phase, uint64_t start, uint64_t duration, int64_t arg)
+        {
+            TraceBuffer& buffer = ThreadBuffer();
+            const size_t index = buffer.count.load(std::memory_order_relaxed);
+            if (index >= buffer.events.size())
+            {
+                buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            TraceEvent& event = buffer.events[index];
+            event.name = name;
+            event.start = start;
+            event.duration = duration;
+            event.arg = arg;
+            event.phase = phase;
+            buffer.count.store(index + 1, std::memory_order_release);
+        }
+    }
+
+    void StartTracing(size_t eventsPerThread)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        runCapacity = eventsPerThread;
+        runStart = TraceDetail::Now();
+        runThreads = 0;
+        currentRun.fetch_add(1, std::memory_order_release);
+        TraceDetail::enabled.store(true, std::memory_order_relaxed);
+    }
+
+    void StopTracing()
+    {
+        TraceDetail::enabled.store(false, std::memory_order_relaxed);
+    }
+
+    void SetTraceThreadName(const char* name)
+    {
+        if (IsTracing())
+        {
+            ThreadBuffer().name.store(name, std::memory_order_release);
+        }
+    }
+
+    void WriteChromeTrace(std::ostream& out)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        const uint64_t run = currentRun.load(std::memory_order_relaxed);
+        out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+        bool first = true;
+        const auto separate = [&]
+        {
+            out << (first ? "  " : ",\n  ");
+            first = false;
+        };
+        for (const std::unique_ptr<TraceBuffer>& buffer : registry)
+        {
+            if (buffer->run != run)
+            {
+                continue;
+            }
+            if (const char* name = buffer->name.load(std::memory_order_acquire))
+            {
+                separate();
+                out << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << buffer->thread << ", \"args\": {\"name\": ";
+                WriteJsonString(out, name);
+                out << "}}";
+            }
+            const size_t count = buffer->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const TraceEvent& event = buffer->events[i];
+                // Spans begun before this run started are clamped to it.
+                const uint64_t start = event.start > runStart ? event.start - runStart : 0;
+                separate();
+                out << "{\"ph\": \"" << event.phase << "\", \"name\": ";
+                WriteJsonString(out, event.name);
+                out << ", \"pid\": 1, \"tid\": " << buffer->thread << ", \"ts\": " << Microseconds(start);
+                switch (event.phase)
+                {
+                case 'X':
+                    out << ", \"dur\": " << Microseconds(event.duration) << ", \"args\": {\"arg\": " << event.arg << "}}";
+                    break;
+                case 'C':
+                    out << ", \"args\": {\"value\": " << event.arg << "}}";
+                    break;
+                default:
+                    out << ", \"s\": \"t\", \"args\": {\"arg\": " << event.arg << "}}";
+                    break;
+                }
+            }
+        }
+        out << "\n]}\n";
+    }
+
+    TraceStats GetTraceStats()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        const uint64_t run = currentRun.load(std::memory_order_relaxed);
+        TraceStats stats = TraceStats();
+        for (const std::unique_ptr<TraceBuffer>& buffer : registry)
+        {
+            if (buffer->run == run)
+            {
+                ++stats.threads;
+                stats.events += buffer->count.load(std::memory_order_acquire);
+                stats.dropped += buffer->dropped.load(std::memory_order_relaxed);
+            }
+        }
+        return stats;
+    }
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace VideoCoding
+{
+
+    // Events each thread can record per tracing run; later ones are dropped
+    // and counted. 40 bytes each.
+    const size_t DEFAULT_TRACE_EVENTS = 1 << 16;
+
+    struct TraceStats
+    {
+        uint64_t threads;       // threads that recorded at least one event
+        uint64_t events;
+        uint64_t dropped;       // events that found their thread's buffer full
+    };
+
+    namespace TraceDetail
+    {
+        extern std::atomic<bool> enabled;
+
+        uint64_t Now();
+        void Record(const char* name, char phase, uint64_t start, uint64_t duration, int64_t arg);
+    }
+
+    // Timeline tracing, written out in the Chrome trace event format (load
+    // the file in chrome://tracing or Perfetto). Each thread appends to its
+    // own fixed-size buffer, so recording takes no lock and never allocates
+    // after the thread's first event. While tracing is off a trace point
+    // costs one relaxed atomic load.
+    //
+    // Names and categories must be string literals or otherwise outlive the
+    // dump; only the pointer is stored.
+
+    // Starts a new run, discarding what an earlier one recorded. Buffers of
+    // earlier runs are kept until exit, since a thread may still be writing
+    // the last event it started before StopTracing().
+    void StartTracing(size_t eventsPerThread = DEFAULT_TRACE_EVENTS);
+    void StopTracing();
+
+    inline bool IsTracing()
+    {
+        return TraceDetail::enabled.load(std::memory_order_relaxed);
+    }
+
+    // Shows up as the thread's name in the viewer. Ignored while not tracing.
+    void SetTraceThreadName(const char* name);
+
+    // A point in time, with an optional argument.
+    inline void TraceInstant(const char* name, int64_t arg = 0)
+    {
+        if (IsTracing())
+        {
+            TraceDetail::Record(name, 'i', TraceDetail::Now(), 0, arg);
+        }
+    }
+
+    // A value over time, drawn as its own track.
+    inline void TraceCounter(const char* name, int64_t value)
+    {
+        if (IsTracing())
+        {
+            TraceDetail::Record(name, 'C', TraceDetail::Now(), 0, value);
+        }
+    }
+
+    // Records the span from construction to destruction. Whether it records
+    // is decided on construction.
+    class TraceScope
+    {
+    public:
+        explicit TraceScope(const char* name, int64_t arg = 0)
+            : name(name), arg(arg), start(IsTracing() ? TraceDetail::Now() : 0)
+        {
+        }
+
+        ~TraceScope()
+        {
+            if (start != 0)
+            {
+                TraceDetail::Record(name, 'X', start, TraceDetail::Now() - start, arg);
+            }
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+        // For spans that only learn what they were about as they go.
+        void rename(const char* newName) { name = newName; }
+        void setArg(int64_t value) { arg = value; }
+
+    private:
+        const char* name;
+        int64_t arg;
+        const uint64_t start;
+    };
+
+    // Writes what the current run recorded, one process with a track per
+    // thread. Best called after StopTracing(); events still being written
+    // at the time may be left out.
+    void WriteChromeTrace(std::ostream& out);
+
+    TraceStats GetTraceStats();
+
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// TRACE_SCOPE("name") or TRACE_SCOPE("name", arg) traces the rest of the
+// enclosing block.
+#define TRACE_SCOPE(...) VideoCoding::TraceScope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
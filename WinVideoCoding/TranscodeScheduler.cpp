@@ -0,0 +1,303 @@
+#include "TranscodeScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "FrameView.h"
+
+namespace VideoCoding
+{
+
+    namespace
+    {
+        double SecondsSince(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        int ParseProfileField(const std::string& text, size_t lineNumber)
+        {
+            size_t used = 0;
+            int value = -1;
+            try
+            {
+                value = std::stoi(text, &used);
+            }
+            catch (const std::exception&)
+            {
+                used = 0;
+            }
+            if (used == 0 || used != text.size() || value < 0)
+            {
+                std::ostringstream message;
+                message << "manifest line " << lineNumber << ": bad number '" << text << "'";
+                throw std::invalid_argument(message.str());
+            }
+            return value;
+        }
+
+        // Shared between the worker threads of one TranscodeScheduler::run.
+        struct BatchState
+        {
+            std::mutex mutex;
+            std::condition_variable changed;
+            std::deque<size_t> pending;
+            size_t running;
+            uint64_t memoryInUse;
+            TranscodeBatchReport report;
+        };
+    }
+
+    size_t DefaultSessionLimit()
+    {
+        const size_t cores = std::thread::hardware_concurrency();
+        return std::max<size_t>(1, cores / 2);
+    }
+
+    uint64_t EstimateSessionMemory(uint32_t width, uint32_t height)
+    {
+        const uint64_t SURFACES_IN_FLIGHT = 32;
+        const uint64_t FIXED_OVERHEAD = 32ull << 20;
+        return FIXED_OVERHEAD + SURFACES_IN_FLIGHT * FrameBytes(PixelFormat::NV12, width, height);
+    }
+
+    std::vector<TranscodeJob> ParseTranscodeManifest(std::istream& in)
+    {
+        std::vector<TranscodeJob> jobs;
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(in, line))
+        {
+            ++lineNumber;
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            std::vector<std::string> fields;
+            std::istringstream fieldStream(line);
+            std::string field;
+            while (std::getline(fieldStream, field, '\t'))
+            {
+                fields.push_back(field);
+            }
+            if (fields.size() < 2 || fields.size() > 5 || fields[0].empty() || fields[1].empty())
+            {
+                std::ostringstream message;
+                message << "manifest line " << lineNumber << ": expected input<TAB>output[<TAB>audio_profile[<TAB>video_profile[<TAB>memory_mb]]]";
+                throw std::invalid_argument(message.str());
+            }
+
+            TranscodeJob job = { fields[0], fields[1], 0, 0, 0, 0, 0, 0 };
+            if (fields.size() > 2)
+            {
+                job.audioProfile = ParseProfileField(fields[2], lineNumber);
+            }
+            if (fields.size() > 3)
+            {
+                job.videoProfile = ParseProfileField(fields[3], lineNumber);
+            }
+            if (fields.size() > 4)
+            {
+                job.memoryEstimate = static_cast<uint64_t>(ParseProfileField(fields[4], lineNumber)) << 20;
+            }
+            jobs.push_back(job);
+        }
+        return jobs;
+    }
+
+    // ------------------------------------------------------------------------
+
+    TranscodeScheduler::TranscodeScheduler(const TranscodeSchedulerSettings& settings)
+        : sessionLimit(settings.maxSessions > 0 ? settings.maxSessions : DefaultSessionLimit()),
+          memoryBudget(settings.memoryBudget),
+          maxAttempts(std::max(1u, settings.maxAttempts))
+    {
+    }
+
+    TranscodeBatchReport TranscodeScheduler::run(const std::vector<TranscodeJob>& jobs, const TranscodeRunnerFactory& createRunner, const JobCallback& onJobFinished)
+    {
+        BatchState state;
+        state.running = 0;
+        state.memoryInUse = 0;
+        state.report = TranscodeBatchReport();
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            TranscodeJobReport job = { i, jobs[i], false, 0, 0.0, { 0, 0 }, std::string() };
+            state.report.jobs.push_back(job);
+            state.pending.push_back(i);
+        }
+
+        const uint64_t budget = memoryBudget;
+        const unsigned attemptLimit = maxAttempts;
+        const auto batchStart = std::chrono::steady_clock::now();
+
+        // The head of the queue is admitted when it fits in the budget, or
+        // unconditionally when the machine is otherwise idle.
+        auto admissible = [&state, budget]()
+        {
+            if (state.pending.empty())
+            {
+                return false;
+            }
+            const uint64_t need = state.report.jobs[state.pending.front()].job.memoryEstimate;
+            return state.running == 0 || budget == 0 || state.memoryInUse + need <= budget;
+        };
+
+        auto worker = [&]()
+        {
+            std::unique_ptr<TranscodeRunner> runner;
+            std::unique_lock<std::mutex> lock(state.mutex);
+            for (;;)
+            {
+                state.changed.wait(lock, [&]() { return admissible() || (state.pending.empty() && state.running == 0); });
+                if (state.pending.empty())
+                {
+                    break;
+                }
+
+                const size_t index = state.pending.front();
+                state.pending.pop_front();
+                TranscodeJobReport& report = state.report.jobs[index];
+                const uint64_t memory = report.job.memoryEstimate;
+                ++state.running;
+                state.memoryInUse += memory;
+                state.report.peakSessions = std::max(state.report.peakSessions, state.running);
+                state.report.peakMemory = std::max(state.report.peakMemory, state.memoryInUse);
+                ++report.attempts;
+                const TranscodeJob job = report.job;
+                lock.unlock();
+
+                bool succeeded = false;
+                bool retryable = true;
+                TranscodeOutcome outcome = { 0, 0 };
+                std::string error;
+                const auto attemptStart = std::chrono::steady_clock::now();
+                try
+                {
+                    // Created lazily so a runner that fails to start counts
+                    // against the job and is tried again for the next one.
+                    if (!runner)
+                    {
+                        runner = createRunner();
+                    }
+                    outcome = runner->transcode(job);
+                    succeeded = true;
+                }
+                catch (const TranscodeError& err)
+                {
+                    error = err.what();
+                    retryable = err.isRetryable();
+                }
+                catch (const std::exception& err)
+                {
+                    error = err.what();
+                }
+                const double attemptSeconds = SecondsSince(attemptStart);
+
+                lock.lock();
+                --state.running;
+                state.memoryInUse -= memory;
+                report.seconds += attemptSeconds;
+                report.outcome = outcome;
+                report.succeeded = succeeded;
+                report.error = error;
+
+                const bool finished = succeeded || !retryable || report.attempts >= attemptLimit;
+                if (!finished)
+                {
+                    state.pending.push_back(index);
+                    ++state.report.retries;
+                }
+                state.changed.notify_all();
+
+                if (finished && onJobFinished)
+                {
+                    const TranscodeJobReport finishedReport = report;
+                    lock.unlock();
+                    onJobFinished(finishedReport);
+                    lock.lock();
+                }
+            }
+            lock.unlock();
+            runner.reset();
+        };
+
+        const size_t workerCount = std::min(sessionLimit, jobs.size());
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < workerCount; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+        if (workerCount > 0)
+        {
+            worker();
+        }
+        for (std::thread& thread : workers)
+        {
+            thread.join();
+        }
+
+        TranscodeBatchReport& report = state.report;
+        report.seconds = SecondsSince(batchStart);
+        for (const TranscodeJobReport& job : report.jobs)
+        {
+            if (job.succeeded)
+            {
+                ++report.succeeded;
+                report.mediaDuration += job.outcome.mediaDuration;
+                report.outputBytes += job.outcome.outputBytes;
+            }
+            else
+            {
+                ++report.failed;
+            }
+        }
+        return report;
+    }
+
+    // ------------------------------------------------------------------------
+
+    void WriteTranscodeJobStatus(std::ostream& out, const TranscodeJobReport& report)
+    {
+        std::ostringstream line;
+        line << "[" << report.index + 1 << "] " << (report.succeeded ? "OK    " : "FAILED") << " "
+            << report.job.input << " -> " << report.job.output << " (" << report.attempts
+            << (report.attempts == 1 ? " attempt, " : " attempts, ") << report.seconds << " s";
+        if (report.succeeded && report.seconds > 0)
+        {
+            line << ", " << report.outcome.mediaDuration / 1e7 / report.seconds << "x realtime";
+        }
+        line << ")";
+        if (!report.succeeded)
+        {
+            line << ": " << report.error;
+        }
+        line << "\n";
+        out << line.str() << std::flush;
+    }
+
+    void WriteTranscodeBatchSummary(std::ostream& out, const TranscodeBatchReport& report)
+    {
+        const double mediaSeconds = report.mediaDuration / 1e7;
+        out << report.succeeded << " of " << report.jobs.size() << " jobs succeeded, " << report.failed << " failed, "
+            << report.retries << " retries in " << report.seconds << " s" << std::endl;
+        if (report.seconds > 0)
+        {
+            out << "Throughput: " << mediaSeconds / report.seconds << "x realtime, "
+                << report.outputBytes / 1e6 / report.seconds << " MB/s written, "
+                << report.succeeded / report.seconds << " jobs/s" << std::endl;
+        }
+        out << "Peak: " << report.peakSessions << " sessions, " << (report.peakMemory >> 20) << " MiB estimated" << std::endl;
+    }
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SessionNotifier.h"
+
+namespace VideoCoding
+{
+
+    // One manifest entry. Profiles are indices into the encoder's profile
+    // tables and are not interpreted by the scheduler.
+    struct TranscodeJob
+    {
+        std::string input;
+        std::string output;
+        int audioProfile;
+        int videoProfile;
+        uint64_t memoryEstimate;    // bytes a running session holds, 0 if unknown
+        int64_t start;              // part of the input to transcode, 100 ns units;
+        int64_t end;                // end 0 means the whole input
+        int64_t fragmentDuration;   // 100 ns units, 0 writes a progressive MP4
+    };
+
+    // Thrown by a runner when it knows whether another attempt could help.
+    // Any other std::exception is treated as retryable.
+    class TranscodeError : public std::runtime_error
+    {
+    public:
+        TranscodeError(const std::string& what, bool retryable) : std::runtime_error(what), retryable(retryable) {}
+
+        bool isRetryable() const { return retryable; }
+
+    private:
+        bool retryable;
+    };
+
+    struct TranscodeOutcome
+    {
+        int64_t mediaDuration;      // source media transcoded, 100 ns units
+        uint64_t outputBytes;
+    };
+
+    typedef std::function<void(const SessionProgress&)> TranscodeProgressCallback;
+
+    // Runs one job at a time. Each scheduler worker creates its own runner on
+    // its own thread, so implementations may keep per-thread state such as
+    // COM apartments or a Media Foundation startup.
+    class TranscodeRunner
+    {
+    public:
+        virtual ~TranscodeRunner() {}
+
+        virtual TranscodeOutcome transcode(const TranscodeJob& job) = 0;
+
+        // Same, passing the job's progress to `onProgress` on the calling
+        // thread as it goes. Runners that can't tell only transcode.
+        virtual TranscodeOutcome transcodeWithProgress(const TranscodeJob& job, const TranscodeProgressCallback& onProgress)
+        {
+            (void)onProgress;
+            return transcode(job);
+        }
+    };
+
+    typedef std::function<std::unique_ptr<TranscodeRunner>()> TranscodeRunnerFactory;
+
+    struct TranscodeJobReport
+    {
+        size_t index;               // position in the manifest
+        TranscodeJob job;
+        bool succeeded;
+        unsigned attempts;
+        double seconds;             // wall time summed over all attempts
+        TranscodeOutcome outcome;
+        std::string error;          // last failure, empty on success
+    };
+
+    struct TranscodeBatchReport
+    {
+        std::vector<TranscodeJobReport> jobs;   // manifest order
+        size_t succeeded;
+        size_t failed;
+        size_t retries;
+        double seconds;
+        size_t peakSessions;
+        uint64_t peakMemory;
+        int64_t mediaDuration;
+        uint64_t outputBytes;
+    };
+
+    struct TranscodeSchedulerSettings
+    {
+        size_t maxSessions;         // 0 picks DefaultSessionLimit()
+        uint64_t memoryBudget;      // 0 means unlimited
+        unsigned maxAttempts;       // per job, at least 1
+    };
+
+    // Encoder and decoder transforms are multithreaded themselves, so one
+    // session per two cores keeps the machine busy without oversubscribing.
+    size_t DefaultSessionLimit();
+
+    // Rough working set of a session decoding and encoding frames of the
+    // given size: a few dozen NV12 surfaces in flight plus fixed overhead.
+    uint64_t EstimateSessionMemory(uint32_t width, uint32_t height);
+
+    // Tab separated, one job per line:
+    //     input <TAB> output [<TAB> audio_profile [<TAB> video_profile [<TAB> memory_mb]]]
+    // Blank lines and lines starting with '#' are ignored. Throws
+    // std::invalid_argument naming the offending line.
+    std::vector<TranscodeJob> ParseTranscodeManifest(std::istream& in);
+
+    // Runs jobs on up to maxSessions worker threads, in manifest order.
+    //
+    // A job is admitted when a worker is free and its memory estimate fits in
+    // what is left of the budget. A job larger than the whole budget still
+    // runs, but only once nothing else is running. Failed jobs go to the back
+    // of the queue until they run out of attempts; a failure never stops the
+    // rest of the batch.
+    class TranscodeScheduler
+    {
+    public:
+        typedef std::function<void(const TranscodeJobReport&)> JobCallback;
+
+        explicit TranscodeScheduler(const TranscodeSchedulerSettings& settings);
+
+        // onJobFinished is called once per job, from the worker thread that
+        // finished it, with no scheduler lock held.
+        TranscodeBatchReport run(const std::vector<TranscodeJob>& jobs, const TranscodeRunnerFactory& createRunner, const JobCallback& onJobFinished = JobCallback());
+
+        size_t getSessionLimit() const { return sessionLimit; }
+
+    private:
+        const size_t sessionLimit;
+        const uint64_t memoryBudget;
+        const unsigned maxAttempts;
+    };
+
+    void WriteTranscodeJobStatus(std::ostream& out, const TranscodeJobReport& report);
+    void WriteTranscodeBatchSummary(std::ostream& out, const TranscodeBatchReport& report);
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "ColorConversion.h"
+#include "FrameView.h"
+
+namespace VideoCoding
+{
+
+    enum class VideoCodec
+    {
+        Uncompressed,
+        WMV3,
+        H264,
+    };
+
+    struct VideoStreamFormat
+    {
+        VideoCodec codec;
+        PixelFormat pixelFormat;    // only meaningful for uncompressed input
+        uint32_t width;
+        uint32_t height;
+        uint32_t fpsNumerator;
+        uint32_t fpsDenominator;
+        uint32_t bitrate;           // only meaningful for compressed output
+        ColorMatrix matrix;
+        ColorRange range;
+    };
+
+    enum class AudioCodec
+    {
+        PCM,
+        AAC,
+    };
+
+    // Interleaved integer samples for PCM.
+    struct AudioStreamFormat
+    {
+        AudioCodec codec;
+        uint32_t sampleRate;
+        uint32_t channels;
+        uint32_t bitsPerSample;
+        uint32_t bytesPerSecond;    // only meaningful for compressed output
+        uint32_t aacProfile;        // MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION
+
+        uint32_t blockAlign() const { return channels * bitsPerSample / 8; }
+    };
+
+    // A writable frame handed out by a sink. The view stays valid until the
+    // frame is passed back through writeFrame() or discardFrame(), the handle
+    // belongs to the backend. Both clear the handle once they have taken the
+    // frame, writeFrame() even when it then fails; a frame with a null handle
+    // must not be passed back again.
+    struct SinkFrame
+    {
+        FrameView view;
+        void* handle;
+    };
+
+    // Destination for encoded or raw video, modelled on IMFSinkWriter:
+    // addStream() declares what is written, setInputFormat() what is fed in,
+    // then frames are written between beginWriting() and finalize().
+    //
+    // The sink owns the frame buffers so backends can hand out memory that
+    // goes to the encoder without another copy. acquireFrame() and
+    // discardFrame() may be called from any thread, the other methods from
+    // one thread at a time.
+    class VideoSink
+    {
+    public:
+        virtual ~VideoSink() {}
+
+        virtual uint32_t addStream(const VideoStreamFormat& outputFormat) = 0;
+        virtual void setInputFormat(uint32_t streamIndex, const VideoStreamFormat& inputFormat) = 0;
+        virtual void beginWriting() = 0;
+
+        virtual SinkFrame acquireFrame(uint32_t streamIndex) = 0;
+        // Timestamp and duration are in 100 ns units.
+        virtual void writeFrame(uint32_t streamIndex, SinkFrame& frame, int64_t timestamp, int64_t duration) = 0;
+        virtual void discardFrame(uint32_t streamIndex, SinkFrame& frame) = 0;
+
+        // Audio is optional, sinks that take none keep these defaults. The
+        // stream is declared and given its PCM input in one go; writeAudio()
+        // copies whole sample blocks, from the same thread as writeFrame().
+        virtual uint32_t addAudioStream(const AudioStreamFormat& /*outputFormat*/, const AudioStreamFormat& /*inputFormat*/)
+        {
+            throw std::invalid_argument("this sink does not take audio");
+        }
+
+        // Timestamp and duration are in 100 ns units.
+        virtual void writeAudio(uint32_t /*streamIndex*/, const void* /*data*/, size_t /*bytes*/, int64_t /*timestamp*/, int64_t /*duration*/)
+        {
+            throw std::invalid_argument("this sink does not take audio");
+        }
+
+        virtual void finalize() = 0;
+    };
+
+}
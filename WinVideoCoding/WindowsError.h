@@ -8,6 +8,8 @@
 #include <locale>
 #include <codecvt>
 
+#include "Result.h"
+
 #define THROW_WINDOWS_ERROR(arg) throw WindowsError(arg, __FILE__, __LINE__);
 
 #define DO_CHECKED_OPERATION(X) \
@@ -19,32 +21,56 @@
     } \
 } \
 
+// System message text for an HRESULT, UTF-8. Usable as a
+// VideoCoding::StatusFormatter.
+inline std::string FormatWindowsMessage(int32_t errorCode) {
+    wchar_t wBuf[256];
+    if (FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, NULL, errorCode, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), wBuf, 256, NULL) == 0) {
+        return VideoCoding::FormatStatusCode(errorCode);
+    }
+    int size = WideCharToMultiByte(CP_UTF8, 0, wBuf, -1, NULL, 0, NULL, NULL);
+    std::string str(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, wBuf, -1, &str[0], size, NULL, NULL);
+    str.resize(size > 0 ? size - 1 : 0);
+    return str;
+}
+
+// Only the code and the site are stored, `file` is expected to be a string
+// literal such as __FILE__. The message is looked up by toString().
 class WindowsError {
 public:
 
     explicit WindowsError(int errorCode, const char *file, int line) : errorCode(errorCode), file(file), line(line) {}
 
+    explicit WindowsError(const VideoCoding::Status& status) : errorCode(status.getCode()), file(status.getFile()), line(status.getLine()) {}
+
     std::string toString() const {
-        wchar_t wBuf[256];
-        FormatMessageW(FORMAT_MESSAGE_FROM_SYSTEM, NULL, errorCode, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), wBuf, 256, NULL);
-        std::string excp = wideCharToMultiByte(wBuf);
         std::ostringstream o;
-        o << file << ":" << line << ": " << excp;
+        o << file << ":" << line << ": " << FormatWindowsMessage(errorCode);
         return o.str();
     }
 
-private:
-
-    std::string wideCharToMultiByte(const wchar_t *lpwstr) const {
-        int size = WideCharToMultiByte(CP_UTF8, 0, lpwstr, -1, NULL, 0, NULL, NULL);
-        char *buffer = new char[size + 1];
-        WideCharToMultiByte(CP_UTF8, 0, lpwstr, -1, buffer, size, NULL, NULL);
-        std::string str(buffer);
-        delete[]buffer;
-        return str;
+    int getErrorCode() const {
+        return errorCode;
     }
 
+private:
+
     int errorCode;
-    std::string file;
+    const char *file;
     int line;
 };
+
+// Where the non-throwing calls meet code that expects exceptions: rethrows a
+// failed Status as WindowsError, keeping the site it was made at.
+inline void ThrowIfFailed(const VideoCoding::Status& status) {
+    if (status.failed()) {
+        throw WindowsError(status);
+    }
+}
+
+template<typename T>
+T Unwrap(VideoCoding::Result<T>&& result) {
+    ThrowIfFailed(result.getStatus());
+    return result.take();
+}